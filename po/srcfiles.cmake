@@ -250,12 +250,16 @@ SET(WEECHAT_SOURCES
 ./src/plugins/irc/irc-protocol.h
 ./src/plugins/irc/irc-raw.c
 ./src/plugins/irc/irc-raw.h
+./src/plugins/irc/irc-recv-thread.c
+./src/plugins/irc/irc-recv-thread.h
 ./src/plugins/irc/irc-redirect.c
 ./src/plugins/irc/irc-redirect.h
 ./src/plugins/irc/irc-sasl.c
 ./src/plugins/irc/irc-sasl.h
 ./src/plugins/irc/irc-server.c
 ./src/plugins/irc/irc-server.h
+./src/plugins/irc/irc-stats.c
+./src/plugins/irc/irc-stats.h
 ./src/plugins/javascript/weechat-js-api.cpp
 ./src/plugins/javascript/weechat-js-api.h
 ./src/plugins/javascript/weechat-js-v8.cpp
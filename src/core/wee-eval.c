@@ -731,6 +731,10 @@ eval_string_if (const char *text, struct t_eval_context *eval_context)
 /*
  * Gets value of hdata using "path" to a variable.
  *
+ * The path is compiled only once (see function hdata_path_get), so that
+ * evaluating many times the same expression does not look for variables by
+ * name in hdata.
+ *
  * Note: result must be freed after use.
  */
 
@@ -738,9 +742,11 @@ char *
 eval_hdata_get_value (struct t_hdata *hdata, void *pointer, const char *path,
                       struct t_eval_context *eval_context)
 {
-    char *value, *old_value, *var_name, str_value[128], *pos;
-    const char *ptr_value, *hdata_name, *ptr_var_name;
-    int type, debug_id;
+    char *value, str_value[128];
+    const char *ptr_value;
+    void *ptr_var;
+    int debug_id;
+    struct t_hdata_path *hpath;
     struct t_hashtable *hashtable;
 
     EVAL_DEBUG_MSG(1, "eval_hdata_get_value(\"%s\", 0x%lx, \"%s\")",
@@ -749,7 +755,6 @@ eval_hdata_get_value (struct t_hdata *hdata, void *pointer, const char *path,
                    path);
 
     value = NULL;
-    var_name = NULL;
 
     /* NULL pointer? return empty string */
     if (!pointer)
@@ -771,68 +776,63 @@ eval_hdata_get_value (struct t_hdata *hdata, void *pointer, const char *path,
         goto end;
 
     /*
-     * look for name of hdata, for example in "window.buffer.full_name", the
-     * hdata name is "window"
+     * get compiled path, for example "window.buffer.full_name" with hdata
+     * "window" follows pointer "buffer" then reads "full_name" in buffer
      */
-    pos = strchr (path, '.');
-    if (pos > path)
-        var_name = string_strndup (path, pos - path);
-    else
-        var_name = strdup (path);
-
-    if (!var_name)
+    hpath = hdata_path_get (hdata, path);
+    if (!hpath)
         goto end;
 
-    /* search type of variable in hdata */
-    hdata_get_index_and_name (var_name, NULL, &ptr_var_name);
-    type = hdata_get_var_type (hdata, ptr_var_name);
-    if (type < 0)
+    /* NULL pointer in path? return empty string */
+    ptr_var = hdata_path_get_value (hpath, pointer, -1);
+    if (!ptr_var)
+    {
+        value = strdup ("");
         goto end;
+    }
 
     /* build a string with the value or variable */
-    switch (type)
+    switch (hdata_path_get_type (hpath))
     {
         case WEECHAT_HDATA_CHAR:
             snprintf (str_value, sizeof (str_value),
-                      "%c", hdata_char (hdata, pointer, var_name));
+                      "%c", *((char *)ptr_var));
             value = strdup (str_value);
             break;
         case WEECHAT_HDATA_INTEGER:
             snprintf (str_value, sizeof (str_value),
-                      "%d", hdata_integer (hdata, pointer, var_name));
+                      "%d", *((int *)ptr_var));
             value = strdup (str_value);
             break;
         case WEECHAT_HDATA_LONG:
             snprintf (str_value, sizeof (str_value),
-                      "%ld", hdata_long (hdata, pointer, var_name));
+                      "%ld", *((long *)ptr_var));
             value = strdup (str_value);
             break;
         case WEECHAT_HDATA_STRING:
         case WEECHAT_HDATA_SHARED_STRING:
-            ptr_value = hdata_string (hdata, pointer, var_name);
+            ptr_value = *((char **)ptr_var);
             value = (ptr_value) ? strdup (ptr_value) : NULL;
             break;
         case WEECHAT_HDATA_POINTER:
-            pointer = hdata_pointer (hdata, pointer, var_name);
             snprintf (str_value, sizeof (str_value),
-                      "0x%lx", (unsigned long)pointer);
+                      "0x%lx", (unsigned long)(*((void **)ptr_var)));
             value = strdup (str_value);
             break;
         case WEECHAT_HDATA_TIME:
             snprintf (str_value, sizeof (str_value),
-                      "%lld", (long long)hdata_time (hdata, pointer, var_name));
+                      "%lld", (long long)(*((time_t *)ptr_var)));
             value = strdup (str_value);
             break;
         case WEECHAT_HDATA_HASHTABLE:
-            pointer = hdata_hashtable (hdata, pointer, var_name);
-            if (pos)
+            hashtable = *((struct t_hashtable **)ptr_var);
+            if (hpath->hashtable_key)
             {
                 /*
                  * for a hashtable, if there is a "." after name of hdata,
                  * get the value for this key in hashtable
                  */
-                hashtable = pointer;
-                ptr_value = hashtable_get (hashtable, pos + 1);
+                ptr_value = hashtable_get (hashtable, hpath->hashtable_key);
                 if (ptr_value)
                 {
                     switch (hashtable->type_values)
@@ -864,36 +864,13 @@ eval_hdata_get_value (struct t_hdata *hdata, void *pointer, const char *path,
             else
             {
                 snprintf (str_value, sizeof (str_value),
-                          "0x%lx", (unsigned long)pointer);
+                          "0x%lx", (unsigned long)hashtable);
                 value = strdup (str_value);
             }
             break;
     }
 
-    /*
-     * if we are on a pointer and that something else is in path (after "."),
-     * go on with this pointer and remaining path
-     */
-    if ((type == WEECHAT_HDATA_POINTER) && pos)
-    {
-        hdata_name = hdata_get_var_hdata (hdata, var_name);
-        if (!hdata_name)
-            goto end;
-
-        hdata = hook_hdata_get (NULL, hdata_name);
-        old_value = value;
-        value = eval_hdata_get_value (hdata,
-                                      pointer,
-                                      (pos) ? pos + 1 : NULL,
-                                      eval_context);
-        if (old_value)
-            free (old_value);
-    }
-
 end:
-    if (var_name)
-        free (var_name);
-
     EVAL_DEBUG_RESULT(1, value);
 
     return value;
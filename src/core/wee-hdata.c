@@ -30,6 +30,7 @@
 #include "wee-hdata.h"
 #include "wee-eval.h"
 #include "wee-hashtable.h"
+#include "wee-hook.h"
 #include "wee-log.h"
 #include "wee-string.h"
 #include "../plugins/plugin.h"
@@ -42,6 +43,10 @@ struct t_hashtable *hdata_search_pointers = NULL;
 struct t_hashtable *hdata_search_extra_vars = NULL;
 struct t_hashtable *hdata_search_options = NULL;
 
+/* all compiled paths (invalidated when a hdata is freed or updated) */
+struct t_hdata_path *hdata_paths = NULL;
+struct t_hdata_path *last_hdata_path = NULL;
+
 char *hdata_type_string[9] =
 { "other", "char", "integer", "long", "string", "pointer", "time",
   "hashtable", "shared_string" };
@@ -87,6 +92,21 @@ hdata_free_list (struct t_hashtable *hashtable,
     free (value);
 }
 
+/*
+ * Frees a compiled path in hdata.
+ */
+
+void
+hdata_free_path (struct t_hashtable *hashtable,
+                 const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    hdata_path_free ((struct t_hdata_path *)value);
+}
+
 /*
  * Creates a new hdata.
  *
@@ -127,6 +147,7 @@ hdata_new (struct t_weechat_plugin *plugin, const char *hdata_name,
                                               NULL,
                                               NULL);
         new_hdata->hash_list->callback_free_value = &hdata_free_list;
+        new_hdata->hash_path = NULL;
         hashtable_set (weechat_hdata, hdata_name, new_hdata);
         new_hdata->create_allowed = create_allowed;
         new_hdata->delete_allowed = delete_allowed;
@@ -152,6 +173,10 @@ hdata_new_var (struct t_hdata *hdata, const char *name, int offset, int type,
     if (!hdata || !name)
         return;
 
+    /* variable replaced: compiled paths using this hdata are now invalid */
+    if (hashtable_has_key (hdata->hash_var, name))
+        hdata_path_invalidate (hdata);
+
     var = malloc (sizeof (*var));
     if (var)
     {
@@ -1154,6 +1179,422 @@ hdata_get_string (struct t_hdata *hdata, const char *property)
     return NULL;
 }
 
+/*
+ * Compiles a path to a variable in hdata: variables are resolved only once
+ * (offsets, types, hdata, size of array), so that the value can then be read
+ * in many objects without any lookup by name (see functions
+ * hdata_path_get_type, hdata_path_get_array_size and hdata_path_get_value).
+ *
+ * Argument path has format: "var1.var2.var3", where all variables except the
+ * last one are pointers to another hdata; each variable can contain an index
+ * in array with format "N|name".
+ * The path stops on first variable which is not a pointer to another hdata:
+ * if it is a hashtable, the rest of path is a key in this hashtable (other
+ * variables ignore the rest of path).
+ *
+ * Returns pointer to compiled path, NULL if error (variable not found).
+ *
+ * Note: result must be freed with hdata_path_free after use; the compiled
+ * path becomes invalid if one of its hdata is freed or updated with a new
+ * variable (it can still be used and freed, but no value is returned).
+ */
+
+struct t_hdata_path *
+hdata_path_compile (struct t_hdata *hdata, const char *path)
+{
+    struct t_hdata_path *new_path;
+    struct t_hdata_path_var *ptr_var;
+    struct t_hdata_var *var, *var_size;
+    struct t_hdata *ptr_hdata;
+    const char *ptr_path, *pos, *ptr_name;
+    char *name, *error;
+    int index, max_vars;
+    long number;
+
+    if (!hdata || !path || !path[0])
+        return NULL;
+
+    new_path = malloc (sizeof (*new_path));
+    if (!new_path)
+        return NULL;
+
+    /* the path can not have more variables than the number of "." + 1 */
+    max_vars = 1;
+    for (pos = path; pos[0]; pos++)
+    {
+        if (pos[0] == '.')
+            max_vars++;
+    }
+
+    new_path->hdata = hdata;
+    new_path->num_vars = 0;
+    new_path->vars = malloc (max_vars * sizeof (*new_path->vars));
+    new_path->type = -1;
+    new_path->array_size = HDATA_PATH_ARRAY_SIZE_NONE;
+    new_path->array_size_offset = -1;
+    new_path->array_size_type = -1;
+    new_path->hashtable_key = NULL;
+    new_path->prev_path = NULL;
+    new_path->next_path = NULL;
+    if (!new_path->vars)
+        goto error;
+
+    ptr_hdata = hdata;
+    ptr_path = path;
+    while (1)
+    {
+        pos = strchr (ptr_path, '.');
+        if (pos > ptr_path)
+            name = string_strndup (ptr_path, pos - ptr_path);
+        else
+            name = strdup (ptr_path);
+        if (!name)
+            goto error;
+        hdata_get_index_and_name (name, &index, &ptr_name);
+        var = hashtable_get (ptr_hdata->hash_var, ptr_name);
+        free (name);
+        if (!var)
+            goto error;
+
+        ptr_var = &new_path->vars[new_path->num_vars];
+        ptr_var->hdata = ptr_hdata;
+        ptr_var->offset = var->offset;
+        ptr_var->index = index;
+        ptr_var->array = (var->array_size) ? 1 : 0;
+        new_path->num_vars++;
+        new_path->type = var->type;
+
+        if (var->type == WEECHAT_HDATA_HASHTABLE)
+        {
+            if (pos)
+            {
+                new_path->hashtable_key = strdup (pos + 1);
+                if (!new_path->hashtable_key)
+                    goto error;
+            }
+            break;
+        }
+
+        /*
+         * end of path, variable with a value or pointer without hdata:
+         * stop here
+         */
+        if ((var->type != WEECHAT_HDATA_POINTER) || !var->hdata_name
+            || !pos || !pos[1])
+        {
+            break;
+        }
+
+        /* pointer followed by another variable: go on with its hdata */
+        ptr_hdata = hook_hdata_get (NULL, var->hdata_name);
+        if (!ptr_hdata)
+            goto error;
+        ptr_path = pos + 1;
+    }
+
+    /* resolve size of array for the last variable */
+    if (var->array_size)
+    {
+        if (strcmp (var->array_size, "*") == 0)
+        {
+            /* automatic size is possible only with pointers */
+            if ((var->type == WEECHAT_HDATA_STRING)
+                || (var->type == WEECHAT_HDATA_SHARED_STRING)
+                || (var->type == WEECHAT_HDATA_POINTER)
+                || (var->type == WEECHAT_HDATA_HASHTABLE))
+            {
+                new_path->array_size = HDATA_PATH_ARRAY_SIZE_AUTO;
+            }
+        }
+        else
+        {
+            var_size = hashtable_get (ptr_hdata->hash_var, var->array_size);
+            if (var_size)
+            {
+                new_path->array_size = HDATA_PATH_ARRAY_SIZE_VAR;
+                new_path->array_size_offset = var_size->offset;
+                new_path->array_size_type = var_size->type;
+            }
+            else
+            {
+                error = NULL;
+                number = strtol (var->array_size, &error, 10);
+                if (error && !error[0] && (number >= 0))
+                    new_path->array_size = (int)number;
+            }
+        }
+    }
+
+    /* add compiled path to list */
+    new_path->prev_path = last_hdata_path;
+    if (last_hdata_path)
+        last_hdata_path->next_path = new_path;
+    else
+        hdata_paths = new_path;
+    last_hdata_path = new_path;
+
+    return new_path;
+
+error:
+    if (new_path->vars)
+        free (new_path->vars);
+    if (new_path->hashtable_key)
+        free (new_path->hashtable_key);
+    free (new_path);
+    return NULL;
+}
+
+/*
+ * Gets a compiled path in hdata: the path is compiled on first call and kept
+ * in hdata for next calls.
+ *
+ * Returns pointer to compiled path, NULL if error.
+ *
+ * Note: result must NOT be freed (it is freed with the hdata).
+ */
+
+struct t_hdata_path *
+hdata_path_get (struct t_hdata *hdata, const char *path)
+{
+    struct t_hdata_path *ptr_path;
+
+    if (!hdata || !path || !path[0])
+        return NULL;
+
+    if (!hdata->hash_path)
+    {
+        hdata->hash_path = hashtable_new (32,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          WEECHAT_HASHTABLE_POINTER,
+                                          NULL,
+                                          NULL);
+        if (!hdata->hash_path)
+            return NULL;
+        hdata->hash_path->callback_free_value = &hdata_free_path;
+    }
+
+    ptr_path = hashtable_get (hdata->hash_path, path);
+    if (ptr_path && ptr_path->hdata)
+        return ptr_path;
+
+    if (!ptr_path
+        && (hdata->hash_path->items_count >= HDATA_PATH_CACHE_MAX))
+    {
+        hashtable_remove_all (hdata->hash_path);
+    }
+
+    /* path not yet compiled (or invalidated): compile it now */
+    ptr_path = hdata_path_compile (hdata, path);
+    if (ptr_path)
+        hashtable_set (hdata->hash_path, path, ptr_path);
+    else
+        hashtable_remove (hdata->hash_path, path);
+
+    return ptr_path;
+}
+
+/*
+ * Gets type of last variable in a compiled path.
+ *
+ * Returns type of variable, -1 if error (or if path has been invalidated).
+ */
+
+int
+hdata_path_get_type (struct t_hdata_path *hpath)
+{
+    if (!hpath || !hpath->hdata)
+        return -1;
+
+    return hpath->type;
+}
+
+/*
+ * Follows pointers of a compiled path, starting with object "pointer".
+ *
+ * Returns pointer to object containing the last variable of path, NULL if a
+ * pointer in path is NULL (or if path has been invalidated).
+ */
+
+void *
+hdata_path_get_object (struct t_hdata_path *hpath, void *pointer)
+{
+    struct t_hdata_path_var *ptr_var;
+    void **array;
+    int i;
+
+    if (!hpath || !hpath->hdata)
+        return NULL;
+
+    for (i = 0; i < hpath->num_vars - 1; i++)
+    {
+        if (!pointer)
+            return NULL;
+        ptr_var = &hpath->vars[i];
+        if (ptr_var->array && (ptr_var->index >= 0))
+        {
+            array = *((void ***)(pointer + ptr_var->offset));
+            pointer = (array) ? array[ptr_var->index] : NULL;
+        }
+        else
+        {
+            pointer = *((void **)(pointer + ptr_var->offset));
+        }
+    }
+
+    return pointer;
+}
+
+/*
+ * Gets size of array for last variable of a compiled path, starting with
+ * object "pointer".
+ *
+ * Returns size of array, -1 if variable is not an array (or if error).
+ */
+
+int
+hdata_path_get_array_size (struct t_hdata_path *hpath, void *pointer)
+{
+    void *object, **array;
+    int i;
+
+    object = hdata_path_get_object (hpath, pointer);
+    if (!object)
+        return -1;
+
+    switch (hpath->array_size)
+    {
+        case HDATA_PATH_ARRAY_SIZE_NONE:
+            return -1;
+        case HDATA_PATH_ARRAY_SIZE_AUTO:
+            array = *((void ***)(object
+                                 + hpath->vars[hpath->num_vars - 1].offset));
+            if (!array)
+                return 0;
+            i = 0;
+            while (array[i])
+            {
+                i++;
+            }
+            return i;
+        case HDATA_PATH_ARRAY_SIZE_VAR:
+            switch (hpath->array_size_type)
+            {
+                case WEECHAT_HDATA_CHAR:
+                    return (int)(*((char *)(object + hpath->array_size_offset)));
+                case WEECHAT_HDATA_INTEGER:
+                    return *((int *)(object + hpath->array_size_offset));
+                case WEECHAT_HDATA_LONG:
+                    return (int)(*((long *)(object + hpath->array_size_offset)));
+                default:
+                    return -1;
+            }
+    }
+
+    return hpath->array_size;
+}
+
+/*
+ * Gets pointer to the value of last variable of a compiled path, starting
+ * with object "pointer".
+ *
+ * If the variable is an array, argument "index" is the index in array; if
+ * "index" is negative, the index in path is used ("N|name"), if any.
+ *
+ * Returns pointer to value (content of variable), NULL if a pointer in path
+ * is NULL (or if error).
+ */
+
+void *
+hdata_path_get_value (struct t_hdata_path *hpath, void *pointer, int index)
+{
+    struct t_hdata_path_var *ptr_var;
+    void *object, *array;
+
+    object = hdata_path_get_object (hpath, pointer);
+    if (!object)
+        return NULL;
+
+    ptr_var = &hpath->vars[hpath->num_vars - 1];
+    if (index < 0)
+        index = ptr_var->index;
+
+    if (!ptr_var->array || (index < 0))
+        return object + ptr_var->offset;
+
+    switch (hpath->type)
+    {
+        case WEECHAT_HDATA_CHAR:
+            array = *((char **)(object + ptr_var->offset));
+            return (array) ? ((char *)array) + index : NULL;
+        case WEECHAT_HDATA_INTEGER:
+            return ((int *)(object + ptr_var->offset)) + index;
+        case WEECHAT_HDATA_LONG:
+            return ((long *)(object + ptr_var->offset)) + index;
+        case WEECHAT_HDATA_TIME:
+            return ((time_t *)(object + ptr_var->offset)) + index;
+        case WEECHAT_HDATA_STRING:
+        case WEECHAT_HDATA_SHARED_STRING:
+        case WEECHAT_HDATA_POINTER:
+        case WEECHAT_HDATA_HASHTABLE:
+            array = *((void ***)(object + ptr_var->offset));
+            return (array) ? ((void **)array) + index : NULL;
+    }
+
+    return object + ptr_var->offset;
+}
+
+/*
+ * Invalidates all compiled paths using a hdata (called when the hdata is
+ * freed or when a variable is replaced in hdata).
+ */
+
+void
+hdata_path_invalidate (struct t_hdata *hdata)
+{
+    struct t_hdata_path *ptr_path;
+    int i;
+
+    for (ptr_path = hdata_paths; ptr_path; ptr_path = ptr_path->next_path)
+    {
+        for (i = 0; i < ptr_path->num_vars; i++)
+        {
+            if (ptr_path->vars[i].hdata == hdata)
+            {
+                ptr_path->hdata = NULL;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Frees a compiled path.
+ */
+
+void
+hdata_path_free (struct t_hdata_path *hpath)
+{
+    if (!hpath)
+        return;
+
+    /* remove compiled path from list */
+    if (hpath->prev_path)
+        (hpath->prev_path)->next_path = hpath->next_path;
+    if (hpath->next_path)
+        (hpath->next_path)->prev_path = hpath->prev_path;
+    if (hdata_paths == hpath)
+        hdata_paths = hpath->next_path;
+    if (last_hdata_path == hpath)
+        last_hdata_path = hpath->prev_path;
+
+    if (hpath->vars)
+        free (hpath->vars);
+    if (hpath->hashtable_key)
+        free (hpath->hashtable_key);
+
+    free (hpath);
+}
+
 /*
  * Frees a hdata.
  */
@@ -1172,9 +1613,14 @@ hdata_free (struct t_hdata *hdata)
         free (hdata->var_next);
     if (hdata->hash_list)
         hashtable_free (hdata->hash_list);
+    if (hdata->hash_path)
+        hashtable_free (hdata->hash_path);
     if (hdata->name)
         free (hdata->name);
 
+    /* compiled paths using this hdata (in other hdata or plugins) */
+    hdata_path_invalidate (hdata);
+
     free (hdata);
 }
 
@@ -1291,6 +1737,9 @@ hdata_print_log_map_cb (void *data, struct t_hashtable *hashtable,
     log_printf ("  hash_list. . . . . . . : 0x%lx (hashtable: '%s')",
                 ptr_hdata->hash_list,
                 hashtable_get_string (ptr_hdata->hash_list, "keys_values"));
+    log_printf ("  hash_path. . . . . . . : 0x%lx (hashtable: '%s')",
+                ptr_hdata->hash_path,
+                hashtable_get_string (ptr_hdata->hash_path, "keys"));
     log_printf ("  create_allowed . . . . : %d",    (int)ptr_hdata->create_allowed);
     log_printf ("  delete_allowed . . . . : %d",    (int)ptr_hdata->delete_allowed);
     log_printf ("  callback_update. . . . : 0x%lx", ptr_hdata->callback_update);
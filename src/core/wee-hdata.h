@@ -30,6 +30,14 @@
 #define HDATA_LIST(__name, __flags)                                     \
     hdata_new_list (hdata, #__name, &(__name), __flags);
 
+/* array size of last variable in a compiled path */
+#define HDATA_PATH_ARRAY_SIZE_NONE -1  /* not an array (or invalid size)    */
+#define HDATA_PATH_ARRAY_SIZE_AUTO -2  /* automatic: look for NULL in array */
+#define HDATA_PATH_ARRAY_SIZE_VAR  -3  /* size is the value of a variable   */
+
+/* max number of compiled paths kept in a hdata (see hdata_path_get) */
+#define HDATA_PATH_CACHE_MAX 256
+
 struct t_hdata_var
 {
     int offset;                        /* offset                            */
@@ -45,6 +53,34 @@ struct t_hdata_list
     int flags;                         /* flags for list                    */
 };
 
+struct t_hdata_path_var
+{
+    struct t_hdata *hdata;             /* hdata of object with variable     */
+    int offset;                        /* offset of variable in object      */
+    int index;                         /* index in array ("N|name" in path) */
+                                       /* (-1 if no index)                  */
+    char array;                        /* 1 if variable is an array         */
+};
+
+struct t_hdata_path
+{
+    struct t_hdata *hdata;             /* hdata of first object in path     */
+                                       /* (NULL if path has been            */
+                                       /* invalidated: hdata freed/updated) */
+    int num_vars;                      /* number of variables in path       */
+    struct t_hdata_path_var *vars;     /* variables (pointers to follow,    */
+                                       /* then variable with the value)     */
+    int type;                          /* type of last variable             */
+    int array_size;                    /* size of array for last variable   */
+                                       /* (>= 0 or HDATA_PATH_ARRAY_SIZE_*) */
+    int array_size_offset;             /* offset of var with size of array  */
+    int array_size_type;               /* type of var with size of array    */
+    char *hashtable_key;               /* key in hashtable (if last var is  */
+                                       /* a hashtable followed by a key)    */
+    struct t_hdata_path *prev_path;    /* link to previous compiled path    */
+    struct t_hdata_path *next_path;    /* link to next compiled path        */
+};
+
 struct t_hdata
 {
     char *name;                        /* name of hdata                     */
@@ -57,6 +93,8 @@ struct t_hdata
     struct t_hashtable *hash_var;      /* hash with type & offset of vars   */
     struct t_hashtable *hash_list;     /* hashtable with pointers on lists  */
                                        /* (used to search objects)          */
+    struct t_hashtable *hash_path;     /* compiled paths (used by eval),    */
+                                       /* created on first use              */
 
     char create_allowed;               /* create allowed?                   */
     char delete_allowed;               /* delete allowed?                   */
@@ -135,6 +173,19 @@ extern int hdata_update (struct t_hdata *hdata, void *pointer,
                          struct t_hashtable *hashtable);
 extern const char *hdata_get_string (struct t_hdata *hdata,
                                      const char *property);
+extern struct t_hdata_path *hdata_path_compile (struct t_hdata *hdata,
+                                                const char *path);
+extern struct t_hdata_path *hdata_path_get (struct t_hdata *hdata,
+                                            const char *path);
+extern int hdata_path_get_type (struct t_hdata_path *hpath);
+extern void *hdata_path_get_object (struct t_hdata_path *hpath,
+                                    void *pointer);
+extern int hdata_path_get_array_size (struct t_hdata_path *hpath,
+                                      void *pointer);
+extern void *hdata_path_get_value (struct t_hdata_path *hpath, void *pointer,
+                                   int index);
+extern void hdata_path_invalidate (struct t_hdata *hdata);
+extern void hdata_path_free (struct t_hdata_path *hpath);
 extern void hdata_free_all_plugin (struct t_weechat_plugin *plugin);
 extern void hdata_free_all ();
 extern void hdata_print_log ();
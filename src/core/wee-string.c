@@ -64,7 +64,11 @@
                     ((c >= 'A') && (c <= 'F')) ? c - 'A' + 10 :         \
                     c - '0')
 
+/* max number of iconv descriptors kept open (pool) */
+#define STRING_ICONV_POOL_MAX 64
+
 struct t_hashtable *string_hashtable_shared = NULL;
+struct t_hashtable *string_hashtable_iconv = NULL;
 
 
 /*
@@ -2633,6 +2637,88 @@ string_free_split_tags (char ***split_tags)
     }
 }
 
+#ifdef HAVE_ICONV
+/*
+ * Frees an iconv descriptor (callback called when an item is removed from
+ * the iconv pool).
+ */
+
+void
+string_iconv_free_cd (struct t_hashtable *hashtable,
+                      const void *key, void *value)
+{
+    iconv_t *ptr_cd;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    ptr_cd = (iconv_t *)value;
+    if (*ptr_cd != (iconv_t)(-1))
+        iconv_close (*ptr_cd);
+    free (ptr_cd);
+}
+
+/*
+ * Gets an iconv descriptor to convert from a charset to another.
+ *
+ * Descriptors are opened once and kept in a pool (hashtable with key
+ * "from_code" + "\n" + "to_code"), so that iconv_open is not called for
+ * each conversion (an unsupported conversion is kept as well).
+ *
+ * Returns (iconv_t)(-1) if the conversion is not supported.
+ */
+
+iconv_t
+string_iconv_get_cd (const char *from_code, const char *to_code)
+{
+    iconv_t *ptr_cd;
+    char *key;
+    int length;
+
+    if (!string_hashtable_iconv)
+    {
+        string_hashtable_iconv = hashtable_new (32,
+                                                WEECHAT_HASHTABLE_STRING,
+                                                WEECHAT_HASHTABLE_POINTER,
+                                                NULL, NULL);
+        if (!string_hashtable_iconv)
+            return (iconv_t)(-1);
+        string_hashtable_iconv->callback_free_value = &string_iconv_free_cd;
+    }
+
+    length = strlen (from_code) + 1 + strlen (to_code) + 1;
+    key = malloc (length);
+    if (!key)
+        return (iconv_t)(-1);
+    snprintf (key, length, "%s\n%s", from_code, to_code);
+
+    ptr_cd = hashtable_get (string_hashtable_iconv, key);
+    if (!ptr_cd)
+    {
+        ptr_cd = malloc (sizeof (*ptr_cd));
+        if (!ptr_cd)
+        {
+            free (key);
+            return (iconv_t)(-1);
+        }
+        *ptr_cd = iconv_open (to_code, from_code);
+        if (string_hashtable_iconv->items_count >= STRING_ICONV_POOL_MAX)
+            hashtable_remove_all (string_hashtable_iconv);
+        hashtable_set (string_hashtable_iconv, key, ptr_cd);
+    }
+    else if (*ptr_cd != (iconv_t)(-1))
+    {
+        /* reset conversion state (previous conversion may be incomplete) */
+        iconv (*ptr_cd, NULL, NULL, NULL, NULL);
+    }
+
+    free (key);
+
+    return *ptr_cd;
+}
+#endif /* HAVE_ICONV */
+
 /*
  * Converts a string to another charset.
  *
@@ -2660,7 +2746,7 @@ string_iconv (int from_utf8, const char *from_code, const char *to_code,
     if (from_code && from_code[0] && to_code && to_code[0]
         && (string_strcasecmp (from_code, to_code) != 0))
     {
-        cd = iconv_open (to_code, from_code);
+        cd = string_iconv_get_cd (from_code, to_code);
         if (cd == (iconv_t)(-1))
             outbuf = strdup (string);
         else
@@ -2733,7 +2819,6 @@ string_iconv (int from_utf8, const char *from_code, const char *to_code,
                 ptr_inbuf = ptr_inbuf_shift;
             ptr_outbuf[0] = '\0';
             free (inbuf);
-            iconv_close (cd);
         }
     }
     else
@@ -4096,4 +4181,9 @@ string_end ()
         hashtable_free (string_hashtable_shared);
         string_hashtable_shared = NULL;
     }
+    if (string_hashtable_iconv)
+    {
+        hashtable_free (string_hashtable_iconv);
+        string_hashtable_iconv = NULL;
+    }
 }
@@ -35,6 +35,7 @@
 #include <ctype.h>
 
 #include "../core/weechat.h"
+#include "../core/wee-arraylist.h"
 #include "../core/wee-config.h"
 #include "../core/wee-hashtable.h"
 #include "../core/wee-hdata.h"
@@ -98,7 +99,7 @@ char *gui_buffer_properties_get_integer[] =
   "input_get_empty", "input_multiline", "input_size", "input_length",
   "input_pos", "input_1st_display", "num_history", "text_search",
   "text_search_exact", "text_search_regex", "text_search_where",
-  "text_search_found",
+  "text_search_found", "batch",
   NULL
 };
 char *gui_buffer_properties_get_string[] =
@@ -720,6 +721,9 @@ gui_buffer_new (struct t_weechat_plugin *plugin,
     new_buffer->lines = new_buffer->own_lines;
     new_buffer->time_for_each_line = 1;
     new_buffer->chat_refresh_needed = 2;
+    new_buffer->batch = 0;
+    new_buffer->batch_lines = NULL;
+    new_buffer->batch_lines_index = NULL;
 
     /* nicklist */
     new_buffer->nicklist = 0;
@@ -1142,6 +1146,8 @@ gui_buffer_get_integer (struct t_gui_buffer *buffer, const char *property)
         return buffer->zoomed;
     else if (string_strcasecmp (property, "print_hooks_enabled") == 0)
         return buffer->print_hooks_enabled;
+    else if (string_strcasecmp (property, "batch") == 0)
+        return buffer->batch;
     else if (string_strcasecmp (property, "day_change") == 0)
         return buffer->day_change;
     else if (string_strcasecmp (property, "clear") == 0)
@@ -1291,6 +1297,112 @@ gui_buffer_ask_chat_refresh (struct t_gui_buffer *buffer, int refresh)
         buffer->chat_refresh_needed = refresh;
 }
 
+/*
+ * Starts a batch of lines in a buffer: until the end of batch, lines are
+ * inserted sorted by date, the hotlist is not updated and the signal
+ * "buffer_line_added" is not sent.
+ *
+ * Batches can be nested: the batch ends with the last call to
+ * gui_buffer_batch_end.
+ */
+
+void
+gui_buffer_batch_start (struct t_gui_buffer *buffer)
+{
+    if (!buffer || (buffer->type != GUI_BUFFER_TYPE_FORMATTED))
+        return;
+
+    if (!buffer->batch_lines)
+    {
+        buffer->batch_lines = arraylist_new (64, 0, 1,
+                                             NULL, NULL, NULL, NULL);
+        if (!buffer->batch_lines)
+            return;
+        buffer->batch_lines_index = hashtable_new (64,
+                                                   WEECHAT_HASHTABLE_POINTER,
+                                                   WEECHAT_HASHTABLE_INTEGER,
+                                                   NULL, NULL);
+        if (!buffer->batch_lines_index)
+        {
+            arraylist_free (buffer->batch_lines);
+            buffer->batch_lines = NULL;
+            return;
+        }
+    }
+
+    buffer->batch++;
+}
+
+/*
+ * Ends a batch of lines in a buffer: the hotlist is updated once with all
+ * lines added, the signal "buffer_lines_added" is sent with the arraylist
+ * of lines added and the buffer is fully refreshed.
+ *
+ * Lines freed during the batch have been replaced by NULL in the arraylist
+ * (see function gui_line_free), they are removed before the signal is sent.
+ */
+
+void
+gui_buffer_batch_end (struct t_gui_buffer *buffer)
+{
+    struct t_arraylist *lines;
+    struct t_gui_line *ptr_line;
+    int i, j, size, count[GUI_HOTLIST_NUM_PRIORITIES];
+
+    if (!buffer || (buffer->batch <= 0))
+        return;
+
+    buffer->batch--;
+    if (buffer->batch > 0)
+        return;
+
+    lines = buffer->batch_lines;
+    buffer->batch_lines = NULL;
+    if (buffer->batch_lines_index)
+    {
+        hashtable_free (buffer->batch_lines_index);
+        buffer->batch_lines_index = NULL;
+    }
+    if (!lines)
+        return;
+
+    /* remove lines freed during the batch */
+    j = 0;
+    for (i = 0; i < lines->size; i++)
+    {
+        if (lines->data[i])
+            lines->data[j++] = lines->data[i];
+    }
+    lines->size = j;
+
+    size = arraylist_size (lines);
+    if (size > 0)
+    {
+        memset (count, 0, sizeof (count));
+        for (i = 0; i < size; i++)
+        {
+            ptr_line = (struct t_gui_line *)arraylist_get (lines, i);
+            if (!ptr_line->data->displayed
+                || (ptr_line->data->notify_level < GUI_HOTLIST_MIN))
+            {
+                continue;
+            }
+            if (ptr_line->data->highlight)
+                count[GUI_HOTLIST_HIGHLIGHT]++;
+            else if (ptr_line->data->notify_level <= GUI_HOTLIST_MAX)
+                count[(int)(ptr_line->data->notify_level)]++;
+        }
+        (void) gui_hotlist_add_count (buffer, count, NULL);
+
+        (void) hook_signal_send ("buffer_lines_added",
+                                 WEECHAT_HOOK_SIGNAL_POINTER, lines);
+
+        gui_buffer_ask_chat_refresh (buffer, 2);
+    }
+
+    arraylist_free (lines);
+}
+
 /*
  * Sets name for a buffer.
  */
@@ -2916,6 +3028,16 @@ gui_buffer_close (struct t_gui_buffer *buffer)
     }
 
     /* free all lines */
+    if (buffer->batch_lines)
+    {
+        arraylist_free (buffer->batch_lines);
+        buffer->batch_lines = NULL;
+    }
+    if (buffer->batch_lines_index)
+    {
+        hashtable_free (buffer->batch_lines_index);
+        buffer->batch_lines_index = NULL;
+    }
     gui_line_free_all (buffer);
     if (buffer->own_lines)
         free (buffer->own_lines);
@@ -4311,6 +4433,7 @@ gui_buffer_hdata_buffer_cb (const void *pointer, void *data,
         HDATA_VAR(struct t_gui_buffer, lines, POINTER, 0, NULL, "lines");
         HDATA_VAR(struct t_gui_buffer, time_for_each_line, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, chat_refresh_needed, INTEGER, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_buffer, batch, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nicklist, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nicklist_case_sensitive, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nicklist_root, POINTER, 0, NULL, "nick_group");
@@ -4735,6 +4858,9 @@ gui_buffer_print_log ()
         log_printf ("  lines . . . . . . . . . : 0x%lx", ptr_buffer->lines);
         log_printf ("  time_for_each_line. . . : %d",    ptr_buffer->time_for_each_line);
         log_printf ("  chat_refresh_needed . . : %d",    ptr_buffer->chat_refresh_needed);
+        log_printf ("  batch . . . . . . . . . : %d",    ptr_buffer->batch);
+        log_printf ("  batch_lines . . . . . . : 0x%lx", ptr_buffer->batch_lines);
+        log_printf ("  batch_lines_index . . . : 0x%lx", ptr_buffer->batch_lines_index);
         log_printf ("  nicklist. . . . . . . . : %d",    ptr_buffer->nicklist);
         log_printf ("  nicklist_case_sensitive : %d",    ptr_buffer->nicklist_case_sensitive);
         log_printf ("  nicklist_root . . . . . : 0x%lx", ptr_buffer->nicklist_root);
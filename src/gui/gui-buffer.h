@@ -23,6 +23,7 @@
 #include <limits.h>
 #include <regex.h>
 
+struct t_arraylist;
 struct t_hashtable;
 struct t_gui_window;
 struct t_infolist;
@@ -125,6 +126,9 @@ struct t_gui_buffer
     int time_for_each_line;            /* time is displayed for each line?  */
     int chat_refresh_needed;           /* refresh for chat is needed ?      */
                                        /* (1=refresh, 2=erase+refresh)      */
+    int batch;                         /* > 0 if lines are added in a batch */
+    struct t_arraylist *batch_lines;   /* lines added in current batch      */
+    struct t_hashtable *batch_lines_index; /* line -> index in batch_lines  */
 
     /* nicklist */
     int nicklist;                      /* = 1 if nicklist is enabled        */
@@ -304,6 +308,8 @@ extern void gui_buffer_set_highlight_tags_restrict (struct t_gui_buffer *buffer,
                                                     const char *new_tags);
 extern void gui_buffer_set_highlight_tags (struct t_gui_buffer *buffer,
                                            const char *new_tags);
+extern void gui_buffer_batch_start (struct t_gui_buffer *buffer);
+extern void gui_buffer_batch_end (struct t_gui_buffer *buffer);
 extern void gui_buffer_set_hotlist_max_level_nicks (struct t_gui_buffer *buffer,
                                                     const char *new_hotlist_max_level_nicks);
 extern void gui_buffer_set_unread (struct t_gui_buffer *buffer);
@@ -284,7 +284,13 @@ gui_hotlist_add_hotlist (struct t_gui_hotlist **hotlist,
 }
 
 /*
- * Adds a buffer to hotlist, with priority.
+ * Adds a buffer to hotlist, with counts for each priority (array with
+ * GUI_HOTLIST_NUM_PRIORITIES integers); the priority of hotlist is the
+ * highest priority with a count > 0.
+ *
+ * Counts of priorities not allowed by the buffer notify level are ignored.
+ * The conditions to add buffer in hotlist are evaluated only once, with the
+ * highest priority.
  *
  * If creation_time is NULL, current time is used.
  *
@@ -293,26 +299,36 @@ gui_hotlist_add_hotlist (struct t_gui_hotlist **hotlist,
  */
 
 struct t_gui_hotlist *
-gui_hotlist_add (struct t_gui_buffer *buffer,
-                 enum t_gui_hotlist_priority priority,
-                 struct timeval *creation_time)
+gui_hotlist_add_count (struct t_gui_buffer *buffer,
+                       int *count_add,
+                       struct timeval *creation_time)
 {
     struct t_gui_hotlist *new_hotlist, *ptr_hotlist;
-    int i, count[GUI_HOTLIST_NUM_PRIORITIES], rc;
+    int i, count[GUI_HOTLIST_NUM_PRIORITIES], count_ok[GUI_HOTLIST_NUM_PRIORITIES];
+    int priority, rc;
     char *value, str_value[32];
 
-    if (!buffer || !gui_add_hotlist)
+    if (!buffer || !count_add || !gui_add_hotlist)
         return NULL;
 
     /* do not add core buffer if upgrading */
     if (weechat_upgrading && (buffer == gui_buffer_search_main ()))
         return NULL;
 
-    if (priority > GUI_HOTLIST_MAX)
-        priority = GUI_HOTLIST_MAX;
-
-    /* check if priority is OK according to buffer notify level value */
-    if (!gui_hotlist_check_buffer_notify (buffer, priority))
+    /*
+     * keep only priorities OK according to buffer notify level value,
+     * and get the highest priority
+     */
+    priority = -1;
+    for (i = 0; i < GUI_HOTLIST_NUM_PRIORITIES; i++)
+    {
+        count_ok[i] = ((count_add[i] > 0)
+                       && gui_hotlist_check_buffer_notify (buffer, i)) ?
+            count_add[i] : 0;
+        if (count_ok[i] > 0)
+            priority = i;
+    }
+    if (priority < 0)
         return NULL;
 
     /* create hashtable if needed (to evaluate conditions) */
@@ -379,9 +395,12 @@ gui_hotlist_add (struct t_gui_buffer *buffer,
     if (ptr_hotlist)
     {
         /* return if priority is greater or equal than the one to add */
-        if (ptr_hotlist->priority >= priority)
+        if ((int)ptr_hotlist->priority >= priority)
         {
-            ptr_hotlist->count[priority]++;
+            for (i = 0; i < GUI_HOTLIST_NUM_PRIORITIES; i++)
+            {
+                ptr_hotlist->count[i] += count_ok[i];
+            }
             gui_hotlist_changed_signal (buffer);
             return ptr_hotlist;
         }
@@ -408,8 +427,10 @@ gui_hotlist_add (struct t_gui_buffer *buffer,
         gettimeofday (&(new_hotlist->creation_time), NULL);
     new_hotlist->buffer = buffer;
     buffer->hotlist = new_hotlist;
-    memcpy (new_hotlist->count, count, sizeof (new_hotlist->count));
-    new_hotlist->count[priority]++;
+    for (i = 0; i < GUI_HOTLIST_NUM_PRIORITIES; i++)
+    {
+        new_hotlist->count[i] = count[i] + count_ok[i];
+    }
     new_hotlist->next_hotlist = NULL;
     new_hotlist->prev_hotlist = NULL;
 
@@ -420,6 +441,31 @@ gui_hotlist_add (struct t_gui_buffer *buffer,
     return new_hotlist;
 }
 
+/*
+ * Adds a buffer to hotlist, with priority.
+ *
+ * If creation_time is NULL, current time is used.
+ *
+ * Returns pointer to hotlist created or changed, NULL if no hotlist was
+ * created/changed.
+ */
+
+struct t_gui_hotlist *
+gui_hotlist_add (struct t_gui_buffer *buffer,
+                 enum t_gui_hotlist_priority priority,
+                 struct timeval *creation_time)
+{
+    int count[GUI_HOTLIST_NUM_PRIORITIES];
+
+    memset (count, 0, sizeof (count));
+
+    if (priority > GUI_HOTLIST_MAX)
+        priority = GUI_HOTLIST_MAX;
+    count[priority] = 1;
+
+    return gui_hotlist_add_count (buffer, count, creation_time);
+}
+
 /*
  * Duplicates a hotlist element.
  *
@@ -58,6 +58,9 @@ extern int gui_add_hotlist;
 
 /* hotlist functions */
 
+extern struct t_gui_hotlist *gui_hotlist_add_count (struct t_gui_buffer *buffer,
+                                                    int *count_add,
+                                                    struct timeval *creation_time);
 extern struct t_gui_hotlist *gui_hotlist_add (struct t_gui_buffer *buffer,
                                               enum t_gui_hotlist_priority priority,
                                               struct timeval *creation_time);
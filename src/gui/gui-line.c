@@ -29,6 +29,7 @@
 #include <time.h>
 
 #include "../core/weechat.h"
+#include "../core/wee-arraylist.h"
 #include "../core/wee-config.h"
 #include "../core/wee-hashtable.h"
 #include "../core/wee-hdata.h"
@@ -988,23 +989,16 @@ gui_line_compute_prefix_max_length (struct t_gui_lines *lines)
 }
 
 /*
- * Adds a line to a "t_gui_lines" structure.
+ * Updates counters of a "t_gui_lines" structure after a line has been
+ * linked in the list.
  */
 
 void
-gui_line_add_to_list (struct t_gui_lines *lines,
-                      struct t_gui_line *line)
+gui_line_lines_update_added (struct t_gui_lines *lines,
+                             struct t_gui_line *line)
 {
     int prefix_length, prefix_is_nick;
 
-    if (lines->last_line)
-        (lines->last_line)->next_line = line;
-    else
-        lines->first_line = line;
-    line->prev_line = lines->last_line;
-    line->next_line = NULL;
-    lines->last_line = line;
-
     /*
      * adjust "prefix_max_length" if this prefix length is > max
      * (only if the line is displayed
@@ -1027,6 +1021,64 @@ gui_line_add_to_list (struct t_gui_lines *lines,
     lines->lines_count++;
 }
 
+/*
+ * Adds a line to a "t_gui_lines" structure.
+ */
+
+void
+gui_line_add_to_list (struct t_gui_lines *lines,
+                      struct t_gui_line *line)
+{
+    if (lines->last_line)
+        (lines->last_line)->next_line = line;
+    else
+        lines->first_line = line;
+    line->prev_line = lines->last_line;
+    line->next_line = NULL;
+    lines->last_line = line;
+
+    gui_line_lines_update_added (lines, line);
+}
+
+/*
+ * Inserts a line in a "t_gui_lines" structure, sorted by date: the line is
+ * inserted after the last line with a date lower or equal to the date of
+ * line.
+ *
+ * Lines are searched from the end, so this is fast if the line is recent.
+ */
+
+void
+gui_line_insert_in_list (struct t_gui_lines *lines,
+                         struct t_gui_line *line)
+{
+    struct t_gui_line *ptr_line, *ptr_next_line;
+
+    ptr_line = lines->last_line;
+    ptr_next_line = NULL;
+    while (ptr_line && (ptr_line->data->date > line->data->date))
+    {
+        ptr_next_line = ptr_line;
+        ptr_line = ptr_line->prev_line;
+    }
+
+    if (!ptr_next_line)
+    {
+        gui_line_add_to_list (lines, line);
+        return;
+    }
+
+    line->prev_line = ptr_line;
+    line->next_line = ptr_next_line;
+    if (ptr_line)
+        ptr_line->next_line = line;
+    else
+        lines->first_line = line;
+    ptr_next_line->prev_line = line;
+
+    gui_line_lines_update_added (lines, line);
+}
+
 /*
  * Frees data in a line.
  */
@@ -1146,6 +1198,24 @@ gui_line_mixed_add (struct t_gui_lines *lines,
     }
 }
 
+/*
+ * Inserts line in mixed lines for a buffer, sorted by date.
+ */
+
+void
+gui_line_mixed_insert (struct t_gui_lines *lines,
+                       struct t_gui_line_data *line_data)
+{
+    struct t_gui_line *new_line;
+
+    new_line = malloc (sizeof (*new_line));
+    if (new_line)
+    {
+        new_line->data = line_data;
+        gui_line_insert_in_list (lines, new_line);
+    }
+}
+
 /*
  * Frees all mixed lines matching a buffer.
  */
@@ -1202,10 +1272,25 @@ void
 gui_line_free (struct t_gui_buffer *buffer, struct t_gui_line *line)
 {
     struct t_gui_line *ptr_line;
+    int *ptr_index;
 
     if (!buffer || !line)
         return;
 
+    /*
+     * remove line from lines added in current batch (replaced by NULL, so
+     * that the index of other lines does not change)
+     */
+    if (buffer->batch_lines_index)
+    {
+        ptr_index = (int *)hashtable_get (buffer->batch_lines_index, line);
+        if (ptr_index)
+        {
+            buffer->batch_lines->data[*ptr_index] = NULL;
+            hashtable_remove (buffer->batch_lines_index, line);
+        }
+    }
+
     /* first remove mixed line if it exists */
     if (buffer->mixed_lines)
     {
@@ -1587,7 +1672,7 @@ gui_line_add (struct t_gui_line *line)
 {
     struct t_gui_window *ptr_win;
     char *message_for_signal;
-    int lines_removed;
+    int lines_removed, batch, index;
     time_t current_time;
 
     /*
@@ -1610,8 +1695,15 @@ gui_line_add (struct t_gui_line *line)
         lines_removed++;
     }
 
-    /* add line to lines list */
-    gui_line_add_to_list (line->data->buffer->own_lines, line);
+    /*
+     * add line to lines list (in a batch, lines are sorted by date and the
+     * hotlist is updated only at the end of batch)
+     */
+    batch = (line->data->buffer->batch > 0);
+    if (batch)
+        gui_line_insert_in_list (line->data->buffer->own_lines, line);
+    else
+        gui_line_add_to_list (line->data->buffer->own_lines, line);
 
     /* update hotlist and/or send signals for line */
     if (line->data->displayed)
@@ -1619,8 +1711,11 @@ gui_line_add (struct t_gui_line *line)
         if ((line->data->notify_level >= GUI_HOTLIST_MIN)
             && line->data->highlight)
         {
-            (void) gui_hotlist_add (line->data->buffer,
-                                    GUI_HOTLIST_HIGHLIGHT, NULL);
+            if (!batch)
+            {
+                (void) gui_hotlist_add (line->data->buffer,
+                                        GUI_HOTLIST_HIGHLIGHT, NULL);
+            }
             if (!weechat_upgrading)
             {
                 message_for_signal = gui_chat_build_string_prefix_message (line);
@@ -1647,7 +1742,7 @@ gui_line_add (struct t_gui_line *line)
                     free (message_for_signal);
                 }
             }
-            if (line->data->notify_level >= GUI_HOTLIST_MIN)
+            if (!batch && (line->data->notify_level >= GUI_HOTLIST_MIN))
             {
                 (void) gui_hotlist_add (line->data->buffer,
                                         line->data->notify_level, NULL);
@@ -1664,7 +1759,26 @@ gui_line_add (struct t_gui_line *line)
     /* add mixed line, if buffer is attached to at least one other buffer */
     if (line->data->buffer->mixed_lines)
     {
-        gui_line_mixed_add (line->data->buffer->mixed_lines, line->data);
+        if (batch)
+            gui_line_mixed_insert (line->data->buffer->mixed_lines, line->data);
+        else
+            gui_line_mixed_add (line->data->buffer->mixed_lines, line->data);
+    }
+
+    /*
+     * in a batch, the line is sent with all other lines of batch in signal
+     * "buffer_lines_added" and the buffer is fully refreshed at the end
+     * of batch
+     */
+    if (batch)
+    {
+        index = arraylist_add (line->data->buffer->batch_lines, line);
+        if (index >= 0)
+        {
+            hashtable_set (line->data->buffer->batch_lines_index,
+                           line, &index);
+        }
+        return;
     }
 
     /*
@@ -41,6 +41,9 @@ WEECHAT_PLUGIN_PRIORITY(15000);
 
 #define CHARSET_CONFIG_NAME "charset"
 
+/* max number of names in cache of charsets (decode/encode) */
+#define CHARSET_CACHE_MAX 4096
+
 struct t_weechat_plugin *weechat_charset_plugin = NULL;
 #define weechat_plugin weechat_charset_plugin
 
@@ -53,6 +56,38 @@ struct t_config_section *charset_config_section_encode = NULL;
 char *charset_terminal = NULL;
 char *charset_internal = NULL;
 
+struct t_hashtable *charset_cache_decode = NULL; /* name -> decode charset  */
+struct t_hashtable *charset_cache_encode = NULL; /* name -> encode charset  */
+
+
+/*
+ * Clears cache of charsets (called when charset options are changed).
+ */
+
+void
+charset_cache_clear ()
+{
+    if (charset_cache_decode)
+        weechat_hashtable_remove_all (charset_cache_decode);
+    if (charset_cache_encode)
+        weechat_hashtable_remove_all (charset_cache_encode);
+}
+
+/*
+ * Callback for changes on a charset option.
+ */
+
+void
+charset_config_change_cb (const void *pointer, void *data,
+                          struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    charset_cache_clear ();
+}
 
 /*
  * Reloads charset configuration file.
@@ -70,6 +105,8 @@ charset_config_reload (const void *pointer, void *data,
     weechat_config_section_free_options (charset_config_section_decode);
     weechat_config_section_free_options (charset_config_section_encode);
 
+    charset_cache_clear ();
+
     return weechat_config_reload (config_file);
 }
 
@@ -166,7 +203,7 @@ charset_config_create_option (const void *pointer, void *data,
                         option_name, "string", NULL,
                         NULL, 0, 0, "", value, 0,
                         (section == charset_config_section_decode) ? &charset_check_charset_decode_cb : NULL, NULL, NULL,
-                        NULL, NULL, NULL,
+                        &charset_config_change_cb, NULL, NULL,
                         NULL, NULL, NULL);
                     rc = (ptr_option) ?
                         WEECHAT_CONFIG_OPTION_SET_OK_SAME_VALUE : WEECHAT_CONFIG_OPTION_SET_ERROR;
@@ -184,10 +221,37 @@ charset_config_create_option (const void *pointer, void *data,
                         weechat_prefix ("error"), CHARSET_PLUGIN_NAME,
                         option_name, value);
     }
+    else
+    {
+        charset_cache_clear ();
+    }
 
     return rc;
 }
 
+/*
+ * Deletes a charset.
+ */
+
+int
+charset_config_delete_option (const void *pointer, void *data,
+                              struct t_config_file *config_file,
+                              struct t_config_section *section,
+                              struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) config_file;
+    (void) section;
+
+    weechat_config_option_free (option);
+
+    charset_cache_clear ();
+
+    return WEECHAT_CONFIG_OPTION_UNSET_OK_REMOVED;
+}
+
 /*
  * Initializes charset configuration file.
  *
@@ -231,7 +295,7 @@ charset_config_init ()
                                  charset_internal) != 0)) ?
         charset_terminal : "iso-8859-1", NULL, 0,
         &charset_check_charset_decode_cb, NULL, NULL,
-        NULL, NULL, NULL,
+        &charset_config_change_cb, NULL, NULL,
         NULL, NULL, NULL);
     charset_default_encode = weechat_config_new_option (
         charset_config_file, ptr_section,
@@ -240,7 +304,9 @@ charset_config_init ()
            "(if empty, default is UTF-8 because it is the WeeChat internal "
            "charset)"),
         NULL, 0, 0, "", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &charset_config_change_cb, NULL, NULL,
+        NULL, NULL, NULL);
 
     ptr_section = weechat_config_new_section (
         charset_config_file, "decode",
@@ -249,7 +315,7 @@ charset_config_init ()
         NULL, NULL, NULL,
         NULL, NULL, NULL,
         &charset_config_create_option, NULL, NULL,
-        NULL, NULL, NULL);
+        &charset_config_delete_option, NULL, NULL);
     if (!ptr_section)
     {
         weechat_config_free (charset_config_file);
@@ -266,7 +332,7 @@ charset_config_init ()
         NULL, NULL, NULL,
         NULL, NULL, NULL,
         &charset_config_create_option, NULL, NULL,
-        NULL, NULL, NULL);
+        &charset_config_delete_option, NULL, NULL);
     if (!ptr_section)
     {
         weechat_config_free (charset_config_file);
@@ -378,6 +444,38 @@ charset_get (struct t_config_section *section, const char *name,
     return NULL;
 }
 
+/*
+ * Gets charset for a name, using a cache (the cache is cleared when any
+ * charset option is changed).
+ *
+ * Returns NULL if no charset is defined for this name.
+ */
+
+const char *
+charset_get_cached (struct t_hashtable *cache,
+                    struct t_config_section *section, const char *name,
+                    struct t_config_option *default_charset)
+{
+    const char *charset;
+
+    if (!cache || !name)
+        return charset_get (section, name, default_charset);
+
+    if (weechat_hashtable_has_key (cache, name))
+    {
+        charset = weechat_hashtable_get (cache, name);
+        return (charset && charset[0]) ? charset : NULL;
+    }
+
+    charset = charset_get (section, name, default_charset);
+
+    if (weechat_hashtable_get_integer (cache, "items_count") >= CHARSET_CACHE_MAX)
+        weechat_hashtable_remove_all (cache);
+    weechat_hashtable_set (cache, name, (charset) ? charset : "");
+
+    return charset;
+}
+
 /*
  * Decodes a string with a charset to internal charset (UTF-8).
  */
@@ -394,8 +492,10 @@ charset_decode_cb (const void *pointer, void *data,
     (void) data;
     (void) modifier;
 
-    charset = charset_get (charset_config_section_decode, modifier_data,
-                           charset_default_decode);
+    charset = charset_get_cached (charset_cache_decode,
+                                  charset_config_section_decode,
+                                  modifier_data,
+                                  charset_default_decode);
     if (weechat_charset_plugin->debug)
     {
         weechat_printf (NULL,
@@ -425,8 +525,10 @@ charset_encode_cb (const void *pointer, void *data,
     (void) data;
     (void) modifier;
 
-    charset = charset_get (charset_config_section_encode, modifier_data,
-                           charset_default_encode);
+    charset = charset_get_cached (charset_cache_encode,
+                                  charset_config_section_encode,
+                                  modifier_data,
+                                  charset_default_encode);
     if (weechat_charset_plugin->debug)
     {
         weechat_printf (NULL,
@@ -602,6 +704,15 @@ weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
     if (weechat_charset_plugin->debug >= 1)
         charset_display_charsets ();
 
+    charset_cache_decode = weechat_hashtable_new (256,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  NULL, NULL);
+    charset_cache_encode = weechat_hashtable_new (256,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  NULL, NULL);
+
     if (!charset_config_init ())
         return WEECHAT_RC_ERROR;
 
@@ -641,6 +752,17 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
 
     weechat_config_free (charset_config_file);
 
+    if (charset_cache_decode)
+    {
+        weechat_hashtable_free (charset_cache_decode);
+        charset_cache_decode = NULL;
+    }
+    if (charset_cache_encode)
+    {
+        weechat_hashtable_free (charset_cache_encode);
+        charset_cache_encode = NULL;
+    }
+
     if (charset_terminal)
         free (charset_terminal);
     if (charset_internal)
@@ -0,0 +1,602 @@
+/*
+ * irc-batch.c - batched events (capability "batch") for IRC plugin
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "../weechat-plugin.h"
+#include "irc.h"
+#include "irc-batch.h"
+#include "irc-channel.h"
+#include "irc-protocol.h"
+#include "irc-server.h"
+
+
+/*
+ * Searches for a batch by reference.
+ *
+ * Returns pointer to batch found, NULL if not found.
+ */
+
+struct t_irc_batch *
+irc_batch_search (struct t_irc_server *server, const char *reference)
+{
+    struct t_irc_batch *ptr_batch;
+
+    if (!server || !reference)
+        return NULL;
+
+    for (ptr_batch = server->batches; ptr_batch;
+         ptr_batch = ptr_batch->next_batch)
+    {
+        if (strcmp (ptr_batch->reference, reference) == 0)
+            return ptr_batch;
+    }
+
+    /* batch not found */
+    return NULL;
+}
+
+/*
+ * Checks if a batch type is a playback of history (messages are then
+ * displayed in bulk in the target buffer, sorted by date).
+ *
+ * Returns:
+ *   1: batch type is a playback of history
+ *   0: other batch type
+ */
+
+int
+irc_batch_is_playback (const char *type)
+{
+    if (!type)
+        return 0;
+
+    return ((strcmp (type, "chathistory") == 0)
+            || (strcmp (type, "draft/chathistory") == 0)
+            || (strcmp (type, "znc.in/playback") == 0)) ? 1 : 0;
+}
+
+/*
+ * Compares two messages of a batch: by date then by order of reception.
+ */
+
+int
+irc_batch_message_cmp_cb (void *data, struct t_arraylist *arraylist,
+                          void *pointer1, void *pointer2)
+{
+    struct t_irc_batch_message *message1, *message2;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) arraylist;
+
+    message1 = (struct t_irc_batch_message *)pointer1;
+    message2 = (struct t_irc_batch_message *)pointer2;
+
+    if (message1->date.tv_sec != message2->date.tv_sec)
+        return (message1->date.tv_sec < message2->date.tv_sec) ? -1 : 1;
+    if (message1->date.tv_usec != message2->date.tv_usec)
+        return (message1->date.tv_usec < message2->date.tv_usec) ? -1 : 1;
+    if (message1->index != message2->index)
+        return (message1->index < message2->index) ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Frees a message of a batch.
+ */
+
+void
+irc_batch_message_free (struct t_irc_batch_message *message)
+{
+    if (message->message)
+        free (message->message);
+    if (message->command)
+        free (message->command);
+    if (message->channel)
+        free (message->channel);
+
+    free (message);
+}
+
+/*
+ * Starts a batch.
+ *
+ * Returns pointer to new batch, NULL if error.
+ */
+
+struct t_irc_batch *
+irc_batch_start (struct t_irc_server *server, const char *reference,
+                 const char *parent_ref, const char *type,
+                 const char *parameters)
+{
+    struct t_irc_batch *new_batch;
+
+    if (!server || !reference || !reference[0] || !type || !type[0])
+        return NULL;
+
+    /* a batch reference must be unique */
+    if (irc_batch_search (server, reference))
+        return NULL;
+
+    new_batch = malloc (sizeof (*new_batch));
+    if (!new_batch)
+        return NULL;
+
+    new_batch->messages = weechat_arraylist_new (
+        32, 1, 1,
+        &irc_batch_message_cmp_cb, NULL,
+        NULL, NULL);
+    if (!new_batch->messages)
+    {
+        free (new_batch);
+        return NULL;
+    }
+    new_batch->reference = strdup (reference);
+    new_batch->parent_ref = (parent_ref) ? strdup (parent_ref) : NULL;
+    new_batch->type = strdup (type);
+    new_batch->parameters = (parameters) ? strdup (parameters) : NULL;
+    new_batch->start_time = time (NULL);
+
+    /* add batch to list of batches on server */
+    new_batch->prev_batch = server->last_batch;
+    if (server->last_batch)
+        server->last_batch->next_batch = new_batch;
+    else
+        server->batches = new_batch;
+    server->last_batch = new_batch;
+    new_batch->next_batch = NULL;
+
+    return new_batch;
+}
+
+/*
+ * Removes a batch from list of batches in server (the batch is not freed).
+ */
+
+void
+irc_batch_remove_from_list (struct t_irc_server *server,
+                            struct t_irc_batch *batch)
+{
+    if (batch->prev_batch)
+        (batch->prev_batch)->next_batch = batch->next_batch;
+    if (batch->next_batch)
+        (batch->next_batch)->prev_batch = batch->prev_batch;
+    if (server->batches == batch)
+        server->batches = batch->next_batch;
+    if (server->last_batch == batch)
+        server->last_batch = batch->prev_batch;
+
+    batch->prev_batch = NULL;
+    batch->next_batch = NULL;
+}
+
+/*
+ * Frees data in a batch and the batch itself.
+ */
+
+void
+irc_batch_free_data (struct t_irc_batch *batch)
+{
+    int i, size;
+
+    if (batch->messages)
+    {
+        size = weechat_arraylist_size (batch->messages);
+        for (i = 0; i < size; i++)
+        {
+            irc_batch_message_free (
+                (struct t_irc_batch_message *)weechat_arraylist_get (
+                    batch->messages, i));
+        }
+        weechat_arraylist_free (batch->messages);
+    }
+    if (batch->reference)
+        free (batch->reference);
+    if (batch->parent_ref)
+        free (batch->parent_ref);
+    if (batch->type)
+        free (batch->type);
+    if (batch->parameters)
+        free (batch->parameters);
+
+    free (batch);
+}
+
+/*
+ * Processes messages received in a batch, sorted by date (the batch must
+ * have been removed from list of batches in server).
+ *
+ * For a playback of history ("chathistory" or "znc.in/playback"), the target
+ * buffer is in "batch" mode while messages are displayed: lines are inserted
+ * sorted by date, the hotlist is updated once and lines are sent in a single
+ * signal at the end.
+ */
+
+void
+irc_batch_process (struct t_irc_server *server, struct t_irc_batch *batch)
+{
+    struct t_irc_batch_message *ptr_message;
+    struct t_irc_channel *ptr_channel;
+    struct t_gui_buffer *ptr_buffer;
+    char *target, *pos;
+    int i, size;
+
+    size = weechat_arraylist_size (batch->messages);
+    if (size == 0)
+        return;
+
+    target = NULL;
+    ptr_buffer = NULL;
+    if (irc_batch_is_playback (batch->type) && batch->parameters)
+    {
+        target = strdup (batch->parameters);
+        if (target)
+        {
+            pos = strchr (target, ' ');
+            if (pos)
+                pos[0] = '\0';
+        }
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        if (target && !ptr_buffer)
+        {
+            /*
+             * the buffer can be created by first message displayed
+             * (for example a private buffer)
+             */
+            ptr_channel = irc_channel_search (server, target);
+            if (ptr_channel && ptr_channel->buffer)
+            {
+                ptr_buffer = ptr_channel->buffer;
+                weechat_buffer_batch_start (ptr_buffer);
+            }
+        }
+        ptr_message = (struct t_irc_batch_message *)weechat_arraylist_get (
+            batch->messages, i);
+        irc_protocol_recv_command (server,
+                                   ptr_message->message,
+                                   ptr_message->command,
+                                   ptr_message->channel);
+    }
+
+    if (ptr_buffer)
+    {
+        /* end batch only if buffer was not closed by a message */
+        ptr_channel = irc_channel_search (server, target);
+        if (ptr_channel && (ptr_channel->buffer == ptr_buffer))
+            weechat_buffer_batch_end (ptr_buffer);
+    }
+
+    if (target)
+        free (target);
+}
+
+/*
+ * Ends a batch: messages are processed (or added to parent batch if the
+ * batch is nested in another batch), then the batch is freed.
+ */
+
+void
+irc_batch_end (struct t_irc_server *server, const char *reference)
+{
+    struct t_irc_batch *ptr_batch, *ptr_parent_batch;
+    struct t_irc_batch_message *ptr_message;
+    int i, size, parent_size;
+
+    ptr_batch = irc_batch_search (server, reference);
+    if (!ptr_batch)
+        return;
+
+    irc_batch_remove_from_list (server, ptr_batch);
+
+    ptr_parent_batch = irc_batch_search (server, ptr_batch->parent_ref);
+    if (ptr_parent_batch)
+    {
+        /* move messages to parent batch */
+        size = weechat_arraylist_size (ptr_batch->messages);
+        parent_size = weechat_arraylist_size (ptr_parent_batch->messages);
+        for (i = 0; i < size; i++)
+        {
+            ptr_message = (struct t_irc_batch_message *)weechat_arraylist_get (
+                ptr_batch->messages, i);
+            ptr_message->index = parent_size + i;
+            weechat_arraylist_add (ptr_parent_batch->messages, ptr_message);
+        }
+        /* messages now belong to parent batch: do not free them */
+        weechat_arraylist_clear (ptr_batch->messages);
+    }
+    else
+    {
+        irc_batch_process (server, ptr_batch);
+    }
+
+    irc_batch_free_data (ptr_batch);
+}
+
+/*
+ * Checks if a received message starts/ends a batch or is part of a batch.
+ *
+ * A message "BATCH" starts or ends a batch and is not added to a batch.
+ * A message with tag "batch" referencing a batch in progress is added to the
+ * batch and will be processed at the end of batch.
+ *
+ * Returns:
+ *   1: message added to a batch (it must not be processed now)
+ *   0: message not added to a batch
+ */
+
+int
+irc_batch_add_message (struct t_irc_server *server, const char *irc_message,
+                       const char *command, const char *channel,
+                       const char *arguments)
+{
+    struct t_irc_protocol_tag tags_stack[IRC_PROTOCOL_TAGS_MAX];
+    struct t_irc_protocol_tag *tags;
+    const struct t_irc_protocol_tag *ptr_tag;
+    struct t_irc_batch *ptr_batch;
+    struct t_irc_batch_message *new_message, *ptr_last_message;
+    char *reference, **argv, **argv_eol, *pos_space;
+    int rc, batch_command, num_tags, argc, size;
+
+    if (!server || !irc_message || !command)
+        return 0;
+
+    batch_command = (weechat_strcasecmp (command, "batch") == 0);
+
+    /* quick exit if no batch in progress or if message has no tags */
+    if (!batch_command
+        && (!server->batches || (irc_message[0] != '@')))
+    {
+        return 0;
+    }
+
+    rc = 0;
+    tags = tags_stack;
+    num_tags = 0;
+    reference = NULL;
+
+    pos_space = (irc_message[0] == '@') ? strchr (irc_message, ' ') : NULL;
+
+    /* get reference of batch in tags */
+    if (pos_space)
+    {
+        num_tags = irc_protocol_tags_split (
+            irc_message + 1, pos_space - (irc_message + 1),
+            tags_stack, IRC_PROTOCOL_TAGS_MAX);
+        if (num_tags > IRC_PROTOCOL_TAGS_MAX)
+        {
+            tags = malloc (num_tags * sizeof (tags[0]));
+            if (tags)
+            {
+                irc_protocol_tags_split (
+                    irc_message + 1, pos_space - (irc_message + 1),
+                    tags, num_tags);
+            }
+            else
+            {
+                tags = tags_stack;
+                num_tags = IRC_PROTOCOL_TAGS_MAX;
+            }
+        }
+        ptr_tag = irc_protocol_tags_search (tags, num_tags, "batch");
+        if (ptr_tag && ptr_tag->value && (ptr_tag->value_size > 0))
+            reference = weechat_strndup (ptr_tag->value, ptr_tag->value_size);
+    }
+
+    if (batch_command)
+    {
+        argv = weechat_string_split (arguments, " ", NULL,
+                                     WEECHAT_STRING_SPLIT_STRIP_LEFT
+                                     | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                                     | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+                                     0, &argc);
+        argv_eol = weechat_string_split (arguments, " ", NULL,
+                                         WEECHAT_STRING_SPLIT_STRIP_LEFT
+                                         | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                                         | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS
+                                         | WEECHAT_STRING_SPLIT_KEEP_EOL,
+                                         0, NULL);
+        if (argv && argv_eol)
+        {
+            if ((argc >= 2) && (argv[0][0] == '+'))
+            {
+                irc_batch_start (
+                    server,
+                    argv[0] + 1,
+                    (irc_batch_search (server, reference)) ? reference : NULL,
+                    argv[1],
+                    (argc > 2) ? argv_eol[2] : NULL);
+            }
+            else if ((argc >= 1) && (argv[0][0] == '-'))
+            {
+                irc_batch_end (server, argv[0] + 1);
+            }
+        }
+        if (argv)
+            weechat_string_free_split (argv);
+        if (argv_eol)
+            weechat_string_free_split (argv_eol);
+        goto end;
+    }
+
+    ptr_batch = irc_batch_search (server, reference);
+    if (!ptr_batch)
+        goto end;
+
+    new_message = malloc (sizeof (*new_message));
+    if (!new_message)
+        goto end;
+
+    new_message->message = strdup (irc_message);
+    new_message->command = strdup (command);
+    new_message->channel = (channel) ? strdup (channel) : NULL;
+    size = weechat_arraylist_size (ptr_batch->messages);
+    new_message->index = size;
+    ptr_tag = irc_protocol_tags_search (tags, num_tags, "time");
+    if (!ptr_tag
+        || !irc_protocol_parse_time_tv (ptr_tag->value, ptr_tag->value_size,
+                                        &new_message->date))
+    {
+        /* no date: use date of most recent message in batch */
+        ptr_last_message = NULL;
+        if (size > 0)
+        {
+            ptr_last_message = (struct t_irc_batch_message *)weechat_arraylist_get (
+                ptr_batch->messages, size - 1);
+        }
+        new_message->date.tv_sec = (ptr_last_message) ?
+            ptr_last_message->date.tv_sec : 0;
+        new_message->date.tv_usec = (ptr_last_message) ?
+            ptr_last_message->date.tv_usec : 0;
+    }
+    weechat_arraylist_add (ptr_batch->messages, new_message);
+
+    rc = 1;
+
+end:
+    if (tags != tags_stack)
+        free (tags);
+    if (reference)
+        free (reference);
+
+    return rc;
+}
+
+/*
+ * Ends batches started for more than IRC_BATCH_TIMEOUT seconds (the server
+ * did not end them): messages received in these batches are processed.
+ */
+
+void
+irc_batch_end_expired (struct t_irc_server *server, time_t current_time)
+{
+    struct t_irc_batch *ptr_batch;
+
+    if (!server)
+        return;
+
+    ptr_batch = server->batches;
+    while (ptr_batch)
+    {
+        if (current_time >= ptr_batch->start_time + IRC_BATCH_TIMEOUT)
+        {
+            irc_batch_end (server, ptr_batch->reference);
+            /* list of batches has changed: restart from first batch */
+            ptr_batch = server->batches;
+        }
+        else
+        {
+            ptr_batch = ptr_batch->next_batch;
+        }
+    }
+}
+
+/*
+ * Frees a batch (messages received in batch are NOT processed).
+ */
+
+void
+irc_batch_free (struct t_irc_server *server, struct t_irc_batch *batch)
+{
+    if (!server || !batch)
+        return;
+
+    irc_batch_remove_from_list (server, batch);
+    irc_batch_free_data (batch);
+}
+
+/*
+ * Frees all batches of a server.
+ */
+
+void
+irc_batch_free_all (struct t_irc_server *server)
+{
+    while (server->batches)
+    {
+        irc_batch_free (server, server->batches);
+    }
+}
+
+/*
+ * Returns hdata for batch.
+ */
+
+struct t_hdata *
+irc_batch_hdata_batch_cb (const void *pointer, void *data,
+                          const char *hdata_name)
+{
+    struct t_hdata *hdata;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+
+    hdata = weechat_hdata_new (hdata_name, "prev_batch", "next_batch",
+                               0, 0, NULL, NULL);
+    if (hdata)
+    {
+        WEECHAT_HDATA_VAR(struct t_irc_batch, reference, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, parent_ref, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, type, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, parameters, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, start_time, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, messages, POINTER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, prev_batch, POINTER, 0, NULL, hdata_name);
+        WEECHAT_HDATA_VAR(struct t_irc_batch, next_batch, POINTER, 0, NULL, hdata_name);
+    }
+    return hdata;
+}
+
+/*
+ * Prints batch infos in WeeChat log file (usually for crash dump).
+ */
+
+void
+irc_batch_print_log (struct t_irc_server *server)
+{
+    struct t_irc_batch *ptr_batch;
+
+    for (ptr_batch = server->batches; ptr_batch;
+         ptr_batch = ptr_batch->next_batch)
+    {
+        weechat_log_printf ("");
+        weechat_log_printf ("  => batch (addr:0x%lx):", ptr_batch);
+        weechat_log_printf ("       reference . . . . . : '%s'",  ptr_batch->reference);
+        weechat_log_printf ("       parent_ref. . . . . : '%s'",  ptr_batch->parent_ref);
+        weechat_log_printf ("       type. . . . . . . . : '%s'",  ptr_batch->type);
+        weechat_log_printf ("       parameters. . . . . : '%s'",  ptr_batch->parameters);
+        weechat_log_printf ("       start_time. . . . . : %lld",  (long long)ptr_batch->start_time);
+        weechat_log_printf ("       messages. . . . . . : 0x%lx (%d)",
+                            ptr_batch->messages,
+                            weechat_arraylist_size (ptr_batch->messages));
+        weechat_log_printf ("       prev_batch. . . . . : 0x%lx", ptr_batch->prev_batch);
+        weechat_log_printf ("       next_batch. . . . . : 0x%lx", ptr_batch->next_batch);
+    }
+}
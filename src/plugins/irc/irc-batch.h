@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_IRC_BATCH_H
+#define WEECHAT_PLUGIN_IRC_BATCH_H
+
+#include <time.h>
+#include <sys/time.h>
+
+/* batch not ended after this delay (in seconds) is ended by WeeChat */
+#define IRC_BATCH_TIMEOUT 60
+
+struct t_irc_server;
+
+struct t_irc_batch_message
+{
+    char *message;                     /* IRC message (with tags)           */
+    char *command;                     /* IRC command                       */
+    char *channel;                     /* channel (can be NULL)             */
+    struct timeval date;               /* date of message (tag "time")      */
+    int index;                         /* index (to keep order of messages  */
+                                       /* with same date)                   */
+};
+
+struct t_irc_batch
+{
+    char *reference;                   /* batch reference                   */
+    char *parent_ref;                  /* ref of parent batch (can be NULL) */
+    char *type;                        /* batch type                        */
+    char *parameters;                  /* batch parameters (can be NULL)    */
+    time_t start_time;                 /* time of batch start               */
+    struct t_arraylist *messages;      /* messages received in batch        */
+    struct t_irc_batch *prev_batch;    /* link to previous batch            */
+    struct t_irc_batch *next_batch;    /* link to next batch                */
+};
+
+extern struct t_irc_batch *irc_batch_search (struct t_irc_server *server,
+                                             const char *reference);
+extern int irc_batch_is_playback (const char *type);
+extern struct t_irc_batch *irc_batch_start (struct t_irc_server *server,
+                                            const char *reference,
+                                            const char *parent_ref,
+                                            const char *type,
+                                            const char *parameters);
+extern void irc_batch_end (struct t_irc_server *server,
+                           const char *reference);
+extern int irc_batch_add_message (struct t_irc_server *server,
+                                  const char *irc_message,
+                                  const char *command,
+                                  const char *channel,
+                                  const char *arguments);
+extern void irc_batch_end_expired (struct t_irc_server *server,
+                                   time_t current_time);
+extern void irc_batch_free (struct t_irc_server *server,
+                            struct t_irc_batch *batch);
+extern void irc_batch_free_all (struct t_irc_server *server);
+extern struct t_hdata *irc_batch_hdata_batch_cb (const void *pointer,
+                                                 void *data,
+                                                 const char *hdata_name);
+extern void irc_batch_print_log (struct t_irc_server *server);
+
+#endif /* WEECHAT_PLUGIN_IRC_BATCH_H */
@@ -166,16 +166,110 @@ irc_channel_search (struct t_irc_server *server, const char *channel_name)
 {
     struct t_irc_channel *ptr_channel;
 
+    char *name_lower;
+
     if (!server || !channel_name)
         return NULL;
 
+    name_lower = irc_server_string_tolower (server, channel_name);
+    if (!name_lower)
+        return NULL;
+
+    ptr_channel = weechat_hashtable_get (server->channels_hashtable,
+                                         name_lower);
+
+    free (name_lower);
+
+    return ptr_channel;
+}
+
+/*
+ * Adds a channel in hashtable of channels (key is the channel name converted
+ * to lower case using casemapping of server).
+ */
+
+void
+irc_channel_hashtable_add (struct t_irc_server *server,
+                           struct t_irc_channel *channel)
+{
+    char *name_lower;
+
+    if (!server || !channel || !channel->name)
+        return;
+
+    name_lower = irc_server_string_tolower (server, channel->name);
+    if (name_lower)
+    {
+        weechat_hashtable_set (server->channels_hashtable,
+                               name_lower, channel);
+        free (name_lower);
+    }
+}
+
+/*
+ * Removes a channel from hashtable of channels.
+ */
+
+void
+irc_channel_hashtable_remove (struct t_irc_server *server,
+                              struct t_irc_channel *channel)
+{
+    char *name_lower;
+
+    if (!server || !channel || !channel->name)
+        return;
+
+    name_lower = irc_server_string_tolower (server, channel->name);
+    if (name_lower)
+    {
+        if (weechat_hashtable_get (server->channels_hashtable,
+                                   name_lower) == channel)
+        {
+            weechat_hashtable_remove (server->channels_hashtable, name_lower);
+        }
+        free (name_lower);
+    }
+}
+
+/*
+ * Rebuilds hashtables of channels and nicks for a server (called when the
+ * casemapping of server has changed, so that all keys are computed again).
+ */
+
+void
+irc_channel_rebuild_hashtables (struct t_irc_server *server)
+{
+    struct t_irc_channel *ptr_channel;
+    struct t_irc_nick *ptr_nick;
+    int i;
+
+    if (!server)
+        return;
+
+    weechat_hashtable_remove_all (server->channels_hashtable);
+
     for (ptr_channel = server->channels; ptr_channel;
          ptr_channel = ptr_channel->next_channel)
     {
-        if (irc_server_strcasecmp (server, ptr_channel->name, channel_name) == 0)
-            return ptr_channel;
+        irc_channel_hashtable_add (server, ptr_channel);
+        weechat_hashtable_remove_all (ptr_channel->nicks_hashtable);
+        for (ptr_nick = ptr_channel->nicks; ptr_nick;
+             ptr_nick = ptr_nick->next_nick)
+        {
+            irc_nick_hashtable_add (server, ptr_channel, ptr_nick);
+        }
+        for (i = 0; i < 2; i++)
+        {
+            irc_channel_nick_speaking_list_rehash (
+                server,
+                ptr_channel->nicks_speaking[i],
+                ptr_channel->nicks_speaking_hashtable[i]);
+        }
+        irc_channel_nick_speaking_list_rehash (
+            server,
+            ptr_channel->nicks_speaking_time,
+            ptr_channel->nicks_speaking_time_hashtable);
     }
-    return NULL;
 }
 
 /*
@@ -446,6 +540,7 @@ irc_channel_new (struct t_irc_server *server, int channel_type,
     struct t_irc_channel *new_channel;
     struct t_gui_buffer *ptr_buffer;
     const char *ptr_chanmode;
+    int i;
 
     /* create buffer for channel (or use existing one) */
     ptr_buffer = irc_channel_create_buffer (server, channel_type,
@@ -495,10 +590,21 @@ irc_channel_new (struct t_irc_server *server, int channel_type,
     new_channel->nicks_count = 0;
     new_channel->nicks = NULL;
     new_channel->last_nick = NULL;
-    new_channel->nicks_speaking[0] = NULL;
-    new_channel->nicks_speaking[1] = NULL;
+    new_channel->nicks_hashtable = weechat_hashtable_new (
+        32,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_POINTER,
+        NULL, NULL);
+    for (i = 0; i < 2; i++)
+    {
+        new_channel->nicks_speaking[i] = NULL;
+        new_channel->last_nick_speaking[i] = NULL;
+        new_channel->nicks_speaking_count[i] = 0;
+        new_channel->nicks_speaking_hashtable[i] = NULL;
+    }
     new_channel->nicks_speaking_time = NULL;
     new_channel->last_nick_speaking_time = NULL;
+    new_channel->nicks_speaking_time_hashtable = NULL;
     new_channel->modelists = NULL;
     new_channel->last_modelist = NULL;
     for (ptr_chanmode = irc_server_get_chanmodes (server); ptr_chanmode[0];
@@ -519,6 +625,7 @@ irc_channel_new (struct t_irc_server *server, int channel_type,
     else
         server->channels = new_channel;
     server->last_channel = new_channel;
+    irc_channel_hashtable_add (server, new_channel);
 
     (void) weechat_hook_signal_send (
         (channel_type == IRC_CHANNEL_TYPE_CHANNEL) ?
@@ -800,6 +907,82 @@ irc_channel_check_whox (struct t_irc_server *server,
     }
 }
 
+/*
+ * Fetches history of a channel with command CHATHISTORY (if capability
+ * "draft/chathistory" is enabled).
+ *
+ * If the channel buffer already has lines, only messages received after the
+ * last line are requested, otherwise the latest messages are requested.
+ *
+ * Messages are received in a batch of type "chathistory", see irc-batch.c.
+ */
+
+void
+irc_channel_fetch_history (struct t_irc_server *server,
+                           struct t_irc_channel *channel)
+{
+    struct t_hdata *hdata_line;
+    void *own_lines, *line, *line_data;
+    time_t date;
+    struct tm *date_tm;
+    const char *ptr_max;
+    char str_from[128], *error;
+    long number;
+    int limit;
+
+    if ((channel->type != IRC_CHANNEL_TYPE_CHANNEL)
+        || !weechat_hashtable_has_key (server->cap_list, "draft/chathistory"))
+        return;
+
+    limit = IRC_SERVER_OPTION_INTEGER(server,
+                                      IRC_SERVER_OPTION_CHATHISTORY_LIMIT);
+    if (limit <= 0)
+        return;
+
+    /* the server may allow less messages than the limit */
+    ptr_max = irc_server_get_isupport_value (server, "CHATHISTORY");
+    if (ptr_max)
+    {
+        error = NULL;
+        number = strtol (ptr_max, &error, 10);
+        if (error && !error[0] && (number > 0) && (number < limit))
+            limit = number;
+    }
+
+    /* date of last line in buffer */
+    date = 0;
+    own_lines = weechat_hdata_pointer (weechat_hdata_get ("buffer"),
+                                       channel->buffer, "own_lines");
+    if (own_lines)
+    {
+        hdata_line = weechat_hdata_get ("line");
+        line = weechat_hdata_pointer (weechat_hdata_get ("lines"),
+                                      own_lines, "last_line");
+        line_data = (line) ?
+            weechat_hdata_pointer (hdata_line, line, "data") : NULL;
+        if (line_data)
+        {
+            date = weechat_hdata_time (weechat_hdata_get ("line_data"),
+                                       line_data, "date");
+        }
+    }
+
+    snprintf (str_from, sizeof (str_from), "*");
+    if (date > 0)
+    {
+        date_tm = gmtime (&date);
+        if (date_tm)
+        {
+            strftime (str_from, sizeof (str_from),
+                      "timestamp=%Y-%m-%dT%H:%M:%S.999Z", date_tm);
+        }
+    }
+
+    irc_server_sendf (server, IRC_SERVER_SEND_OUTQ_PRIO_LOW, NULL,
+                      "CHATHISTORY LATEST %s %s %d",
+                      channel->name, str_from, limit);
+}
+
 /*
  * Sets/unsets away status for a channel.
  */
@@ -819,43 +1002,356 @@ irc_channel_set_away (struct t_irc_server *server,
     }
 }
 
+/*
+ * Searches for a nick speaking in a list, using the hashtable of the list
+ * (key is the nick in lower case).
+ *
+ * Returns pointer to nick speaking, NULL if not found.
+ */
+
+struct t_irc_channel_speaking *
+irc_channel_nick_speaking_search_hashtable (struct t_irc_server *server,
+                                            struct t_hashtable *hashtable,
+                                            const char *nick_name)
+{
+    struct t_irc_channel_speaking *ptr_nick;
+    char *nick_lower;
+
+    if (!hashtable || !nick_name)
+        return NULL;
+
+    nick_lower = irc_server_string_tolower (server, nick_name);
+    if (!nick_lower)
+        return NULL;
+
+    ptr_nick = weechat_hashtable_get (hashtable, nick_lower);
+
+    free (nick_lower);
+
+    return ptr_nick;
+}
+
+/*
+ * Adds a nick speaking in a list (at the end if position_end is 1, otherwise
+ * at beginning) and in the hashtable of the list.
+ *
+ * Returns pointer to new nick speaking, NULL if error.
+ */
+
+struct t_irc_channel_speaking *
+irc_channel_nick_speaking_list_add (struct t_irc_server *server,
+                                    struct t_irc_channel_speaking **nicks,
+                                    struct t_irc_channel_speaking **last_nick,
+                                    struct t_hashtable *hashtable,
+                                    const char *nick_name,
+                                    time_t time_last_message,
+                                    int position_end)
+{
+    struct t_irc_channel_speaking *new_nick;
+
+    new_nick = malloc (sizeof (*new_nick));
+    if (!new_nick)
+        return NULL;
+
+    new_nick->nick = strdup (nick_name);
+    new_nick->nick_lower = irc_server_string_tolower (server, nick_name);
+    if (!new_nick->nick || !new_nick->nick_lower)
+    {
+        if (new_nick->nick)
+            free (new_nick->nick);
+        if (new_nick->nick_lower)
+            free (new_nick->nick_lower);
+        free (new_nick);
+        return NULL;
+    }
+    new_nick->time_last_message = time_last_message;
+
+    if (position_end)
+    {
+        new_nick->prev_nick = *last_nick;
+        new_nick->next_nick = NULL;
+        if (*last_nick)
+            (*last_nick)->next_nick = new_nick;
+        else
+            *nicks = new_nick;
+        *last_nick = new_nick;
+    }
+    else
+    {
+        new_nick->prev_nick = NULL;
+        new_nick->next_nick = *nicks;
+        if (*nicks)
+            (*nicks)->prev_nick = new_nick;
+        else
+            *last_nick = new_nick;
+        *nicks = new_nick;
+    }
+
+    weechat_hashtable_set (hashtable, new_nick->nick_lower, new_nick);
+
+    return new_nick;
+}
+
+/*
+ * Moves a nick speaking at the end of list (if position_end is 1) or at
+ * beginning of list.
+ */
+
+void
+irc_channel_nick_speaking_list_move (struct t_irc_channel_speaking **nicks,
+                                     struct t_irc_channel_speaking **last_nick,
+                                     struct t_irc_channel_speaking *nick_speaking,
+                                     int position_end)
+{
+    if ((position_end && (*last_nick == nick_speaking))
+        || (!position_end && (*nicks == nick_speaking)))
+        return;
+
+    /* remove nick from list */
+    if (nick_speaking->prev_nick)
+        (nick_speaking->prev_nick)->next_nick = nick_speaking->next_nick;
+    if (nick_speaking->next_nick)
+        (nick_speaking->next_nick)->prev_nick = nick_speaking->prev_nick;
+    if (*nicks == nick_speaking)
+        *nicks = nick_speaking->next_nick;
+    if (*last_nick == nick_speaking)
+        *last_nick = nick_speaking->prev_nick;
+
+    /* insert nick at new position */
+    if (position_end)
+    {
+        nick_speaking->prev_nick = *last_nick;
+        nick_speaking->next_nick = NULL;
+        if (*last_nick)
+            (*last_nick)->next_nick = nick_speaking;
+        else
+            *nicks = nick_speaking;
+        *last_nick = nick_speaking;
+    }
+    else
+    {
+        nick_speaking->prev_nick = NULL;
+        nick_speaking->next_nick = *nicks;
+        if (*nicks)
+            (*nicks)->prev_nick = nick_speaking;
+        else
+            *last_nick = nick_speaking;
+        *nicks = nick_speaking;
+    }
+}
+
+/*
+ * Frees a nick speaking and removes it from list and hashtable.
+ */
+
+void
+irc_channel_nick_speaking_list_free (struct t_irc_channel_speaking **nicks,
+                                     struct t_irc_channel_speaking **last_nick,
+                                     struct t_hashtable *hashtable,
+                                     struct t_irc_channel_speaking *nick_speaking)
+{
+    /* remove nick from hashtable */
+    if (hashtable
+        && (weechat_hashtable_get (hashtable,
+                                   nick_speaking->nick_lower) == nick_speaking))
+    {
+        weechat_hashtable_remove (hashtable, nick_speaking->nick_lower);
+    }
+
+    /* remove nick from list */
+    if (nick_speaking->prev_nick)
+        (nick_speaking->prev_nick)->next_nick = nick_speaking->next_nick;
+    if (nick_speaking->next_nick)
+        (nick_speaking->next_nick)->prev_nick = nick_speaking->prev_nick;
+    if (*nicks == nick_speaking)
+        *nicks = nick_speaking->next_nick;
+    if (*last_nick == nick_speaking)
+        *last_nick = nick_speaking->prev_nick;
+
+    /* free data */
+    if (nick_speaking->nick)
+        free (nick_speaking->nick);
+    if (nick_speaking->nick_lower)
+        free (nick_speaking->nick_lower);
+
+    free (nick_speaking);
+}
+
+/*
+ * Sets the nick of a nick speaking (only the case can be different, so the
+ * hashtable key is unchanged).
+ *
+ * If the new nick can not be allocated, the nick is unchanged.
+ */
+
+void
+irc_channel_nick_speaking_set_nick (struct t_irc_channel_speaking *nick_speaking,
+                                    const char *nick_name)
+{
+    char *new_nick;
+
+    if (strcmp (nick_speaking->nick, nick_name) == 0)
+        return;
+
+    new_nick = strdup (nick_name);
+    if (!new_nick)
+        return;
+
+    free (nick_speaking->nick);
+    nick_speaking->nick = new_nick;
+}
+
+/*
+ * Renames a nick speaking in a list (the hashtable key is updated).
+ *
+ * If the new nick was already in list, the old entry is removed.
+ *
+ * Returns number of nicks removed from list (0 or 1).
+ */
+
+int
+irc_channel_nick_speaking_list_rename (struct t_irc_server *server,
+                                       struct t_irc_channel_speaking **nicks,
+                                       struct t_irc_channel_speaking **last_nick,
+                                       struct t_hashtable *hashtable,
+                                       struct t_irc_channel_speaking *nick_speaking,
+                                       const char *new_nick)
+{
+    struct t_irc_channel_speaking *ptr_nick;
+    char *new_nick2, *new_nick_lower;
+    int removed;
+
+    removed = 0;
+
+    new_nick2 = strdup (new_nick);
+    new_nick_lower = irc_server_string_tolower (server, new_nick);
+    if (!new_nick2 || !new_nick_lower)
+    {
+        if (new_nick2)
+            free (new_nick2);
+        if (new_nick_lower)
+            free (new_nick_lower);
+        return removed;
+    }
+
+    ptr_nick = weechat_hashtable_get (hashtable, new_nick_lower);
+    if (ptr_nick && (ptr_nick != nick_speaking))
+    {
+        irc_channel_nick_speaking_list_free (nicks, last_nick, hashtable,
+                                             ptr_nick);
+        removed = 1;
+    }
+
+    if (weechat_hashtable_get (hashtable,
+                               nick_speaking->nick_lower) == nick_speaking)
+    {
+        weechat_hashtable_remove (hashtable, nick_speaking->nick_lower);
+    }
+
+    free (nick_speaking->nick);
+    free (nick_speaking->nick_lower);
+    nick_speaking->nick = new_nick2;
+    nick_speaking->nick_lower = new_nick_lower;
+
+    weechat_hashtable_set (hashtable, nick_speaking->nick_lower,
+                           nick_speaking);
+
+    return removed;
+}
+
+/*
+ * Rebuilds hashtable of a list of nicks speaking (called when the casemapping
+ * of server has changed).
+ */
+
+void
+irc_channel_nick_speaking_list_rehash (struct t_irc_server *server,
+                                       struct t_irc_channel_speaking *nicks,
+                                       struct t_hashtable *hashtable)
+{
+    struct t_irc_channel_speaking *ptr_nick;
+    char *nick_lower;
+
+    if (!hashtable)
+        return;
+
+    weechat_hashtable_remove_all (hashtable);
+
+    for (ptr_nick = nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        nick_lower = irc_server_string_tolower (server, ptr_nick->nick);
+        if (nick_lower)
+        {
+            free (ptr_nick->nick_lower);
+            ptr_nick->nick_lower = nick_lower;
+        }
+        weechat_hashtable_set (hashtable, ptr_nick->nick_lower, ptr_nick);
+    }
+}
+
 /*
  * Adds a nick speaking on a channel.
+ *
+ * The list is sorted by time (most recent nick at the end), so the oldest
+ * nick is removed if the list is too big.
  */
 
 void
-irc_channel_nick_speaking_add_to_list (struct t_irc_channel *channel,
+irc_channel_nick_speaking_add_to_list (struct t_irc_server *server,
+                                       struct t_irc_channel *channel,
                                        const char *nick_name,
                                        int highlight)
 {
-    int size, to_remove, i;
-    struct t_weelist_item *ptr_item;
+    struct t_irc_channel_speaking *ptr_nick;
 
-    /* create list if it does not exist */
-    if (!channel->nicks_speaking[highlight])
-        channel->nicks_speaking[highlight] = weechat_list_new ();
+    /* create hashtable if it does not exist */
+    if (!channel->nicks_speaking_hashtable[highlight])
+    {
+        channel->nicks_speaking_hashtable[highlight] = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_STRING,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!channel->nicks_speaking_hashtable[highlight])
+            return;
+    }
 
-    /* remove item if it was already in list */
-    ptr_item = weechat_list_casesearch (channel->nicks_speaking[highlight],
-                                        nick_name);
-    if (ptr_item)
-        weechat_list_remove (channel->nicks_speaking[highlight], ptr_item);
+    /* move nick at the end of list if it was already in list */
+    ptr_nick = irc_channel_nick_speaking_search_hashtable (
+        server, channel->nicks_speaking_hashtable[highlight], nick_name);
+    if (ptr_nick)
+    {
+        irc_channel_nick_speaking_set_nick (ptr_nick, nick_name);
+        ptr_nick->time_last_message = time (NULL);
+        irc_channel_nick_speaking_list_move (
+            &channel->nicks_speaking[highlight],
+            &channel->last_nick_speaking[highlight],
+            ptr_nick, 1);
+        return;
+    }
 
     /* add nick in list */
-    weechat_list_add (channel->nicks_speaking[highlight], nick_name,
-                      WEECHAT_LIST_POS_END, NULL);
+    if (!irc_channel_nick_speaking_list_add (
+            server,
+            &channel->nicks_speaking[highlight],
+            &channel->last_nick_speaking[highlight],
+            channel->nicks_speaking_hashtable[highlight],
+            nick_name, time (NULL), 1))
+    {
+        return;
+    }
+    channel->nicks_speaking_count[highlight]++;
 
     /* reduce list size if it's too big */
-    size = weechat_list_size (channel->nicks_speaking[highlight]);
-    if (size > IRC_CHANNEL_NICKS_SPEAKING_LIMIT)
+    while (channel->nicks_speaking[highlight]
+           && (channel->nicks_speaking_count[highlight] > IRC_CHANNEL_NICKS_SPEAKING_LIMIT))
     {
-        to_remove = size - IRC_CHANNEL_NICKS_SPEAKING_LIMIT;
-        for (i = 0; i < to_remove; i++)
-        {
-            weechat_list_remove (
-                channel->nicks_speaking[highlight],
-                weechat_list_get (channel->nicks_speaking[highlight], 0));
-        }
+        irc_channel_nick_speaking_list_free (
+            &channel->nicks_speaking[highlight],
+            &channel->last_nick_speaking[highlight],
+            channel->nicks_speaking_hashtable[highlight],
+            channel->nicks_speaking[highlight]);
+        channel->nicks_speaking_count[highlight]--;
     }
 }
 
@@ -864,17 +1360,49 @@ irc_channel_nick_speaking_add_to_list (struct t_irc_channel *channel,
  */
 
 void
-irc_channel_nick_speaking_add (struct t_irc_channel *channel,
+irc_channel_nick_speaking_add (struct t_irc_server *server,
+                               struct t_irc_channel *channel,
                                const char *nick_name, int highlight)
 {
+    if (!channel || !nick_name)
+        return;
+
     if (highlight < 0)
         highlight = 0;
     if (highlight > 1)
         highlight = 1;
     if (highlight)
-        irc_channel_nick_speaking_add_to_list (channel, nick_name, 1);
+        irc_channel_nick_speaking_add_to_list (server, channel, nick_name, 1);
+
+    irc_channel_nick_speaking_add_to_list (server, channel, nick_name, 0);
+}
+
+/*
+ * Frees all nicks speaking on a channel (both lists).
+ */
+
+void
+irc_channel_nick_speaking_free_all (struct t_irc_channel *channel)
+{
+    int i;
 
-    irc_channel_nick_speaking_add_to_list (channel, nick_name, 0);
+    for (i = 0; i < 2; i++)
+    {
+        while (channel->nicks_speaking[i])
+        {
+            irc_channel_nick_speaking_list_free (
+                &channel->nicks_speaking[i],
+                &channel->last_nick_speaking[i],
+                channel->nicks_speaking_hashtable[i],
+                channel->nicks_speaking[i]);
+        }
+        channel->nicks_speaking_count[i] = 0;
+        if (channel->nicks_speaking_hashtable[i])
+        {
+            weechat_hashtable_free (channel->nicks_speaking_hashtable[i]);
+            channel->nicks_speaking_hashtable[i] = NULL;
+        }
+    }
 }
 
 /*
@@ -882,21 +1410,27 @@ irc_channel_nick_speaking_add (struct t_irc_channel *channel,
  */
 
 void
-irc_channel_nick_speaking_rename (struct t_irc_channel *channel,
+irc_channel_nick_speaking_rename (struct t_irc_server *server,
+                                  struct t_irc_channel *channel,
                                   const char *old_nick,
                                   const char *new_nick)
 {
-    struct t_weelist_item *ptr_item;
+    struct t_irc_channel_speaking *ptr_nick;
     int i;
 
     for (i = 0; i < 2; i++)
     {
-        if (channel->nicks_speaking[i])
+        ptr_nick = irc_channel_nick_speaking_search_hashtable (
+            server, channel->nicks_speaking_hashtable[i], old_nick);
+        if (ptr_nick)
         {
-            ptr_item = weechat_list_search (channel->nicks_speaking[i],
-                                            old_nick);
-            if (ptr_item)
-                weechat_list_set (ptr_item, new_nick);
+            channel->nicks_speaking_count[i] -=
+                irc_channel_nick_speaking_list_rename (
+                    server,
+                    &channel->nicks_speaking[i],
+                    &channel->last_nick_speaking[i],
+                    channel->nicks_speaking_hashtable[i],
+                    ptr_nick, new_nick);
         }
     }
 }
@@ -910,26 +1444,15 @@ irc_channel_nick_speaking_rename_if_present (struct t_irc_server *server,
                                              struct t_irc_channel *channel,
                                              const char *nick_name)
 {
-    struct t_weelist_item *ptr_item;
-    int i, j, list_size;
+    struct t_irc_channel_speaking *ptr_nick;
+    int i;
 
     for (i = 0; i < 2; i++)
     {
-        if (channel->nicks_speaking[i])
-        {
-            list_size = weechat_list_size (channel->nicks_speaking[i]);
-            for (j = 0; j < list_size; j++)
-            {
-                ptr_item = weechat_list_get (channel->nicks_speaking[i], j);
-                if (ptr_item
-                    && (irc_server_strcasecmp (server,
-                                               weechat_list_string (ptr_item),
-                                               nick_name) == 0))
-                {
-                    weechat_list_set (ptr_item, nick_name);
-                }
-            }
-        }
+        ptr_nick = irc_channel_nick_speaking_search_hashtable (
+            server, channel->nicks_speaking_hashtable[i], nick_name);
+        if (ptr_nick)
+            irc_channel_nick_speaking_set_nick (ptr_nick, nick_name);
     }
 }
 
@@ -948,22 +1471,20 @@ irc_channel_nick_speaking_time_search (struct t_irc_server *server,
     struct t_irc_channel_speaking *ptr_nick;
     time_t time_limit;
 
-    time_limit = time (NULL) -
-        (weechat_config_integer (irc_config_look_smart_filter_delay) * 60);
+    ptr_nick = irc_channel_nick_speaking_search_hashtable (
+        server, channel->nicks_speaking_time_hashtable, nick_name);
+    if (!ptr_nick)
+        return NULL;
 
-    for (ptr_nick = channel->nicks_speaking_time; ptr_nick;
-         ptr_nick = ptr_nick->next_nick)
+    if (check_time)
     {
-        if (irc_server_strcasecmp (server, ptr_nick->nick, nick_name) == 0)
-        {
-            if (check_time && (ptr_nick->time_last_message < time_limit))
-                return NULL;
-            return ptr_nick;
-        }
+        time_limit = time (NULL) -
+            (weechat_config_integer (irc_config_look_smart_filter_delay) * 60);
+        if (ptr_nick->time_last_message < time_limit)
+            return NULL;
     }
 
-    /* nick speaking time not found */
-    return NULL;
+    return ptr_nick;
 }
 
 /*
@@ -977,21 +1498,11 @@ irc_channel_nick_speaking_time_free (struct t_irc_channel *channel,
     if (!channel || !nick_speaking)
         return;
 
-    /* free data */
-    if (nick_speaking->nick)
-        free (nick_speaking->nick);
-
-    /* remove nick from list */
-    if (nick_speaking->prev_nick)
-        (nick_speaking->prev_nick)->next_nick = nick_speaking->next_nick;
-    if (nick_speaking->next_nick)
-        (nick_speaking->next_nick)->prev_nick = nick_speaking->prev_nick;
-    if (channel->nicks_speaking_time == nick_speaking)
-        channel->nicks_speaking_time = nick_speaking->next_nick;
-    if (channel->last_nick_speaking_time == nick_speaking)
-        channel->last_nick_speaking_time = nick_speaking->prev_nick;
-
-    free (nick_speaking);
+    irc_channel_nick_speaking_list_free (
+        &channel->nicks_speaking_time,
+        &channel->last_nick_speaking_time,
+        channel->nicks_speaking_time_hashtable,
+        nick_speaking);
 }
 
 /*
@@ -1006,6 +1517,11 @@ irc_channel_nick_speaking_time_free_all (struct t_irc_channel *channel)
         irc_channel_nick_speaking_time_free (channel,
                                              channel->nicks_speaking_time);
     }
+    if (channel->nicks_speaking_time_hashtable)
+    {
+        weechat_hashtable_free (channel->nicks_speaking_time_hashtable);
+        channel->nicks_speaking_time_hashtable = NULL;
+    }
 }
 
 /*
@@ -1032,6 +1548,8 @@ irc_channel_nick_speaking_time_remove_old (struct t_irc_channel *channel)
 
 /*
  * Adds a nick speaking time on a channel.
+ *
+ * The list is sorted by time (most recent nick first).
  */
 
 void
@@ -1040,28 +1558,39 @@ irc_channel_nick_speaking_time_add (struct t_irc_server *server,
                                     const char *nick_name,
                                     time_t time_last_message)
 {
-    struct t_irc_channel_speaking *ptr_nick, *new_nick;
+    struct t_irc_channel_speaking *ptr_nick;
+
+    if (!channel->nicks_speaking_time_hashtable)
+    {
+        channel->nicks_speaking_time_hashtable = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_STRING,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!channel->nicks_speaking_time_hashtable)
+            return;
+    }
 
     ptr_nick = irc_channel_nick_speaking_time_search (server, channel,
                                                       nick_name, 0);
     if (ptr_nick)
-        irc_channel_nick_speaking_time_free (channel, ptr_nick);
-
-    new_nick = malloc (sizeof (*new_nick));
-    if (new_nick)
     {
-        new_nick->nick = strdup (nick_name);
-        new_nick->time_last_message = time_last_message;
-
-        /* insert nick at beginning of list */
-        new_nick->prev_nick = NULL;
-        new_nick->next_nick = channel->nicks_speaking_time;
-        if (channel->nicks_speaking_time)
-            channel->nicks_speaking_time->prev_nick = new_nick;
-        else
-            channel->last_nick_speaking_time = new_nick;
-        channel->nicks_speaking_time = new_nick;
+        /* nick already in list: update time and move it at beginning */
+        irc_channel_nick_speaking_set_nick (ptr_nick, nick_name);
+        ptr_nick->time_last_message = time_last_message;
+        irc_channel_nick_speaking_list_move (
+            &channel->nicks_speaking_time,
+            &channel->last_nick_speaking_time,
+            ptr_nick, 0);
+        return;
     }
+
+    irc_channel_nick_speaking_list_add (
+        server,
+        &channel->nicks_speaking_time,
+        &channel->last_nick_speaking_time,
+        channel->nicks_speaking_time_hashtable,
+        nick_name, time_last_message, 0);
 }
 
 /*
@@ -1082,8 +1611,12 @@ irc_channel_nick_speaking_time_rename (struct t_irc_server *server,
                                                           old_nick, 0);
         if (ptr_nick)
         {
-            free (ptr_nick->nick);
-            ptr_nick->nick = strdup (new_nick);
+            irc_channel_nick_speaking_list_rename (
+                server,
+                &channel->nicks_speaking_time,
+                &channel->last_nick_speaking_time,
+                channel->nicks_speaking_time_hashtable,
+                ptr_nick, new_nick);
         }
     }
 }
@@ -1480,6 +2013,7 @@ irc_channel_free (struct t_irc_server *server, struct t_irc_channel *channel)
         return;
 
     /* remove channel from channels list */
+    irc_channel_hashtable_remove (server, channel);
     if (server->last_channel == channel)
         server->last_channel = channel->prev_channel;
     if (channel->prev_channel)
@@ -1496,6 +2030,8 @@ irc_channel_free (struct t_irc_server *server, struct t_irc_channel *channel)
     /* free linked lists */
     irc_nick_free_all (server, channel);
     irc_modelist_free_all (channel);
+    if (channel->nicks_hashtable)
+        weechat_hashtable_free (channel->nicks_hashtable);
 
     /* free channel data */
     if (channel->name)
@@ -1514,10 +2050,7 @@ irc_channel_free (struct t_irc_server *server, struct t_irc_channel *channel)
         free (channel->pv_remote_nick_color);
     if (channel->hook_autorejoin)
         weechat_unhook (channel->hook_autorejoin);
-    if (channel->nicks_speaking[0])
-        weechat_list_free (channel->nicks_speaking[0]);
-    if (channel->nicks_speaking[1])
-        weechat_list_free (channel->nicks_speaking[1]);
+    irc_channel_nick_speaking_free_all (channel);
     irc_channel_nick_speaking_time_free_all (channel);
     if (channel->join_smart_filtered)
         weechat_hashtable_free (channel->join_smart_filtered);
@@ -1578,9 +2111,14 @@ irc_channel_hdata_channel_cb (const void *pointer, void *data,
         WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_count, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_channel, nicks, POINTER, 0, NULL, "irc_nick");
         WEECHAT_HDATA_VAR(struct t_irc_channel, last_nick, POINTER, 0, NULL, "irc_nick");
-        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking, POINTER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_hashtable, HASHTABLE, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking, POINTER, 0, NULL, "irc_channel_speaking");
+        WEECHAT_HDATA_VAR(struct t_irc_channel, last_nick_speaking, POINTER, 0, NULL, "irc_channel_speaking");
+        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking_count, INTEGER, 0, "2", NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking_hashtable, HASHTABLE, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking_time, POINTER, 0, NULL, "irc_channel_speaking");
         WEECHAT_HDATA_VAR(struct t_irc_channel, last_nick_speaking_time, POINTER, 0, NULL, "irc_channel_speaking");
+        WEECHAT_HDATA_VAR(struct t_irc_channel, nicks_speaking_time_hashtable, HASHTABLE, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_channel, modelists, POINTER, 0, NULL, "irc_modelist");
         WEECHAT_HDATA_VAR(struct t_irc_channel, last_modelist, POINTER, 0, NULL, "irc_modelist");
         WEECHAT_HDATA_VAR(struct t_irc_channel, join_smart_filtered, HASHTABLE, 0, NULL, NULL);
@@ -1611,6 +2149,7 @@ irc_channel_hdata_channel_speaking_cb (const void *pointer, void *data,
     if (hdata)
     {
         WEECHAT_HDATA_VAR(struct t_irc_channel_speaking, nick, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_channel_speaking, nick_lower, STRING, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_channel_speaking, time_last_message, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_channel_speaking, prev_nick, POINTER, 0, NULL, hdata_name);
         WEECHAT_HDATA_VAR(struct t_irc_channel_speaking, next_nick, POINTER, 0, NULL, hdata_name);
@@ -1631,7 +2170,6 @@ irc_channel_add_to_infolist (struct t_infolist *infolist,
                              struct t_irc_channel *channel)
 {
     struct t_infolist_item *ptr_item;
-    struct t_weelist_item *ptr_list_item;
     struct t_irc_channel_speaking *ptr_nick;
     char option_name[64];
     int i, index;
@@ -1686,20 +2224,16 @@ irc_channel_add_to_infolist (struct t_infolist *infolist,
         return 0;
     for (i = 0; i < 2; i++)
     {
-        if (channel->nicks_speaking[i])
+        index = 0;
+        for (ptr_nick = channel->nicks_speaking[i]; ptr_nick;
+             ptr_nick = ptr_nick->next_nick)
         {
-            index = 0;
-            for (ptr_list_item = weechat_list_get (channel->nicks_speaking[i], 0);
-                 ptr_list_item;
-                 ptr_list_item = weechat_list_next (ptr_list_item))
-            {
-                snprintf (option_name, sizeof (option_name),
-                          "nick_speaking%d_%05d", i, index);
-                if (!weechat_infolist_new_var_string (ptr_item, option_name,
-                                                      weechat_list_string (ptr_list_item)))
-                    return 0;
-                index++;
-            }
+            snprintf (option_name, sizeof (option_name),
+                      "nick_speaking%d_%05d", i, index);
+            if (!weechat_infolist_new_var_string (ptr_item, option_name,
+                                                  ptr_nick->nick))
+                return 0;
+            index++;
         }
     }
     if (channel->nicks_speaking_time)
@@ -1736,7 +2270,6 @@ irc_channel_add_to_infolist (struct t_infolist *infolist,
 void
 irc_channel_print_log (struct t_irc_channel *channel)
 {
-    struct t_weelist_item *ptr_item;
     struct t_irc_channel_speaking *ptr_nick_speaking;
     int i, index;
     struct t_irc_nick *ptr_nick;
@@ -1764,10 +2297,23 @@ irc_channel_print_log (struct t_irc_channel *channel)
     weechat_log_printf ("       nicks_count. . . . . . . : %d",    channel->nicks_count);
     weechat_log_printf ("       nicks. . . . . . . . . . : 0x%lx", channel->nicks);
     weechat_log_printf ("       last_nick. . . . . . . . : 0x%lx", channel->last_nick);
+    weechat_log_printf ("       nicks_hashtable. . . . . : 0x%lx (%d items)",
+                        channel->nicks_hashtable,
+                        weechat_hashtable_get_integer (channel->nicks_hashtable,
+                                                       "items_count"));
     weechat_log_printf ("       nicks_speaking[0]. . . . : 0x%lx", channel->nicks_speaking[0]);
     weechat_log_printf ("       nicks_speaking[1]. . . . : 0x%lx", channel->nicks_speaking[1]);
+    weechat_log_printf ("       last_nick_speaking[0]. . : 0x%lx", channel->last_nick_speaking[0]);
+    weechat_log_printf ("       last_nick_speaking[1]. . : 0x%lx", channel->last_nick_speaking[1]);
+    weechat_log_printf ("       nicks_speaking_count . . : %d, %d",
+                        channel->nicks_speaking_count[0],
+                        channel->nicks_speaking_count[1]);
+    weechat_log_printf ("       nicks_speaking_hashtable : 0x%lx, 0x%lx",
+                        channel->nicks_speaking_hashtable[0],
+                        channel->nicks_speaking_hashtable[1]);
     weechat_log_printf ("       nicks_speaking_time. . . : 0x%lx", channel->nicks_speaking_time);
     weechat_log_printf ("       last_nick_speaking_time. : 0x%lx", channel->last_nick_speaking_time);
+    weechat_log_printf ("       nicks_speaking_time_hashtable: 0x%lx", channel->nicks_speaking_time_hashtable);
     weechat_log_printf ("       modelists. . . . . . . . : 0x%lx", channel->modelists);
     weechat_log_printf ("       last_modelist. . . . . . : 0x%lx", channel->last_modelist);
     weechat_log_printf ("       join_smart_filtered. . . : 0x%lx (hashtable: '%s')",
@@ -1784,11 +2330,12 @@ irc_channel_print_log (struct t_irc_channel *channel)
         {
             weechat_log_printf ("");
             index = 0;
-            for (ptr_item = weechat_list_get (channel->nicks_speaking[i], 0);
-                 ptr_item; ptr_item = weechat_list_next (ptr_item))
+            for (ptr_nick_speaking = channel->nicks_speaking[i];
+                 ptr_nick_speaking;
+                 ptr_nick_speaking = ptr_nick_speaking->next_nick)
             {
                 weechat_log_printf ("         nick speaking[%d][%d]: '%s'",
-                                    i, index, weechat_list_string (ptr_item));
+                                    i, index, ptr_nick_speaking->nick);
                 index++;
             }
         }
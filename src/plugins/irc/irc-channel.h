@@ -35,6 +35,7 @@ struct t_irc_modelist;
 struct t_irc_channel_speaking
 {
     char *nick;                        /* nick speaking                     */
+    char *nick_lower;                  /* nick in lower case (hashtable key)*/
     time_t time_last_message;          /* time                              */
     struct t_irc_channel_speaking *prev_nick; /* pointer to previous nick   */
     struct t_irc_channel_speaking *next_nick; /* pointer to next nick       */
@@ -64,12 +65,20 @@ struct t_irc_channel
     int nicks_count;                   /* # nicks on channel (0 if pv)      */
     struct t_irc_nick *nicks;          /* nicks on the channel              */
     struct t_irc_nick *last_nick;      /* last nick on the channel          */
-    struct t_weelist *nicks_speaking[2]; /* for smart completion: first     */
-                                       /* list is nick speaking, second is  */
-                                       /* speaking to me (highlight)        */
+    struct t_hashtable *nicks_hashtable; /* nicks by name (lower case)      */
+    struct t_irc_channel_speaking *nicks_speaking[2]; /* for smart       */
+                                       /* completion: first list is nick    */
+                                       /* speaking, second is speaking to   */
+                                       /* me (highlight); oldest first      */
+    struct t_irc_channel_speaking *last_nick_speaking[2]; /* most recent    */
+    int nicks_speaking_count[2];       /* number of nicks in lists above    */
+    struct t_hashtable *nicks_speaking_hashtable[2]; /* nicks speaking by   */
+                                       /* name (lower case)                 */
     struct t_irc_channel_speaking *nicks_speaking_time; /* for smart filter */
                                        /* of join/part/quit messages        */
     struct t_irc_channel_speaking *last_nick_speaking_time;
+    struct t_hashtable *nicks_speaking_time_hashtable; /* nicks by name     */
+                                       /* (lower case)                      */
     struct t_irc_modelist *modelists;     /* modelists in the channel       */
     struct t_irc_modelist *last_modelist; /* last modelist in the channel   */
     struct t_hashtable *join_smart_filtered; /* smart filtered joins        */
@@ -85,6 +94,11 @@ extern int irc_channel_valid (struct t_irc_server *server,
                               struct t_irc_channel *channel);
 extern struct t_irc_channel *irc_channel_search (struct t_irc_server *server,
                                                  const char *channel_name);
+extern void irc_channel_hashtable_add (struct t_irc_server *server,
+                                       struct t_irc_channel *channel);
+extern void irc_channel_hashtable_remove (struct t_irc_server *server,
+                                          struct t_irc_channel *channel);
+extern void irc_channel_rebuild_hashtables (struct t_irc_server *server);
 extern struct t_gui_buffer *irc_channel_search_buffer (struct t_irc_server *server,
                                                        int channel_type,
                                                        const char *channel_name);
@@ -122,14 +136,21 @@ extern void irc_channel_remove_away (struct t_irc_server *server,
                                      struct t_irc_channel *channel);
 extern void irc_channel_check_whox (struct t_irc_server *server,
                                     struct t_irc_channel *channel);
+extern void irc_channel_fetch_history (struct t_irc_server *server,
+                                       struct t_irc_channel *channel);
 extern void irc_channel_set_away (struct t_irc_server *server,
                                   struct t_irc_channel *channel,
                                   const char *nick_name,
                                   int is_away);
-extern void irc_channel_nick_speaking_add (struct t_irc_channel *channel,
+extern void irc_channel_nick_speaking_list_rehash (struct t_irc_server *server,
+                                                   struct t_irc_channel_speaking *nicks,
+                                                   struct t_hashtable *hashtable);
+extern void irc_channel_nick_speaking_add (struct t_irc_server *server,
+                                           struct t_irc_channel *channel,
                                            const char *nick_name,
                                            int highlight);
-extern void irc_channel_nick_speaking_rename (struct t_irc_channel *channel,
+extern void irc_channel_nick_speaking_rename (struct t_irc_server *server,
+                                              struct t_irc_channel *channel,
                                               const char *old_nick,
                                               const char *new_nick);
 extern void irc_channel_nick_speaking_rename_if_present (struct t_irc_server *server,
@@ -51,6 +51,7 @@
 #include "irc-raw.h"
 #include "irc-sasl.h"
 #include "irc-server.h"
+#include "irc-stats.h"
 
 
 /*
@@ -4724,6 +4725,29 @@ irc_command_display_server (struct t_irc_server *server, int with_detail)
                         (server->temp_server) ? _(" (temporary)") : "",
                         /* TRANSLATORS: "fake IRC server" */
                         (server->fake_server) ? _(" (fake)") : "");
+        /* connection timings */
+        if (server->connect_pending)
+        {
+            weechat_printf (NULL, "  connection . . . . . : %s%s",
+                            IRC_COLOR_CHAT_VALUE,
+                            _("waiting for a free slot"));
+        }
+        if (server->connect_duration >= 0)
+        {
+            weechat_printf (NULL, "  connect_duration . . : %s%d %s",
+                            IRC_COLOR_CHAT_VALUE,
+                            server->connect_duration,
+                            NG_("millisecond", "milliseconds",
+                                server->connect_duration));
+        }
+        if (server->login_duration >= 0)
+        {
+            weechat_printf (NULL, "  login_duration . . . : %s%d %s",
+                            IRC_COLOR_CHAT_VALUE,
+                            server->login_duration,
+                            NG_("millisecond", "milliseconds",
+                                server->login_duration));
+        }
         /* addresses */
         if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_ADDRESSES]))
             weechat_printf (NULL, "  addresses. . . . . . :   ('%s')",
@@ -4826,6 +4850,14 @@ irc_command_display_server (struct t_irc_server *server, int with_detail)
             weechat_printf (NULL, "  capabilities . . . . : %s'%s'",
                             IRC_COLOR_CHAT_VALUE,
                             weechat_config_string (server->options[IRC_SERVER_OPTION_CAPABILITIES]));
+        /* chathistory_limit */
+        if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_CHATHISTORY_LIMIT]))
+            weechat_printf (NULL, "  chathistory_limit. . :   (%d)",
+                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_CHATHISTORY_LIMIT));
+        else
+            weechat_printf (NULL, "  chathistory_limit. . : %s%d",
+                            IRC_COLOR_CHAT_VALUE,
+                            weechat_config_integer (server->options[IRC_SERVER_OPTION_CHATHISTORY_LIMIT]));
         /* sasl_mechanism */
         if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_SASL_MECHANISM]))
             weechat_printf (NULL, "  sasl_mechanism . . . :   ('%s')",
@@ -5026,6 +5058,14 @@ irc_command_display_server (struct t_irc_server *server, int with_detail)
                             IRC_COLOR_CHAT_VALUE,
                             weechat_config_integer (server->options[IRC_SERVER_OPTION_CONNECTION_TIMEOUT]),
                             NG_("second", "seconds", weechat_config_integer (server->options[IRC_SERVER_OPTION_CONNECTION_TIMEOUT])));
+        /* connection_priority */
+        if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_CONNECTION_PRIORITY]))
+            weechat_printf (NULL, "  connection_priority. :   (%d)",
+                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_CONNECTION_PRIORITY));
+        else
+            weechat_printf (NULL, "  connection_priority. : %s%d",
+                            IRC_COLOR_CHAT_VALUE,
+                            weechat_config_integer (server->options[IRC_SERVER_OPTION_CONNECTION_PRIORITY]));
         /* anti_flood_prio_high */
         if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH]))
             weechat_printf (NULL, "  anti_flood_prio_high :   (%d %s)",
@@ -5046,6 +5086,22 @@ irc_command_display_server (struct t_irc_server *server, int with_detail)
                             IRC_COLOR_CHAT_VALUE,
                             weechat_config_integer (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW]),
                             NG_("second", "seconds", weechat_config_integer (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW])));
+        /* anti_flood_burst */
+        if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BURST]))
+            weechat_printf (NULL, "  anti_flood_burst . . :   (%d)",
+                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_BURST));
+        else
+            weechat_printf (NULL, "  anti_flood_burst . . : %s%d",
+                            IRC_COLOR_CHAT_VALUE,
+                            weechat_config_integer (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BURST]));
+        /* anti_flood_bytes */
+        if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BYTES]))
+            weechat_printf (NULL, "  anti_flood_bytes . . :   (%d)",
+                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_BYTES));
+        else
+            weechat_printf (NULL, "  anti_flood_bytes . . : %s%d",
+                            IRC_COLOR_CHAT_VALUE,
+                            weechat_config_integer (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BYTES]));
         /* away_check */
         if (weechat_config_option_is_null (server->options[IRC_SERVER_OPTION_AWAY_CHECK]))
             weechat_printf (NULL, "  away_check . . . . . :   (%d %s)",
@@ -5163,13 +5219,145 @@ irc_command_display_server (struct t_irc_server *server, int with_detail)
     }
 }
 
+/*
+ * Builds columns with sums of a rolling counter for windows displayed by
+ * /server stats (see irc_stats_windows).
+ */
+
+void
+irc_command_server_stats_windows (char *string, int size,
+                                  struct t_irc_stats_window *window,
+                                  time_t current_time)
+{
+    int i, length;
+
+    string[0] = '\0';
+    for (i = 0; i < IRC_STATS_NUM_WINDOWS; i++)
+    {
+        length = strlen (string);
+        snprintf (string + length, size - length,
+                  " %10ld",
+                  irc_stats_window_sum (window, current_time,
+                                        irc_stats_windows[i]));
+    }
+}
+
+/*
+ * Displays statistics of a server (for command /server stats).
+ */
+
+void
+irc_command_display_server_stats (struct t_irc_server *server)
+{
+    struct t_irc_stats_command *ptr_cmd;
+    const char *counter_label[IRC_STATS_NUM_COUNTERS] =
+        { N_("bytes received"), N_("bytes sent"), N_("messages received"),
+          N_("messages sent"), N_("processing time (µs)"),
+          N_("out queue messages"), N_("out queue wait (ms)"),
+          N_("lag samples"), N_("lag sum (ms)"),
+          N_("redirect messages"), N_("redirect time (µs)"),
+          N_("redirections") };
+    char str_date[128], str_windows[256], str_value[64], **commands;
+    struct tm *local_time;
+    time_t current_time;
+    int i, length, num_commands;
+
+    if (!server->stats)
+        return;
+
+    current_time = time (NULL);
+
+    str_date[0] = '\0';
+    local_time = localtime (&server->stats->start_time);
+    if (local_time)
+    {
+        if (strftime (str_date, sizeof (str_date),
+                      "%Y-%m-%d %H:%M:%S", local_time) == 0)
+            str_date[0] = '\0';
+    }
+
+    weechat_printf (NULL, "");
+    weechat_printf (NULL, _("Statistics for server %s%s%s (since %s):"),
+                    IRC_COLOR_CHAT_SERVER,
+                    server->name,
+                    IRC_COLOR_RESET,
+                    str_date);
+    str_windows[0] = '\0';
+    for (i = 0; i < IRC_STATS_NUM_WINDOWS; i++)
+    {
+        /* TRANSLATORS: "%d" is a number of minutes */
+        snprintf (str_value, sizeof (str_value),
+                  _("%d min"), irc_stats_windows[i]);
+        length = strlen (str_windows);
+        snprintf (str_windows + length, sizeof (str_windows) - length,
+                  " %10s", str_value);
+    }
+    weechat_printf (NULL, "  %-24s %12s%s", "", _("total"), str_windows);
+    for (i = 0; i < IRC_STATS_NUM_COUNTERS; i++)
+    {
+        irc_command_server_stats_windows (str_windows, sizeof (str_windows),
+                                          &server->stats->window[i],
+                                          current_time);
+        weechat_printf (NULL, "  %-24s %s%12ld%s",
+                        _(counter_label[i]),
+                        IRC_COLOR_CHAT_VALUE,
+                        irc_stats_get (server->stats, i, current_time, 0),
+                        str_windows);
+    }
+    weechat_printf (NULL, "  %-24s %s%12d",
+                    _("out queue depth"),
+                    IRC_COLOR_CHAT_VALUE,
+                    irc_stats_outqueue_depth (server));
+
+    commands = weechat_string_split (
+        weechat_hashtable_get_string (server->stats->commands, "keys_sorted"),
+        ",",
+        NULL,
+        WEECHAT_STRING_SPLIT_STRIP_LEFT
+        | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+        | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+        0,
+        &num_commands);
+    if (commands)
+    {
+        weechat_printf (NULL, _("  Messages received by command "
+                                "(count / processing time in µs):"));
+        for (i = 0; i < num_commands; i++)
+        {
+            ptr_cmd = weechat_hashtable_get (server->stats->commands,
+                                             commands[i]);
+            if (!ptr_cmd)
+                continue;
+            irc_command_server_stats_windows (str_windows,
+                                              sizeof (str_windows),
+                                              &ptr_cmd->window_count,
+                                              current_time);
+            weechat_printf (NULL, "    %-22s %s%12ld%s",
+                            commands[i],
+                            IRC_COLOR_CHAT_VALUE,
+                            ptr_cmd->count,
+                            str_windows);
+            irc_command_server_stats_windows (str_windows,
+                                              sizeof (str_windows),
+                                              &ptr_cmd->window_time,
+                                              current_time);
+            weechat_printf (NULL, "    %-22s %s%12ld%s",
+                            "",
+                            IRC_COLOR_CHAT_VALUE,
+                            ptr_cmd->time,
+                            str_windows);
+        }
+        weechat_string_free_split (commands);
+    }
+}
+
 /*
  * Callback for command "/server": manages IRC servers.
  */
 
 IRC_COMMAND_CALLBACK(server)
 {
-    int i, detailed_list, one_server_found, length, count, refresh;
+    int i, detailed_list, one_server_found, length, count, refresh, reset;
     struct t_irc_server *ptr_server2, *server_found, *new_server;
     char *server_name, *message;
     const char *ptr_address;
@@ -5568,6 +5756,52 @@ IRC_COMMAND_CALLBACK(server)
         return WEECHAT_RC_OK;
     }
 
+    if (weechat_strcasecmp (argv[1], "stats") == 0)
+    {
+        reset = 0;
+        server_name = NULL;
+        for (i = 2; i < argc; i++)
+        {
+            if (weechat_strcasecmp (argv[i], "-reset") == 0)
+                reset = 1;
+            else if (!server_name)
+                server_name = argv[i];
+        }
+        server_found = NULL;
+        if (server_name)
+        {
+            server_found = irc_server_search (server_name);
+            if (!server_found)
+            {
+                weechat_printf (
+                    NULL,
+                    _("%s%s: server \"%s\" not found for \"%s\" command"),
+                    weechat_prefix ("error"), IRC_PLUGIN_NAME,
+                    server_name, "server stats");
+                return WEECHAT_RC_OK;
+            }
+        }
+        else if (ptr_server)
+        {
+            server_found = ptr_server;
+        }
+        for (ptr_server2 = irc_servers; ptr_server2;
+             ptr_server2 = ptr_server2->next_server)
+        {
+            if (server_found && (ptr_server2 != server_found))
+                continue;
+            if (reset)
+                irc_stats_reset (ptr_server2->stats);
+            else
+                irc_command_display_server_stats (ptr_server2);
+        }
+        if (reset)
+        {
+            weechat_printf (NULL, _("%s: statistics reset"), IRC_PLUGIN_NAME);
+        }
+        return WEECHAT_RC_OK;
+    }
+
     if (weechat_strcasecmp (argv[1], "jump") == 0)
     {
         if (ptr_server && ptr_server->buffer)
@@ -6489,8 +6723,9 @@ irc_command_init ()
            "Without argument, \"ls\" and \"list\" are sent.\n"
            "\n"
            "Capabilities supported by WeeChat are: "
-           "account-notify, away-notify, cap-notify, chghost, extended-join, "
-           "invite-notify, multi-prefix, server-time, userhost-in-names.\n"
+           "account-notify, away-notify, batch, cap-notify, chghost, "
+           "draft/chathistory, extended-join, invite-notify, multi-prefix, "
+           "server-time, userhost-in-names.\n"
            "\n"
            "The capabilities to automatically enable on servers can be set "
            "in option irc.server_default.capabilities (or by server in "
@@ -7033,7 +7268,8 @@ irc_command_init ()
            " || open <name>|-all [<name>...]"
            " || del|keep <name>"
            " || deloutq|jump"
-           " || raw [<filter>]"),
+           " || raw [<filter>]"
+           " || stats [-reset] [<name>]"),
         N_("    list: list servers (without argument, this list is displayed)\n"
            "listfull: list servers with detailed info for each server\n"
            "     add: add a new server\n"
@@ -7072,6 +7308,11 @@ irc_command_init ()
            "function info_get_hashtable in plugin API reference for the list "
            "of all variables), date (format: \"yyyy-mm-dd hh:mm:ss\"), server, "
            "recv, sent, modified, redirected\n"
+           "   stats: display traffic and processing statistics (total and "
+           "rolling windows of 1, 5 and 15 minutes) for the server (current "
+           "server by default, all servers if the current buffer is not an "
+           "IRC buffer)\n"
+           "  -reset: reset statistics\n"
            "\n"
            "Examples:\n"
            "  /server listfull\n"
@@ -7086,7 +7327,8 @@ irc_command_init ()
            "  /server deloutq\n"
            "  /server raw\n"
            "  /server raw s:freenode\n"
-           "  /server raw c:${recv} && ${command}==PRIVMSG && ${nick}==foo"),
+           "  /server raw c:${recv} && ${command}==PRIVMSG && ${nick}==foo\n"
+           "  /server stats freenode"),
         "list %(irc_servers)"
         " || listfull %(irc_servers)"
         " || add %(irc_servers)"
@@ -7098,7 +7340,8 @@ irc_command_init ()
         " || del %(irc_servers)"
         " || deloutq"
         " || jump"
-        " || raw %(irc_raw_filters)",
+        " || raw %(irc_raw_filters)"
+        " || stats -reset|%(irc_servers) %(irc_servers)",
         &irc_command_server, NULL, NULL);
     weechat_hook_command (
         "servlist",
@@ -274,23 +274,18 @@ irc_completion_channel_nicks_add_speakers (struct t_gui_completion *completion,
                                            struct t_irc_channel *channel,
                                            int highlight)
 {
-    int list_size, i;
-    const char *nick;
+    struct t_irc_channel_speaking *ptr_nick;
 
-    if (channel->nicks_speaking[highlight])
+    /* nicks are sorted by time (oldest first), most recent is added last */
+    for (ptr_nick = channel->nicks_speaking[highlight]; ptr_nick;
+         ptr_nick = ptr_nick->next_nick)
     {
-        list_size = weechat_list_size (channel->nicks_speaking[highlight]);
-        for (i = 0; i < list_size; i++)
+        if (irc_nick_search (server, channel, ptr_nick->nick))
         {
-            nick = weechat_list_string (
-                weechat_list_get (channel->nicks_speaking[highlight], i));
-            if (nick && irc_nick_search (server, channel, nick))
-            {
-                weechat_completion_list_add (completion,
-                                             nick,
-                                             1,
-                                             WEECHAT_LIST_POS_BEGINNING);
-            }
+            weechat_completion_list_add (completion,
+                                         ptr_nick->nick,
+                                         1,
+                                         WEECHAT_LIST_POS_BEGINNING);
         }
     }
 }
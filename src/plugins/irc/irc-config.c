@@ -37,6 +37,8 @@
 #include "irc-msgbuffer.h"
 #include "irc-nick.h"
 #include "irc-notify.h"
+#include "irc-raw.h"
+#include "irc-recv-thread.h"
 #include "irc-server.h"
 
 
@@ -96,6 +98,7 @@ struct t_config_option *irc_config_look_part_closes_buffer;
 struct t_config_option *irc_config_look_pv_buffer;
 struct t_config_option *irc_config_look_pv_tags;
 struct t_config_option *irc_config_look_raw_messages;
+struct t_config_option *irc_config_look_raw_messages_size;
 struct t_config_option *irc_config_look_server_buffer;
 struct t_config_option *irc_config_look_smart_filter;
 struct t_config_option *irc_config_look_smart_filter_account;
@@ -134,10 +137,12 @@ struct t_config_option *irc_config_color_topic_old;
 /* IRC config, network section */
 
 struct t_config_option *irc_config_network_autoreconnect_delay_growing;
+struct t_config_option *irc_config_network_autoreconnect_delay_jitter;
 struct t_config_option *irc_config_network_autoreconnect_delay_max;
 struct t_config_option *irc_config_network_ban_mask_default;
 struct t_config_option *irc_config_network_colors_receive;
 struct t_config_option *irc_config_network_colors_send;
+struct t_config_option *irc_config_network_connections_max;
 struct t_config_option *irc_config_network_lag_check;
 struct t_config_option *irc_config_network_lag_max;
 struct t_config_option *irc_config_network_lag_min_show;
@@ -145,6 +150,7 @@ struct t_config_option *irc_config_network_lag_reconnect;
 struct t_config_option *irc_config_network_lag_refresh_interval;
 struct t_config_option *irc_config_network_notify_check_ison;
 struct t_config_option *irc_config_network_notify_check_whois;
+struct t_config_option *irc_config_network_recv_thread;
 struct t_config_option *irc_config_network_sasl_fail_unavailable;
 struct t_config_option *irc_config_network_send_unknown_commands;
 struct t_config_option *irc_config_network_whois_double_nick;
@@ -220,6 +226,7 @@ irc_config_compute_nick_colors ()
                         free (ptr_nick->color);
                     ptr_nick->color = irc_nick_find_color (ptr_nick->name);
                 }
+                irc_nick_reset_as_prefix (ptr_nick);
             }
             if (ptr_channel->pv_remote_nick_color)
             {
@@ -229,6 +236,8 @@ irc_config_compute_nick_colors ()
         }
     }
 
+    irc_nick_color_cache_flush ();
+
     /* if colors are displayed for nicks in nicklist, refresh them */
     if (weechat_config_boolean (irc_config_look_color_nicks_in_nicklist))
         irc_nick_nicklist_set_color_all ();
@@ -309,6 +318,25 @@ irc_config_change_look_color_nicks_in_nicklist (const void *pointer,
     irc_nick_nicklist_set_color_all ();
 }
 
+/*
+ * Callback for changes on options "irc.look.nick_mode" and
+ * "irc.look.nick_mode_empty".
+ */
+
+void
+irc_config_change_look_nick_mode (const void *pointer, void *data,
+                                  struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    irc_nick_reset_as_prefix_all ();
+
+    weechat_bar_item_update ("input_prompt");
+}
+
 /*
  * Callback for changes on option "irc.look.display_away".
  */
@@ -494,6 +522,23 @@ irc_config_change_look_pv_buffer (const void *pointer, void *data,
     }
 }
 
+/*
+ * Callback for changes on options "irc.look.raw_messages" and
+ * "irc.look.raw_messages_size".
+ */
+
+void
+irc_config_change_look_raw_messages (const void *pointer, void *data,
+                                     struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    irc_raw_message_resize ();
+}
+
 /*
  * Callback for changes on option "irc.look.item_channel_modes_hide_args".
  */
@@ -805,6 +850,8 @@ irc_config_change_color_nick_prefixes (const void *pointer, void *data,
 
     irc_nick_nicklist_set_prefix_color_all ();
 
+    irc_nick_reset_as_prefix_all ();
+
     weechat_bar_item_update ("input_prompt");
 }
 
@@ -883,6 +930,51 @@ irc_config_change_network_notify_check_whois (const void *pointer, void *data,
     irc_notify_hook_timer_whois ();
 }
 
+/*
+ * Callback for changes on option "irc.network.recv_thread".
+ */
+
+void
+irc_config_change_network_recv_thread (const void *pointer, void *data,
+                                       struct t_config_option *option)
+{
+    struct t_irc_server *ptr_server;
+    int recv_thread, msgq_flush;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    recv_thread = weechat_config_boolean (irc_config_network_recv_thread);
+    msgq_flush = 0;
+
+    for (ptr_server = irc_servers; ptr_server;
+         ptr_server = ptr_server->next_server)
+    {
+        if (!ptr_server->hook_fd || (ptr_server->sock < 0)
+            || (recv_thread == ((ptr_server->recv_thread) ? 1 : 0)))
+        {
+            continue;
+        }
+        if (ptr_server->recv_thread)
+        {
+            /* keep messages received by thread, they are processed below */
+            irc_recv_thread_stop (ptr_server, 1);
+            msgq_flush = 1;
+        }
+        else
+        {
+            weechat_unhook (ptr_server->hook_fd);
+            ptr_server->hook_fd = NULL;
+        }
+        irc_server_hook_recv (ptr_server);
+    }
+
+    if (msgq_flush)
+        irc_server_msgq_flush ();
+}
+
 /*
  * Callback for changes on option "irc.network.send_unknown_commands".
  */
@@ -1833,6 +1925,27 @@ irc_config_server_new_option (struct t_config_file *config_file,
                 callback_change_data,
                 NULL, NULL, NULL);
             break;
+        case IRC_SERVER_OPTION_CHATHISTORY_LIMIT:
+            new_option = weechat_config_new_option (
+                config_file, section,
+                option_name, "integer",
+                N_("number of messages to fetch from history of channel "
+                   "when joining it, if the capability "
+                   "\"draft/chathistory\" is enabled; if the buffer already "
+                   "has lines, only messages after the last line are fetched; "
+                   "the value is limited by the max number of messages "
+                   "allowed by the server (0 = do not fetch history)"),
+                NULL, 0, 1000,
+                default_value, value,
+                null_value_allowed,
+                callback_check_value,
+                callback_check_value_pointer,
+                callback_check_value_data,
+                callback_change,
+                callback_change_pointer,
+                callback_change_data,
+                NULL, NULL, NULL);
+            break;
         case IRC_SERVER_OPTION_SASL_MECHANISM:
             new_option = weechat_config_new_option (
                 config_file, section,
@@ -2241,6 +2354,25 @@ irc_config_server_new_option (struct t_config_file *config_file,
                 callback_change_data,
                 NULL, NULL, NULL);
             break;
+        case IRC_SERVER_OPTION_CONNECTION_PRIORITY:
+            new_option = weechat_config_new_option (
+                config_file, section,
+                option_name, "integer",
+                N_("priority of server for automatic connection and "
+                   "reconnection when the number of connections in progress "
+                   "is limited (see option irc.network.connections_max): "
+                   "servers with a higher priority are connected first"),
+                NULL, -1000, 1000,
+                default_value, value,
+                null_value_allowed,
+                callback_check_value,
+                callback_check_value_pointer,
+                callback_check_value_data,
+                callback_change,
+                callback_change_pointer,
+                callback_change_data,
+                NULL, NULL, NULL);
+            break;
         case IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH:
             new_option = weechat_config_new_option (
                 config_file, section,
@@ -2277,6 +2409,42 @@ irc_config_server_new_option (struct t_config_file *config_file,
                 callback_change_data,
                 NULL, NULL, NULL);
             break;
+        case IRC_SERVER_OPTION_ANTI_FLOOD_BURST:
+            new_option = weechat_config_new_option (
+                config_file, section,
+                option_name, "integer",
+                N_("anti-flood: number of messages that can be sent at once "
+                   "to IRC server before the delay of options "
+                   "anti_flood_prio_high/low is applied (1 = no burst)"),
+                NULL, 1, 1000,
+                default_value, value,
+                null_value_allowed,
+                callback_check_value,
+                callback_check_value_pointer,
+                callback_check_value_data,
+                callback_change,
+                callback_change_pointer,
+                callback_change_data,
+                NULL, NULL, NULL);
+            break;
+        case IRC_SERVER_OPTION_ANTI_FLOOD_BYTES:
+            new_option = weechat_config_new_option (
+                config_file, section,
+                option_name, "integer",
+                N_("anti-flood: max number of bytes sent to IRC server per "
+                   "second, for messages sent with a priority queue "
+                   "(0 = no limit)"),
+                NULL, 0, 1024 * 1024,
+                default_value, value,
+                null_value_allowed,
+                callback_check_value,
+                callback_check_value_pointer,
+                callback_check_value_data,
+                callback_change,
+                callback_change_pointer,
+                callback_change_data,
+                NULL, NULL, NULL);
+            break;
         case IRC_SERVER_OPTION_AWAY_CHECK:
             new_option = weechat_config_new_option (
                 config_file, section,
@@ -2982,7 +3150,9 @@ irc_config_init ()
            "prefix = in prefix only (default), action = in action messages "
            "only, both = prefix + action messages)"),
         "none|prefix|action|both", 0, 0, "prefix", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &irc_config_change_look_nick_mode, NULL, NULL,
+        NULL, NULL, NULL);
     irc_config_look_nick_mode_empty = weechat_config_new_option (
         irc_config_file, ptr_section,
         "nick_mode_empty", "boolean",
@@ -2990,7 +3160,7 @@ irc_config_init ()
            "op, voice, ...)"),
         NULL, 0, 0, "off", NULL, 0,
         NULL, NULL, NULL,
-        &irc_config_change_bar_item_input_prompt, NULL, NULL,
+        &irc_config_change_look_nick_mode, NULL, NULL,
         NULL, NULL, NULL);
     irc_config_look_nicks_hide_password = weechat_config_new_option (
         irc_config_file, ptr_section,
@@ -3069,10 +3239,24 @@ irc_config_init ()
     irc_config_look_raw_messages = weechat_config_new_option (
         irc_config_file, ptr_section,
         "raw_messages", "integer",
-        N_("number of raw messages to save in memory when raw data buffer is "
-           "closed (messages will be displayed when opening raw data buffer)"),
+        N_("number of raw messages saved in memory (they are displayed when "
+           "raw data buffer is opened); oldest messages are removed when this "
+           "number or the size of messages (option "
+           "irc.look.raw_messages_size) is reached"),
         NULL, 0, 65535, "256", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &irc_config_change_look_raw_messages, NULL, NULL,
+        NULL, NULL, NULL);
+    irc_config_look_raw_messages_size = weechat_config_new_option (
+        irc_config_file, ptr_section,
+        "raw_messages_size", "integer",
+        N_("max size of raw messages saved in memory (in bytes); oldest "
+           "messages are removed when this size or the number of messages "
+           "(option irc.look.raw_messages) is reached"),
+        NULL, 16384, 64 * 1024 * 1024, "262144", NULL, 0,
+        NULL, NULL, NULL,
+        &irc_config_change_look_raw_messages, NULL, NULL,
+        NULL, NULL, NULL);
     irc_config_look_server_buffer = weechat_config_new_option (
         irc_config_file, ptr_section,
         "server_buffer", "integer",
@@ -3347,6 +3531,14 @@ irc_config_init ()
            "delay, 2 = delay*2 for each retry, etc.)"),
         NULL, 1, 100, "2", NULL, 0,
         NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    irc_config_network_autoreconnect_delay_jitter = weechat_config_new_option (
+        irc_config_file, ptr_section,
+        "autoreconnect_delay_jitter", "integer",
+        N_("random delay added to autoreconnect delay, as percentage of "
+           "delay (0 = no random delay); this prevents all servers from "
+           "reconnecting at the same time after a network outage"),
+        NULL, 0, 100, "20", NULL, 0,
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
     irc_config_network_autoreconnect_delay_max = weechat_config_new_option (
         irc_config_file, ptr_section,
         "autoreconnect_delay_max", "integer",
@@ -3377,6 +3569,16 @@ irc_config_init ()
            "i=italic, o=disable color/attributes, r=reverse, u=underline)"),
         NULL, 0, 0, "on", NULL, 0,
         NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    irc_config_network_connections_max = weechat_config_new_option (
+        irc_config_file, ptr_section,
+        "connections_max", "integer",
+        N_("maximum number of connections in progress (connecting to server "
+           "or waiting for message 001) for automatic connections and "
+           "reconnections; other servers wait for a free slot, by order of "
+           "server option \"connection_priority\" (0 = no limit); "
+           "connections started with command /connect are not limited"),
+        NULL, 0, 1000, "5", NULL, 0,
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
     irc_config_network_lag_check = weechat_config_new_option (
         irc_config_file, ptr_section,
         "lag_check", "integer",
@@ -3435,6 +3637,18 @@ irc_config_init ()
         NULL, NULL, NULL,
         &irc_config_change_network_notify_check_whois, NULL, NULL,
         NULL, NULL, NULL);
+    irc_config_network_recv_thread = weechat_config_new_option (
+        irc_config_file, ptr_section,
+        "recv_thread", "boolean",
+        N_("receive data from servers in a thread (one thread by server): "
+           "reading of socket, SSL decryption and split of messages are "
+           "done in this thread, so that a server sending a lot of data "
+           "does not slow down WeeChat; messages are still processed "
+           "(modifiers, charset, display) in main thread"),
+        NULL, 0, 0, "off", NULL, 0,
+        NULL, NULL, NULL,
+        &irc_config_change_network_recv_thread, NULL, NULL,
+        NULL, NULL, NULL);
     irc_config_network_sasl_fail_unavailable = weechat_config_new_option (
         irc_config_file, ptr_section,
         "sasl_fail_unavailable", "boolean",
@@ -1037,7 +1037,8 @@ irc_ctcp_recv (struct t_irc_server *server, time_t date, const char *command,
             if (channel)
             {
                 ptr_nick = irc_nick_search (server, channel, nick);
-                irc_channel_nick_speaking_add (channel,
+                irc_channel_nick_speaking_add (server,
+                                               channel,
                                                nick,
                                                (pos_args) ?
                                                weechat_string_has_highlight (pos_args,
@@ -21,6 +21,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "../weechat-plugin.h"
@@ -33,6 +34,13 @@
 struct t_irc_ignore *irc_ignore_list = NULL; /* list of ignore              */
 struct t_irc_ignore *last_irc_ignore = NULL; /* last ignore in list         */
 
+/* index of ignores: "server\x01channel" => struct t_irc_ignore_group */
+struct t_hashtable *irc_ignore_groups = NULL;
+/* ignores with non-ASCII server/channel: checked one by one */
+struct t_arraylist *irc_ignore_not_indexed = NULL;
+/* cache of verdicts: "server\x01channel\x01nick\x01host" => 0/1 */
+struct t_hashtable *irc_ignore_cache = NULL;
+
 
 /*
  * Checks if an ignore pointer is valid.
@@ -115,6 +123,406 @@ irc_ignore_search_by_number (int number)
     return NULL;
 }
 
+/*
+ * Checks if a mask can be combined with other masks in a single regex: the
+ * mask must not have flags (like "(?-i)"), back-references, and parentheses
+ * must be balanced.
+ *
+ * Returns:
+ *   1: mask can be combined
+ *   0: mask can not be combined
+ */
+
+int
+irc_ignore_mask_can_be_combined (const char *mask)
+{
+    const char *ptr_mask;
+    int depth;
+
+    if (!mask || !mask[0] || (strncmp (mask, "(?", 2) == 0))
+        return 0;
+
+    depth = 0;
+    ptr_mask = mask;
+    while (ptr_mask[0])
+    {
+        switch (ptr_mask[0])
+        {
+            case '\\':
+                if (!ptr_mask[1] || ((ptr_mask[1] >= '0') && (ptr_mask[1] <= '9')))
+                    return 0;
+                ptr_mask++;
+                break;
+            case '[':
+                /* skip bracket expression (with "]" as first char allowed) */
+                ptr_mask++;
+                if (ptr_mask[0] == '^')
+                    ptr_mask++;
+                if (ptr_mask[0] == ']')
+                    ptr_mask++;
+                while (ptr_mask[0] && (ptr_mask[0] != ']'))
+                {
+                    ptr_mask++;
+                }
+                if (!ptr_mask[0])
+                    return 0;
+                break;
+            case '(':
+                depth++;
+                break;
+            case ')':
+                depth--;
+                if (depth < 0)
+                    return 0;
+                break;
+        }
+        ptr_mask++;
+    }
+
+    return (depth == 0) ? 1 : 0;
+}
+
+/*
+ * Returns the key used for a server/channel in index of ignores: name in
+ * lower case, or NULL if the name has non-ASCII chars (such ignores are not
+ * indexed).
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+irc_ignore_index_key (const char *name)
+{
+    const unsigned char *ptr_name;
+    char *key;
+
+    for (ptr_name = (const unsigned char *)name; ptr_name[0]; ptr_name++)
+    {
+        if (ptr_name[0] >= 128)
+            return NULL;
+    }
+
+    key = strdup (name);
+    if (key)
+        weechat_string_tolower (key);
+
+    return key;
+}
+
+/*
+ * Frees a group of ignores.
+ */
+
+void
+irc_ignore_group_free (struct t_hashtable *hashtable,
+                       const void *key, void *value)
+{
+    struct t_irc_ignore_group *group;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    group = (struct t_irc_ignore_group *)value;
+    if (!group)
+        return;
+
+    if (group->ignores)
+        weechat_arraylist_free (group->ignores);
+    if (group->regex)
+    {
+        regfree (group->regex);
+        free (group->regex);
+    }
+    if (group->regex_no_excl)
+    {
+        regfree (group->regex_no_excl);
+        free (group->regex_no_excl);
+    }
+    if (group->ignores_single)
+        weechat_arraylist_free (group->ignores_single);
+
+    free (group);
+}
+
+/*
+ * Frees index of ignores and cache of verdicts (they are built again on next
+ * check).
+ */
+
+void
+irc_ignore_index_free ()
+{
+    if (irc_ignore_groups)
+    {
+        weechat_hashtable_free (irc_ignore_groups);
+        irc_ignore_groups = NULL;
+    }
+    if (irc_ignore_not_indexed)
+    {
+        weechat_arraylist_free (irc_ignore_not_indexed);
+        irc_ignore_not_indexed = NULL;
+    }
+    if (irc_ignore_cache)
+    {
+        weechat_hashtable_free (irc_ignore_cache);
+        irc_ignore_cache = NULL;
+    }
+}
+
+/*
+ * Adds an ignore in a group of index.
+ */
+
+void
+irc_ignore_index_add (const char *server, const char *channel,
+                      struct t_irc_ignore *ignore)
+{
+    struct t_irc_ignore_group *ptr_group;
+    char key[4096];
+
+    snprintf (key, sizeof (key), "%s\x01%s", server, channel);
+
+    ptr_group = weechat_hashtable_get (irc_ignore_groups, key);
+    if (!ptr_group)
+    {
+        ptr_group = malloc (sizeof (*ptr_group));
+        if (!ptr_group)
+            return;
+        ptr_group->ignores = weechat_arraylist_new (8, 0, 1,
+                                                    NULL, NULL, NULL, NULL);
+        ptr_group->compiled = 0;
+        ptr_group->regex = NULL;
+        ptr_group->regex_no_excl = NULL;
+        ptr_group->ignores_single = NULL;
+        if (!ptr_group->ignores)
+        {
+            free (ptr_group);
+            return;
+        }
+        weechat_hashtable_set (irc_ignore_groups, key, ptr_group);
+    }
+
+    weechat_arraylist_add (ptr_group->ignores, ignore);
+}
+
+/*
+ * Builds index of ignores: each ignore is added in the group
+ * "server\x01channel" and in the group "server\x01" (used when no channel is
+ * given to check).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+irc_ignore_index_build ()
+{
+    struct t_irc_ignore *ptr_ignore;
+    char *server, *channel;
+
+    irc_ignore_index_free ();
+
+    irc_ignore_groups = weechat_hashtable_new (
+        32,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_POINTER,
+        NULL, NULL);
+    irc_ignore_not_indexed = weechat_arraylist_new (8, 0, 1,
+                                                    NULL, NULL, NULL, NULL);
+    irc_ignore_cache = weechat_hashtable_new (
+        256,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_INTEGER,
+        NULL, NULL);
+    if (!irc_ignore_groups || !irc_ignore_not_indexed || !irc_ignore_cache)
+    {
+        irc_ignore_index_free ();
+        return 0;
+    }
+    weechat_hashtable_set_pointer (irc_ignore_groups,
+                                   "callback_free_value",
+                                   &irc_ignore_group_free);
+
+    for (ptr_ignore = irc_ignore_list; ptr_ignore;
+         ptr_ignore = ptr_ignore->next_ignore)
+    {
+        server = irc_ignore_index_key (ptr_ignore->server);
+        channel = irc_ignore_index_key (ptr_ignore->channel);
+        if (server && channel)
+        {
+            irc_ignore_index_add (server, channel, ptr_ignore);
+            irc_ignore_index_add (server, "", ptr_ignore);
+        }
+        else
+        {
+            weechat_arraylist_add (irc_ignore_not_indexed, ptr_ignore);
+        }
+        if (server)
+            free (server);
+        if (channel)
+            free (channel);
+    }
+
+    return 1;
+}
+
+/*
+ * Compiles a regex combining masks of ignores (all masks or only masks
+ * without "!").
+ *
+ * Returns pointer to compiled regex, NULL if no mask or error.
+ */
+
+regex_t *
+irc_ignore_group_regcomp (struct t_irc_ignore_group *group, int no_excl)
+{
+    struct t_irc_ignore *ptr_ignore;
+    regex_t *regex;
+    char **mask;
+    int i, size, count;
+
+    mask = weechat_string_dyn_alloc (256);
+    if (!mask)
+        return NULL;
+
+    count = 0;
+    size = weechat_arraylist_size (group->ignores);
+    for (i = 0; i < size; i++)
+    {
+        ptr_ignore = (struct t_irc_ignore *)weechat_arraylist_get (
+            group->ignores, i);
+        if (!irc_ignore_mask_can_be_combined (ptr_ignore->mask))
+            continue;
+        if (no_excl && strchr (ptr_ignore->mask, '!'))
+            continue;
+        if (count > 0)
+            weechat_string_dyn_concat (mask, "|", -1);
+        weechat_string_dyn_concat (mask, "(", -1);
+        weechat_string_dyn_concat (mask, ptr_ignore->mask, -1);
+        weechat_string_dyn_concat (mask, ")", -1);
+        count++;
+    }
+
+    regex = NULL;
+    if (count > 0)
+    {
+        regex = malloc (sizeof (*regex));
+        if (regex && (regcomp (regex, *mask,
+                               REG_EXTENDED | REG_ICASE | REG_NOSUB) != 0))
+        {
+            free (regex);
+            regex = NULL;
+        }
+    }
+
+    weechat_string_dyn_free (mask, 1);
+
+    return regex;
+}
+
+/*
+ * Compiles combined regex of a group of ignores (if not already done).
+ */
+
+void
+irc_ignore_group_compile (struct t_irc_ignore_group *group)
+{
+    struct t_irc_ignore *ptr_ignore;
+    int i, size;
+
+    if (group->compiled)
+        return;
+
+    group->regex = irc_ignore_group_regcomp (group, 0);
+    group->regex_no_excl = irc_ignore_group_regcomp (group, 1);
+    group->ignores_single = weechat_arraylist_new (8, 0, 1,
+                                                   NULL, NULL, NULL, NULL);
+
+    size = weechat_arraylist_size (group->ignores);
+    for (i = 0; i < size; i++)
+    {
+        ptr_ignore = (struct t_irc_ignore *)weechat_arraylist_get (
+            group->ignores, i);
+        /*
+         * if the combined regex could not be compiled, all ignores are
+         * checked one by one
+         */
+        if (!irc_ignore_mask_can_be_combined (ptr_ignore->mask)
+            || !group->regex
+            || (!strchr (ptr_ignore->mask, '!') && !group->regex_no_excl))
+        {
+            if (group->ignores_single)
+                weechat_arraylist_add (group->ignores_single, ptr_ignore);
+        }
+    }
+
+    group->compiled = 1;
+}
+
+/*
+ * Checks if a group of ignores matches a nick/host.
+ *
+ * Returns:
+ *   1: a mask of the group matches the nick or host
+ *   0: no mask matches
+ */
+
+int
+irc_ignore_group_check (const char *server, const char *channel,
+                        const char *nick, const char *host)
+{
+    struct t_irc_ignore_group *ptr_group;
+    const char *pos;
+    char key[4096];
+    int i, size;
+
+    snprintf (key, sizeof (key), "%s\x01%s", server, channel);
+
+    ptr_group = weechat_hashtable_get (irc_ignore_groups, key);
+    if (!ptr_group)
+        return 0;
+
+    irc_ignore_group_compile (ptr_group);
+
+    /* check combined regex (same rules as in irc_ignore_check_host) */
+    if (ptr_group->regex)
+    {
+        if (nick && (regexec (ptr_group->regex, nick, 0, NULL, 0) == 0))
+            return 1;
+        if (host && (regexec (ptr_group->regex, host, 0, NULL, 0) == 0))
+            return 1;
+    }
+    if (ptr_group->regex_no_excl && host)
+    {
+        pos = strchr (host, '!');
+        if (pos && (regexec (ptr_group->regex_no_excl, pos + 1,
+                             0, NULL, 0) == 0))
+        {
+            return 1;
+        }
+    }
+
+    /* check ignores that are not in combined regex */
+    if (ptr_group->ignores_single)
+    {
+        size = weechat_arraylist_size (ptr_group->ignores_single);
+        for (i = 0; i < size; i++)
+        {
+            if (irc_ignore_check_host (
+                    (struct t_irc_ignore *)weechat_arraylist_get (
+                        ptr_group->ignores_single, i),
+                    nick, host))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 /*
  * Adds a new ignore.
  *
@@ -158,6 +566,8 @@ irc_ignore_new (const char *mask, const char *server, const char *channel)
             irc_ignore_list = new_ignore;
         last_irc_ignore = new_ignore;
         new_ignore->next_ignore = NULL;
+
+        irc_ignore_index_free ();
     }
 
     return new_ignore;
@@ -255,8 +665,11 @@ irc_ignore_check (struct t_irc_server *server, const char *channel,
                   const char *nick, const char *host)
 {
     struct t_irc_ignore *ptr_ignore;
+    char *key_server, *key_target, *cache_key;
+    const char *target;
+    int i, size, *ptr_verdict, ignored, length;
 
-    if (!server)
+    if (!server || !irc_ignore_list)
         return 0;
 
     /*
@@ -269,18 +682,120 @@ irc_ignore_check (struct t_irc_server *server, const char *channel,
         return 0;
     }
 
-    for (ptr_ignore = irc_ignore_list; ptr_ignore;
-         ptr_ignore = ptr_ignore->next_ignore)
+    if (!irc_ignore_groups && !irc_ignore_index_build ())
+        return 0;
+
+    /*
+     * target of message is the channel, or the nick if the channel is not
+     * a valid channel name (NULL if no channel: all channels are checked)
+     */
+    target = NULL;
+    if (channel)
+        target = (irc_channel_is_channel (server, channel)) ? channel : nick;
+
+    /* search verdict in cache */
+    length = strlen (server->name) + 1
+        + ((channel) ? strlen (channel) : 0) + 2
+        + ((target) ? strlen (target) : 0) + 1
+        + ((nick) ? strlen (nick) : 0) + 1
+        + ((host) ? strlen (host) : 0) + 1;
+    cache_key = malloc (length);
+    if (cache_key)
     {
-        if (irc_ignore_check_server (ptr_ignore, server->name)
-            && irc_ignore_check_channel (ptr_ignore, server, channel, nick))
+        snprintf (cache_key, length, "%s\x01%s%s\x01%s\x01%s\x01%s",
+                  server->name,
+                  (channel) ? "c" : "-",
+                  (channel) ? channel : "",
+                  (target) ? target : "",
+                  (nick) ? nick : "",
+                  (host) ? host : "");
+        ptr_verdict = weechat_hashtable_get (irc_ignore_cache, cache_key);
+        if (ptr_verdict)
         {
-            if (irc_ignore_check_host (ptr_ignore, nick, host))
-                return 1;
+            ignored = *ptr_verdict;
+            free (cache_key);
+            return ignored;
         }
     }
 
-    return 0;
+    ignored = 0;
+
+    /* check indexed ignores */
+    key_server = irc_ignore_index_key (server->name);
+    key_target = (target) ? irc_ignore_index_key (target) : NULL;
+    if (key_server && (!target || key_target))
+    {
+        if (target)
+        {
+            ignored = irc_ignore_group_check ("*", "*", nick, host)
+                || irc_ignore_group_check ("*", key_target, nick, host)
+                || irc_ignore_group_check (key_server, "*", nick, host)
+                || irc_ignore_group_check (key_server, key_target,
+                                           nick, host);
+        }
+        else if (channel)
+        {
+            /* channel with no target: only ignores for any channel match */
+            ignored = irc_ignore_group_check ("*", "*", nick, host)
+                || irc_ignore_group_check (key_server, "*", nick, host);
+        }
+        else
+        {
+            ignored = irc_ignore_group_check ("*", "", nick, host)
+                || irc_ignore_group_check (key_server, "", nick, host);
+        }
+    }
+    else
+    {
+        /* server or target has non-ASCII chars: check all ignores */
+        for (ptr_ignore = irc_ignore_list; ptr_ignore;
+             ptr_ignore = ptr_ignore->next_ignore)
+        {
+            if (irc_ignore_check_server (ptr_ignore, server->name)
+                && irc_ignore_check_channel (ptr_ignore, server, channel, nick)
+                && irc_ignore_check_host (ptr_ignore, nick, host))
+            {
+                ignored = 1;
+                break;
+            }
+        }
+    }
+    if (key_server)
+        free (key_server);
+    if (key_target)
+        free (key_target);
+
+    /* check ignores that are not indexed */
+    if (!ignored)
+    {
+        size = weechat_arraylist_size (irc_ignore_not_indexed);
+        for (i = 0; i < size; i++)
+        {
+            ptr_ignore = (struct t_irc_ignore *)weechat_arraylist_get (
+                irc_ignore_not_indexed, i);
+            if (irc_ignore_check_server (ptr_ignore, server->name)
+                && irc_ignore_check_channel (ptr_ignore, server, channel, nick)
+                && irc_ignore_check_host (ptr_ignore, nick, host))
+            {
+                ignored = 1;
+                break;
+            }
+        }
+    }
+
+    /* save verdict in cache */
+    if (cache_key)
+    {
+        if (weechat_hashtable_get_integer (irc_ignore_cache, "items_count")
+            >= IRC_IGNORE_CACHE_MAX_SIZE)
+        {
+            weechat_hashtable_remove_all (irc_ignore_cache);
+        }
+        weechat_hashtable_set (irc_ignore_cache, cache_key, &ignored);
+        free (cache_key);
+    }
+
+    return ignored;
 }
 
 /*
@@ -330,6 +845,8 @@ irc_ignore_free (struct t_irc_ignore *ignore)
 
     free (ignore);
 
+    irc_ignore_index_free ();
+
     (void) weechat_hook_signal_send ("irc_ignore_removed",
                                      WEECHAT_HOOK_SIGNAL_STRING, NULL);
 }
@@ -345,6 +862,8 @@ irc_ignore_free_all ()
     {
         irc_ignore_free (irc_ignore_list);
     }
+
+    irc_ignore_index_free ();
 }
 
 /*
@@ -22,6 +22,8 @@
 
 #include <regex.h>
 
+#define IRC_IGNORE_CACHE_MAX_SIZE 4096
+
 struct t_irc_server;
 struct t_irc_channel;
 
@@ -36,6 +38,22 @@ struct t_irc_ignore
     struct t_irc_ignore *next_ignore;  /* link to next ignore               */
 };
 
+/*
+ * ignores are indexed by server/channel in groups, and masks of each group are
+ * combined in a single regex (built on first use); the index is rebuilt after
+ * any change in ignores
+ */
+
+struct t_irc_ignore_group
+{
+    struct t_arraylist *ignores;       /* ignores in this group             */
+    int compiled;                      /* 1 if regex have been built        */
+    regex_t *regex;                    /* combined regex for all masks      */
+    regex_t *regex_no_excl;            /* combined regex for masks w/o "!"  */
+    struct t_arraylist *ignores_single; /* ignores with a mask that can not */
+                                       /* be combined: checked one by one   */
+};
+
 extern struct t_irc_ignore *irc_ignore_list;
 extern struct t_irc_ignore *last_irc_ignore;
 
@@ -55,6 +73,7 @@ extern int irc_ignore_check_channel (struct t_irc_ignore *ignore,
                                      const char *nick);
 extern int irc_ignore_check_host (struct t_irc_ignore *ignore,
                                   const char *nick, const char *host);
+extern int irc_ignore_mask_can_be_combined (const char *mask);
 extern int irc_ignore_check (struct t_irc_server *server,
                              const char *channel, const char *nick,
                              const char *host);
@@ -25,6 +25,7 @@
 
 #include "../weechat-plugin.h"
 #include "irc.h"
+#include "irc-batch.h"
 #include "irc-channel.h"
 #include "irc-color.h"
 #include "irc-config.h"
@@ -36,6 +37,7 @@
 #include "irc-protocol.h"
 #include "irc-redirect.h"
 #include "irc-server.h"
+#include "irc-stats.h"
 
 
 /*
@@ -507,6 +509,34 @@ irc_info_info_hashtable_irc_message_split_cb (const void *pointer, void *data,
     return NULL;
 }
 
+/*
+ * Returns IRC info with hashtable "irc_stats".
+ */
+
+struct t_hashtable *
+irc_info_info_hashtable_irc_stats_cb (const void *pointer, void *data,
+                                      const char *info_name,
+                                      struct t_hashtable *hashtable)
+{
+    const char *server;
+    struct t_irc_server *ptr_server;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) info_name;
+
+    if (!hashtable)
+        return NULL;
+
+    server = weechat_hashtable_get (hashtable, "server");
+    ptr_server = (server) ? irc_server_search (server) : NULL;
+    if (!ptr_server)
+        return NULL;
+
+    return irc_stats_to_hashtable (ptr_server);
+}
+
 /*
  * Returns IRC infolist "irc_server".
  */
@@ -1209,6 +1239,30 @@ irc_info_init ()
            "\"args1\" ... \"argsN\": arguments of messages, \"count\": number "
            "of messages"),
         &irc_info_info_hashtable_irc_message_split_cb, NULL, NULL);
+    weechat_hook_info_hashtable (
+        "irc_stats",
+        N_("traffic and processing statistics of an IRC server"),
+        N_("\"server\": server name"),
+        /* TRANSLATORS: please do not translate key names (enclosed by quotes) */
+        N_("\"start_time\": start of statistics, "
+           "\"bytes_recv\", \"bytes_sent\": bytes received/sent, "
+           "\"msgs_recv\", \"msgs_sent\": messages received/sent, "
+           "\"recv_time\": time spent processing received messages "
+           "(microseconds), "
+           "\"outqueue_msgs\", \"outqueue_wait\": messages sent from out "
+           "queue and time spent in queue (milliseconds), "
+           "\"lag_samples\", \"lag\": number and sum of lag measures "
+           "(milliseconds), "
+           "\"redirect_msgs\", \"redirect_time\": messages checked by "
+           "redirects and time spent in redirects (microseconds), "
+           "\"redirects\": number of redirections completed, "
+           "\"command_count_xxx\", \"command_time_xxx\": number of messages "
+           "and processing time for command \"xxx\"; "
+           "all counters are the total since start, with suffix \"_1m\", "
+           "\"_5m\" and \"_15m\" for the last 1, 5 and 15 minutes; "
+           "\"outqueue_depth\": number of messages in out queue, "
+           "\"lag_current\": current lag (milliseconds)"),
+        &irc_info_info_hashtable_irc_stats_cb, NULL, NULL);
 
     /* infolist hooks */
     weechat_hook_infolist (
@@ -1270,6 +1324,12 @@ irc_info_init ()
     weechat_hook_hdata (
         "irc_modelist_item", N_("irc modelist item"),
         &irc_modelist_hdata_item_cb, NULL, NULL);
+    weechat_hook_hdata (
+        "irc_batch", N_("irc batch"),
+        &irc_batch_hdata_batch_cb, NULL, NULL);
+    weechat_hook_hdata (
+        "irc_stats", N_("irc server statistics"),
+        &irc_stats_hdata_stats_cb, NULL, NULL);
     weechat_hook_hdata (
         "irc_channel", N_("irc channel"),
         &irc_channel_hdata_channel_cb, NULL, NULL);
@@ -33,6 +33,10 @@
 #include "irc-modelist.h"
 
 
+/* min size of array/hashtable used to index items of a modelist */
+#define IRC_MODELIST_INDEX_MIN_SIZE 32
+
+
 /*
  * Checks if a modelist pointer is valid for a channel.
  *
@@ -109,6 +113,11 @@ irc_modelist_new (struct t_irc_channel *channel, char type)
     new_modelist->state = IRC_MODELIST_STATE_EMPTY;
     new_modelist->items = NULL;
     new_modelist->last_item = NULL;
+    new_modelist->items_count = 0;
+    new_modelist->items_by_number = NULL;
+    new_modelist->items_by_number_size = 0;
+    new_modelist->masks = NULL;
+    new_modelist->masks_duplicated = 0;
 
     /* add new modelist to channel */
     new_modelist->prev_modelist = channel->last_modelist;
@@ -199,6 +208,44 @@ irc_modelist_item_valid (struct t_irc_modelist *modelist,
     return 0;
 }
 
+/*
+ * Builds the index of items by mask (the index is built on first search by
+ * mask, so that items received in a list (bulk) are not indexed one by one).
+ *
+ * If a mask is in many items, the first item is indexed.
+ */
+
+void
+irc_modelist_item_build_index (struct t_irc_modelist *modelist)
+{
+    struct t_irc_modelist_item *ptr_item;
+
+    if (!modelist)
+        return;
+
+    if (modelist->masks)
+        weechat_hashtable_free (modelist->masks);
+    modelist->masks_duplicated = 0;
+
+    modelist->masks = weechat_hashtable_new (
+        (modelist->items_count > IRC_MODELIST_INDEX_MIN_SIZE) ?
+        modelist->items_count : IRC_MODELIST_INDEX_MIN_SIZE,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_POINTER,
+        NULL, NULL);
+    if (!modelist->masks)
+        return;
+
+    for (ptr_item = modelist->items; ptr_item;
+         ptr_item = ptr_item->next_item)
+    {
+        if (weechat_hashtable_has_key (modelist->masks, ptr_item->mask))
+            modelist->masks_duplicated++;
+        else
+            weechat_hashtable_set (modelist->masks, ptr_item->mask, ptr_item);
+    }
+}
+
 /*
  * Searches for an item by mask.
  *
@@ -213,6 +260,23 @@ irc_modelist_item_search_mask (struct t_irc_modelist *modelist, const char *mask
     if (!modelist || !mask)
         return NULL;
 
+    /*
+     * build index if needed (not while the list is received, and rebuild it
+     * if the number of items is much bigger than the size of hashtable)
+     */
+    if (modelist->state != IRC_MODELIST_STATE_RECEIVING)
+    {
+        if (!modelist->masks
+            || (modelist->items_count > 8 * weechat_hashtable_get_integer (
+                    modelist->masks, "size")))
+        {
+            irc_modelist_item_build_index (modelist);
+        }
+    }
+
+    if (modelist->masks)
+        return weechat_hashtable_get (modelist->masks, mask);
+
     for (ptr_item = modelist->items; ptr_item;
          ptr_item = ptr_item->next_item)
     {
@@ -231,18 +295,74 @@ irc_modelist_item_search_mask (struct t_irc_modelist *modelist, const char *mask
 struct t_irc_modelist_item *
 irc_modelist_item_search_number (struct t_irc_modelist *modelist, int number)
 {
-    struct t_irc_modelist_item *ptr_item;
-
-    if (!modelist)
+    if (!modelist || !modelist->items_by_number
+        || (number < 0) || (number >= modelist->items_by_number_size))
+    {
         return NULL;
+    }
 
-    for (ptr_item = modelist->items; ptr_item;
-         ptr_item = ptr_item->next_item)
+    return modelist->items_by_number[number];
+}
+
+/*
+ * Grows the array of items by number so that it can store an item with
+ * this number.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (memory allocation)
+ */
+
+int
+irc_modelist_item_alloc_number (struct t_irc_modelist *modelist, int number)
+{
+    struct t_irc_modelist_item **new_items_by_number;
+    int new_size;
+
+    if (number < modelist->items_by_number_size)
+        return 1;
+
+    new_size = (modelist->items_by_number_size > 0) ?
+        modelist->items_by_number_size * 2 : IRC_MODELIST_INDEX_MIN_SIZE;
+    while (number >= new_size)
     {
-        if (ptr_item->number == number)
-            return ptr_item;
+        new_size *= 2;
     }
-    return NULL;
+    new_items_by_number = realloc (modelist->items_by_number,
+                                   new_size * sizeof (*new_items_by_number));
+    if (!new_items_by_number)
+        return 0;
+    memset (new_items_by_number + modelist->items_by_number_size, 0,
+            (new_size - modelist->items_by_number_size) *
+            sizeof (*new_items_by_number));
+    modelist->items_by_number = new_items_by_number;
+    modelist->items_by_number_size = new_size;
+
+    return 1;
+}
+
+/*
+ * Sets number of an item (used to restore numbers on /upgrade).
+ */
+
+void
+irc_modelist_item_set_number (struct t_irc_modelist *modelist,
+                              struct t_irc_modelist_item *item, int number)
+{
+    if (!modelist || !item || (number < 0) || (item->number == number))
+        return;
+
+    if (!irc_modelist_item_alloc_number (modelist, number))
+        return;
+
+    if ((item->number >= 0)
+        && (item->number < modelist->items_by_number_size)
+        && (modelist->items_by_number[item->number] == item))
+    {
+        modelist->items_by_number[item->number] = NULL;
+    }
+    item->number = number;
+    modelist->items_by_number[number] = item;
 }
 
 /*
@@ -256,12 +376,16 @@ irc_modelist_item_new (struct t_irc_modelist *modelist,
                        const char *mask, const char *setter, time_t datetime)
 {
     struct t_irc_modelist_item *new_item;
+    int number;
 
     if (!mask)
         return NULL;
 
-    /* alloc memory for new item */
-    if ((new_item = malloc (sizeof (*new_item))) == NULL)
+    number = (modelist->last_item) ? modelist->last_item->number + 1 : 0;
+
+    /* alloc memory for new item (and its slot in array of items) */
+    if (!irc_modelist_item_alloc_number (modelist, number)
+        || ((new_item = malloc (sizeof (*new_item))) == NULL))
     {
         weechat_printf (NULL,
                         _("%s%s: cannot allocate new modelist item"),
@@ -270,8 +394,7 @@ irc_modelist_item_new (struct t_irc_modelist *modelist,
     }
 
     /* initialize new item */
-    new_item->number = (modelist->last_item) ?
-        modelist->last_item->number + 1 : 0;
+    new_item->number = number;
     new_item->mask = strdup (mask);
     new_item->setter = (setter) ? strdup (setter) : NULL;
     new_item->datetime = datetime;
@@ -284,6 +407,17 @@ irc_modelist_item_new (struct t_irc_modelist *modelist,
     else
         modelist->items = new_item;
     modelist->last_item = new_item;
+    modelist->items_count++;
+
+    /* add new item in indexes */
+    modelist->items_by_number[number] = new_item;
+    if (modelist->masks)
+    {
+        if (weechat_hashtable_has_key (modelist->masks, mask))
+            modelist->masks_duplicated++;
+        else
+            weechat_hashtable_set (modelist->masks, mask, new_item);
+    }
 
     if ((modelist->state == IRC_MODELIST_STATE_EMPTY) ||
         (modelist->state == IRC_MODELIST_STATE_RECEIVED))
@@ -303,11 +437,47 @@ void
 irc_modelist_item_free (struct t_irc_modelist *modelist,
                         struct t_irc_modelist_item *item)
 {
-    struct t_irc_modelist_item *new_items;
+    struct t_irc_modelist_item *new_items, *ptr_item;
 
     if (!modelist || !item)
         return;
 
+    /* remove item from indexes */
+    if (modelist->items_by_number
+        && (item->number >= 0)
+        && (item->number < modelist->items_by_number_size)
+        && (modelist->items_by_number[item->number] == item))
+    {
+        modelist->items_by_number[item->number] = NULL;
+    }
+    if (modelist->masks)
+    {
+        if (weechat_hashtable_get (modelist->masks, item->mask) == item)
+        {
+            weechat_hashtable_remove (modelist->masks, item->mask);
+            if (modelist->masks_duplicated > 0)
+            {
+                /* index another item with same mask (if any) */
+                for (ptr_item = modelist->items; ptr_item;
+                     ptr_item = ptr_item->next_item)
+                {
+                    if ((ptr_item != item)
+                        && (strcmp (ptr_item->mask, item->mask) == 0))
+                    {
+                        weechat_hashtable_set (modelist->masks,
+                                               ptr_item->mask, ptr_item);
+                        modelist->masks_duplicated--;
+                        break;
+                    }
+                }
+            }
+        }
+        else if (modelist->masks_duplicated > 0)
+        {
+            modelist->masks_duplicated--;
+        }
+    }
+
     /* remove item from modelist list */
     if (modelist->last_item == item)
         modelist->last_item = item->prev_item;
@@ -330,6 +500,7 @@ irc_modelist_item_free (struct t_irc_modelist *modelist,
     free (item);
 
     modelist->items = new_items;
+    modelist->items_count--;
 
     if (modelist->state == IRC_MODELIST_STATE_RECEIVED)
         modelist->state = IRC_MODELIST_STATE_MODIFIED;
@@ -342,10 +513,25 @@ irc_modelist_item_free (struct t_irc_modelist *modelist,
 void
 irc_modelist_item_free_all (struct t_irc_modelist *modelist)
 {
+    /* indexes are freed first, so that they are not updated for each item */
+    if (modelist->masks)
+    {
+        weechat_hashtable_free (modelist->masks);
+        modelist->masks = NULL;
+    }
+    modelist->masks_duplicated = 0;
+    if (modelist->items_by_number)
+    {
+        free (modelist->items_by_number);
+        modelist->items_by_number = NULL;
+    }
+    modelist->items_by_number_size = 0;
+
     while (modelist->items)
     {
         irc_modelist_item_free (modelist, modelist->items);
     }
+    modelist->items_count = 0;
     modelist->state = IRC_MODELIST_STATE_EMPTY;
 }
 
@@ -398,6 +584,8 @@ irc_modelist_hdata_modelist_cb (const void *pointer, void *data, const char *hda
         WEECHAT_HDATA_VAR(struct t_irc_modelist, state, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_modelist, items, POINTER, 0, NULL, "irc_modelist_item");
         WEECHAT_HDATA_VAR(struct t_irc_modelist, last_item, POINTER, 0, NULL, "irc_modelist_item");
+        WEECHAT_HDATA_VAR(struct t_irc_modelist, items_count, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_modelist, masks, HASHTABLE, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_modelist, prev_modelist, POINTER, 0, NULL, hdata_name);
         WEECHAT_HDATA_VAR(struct t_irc_modelist, next_modelist, POINTER, 0, NULL, hdata_name);
     }
@@ -499,6 +687,14 @@ irc_modelist_print_log (struct t_irc_modelist *modelist)
     weechat_log_printf ("");
     weechat_log_printf ("    => modelist \"%c\" (addr:0x%lx):", modelist->type, modelist);
     weechat_log_printf ("         state. . . . . . . . . . : %d",    modelist->state);
+    weechat_log_printf ("         items_count. . . . . . . : %d",    modelist->items_count);
+    weechat_log_printf ("         items_by_number. . . . . : 0x%lx", modelist->items_by_number);
+    weechat_log_printf ("         items_by_number_size . . : %d",    modelist->items_by_number_size);
+    weechat_log_printf ("         masks. . . . . . . . . . : 0x%lx (%d items)",
+                        modelist->masks,
+                        weechat_hashtable_get_integer (modelist->masks,
+                                                       "items_count"));
+    weechat_log_printf ("         masks_duplicated . . . . : %d",    modelist->masks_duplicated);
     weechat_log_printf ("         prev_modelist  . . . . . : 0x%lx", modelist->prev_modelist);
     weechat_log_printf ("         next_modelist  . . . . . : 0x%lx", modelist->next_modelist);
     for (ptr_item = modelist->items; ptr_item; ptr_item = ptr_item->next_item)
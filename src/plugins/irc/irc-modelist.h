@@ -49,6 +49,14 @@ struct t_irc_modelist
 
     struct t_irc_modelist_item *items;     /* items in modelist             */
     struct t_irc_modelist_item *last_item; /* last item in modelist         */
+    int items_count;                       /* number of items in modelist   */
+    struct t_irc_modelist_item **items_by_number; /* items indexed by number*/
+                                           /* (NULL for removed items)      */
+    int items_by_number_size;              /* size of array items_by_number */
+    struct t_hashtable *masks;             /* index: mask -> item (built    */
+                                           /* on first search by mask)      */
+    int masks_duplicated;                  /* number of masks duplicated in */
+                                           /* items (not in index)          */
 
     struct t_irc_modelist *prev_modelist;  /* pointer to previous modelist  */
     struct t_irc_modelist *next_modelist;  /* pointer to next modelist      */
@@ -66,10 +74,14 @@ extern void irc_modelist_free_all (struct t_irc_channel *channel);
 
 extern int irc_modelist_item_valid (struct t_irc_modelist *modelist,
                                     struct t_irc_modelist_item *item);
+extern void irc_modelist_item_build_index (struct t_irc_modelist *modelist);
 extern struct t_irc_modelist_item *irc_modelist_item_search_mask (struct t_irc_modelist *modelist,
                                                                   const char *mask);
 extern struct t_irc_modelist_item *irc_modelist_item_search_number (struct t_irc_modelist *modelist,
                                                                     int number);
+extern void irc_modelist_item_set_number (struct t_irc_modelist *modelist,
+                                          struct t_irc_modelist_item *item,
+                                          int number);
 extern struct t_irc_modelist_item *irc_modelist_item_new (struct t_irc_modelist *modelist,
                                                           const char *mask,
                                                           const char *setter,
@@ -35,6 +35,11 @@
 #include "irc-channel.h"
 
 
+/* colors of nicks not in a channel, most recently used first */
+struct t_irc_nick_color_cache irc_nick_color_cache[IRC_NICK_COLOR_CACHE_SIZE];
+int irc_nick_color_cache_count = 0;
+
+
 /*
  * Checks if a nick pointer is valid.
  *
@@ -156,6 +161,131 @@ irc_nick_find_color_name (const char *nickname)
     return weechat_info_get ("nick_color_name", nickname);
 }
 
+/*
+ * Finds a color code for a nick which is not in a channel (for example in
+ * private buffers), using a cache of the last nicks used.
+ *
+ * The string returned is valid until IRC_NICK_COLOR_CACHE_SIZE other nicks
+ * are added in cache or until the cache is flushed.
+ *
+ * Returns a WeeChat color code (that can be used for display).
+ */
+
+const char *
+irc_nick_find_color_cached (const char *nickname)
+{
+    struct t_irc_nick_color_cache entry;
+    int i;
+
+    if (!nickname)
+        return NULL;
+
+    for (i = 0; i < irc_nick_color_cache_count; i++)
+    {
+        if (strcmp (irc_nick_color_cache[i].nickname, nickname) == 0)
+        {
+            /* move entry to the beginning of cache */
+            if (i > 0)
+            {
+                entry = irc_nick_color_cache[i];
+                memmove (&irc_nick_color_cache[1],
+                         &irc_nick_color_cache[0],
+                         i * sizeof (irc_nick_color_cache[0]));
+                irc_nick_color_cache[0] = entry;
+            }
+            return irc_nick_color_cache[0].color;
+        }
+    }
+
+    entry.nickname = strdup (nickname);
+    entry.color = irc_nick_find_color (nickname);
+    if (!entry.nickname || !entry.color)
+    {
+        if (entry.nickname)
+            free (entry.nickname);
+        if (entry.color)
+            free (entry.color);
+        return IRC_COLOR_CHAT_NICK;
+    }
+
+    /* cache full? remove the least recently used nick */
+    if (irc_nick_color_cache_count == IRC_NICK_COLOR_CACHE_SIZE)
+    {
+        irc_nick_color_cache_count--;
+        free (irc_nick_color_cache[irc_nick_color_cache_count].nickname);
+        free (irc_nick_color_cache[irc_nick_color_cache_count].color);
+    }
+
+    /* add nick at the beginning of cache */
+    memmove (&irc_nick_color_cache[1],
+             &irc_nick_color_cache[0],
+             irc_nick_color_cache_count * sizeof (irc_nick_color_cache[0]));
+    irc_nick_color_cache[0] = entry;
+    irc_nick_color_cache_count++;
+
+    return entry.color;
+}
+
+/*
+ * Flushes the cache of nick colors (called when options changing nick colors
+ * are changed).
+ */
+
+void
+irc_nick_color_cache_flush ()
+{
+    int i;
+
+    for (i = 0; i < irc_nick_color_cache_count; i++)
+    {
+        free (irc_nick_color_cache[i].nickname);
+        free (irc_nick_color_cache[i].color);
+    }
+    irc_nick_color_cache_count = 0;
+}
+
+/*
+ * Resets the nick displayed in prefix (it will be computed again on next
+ * message displayed).
+ */
+
+void
+irc_nick_reset_as_prefix (struct t_irc_nick *nick)
+{
+    if (nick && nick->as_prefix)
+    {
+        free (nick->as_prefix);
+        nick->as_prefix = NULL;
+    }
+}
+
+/*
+ * Resets the nick displayed in prefix for all nicks of all servers and
+ * channels (called when options changing display of nicks are changed).
+ */
+
+void
+irc_nick_reset_as_prefix_all ()
+{
+    struct t_irc_server *ptr_server;
+    struct t_irc_channel *ptr_channel;
+    struct t_irc_nick *ptr_nick;
+
+    for (ptr_server = irc_servers; ptr_server;
+         ptr_server = ptr_server->next_server)
+    {
+        for (ptr_channel = ptr_server->channels; ptr_channel;
+             ptr_channel = ptr_channel->next_channel)
+        {
+            for (ptr_nick = ptr_channel->nicks; ptr_nick;
+                 ptr_nick = ptr_nick->next_nick)
+            {
+                irc_nick_reset_as_prefix (ptr_nick);
+            }
+        }
+    }
+}
+
 /*
  * Sets current prefix, using higher prefix set in prefixes.
  */
@@ -168,6 +298,8 @@ irc_nick_set_current_prefix (struct t_irc_nick *nick)
     if (!nick)
         return;
 
+    irc_nick_reset_as_prefix (nick);
+
     nick->prefix[0] = ' ';
     for (ptr_prefixes = nick->prefixes; ptr_prefixes[0]; ptr_prefixes++)
     {
@@ -521,6 +653,55 @@ irc_nick_nicklist_set_color_all ()
     }
 }
 
+/*
+ * Adds a nick in hashtable of nicks for a channel (key is the nick converted
+ * to lower case using casemapping of server).
+ */
+
+void
+irc_nick_hashtable_add (struct t_irc_server *server,
+                        struct t_irc_channel *channel,
+                        struct t_irc_nick *nick)
+{
+    char *name_lower;
+
+    if (!channel || !nick || !nick->name)
+        return;
+
+    name_lower = irc_server_string_tolower (server, nick->name);
+    if (name_lower)
+    {
+        weechat_hashtable_set (channel->nicks_hashtable, name_lower, nick);
+        free (name_lower);
+    }
+}
+
+/*
+ * Removes a nick from hashtable of nicks for a channel.
+ */
+
+void
+irc_nick_hashtable_remove (struct t_irc_server *server,
+                           struct t_irc_channel *channel,
+                           struct t_irc_nick *nick)
+{
+    char *name_lower;
+
+    if (!channel || !nick || !nick->name)
+        return;
+
+    name_lower = irc_server_string_tolower (server, nick->name);
+    if (name_lower)
+    {
+        if (weechat_hashtable_get (channel->nicks_hashtable,
+                                   name_lower) == nick)
+        {
+            weechat_hashtable_remove (channel->nicks_hashtable, name_lower);
+        }
+        free (name_lower);
+    }
+}
+
 /*
  * Adds a new nick in channel.
  *
@@ -590,6 +771,7 @@ irc_nick_new (struct t_irc_server *server, struct t_irc_channel *channel,
     new_nick->prefixes[length] = '\0';
     new_nick->prefix[0] = ' ';
     new_nick->prefix[1] = '\0';
+    new_nick->as_prefix = NULL;
     irc_nick_set_prefixes (server, new_nick, prefixes);
     new_nick->away = away;
     if (irc_server_strcasecmp (server, new_nick->name, server->nick) == 0)
@@ -605,6 +787,7 @@ irc_nick_new (struct t_irc_server *server, struct t_irc_channel *channel,
         channel->nicks = new_nick;
     channel->last_nick = new_nick;
     new_nick->next_nick = NULL;
+    irc_nick_hashtable_add (server, channel, new_nick);
 
     channel->nicks_count++;
 
@@ -633,18 +816,22 @@ irc_nick_change (struct t_irc_server *server, struct t_irc_channel *channel,
     /* update nicks speaking */
     nick_is_me = (irc_server_strcasecmp (server, new_nick, server->nick) == 0) ? 1 : 0;
     if (!nick_is_me)
-        irc_channel_nick_speaking_rename (channel, nick->name, new_nick);
+        irc_channel_nick_speaking_rename (server, channel, nick->name,
+                                          new_nick);
 
     /* change nickname */
+    irc_nick_hashtable_remove (server, channel, nick);
     if (nick->name)
         free (nick->name);
     nick->name = strdup (new_nick);
+    irc_nick_hashtable_add (server, channel, nick);
     if (nick->color)
         free (nick->color);
     if (nick_is_me)
         nick->color = strdup (IRC_COLOR_CHAT_NICK_SELF);
     else
         nick->color = irc_nick_find_color (nick->name);
+    irc_nick_reset_as_prefix (nick);
 
     /* add nick in nicklist */
     irc_nick_nicklist_add (server, channel, nick);
@@ -702,6 +889,8 @@ irc_nick_realloc_prefixes (struct t_irc_server *server,
         for (ptr_nick = ptr_channel->nicks; ptr_nick;
              ptr_nick = ptr_nick->next_nick)
         {
+            /* color of prefix depends on prefixes of server */
+            irc_nick_reset_as_prefix (ptr_nick);
             if (ptr_nick->prefixes)
             {
                 new_prefixes = realloc (ptr_nick->prefixes, new_length + 1);
@@ -747,6 +936,7 @@ irc_nick_free (struct t_irc_server *server, struct t_irc_channel *channel,
     irc_nick_nicklist_remove (server, channel, nick);
 
     /* remove nick */
+    irc_nick_hashtable_remove (server, channel, nick);
     if (channel->last_nick == nick)
         channel->last_nick = nick->prev_nick;
     if (nick->prev_nick)
@@ -777,6 +967,8 @@ irc_nick_free (struct t_irc_server *server, struct t_irc_channel *channel,
         free (nick->realname);
     if (nick->color)
         free (nick->color);
+    if (nick->as_prefix)
+        free (nick->as_prefix);
 
     free (nick);
 
@@ -818,19 +1010,20 @@ irc_nick_search (struct t_irc_server *server, struct t_irc_channel *channel,
                  const char *nickname)
 {
     struct t_irc_nick *ptr_nick;
+    char *name_lower;
 
     if (!channel || !nickname)
         return NULL;
 
-    for (ptr_nick = channel->nicks; ptr_nick;
-         ptr_nick = ptr_nick->next_nick)
-    {
-        if (irc_server_strcasecmp (server, ptr_nick->name, nickname) == 0)
-            return ptr_nick;
-    }
+    name_lower = irc_server_string_tolower (server, nickname);
+    if (!name_lower)
+        return NULL;
 
-    /* nick not found */
-    return NULL;
+    ptr_nick = weechat_hashtable_get (channel->nicks_hashtable, name_lower);
+
+    free (name_lower);
+
+    return ptr_nick;
 }
 
 /*
@@ -946,6 +1139,9 @@ irc_nick_mode_for_display (struct t_irc_server *server, struct t_irc_nick *nick,
 /*
  * Returns string with nick to display as prefix on buffer (returned string ends
  * by a tab).
+ *
+ * The string is cached in the nick if it is displayed with its own color
+ * (the cache is reset when the nick, its prefix or options change).
  */
 
 const char *
@@ -953,24 +1149,36 @@ irc_nick_as_prefix (struct t_irc_server *server, struct t_irc_nick *nick,
                     const char *nickname, const char *force_color)
 {
     static char result[256];
-    char *color;
+    const char *color;
+    int use_cache;
+
+    /* cache is used for a nick in channel displayed with its own color */
+    use_cache = (nick
+                 && (!force_color
+                     || (nick->color && (strcmp (force_color, nick->color) == 0))));
+    if (use_cache && nick->as_prefix)
+        return nick->as_prefix;
 
     if (force_color)
-        color = strdup (force_color);
+        color = force_color;
     else if (nick)
-        color = strdup (nick->color);
+        color = nick->color;
     else if (nickname)
-        color = irc_nick_find_color (nickname);
+        color = irc_nick_find_color_cached (nickname);
     else
-        color = strdup (IRC_COLOR_CHAT_NICK);
+        color = IRC_COLOR_CHAT_NICK;
 
     snprintf (result, sizeof (result), "%s%s%s\t",
               irc_nick_mode_for_display (server, nick, 1),
               color,
               (nick) ? nick->name : nickname);
 
-    if (color)
-        free (color);
+    if (use_cache)
+    {
+        nick->as_prefix = strdup (result);
+        if (nick->as_prefix)
+            return nick->as_prefix;
+    }
 
     return result;
 }
@@ -983,10 +1191,6 @@ const char *
 irc_nick_color_for_msg (struct t_irc_server *server, int server_message,
                         struct t_irc_nick *nick, const char *nickname)
 {
-    static char color[16][64];
-    static int index_color = 0;
-    char *color_found;
-
     if (server_message
         && !weechat_config_boolean (irc_config_look_color_nicks_in_server_messages))
     {
@@ -1003,14 +1207,7 @@ irc_nick_color_for_msg (struct t_irc_server *server, int server_message,
         {
             return IRC_COLOR_CHAT_NICK_SELF;
         }
-        color_found = irc_nick_find_color (nickname);
-        index_color = (index_color + 1) % 16;
-        snprintf (color[index_color], sizeof (color[index_color]),
-                  "%s",
-                  color_found);
-        if (color_found)
-            free (color_found);
-        return color[index_color];
+        return irc_nick_find_color_cached (nickname);
     }
 
     return IRC_COLOR_CHAT_NICK;
@@ -1183,6 +1380,17 @@ irc_nick_print_log (struct t_irc_nick *nick)
     weechat_log_printf ("         account. . . . : '%s'",  nick->account);
     weechat_log_printf ("         realname . . . : '%s'",  nick->realname);
     weechat_log_printf ("         color. . . . . : '%s'",  nick->color);
+    weechat_log_printf ("         as_prefix. . . : '%s'",  nick->as_prefix);
     weechat_log_printf ("         prev_nick. . . : 0x%lx", nick->prev_nick);
     weechat_log_printf ("         next_nick. . . : 0x%lx", nick->next_nick);
 }
+
+/*
+ * Ends nicks (frees the cache of nick colors).
+ */
+
+void
+irc_nick_end ()
+{
+    irc_nick_color_cache_flush ();
+}
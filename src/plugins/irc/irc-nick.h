@@ -28,6 +28,9 @@
 #define IRC_NICK_GROUP_OTHER_NUMBER 999
 #define IRC_NICK_GROUP_OTHER_NAME   "..."
 
+/* number of colors cached for nicks which are not in a channel */
+#define IRC_NICK_COLOR_CACHE_SIZE 32
+
 struct t_irc_server;
 struct t_irc_channel;
 
@@ -42,15 +45,30 @@ struct t_irc_nick
     char *account;                  /* account name of the user              */
     char *realname;                 /* realname (aka gecos) of the user      */
     char *color;                    /* color for nickname                    */
+    char *as_prefix;                /* cached nick for display in prefix     */
+                                    /* (NULL if not computed yet)            */
     struct t_irc_nick *prev_nick;   /* link to previous nick on channel      */
     struct t_irc_nick *next_nick;   /* link to next nick on channel          */
 };
 
+struct t_irc_nick_color_cache
+{
+    char *nickname;                 /* nickname                              */
+    char *color;                    /* color for nickname                    */
+};
+
+extern struct t_irc_nick_color_cache irc_nick_color_cache[];
+extern int irc_nick_color_cache_count;
+
 extern int irc_nick_valid (struct t_irc_channel *channel,
                            struct t_irc_nick *nick);
 extern int irc_nick_is_nick (struct t_irc_server *server, const char *string);
 extern char *irc_nick_find_color (const char *nickname);
 extern char *irc_nick_find_color_name (const char *nickname);
+extern const char *irc_nick_find_color_cached (const char *nickname);
+extern void irc_nick_color_cache_flush ();
+extern void irc_nick_reset_as_prefix (struct t_irc_nick *nick);
+extern void irc_nick_reset_as_prefix_all ();
 extern void irc_nick_set_host (struct t_irc_nick *nick, const char *host);
 extern int irc_nick_is_op (struct t_irc_server *server,
                            struct t_irc_nick *nick);
@@ -61,6 +79,12 @@ extern const char *irc_nick_get_prefix_color_name (struct t_irc_server *server,
                                                    char prefix);
 extern void irc_nick_nicklist_set_prefix_color_all ();
 extern void irc_nick_nicklist_set_color_all ();
+extern void irc_nick_hashtable_add (struct t_irc_server *server,
+                                    struct t_irc_channel *channel,
+                                    struct t_irc_nick *nick);
+extern void irc_nick_hashtable_remove (struct t_irc_server *server,
+                                       struct t_irc_channel *channel,
+                                       struct t_irc_nick *nick);
 extern struct t_irc_nick *irc_nick_new (struct t_irc_server *server,
                                         struct t_irc_channel *channel,
                                         const char *nickname,
@@ -112,5 +136,6 @@ extern struct t_hdata *irc_nick_hdata_nick_cb (const void *pointer,
 extern int irc_nick_add_to_infolist (struct t_infolist *infolist,
                                      struct t_irc_nick *nick);
 extern void irc_nick_print_log (struct t_irc_nick *nick);
+extern void irc_nick_end ();
 
 #endif /* WEECHAT_PLUGIN_IRC_NICK_H */
@@ -21,15 +21,6 @@
  * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-/* this define is needed for strptime() (not on OpenBSD/Sun) */
-#if !defined(__OpenBSD__) && !defined(__sun)
-#define _XOPEN_SOURCE 700
-#endif
-
-#ifndef __USE_XOPEN
-#define __USE_XOPEN
-#endif
-
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -55,6 +46,7 @@
 #include "irc-nick.h"
 #include "irc-sasl.h"
 #include "irc-server.h"
+#include "irc-stats.h"
 #include "irc-notify.h"
 
 
@@ -200,122 +192,367 @@ irc_protocol_nick_address (struct t_irc_server *server,
 }
 
 /*
- * Returns hashtable with tags for an IRC message.
+ * Splits tags of an IRC message (without the leading "@"), without any memory
+ * allocation: keys and values in "message_tags" point to the string "tags".
+ *
+ * If length is < 0, the tags string must be null-terminated, otherwise it
+ * is the size of tags string (in bytes).
  *
- * Example:
- *   if tags == "aaa=bbb;ccc;example.com/ddd=eee",
- *   hashtable will have following keys/values:
- *     "aaa" => "bbb"
- *     "ccc" => NULL
- *     "example.com/ddd" => "eee"
+ * At most "max_tags" tags are stored in "message_tags" (which can be NULL to
+ * just count tags).
+ *
+ * Returns the number of tags found (can be greater than max_tags).
  */
 
-struct t_hashtable *
-irc_protocol_get_message_tags (const char *tags)
+int
+irc_protocol_tags_split (const char *tags, int length,
+                         struct t_irc_protocol_tag *message_tags,
+                         int max_tags)
 {
-    struct t_hashtable *hashtable;
-    char **items, *pos, *key;
-    int num_items, i;
+    const char *ptr_tags, *end, *pos_end, *pos_equal;
+    int num_tags;
 
-    if (!tags || !tags[0])
-        return NULL;
+    if (!tags)
+        return 0;
 
-    hashtable = weechat_hashtable_new (32,
-                                       WEECHAT_HASHTABLE_STRING,
-                                       WEECHAT_HASHTABLE_STRING,
-                                       NULL, NULL);
-    if (!hashtable)
-        return NULL;
+    end = tags + ((length < 0) ? (int)strlen (tags) : length);
 
-    items = weechat_string_split (tags, ";", NULL,
-                                  WEECHAT_STRING_SPLIT_STRIP_LEFT
-                                  | WEECHAT_STRING_SPLIT_STRIP_RIGHT
-                                  | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
-                                  0, &num_items);
-    if (items)
+    num_tags = 0;
+    ptr_tags = tags;
+    while (ptr_tags < end)
     {
-        for (i = 0; i < num_items; i++)
+        pos_end = memchr (ptr_tags, ';', end - ptr_tags);
+        if (!pos_end)
+            pos_end = end;
+        if (pos_end > ptr_tags)
         {
-            pos = strchr (items[i], '=');
-            if (pos)
+            if (message_tags && (num_tags < max_tags))
             {
-                /* format: "tag=value" */
-                key = weechat_strndup (items[i], pos - items[i]);
-                if (key)
+                pos_equal = memchr (ptr_tags, '=', pos_end - ptr_tags);
+                message_tags[num_tags].key = ptr_tags;
+                if (pos_equal)
                 {
-                    weechat_hashtable_set (hashtable, key, pos + 1);
-                    free (key);
+                    /* format: "tag=value" */
+                    message_tags[num_tags].key_size = pos_equal - ptr_tags;
+                    message_tags[num_tags].value = pos_equal + 1;
+                    message_tags[num_tags].value_size = pos_end - pos_equal - 1;
+                }
+                else
+                {
+                    /* format: "tag" */
+                    message_tags[num_tags].key_size = pos_end - ptr_tags;
+                    message_tags[num_tags].value = NULL;
+                    message_tags[num_tags].value_size = 0;
                 }
             }
-            else
+            num_tags++;
+        }
+        ptr_tags = pos_end + 1;
+    }
+
+    return num_tags;
+}
+
+/*
+ * Searches a tag by key in tags of a message (if the key is there many times,
+ * the last one is returned).
+ *
+ * Returns pointer to tag found, NULL if not found.
+ */
+
+const struct t_irc_protocol_tag *
+irc_protocol_tags_search (const struct t_irc_protocol_tag *message_tags,
+                          int num_tags, const char *key)
+{
+    int i, length;
+
+    if (!message_tags || !key)
+        return NULL;
+
+    length = strlen (key);
+
+    for (i = num_tags - 1; i >= 0; i--)
+    {
+        if ((message_tags[i].key_size == length)
+            && (memcmp (message_tags[i].key, key, length) == 0))
+        {
+            return &message_tags[i];
+        }
+    }
+
+    /* tag not found */
+    return NULL;
+}
+
+/*
+ * Unescapes value of a tag (see
+ * https://ircv3.net/specs/extensions/message-tags#escaping-values).
+ *
+ * Returns unescaped value, NULL if the tag has no value.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+irc_protocol_tag_value_unescape (const struct t_irc_protocol_tag *tag)
+{
+    char *value;
+    int i, j;
+
+    if (!tag || !tag->value)
+        return NULL;
+
+    value = malloc (tag->value_size + 1);
+    if (!value)
+        return NULL;
+
+    j = 0;
+    for (i = 0; i < tag->value_size; i++)
+    {
+        if (tag->value[i] == '\\')
+        {
+            i++;
+            if (i >= tag->value_size)
+                break;
+            switch (tag->value[i])
             {
-                /* format: "tag" */
-                weechat_hashtable_set (hashtable, items[i], NULL);
+                case ':':
+                    value[j++] = ';';
+                    break;
+                case 's':
+                    value[j++] = ' ';
+                    break;
+                case 'r':
+                    value[j++] = '\r';
+                    break;
+                case 'n':
+                    value[j++] = '\n';
+                    break;
+                default:
+                    value[j++] = tag->value[i];
+                    break;
             }
         }
-        weechat_string_free_split (items);
+        else
+        {
+            value[j++] = tag->value[i];
+        }
     }
+    value[j] = '\0';
 
-    return hashtable;
+    return value;
 }
 
 /*
- * Parses date/time received in a "time" tag.
+ * Parses an unsigned integer with at least one digit and at most "max_digits"
+ * digits.
  *
- * Returns value of time (timestamp), 0 if error.
+ * Returns number of digits read (0 if error), the integer is stored in
+ * "value".
  */
 
-time_t
-irc_protocol_parse_time (const char *time)
+int
+irc_protocol_parse_time_int (const char *string, const char *end,
+                             int max_digits, int *value)
 {
-    time_t time_value, time_msg, time_gm, time_local;
-    struct tm tm_date, tm_date_gm, tm_date_local;
-    long value;
-    char *time2, *pos, *error;
+    int digits;
+
+    *value = 0;
+    digits = 0;
+    while ((string + digits < end) && (digits < max_digits)
+           && isdigit ((unsigned char)string[digits]))
+    {
+        *value = (*value * 10) + (string[digits] - '0');
+        digits++;
+    }
+
+    return digits;
+}
+
+/*
+ * Parses date/time received in a "time" tag, with millisecond precision.
+ *
+ * Formats supported:
+ *   - ISO 8601: "2012-11-24T07:41:02.018Z" (with optional fraction of
+ *     seconds, and optional time zone: "Z", "+hh:mm", "+hhmm" or "+hh"),
+ *   - timestamp: "1353403519.478".
+ *
+ * If length is < 0, the time string must be null-terminated, otherwise it
+ * is the size of time string (in bytes).
+ *
+ * Returns:
+ *   1: OK, date/time is stored in "tv"
+ *   0: error
+ */
+
+int
+irc_protocol_parse_time_tv (const char *time, int length, struct timeval *tv)
+{
+    const char *ptr_time, *end;
+    int year, month, day, hour, min, sec, usec, digits, sign, tz_hour, tz_min;
+    long long days, value;
+
+    if (!time || !tv)
+        return 0;
+
+    tv->tv_sec = 0;
+    tv->tv_usec = 0;
 
-    if (!time || !time[0])
+    end = time + ((length < 0) ? (int)strlen (time) : length);
+    if (end <= time)
         return 0;
 
-    time_value = 0;
+    ptr_time = time;
 
-    if (strchr (time, '-'))
+    /* timestamp format: "1353403519.478" */
+    if (!memchr (time, '-', end - time))
     {
-        /* date is with ISO 8601 format: "2012-11-24T07:41:02.018Z" */
-        /* initialize structure, because strptime does not do it */
-        memset (&tm_date, 0, sizeof (struct tm));
-        if (strptime (time, "%Y-%m-%dT%H:%M:%S", &tm_date))
+        value = 0;
+        while ((ptr_time < end) && isdigit ((unsigned char)ptr_time[0]))
+        {
+            value = (value * 10) + (ptr_time[0] - '0');
+            if (value > 0x7FFFFFFFLL)
+                return 0;
+            ptr_time++;
+        }
+        if ((ptr_time == time)
+            || ((ptr_time < end) && (ptr_time[0] != '.')
+                && (ptr_time[0] != ',')))
+        {
+            return 0;
+        }
+        usec = 0;
+        if (ptr_time < end)
         {
-            if (tm_date.tm_year > 0)
+            ptr_time++;
+            digits = irc_protocol_parse_time_int (ptr_time, end, 6, &usec);
+            for (; digits < 6; digits++)
             {
-                time_msg = mktime (&tm_date);
-                gmtime_r (&time_msg, &tm_date_gm);
-                localtime_r (&time_msg, &tm_date_local);
-                time_gm = mktime (&tm_date_gm);
-                time_local = mktime (&tm_date_local);
-                time_value = mktime (&tm_date_local) + (time_local - time_gm);
+                usec *= 10;
             }
         }
+        tv->tv_sec = (time_t)value;
+        tv->tv_usec = usec;
+        return 1;
     }
-    else
+
+    /* ISO 8601 format: "2012-11-24T07:41:02.018Z" */
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 4, &year))
+        || (digits != 4))
+    {
+        return 0;
+    }
+    ptr_time += digits;
+    if ((ptr_time >= end) || (ptr_time[0] != '-'))
+        return 0;
+    ptr_time++;
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 2, &month)))
+        return 0;
+    ptr_time += digits;
+    if ((ptr_time >= end) || (ptr_time[0] != '-'))
+        return 0;
+    ptr_time++;
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 2, &day)))
+        return 0;
+    ptr_time += digits;
+    if ((ptr_time >= end) || ((ptr_time[0] != 'T') && (ptr_time[0] != 't')
+                              && (ptr_time[0] != ' ')))
+    {
+        return 0;
+    }
+    ptr_time++;
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 2, &hour)))
+        return 0;
+    ptr_time += digits;
+    if ((ptr_time >= end) || (ptr_time[0] != ':'))
+        return 0;
+    ptr_time++;
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 2, &min)))
+        return 0;
+    ptr_time += digits;
+    if ((ptr_time >= end) || (ptr_time[0] != ':'))
+        return 0;
+    ptr_time++;
+    if (!(digits = irc_protocol_parse_time_int (ptr_time, end, 2, &sec)))
+        return 0;
+    ptr_time += digits;
+
+    if ((year <= 1900) || (month < 1) || (month > 12) || (day < 1)
+        || (day > 31) || (hour > 23) || (min > 59) || (sec > 60))
     {
-        /* date is with timestamp format: "1353403519.478" */
-        time2 = strdup (time);
-        if (time2)
+        return 0;
+    }
+
+    /* optional fraction of seconds */
+    usec = 0;
+    if ((ptr_time < end) && ((ptr_time[0] == '.') || (ptr_time[0] == ',')))
+    {
+        ptr_time++;
+        digits = irc_protocol_parse_time_int (ptr_time, end, 6, &usec);
+        ptr_time += digits;
+        for (; digits < 6; digits++)
+        {
+            usec *= 10;
+        }
+        /* ignore extra digits (below microsecond) */
+        while ((ptr_time < end) && isdigit ((unsigned char)ptr_time[0]))
         {
-            pos = strchr (time2, '.');
-            if (pos)
-                pos[0] = '\0';
-            pos = strchr (time2, ',');
-            if (pos)
-                pos[0] = '\0';
-            value = strtol (time2, &error, 10);
-            if (error && !error[0] && (value >= 0))
-                time_value = (int)value;
-            free (time2);
+            ptr_time++;
         }
     }
 
-    return time_value;
+    /* optional time zone (UTC if not specified) */
+    tz_hour = 0;
+    tz_min = 0;
+    sign = 0;
+    if ((ptr_time < end) && ((ptr_time[0] == '+') || (ptr_time[0] == '-')))
+    {
+        sign = (ptr_time[0] == '+') ? 1 : -1;
+        ptr_time++;
+        digits = irc_protocol_parse_time_int (ptr_time, end, 2, &tz_hour);
+        if (digits != 2)
+            return 0;
+        ptr_time += digits;
+        if ((ptr_time < end) && (ptr_time[0] == ':'))
+            ptr_time++;
+        digits = irc_protocol_parse_time_int (ptr_time, end, 2, &tz_min);
+        ptr_time += digits;
+    }
+
+    /* days since 1970-01-01 (algorithm "days from civil" of H. Hinnant) */
+    if (month <= 2)
+        year--;
+    days = (long long)(year / 400) * 146097
+        + (((year % 400) * 365) + ((year % 400) / 4) - ((year % 400) / 100))
+        + ((153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5) + day - 1
+        - 719468;
+
+    value = (days * 86400) + (hour * 3600) + (min * 60) + sec
+        - (sign * ((tz_hour * 3600) + (tz_min * 60)));
+    if (value < 0)
+        return 0;
+
+    tv->tv_sec = (time_t)value;
+    tv->tv_usec = usec;
+
+    return 1;
+}
+
+/*
+ * Parses date/time received in a "time" tag.
+ *
+ * Returns value of time (timestamp), 0 if error.
+ */
+
+time_t
+irc_protocol_parse_time (const char *time)
+{
+    struct timeval tv;
+
+    if (!irc_protocol_parse_time_tv (time, -1, &tv))
+        return 0;
+
+    return tv.tv_sec;
 }
 
 /*
@@ -498,6 +735,24 @@ IRC_PROTOCOL_CALLBACK(away)
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Callback for the IRC message "BATCH" (with capability "batch").
+ *
+ * Batches are started and ended in irc-batch.c (when the message is received,
+ * with its tags), so there's nothing to do here.
+ *
+ * Message looks like:
+ *   :server BATCH +ref chathistory #channel
+ *   :server BATCH -ref
+ */
+
+IRC_PROTOCOL_CALLBACK(batch)
+{
+    IRC_PROTOCOL_MIN_ARGS(3);
+
+    return WEECHAT_RC_OK;
+}
+
 /*
  * Callback for IRC server capabilities string hashtable map.
  */
@@ -1345,6 +1600,10 @@ IRC_PROTOCOL_CALLBACK(join)
         ptr_channel->checking_whox = 0;
     }
 
+    /* fetch history of channel (before the join is displayed) */
+    if (local_join)
+        irc_channel_fetch_history (server, ptr_channel);
+
     /* add nick in channel */
     ptr_nick = irc_nick_new (server, ptr_channel, nick, address, NULL, 0,
                              (pos_account) ? pos_account : NULL,
@@ -1781,8 +2040,10 @@ IRC_PROTOCOL_CALLBACK(nick)
                 if ((irc_server_strcasecmp (server, ptr_channel->name, nick) == 0)
                     && !irc_channel_search (server, new_nick))
                 {
+                    irc_channel_hashtable_remove (server, ptr_channel);
                     free (ptr_channel->name);
                     ptr_channel->name = strdup (new_nick);
+                    irc_channel_hashtable_add (server, ptr_channel);
                     if (ptr_channel->pv_remote_nick_color)
                     {
                         free (ptr_channel->pv_remote_nick_color);
@@ -1869,7 +2130,8 @@ IRC_PROTOCOL_CALLBACK(nick)
                                 new_nick,
                                 IRC_COLOR_RESET);
                         }
-                        irc_channel_nick_speaking_rename (ptr_channel,
+                        irc_channel_nick_speaking_rename (server,
+                                                          ptr_channel,
                                                           nick, new_nick);
                         irc_channel_nick_speaking_time_rename (server,
                                                                ptr_channel,
@@ -2355,6 +2617,8 @@ IRC_PROTOCOL_CALLBACK(pong)
         gettimeofday (&tv, NULL);
         server->lag = (int)(weechat_util_timeval_diff (&(server->lag_check_time),
                                                        &tv) / 1000);
+        irc_stats_add (server->stats, IRC_STATS_LAG_SAMPLES, 1);
+        irc_stats_add (server->stats, IRC_STATS_LAG, server->lag);
 
         /* schedule next lag check */
         server->lag_check_time.tv_sec = 0;
@@ -2500,6 +2764,7 @@ IRC_PROTOCOL_CALLBACK(privmsg)
             }
 
             irc_channel_nick_speaking_add (
+                server,
                 ptr_channel,
                 nick,
                 weechat_string_has_highlight (pos_args,
@@ -2994,12 +3259,18 @@ IRC_PROTOCOL_CALLBACK(001)
     server->is_connected = 1;
     server->reconnect_delay = 0;
     server->monitor_time = time (NULL) + 5;
+    server->login_duration = irc_server_elapsed_ms (&server->connect_start);
+    if ((server->login_duration >= 0) && (server->connect_duration >= 0))
+        server->login_duration -= server->connect_duration;
 
     if (server->hook_timer_connection)
     {
         weechat_unhook (server->hook_timer_connection);
         server->hook_timer_connection = NULL;
     }
+
+    /* a connection slot is free: start pending connections (if any) */
+    irc_server_connect_pending (time (NULL));
     server->lag_next_check = time (NULL) +
         weechat_config_integer (irc_config_network_lag_check);
     irc_server_set_buffer_title (server);
@@ -3177,8 +3448,11 @@ IRC_PROTOCOL_CALLBACK(005)
         if (pos2)
             pos2[0] = '\0';
         casemapping = irc_server_search_casemapping (pos);
-        if (casemapping >= 0)
+        if ((casemapping >= 0) && (casemapping != server->casemapping))
+        {
             server->casemapping = casemapping;
+            irc_channel_rebuild_hashtables (server);
+        }
         if (pos2)
             pos2[0] = ' ';
     }
@@ -6439,7 +6713,7 @@ irc_protocol_recv_command (struct t_irc_server *server,
 {
     int i, cmd_found, return_code, argc, decode_color, keep_trailing_spaces;
     int message_ignored, flags;
-    char *message_colors_decoded, *pos_space, *tags;
+    char *message_colors_decoded, *pos_space;
     struct t_irc_channel *ptr_channel;
     t_irc_recv_func *cmd_recv_func;
     const char *cmd_name, *ptr_msg_after_tags;
@@ -6447,11 +6721,16 @@ irc_protocol_recv_command (struct t_irc_server *server,
     const char *nick1, *address1, *host1;
     char *nick, *address, *address_color, *host, *host_no_color, *host_color;
     char **argv, **argv_eol;
-    struct t_hashtable *hash_tags;
+    struct t_irc_protocol_tag tags_stack[IRC_PROTOCOL_TAGS_MAX];
+    struct t_irc_protocol_tag *message_tags;
+    const struct t_irc_protocol_tag *ptr_tag;
+    int num_tags;
+    struct timeval tv_date;
     struct t_irc_protocol_msg irc_protocol_messages[] =
         { { "account", /* account (cap account-notify) */ 1, 0, &irc_protocol_cb_account },
           { "authenticate", /* authenticate */ 1, 0, &irc_protocol_cb_authenticate },
           { "away", /* away (cap away-notify) */ 1, 0, &irc_protocol_cb_away },
+          { "batch", /* batch (cap batch) */ 1, 0, &irc_protocol_cb_batch },
           { "cap", /* client capability */ 1, 0, &irc_protocol_cb_cap },
           { "chghost", /* user/host change (cap chghost) */ 1, 0, &irc_protocol_cb_chghost },
           { "error", /* error received from IRC server */ 1, 0, &irc_protocol_cb_error },
@@ -6608,28 +6887,42 @@ irc_protocol_recv_command (struct t_irc_server *server,
     message_colors_decoded = NULL;
     argv = NULL;
     argv_eol = NULL;
-    hash_tags = NULL;
+    message_tags = tags_stack;
     date = 0;
 
     ptr_msg_after_tags = irc_message;
 
-    /* get tags as hashtable */
+    /* get date from tags (tags are not copied) */
     if (irc_message && (irc_message[0] == '@'))
     {
         pos_space = strchr (irc_message, ' ');
         if (pos_space)
         {
-            tags = weechat_strndup (irc_message + 1,
-                                    pos_space - (irc_message + 1));
-            if (tags)
+            num_tags = irc_protocol_tags_split (
+                irc_message + 1, pos_space - (irc_message + 1),
+                tags_stack, IRC_PROTOCOL_TAGS_MAX);
+            if (num_tags > IRC_PROTOCOL_TAGS_MAX)
             {
-                hash_tags = irc_protocol_get_message_tags (tags);
-                if (hash_tags)
+                message_tags = malloc (num_tags * sizeof (message_tags[0]));
+                if (message_tags)
                 {
-                    date = irc_protocol_parse_time (
-                        weechat_hashtable_get (hash_tags, "time"));
+                    irc_protocol_tags_split (
+                        irc_message + 1, pos_space - (irc_message + 1),
+                        message_tags, num_tags);
                 }
-                free (tags);
+                else
+                {
+                    message_tags = tags_stack;
+                    num_tags = IRC_PROTOCOL_TAGS_MAX;
+                }
+            }
+            ptr_tag = irc_protocol_tags_search (message_tags, num_tags, "time");
+            if (ptr_tag
+                && irc_protocol_parse_time_tv (ptr_tag->value,
+                                               ptr_tag->value_size,
+                                               &tv_date))
+            {
+                date = tv_date.tv_sec;
             }
             ptr_msg_after_tags = pos_space;
             while (ptr_msg_after_tags[0] == ' ')
@@ -6815,6 +7108,6 @@ end:
         weechat_string_free_split (argv);
     if (argv_eol)
         weechat_string_free_split (argv_eol);
-    if (hash_tags)
-        weechat_hashtable_free (hash_tags);
+    if (message_tags != tags_stack)
+        free (message_tags);
 }
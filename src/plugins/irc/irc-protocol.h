@@ -21,6 +21,10 @@
 #define WEECHAT_PLUGIN_IRC_PROTOCOL_H
 
 #include <time.h>
+#include <sys/time.h>
+
+/* max tags stored on stack when parsing an IRC message (more are allocated) */
+#define IRC_PROTOCOL_TAGS_MAX 32
 
 #define IRC_PROTOCOL_CALLBACK(__command)                                \
     int                                                                 \
@@ -83,8 +87,31 @@ struct t_irc_protocol_msg
     t_irc_recv_func *recv_function; /* function called when msg is received  */
 };
 
+/*
+ * view on a message tag: key and value are not copied, they point directly to
+ * the IRC message (they are NOT null-terminated), and the value is escaped
+ * (see function irc_protocol_tag_value_unescape)
+ */
+
+struct t_irc_protocol_tag
+{
+    const char *key;                /* pointer to key in message             */
+    int key_size;                   /* size of key (in bytes)                */
+    const char *value;              /* pointer to value (NULL if no value)   */
+    int value_size;                 /* size of value (in bytes)              */
+};
+
 extern const char *irc_protocol_tags (const char *command, const char *tags,
                                       const char *nick, const char *address);
+extern int irc_protocol_tags_split (const char *tags, int length,
+                                    struct t_irc_protocol_tag *message_tags,
+                                    int max_tags);
+extern const struct t_irc_protocol_tag *irc_protocol_tags_search (const struct t_irc_protocol_tag *message_tags,
+                                                                  int num_tags,
+                                                                  const char *key);
+extern char *irc_protocol_tag_value_unescape (const struct t_irc_protocol_tag *tag);
+extern int irc_protocol_parse_time_tv (const char *time, int length,
+                                       struct timeval *tv);
 extern time_t irc_protocol_parse_time (const char *time);
 extern void irc_protocol_recv_command (struct t_irc_server *server,
                                        const char *irc_message,
@@ -36,9 +36,13 @@
 
 struct t_gui_buffer *irc_raw_buffer = NULL;
 
-int irc_raw_messages_count = 0;
-struct t_irc_raw_message *irc_raw_messages = NULL;
-struct t_irc_raw_message *last_irc_raw_message = NULL;
+struct t_irc_raw_message *irc_raw_messages = NULL; /* ring of messages   */
+int irc_raw_messages_size = 0;         /* number of messages in ring        */
+int irc_raw_messages_first = 0;        /* index of oldest message in ring   */
+int irc_raw_messages_count = 0;        /* number of messages stored         */
+int irc_raw_messages_not_printed = 0;  /* newest msgs not printed in buffer */
+char *irc_raw_data = NULL;             /* data of messages                  */
+int irc_raw_data_size = 0;             /* size of data (in bytes)           */
 
 char *irc_raw_filter = NULL;
 struct t_hashtable *irc_raw_filter_hashtable_options = NULL;
@@ -99,8 +103,10 @@ irc_raw_message_match_filter (struct t_irc_raw_message *raw_message,
                 str_date[0] = '\0';
             }
             weechat_hashtable_set (hashtable, "date", str_date);
-            weechat_hashtable_set (hashtable,
-                                   "server", raw_message->server->name);
+            weechat_hashtable_set (
+                hashtable,
+                "server",
+                (raw_message->server) ? raw_message->server->name : "");
             weechat_hashtable_set (
                 hashtable,
                 "recv",
@@ -133,6 +139,8 @@ irc_raw_message_match_filter (struct t_irc_raw_message *raw_message,
     else if (strncmp (filter, "s:", 2) == 0)
     {
         /* filter by server name */
+        if (!raw_message->server)
+            return 0;
         return (weechat_strcasecmp (raw_message->server->name,
                                     filter + 2) == 0) ? 1 : 0;
     }
@@ -295,6 +303,53 @@ irc_raw_message_print (struct t_irc_raw_message *raw_message)
         free (buf2);
 }
 
+/*
+ * Prints messages not yet printed in irc raw buffer, only if the buffer is
+ * displayed in a window (messages are formatted only when they are needed).
+ */
+
+void
+irc_raw_print_pending ()
+{
+    int i;
+
+    if (!irc_raw_buffer || (irc_raw_messages_not_printed <= 0))
+        return;
+
+    if (weechat_buffer_get_integer (irc_raw_buffer, "num_displayed") <= 0)
+        return;
+
+    for (i = irc_raw_messages_count - irc_raw_messages_not_printed;
+         i < irc_raw_messages_count; i++)
+    {
+        irc_raw_message_print (irc_raw_message_get (i));
+    }
+
+    irc_raw_messages_not_printed = 0;
+}
+
+/*
+ * Callback for signal "buffer_switch": prints pending messages if the irc raw
+ * buffer is displayed.
+ */
+
+int
+irc_raw_buffer_switch_cb (const void *pointer, void *data,
+                          const char *signal,
+                          const char *type_data, void *signal_data)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) signal;
+    (void) type_data;
+
+    if (irc_raw_buffer && (signal_data == irc_raw_buffer))
+        irc_raw_print_pending ();
+
+    return WEECHAT_RC_OK;
+}
+
 /*
  * Sets the local variable "filter" in the irc raw buffer.
  */
@@ -335,20 +390,15 @@ irc_raw_set_title ()
 void
 irc_raw_refresh (int clear)
 {
-    struct t_irc_raw_message *ptr_raw_message;
-
     if (!irc_raw_buffer)
         return;
 
     if (clear)
         weechat_buffer_clear (irc_raw_buffer);
 
-    /* print messages in list */
-    for (ptr_raw_message = irc_raw_messages; ptr_raw_message;
-         ptr_raw_message = ptr_raw_message->next_message)
-    {
-        irc_raw_message_print (ptr_raw_message);
-    }
+    /* all messages will be printed when the buffer is displayed */
+    irc_raw_messages_not_printed = irc_raw_messages_count;
+    irc_raw_print_pending ();
 
     irc_raw_set_title ();
 }
@@ -424,121 +474,248 @@ irc_raw_filter_options (const char *filter)
 }
 
 /*
- * Frees a raw message and removes it from list.
+ * Returns a raw message by its index: 0 is the oldest message and
+ * (irc_raw_messages_count - 1) the newest.
+ *
+ * Returns NULL if index is out of range.
  */
 
-void
-irc_raw_message_free (struct t_irc_raw_message *raw_message)
+struct t_irc_raw_message *
+irc_raw_message_get (int index)
 {
-    struct t_irc_raw_message *new_raw_messages;
+    if (!irc_raw_messages || (index < 0) || (index >= irc_raw_messages_count))
+        return NULL;
+
+    return &irc_raw_messages[(irc_raw_messages_first + index)
+                             % irc_raw_messages_size];
+}
 
-    if (!raw_message)
+/*
+ * Removes the oldest raw message.
+ */
+
+void
+irc_raw_message_remove_oldest ()
+{
+    if (irc_raw_messages_count <= 0)
         return;
 
-    /* remove message from raw messages list */
-    if (last_irc_raw_message == raw_message)
-        last_irc_raw_message = raw_message->prev_message;
-    if (raw_message->prev_message)
+    irc_raw_messages_first = (irc_raw_messages_first + 1)
+        % irc_raw_messages_size;
+    irc_raw_messages_count--;
+    if (irc_raw_messages_not_printed > irc_raw_messages_count)
+        irc_raw_messages_not_printed = irc_raw_messages_count;
+}
+
+/*
+ * Frees all raw messages (and the ring buffer).
+ */
+
+void
+irc_raw_message_free_all ()
+{
+    if (irc_raw_messages)
     {
-        (raw_message->prev_message)->next_message = raw_message->next_message;
-        new_raw_messages = irc_raw_messages;
+        free (irc_raw_messages);
+        irc_raw_messages = NULL;
     }
-    else
-        new_raw_messages = raw_message->next_message;
+    if (irc_raw_data)
+    {
+        free (irc_raw_data);
+        irc_raw_data = NULL;
+    }
+    irc_raw_messages_size = 0;
+    irc_raw_messages_first = 0;
+    irc_raw_messages_count = 0;
+    irc_raw_messages_not_printed = 0;
+    irc_raw_data_size = 0;
+}
 
-    if (raw_message->next_message)
-        (raw_message->next_message)->prev_message = raw_message->prev_message;
+/*
+ * Allocates the ring buffer, using options irc.look.raw_messages and
+ * irc.look.raw_messages_size.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (or no raw messages must be kept in memory)
+ */
 
-    /* free data */
-    if (raw_message->message)
-        free (raw_message->message);
+int
+irc_raw_message_alloc ()
+{
+    int max_messages, data_size;
 
-    free (raw_message);
+    max_messages = weechat_config_integer (irc_config_look_raw_messages);
+    data_size = weechat_config_integer (irc_config_look_raw_messages_size);
+    if ((max_messages <= 0) || (data_size <= 0))
+        return 0;
 
-    irc_raw_messages = new_raw_messages;
+    irc_raw_messages = malloc (max_messages * sizeof (irc_raw_messages[0]));
+    irc_raw_data = malloc (data_size);
+    if (!irc_raw_messages || !irc_raw_data)
+    {
+        irc_raw_message_free_all ();
+        return 0;
+    }
 
-    irc_raw_messages_count--;
+    irc_raw_messages_size = max_messages;
+    irc_raw_messages_first = 0;
+    irc_raw_messages_count = 0;
+    irc_raw_messages_not_printed = 0;
+    irc_raw_data_size = data_size;
+
+    return 1;
 }
 
 /*
- * Frees all raw messages.
+ * Resizes the ring buffer (after a change of option irc.look.raw_messages or
+ * irc.look.raw_messages_size): the newest messages are kept.
  */
 
 void
-irc_raw_message_free_all ()
+irc_raw_message_resize ()
 {
-    while (irc_raw_messages)
+    struct t_irc_raw_message *old_messages, *ptr_raw_message;
+    char *old_data;
+    int old_size, old_first, old_count, old_not_printed, i;
+
+    old_messages = irc_raw_messages;
+    old_data = irc_raw_data;
+    old_size = irc_raw_messages_size;
+    old_first = irc_raw_messages_first;
+    old_count = irc_raw_messages_count;
+    old_not_printed = irc_raw_messages_not_printed;
+
+    irc_raw_messages = NULL;
+    irc_raw_data = NULL;
+    irc_raw_message_free_all ();
+
+    for (i = 0; i < old_count; i++)
     {
-        irc_raw_message_free (irc_raw_messages);
+        ptr_raw_message = &old_messages[(old_first + i) % old_size];
+        irc_raw_message_add_to_list (ptr_raw_message->date,
+                                     ptr_raw_message->server,
+                                     ptr_raw_message->flags,
+                                     ptr_raw_message->message);
     }
+    irc_raw_messages_not_printed = (old_not_printed < irc_raw_messages_count) ?
+        old_not_printed : irc_raw_messages_count;
+
+    if (old_messages)
+        free (old_messages);
+    if (old_data)
+        free (old_data);
 }
 
 /*
- * Removes old raw messages if limit has been reached.
+ * Removes references to a server in raw messages (called when a server is
+ * freed).
  */
 
 void
-irc_raw_message_remove_old ()
+irc_raw_message_remove_server (struct t_irc_server *server)
 {
-    int max_messages;
+    struct t_irc_raw_message *ptr_raw_message;
+    int i;
 
-    max_messages = weechat_config_integer (irc_config_look_raw_messages);
-    while (irc_raw_messages && (irc_raw_messages_count >= max_messages))
+    for (i = 0; i < irc_raw_messages_count; i++)
     {
-        irc_raw_message_free (irc_raw_messages);
+        ptr_raw_message = irc_raw_message_get (i);
+        if (ptr_raw_message->server == server)
+            ptr_raw_message->server = NULL;
     }
 }
 
 /*
- * Adds a new raw message to list.
+ * Adds a new raw message to list: oldest messages are removed if the max
+ * number of messages is reached or if there is not enough space in data
+ * for the new message.
  *
  * Returns pointer to new raw message, NULL if error.
+ *
+ * Note: the pointer returned is valid only until next message is added.
  */
 
 struct t_irc_raw_message *
 irc_raw_message_add_to_list (time_t date, struct t_irc_server *server,
                              int flags, const char *message)
 {
-    struct t_irc_raw_message *new_raw_message;
+    struct t_irc_raw_message *new_raw_message, *ptr_raw_message;
+    int size, offset;
 
     if (!message)
         return NULL;
 
-    irc_raw_message_remove_old ();
+    if (!irc_raw_messages && !irc_raw_message_alloc ())
+        return NULL;
+
+    size = strlen (message) + 1;
+    if (size > irc_raw_data_size)
+        return NULL;
 
-    new_raw_message = malloc (sizeof (*new_raw_message));
-    if (new_raw_message)
+    /* new message is stored just after the newest message */
+    ptr_raw_message = irc_raw_message_get (irc_raw_messages_count - 1);
+    offset = (ptr_raw_message) ?
+        ptr_raw_message->offset + ptr_raw_message->size : 0;
+
+    /*
+     * not enough space at the end of data: remove messages stored after this
+     * offset and go back to the beginning of data
+     */
+    if (offset + size > irc_raw_data_size)
     {
-        new_raw_message->date = date;
-        new_raw_message->server = server;
-        new_raw_message->flags = flags;
-        new_raw_message->message = strdup (message);
-
-        /* add message to list */
-        new_raw_message->prev_message = last_irc_raw_message;
-        new_raw_message->next_message = NULL;
-        if (last_irc_raw_message)
-            last_irc_raw_message->next_message = new_raw_message;
-        else
-            irc_raw_messages = new_raw_message;
-        last_irc_raw_message = new_raw_message;
-
-        irc_raw_messages_count++;
+        while ((ptr_raw_message = irc_raw_message_get (0))
+               && (ptr_raw_message->offset >= offset))
+        {
+            irc_raw_message_remove_oldest ();
+        }
+        offset = 0;
     }
 
+    /* remove old messages until there is room for the new message */
+    while ((ptr_raw_message = irc_raw_message_get (0)))
+    {
+        if ((irc_raw_messages_count < irc_raw_messages_size)
+            && ((ptr_raw_message->offset >= offset + size)
+                || (ptr_raw_message->offset + ptr_raw_message->size <= offset)))
+        {
+            break;
+        }
+        irc_raw_message_remove_oldest ();
+    }
+
+    new_raw_message = &irc_raw_messages[(irc_raw_messages_first
+                                         + irc_raw_messages_count)
+                                        % irc_raw_messages_size];
+    new_raw_message->date = date;
+    new_raw_message->server = server;
+    new_raw_message->flags = flags;
+    new_raw_message->message = irc_raw_data + offset;
+    new_raw_message->offset = offset;
+    new_raw_message->size = size;
+    memcpy (new_raw_message->message, message, size);
+
+    irc_raw_messages_count++;
+
     return new_raw_message;
 }
 
 /*
  * Prints a message on IRC raw buffer.
+ *
+ * The message is stored in ring buffer and printed only when the raw buffer
+ * is displayed; if the message is not kept in memory (for example if option
+ * irc.look.raw_messages is set to 0), it is printed immediately in the raw
+ * buffer (if opened).
  */
 
 void
 irc_raw_print (struct t_irc_server *server, int flags,
                const char *message)
 {
-    struct t_irc_raw_message *new_raw_message;
+    struct t_irc_raw_message raw_message;
     time_t now;
+    int i;
 
     if (!message)
         return;
@@ -549,31 +726,33 @@ irc_raw_print (struct t_irc_server *server, int flags,
 
     now = time (NULL);
 
-    new_raw_message = irc_raw_message_add_to_list (now, server, flags,
-                                                   message);
-    if (new_raw_message)
-    {
-        if (irc_raw_buffer)
-            irc_raw_message_print (new_raw_message);
-        if (weechat_config_integer (irc_config_look_raw_messages) == 0)
-            irc_raw_message_free (new_raw_message);
-    }
-
-    if (weechat_irc_plugin->debug >= 2)
+    for (i = 0; i < 2; i++)
     {
-        new_raw_message = irc_raw_message_add_to_list (
-            now,
-            server,
-            flags | IRC_RAW_FLAG_BINARY,
-            message);
-        if (new_raw_message)
+        /* with debug >= 2, the message is also displayed as hex dump */
+        if (i == 1)
+        {
+            if (weechat_irc_plugin->debug < 2)
+                break;
+            flags |= IRC_RAW_FLAG_BINARY;
+        }
+        if (irc_raw_message_add_to_list (now, server, flags, message))
+        {
+            irc_raw_messages_not_printed++;
+        }
+        else if (irc_raw_buffer)
         {
-            if (irc_raw_buffer)
-                irc_raw_message_print (new_raw_message);
-            if (weechat_config_integer (irc_config_look_raw_messages) == 0)
-                irc_raw_message_free (new_raw_message);
+            irc_raw_print_pending ();
+            raw_message.date = now;
+            raw_message.server = server;
+            raw_message.flags = flags;
+            raw_message.message = (char *)message;
+            raw_message.offset = 0;
+            raw_message.size = 0;
+            irc_raw_message_print (&raw_message);
         }
     }
+
+    irc_raw_print_pending ();
 }
 
 /*
@@ -599,7 +778,9 @@ irc_raw_add_to_infolist (struct t_infolist *infolist,
 
     if (!weechat_infolist_new_var_time (ptr_item, "date", raw_message->date))
         return 0;
-    if (!weechat_infolist_new_var_string (ptr_item, "server", raw_message->server->name))
+    if (!weechat_infolist_new_var_string (ptr_item, "server",
+                                          (raw_message->server) ?
+                                          raw_message->server->name : NULL))
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "flags", raw_message->flags))
         return 0;
@@ -626,6 +807,9 @@ irc_raw_init ()
         weechat_hashtable_set (irc_raw_filter_hashtable_options,
                                "type", "condition");
     }
+
+    weechat_hook_signal ("buffer_switch",
+                         &irc_raw_buffer_switch_cb, NULL, NULL);
 }
 
 /*
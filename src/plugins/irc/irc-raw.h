@@ -38,26 +38,37 @@
 
 struct t_irc_server;
 
+/*
+ * raw messages are stored in a ring buffer with fixed memory: an array of
+ * messages (max "irc.look.raw_messages" messages) and a data buffer where
+ * messages are stored (max "irc.look.raw_messages_size" bytes); the oldest
+ * messages are dropped when one of these limits is reached
+ */
+
 struct t_irc_raw_message
 {
     time_t date;                       /* date/time of message              */
     struct t_irc_server *server;       /* server                            */
     int flags;                         /* flags                             */
-    char *message;                     /* message                           */
-    struct t_irc_raw_message *prev_message; /* pointer to previous message  */
-    struct t_irc_raw_message *next_message; /* pointer to next message      */
+    char *message;                     /* message (in ring data buffer)     */
+    int offset;                        /* offset of message in data buffer  */
+    int size;                          /* size of message (with final '\0') */
 };
 
 struct t_irc_server;
 
 extern struct t_gui_buffer *irc_raw_buffer;
 extern int irc_raw_messages_count;
-extern struct t_irc_raw_message *irc_raw_messages, *last_irc_raw_message;
+extern int irc_raw_messages_not_printed;
 
 extern void irc_raw_refresh (int clear);
 extern void irc_raw_open (int switch_to_buffer);
 extern void irc_raw_set_filter (const char *filter);
 extern void irc_raw_filter_options (const char *filter);
+extern struct t_irc_raw_message *irc_raw_message_get (int index);
+extern void irc_raw_message_free_all ();
+extern void irc_raw_message_resize ();
+extern void irc_raw_message_remove_server (struct t_irc_server *server);
 extern struct t_irc_raw_message *irc_raw_message_add_to_list (time_t date,
                                                               struct t_irc_server *server,
                                                               int flags,
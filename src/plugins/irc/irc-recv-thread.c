@@ -0,0 +1,680 @@
+/*
+ * irc-recv-thread.c - receive data from IRC server in a thread
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * When option irc.network.recv_thread is enabled, a thread is created for
+ * each connected server: it reads data on socket (including SSL decryption)
+ * and splits it into messages, which are sent to main thread.
+ *
+ * The main thread is woken up by a pipe (hooked with weechat_hook_fd) and
+ * processes messages as usual (modifiers, charset, parsing, callbacks):
+ * the receiving thread must NOT call any WeeChat API function.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <gnutls/gnutls.h>
+
+#include "../weechat-plugin.h"
+#include "irc.h"
+#include "irc-recv-thread.h"
+#include "irc-server.h"
+#include "irc-stats.h"
+
+
+/*
+ * Adds a string to unterminated message (receiving thread).
+ */
+
+void
+irc_recv_thread_add_unterminated (struct t_irc_recv_thread *recv_thread,
+                                  const char *string)
+{
+    char *unterminated_message2;
+    int length;
+
+    if (!string[0])
+        return;
+
+    if (recv_thread->unterminated_message)
+    {
+        length = strlen (recv_thread->unterminated_message);
+        unterminated_message2 = realloc (recv_thread->unterminated_message,
+                                         length + strlen (string) + 1);
+        if (!unterminated_message2)
+        {
+            free (recv_thread->unterminated_message);
+            recv_thread->unterminated_message = NULL;
+            return;
+        }
+        recv_thread->unterminated_message = unterminated_message2;
+        strcpy (recv_thread->unterminated_message + length, string);
+    }
+    else
+    {
+        recv_thread->unterminated_message = strdup (string);
+    }
+}
+
+/*
+ * Adds a message (beginning is the unterminated message, if any) to a list
+ * of messages (receiving thread).
+ */
+
+void
+irc_recv_thread_add_message (struct t_irc_recv_thread *recv_thread,
+                             const char *string,
+                             struct t_irc_recv_thread_message **messages,
+                             struct t_irc_recv_thread_message **last_message)
+{
+    struct t_irc_recv_thread_message *new_message;
+
+    new_message = malloc (sizeof (*new_message));
+    if (!new_message)
+        return;
+
+    if (recv_thread->unterminated_message)
+    {
+        irc_recv_thread_add_unterminated (recv_thread, string);
+        new_message->data = recv_thread->unterminated_message;
+        recv_thread->unterminated_message = NULL;
+    }
+    else
+    {
+        new_message->data = strdup (string);
+    }
+    if (!new_message->data)
+    {
+        free (new_message);
+        return;
+    }
+    new_message->next_message = NULL;
+
+    if (*last_message)
+        (*last_message)->next_message = new_message;
+    else
+        *messages = new_message;
+    *last_message = new_message;
+}
+
+/*
+ * Splits received buffer into messages: chars '\r' are ignored and '\n' ends
+ * a message (receiving thread).
+ *
+ * Messages are added to the list "messages", the end of buffer (not
+ * terminated by '\n') is kept in recv_thread->unterminated_message.
+ *
+ * Note: content of buffer is modified by this function.
+ */
+
+void
+irc_recv_thread_split (struct t_irc_recv_thread *recv_thread, char *buffer,
+                       struct t_irc_recv_thread_message **messages,
+                       struct t_irc_recv_thread_message **last_message)
+{
+    char *pos, separator;
+
+    if (!recv_thread || !buffer)
+        return;
+
+    while (buffer[0])
+    {
+        pos = strpbrk (buffer, "\r\n");
+        if (!pos)
+        {
+            irc_recv_thread_add_unterminated (recv_thread, buffer);
+            return;
+        }
+        separator = pos[0];
+        pos[0] = '\0';
+        if (separator == '\n')
+        {
+            irc_recv_thread_add_message (recv_thread, buffer,
+                                         messages, last_message);
+        }
+        else
+        {
+            irc_recv_thread_add_unterminated (recv_thread, buffer);
+        }
+        buffer = pos + 1;
+    }
+}
+
+/*
+ * Frees a list of messages.
+ */
+
+void
+irc_recv_thread_free_messages (struct t_irc_recv_thread_message *messages)
+{
+    struct t_irc_recv_thread_message *next_message;
+
+    while (messages)
+    {
+        next_message = messages->next_message;
+        if (messages->data)
+            free (messages->data);
+        free (messages);
+        messages = next_message;
+    }
+}
+
+/*
+ * Wakes up main thread (receiving thread).
+ */
+
+void
+irc_recv_thread_wakeup (struct t_irc_recv_thread *recv_thread)
+{
+    int rc;
+
+    /* pipe is non-blocking: if it's full, main thread is already woken up */
+    rc = write (recv_thread->pipe_data[1], "d", 1);
+    (void) rc;
+}
+
+/*
+ * Reads data available on socket and sends messages to main thread
+ * (receiving thread).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (or connection closed by peer), thread must end
+ */
+
+int
+irc_recv_thread_read (struct t_irc_recv_thread *recv_thread)
+{
+    struct t_irc_recv_thread_message *messages, *last_message, *ptr_message;
+    char buffer[4096 + 2];
+    int num_read, end_recv, error, error_closed, error_code, wakeup;
+    long bytes, size;
+
+    messages = NULL;
+    last_message = NULL;
+    bytes = 0;
+    size = 0;
+    error = 0;
+    error_closed = 0;
+    error_code = 0;
+    end_recv = 0;
+
+    while (!end_recv)
+    {
+        end_recv = 1;
+
+        if (recv_thread->ssl_connected)
+            num_read = gnutls_record_recv (recv_thread->gnutls_sess, buffer,
+                                           sizeof (buffer) - 2);
+        else
+            num_read = recv (recv_thread->sock, buffer, sizeof (buffer) - 2, 0);
+
+        if (num_read > 0)
+        {
+            buffer[num_read] = '\0';
+            bytes += num_read;
+            irc_recv_thread_split (recv_thread, buffer,
+                                   &messages, &last_message);
+            if (recv_thread->ssl_connected
+                && (gnutls_record_check_pending (recv_thread->gnutls_sess) > 0))
+            {
+                /*
+                 * if there are unread data in the gnutls buffers,
+                 * go on with recv
+                 */
+                end_recv = 0;
+            }
+        }
+        else if (recv_thread->ssl_connected)
+        {
+            if ((num_read == 0)
+                || ((num_read != GNUTLS_E_AGAIN)
+                    && (num_read != GNUTLS_E_INTERRUPTED)))
+            {
+                error = 1;
+                error_closed = (num_read == 0);
+                error_code = num_read;
+            }
+        }
+        else
+        {
+            if ((num_read == 0)
+                || ((errno != EAGAIN) && (errno != EWOULDBLOCK)
+                    && (errno != EINTR)))
+            {
+                error = 1;
+                error_closed = (num_read == 0);
+                error_code = errno;
+            }
+        }
+    }
+
+    if (!messages && !error)
+    {
+        if (bytes > 0)
+        {
+            pthread_mutex_lock (&recv_thread->mutex);
+            recv_thread->bytes += bytes;
+            pthread_mutex_unlock (&recv_thread->mutex);
+        }
+        return 1;
+    }
+
+    for (ptr_message = messages; ptr_message;
+         ptr_message = ptr_message->next_message)
+    {
+        size += sizeof (*ptr_message) + strlen (ptr_message->data) + 1;
+    }
+
+    pthread_mutex_lock (&recv_thread->mutex);
+    wakeup = (!recv_thread->messages || error);
+    if (messages)
+    {
+        if (recv_thread->last_message)
+            recv_thread->last_message->next_message = messages;
+        else
+            recv_thread->messages = messages;
+        recv_thread->last_message = last_message;
+        recv_thread->size += size;
+        if (recv_thread->size >= IRC_RECV_THREAD_MAX_QUEUE_SIZE)
+            recv_thread->paused = 1;
+    }
+    recv_thread->bytes += bytes;
+    if (error)
+    {
+        recv_thread->error = 1;
+        recv_thread->error_closed = error_closed;
+        recv_thread->error_code = error_code;
+    }
+    pthread_mutex_unlock (&recv_thread->mutex);
+
+    if (wakeup)
+        irc_recv_thread_wakeup (recv_thread);
+
+    return (error) ? 0 : 1;
+}
+
+/*
+ * Reads the pipe used by main thread to stop or resume the thread
+ * (receiving thread).
+ *
+ * Returns:
+ *   1: stop requested
+ *   0: no stop requested (thread is resumed)
+ */
+
+int
+irc_recv_thread_read_pipe_stop (struct t_irc_recv_thread *recv_thread)
+{
+    char buffer[64];
+    int num_read, stop;
+
+    stop = 0;
+
+    /* pipe is non-blocking */
+    while ((num_read = read (recv_thread->pipe_stop[0], buffer,
+                             sizeof (buffer))) > 0)
+    {
+        if (memchr (buffer, 's', num_read))
+            stop = 1;
+    }
+
+    return stop;
+}
+
+/*
+ * Main function of receiving thread: waits for data on socket (or a stop
+ * request from main thread).
+ *
+ * When the queue of messages is full, the socket is not polled any more
+ * until the main thread has processed the messages (it writes on the pipe
+ * "pipe_stop" to resume the thread).
+ */
+
+void *
+irc_recv_thread_run (void *arg)
+{
+    struct t_irc_recv_thread *recv_thread;
+    struct pollfd fds[2];
+    int rc, paused;
+
+    recv_thread = (struct t_irc_recv_thread *)arg;
+
+    fds[0].fd = recv_thread->pipe_stop[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = recv_thread->sock;
+    fds[1].events = POLLIN;
+
+    while (1)
+    {
+        pthread_mutex_lock (&recv_thread->mutex);
+        paused = recv_thread->paused;
+        pthread_mutex_unlock (&recv_thread->mutex);
+
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        rc = poll (fds, (paused) ? 1 : 2, -1);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            pthread_mutex_lock (&recv_thread->mutex);
+            recv_thread->error = 1;
+            recv_thread->error_closed = 0;
+            recv_thread->error_code = errno;
+            pthread_mutex_unlock (&recv_thread->mutex);
+            irc_recv_thread_wakeup (recv_thread);
+            break;
+        }
+
+        /* stop (or resume) requested by main thread */
+        if (fds[0].revents && irc_recv_thread_read_pipe_stop (recv_thread))
+            break;
+
+        if (!paused && fds[1].revents && !irc_recv_thread_read (recv_thread))
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Callback for data sent by receiving thread (main thread): adds messages
+ * to the received messages queue and flushes it.
+ */
+
+int
+irc_recv_thread_data_cb (const void *pointer, void *data, int fd)
+{
+    struct t_irc_server *server;
+    struct t_irc_recv_thread *recv_thread;
+    struct t_irc_recv_thread_message *messages, *ptr_message;
+    char buffer[64];
+    long bytes;
+    int error, error_closed, error_code, resume, rc;
+
+    /* make C compiler happy */
+    (void) data;
+
+    server = (struct t_irc_server *)pointer;
+    if (!server || !server->recv_thread)
+        return WEECHAT_RC_ERROR;
+
+    recv_thread = server->recv_thread;
+
+    /* empty the pipe (non-blocking) */
+    while (read (fd, buffer, sizeof (buffer)) > 0)
+    {
+    }
+
+    pthread_mutex_lock (&recv_thread->mutex);
+    messages = recv_thread->messages;
+    recv_thread->messages = NULL;
+    recv_thread->last_message = NULL;
+    recv_thread->size = 0;
+    resume = recv_thread->paused;
+    recv_thread->paused = 0;
+    bytes = recv_thread->bytes;
+    recv_thread->bytes = 0;
+    error = recv_thread->error;
+    error_closed = recv_thread->error_closed;
+    error_code = recv_thread->error_code;
+    pthread_mutex_unlock (&recv_thread->mutex);
+
+    /* queue is now empty: the thread can read the socket again */
+    if (resume)
+    {
+        rc = write (recv_thread->pipe_stop[1], "r", 1);
+        (void) rc;
+    }
+
+    if (bytes > 0)
+        irc_stats_add (server->stats, IRC_STATS_BYTES_RECV, bytes);
+
+    if (messages)
+    {
+        for (ptr_message = messages; ptr_message;
+             ptr_message = ptr_message->next_message)
+        {
+            irc_server_msgq_add_msg (server, ptr_message->data);
+        }
+        irc_recv_thread_free_messages (messages);
+        irc_server_msgq_flush ();
+    }
+
+    /*
+     * disconnect if there was an error in thread (only if the thread was
+     * not already stopped while processing messages)
+     */
+    if (error && (server->recv_thread == recv_thread))
+        irc_server_recv_error (server, error_closed, error_code);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Sets flag O_NONBLOCK on the two ends of a pipe.
+ */
+
+void
+irc_recv_thread_pipe_nonblock (int *fds)
+{
+    int i, flags;
+
+    for (i = 0; i < 2; i++)
+    {
+        flags = fcntl (fds[i], F_GETFL);
+        if (flags == -1)
+            flags = 0;
+        fcntl (fds[i], F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+/*
+ * Starts the receiving thread for a server: the main thread is then woken
+ * up by a hook on a pipe (server->hook_fd) instead of the socket.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (thread not started)
+ */
+
+int
+irc_recv_thread_start (struct t_irc_server *server)
+{
+    struct t_irc_recv_thread *new_recv_thread;
+    sigset_t signals_all, signals_old;
+    int rc, error_code;
+
+    if (!server || server->fake_server || (server->sock < 0)
+        || server->recv_thread)
+    {
+        return 0;
+    }
+
+    new_recv_thread = calloc (1, sizeof (*new_recv_thread));
+    if (!new_recv_thread)
+        return 0;
+
+    new_recv_thread->sock = server->sock;
+    new_recv_thread->ssl_connected = server->ssl_connected;
+    new_recv_thread->gnutls_sess = server->gnutls_sess;
+    new_recv_thread->pipe_data[0] = -1;
+    new_recv_thread->pipe_data[1] = -1;
+    new_recv_thread->pipe_stop[0] = -1;
+    new_recv_thread->pipe_stop[1] = -1;
+
+    if ((pipe (new_recv_thread->pipe_data) < 0)
+        || (pipe (new_recv_thread->pipe_stop) < 0))
+    {
+        error_code = errno;
+        goto error;
+    }
+    irc_recv_thread_pipe_nonblock (new_recv_thread->pipe_data);
+    irc_recv_thread_pipe_nonblock (new_recv_thread->pipe_stop);
+
+    rc = pthread_mutex_init (&new_recv_thread->mutex, NULL);
+    if (rc != 0)
+    {
+        error_code = rc;
+        goto error;
+    }
+
+    /* signals must be handled by main thread only */
+    sigfillset (&signals_all);
+    pthread_sigmask (SIG_SETMASK, &signals_all, &signals_old);
+    rc = pthread_create (&new_recv_thread->thread, NULL,
+                         &irc_recv_thread_run, new_recv_thread);
+    pthread_sigmask (SIG_SETMASK, &signals_old, NULL);
+    if (rc != 0)
+    {
+        /* pthread functions return the error code, errno is not set */
+        error_code = rc;
+        pthread_mutex_destroy (&new_recv_thread->mutex);
+        goto error;
+    }
+
+    server->recv_thread = new_recv_thread;
+    server->hook_fd = weechat_hook_fd (new_recv_thread->pipe_data[0],
+                                       1, 0, 0,
+                                       &irc_recv_thread_data_cb,
+                                       server, NULL);
+
+    return 1;
+
+error:
+    weechat_printf (
+        server->buffer,
+        _("%s%s: unable to start thread to receive data: error %d %s"),
+        weechat_prefix ("error"), IRC_PLUGIN_NAME,
+        error_code, strerror (error_code));
+    if (new_recv_thread->pipe_data[0] >= 0)
+        close (new_recv_thread->pipe_data[0]);
+    if (new_recv_thread->pipe_data[1] >= 0)
+        close (new_recv_thread->pipe_data[1]);
+    if (new_recv_thread->pipe_stop[0] >= 0)
+        close (new_recv_thread->pipe_stop[0]);
+    if (new_recv_thread->pipe_stop[1] >= 0)
+        close (new_recv_thread->pipe_stop[1]);
+    free (new_recv_thread);
+    return 0;
+}
+
+/*
+ * Stops the receiving thread of a server (main thread).
+ *
+ * If keep_data == 1, messages received and not yet processed are added to
+ * the received messages queue (the caller must flush it) and the beginning
+ * of message not yet terminated is moved to server; otherwise they are lost.
+ */
+
+void
+irc_recv_thread_stop (struct t_irc_server *server, int keep_data)
+{
+    struct t_irc_recv_thread *recv_thread;
+    struct t_irc_recv_thread_message *ptr_message;
+    int rc;
+
+    if (!server || !server->recv_thread)
+        return;
+
+    recv_thread = server->recv_thread;
+
+    if (server->hook_fd)
+    {
+        weechat_unhook (server->hook_fd);
+        server->hook_fd = NULL;
+    }
+
+    rc = write (recv_thread->pipe_stop[1], "s", 1);
+    (void) rc;
+    pthread_join (recv_thread->thread, NULL);
+
+    if (keep_data)
+    {
+        if (recv_thread->bytes > 0)
+        {
+            irc_stats_add (server->stats, IRC_STATS_BYTES_RECV,
+                           recv_thread->bytes);
+        }
+        for (ptr_message = recv_thread->messages; ptr_message;
+             ptr_message = ptr_message->next_message)
+        {
+            irc_server_msgq_add_msg (server, ptr_message->data);
+        }
+        if (recv_thread->unterminated_message)
+        {
+            irc_server_msgq_add_unterminated (
+                server, recv_thread->unterminated_message);
+        }
+    }
+
+    irc_recv_thread_free_messages (recv_thread->messages);
+    if (recv_thread->unterminated_message)
+        free (recv_thread->unterminated_message);
+    close (recv_thread->pipe_data[0]);
+    close (recv_thread->pipe_data[1]);
+    close (recv_thread->pipe_stop[0]);
+    close (recv_thread->pipe_stop[1]);
+    pthread_mutex_destroy (&recv_thread->mutex);
+
+    free (recv_thread);
+    server->recv_thread = NULL;
+}
+
+/*
+ * Prints receiving thread infos in WeeChat log file (usually for crash dump).
+ */
+
+void
+irc_recv_thread_print_log (struct t_irc_recv_thread *recv_thread)
+{
+    if (!recv_thread)
+        return;
+
+    weechat_log_printf ("");
+    weechat_log_printf ("  => recv_thread (addr:0x%lx):", recv_thread);
+    weechat_log_printf ("       sock . . . . . . . . . . : %d",
+                        recv_thread->sock);
+    weechat_log_printf ("       ssl_connected. . . . . . : %d",
+                        recv_thread->ssl_connected);
+    weechat_log_printf ("       pipe_data. . . . . . . . : %d/%d",
+                        recv_thread->pipe_data[0], recv_thread->pipe_data[1]);
+    weechat_log_printf ("       pipe_stop. . . . . . . . : %d/%d",
+                        recv_thread->pipe_stop[0], recv_thread->pipe_stop[1]);
+    weechat_log_printf ("       messages . . . . . . . . : 0x%lx",
+                        recv_thread->messages);
+    weechat_log_printf ("       size . . . . . . . . . . : %ld",
+                        recv_thread->size);
+    weechat_log_printf ("       paused . . . . . . . . . : %d",
+                        recv_thread->paused);
+    weechat_log_printf ("       error. . . . . . . . . . : %d",
+                        recv_thread->error);
+}
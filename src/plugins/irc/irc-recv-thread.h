@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_IRC_RECV_THREAD_H
+#define WEECHAT_PLUGIN_IRC_RECV_THREAD_H
+
+#include <pthread.h>
+#include <gnutls/gnutls.h>
+
+/*
+ * max size of messages received and not yet processed by main thread (bytes):
+ * above this size, the receiving thread stops reading the socket until the
+ * main thread has processed the messages
+ */
+#define IRC_RECV_THREAD_MAX_QUEUE_SIZE (1024 * 1024)
+
+struct t_irc_server;
+
+struct t_irc_recv_thread_message
+{
+    char *data;                        /* message (without CR/LF)           */
+    struct t_irc_recv_thread_message *next_message; /* link to next message */
+};
+
+struct t_irc_recv_thread
+{
+    /* data set by main thread, read-only in receiving thread */
+    int sock;                          /* socket for server                 */
+    int ssl_connected;                 /* 1 if connected with SSL           */
+    gnutls_session_t gnutls_sess;      /* gnutls session (if SSL is used)   */
+    pthread_t thread;                  /* thread receiving data             */
+    int pipe_data[2];                  /* pipe to wake up main thread when  */
+                                       /* data is available                 */
+    int pipe_stop[2];                  /* pipe to stop the thread           */
+
+    /* data used only by receiving thread (until thread is stopped) */
+    char *unterminated_message;        /* beginning of a message            */
+
+    /* data shared by the two threads (protected by mutex) */
+    pthread_mutex_t mutex;             /* mutex for the data below          */
+    struct t_irc_recv_thread_message *messages;     /* messages received    */
+    struct t_irc_recv_thread_message *last_message; /* last message         */
+    long size;                         /* size of messages (bytes)          */
+    int paused;                        /* 1 if socket is not read because   */
+                                       /* queue is full (size >= max)       */
+    long bytes;                        /* bytes received (not yet counted)  */
+    int error;                         /* 1 if error in receiving thread    */
+    int error_closed;                  /* 1 if connection closed by peer    */
+    int error_code;                    /* gnutls error (SSL) or errno       */
+};
+
+extern void irc_recv_thread_split (struct t_irc_recv_thread *recv_thread,
+                                   char *buffer,
+                                   struct t_irc_recv_thread_message **messages,
+                                   struct t_irc_recv_thread_message **last_message);
+extern void irc_recv_thread_free_messages (struct t_irc_recv_thread_message *messages);
+extern int irc_recv_thread_data_cb (const void *pointer, void *data, int fd);
+extern int irc_recv_thread_start (struct t_irc_server *server);
+extern void irc_recv_thread_stop (struct t_irc_server *server, int keep_data);
+extern void irc_recv_thread_print_log (struct t_irc_recv_thread *recv_thread);
+
+#endif /* WEECHAT_PLUGIN_IRC_RECV_THREAD_H */
@@ -25,11 +25,13 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "../weechat-plugin.h"
 #include "irc.h"
 #include "irc-redirect.h"
 #include "irc-server.h"
+#include "irc-stats.h"
 
 
 struct t_irc_redirect_pattern *irc_redirect_patterns = NULL;
@@ -389,6 +391,128 @@ irc_redirect_pattern_free_all ()
     }
 }
 
+/*
+ * Callback used to add a command in index of redirect commands of server
+ * (the value in index is the number of redirects using this command).
+ */
+
+void
+irc_redirect_index_add_cb (void *data, struct t_hashtable *hashtable,
+                           const void *key, const void *value)
+{
+    struct t_hashtable *commands;
+    int *ptr_count, count;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) value;
+
+    commands = (struct t_hashtable *)data;
+
+    ptr_count = weechat_hashtable_get (commands, key);
+    count = (ptr_count) ? *ptr_count + 1 : 1;
+    weechat_hashtable_set (commands, key, &count);
+}
+
+/*
+ * Callback used to remove a command from index of redirect commands of
+ * server (the command is removed when no more redirects are using it).
+ */
+
+void
+irc_redirect_index_remove_cb (void *data, struct t_hashtable *hashtable,
+                              const void *key, const void *value)
+{
+    struct t_hashtable *commands;
+    int *ptr_count, count;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) value;
+
+    commands = (struct t_hashtable *)data;
+
+    ptr_count = weechat_hashtable_get (commands, key);
+    if (!ptr_count)
+        return;
+    if (*ptr_count <= 1)
+    {
+        weechat_hashtable_remove (commands, key);
+    }
+    else
+    {
+        count = *ptr_count - 1;
+        weechat_hashtable_set (commands, key, &count);
+    }
+}
+
+/*
+ * Adds (if add == 1) or removes (if add == 0) start/stop commands of a
+ * redirect in index of redirect commands of server.
+ */
+
+void
+irc_redirect_index_update (struct t_irc_redirect *redirect, int add)
+{
+    struct t_irc_server *server;
+
+    server = redirect->server;
+
+    if (add && !server->redirects_commands)
+    {
+        server->redirects_commands = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_STRING,
+            WEECHAT_HASHTABLE_INTEGER,
+            NULL, NULL);
+    }
+    if (!server->redirects_commands)
+        return;
+
+    if (redirect->cmd_start)
+    {
+        weechat_hashtable_map (redirect->cmd_start,
+                               (add) ?
+                               &irc_redirect_index_add_cb :
+                               &irc_redirect_index_remove_cb,
+                               server->redirects_commands);
+    }
+    if (redirect->cmd_stop)
+    {
+        weechat_hashtable_map (redirect->cmd_stop,
+                               (add) ?
+                               &irc_redirect_index_add_cb :
+                               &irc_redirect_index_remove_cb,
+                               server->redirects_commands);
+    }
+}
+
+/*
+ * Sets flags "start command received" and "stop command received" in a
+ * redirect and updates the number of redirects in progress in server.
+ */
+
+void
+irc_redirect_set_received (struct t_irc_redirect *redirect,
+                           int cmd_start_received, int cmd_stop_received)
+{
+    int old_in_progress, new_in_progress;
+
+    if (!redirect)
+        return;
+
+    old_in_progress = (redirect->cmd_start_received
+                       || redirect->cmd_stop_received) ? 1 : 0;
+
+    redirect->cmd_start_received = cmd_start_received;
+    redirect->cmd_stop_received = cmd_stop_received;
+
+    new_in_progress = (redirect->cmd_start_received
+                       || redirect->cmd_stop_received) ? 1 : 0;
+
+    redirect->server->redirects_in_progress += new_in_progress - old_in_progress;
+}
+
 /*
  * Creates a new redirect for a command on a server (with start/stop/extra
  * commands in arguments).
@@ -507,6 +631,8 @@ irc_redirect_new_with_commands (struct t_irc_server *server,
     server->last_redirect = new_redirect;
     new_redirect->next_redirect = NULL;
 
+    irc_redirect_index_update (new_redirect, 1);
+
     return new_redirect;
 }
 
@@ -772,6 +898,8 @@ irc_redirect_stop (struct t_irc_redirect *redirect, const char *error)
         if (hashtable)
             weechat_hashtable_free (hashtable);
 
+        irc_stats_add (redirect->server->stats, IRC_STATS_REDIRECTS, 1);
+
         irc_redirect_free (redirect);
     }
     else
@@ -780,8 +908,7 @@ irc_redirect_stop (struct t_irc_redirect *redirect, const char *error)
          * max count not yet reached, then we prepare redirect to continue
          * redirection
          */
-        redirect->cmd_start_received = 0;
-        redirect->cmd_stop_received = 0;
+        irc_redirect_set_received (redirect, 0, 0);
     }
 }
 
@@ -801,10 +928,25 @@ irc_redirect_message (struct t_irc_server *server, const char *message,
     struct t_irc_redirect *ptr_redirect, *ptr_next_redirect;
     int rc, match_stop, arguments_argc;
     char **arguments_argv;
+    struct timeval tv_start, tv_end;
 
     if (!server || !server->redirects || !message || !command)
         return 0;
 
+    /*
+     * if no redirect is in progress, the message can only be redirected
+     * if its command is a start/stop command of a redirect
+     */
+    if ((server->redirects_in_progress == 0)
+        && (!server->redirects_commands
+            || !weechat_hashtable_has_key (server->redirects_commands,
+                                           command)))
+    {
+        return 0;
+    }
+
+    gettimeofday (&tv_start, NULL);
+
     rc = 0;
 
     if (arguments && arguments[0])
@@ -865,7 +1007,7 @@ irc_redirect_message (struct t_irc_server *server, const char *message,
                      * command as "received" for this redirect
                      */
                     irc_redirect_message_add (ptr_redirect, message, command);
-                    ptr_redirect->cmd_start_received = 1;
+                    irc_redirect_set_received (ptr_redirect, 1, 0);
                     rc = 1;
                     goto end;
                 }
@@ -888,7 +1030,9 @@ irc_redirect_message (struct t_irc_server *server, const char *message,
                     irc_redirect_message_add (ptr_redirect, message, command);
                     if (match_stop)
                     {
-                        ptr_redirect->cmd_stop_received = 1;
+                        irc_redirect_set_received (
+                            ptr_redirect,
+                            ptr_redirect->cmd_start_received, 1);
                         if (ptr_redirect->cmd_extra)
                         {
                             if (irc_redirect_message_match_hash (ptr_redirect,
@@ -926,6 +1070,11 @@ end:
     if (arguments_argv)
         weechat_string_free_split (arguments_argv);
 
+    gettimeofday (&tv_end, NULL);
+    irc_stats_add (server->stats, IRC_STATS_REDIRECT_MSGS, 1);
+    irc_stats_add (server->stats, IRC_STATS_REDIRECT_TIME,
+                   (long)weechat_util_timeval_diff (&tv_start, &tv_end));
+
     return rc;
 }
 
@@ -971,6 +1120,10 @@ irc_redirect_free (struct t_irc_redirect *redirect)
         }
     }
 
+    /* remove redirect from index and counter of redirects in progress */
+    irc_redirect_set_received (redirect, 0, 0);
+    irc_redirect_index_update (redirect, 0);
+
     /* free data */
     if (redirect->pattern)
         free (redirect->pattern);
@@ -101,6 +101,9 @@ extern struct t_irc_redirect *irc_redirect_new (struct t_irc_server *server,
                                                 const char *string,
                                                 int timeout,
                                                 const char *cmd_filter);
+extern void irc_redirect_set_received (struct t_irc_redirect *redirect,
+                                       int cmd_start_received,
+                                       int cmd_stop_received);
 extern struct t_irc_redirect *irc_redirect_search_available (struct t_irc_server *server);
 extern void irc_redirect_init_command (struct t_irc_redirect *redirect,
                                        const char *command);
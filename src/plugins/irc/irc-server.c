@@ -51,6 +51,7 @@
 #include "irc.h"
 #include "irc-server.h"
 #include "irc-bar-item.h"
+#include "irc-batch.h"
 #include "irc-buffer.h"
 #include "irc-channel.h"
 #include "irc-color.h"
@@ -62,8 +63,10 @@
 #include "irc-notify.h"
 #include "irc-protocol.h"
 #include "irc-raw.h"
+#include "irc-recv-thread.h"
 #include "irc-redirect.h"
 #include "irc-sasl.h"
+#include "irc-stats.h"
 
 
 struct t_irc_server *irc_servers = NULL;
@@ -88,6 +91,7 @@ char *irc_server_options[IRC_SERVER_NUM_OPTIONS][2] =
   { "ssl_verify",           "on"                      },
   { "password",             ""                        },
   { "capabilities",         ""                        },
+  { "chathistory_limit",    "100"                     },
   { "sasl_mechanism",       "plain"                   },
   { "sasl_username",        ""                        },
   { "sasl_password",        ""                        },
@@ -109,8 +113,11 @@ char *irc_server_options[IRC_SERVER_NUM_OPTIONS][2] =
   { "autorejoin",           "off"                     },
   { "autorejoin_delay",     "30"                      },
   { "connection_timeout",   "60"                      },
+  { "connection_priority",  "0"                       },
   { "anti_flood_prio_high", "2"                       },
   { "anti_flood_prio_low",  "2"                       },
+  { "anti_flood_burst",     "1"                       },
+  { "anti_flood_bytes",     "0"                       },
   { "away_check",           "0"                       },
   { "away_check_max_nicks", "25"                      },
   { "msg_kick",             ""                        },
@@ -362,6 +369,57 @@ irc_server_strncasecmp (struct t_irc_server *server,
     return rc;
 }
 
+/*
+ * Converts a string to lower case, using casemapping of server (the string
+ * can be used as key in hashtables, two strings which are equal with function
+ * irc_server_strcasecmp have the same lower case string).
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+irc_server_string_tolower (struct t_irc_server *server, const char *string)
+{
+    char *result, *ptr_result;
+    int casemapping, range;
+
+    if (!string)
+        return NULL;
+
+    result = strdup (string);
+    if (!result)
+        return NULL;
+
+    casemapping = (server) ? server->casemapping : IRC_SERVER_CASEMAPPING_RFC1459;
+    switch (casemapping)
+    {
+        case IRC_SERVER_CASEMAPPING_RFC1459:
+            range = 30;
+            break;
+        case IRC_SERVER_CASEMAPPING_STRICT_RFC1459:
+            range = 29;
+            break;
+        case IRC_SERVER_CASEMAPPING_ASCII:
+            range = 26;
+            break;
+        default:
+            range = 30;
+            break;
+    }
+
+    /*
+     * chars converted are all ASCII, so we can safely work on bytes
+     * (bytes of a multi-byte UTF-8 char are all >= 128)
+     */
+    for (ptr_result = result; ptr_result[0]; ptr_result++)
+    {
+        if ((ptr_result[0] >= 'A') && (ptr_result[0] < 'A' + range))
+            ptr_result[0] += ('a' - 'A');
+    }
+
+    return result;
+}
+
 /*
  * Evaluates a string using the server as context:
  * ${irc_server.xxx} and ${server} are replaced by a server option and the
@@ -1428,8 +1486,10 @@ irc_server_alloc (const char *name)
     new_server->sock = -1;
     new_server->hook_connect = NULL;
     new_server->hook_fd = NULL;
+    new_server->recv_thread = NULL;
     new_server->hook_timer_connection = NULL;
     new_server->hook_timer_sasl = NULL;
+    new_server->hook_timer_anti_flood = NULL;
     new_server->is_connected = 0;
     new_server->ssl_connected = 0;
     new_server->disconnected = 0;
@@ -1466,7 +1526,13 @@ irc_server_alloc (const char *name)
     new_server->monitor = 0;
     new_server->monitor_time = 0;
     new_server->reconnect_delay = 0;
+    new_server->reconnect_jitter = 0;
     new_server->reconnect_start = 0;
+    new_server->connect_pending = 0;
+    new_server->connect_start.tv_sec = 0;
+    new_server->connect_start.tv_usec = 0;
+    new_server->connect_duration = -1;
+    new_server->login_duration = -1;
     new_server->command_time = 0;
     new_server->reconnect_join = 0;
     new_server->disable_autojoin = 0;
@@ -1482,6 +1548,10 @@ irc_server_alloc (const char *name)
     new_server->lag_last_refresh = 0;
     new_server->cmd_list_regexp = NULL;
     new_server->last_user_message = 0;
+    new_server->anti_flood_msg_time.tv_sec = 0;
+    new_server->anti_flood_msg_time.tv_usec = 0;
+    new_server->anti_flood_bytes_time.tv_sec = 0;
+    new_server->anti_flood_bytes_time.tv_usec = 0;
     new_server->last_away_check = 0;
     new_server->last_data_purge = 0;
     for (i = 0; i < IRC_SERVER_NUM_OUTQUEUES_PRIO; i++)
@@ -1489,8 +1559,14 @@ irc_server_alloc (const char *name)
         new_server->outqueue[i] = NULL;
         new_server->last_outqueue[i] = NULL;
     }
+    new_server->outqueue_unsent = NULL;
     new_server->redirects = NULL;
     new_server->last_redirect = NULL;
+    new_server->redirects_commands = NULL;
+    new_server->redirects_in_progress = 0;
+    new_server->batches = NULL;
+    new_server->last_batch = NULL;
+    new_server->stats = irc_stats_new ();
     new_server->notify_list = NULL;
     new_server->last_notify = NULL;
     new_server->notify_count = 0;
@@ -1513,6 +1589,11 @@ irc_server_alloc (const char *name)
     new_server->buffer_as_string = NULL;
     new_server->channels = NULL;
     new_server->last_channel = NULL;
+    new_server->channels_hashtable = weechat_hashtable_new (
+        32,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_POINTER,
+        NULL, NULL);
 
     /* create options with null value */
     for (i = 0; i < IRC_SERVER_NUM_OPTIONS; i++)
@@ -1841,6 +1922,7 @@ irc_server_outqueue_add (struct t_irc_server *server, int priority,
         new_outqueue->modified = modified;
         new_outqueue->tags = (tags) ? strdup (tags) : NULL;
         new_outqueue->redirect = redirect;
+        gettimeofday (&new_outqueue->time_added, NULL);
 
         new_outqueue->prev_outqueue = server->last_outqueue[priority];
         new_outqueue->next_outqueue = NULL;
@@ -1926,14 +2008,21 @@ irc_server_free_data (struct t_irc_server *server)
     {
         irc_server_outqueue_free_all (server, i);
     }
+    if (server->outqueue_unsent)
+        free (server->outqueue_unsent);
     irc_redirect_free_all (server);
+    irc_batch_free_all (server);
     irc_notify_free_all (server);
     irc_channel_free_all (server);
+    irc_stats_free (server->stats);
 
     /* free hashtables */
+    if (server->redirects_commands)
+        weechat_hashtable_free (server->redirects_commands);
     weechat_hashtable_free (server->join_manual);
     weechat_hashtable_free (server->join_channel_key);
     weechat_hashtable_free (server->join_noswitch);
+    weechat_hashtable_free (server->channels_hashtable);
 
     /* free server data */
     for (i = 0; i < IRC_SERVER_NUM_OPTIONS; i++)
@@ -1957,12 +2046,15 @@ irc_server_free_data (struct t_irc_server *server)
         free (server->current_ip);
     if (server->hook_connect)
         weechat_unhook (server->hook_connect);
+    irc_recv_thread_stop (server, 0);
     if (server->hook_fd)
         weechat_unhook (server->hook_fd);
     if (server->hook_timer_connection)
         weechat_unhook (server->hook_timer_connection);
     if (server->hook_timer_sasl)
         weechat_unhook (server->hook_timer_sasl);
+    if (server->hook_timer_anti_flood)
+        weechat_unhook (server->hook_timer_anti_flood);
     if (server->unterminated_message)
         free (server->unterminated_message);
     if (server->nicks_array)
@@ -2032,6 +2124,8 @@ irc_server_free (struct t_irc_server *server)
     if (server->next_server)
         (server->next_server)->prev_server = server->prev_server;
 
+    irc_raw_message_remove_server (server);
+
     irc_server_free_data (server);
     free (server);
     irc_servers = new_irc_servers;
@@ -2315,7 +2409,7 @@ irc_server_send_signal (struct t_irc_server *server, const char *signal,
 /*
  * Sends data to IRC server.
  *
- * Returns number of bytes sent, -1 if error.
+ * Returns number of bytes sent (0 if the socket is full), -1 if error.
  */
 
 int
@@ -2324,7 +2418,10 @@ irc_server_send (struct t_irc_server *server, const char *buffer, int size_buf)
     int rc;
 
     if (server->fake_server)
+    {
+        irc_stats_add_sent (server->stats, buffer, size_buf);
         return size_buf;
+    }
 
     if (!server)
     {
@@ -2355,6 +2452,8 @@ irc_server_send (struct t_irc_server *server, const char *buffer, int size_buf)
     {
         if (server->ssl_connected)
         {
+            if ((rc == GNUTLS_E_AGAIN) || (rc == GNUTLS_E_INTERRUPTED))
+                return 0;
             weechat_printf (
                 server->buffer,
                 _("%s%s: sending data to server: error %d %s"),
@@ -2363,6 +2462,11 @@ irc_server_send (struct t_irc_server *server, const char *buffer, int size_buf)
         }
         else
         {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)
+                || (errno == EINTR))
+            {
+                return 0;
+            }
             weechat_printf (
                 server->buffer,
                 _("%s%s: sending data to server: error %d %s"),
@@ -2370,10 +2474,94 @@ irc_server_send (struct t_irc_server *server, const char *buffer, int size_buf)
                 errno, strerror (errno));
         }
     }
+    else
+    {
+        irc_stats_add_sent (server->stats, buffer, rc);
+    }
 
     return rc;
 }
 
+/*
+ * Sends data not yet sent to IRC server (socket was full).
+ *
+ * The data that still can not be sent is kept in server->outqueue_unsent.
+ */
+
+void
+irc_server_send_unsent (struct t_irc_server *server)
+{
+    int size, sent;
+
+    if (!server->outqueue_unsent)
+        return;
+
+    size = strlen (server->outqueue_unsent);
+    sent = irc_server_send (server, server->outqueue_unsent, size);
+    if ((sent < 0) || (sent >= size))
+    {
+        /* all data sent (or error: data is lost) */
+        free (server->outqueue_unsent);
+        server->outqueue_unsent = NULL;
+    }
+    else if (sent > 0)
+    {
+        memmove (server->outqueue_unsent, server->outqueue_unsent + sent,
+                 size - sent + 1);
+    }
+}
+
+/*
+ * Sends data to IRC server, after data not yet sent (if any).
+ *
+ * The data that can not be sent now (socket full) is kept in
+ * server->outqueue_unsent and sent later by the out queue timer, so that
+ * the messages are never truncated.
+ *
+ * Returns:
+ *   1: OK (data sent or kept to be sent later)
+ *   0: error
+ */
+
+int
+irc_server_send_data (struct t_irc_server *server, const char *data)
+{
+    char *new_unsent;
+    int size, length, sent;
+
+    size = strlen (data);
+    if (size == 0)
+        return 1;
+
+    if (server->outqueue_unsent)
+    {
+        length = strlen (server->outqueue_unsent);
+        new_unsent = realloc (server->outqueue_unsent, length + size + 1);
+        if (!new_unsent)
+            return 0;
+        server->outqueue_unsent = new_unsent;
+        memcpy (server->outqueue_unsent + length, data, size + 1);
+        irc_server_send_unsent (server);
+    }
+    else
+    {
+        sent = irc_server_send (server, data, size);
+        if (sent < 0)
+            return 0;
+        if (sent < size)
+        {
+            server->outqueue_unsent = strdup (data + sent);
+            if (!server->outqueue_unsent)
+                return 0;
+        }
+    }
+
+    if (server->outqueue_unsent)
+        irc_server_outqueue_schedule (server);
+
+    return 1;
+}
+
 /*
  * Sets default tags used when sending message.
  */
@@ -2415,96 +2603,349 @@ irc_server_get_tags_to_send (const char *tags)
 }
 
 /*
- * Sends a message from out queue.
+ * Returns the anti-flood delay (in milliseconds) between two messages for an
+ * out queue.
+ */
+
+long long
+irc_server_anti_flood_delay (struct t_irc_server *server, int priority)
+{
+    int anti_flood;
+
+    switch (priority)
+    {
+        case 0:
+            anti_flood = IRC_SERVER_OPTION_INTEGER(
+                server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH);
+            break;
+        default:
+            anti_flood = IRC_SERVER_OPTION_INTEGER(
+                server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW);
+            break;
+    }
+
+    return ((long long)anti_flood) * 1000;
+}
+
+/*
+ * Returns the time (in milliseconds) to wait before a message of "size" bytes
+ * can be sent with the given out queue priority.
+ *
+ * The anti-flood is a token bucket (implemented as a "generic cell rate
+ * algorithm", which only needs the theoretical time of next message):
+ *   - up to "anti_flood_burst" messages can be sent immediately, then one
+ *     message is allowed every "anti_flood_prio_high" (or "low") seconds,
+ *   - if "anti_flood_bytes" is set, no more than this number of bytes are
+ *     sent in any period of one second.
+ *
+ * Returns 0 if the message can be sent now.
+ */
+
+long long
+irc_server_anti_flood_wait (struct t_irc_server *server, int priority,
+                            int size)
+{
+    struct timeval tv_now;
+    long long delay, tolerance, wait_msg, wait_bytes, bytes_delay, diff;
+    int burst, bytes_per_second;
+
+    if (!server)
+        return 0;
+
+    gettimeofday (&tv_now, NULL);
+
+    /* messages */
+    delay = irc_server_anti_flood_delay (server, priority);
+    burst = IRC_SERVER_OPTION_INTEGER(server,
+                                      IRC_SERVER_OPTION_ANTI_FLOOD_BURST);
+    tolerance = (burst > 1) ? (burst - 1) * delay : 0;
+    wait_msg = (weechat_util_timeval_diff (&tv_now,
+                                           &server->anti_flood_msg_time) / 1000)
+        - tolerance;
+    if (wait_msg > delay)
+    {
+        /* system clock has been changed (now lower than before) */
+        server->anti_flood_msg_time = tv_now;
+        wait_msg = 0;
+    }
+
+    /* bytes */
+    wait_bytes = 0;
+    bytes_per_second = IRC_SERVER_OPTION_INTEGER(
+        server, IRC_SERVER_OPTION_ANTI_FLOOD_BYTES);
+    if ((bytes_per_second > 0) && (size > 0))
+    {
+        bytes_delay = (((long long)size) * 1000) / bytes_per_second;
+        diff = weechat_util_timeval_diff (&tv_now,
+                                          &server->anti_flood_bytes_time) / 1000;
+        if (diff > 1000 + bytes_delay)
+        {
+            /* system clock has been changed (now lower than before) */
+            server->anti_flood_bytes_time = tv_now;
+        }
+        else if (diff > 0)
+        {
+            /*
+             * bucket is not empty: wait until there's enough room for the
+             * message (an empty bucket always accepts a message, even if it
+             * is bigger than the number of bytes allowed per second)
+             */
+            wait_bytes = diff + bytes_delay - 1000;
+        }
+    }
+
+    if (wait_msg < 0)
+        wait_msg = 0;
+    if (wait_bytes < 0)
+        wait_bytes = 0;
+
+    return (wait_msg > wait_bytes) ? wait_msg : wait_bytes;
+}
+
+/*
+ * Consumes anti-flood tokens for a message of "size" bytes sent with the
+ * given out queue priority.
  */
 
 void
-irc_server_outqueue_send (struct t_irc_server *server)
+irc_server_anti_flood_consume (struct t_irc_server *server, int priority,
+                               int size)
 {
-    time_t time_now;
-    char *pos, *tags_to_send;
-    int priority, anti_flood;
+    struct timeval tv_now;
+    int bytes_per_second;
+
+    if (!server)
+        return;
 
-    time_now = time (NULL);
+    gettimeofday (&tv_now, NULL);
 
-    /* detect if system clock has been changed (now lower than before) */
-    if (server->last_user_message > time_now)
-        server->last_user_message = time_now;
+    if (weechat_util_timeval_cmp (&server->anti_flood_msg_time, &tv_now) < 0)
+        server->anti_flood_msg_time = tv_now;
+    weechat_util_timeval_add (&server->anti_flood_msg_time,
+                              irc_server_anti_flood_delay (server, priority) * 1000);
+
+    bytes_per_second = IRC_SERVER_OPTION_INTEGER(
+        server, IRC_SERVER_OPTION_ANTI_FLOOD_BYTES);
+    if ((bytes_per_second > 0) && (size > 0))
+    {
+        if (weechat_util_timeval_cmp (&server->anti_flood_bytes_time,
+                                      &tv_now) < 0)
+        {
+            server->anti_flood_bytes_time = tv_now;
+        }
+        weechat_util_timeval_add (
+            &server->anti_flood_bytes_time,
+            (((long long)size) * 1000 * 1000) / bytes_per_second);
+    }
+
+    server->last_user_message = tv_now.tv_sec;
+}
+
+/*
+ * Callback for anti-flood timer: sends messages from out queues.
+ */
+
+int
+irc_server_outqueue_timer_cb (const void *pointer, void *data,
+                              int remaining_calls)
+{
+    struct t_irc_server *server;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) remaining_calls;
+
+    server = (struct t_irc_server *)pointer;
+
+    if (!server)
+        return WEECHAT_RC_ERROR;
+
+    server->hook_timer_anti_flood = NULL;
+
+    if (server->is_connected)
+        irc_server_outqueue_send (server);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Schedules a timer to send messages from out queues as soon as the
+ * anti-flood allows it (if some messages are queued and no timer is already
+ * scheduled).
+ */
+
+void
+irc_server_outqueue_schedule (struct t_irc_server *server)
+{
+    long long wait, min_wait;
+    int priority;
+
+    if (server->hook_timer_anti_flood)
+        return;
+
+    if (server->outqueue_unsent)
+    {
+        server->hook_timer_anti_flood = weechat_hook_timer (
+            IRC_SERVER_OUTQUEUE_UNSENT_DELAY, 0, 1,
+            &irc_server_outqueue_timer_cb, server, NULL);
+        return;
+    }
 
+    min_wait = -1;
     for (priority = 0; priority < IRC_SERVER_NUM_OUTQUEUES_PRIO; priority++)
     {
-        switch (priority)
+        if (!server->outqueue[priority])
+            continue;
+        wait = irc_server_anti_flood_wait (
+            server, priority,
+            (server->outqueue[priority]->message_after_mod) ?
+            strlen (server->outqueue[priority]->message_after_mod) : 0);
+        if ((min_wait < 0) || (wait < min_wait))
+            min_wait = wait;
+    }
+
+    if (min_wait < 0)
+        return;
+
+    server->hook_timer_anti_flood = weechat_hook_timer (
+        (min_wait > 0) ? min_wait : 1, 0, 1,
+        &irc_server_outqueue_timer_cb, server, NULL);
+}
+
+/*
+ * Sends messages from out queues: all messages allowed by the anti-flood are
+ * sent at once to the server (with a single call to send), up to
+ * IRC_SERVER_OUTQUEUE_BATCH_MAX_SIZE bytes.
+ *
+ * Data of a previous batch not fully sent (socket full) is sent first, and
+ * no message is taken from the queues until it is entirely sent.
+ *
+ * If some messages are still in queues, a timer is scheduled to send them
+ * later.
+ */
+
+void
+irc_server_outqueue_send (struct t_irc_server *server)
+{
+    struct t_irc_outqueue *ptr_outqueue;
+    char **batch, *pos, *tags_to_send;
+    int priority, size;
+    struct timeval tv_now;
+
+    if (server->outqueue_unsent)
+    {
+        irc_server_send_unsent (server);
+        if (server->outqueue_unsent)
         {
-            case 0:
-                anti_flood = IRC_SERVER_OPTION_INTEGER(
-                    server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH);
-                break;
-            default:
-                anti_flood = IRC_SERVER_OPTION_INTEGER(
-                    server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW);
-                break;
+            irc_server_outqueue_schedule (server);
+            return;
         }
-        if (server->outqueue[priority]
-            && (time_now >= server->last_user_message + anti_flood))
+    }
+
+    batch = NULL;
+
+    while (1)
+    {
+        /* search first queue with a message allowed by the anti-flood */
+        ptr_outqueue = NULL;
+        size = 0;
+        for (priority = 0; priority < IRC_SERVER_NUM_OUTQUEUES_PRIO;
+             priority++)
         {
-            if (server->outqueue[priority]->message_before_mod)
+            if (!server->outqueue[priority])
+                continue;
+            size = (server->outqueue[priority]->message_after_mod) ?
+                strlen (server->outqueue[priority]->message_after_mod) : 0;
+            if (irc_server_anti_flood_wait (server, priority, size) == 0)
             {
-                pos = strchr (server->outqueue[priority]->message_before_mod,
-                              '\r');
-                if (pos)
-                    pos[0] = '\0';
-                irc_raw_print (server, IRC_RAW_FLAG_SEND,
-                               server->outqueue[priority]->message_before_mod);
-                if (pos)
-                    pos[0] = '\r';
+                ptr_outqueue = server->outqueue[priority];
+                break;
             }
-            if (server->outqueue[priority]->message_after_mod)
-            {
-                pos = strchr (server->outqueue[priority]->message_after_mod,
-                              '\r');
-                if (pos)
-                    pos[0] = '\0';
-                irc_raw_print (server, IRC_RAW_FLAG_SEND |
-                               ((server->outqueue[priority]->modified) ? IRC_RAW_FLAG_MODIFIED : 0),
-                               server->outqueue[priority]->message_after_mod);
-                if (pos)
-                    pos[0] = '\r';
+        }
+        if (!ptr_outqueue)
+            break;
 
-                /* send signal with command that will be sent to server */
-                irc_server_send_signal (
-                    server, "irc_out",
-                    server->outqueue[priority]->command,
-                    server->outqueue[priority]->message_after_mod,
-                    NULL);
-                tags_to_send = irc_server_get_tags_to_send (
-                    server->outqueue[priority]->tags);
-                irc_server_send_signal (
-                    server, "irc_outtags",
-                    server->outqueue[priority]->command,
-                    server->outqueue[priority]->message_after_mod,
-                    (tags_to_send) ? tags_to_send : "");
-                if (tags_to_send)
-                    free (tags_to_send);
+        if (!batch)
+        {
+            batch = weechat_string_dyn_alloc (256);
+            if (!batch)
+                break;
+        }
 
-                /* send command */
-                irc_server_send (
-                    server, server->outqueue[priority]->message_after_mod,
-                    strlen (server->outqueue[priority]->message_after_mod));
-                server->last_user_message = time_now;
+        /* batch is full: other messages will be sent later */
+        if ((*batch)[0]
+            && ((int)strlen (*batch) + size > IRC_SERVER_OUTQUEUE_BATCH_MAX_SIZE))
+        {
+            break;
+        }
 
-                /* start redirection if redirect is set */
-                if (server->outqueue[priority]->redirect)
-                {
-                    irc_redirect_init_command (
-                        server->outqueue[priority]->redirect,
-                        server->outqueue[priority]->message_after_mod);
-                }
+        if (ptr_outqueue->message_before_mod)
+        {
+            pos = strchr (ptr_outqueue->message_before_mod, '\r');
+            if (pos)
+                pos[0] = '\0';
+            irc_raw_print (server, IRC_RAW_FLAG_SEND,
+                           ptr_outqueue->message_before_mod);
+            if (pos)
+                pos[0] = '\r';
+        }
+        if (ptr_outqueue->message_after_mod)
+        {
+            pos = strchr (ptr_outqueue->message_after_mod, '\r');
+            if (pos)
+                pos[0] = '\0';
+            irc_raw_print (server, IRC_RAW_FLAG_SEND |
+                           ((ptr_outqueue->modified) ? IRC_RAW_FLAG_MODIFIED : 0),
+                           ptr_outqueue->message_after_mod);
+            if (pos)
+                pos[0] = '\r';
+
+            /* send signal with command that will be sent to server */
+            irc_server_send_signal (
+                server, "irc_out",
+                ptr_outqueue->command,
+                ptr_outqueue->message_after_mod,
+                NULL);
+            tags_to_send = irc_server_get_tags_to_send (ptr_outqueue->tags);
+            irc_server_send_signal (
+                server, "irc_outtags",
+                ptr_outqueue->command,
+                ptr_outqueue->message_after_mod,
+                (tags_to_send) ? tags_to_send : "");
+            if (tags_to_send)
+                free (tags_to_send);
+
+            /* add command in batch (sent after this loop) */
+            weechat_string_dyn_concat (batch, ptr_outqueue->message_after_mod,
+                                       -1);
+            irc_server_anti_flood_consume (server, priority, size);
+
+            /* start redirection if redirect is set */
+            if (ptr_outqueue->redirect)
+            {
+                irc_redirect_init_command (ptr_outqueue->redirect,
+                                           ptr_outqueue->message_after_mod);
             }
-            irc_server_outqueue_free (server, priority,
-                                      server->outqueue[priority]);
-            break;
+
+            /* time spent by message in queue */
+            gettimeofday (&tv_now, NULL);
+            irc_stats_add (server->stats, IRC_STATS_OUTQUEUE_MSGS, 1);
+            irc_stats_add (
+                server->stats, IRC_STATS_OUTQUEUE_WAIT,
+                (long)(weechat_util_timeval_diff (&ptr_outqueue->time_added,
+                                                  &tv_now) / 1000));
         }
+        irc_server_outqueue_free (server, priority, ptr_outqueue);
     }
+
+    /* send all commands at once (data not sent now is sent later) */
+    if (batch && (*batch)[0])
+        irc_server_send_data (server, *batch);
+
+    if (batch)
+        weechat_string_dyn_free (batch, 1);
+
+    irc_server_outqueue_schedule (server);
 }
 
 /*
@@ -2531,9 +2972,8 @@ irc_server_send_one_msg (struct t_irc_server *server, int flags,
     const char *ptr_msg, *ptr_chan_nick;
     char *new_msg, *pos, *tags_to_send, *msg_encoded;
     char str_modifier[128], modifier_data[256];
-    int rc, queue_msg, add_to_queue, first_message, anti_flood;
+    int rc, queue_msg, add_to_queue, first_message;
     int pos_channel, pos_text, pos_encode;
-    time_t time_now;
     struct t_irc_redirect *ptr_redirect;
 
     rc = 1;
@@ -2613,13 +3053,6 @@ irc_server_send_one_msg (struct t_irc_server *server, int flags,
 
             snprintf (buffer, sizeof (buffer), "%s\r\n", ptr_msg);
 
-            /* anti-flood: look whether we should queue outgoing message or not */
-            time_now = time (NULL);
-
-            /* detect if system clock has been changed (now lower than before) */
-            if (server->last_user_message > time_now)
-                server->last_user_message = time_now;
-
             /* get queue from flags */
             queue_msg = 0;
             if (flags & IRC_SERVER_SEND_OUTQ_PRIO_HIGH)
@@ -2627,23 +3060,12 @@ irc_server_send_one_msg (struct t_irc_server *server, int flags,
             else if (flags & IRC_SERVER_SEND_OUTQ_PRIO_LOW)
                 queue_msg = 2;
 
-            switch (queue_msg - 1)
-            {
-                case 0:
-                    anti_flood = IRC_SERVER_OPTION_INTEGER(
-                        server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH);
-                    break;
-                default:
-                    anti_flood = IRC_SERVER_OPTION_INTEGER(
-                        server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW);
-                    break;
-            }
-
+            /* anti-flood: look whether we should queue outgoing message or not */
             add_to_queue = 0;
             if ((queue_msg > 0)
                 && (server->outqueue[queue_msg - 1]
-                    || ((anti_flood > 0)
-                        && (time_now - server->last_user_message < anti_flood))))
+                    || (irc_server_anti_flood_wait (server, queue_msg - 1,
+                                                    strlen (buffer)) > 0)))
             {
                 add_to_queue = queue_msg;
             }
@@ -2664,6 +3086,7 @@ irc_server_send_one_msg (struct t_irc_server *server, int flags,
                 /* mark redirect as "used" */
                 if (ptr_redirect)
                     ptr_redirect->assigned_to_command = 1;
+                irc_server_outqueue_schedule (server);
             }
             else
             {
@@ -2688,12 +3111,15 @@ irc_server_send_one_msg (struct t_irc_server *server, int flags,
                                         ptr_msg,
                                         (tags_to_send) ? tags_to_send : "");
 
-                if (irc_server_send (server, buffer, strlen (buffer)) <= 0)
+                if (!irc_server_send_data (server, buffer))
                     rc = 0;
                 else
                 {
                     if (queue_msg > 0)
-                        server->last_user_message = time_now;
+                    {
+                        irc_server_anti_flood_consume (server, queue_msg - 1,
+                                                       strlen (buffer));
+                    }
                 }
                 if (ptr_redirect)
                     irc_redirect_init_command (ptr_redirect, buffer);
@@ -3018,6 +3444,7 @@ irc_server_msgq_flush ()
     char *msg_decoded, *msg_decoded_without_color;
     char str_modifier[128], modifier_data[256];
     int pos_channel, pos_text, pos_decode;
+    struct timeval tv_start;
 
     while (irc_recv_msgq)
     {
@@ -3070,6 +3497,8 @@ irc_server_msgq_flush ()
 
                         while (ptr_msg && ptr_msg[0])
                         {
+                            gettimeofday (&tv_start, NULL);
+
                             pos = strchr (ptr_msg, '\n');
                             if (pos)
                                 pos[0] = '\0';
@@ -3180,6 +3609,12 @@ irc_server_msgq_flush ()
                                 {
                                     /* message redirected, we'll not display it! */
                                 }
+                                else if (irc_batch_add_message (irc_recv_msgq->server,
+                                                                ptr_msg2, command,
+                                                                channel, arguments))
+                                {
+                                    /* message in a batch, displayed at end of batch */
+                                }
                                 else
                                 {
                                     /* message not redirected, display it */
@@ -3191,6 +3626,9 @@ irc_server_msgq_flush ()
                                 }
                             }
 
+                            irc_stats_add_message (irc_recv_msgq->server->stats,
+                                                   command, &tv_start);
+
                             if (new_msg2)
                                 free (new_msg2);
                             if (nick)
@@ -3238,6 +3676,30 @@ irc_server_msgq_flush ()
     }
 }
 
+/*
+ * Displays an error when reading data on socket failed (or if connection was
+ * closed by peer) and disconnects from server.
+ *
+ * Argument "error" is a gnutls error code if SSL is used, otherwise errno.
+ */
+
+void
+irc_server_recv_error (struct t_irc_server *server, int closed, int error)
+{
+    weechat_printf (
+        server->buffer,
+        _("%s%s: reading data on socket: error %d %s"),
+        weechat_prefix ("error"), IRC_PLUGIN_NAME,
+        error,
+        (closed) ? _("(connection closed by peer)") :
+        ((server->ssl_connected) ? gnutls_strerror (error) : strerror (error)));
+    weechat_printf (
+        server->buffer,
+        _("%s%s: disconnecting from server..."),
+        weechat_prefix ("network"), IRC_PLUGIN_NAME);
+    irc_server_disconnect (server, !server->is_connected, 1);
+}
+
 /*
  * Receives data from a server.
  */
@@ -3273,6 +3735,7 @@ irc_server_recv_cb (const void *pointer, void *data, int fd)
         if (num_read > 0)
         {
             buffer[num_read] = '\0';
+            irc_stats_add (server->stats, IRC_STATS_BYTES_RECV, num_read);
             irc_server_msgq_add_buffer (server, buffer);
             msgq_flush = 1;  /* the flush will be done after the loop */
             if (server->ssl_connected
@@ -3293,18 +3756,7 @@ irc_server_recv_cb (const void *pointer, void *data, int fd)
                     || ((num_read != GNUTLS_E_AGAIN)
                         && (num_read != GNUTLS_E_INTERRUPTED)))
                 {
-                    weechat_printf (
-                        server->buffer,
-                        _("%s%s: reading data on socket: error %d %s"),
-                        weechat_prefix ("error"), IRC_PLUGIN_NAME,
-                        num_read,
-                        (num_read == 0) ? _("(connection closed by peer)") :
-                        gnutls_strerror (num_read));
-                    weechat_printf (
-                        server->buffer,
-                        _("%s%s: disconnecting from server..."),
-                        weechat_prefix ("network"), IRC_PLUGIN_NAME);
-                    irc_server_disconnect (server, !server->is_connected, 1);
+                    irc_server_recv_error (server, (num_read == 0), num_read);
                 }
             }
             else
@@ -3312,18 +3764,7 @@ irc_server_recv_cb (const void *pointer, void *data, int fd)
                 if ((num_read == 0)
                     || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
                 {
-                    weechat_printf (
-                        server->buffer,
-                        _("%s%s: reading data on socket: error %d %s"),
-                        weechat_prefix ("error"), IRC_PLUGIN_NAME,
-                        errno,
-                        (num_read == 0) ? _("(connection closed by peer)") :
-                        strerror (errno));
-                    weechat_printf (
-                        server->buffer,
-                        _("%s%s: disconnecting from server..."),
-                        weechat_prefix ("network"), IRC_PLUGIN_NAME);
-                    irc_server_disconnect (server, !server->is_connected, 1);
+                    irc_server_recv_error (server, (num_read == 0), errno);
                 }
             }
         }
@@ -3335,6 +3776,32 @@ irc_server_recv_cb (const void *pointer, void *data, int fd)
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Hooks socket of server to receive data: in a thread if option
+ * irc.network.recv_thread is enabled, otherwise in main thread.
+ */
+
+void
+irc_server_hook_recv (struct t_irc_server *server)
+{
+    if (!server || server->fake_server || (server->sock < 0)
+        || server->hook_fd)
+    {
+        return;
+    }
+
+    if (weechat_config_boolean (irc_config_network_recv_thread)
+        && irc_recv_thread_start (server))
+    {
+        return;
+    }
+
+    server->hook_fd = weechat_hook_fd (server->sock,
+                                       1, 0, 0,
+                                       &irc_server_recv_cb,
+                                       server, NULL);
+}
+
 /*
  * Callback for server connection: it is called if WeeChat is TCP-connected to
  * server, but did not receive message 001.
@@ -3491,163 +3958,161 @@ irc_server_timer_cb (const void *pointer, void *data, int remaining_calls)
 
     current_time = time (NULL);
 
+    /* start pending connections and reconnections (if slots are free) */
+    irc_server_connect_pending (current_time);
+
     for (ptr_server = irc_servers; ptr_server;
          ptr_server = ptr_server->next_server)
     {
-        /* check if reconnection is pending */
-        if ((!ptr_server->is_connected)
-            && (ptr_server->reconnect_start > 0)
-            && (current_time >= (ptr_server->reconnect_start + ptr_server->reconnect_delay)))
+        /* (re)connections are started by irc_server_connect_pending */
+        if (!ptr_server->is_connected)
+            continue;
+
+        /* send queued messages */
+        irc_server_outqueue_send (ptr_server);
+
+        /* check for lag */
+        if ((weechat_config_integer (irc_config_network_lag_check) > 0)
+            && (ptr_server->lag_check_time.tv_sec == 0)
+            && (current_time >= ptr_server->lag_next_check))
         {
-            irc_server_reconnect (ptr_server);
+            irc_server_sendf (ptr_server, 0, NULL, "PING %s",
+                              (ptr_server->current_address) ?
+                              ptr_server->current_address : "weechat");
+            gettimeofday (&(ptr_server->lag_check_time), NULL);
+            ptr_server->lag = 0;
+            ptr_server->lag_last_refresh = 0;
         }
         else
         {
-            if (!ptr_server->is_connected)
-                continue;
-
-            /* send queued messages */
-            irc_server_outqueue_send (ptr_server);
-
-            /* check for lag */
-            if ((weechat_config_integer (irc_config_network_lag_check) > 0)
-                && (ptr_server->lag_check_time.tv_sec == 0)
-                && (current_time >= ptr_server->lag_next_check))
+            /* check away (only if lag check was not done) */
+            away_check = IRC_SERVER_OPTION_INTEGER(
+                ptr_server, IRC_SERVER_OPTION_AWAY_CHECK);
+            if (!weechat_hashtable_has_key (ptr_server->cap_list,
+                                            "away-notify")
+                && (away_check > 0)
+                && ((ptr_server->last_away_check == 0)
+                    || (current_time >= ptr_server->last_away_check + (away_check * 60))))
             {
-                irc_server_sendf (ptr_server, 0, NULL, "PING %s",
-                                  (ptr_server->current_address) ?
-                                  ptr_server->current_address : "weechat");
-                gettimeofday (&(ptr_server->lag_check_time), NULL);
-                ptr_server->lag = 0;
-                ptr_server->lag_last_refresh = 0;
+                irc_server_check_away (ptr_server);
             }
-            else
+        }
+
+        /* check if it's time to autojoin channels (after command delay) */
+        if ((ptr_server->command_time != 0)
+            && (current_time >= ptr_server->command_time +
+                IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_COMMAND_DELAY)))
+        {
+            irc_server_autojoin_channels (ptr_server);
+            ptr_server->command_time = 0;
+        }
+
+        /* check if it's time to send MONITOR command */
+        if ((ptr_server->monitor_time != 0)
+            && (current_time >= ptr_server->monitor_time))
+        {
+            if (ptr_server->monitor > 0)
+                irc_notify_send_monitor (ptr_server);
+            ptr_server->monitor_time = 0;
+        }
+
+        /* end batches not ended by server after a delay */
+        if (ptr_server->batches)
+            irc_batch_end_expired (ptr_server, current_time);
+
+        /* compute lag */
+        if (ptr_server->lag_check_time.tv_sec != 0)
+        {
+            refresh_lag = 0;
+            gettimeofday (&tv, NULL);
+            ptr_server->lag = (int)(weechat_util_timeval_diff (&(ptr_server->lag_check_time),
+                                                               &tv) / 1000);
+            /* refresh lag item if needed */
+            if (((ptr_server->lag_last_refresh == 0)
+                 || (current_time >= ptr_server->lag_last_refresh + weechat_config_integer (irc_config_network_lag_refresh_interval)))
+                && (ptr_server->lag >= weechat_config_integer (irc_config_network_lag_min_show)))
             {
-                /* check away (only if lag check was not done) */
-                away_check = IRC_SERVER_OPTION_INTEGER(
-                    ptr_server, IRC_SERVER_OPTION_AWAY_CHECK);
-                if (!weechat_hashtable_has_key (ptr_server->cap_list,
-                                                "away-notify")
-                    && (away_check > 0)
-                    && ((ptr_server->last_away_check == 0)
-                        || (current_time >= ptr_server->last_away_check + (away_check * 60))))
+                ptr_server->lag_last_refresh = current_time;
+                if (ptr_server->lag != ptr_server->lag_displayed)
                 {
-                    irc_server_check_away (ptr_server);
+                    ptr_server->lag_displayed = ptr_server->lag;
+                    refresh_lag = 1;
                 }
             }
-
-            /* check if it's time to autojoin channels (after command delay) */
-            if ((ptr_server->command_time != 0)
-                && (current_time >= ptr_server->command_time +
-                    IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_COMMAND_DELAY)))
-            {
-                irc_server_autojoin_channels (ptr_server);
-                ptr_server->command_time = 0;
-            }
-
-            /* check if it's time to send MONITOR command */
-            if ((ptr_server->monitor_time != 0)
-                && (current_time >= ptr_server->monitor_time))
+            /* lag timeout? => disconnect */
+            if ((weechat_config_integer (irc_config_network_lag_reconnect) > 0)
+                && (ptr_server->lag >= weechat_config_integer (irc_config_network_lag_reconnect) * 1000))
             {
-                if (ptr_server->monitor > 0)
-                    irc_notify_send_monitor (ptr_server);
-                ptr_server->monitor_time = 0;
+                weechat_printf (
+                    ptr_server->buffer,
+                    _("%s%s: lag is high, reconnecting to server %s%s%s"),
+                    weechat_prefix ("network"),
+                    IRC_PLUGIN_NAME,
+                    IRC_COLOR_CHAT_SERVER,
+                    ptr_server->name,
+                    IRC_COLOR_RESET);
+                irc_server_disconnect (ptr_server, 0, 1);
             }
-
-            /* compute lag */
-            if (ptr_server->lag_check_time.tv_sec != 0)
+            else
             {
-                refresh_lag = 0;
-                gettimeofday (&tv, NULL);
-                ptr_server->lag = (int)(weechat_util_timeval_diff (&(ptr_server->lag_check_time),
-                                                                   &tv) / 1000);
-                /* refresh lag item if needed */
-                if (((ptr_server->lag_last_refresh == 0)
-                     || (current_time >= ptr_server->lag_last_refresh + weechat_config_integer (irc_config_network_lag_refresh_interval)))
-                    && (ptr_server->lag >= weechat_config_integer (irc_config_network_lag_min_show)))
+                /* stop lag counting if max lag is reached */
+                if ((weechat_config_integer (irc_config_network_lag_max) > 0)
+                    && (ptr_server->lag >= (weechat_config_integer (irc_config_network_lag_max) * 1000)))
                 {
+                    /* refresh lag item */
                     ptr_server->lag_last_refresh = current_time;
                     if (ptr_server->lag != ptr_server->lag_displayed)
                     {
                         ptr_server->lag_displayed = ptr_server->lag;
                         refresh_lag = 1;
                     }
-                }
-                /* lag timeout? => disconnect */
-                if ((weechat_config_integer (irc_config_network_lag_reconnect) > 0)
-                    && (ptr_server->lag >= weechat_config_integer (irc_config_network_lag_reconnect) * 1000))
-                {
-                    weechat_printf (
-                        ptr_server->buffer,
-                        _("%s%s: lag is high, reconnecting to server %s%s%s"),
-                        weechat_prefix ("network"),
-                        IRC_PLUGIN_NAME,
-                        IRC_COLOR_CHAT_SERVER,
-                        ptr_server->name,
-                        IRC_COLOR_RESET);
-                    irc_server_disconnect (ptr_server, 0, 1);
-                }
-                else
-                {
-                    /* stop lag counting if max lag is reached */
-                    if ((weechat_config_integer (irc_config_network_lag_max) > 0)
-                        && (ptr_server->lag >= (weechat_config_integer (irc_config_network_lag_max) * 1000)))
-                    {
-                        /* refresh lag item */
-                        ptr_server->lag_last_refresh = current_time;
-                        if (ptr_server->lag != ptr_server->lag_displayed)
-                        {
-                            ptr_server->lag_displayed = ptr_server->lag;
-                            refresh_lag = 1;
-                        }
 
-                        /* schedule next lag check in 5 seconds */
-                        ptr_server->lag_check_time.tv_sec = 0;
-                        ptr_server->lag_check_time.tv_usec = 0;
-                        ptr_server->lag_next_check = time (NULL) +
-                            weechat_config_integer (irc_config_network_lag_check);
-                    }
+                    /* schedule next lag check in 5 seconds */
+                    ptr_server->lag_check_time.tv_sec = 0;
+                    ptr_server->lag_check_time.tv_usec = 0;
+                    ptr_server->lag_next_check = time (NULL) +
+                        weechat_config_integer (irc_config_network_lag_check);
                 }
-                if (refresh_lag)
-                    irc_server_set_lag (ptr_server);
             }
+            if (refresh_lag)
+                irc_server_set_lag (ptr_server);
+        }
 
-            /* remove redirects if timeout occurs */
-            ptr_redirect = ptr_server->redirects;
-            while (ptr_redirect)
-            {
-                ptr_next_redirect = ptr_redirect->next_redirect;
-
-                if ((ptr_redirect->start_time > 0)
-                    && (ptr_redirect->start_time + ptr_redirect->timeout < current_time))
-                {
-                    irc_redirect_stop (ptr_redirect, "timeout");
-                }
+        /* remove redirects if timeout occurs */
+        ptr_redirect = ptr_server->redirects;
+        while (ptr_redirect)
+        {
+            ptr_next_redirect = ptr_redirect->next_redirect;
 
-                ptr_redirect = ptr_next_redirect;
+            if ((ptr_redirect->start_time > 0)
+                && (ptr_redirect->start_time + ptr_redirect->timeout < current_time))
+            {
+                irc_redirect_stop (ptr_redirect, "timeout");
             }
 
-            /* purge some data (every 10 minutes) */
-            if (current_time > ptr_server->last_data_purge + (60 * 10))
+            ptr_redirect = ptr_next_redirect;
+        }
+
+        /* purge some data (every 10 minutes) */
+        if (current_time > ptr_server->last_data_purge + (60 * 10))
+        {
+            weechat_hashtable_map (ptr_server->join_manual,
+                                   &irc_server_check_join_manual_cb,
+                                   NULL);
+            weechat_hashtable_map (ptr_server->join_noswitch,
+                                   &irc_server_check_join_noswitch_cb,
+                                   NULL);
+            for (ptr_channel = ptr_server->channels; ptr_channel;
+                 ptr_channel = ptr_channel->next_channel)
             {
-                weechat_hashtable_map (ptr_server->join_manual,
-                                       &irc_server_check_join_manual_cb,
-                                       NULL);
-                weechat_hashtable_map (ptr_server->join_noswitch,
-                                       &irc_server_check_join_noswitch_cb,
-                                       NULL);
-                for (ptr_channel = ptr_server->channels; ptr_channel;
-                     ptr_channel = ptr_channel->next_channel)
+                if (ptr_channel->join_smart_filtered)
                 {
-                    if (ptr_channel->join_smart_filtered)
-                    {
-                        weechat_hashtable_map (ptr_channel->join_smart_filtered,
-                                               &irc_server_check_join_smart_filtered_cb,
-                                               NULL);
-                    }
+                    weechat_hashtable_map (ptr_channel->join_smart_filtered,
+                                           &irc_server_check_join_smart_filtered_cb,
+                                           NULL);
                 }
-                ptr_server->last_data_purge = current_time;
             }
+            ptr_server->last_data_purge = current_time;
         }
     }
 
@@ -3675,6 +4140,15 @@ irc_server_close_connection (struct t_irc_server *server)
         server->hook_timer_sasl = NULL;
     }
 
+    if (server->hook_timer_anti_flood)
+    {
+        weechat_unhook (server->hook_timer_anti_flood);
+        server->hook_timer_anti_flood = NULL;
+    }
+
+    /* stop receiving thread (messages not yet processed are lost) */
+    irc_recv_thread_stop (server, 0);
+
     if (server->hook_fd)
     {
         weechat_unhook (server->hook_fd);
@@ -3716,10 +4190,18 @@ irc_server_close_connection (struct t_irc_server *server)
     {
         irc_server_outqueue_free_all (server, i);
     }
+    if (server->outqueue_unsent)
+    {
+        free (server->outqueue_unsent);
+        server->outqueue_unsent = NULL;
+    }
 
     /* remove all redirects */
     irc_redirect_free_all (server);
 
+    /* remove all batches (messages received in batches are lost) */
+    irc_batch_free_all (server);
+
     /* remove all manual joins */
     weechat_hashtable_remove_all (server->join_manual);
 
@@ -3741,23 +4223,39 @@ irc_server_close_connection (struct t_irc_server *server)
 void
 irc_server_reconnect_schedule (struct t_irc_server *server)
 {
-    int minutes, seconds;
+    int minutes, seconds, delay, delay_max, jitter;
 
     if (IRC_SERVER_OPTION_BOOLEAN(server, IRC_SERVER_OPTION_AUTORECONNECT))
     {
-        /* growing reconnect delay */
+        delay_max = weechat_config_integer (irc_config_network_autoreconnect_delay_max);
+
+        /* growing reconnect delay (without the random delay) */
         if (server->reconnect_delay == 0)
             server->reconnect_delay = IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_AUTORECONNECT_DELAY);
         else
             server->reconnect_delay = server->reconnect_delay * weechat_config_integer (irc_config_network_autoreconnect_delay_growing);
-        if ((weechat_config_integer (irc_config_network_autoreconnect_delay_max) > 0)
-            && (server->reconnect_delay > weechat_config_integer (irc_config_network_autoreconnect_delay_max)))
-            server->reconnect_delay = weechat_config_integer (irc_config_network_autoreconnect_delay_max);
+        if ((delay_max > 0) && (server->reconnect_delay > delay_max))
+            server->reconnect_delay = delay_max;
+
+        /*
+         * add a random delay, so that servers disconnected at the same time
+         * do not all reconnect at the same time; the max delay is applied
+         * after the random delay, which is not used for the next growing
+         * delay
+         */
+        delay = server->reconnect_delay;
+        jitter = (delay *
+                  weechat_config_integer (irc_config_network_autoreconnect_delay_jitter)) / 100;
+        if (jitter > 0)
+            delay += rand () % (jitter + 1);
+        if ((delay_max > 0) && (delay > delay_max))
+            delay = delay_max;
+        server->reconnect_jitter = delay - server->reconnect_delay;
 
         server->reconnect_start = time (NULL);
 
-        minutes = server->reconnect_delay / 60;
-        seconds = server->reconnect_delay % 60;
+        minutes = delay / 60;
+        seconds = delay % 60;
         if ((minutes > 0) && (seconds > 0))
         {
             weechat_printf (
@@ -3794,6 +4292,7 @@ irc_server_reconnect_schedule (struct t_irc_server *server)
     else
     {
         server->reconnect_delay = 0;
+        server->reconnect_jitter = 0;
         server->reconnect_start = 0;
     }
 }
@@ -3911,6 +4410,23 @@ irc_server_switch_address (struct t_irc_server *server, int connection)
     }
 }
 
+/*
+ * Returns the number of milliseconds elapsed since a time (-1 if the time is
+ * not set).
+ */
+
+int
+irc_server_elapsed_ms (struct timeval *start)
+{
+    struct timeval tv_now;
+
+    if (!start || (start->tv_sec == 0))
+        return -1;
+
+    gettimeofday (&tv_now, NULL);
+    return (int)(weechat_util_timeval_diff (start, &tv_now) / 1000);
+}
+
 /*
  * Reads connection status.
  */
@@ -3937,6 +4453,8 @@ irc_server_connect_cb (const void *pointer, void *data,
     switch (status)
     {
         case WEECHAT_HOOK_CONNECT_OK:
+            server->connect_duration = irc_server_elapsed_ms (
+                &server->connect_start);
             /* set IP */
             if (server->current_ip)
                 free (server->current_ip);
@@ -3949,13 +4467,7 @@ irc_server_connect_cb (const void *pointer, void *data,
                 server->current_address,
                 server->current_port,
                 (server->current_ip) ? server->current_ip : "?");
-            if (!server->fake_server)
-            {
-                server->hook_fd = weechat_hook_fd (server->sock,
-                                                   1, 0, 0,
-                                                   &irc_server_recv_cb,
-                                                   server, NULL);
-            }
+            irc_server_hook_recv (server);
             /* login to server */
             irc_server_login (server);
             break;
@@ -4888,6 +5400,10 @@ irc_server_connect (struct t_irc_server *server)
     const char *proxy, *str_proxy_type, *str_proxy_address;
 
     server->disconnected = 0;
+    server->connect_pending = 0;
+    gettimeofday (&server->connect_start, NULL);
+    server->connect_duration = -1;
+    server->login_duration = -1;
 
     if (!server->buffer)
     {
@@ -5106,6 +5622,126 @@ irc_server_reconnect (struct t_irc_server *server)
         irc_server_reconnect_schedule (server);
 }
 
+/*
+ * Checks if a connection to server is in progress (connecting to server or
+ * waiting for message 001).
+ *
+ * Returns:
+ *   1: connection in progress
+ *   0: no connection in progress
+ */
+
+int
+irc_server_connection_in_progress (struct t_irc_server *server)
+{
+    return (server->hook_connect || server->hook_timer_connection) ? 1 : 0;
+}
+
+/*
+ * Returns the number of connections in progress on all servers.
+ */
+
+int
+irc_server_count_connections_in_progress ()
+{
+    struct t_irc_server *ptr_server;
+    int count;
+
+    count = 0;
+    for (ptr_server = irc_servers; ptr_server;
+         ptr_server = ptr_server->next_server)
+    {
+        if (irc_server_connection_in_progress (ptr_server))
+            count++;
+    }
+
+    return count;
+}
+
+/*
+ * Checks if a server is waiting for an automatic connection: auto-connection
+ * at startup or reconnection (when the reconnection delay is over).
+ *
+ * Returns:
+ *   1: server is waiting for connection
+ *   0: server is not waiting for connection
+ */
+
+int
+irc_server_connect_is_pending (struct t_irc_server *server,
+                               time_t current_time)
+{
+    if (server->is_connected || irc_server_connection_in_progress (server))
+        return 0;
+
+    if (server->connect_pending)
+        return 1;
+
+    return ((server->reconnect_start > 0)
+            && (current_time >= server->reconnect_start
+                + server->reconnect_delay + server->reconnect_jitter)) ?
+        1 : 0;
+}
+
+/*
+ * Starts pending connections and reconnections to servers, by order of
+ * priority (server option "connection_priority"), without exceeding the max
+ * number of connections in progress (option irc.network.connections_max).
+ *
+ * Connections started by the user (command /connect) are not limited.
+ */
+
+void
+irc_server_connect_pending (time_t current_time)
+{
+    struct t_irc_server *ptr_server, *ptr_next_server;
+    int connections_max, count, priority, next_priority;
+
+    connections_max = weechat_config_integer (irc_config_network_connections_max);
+    count = irc_server_count_connections_in_progress ();
+
+    while ((connections_max == 0) || (count < connections_max))
+    {
+        /* search pending server with highest priority */
+        ptr_next_server = NULL;
+        next_priority = 0;
+        for (ptr_server = irc_servers; ptr_server;
+             ptr_server = ptr_server->next_server)
+        {
+            if (!irc_server_connect_is_pending (ptr_server, current_time))
+                continue;
+            priority = IRC_SERVER_OPTION_INTEGER(
+                ptr_server, IRC_SERVER_OPTION_CONNECTION_PRIORITY);
+            if (!ptr_next_server || (priority > next_priority))
+            {
+                ptr_next_server = ptr_server;
+                next_priority = priority;
+            }
+        }
+        if (!ptr_next_server)
+            break;
+
+        if (ptr_next_server->connect_pending)
+        {
+            /* auto-connection (startup) */
+            if (!irc_server_connect (ptr_next_server))
+                irc_server_reconnect_schedule (ptr_next_server);
+        }
+        else
+        {
+            irc_server_reconnect (ptr_next_server);
+        }
+
+        /*
+         * if the connection could not be started, the server is no longer
+         * pending (reconnection scheduled later) and does not use a slot
+         */
+        if (irc_server_connection_in_progress (ptr_next_server))
+            count++;
+        ptr_next_server->connect_pending = 0;
+    }
+}
+
 /*
  * Callback for auto-connect to servers (called at startup).
  */
@@ -5129,11 +5765,12 @@ irc_server_auto_connect_timer_cb (const void *pointer, void *data,
         if ((auto_connect || ptr_server->temp_server)
             && (IRC_SERVER_OPTION_BOOLEAN(ptr_server, IRC_SERVER_OPTION_AUTOCONNECT)))
         {
-            if (!irc_server_connect (ptr_server))
-                irc_server_reconnect_schedule (ptr_server);
+            ptr_server->connect_pending = 1;
         }
     }
 
+    irc_server_connect_pending (time (NULL));
+
     return WEECHAT_RC_OK;
 }
 
@@ -5236,6 +5873,7 @@ irc_server_disconnect (struct t_irc_server *server, int switch_address,
     server->monitor = 0;
     server->monitor_time = 0;
 
+    server->connect_pending = 0;
     if (reconnect
         && IRC_SERVER_OPTION_BOOLEAN(server, IRC_SERVER_OPTION_AUTORECONNECT))
         irc_server_reconnect_schedule (server);
@@ -5841,8 +6479,10 @@ irc_server_hdata_server_cb (const void *pointer, void *data,
         WEECHAT_HDATA_VAR(struct t_irc_server, sock, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, hook_connect, POINTER, 0, NULL, "hook");
         WEECHAT_HDATA_VAR(struct t_irc_server, hook_fd, POINTER, 0, NULL, "hook");
+        WEECHAT_HDATA_VAR(struct t_irc_server, recv_thread, POINTER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, hook_timer_connection, POINTER, 0, NULL, "hook");
         WEECHAT_HDATA_VAR(struct t_irc_server, hook_timer_sasl, POINTER, 0, NULL, "hook");
+        WEECHAT_HDATA_VAR(struct t_irc_server, hook_timer_anti_flood, POINTER, 0, NULL, "hook");
         WEECHAT_HDATA_VAR(struct t_irc_server, is_connected, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, ssl_connected, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, disconnected, INTEGER, 0, NULL, NULL);
@@ -5874,7 +6514,12 @@ irc_server_hdata_server_cb (const void *pointer, void *data,
         WEECHAT_HDATA_VAR(struct t_irc_server, monitor, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, monitor_time, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, reconnect_delay, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, reconnect_jitter, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, reconnect_start, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, connect_pending, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, connect_start, OTHER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, connect_duration, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, login_duration, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, command_time, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, reconnect_join, INTEGER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, disable_autojoin, INTEGER, 0, NULL, NULL);
@@ -5888,12 +6533,20 @@ irc_server_hdata_server_cb (const void *pointer, void *data,
         WEECHAT_HDATA_VAR(struct t_irc_server, lag_last_refresh, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, cmd_list_regexp, POINTER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, last_user_message, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, anti_flood_msg_time, OTHER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, anti_flood_bytes_time, OTHER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, last_away_check, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, last_data_purge, TIME, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, outqueue, POINTER, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, last_outqueue, POINTER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, outqueue_unsent, STRING, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, redirects, POINTER, 0, NULL, "irc_redirect");
         WEECHAT_HDATA_VAR(struct t_irc_server, last_redirect, POINTER, 0, NULL, "irc_redirect");
+        WEECHAT_HDATA_VAR(struct t_irc_server, redirects_commands, HASHTABLE, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, redirects_in_progress, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_irc_server, batches, POINTER, 0, NULL, "irc_batch");
+        WEECHAT_HDATA_VAR(struct t_irc_server, last_batch, POINTER, 0, NULL, "irc_batch");
+        WEECHAT_HDATA_VAR(struct t_irc_server, stats, POINTER, 0, NULL, "irc_stats");
         WEECHAT_HDATA_VAR(struct t_irc_server, notify_list, POINTER, 0, NULL, "irc_notify");
         WEECHAT_HDATA_VAR(struct t_irc_server, last_notify, POINTER, 0, NULL, "irc_notify");
         WEECHAT_HDATA_VAR(struct t_irc_server, notify_count, INTEGER, 0, NULL, NULL);
@@ -5904,6 +6557,7 @@ irc_server_hdata_server_cb (const void *pointer, void *data,
         WEECHAT_HDATA_VAR(struct t_irc_server, buffer_as_string, STRING, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, channels, POINTER, 0, NULL, "irc_channel");
         WEECHAT_HDATA_VAR(struct t_irc_server, last_channel, POINTER, 0, NULL, "irc_channel");
+        WEECHAT_HDATA_VAR(struct t_irc_server, channels_hashtable, HASHTABLE, 0, NULL, NULL);
         WEECHAT_HDATA_VAR(struct t_irc_server, prev_server, POINTER, 0, NULL, hdata_name);
         WEECHAT_HDATA_VAR(struct t_irc_server, next_server, POINTER, 0, NULL, hdata_name);
         WEECHAT_HDATA_LIST(irc_servers, WEECHAT_HDATA_LIST_CHECK_POINTERS);
@@ -5981,6 +6635,9 @@ irc_server_add_to_infolist (struct t_infolist *infolist,
     if (!weechat_infolist_new_var_string (ptr_item, "capabilities",
                                           IRC_SERVER_OPTION_STRING(server, IRC_SERVER_OPTION_CAPABILITIES)))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "chathistory_limit",
+                                           IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_CHATHISTORY_LIMIT)))
+        return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "sasl_mechanism",
                                           IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_SASL_MECHANISM)))
         return 0;
@@ -6041,12 +6698,21 @@ irc_server_add_to_infolist (struct t_infolist *infolist,
     if (!weechat_infolist_new_var_integer (ptr_item, "connection_timeout",
                                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_CONNECTION_TIMEOUT)))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "connection_priority",
+                                           IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_CONNECTION_PRIORITY)))
+        return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "anti_flood_prio_high",
                                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH)))
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "anti_flood_prio_low",
                                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW)))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "anti_flood_burst",
+                                           IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_BURST)))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "anti_flood_bytes",
+                                           IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_ANTI_FLOOD_BYTES)))
+        return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "away_check",
                                            IRC_SERVER_OPTION_INTEGER(server, IRC_SERVER_OPTION_AWAY_CHECK)))
         return 0;
@@ -6130,8 +6796,16 @@ irc_server_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "reconnect_delay", server->reconnect_delay))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "reconnect_jitter", server->reconnect_jitter))
+        return 0;
     if (!weechat_infolist_new_var_time (ptr_item, "reconnect_start", server->reconnect_start))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "connect_pending", server->connect_pending))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "connect_duration", server->connect_duration))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "login_duration", server->login_duration))
+        return 0;
     if (!weechat_infolist_new_var_time (ptr_item, "command_time", server->command_time))
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "reconnect_join", server->reconnect_join))
@@ -6266,6 +6940,13 @@ irc_server_print_log ()
         else
             weechat_log_printf ("  capabilities . . . . : '%s'",
                                 weechat_config_string (ptr_server->options[IRC_SERVER_OPTION_CAPABILITIES]));
+        /* chathistory_limit */
+        if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_CHATHISTORY_LIMIT]))
+            weechat_log_printf ("  chathistory_limit. . : null (%d)",
+                                IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_CHATHISTORY_LIMIT));
+        else
+            weechat_log_printf ("  chathistory_limit. . : %d",
+                                weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_CHATHISTORY_LIMIT]));
         /* sasl_mechanism */
         if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_SASL_MECHANISM]))
             weechat_log_printf ("  sasl_mechanism . . . : null ('%s')",
@@ -6410,6 +7091,13 @@ irc_server_print_log ()
         else
             weechat_log_printf ("  connection_timeout . : %d",
                                 weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_CONNECTION_TIMEOUT]));
+        /* connection_priority */
+        if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_CONNECTION_PRIORITY]))
+            weechat_log_printf ("  connection_priority. : null (%d)",
+                                IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_CONNECTION_PRIORITY));
+        else
+            weechat_log_printf ("  connection_priority. : %d",
+                                weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_CONNECTION_PRIORITY]));
         /* anti_flood_prio_high */
         if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH]))
             weechat_log_printf ("  anti_flood_prio_high : null (%d)",
@@ -6424,6 +7112,20 @@ irc_server_print_log ()
         else
             weechat_log_printf ("  anti_flood_prio_low. : %d",
                                 weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW]));
+        /* anti_flood_burst */
+        if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BURST]))
+            weechat_log_printf ("  anti_flood_burst . . : null (%d)",
+                                IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_ANTI_FLOOD_BURST));
+        else
+            weechat_log_printf ("  anti_flood_burst . . : %d",
+                                weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BURST]));
+        /* anti_flood_bytes */
+        if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BYTES]))
+            weechat_log_printf ("  anti_flood_bytes . . : null (%d)",
+                                IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_ANTI_FLOOD_BYTES));
+        else
+            weechat_log_printf ("  anti_flood_bytes . . : %d",
+                                weechat_config_integer (ptr_server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BYTES]));
         /* away_check */
         if (weechat_config_option_is_null (ptr_server->options[IRC_SERVER_OPTION_AWAY_CHECK]))
             weechat_log_printf ("  away_check . . . . . : null (%d)",
@@ -6477,8 +7179,10 @@ irc_server_print_log ()
         weechat_log_printf ("  sock . . . . . . . . : %d",    ptr_server->sock);
         weechat_log_printf ("  hook_connect . . . . : 0x%lx", ptr_server->hook_connect);
         weechat_log_printf ("  hook_fd. . . . . . . : 0x%lx", ptr_server->hook_fd);
+        weechat_log_printf ("  recv_thread. . . . . : 0x%lx", ptr_server->recv_thread);
         weechat_log_printf ("  hook_timer_connection: 0x%lx", ptr_server->hook_timer_connection);
         weechat_log_printf ("  hook_timer_sasl. . . : 0x%lx", ptr_server->hook_timer_sasl);
+        weechat_log_printf ("  hook_timer_anti_flood: 0x%lx", ptr_server->hook_timer_anti_flood);
         weechat_log_printf ("  is_connected . . . . : %d",    ptr_server->is_connected);
         weechat_log_printf ("  ssl_connected. . . . : %d",    ptr_server->ssl_connected);
         weechat_log_printf ("  disconnected . . . . : %d",    ptr_server->disconnected);
@@ -6516,7 +7220,14 @@ irc_server_print_log ()
         weechat_log_printf ("  monitor. . . . . . . : %d",    ptr_server->monitor);
         weechat_log_printf ("  monitor_time . . . . : %lld",  (long long)ptr_server->monitor_time);
         weechat_log_printf ("  reconnect_delay. . . : %d",    ptr_server->reconnect_delay);
+        weechat_log_printf ("  reconnect_jitter . . : %d",    ptr_server->reconnect_jitter);
         weechat_log_printf ("  reconnect_start. . . : %lld",  (long long)ptr_server->reconnect_start);
+        weechat_log_printf ("  connect_pending. . . : %d",    ptr_server->connect_pending);
+        weechat_log_printf ("  connect_start. . . . : %lld.%06ld",
+                            (long long)(ptr_server->connect_start.tv_sec),
+                            (long)(ptr_server->connect_start.tv_usec));
+        weechat_log_printf ("  connect_duration . . : %d",    ptr_server->connect_duration);
+        weechat_log_printf ("  login_duration . . . : %d",    ptr_server->login_duration);
         weechat_log_printf ("  command_time . . . . : %lld",  (long long)ptr_server->command_time);
         weechat_log_printf ("  reconnect_join . . . : %d",    ptr_server->reconnect_join);
         weechat_log_printf ("  disable_autojoin . . : %d",    ptr_server->disable_autojoin);
@@ -6539,8 +7250,17 @@ irc_server_print_log ()
             weechat_log_printf ("  outqueue[%02d] . . . . : 0x%lx", i, ptr_server->outqueue[i]);
             weechat_log_printf ("  last_outqueue[%02d]. . : 0x%lx", i, ptr_server->last_outqueue[i]);
         }
+        weechat_log_printf ("  outqueue_unsent. . . : '%s'",  ptr_server->outqueue_unsent);
         weechat_log_printf ("  redirects. . . . . . : 0x%lx", ptr_server->redirects);
         weechat_log_printf ("  last_redirect. . . . : 0x%lx", ptr_server->last_redirect);
+        weechat_log_printf ("  redirects_commands . : 0x%lx (hashtable: '%s')",
+                            ptr_server->redirects_commands,
+                            weechat_hashtable_get_string (ptr_server->redirects_commands,
+                                                          "keys_values"));
+        weechat_log_printf ("  redirects_in_progress: %d",    ptr_server->redirects_in_progress);
+        weechat_log_printf ("  batches. . . . . . . : 0x%lx", ptr_server->batches);
+        weechat_log_printf ("  last_batch . . . . . : 0x%lx", ptr_server->last_batch);
+        weechat_log_printf ("  stats. . . . . . . . : 0x%lx", ptr_server->stats);
         weechat_log_printf ("  notify_list. . . . . : 0x%lx", ptr_server->notify_list);
         weechat_log_printf ("  last_notify. . . . . : 0x%lx", ptr_server->last_notify);
         weechat_log_printf ("  notify_count . . . . : %d",    ptr_server->notify_count);
@@ -6557,11 +7277,20 @@ irc_server_print_log ()
         weechat_log_printf ("  buffer_as_string . . : 0x%lx", ptr_server->buffer_as_string);
         weechat_log_printf ("  channels . . . . . . : 0x%lx", ptr_server->channels);
         weechat_log_printf ("  last_channel . . . . : 0x%lx", ptr_server->last_channel);
+        weechat_log_printf ("  channels_hashtable . : 0x%lx (%d items)",
+                            ptr_server->channels_hashtable,
+                            weechat_hashtable_get_integer (ptr_server->channels_hashtable, "items_count"));
         weechat_log_printf ("  prev_server. . . . . : 0x%lx", ptr_server->prev_server);
         weechat_log_printf ("  next_server. . . . . : 0x%lx", ptr_server->next_server);
 
         irc_redirect_print_log (ptr_server);
 
+        irc_batch_print_log (ptr_server);
+
+        irc_stats_print_log (ptr_server->stats);
+
+        irc_recv_thread_print_log (ptr_server->recv_thread);
+
         irc_notify_print_log (ptr_server);
 
         for (ptr_channel = ptr_server->channels; ptr_channel;
@@ -61,6 +61,7 @@ enum t_irc_server_option
     IRC_SERVER_OPTION_SSL_VERIFY,    /* check if the connection is trusted   */
     IRC_SERVER_OPTION_PASSWORD,      /* password for server                  */
     IRC_SERVER_OPTION_CAPABILITIES,  /* client capabilities to enable        */
+    IRC_SERVER_OPTION_CHATHISTORY_LIMIT, /* messages fetched (chathistory)   */
     IRC_SERVER_OPTION_SASL_MECHANISM,/* mechanism for SASL authentication    */
     IRC_SERVER_OPTION_SASL_USERNAME, /* username for SASL authentication     */
     IRC_SERVER_OPTION_SASL_PASSWORD, /* password for SASL authentication     */
@@ -82,8 +83,11 @@ enum t_irc_server_option
     IRC_SERVER_OPTION_AUTOREJOIN,    /* auto rejoin channels when kicked     */
     IRC_SERVER_OPTION_AUTOREJOIN_DELAY,     /* delay before auto rejoin      */
     IRC_SERVER_OPTION_CONNECTION_TIMEOUT,   /* timeout for connection        */
+    IRC_SERVER_OPTION_CONNECTION_PRIORITY,  /* priority for auto connection  */
     IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_HIGH, /* anti-flood (high priority)    */
     IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW,  /* anti-flood (low priority)     */
+    IRC_SERVER_OPTION_ANTI_FLOOD_BURST,     /* anti-flood: max burst of msgs */
+    IRC_SERVER_OPTION_ANTI_FLOOD_BYTES,     /* anti-flood: max bytes/second  */
     IRC_SERVER_OPTION_AWAY_CHECK,           /* delay between away checks     */
     IRC_SERVER_OPTION_AWAY_CHECK_MAX_NICKS, /* max nicks for away check      */
     IRC_SERVER_OPTION_MSG_KICK,             /* default kick message          */
@@ -125,6 +129,12 @@ enum t_irc_server_option
 /* number of queues for sending messages */
 #define IRC_SERVER_NUM_OUTQUEUES_PRIO 2
 
+/* max size of messages sent at once when the outqueue is flushed */
+#define IRC_SERVER_OUTQUEUE_BATCH_MAX_SIZE 16384
+
+/* delay (in milliseconds) before sending again data not sent (socket full) */
+#define IRC_SERVER_OUTQUEUE_UNSENT_DELAY 50
+
 /* flags for irc_server_sendf() */
 #define IRC_SERVER_SEND_OUTQ_PRIO_HIGH   (1 << 0)
 #define IRC_SERVER_SEND_OUTQ_PRIO_LOW    (1 << 1)
@@ -162,6 +172,7 @@ struct t_irc_outqueue
     int modified;                         /* msg was modified by modifier(s) */
     char *tags;                           /* tags (used by Relay plugin)     */
     struct t_irc_redirect *redirect;      /* command redirection             */
+    struct timeval time_added;            /* time of add in queue            */
     struct t_irc_outqueue *next_outqueue; /* link to next msg in queue       */
     struct t_irc_outqueue *prev_outqueue; /* link to prev msg in queue       */
 };
@@ -190,9 +201,13 @@ struct t_irc_server
                                     /* connected server fails in any way)    */
     int sock;                       /* socket for server                     */
     struct t_hook *hook_connect;    /* connection hook                       */
-    struct t_hook *hook_fd;         /* hook for server socket                */
+    struct t_hook *hook_fd;         /* hook for server socket (or pipe of    */
+                                    /* receiving thread)                     */
+    struct t_irc_recv_thread *recv_thread; /* thread receiving data (if     */
+                                    /* option irc.network.recv_thread is on) */
     struct t_hook *hook_timer_connection; /* timer for connection            */
     struct t_hook *hook_timer_sasl; /* timer for SASL authentication         */
+    struct t_hook *hook_timer_anti_flood; /* timer to flush outqueue         */
     int is_connected;               /* 1 if WeeChat is connected to server   */
     int ssl_connected;              /* = 1 if connected with SSL             */
     int disconnected;               /* 1 if server has been disconnected     */
@@ -227,7 +242,16 @@ struct t_irc_server
     int monitor;                    /* monitor limit from msg 005 (eg 100)   */
     time_t monitor_time;            /* time for monitoring nicks (on connect)*/
     int reconnect_delay;            /* current reconnect delay (growing)     */
-    time_t reconnect_start;         /* this time + delay = reconnect time    */
+    int reconnect_jitter;           /* random delay added to reconnect delay */
+    time_t reconnect_start;         /* this time + delay + jitter =          */
+                                    /* reconnect time                        */
+    int connect_pending;            /* 1 if auto-connection is waiting for a */
+                                    /* free slot (irc.network.connections_max)*/
+    struct timeval connect_start;   /* time of start of last connection      */
+    int connect_duration;           /* TCP/TLS connection duration (in ms),  */
+                                    /* -1 if unknown                         */
+    int login_duration;             /* duration from connection to message   */
+                                    /* 001 (in ms), -1 if unknown            */
     time_t command_time;            /* this time + command_delay = time to   */
                                     /* autojoin channels                     */
     int reconnect_join;             /* 1 if channels opened to rejoin        */
@@ -242,13 +266,26 @@ struct t_irc_server
     time_t lag_last_refresh;        /* last refresh of lag item              */
     regex_t *cmd_list_regexp;       /* compiled Regular Expression for /list */
     time_t last_user_message;       /* time of last user message (anti flood)*/
+    struct timeval anti_flood_msg_time;   /* anti-flood: theoretical time of */
+                                          /* next msg (token bucket)         */
+    struct timeval anti_flood_bytes_time; /* anti-flood: theoretical time of */
+                                          /* next byte (token bucket)        */
     time_t last_away_check;         /* time of last away check on server     */
     time_t last_data_purge;         /* time of last purge (some hashtables)  */
     struct t_irc_outqueue *outqueue[2];      /* queue for outgoing messages  */
                                              /* with 2 priorities (high/low) */
     struct t_irc_outqueue *last_outqueue[2]; /* last outgoing message        */
+    char *outqueue_unsent;                   /* data not sent yet (socket    */
+                                             /* full), sent before any msg   */
     struct t_irc_redirect *redirects;        /* command redirections         */
     struct t_irc_redirect *last_redirect;    /* last command redirection     */
+    struct t_hashtable *redirects_commands;  /* start/stop commands of      */
+                                             /* redirects (with count)      */
+    int redirects_in_progress;               /* redirects with start/stop   */
+                                             /* command received            */
+    struct t_irc_batch *batches;             /* batches in progress          */
+    struct t_irc_batch *last_batch;          /* last batch                   */
+    struct t_irc_stats *stats;               /* traffic/processing stats     */
     struct t_irc_notify *notify_list;        /* list of notify               */
     struct t_irc_notify *last_notify;        /* last notify                  */
     int notify_count;                        /* number of notify in list     */
@@ -259,6 +296,7 @@ struct t_irc_server
     char *buffer_as_string;               /* used to return buffer info      */
     struct t_irc_channel *channels;       /* opened channels on server       */
     struct t_irc_channel *last_channel;   /* last opened channel on server   */
+    struct t_hashtable *channels_hashtable; /* channels by name (lower case) */
     struct t_irc_server *prev_server;     /* link to previous server         */
     struct t_irc_server *next_server;     /* link to next server             */
 };
@@ -304,6 +342,8 @@ extern int irc_server_strcasecmp (struct t_irc_server *server,
 extern int irc_server_strncasecmp (struct t_irc_server *server,
                                    const char *string1, const char *string2,
                                    int max);
+extern char *irc_server_string_tolower (struct t_irc_server *server,
+                                        const char *string);
 extern char *irc_server_eval_expression (struct t_irc_server *server,
                                          const char *string);
 extern int irc_server_sasl_enabled (struct t_irc_server *server);
@@ -353,11 +393,21 @@ extern void irc_server_send_signal (struct t_irc_server *server,
                                     const char *signal, const char *command,
                                     const char *full_message,
                                     const char *tags);
+extern long long irc_server_anti_flood_wait (struct t_irc_server *server,
+                                             int priority, int size);
+extern void irc_server_anti_flood_consume (struct t_irc_server *server,
+                                           int priority, int size);
+extern void irc_server_outqueue_schedule (struct t_irc_server *server);
+extern void irc_server_outqueue_send (struct t_irc_server *server);
 extern void irc_server_set_send_default_tags (const char *tags);
 extern struct t_hashtable *irc_server_sendf (struct t_irc_server *server,
                                              int flags,
                                              const char *tags,
                                              const char *format, ...);
+extern void irc_server_msgq_add_msg (struct t_irc_server *server,
+                                     const char *msg);
+extern void irc_server_msgq_add_unterminated (struct t_irc_server *server,
+                                              const char *string);
 extern void irc_server_msgq_add_buffer (struct t_irc_server *server,
                                         const char *buffer);
 extern void irc_server_msgq_flush ();
@@ -367,8 +417,15 @@ int irc_server_fingerprint_search_algo_with_size (int size);
 char *irc_server_fingerprint_str_sizes ();
 extern int irc_server_connect (struct t_irc_server *server);
 extern void irc_server_auto_connect (int auto_connect);
+extern int irc_server_elapsed_ms (struct timeval *start);
+extern int irc_server_connection_in_progress (struct t_irc_server *server);
+extern int irc_server_count_connections_in_progress ();
+extern void irc_server_connect_pending (time_t current_time);
 extern void irc_server_autojoin_channels (struct t_irc_server *server);
+extern void irc_server_recv_error (struct t_irc_server *server, int closed,
+                                   int error);
 extern int irc_server_recv_cb (const void *pointer, void *data, int fd);
+extern void irc_server_hook_recv (struct t_irc_server *server);
 extern int irc_server_timer_sasl_cb (const void *pointer, void *data,
                                      int remaining_calls);
 extern int irc_server_timer_cb (const void *pointer, void *data,
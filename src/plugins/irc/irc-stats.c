@@ -0,0 +1,500 @@
+/*
+ * irc-stats.c - traffic and processing statistics for IRC servers
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "../weechat-plugin.h"
+#include "irc.h"
+#include "irc-stats.h"
+#include "irc-server.h"
+
+
+char *irc_stats_counter_name[IRC_STATS_NUM_COUNTERS] =
+{ "bytes_recv", "bytes_sent", "msgs_recv", "msgs_sent", "recv_time",
+  "outqueue_msgs", "outqueue_wait", "lag_samples", "lag", "redirect_msgs",
+  "redirect_time", "redirects" };
+
+/* windows returned in hashtable and displayed by /server stats */
+int irc_stats_windows[IRC_STATS_NUM_WINDOWS] = { 1, 5, 15 };
+
+
+/*
+ * Frees stats of a command (callback called by hashtable).
+ */
+
+void
+irc_stats_command_free_cb (struct t_hashtable *hashtable,
+                           const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    free (value);
+}
+
+/*
+ * Creates new statistics.
+ *
+ * Returns pointer to new statistics, NULL if error.
+ */
+
+struct t_irc_stats *
+irc_stats_new ()
+{
+    struct t_irc_stats *new_stats;
+
+    new_stats = malloc (sizeof (*new_stats));
+    if (!new_stats)
+        return NULL;
+
+    new_stats->commands = weechat_hashtable_new (
+        64,
+        WEECHAT_HASHTABLE_STRING,
+        WEECHAT_HASHTABLE_POINTER,
+        NULL, NULL);
+    if (!new_stats->commands)
+    {
+        free (new_stats);
+        return NULL;
+    }
+    weechat_hashtable_set_pointer (new_stats->commands,
+                                   "callback_free_value",
+                                   &irc_stats_command_free_cb);
+
+    irc_stats_reset (new_stats);
+
+    return new_stats;
+}
+
+/*
+ * Resets statistics (all counters are set to zero).
+ */
+
+void
+irc_stats_reset (struct t_irc_stats *stats)
+{
+    if (!stats)
+        return;
+
+    stats->start_time = time (NULL);
+    memset (stats->total, 0, sizeof (stats->total));
+    memset (stats->window, 0, sizeof (stats->window));
+    weechat_hashtable_remove_all (stats->commands);
+}
+
+/*
+ * Adds a value in a rolling window (the value is added in the slot of the
+ * current minute; a slot used by an older minute is reset first).
+ */
+
+void
+irc_stats_window_add (struct t_irc_stats_window *window,
+                      time_t current_time, long value)
+{
+    time_t minute;
+    int slot;
+
+    minute = current_time / 60;
+    slot = minute % IRC_STATS_WINDOW_MINUTES;
+    if (window->minute[slot] != minute)
+    {
+        window->minute[slot] = minute;
+        window->value[slot] = 0;
+    }
+    window->value[slot] += value;
+}
+
+/*
+ * Returns sum of values in a rolling window for the last N minutes
+ * (including current minute).
+ */
+
+long
+irc_stats_window_sum (struct t_irc_stats_window *window,
+                      time_t current_time, int minutes)
+{
+    time_t minute;
+    long sum;
+    int i;
+
+    if (minutes > IRC_STATS_WINDOW_MINUTES)
+        minutes = IRC_STATS_WINDOW_MINUTES;
+
+    minute = current_time / 60;
+    sum = 0;
+    for (i = 0; i < IRC_STATS_WINDOW_MINUTES; i++)
+    {
+        if ((window->minute[i] <= minute)
+            && (window->minute[i] > minute - minutes))
+        {
+            sum += window->value[i];
+        }
+    }
+
+    return sum;
+}
+
+/*
+ * Adds a value to a counter.
+ */
+
+void
+irc_stats_add (struct t_irc_stats *stats, enum t_irc_stats_counter counter,
+               long value)
+{
+    if (!stats || (counter < 0) || (counter >= IRC_STATS_NUM_COUNTERS))
+        return;
+
+    stats->total[counter] += value;
+    irc_stats_window_add (&stats->window[counter], time (NULL), value);
+}
+
+/*
+ * Adds data sent to server (number of bytes and number of messages, which is
+ * the number of "\n" in data).
+ */
+
+void
+irc_stats_add_sent (struct t_irc_stats *stats, const char *buffer, int size)
+{
+    const char *ptr_buffer, *pos;
+    long msgs;
+
+    if (!stats || !buffer || (size <= 0))
+        return;
+
+    msgs = 0;
+    ptr_buffer = buffer;
+    while ((pos = memchr (ptr_buffer, '\n', size - (ptr_buffer - buffer))))
+    {
+        msgs++;
+        ptr_buffer = pos + 1;
+    }
+
+    irc_stats_add (stats, IRC_STATS_BYTES_SENT, size);
+    if (msgs > 0)
+        irc_stats_add (stats, IRC_STATS_MSGS_SENT, msgs);
+}
+
+/*
+ * Adds a message received (counters for number of messages and processing
+ * time, globally and for the command).
+ *
+ * The command is sent by the server, so at most IRC_STATS_MAX_COMMANDS
+ * commands are counted, the messages with other commands are counted in
+ * IRC_STATS_COMMAND_OTHER.
+ *
+ * Argument tv_start is the time when processing of message started.
+ */
+
+void
+irc_stats_add_message (struct t_irc_stats *stats, const char *command,
+                       struct timeval *tv_start)
+{
+    struct t_irc_stats_command *ptr_cmd;
+    struct timeval tv_now;
+    long elapsed;
+
+    if (!stats)
+        return;
+
+    gettimeofday (&tv_now, NULL);
+    elapsed = (long)weechat_util_timeval_diff (tv_start, &tv_now);
+    if (elapsed < 0)
+        elapsed = 0;
+
+    stats->total[IRC_STATS_MSGS_RECV]++;
+    irc_stats_window_add (&stats->window[IRC_STATS_MSGS_RECV],
+                          tv_now.tv_sec, 1);
+    stats->total[IRC_STATS_RECV_TIME] += elapsed;
+    irc_stats_window_add (&stats->window[IRC_STATS_RECV_TIME],
+                          tv_now.tv_sec, elapsed);
+
+    if (!command || !command[0])
+        return;
+
+    ptr_cmd = weechat_hashtable_get (stats->commands, command);
+    if (!ptr_cmd
+        && (weechat_hashtable_get_integer (stats->commands,
+                                           "items_count") >= IRC_STATS_MAX_COMMANDS))
+    {
+        command = IRC_STATS_COMMAND_OTHER;
+        ptr_cmd = weechat_hashtable_get (stats->commands, command);
+    }
+    if (!ptr_cmd)
+    {
+        ptr_cmd = calloc (1, sizeof (*ptr_cmd));
+        if (!ptr_cmd)
+            return;
+        weechat_hashtable_set (stats->commands, command, ptr_cmd);
+    }
+    ptr_cmd->count++;
+    ptr_cmd->time += elapsed;
+    irc_stats_window_add (&ptr_cmd->window_count, tv_now.tv_sec, 1);
+    irc_stats_window_add (&ptr_cmd->window_time, tv_now.tv_sec, elapsed);
+}
+
+/*
+ * Returns value of a counter: total if minutes is 0, otherwise sum for the
+ * last N minutes.
+ */
+
+long
+irc_stats_get (struct t_irc_stats *stats, enum t_irc_stats_counter counter,
+               time_t current_time, int minutes)
+{
+    if (!stats || (counter < 0) || (counter >= IRC_STATS_NUM_COUNTERS))
+        return 0;
+
+    if (minutes <= 0)
+        return stats->total[counter];
+
+    return irc_stats_window_sum (&stats->window[counter], current_time,
+                                 minutes);
+}
+
+/*
+ * Returns number of messages in out queues of server.
+ */
+
+int
+irc_stats_outqueue_depth (struct t_irc_server *server)
+{
+    struct t_irc_outqueue *ptr_outqueue;
+    int i, count;
+
+    if (!server)
+        return 0;
+
+    count = 0;
+    for (i = 0; i < IRC_SERVER_NUM_OUTQUEUES_PRIO; i++)
+    {
+        for (ptr_outqueue = server->outqueue[i]; ptr_outqueue;
+             ptr_outqueue = ptr_outqueue->next_outqueue)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Adds stats of a command in hashtable (callback called for each command).
+ */
+
+void
+irc_stats_to_hashtable_command_cb (void *data,
+                                   struct t_hashtable *hashtable,
+                                   const void *key, const void *value)
+{
+    struct t_hashtable *hashtable_stats;
+    struct t_irc_stats_command *ptr_cmd;
+    time_t current_time;
+    char str_key[256], str_value[64];
+    int i;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    hashtable_stats = (struct t_hashtable *)data;
+    ptr_cmd = (struct t_irc_stats_command *)value;
+
+    current_time = time (NULL);
+
+    snprintf (str_key, sizeof (str_key),
+              "command_count_%s", (const char *)key);
+    snprintf (str_value, sizeof (str_value), "%ld", ptr_cmd->count);
+    weechat_hashtable_set (hashtable_stats, str_key, str_value);
+    snprintf (str_key, sizeof (str_key),
+              "command_time_%s", (const char *)key);
+    snprintf (str_value, sizeof (str_value), "%ld", ptr_cmd->time);
+    weechat_hashtable_set (hashtable_stats, str_key, str_value);
+
+    for (i = 0; i < IRC_STATS_NUM_WINDOWS; i++)
+    {
+        snprintf (str_key, sizeof (str_key),
+                  "command_count_%s_%dm",
+                  (const char *)key, irc_stats_windows[i]);
+        snprintf (str_value, sizeof (str_value),
+                  "%ld",
+                  irc_stats_window_sum (&ptr_cmd->window_count,
+                                        current_time,
+                                        irc_stats_windows[i]));
+        weechat_hashtable_set (hashtable_stats, str_key, str_value);
+        snprintf (str_key, sizeof (str_key),
+                  "command_time_%s_%dm",
+                  (const char *)key, irc_stats_windows[i]);
+        snprintf (str_value, sizeof (str_value),
+                  "%ld",
+                  irc_stats_window_sum (&ptr_cmd->window_time,
+                                        current_time,
+                                        irc_stats_windows[i]));
+        weechat_hashtable_set (hashtable_stats, str_key, str_value);
+    }
+}
+
+/*
+ * Builds a hashtable with statistics of a server.
+ *
+ * Keys are counter names for the total (since start of stats), with suffix
+ * "_1m", "_5m" and "_15m" for the rolling windows.
+ *
+ * Note: result must be freed after use.
+ */
+
+struct t_hashtable *
+irc_stats_to_hashtable (struct t_irc_server *server)
+{
+    struct t_hashtable *hashtable;
+    time_t current_time;
+    char str_key[128], str_value[64];
+    int i, j;
+
+    if (!server || !server->stats)
+        return NULL;
+
+    hashtable = weechat_hashtable_new (128,
+                                       WEECHAT_HASHTABLE_STRING,
+                                       WEECHAT_HASHTABLE_STRING,
+                                       NULL, NULL);
+    if (!hashtable)
+        return NULL;
+
+    current_time = time (NULL);
+
+    weechat_hashtable_set (hashtable, "server", server->name);
+    snprintf (str_value, sizeof (str_value),
+              "%lld", (long long)server->stats->start_time);
+    weechat_hashtable_set (hashtable, "start_time", str_value);
+
+    for (i = 0; i < IRC_STATS_NUM_COUNTERS; i++)
+    {
+        snprintf (str_value, sizeof (str_value),
+                  "%ld", server->stats->total[i]);
+        weechat_hashtable_set (hashtable, irc_stats_counter_name[i],
+                               str_value);
+        for (j = 0; j < IRC_STATS_NUM_WINDOWS; j++)
+        {
+            snprintf (str_key, sizeof (str_key),
+                      "%s_%dm", irc_stats_counter_name[i],
+                      irc_stats_windows[j]);
+            snprintf (str_value, sizeof (str_value),
+                      "%ld",
+                      irc_stats_window_sum (&server->stats->window[i],
+                                            current_time,
+                                            irc_stats_windows[j]));
+            weechat_hashtable_set (hashtable, str_key, str_value);
+        }
+    }
+
+    snprintf (str_value, sizeof (str_value),
+              "%d", irc_stats_outqueue_depth (server));
+    weechat_hashtable_set (hashtable, "outqueue_depth", str_value);
+    snprintf (str_value, sizeof (str_value), "%d", server->lag);
+    weechat_hashtable_set (hashtable, "lag_current", str_value);
+
+    weechat_hashtable_map (server->stats->commands,
+                           &irc_stats_to_hashtable_command_cb, hashtable);
+
+    return hashtable;
+}
+
+/*
+ * Frees statistics.
+ */
+
+void
+irc_stats_free (struct t_irc_stats *stats)
+{
+    if (!stats)
+        return;
+
+    if (stats->commands)
+        weechat_hashtable_free (stats->commands);
+
+    free (stats);
+}
+
+/*
+ * Returns hdata for statistics.
+ */
+
+struct t_hdata *
+irc_stats_hdata_stats_cb (const void *pointer, void *data,
+                          const char *hdata_name)
+{
+    struct t_hdata *hdata;
+    int i;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+
+    hdata = weechat_hdata_new (hdata_name, NULL, NULL, 0, 0, NULL, NULL);
+    if (hdata)
+    {
+        WEECHAT_HDATA_VAR(struct t_irc_stats, start_time, TIME, 0, NULL, NULL);
+        /* totals, one variable by counter */
+        for (i = 0; i < IRC_STATS_NUM_COUNTERS; i++)
+        {
+            weechat_hdata_new_var (hdata, irc_stats_counter_name[i],
+                                   offsetof (struct t_irc_stats, total) +
+                                   (i * sizeof (long)),
+                                   WEECHAT_HDATA_LONG, 0, NULL, NULL);
+        }
+        WEECHAT_HDATA_VAR(struct t_irc_stats, commands, HASHTABLE, 0, NULL, NULL);
+    }
+    return hdata;
+}
+
+/*
+ * Prints statistics in WeeChat log file (usually for crash dump).
+ */
+
+void
+irc_stats_print_log (struct t_irc_stats *stats)
+{
+    int i;
+
+    if (!stats)
+        return;
+
+    weechat_log_printf ("");
+    weechat_log_printf ("  => stats (addr:0x%lx):", stats);
+    weechat_log_printf ("       start_time . . . . . . . : %lld",
+                        (long long)stats->start_time);
+    for (i = 0; i < IRC_STATS_NUM_COUNTERS; i++)
+    {
+        weechat_log_printf ("       %-24s : %ld",
+                            irc_stats_counter_name[i], stats->total[i]);
+    }
+    weechat_log_printf ("       commands . . . . . . . . : 0x%lx (%d items)",
+                        stats->commands,
+                        weechat_hashtable_get_integer (stats->commands,
+                                                       "items_count"));
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_IRC_STATS_H
+#define WEECHAT_PLUGIN_IRC_STATS_H
+
+#include <time.h>
+#include <sys/time.h>
+
+/* number of minutes kept for rolling counters (windows: 1, 5, 15 minutes) */
+#define IRC_STATS_WINDOW_MINUTES 15
+
+/* number of windows returned in hashtable and displayed (irc_stats_windows) */
+#define IRC_STATS_NUM_WINDOWS    3
+
+/* max different commands counted, other ones are counted in "other" */
+#define IRC_STATS_MAX_COMMANDS   64
+#define IRC_STATS_COMMAND_OTHER  "other"
+
+struct t_irc_server;
+
+enum t_irc_stats_counter
+{
+    IRC_STATS_BYTES_RECV = 0,          /* bytes received from server        */
+    IRC_STATS_BYTES_SENT,              /* bytes sent to server              */
+    IRC_STATS_MSGS_RECV,               /* messages received from server     */
+    IRC_STATS_MSGS_SENT,               /* messages sent to server           */
+    IRC_STATS_RECV_TIME,               /* time spent in processing of       */
+                                       /* received messages (microseconds)  */
+    IRC_STATS_OUTQUEUE_MSGS,           /* messages sent from out queue      */
+    IRC_STATS_OUTQUEUE_WAIT,           /* time spent by messages in out     */
+                                       /* queue (milliseconds)              */
+    IRC_STATS_LAG_SAMPLES,             /* number of lag measures            */
+    IRC_STATS_LAG,                     /* sum of lag measures (ms)          */
+    IRC_STATS_REDIRECT_MSGS,           /* messages checked by redirects     */
+    IRC_STATS_REDIRECT_TIME,           /* time spent in redirects for       */
+                                       /* received messages (microseconds)  */
+    IRC_STATS_REDIRECTS,               /* redirections completed            */
+    /* number of counters */
+    IRC_STATS_NUM_COUNTERS,
+};
+
+struct t_irc_stats_window
+{
+    time_t minute[IRC_STATS_WINDOW_MINUTES]; /* minute (time / 60) of slot  */
+    long value[IRC_STATS_WINDOW_MINUTES];    /* value for this minute       */
+};
+
+struct t_irc_stats_command
+{
+    long count;                        /* number of messages received       */
+    long time;                         /* processing time (microseconds)    */
+    struct t_irc_stats_window window_count; /* rolling count                */
+    struct t_irc_stats_window window_time;  /* rolling processing time      */
+};
+
+struct t_irc_stats
+{
+    time_t start_time;                 /* time of start of statistics       */
+    long total[IRC_STATS_NUM_COUNTERS];  /* counters since start            */
+    struct t_irc_stats_window window[IRC_STATS_NUM_COUNTERS]; /* rolling    */
+    struct t_hashtable *commands;      /* stats by command received         */
+                                       /* (key: command, value: pointer to  */
+                                       /* struct t_irc_stats_command)       */
+};
+
+extern char *irc_stats_counter_name[];
+extern int irc_stats_windows[];
+
+extern struct t_irc_stats *irc_stats_new ();
+extern void irc_stats_reset (struct t_irc_stats *stats);
+extern void irc_stats_window_add (struct t_irc_stats_window *window,
+                                  time_t current_time, long value);
+extern long irc_stats_window_sum (struct t_irc_stats_window *window,
+                                  time_t current_time, int minutes);
+extern void irc_stats_add (struct t_irc_stats *stats,
+                           enum t_irc_stats_counter counter, long value);
+extern void irc_stats_add_sent (struct t_irc_stats *stats,
+                                const char *buffer, int size);
+extern void irc_stats_add_message (struct t_irc_stats *stats,
+                                   const char *command,
+                                   struct timeval *tv_start);
+extern long irc_stats_get (struct t_irc_stats *stats,
+                           enum t_irc_stats_counter counter,
+                           time_t current_time, int minutes);
+extern int irc_stats_outqueue_depth (struct t_irc_server *server);
+extern struct t_hashtable *irc_stats_to_hashtable (struct t_irc_server *server);
+extern void irc_stats_free (struct t_irc_stats *stats);
+extern struct t_hdata *irc_stats_hdata_stats_cb (const void *pointer,
+                                                 void *data,
+                                                 const char *hdata_name);
+extern void irc_stats_print_log (struct t_irc_stats *stats);
+
+#endif /* WEECHAT_PLUGIN_IRC_STATS_H */
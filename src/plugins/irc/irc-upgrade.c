@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "../weechat-plugin.h"
 #include "irc.h"
@@ -34,6 +35,7 @@
 #include "irc-nick.h"
 #include "irc-notify.h"
 #include "irc-raw.h"
+#include "irc-recv-thread.h"
 #include "irc-redirect.h"
 #include "irc-server.h"
 
@@ -43,6 +45,618 @@ struct t_irc_channel *irc_upgrade_current_channel = NULL;
 struct t_irc_modelist *irc_upgrade_current_modelist = NULL;
 
 
+/*
+ * Initializes a pack.
+ *
+ * If data is NULL, the pack is empty and used to add data, otherwise the pack
+ * is used to read data (which is not copied and must remain valid while the
+ * pack is read).
+ */
+
+void
+irc_upgrade_pack_init (struct t_irc_upgrade_pack *pack,
+                       const void *data, int size)
+{
+    if (!pack)
+        return;
+
+    pack->data = (char *)data;
+    pack->size = (data && (size > 0)) ? size : 0;
+    pack->allocated = 0;
+    pack->pos = 0;
+    pack->error = 0;
+}
+
+/*
+ * Frees data in a pack.
+ */
+
+void
+irc_upgrade_pack_free (struct t_irc_upgrade_pack *pack)
+{
+    if (!pack)
+        return;
+
+    if (pack->data && (pack->allocated > 0))
+        free (pack->data);
+    pack->data = NULL;
+    pack->size = 0;
+    pack->allocated = 0;
+    pack->pos = 0;
+}
+
+/*
+ * Adds raw bytes at the end of a pack (the buffer is grown if needed).
+ */
+
+void
+irc_upgrade_pack_add (struct t_irc_upgrade_pack *pack,
+                      const void *data, int size)
+{
+    char *new_data;
+    int new_allocated;
+
+    if (!pack || pack->error || (size <= 0))
+        return;
+
+    if (pack->size + size > pack->allocated)
+    {
+        new_allocated = (pack->allocated > 0) ? pack->allocated * 2 : 4096;
+        while (pack->size + size > new_allocated)
+        {
+            new_allocated *= 2;
+        }
+        new_data = realloc ((pack->allocated > 0) ? pack->data : NULL,
+                            new_allocated);
+        if (!new_data)
+        {
+            pack->error = 1;
+            return;
+        }
+        pack->data = new_data;
+        pack->allocated = new_allocated;
+    }
+
+    memcpy (pack->data + pack->size, data, size);
+    pack->size += size;
+}
+
+/*
+ * Adds an integer in a pack.
+ */
+
+void
+irc_upgrade_pack_add_int (struct t_irc_upgrade_pack *pack, int value)
+{
+    irc_upgrade_pack_add (pack, &value, sizeof (value));
+}
+
+/*
+ * Adds a time in a pack.
+ */
+
+void
+irc_upgrade_pack_add_time (struct t_irc_upgrade_pack *pack, time_t value)
+{
+    long long time_value;
+
+    time_value = (long long)value;
+    irc_upgrade_pack_add (pack, &time_value, sizeof (time_value));
+}
+
+/*
+ * Adds a string in a pack: length (-1 for NULL), then the string with final
+ * '\0' (so that the string can be read without copy).
+ */
+
+void
+irc_upgrade_pack_add_string (struct t_irc_upgrade_pack *pack,
+                             const char *string)
+{
+    int length;
+
+    length = (string) ? (int)strlen (string) : -1;
+    irc_upgrade_pack_add_int (pack, length);
+    if (string)
+        irc_upgrade_pack_add (pack, string, length + 1);
+}
+
+/*
+ * Reads an integer in a pack.
+ *
+ * Returns the integer read, 0 if error.
+ */
+
+int
+irc_upgrade_pack_read_int (struct t_irc_upgrade_pack *pack)
+{
+    int value;
+
+    if (!pack || pack->error)
+        return 0;
+
+    if (pack->pos + (int)sizeof (value) > pack->size)
+    {
+        pack->error = 1;
+        return 0;
+    }
+
+    memcpy (&value, pack->data + pack->pos, sizeof (value));
+    pack->pos += sizeof (value);
+
+    return value;
+}
+
+/*
+ * Reads a time in a pack.
+ *
+ * Returns the time read, 0 if error.
+ */
+
+time_t
+irc_upgrade_pack_read_time (struct t_irc_upgrade_pack *pack)
+{
+    long long time_value;
+
+    if (!pack || pack->error)
+        return 0;
+
+    if (pack->pos + (int)sizeof (time_value) > pack->size)
+    {
+        pack->error = 1;
+        return 0;
+    }
+
+    memcpy (&time_value, pack->data + pack->pos, sizeof (time_value));
+    pack->pos += sizeof (time_value);
+
+    return (time_t)time_value;
+}
+
+/*
+ * Reads a string in a pack.
+ *
+ * Returns pointer to string in pack data (not to be freed), NULL if the string
+ * is NULL or if error.
+ */
+
+const char *
+irc_upgrade_pack_read_string (struct t_irc_upgrade_pack *pack)
+{
+    const char *string;
+    int length;
+
+    length = irc_upgrade_pack_read_int (pack);
+    if (!pack || pack->error || (length < 0))
+        return NULL;
+
+    if ((pack->pos + length + 1 > pack->size)
+        || (pack->data[pack->pos + length] != '\0'))
+    {
+        pack->error = 1;
+        return NULL;
+    }
+
+    string = pack->data + pack->pos;
+    pack->pos += length + 1;
+
+    return string;
+}
+
+/*
+ * Packs nicks of a channel.
+ *
+ * Returns number of nicks packed.
+ */
+
+int
+irc_upgrade_pack_nicks (struct t_irc_upgrade_pack *pack,
+                        struct t_irc_channel *channel)
+{
+    struct t_irc_nick *ptr_nick;
+
+    irc_upgrade_pack_add_int (pack, channel->nicks_count);
+    for (ptr_nick = channel->nicks; ptr_nick;
+         ptr_nick = ptr_nick->next_nick)
+    {
+        irc_upgrade_pack_add_string (pack, ptr_nick->name);
+        irc_upgrade_pack_add_string (pack, ptr_nick->host);
+        irc_upgrade_pack_add_string (pack, ptr_nick->prefixes);
+        irc_upgrade_pack_add_int (pack, ptr_nick->away);
+        irc_upgrade_pack_add_string (pack, ptr_nick->account);
+        irc_upgrade_pack_add_string (pack, ptr_nick->realname);
+    }
+
+    return channel->nicks_count;
+}
+
+/*
+ * Restores nicks of a channel from a pack.
+ */
+
+void
+irc_upgrade_unpack_nicks (struct t_irc_upgrade_pack *pack,
+                          struct t_irc_server *server,
+                          struct t_irc_channel *channel)
+{
+    const char *name, *host, *prefixes, *account, *realname;
+    int i, count, away;
+
+    count = irc_upgrade_pack_read_int (pack);
+    for (i = 0; (i < count) && !pack->error; i++)
+    {
+        name = irc_upgrade_pack_read_string (pack);
+        host = irc_upgrade_pack_read_string (pack);
+        prefixes = irc_upgrade_pack_read_string (pack);
+        away = irc_upgrade_pack_read_int (pack);
+        account = irc_upgrade_pack_read_string (pack);
+        realname = irc_upgrade_pack_read_string (pack);
+        if (!pack->error)
+        {
+            irc_nick_new (server, channel, name, host, prefixes, away,
+                          account, realname);
+        }
+    }
+}
+
+/*
+ * Packs modelists of a channel (with their items).
+ *
+ * Returns number of modelist items packed.
+ */
+
+int
+irc_upgrade_pack_modelists (struct t_irc_upgrade_pack *pack,
+                            struct t_irc_channel *channel)
+{
+    struct t_irc_modelist *ptr_modelist;
+    struct t_irc_modelist_item *ptr_item;
+    int count;
+
+    count = 0;
+    for (ptr_modelist = channel->modelists; ptr_modelist;
+         ptr_modelist = ptr_modelist->next_modelist)
+    {
+        count++;
+    }
+
+    irc_upgrade_pack_add_int (pack, count);
+
+    count = 0;
+    for (ptr_modelist = channel->modelists; ptr_modelist;
+         ptr_modelist = ptr_modelist->next_modelist)
+    {
+        irc_upgrade_pack_add_int (pack, ptr_modelist->type);
+        irc_upgrade_pack_add_int (pack, ptr_modelist->state);
+        irc_upgrade_pack_add_int (pack, ptr_modelist->items_count);
+        for (ptr_item = ptr_modelist->items; ptr_item;
+             ptr_item = ptr_item->next_item)
+        {
+            irc_upgrade_pack_add_int (pack, ptr_item->number);
+            irc_upgrade_pack_add_string (pack, ptr_item->mask);
+            irc_upgrade_pack_add_string (pack, ptr_item->setter);
+            irc_upgrade_pack_add_time (pack, ptr_item->datetime);
+        }
+        count += ptr_modelist->items_count;
+    }
+
+    return count;
+}
+
+/*
+ * Restores modelists of a channel from a pack (modelists are already created
+ * by the channel, only the items and state are restored).
+ */
+
+void
+irc_upgrade_unpack_modelists (struct t_irc_upgrade_pack *pack,
+                              struct t_irc_channel *channel)
+{
+    struct t_irc_modelist *ptr_modelist;
+    struct t_irc_modelist_item *ptr_item;
+    const char *mask, *setter;
+    int i, j, count, type, state, items_count, number;
+    time_t datetime;
+
+    count = irc_upgrade_pack_read_int (pack);
+    for (i = 0; (i < count) && !pack->error; i++)
+    {
+        type = irc_upgrade_pack_read_int (pack);
+        state = irc_upgrade_pack_read_int (pack);
+        items_count = irc_upgrade_pack_read_int (pack);
+        ptr_modelist = irc_modelist_search (channel, (char)type);
+        for (j = 0; (j < items_count) && !pack->error; j++)
+        {
+            number = irc_upgrade_pack_read_int (pack);
+            mask = irc_upgrade_pack_read_string (pack);
+            setter = irc_upgrade_pack_read_string (pack);
+            datetime = irc_upgrade_pack_read_time (pack);
+            if (ptr_modelist && !pack->error)
+            {
+                ptr_item = irc_modelist_item_new (ptr_modelist, mask, setter,
+                                                  datetime);
+                if (ptr_item)
+                    irc_modelist_item_set_number (ptr_modelist, ptr_item,
+                                                  number);
+            }
+        }
+        /* state is restored after items (adding items changes the state) */
+        if (ptr_modelist)
+            ptr_modelist->state = state;
+    }
+}
+
+/*
+ * Packs redirects of a server.
+ *
+ * Returns number of redirects packed.
+ */
+
+int
+irc_upgrade_pack_redirects (struct t_irc_upgrade_pack *pack,
+                            struct t_irc_server *server)
+{
+    struct t_irc_redirect *ptr_redirect;
+    int count;
+
+    count = 0;
+    for (ptr_redirect = server->redirects; ptr_redirect;
+         ptr_redirect = ptr_redirect->next_redirect)
+    {
+        count++;
+    }
+
+    irc_upgrade_pack_add_int (pack, count);
+    for (ptr_redirect = server->redirects; ptr_redirect;
+         ptr_redirect = ptr_redirect->next_redirect)
+    {
+        irc_upgrade_pack_add_string (pack, ptr_redirect->pattern);
+        irc_upgrade_pack_add_string (pack, ptr_redirect->signal);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->count);
+        irc_upgrade_pack_add_string (pack, ptr_redirect->string);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->timeout);
+        irc_upgrade_pack_add_string (
+            pack,
+            weechat_hashtable_get_string (ptr_redirect->cmd_start,
+                                          "keys_values"));
+        irc_upgrade_pack_add_string (
+            pack,
+            weechat_hashtable_get_string (ptr_redirect->cmd_stop,
+                                          "keys_values"));
+        irc_upgrade_pack_add_string (
+            pack,
+            weechat_hashtable_get_string (ptr_redirect->cmd_extra,
+                                          "keys_values"));
+        irc_upgrade_pack_add_string (
+            pack,
+            weechat_hashtable_get_string (ptr_redirect->cmd_filter,
+                                          "keys"));
+        irc_upgrade_pack_add_int (pack, ptr_redirect->current_count);
+        irc_upgrade_pack_add_string (pack, ptr_redirect->command);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->assigned_to_command);
+        irc_upgrade_pack_add_time (pack, ptr_redirect->start_time);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->cmd_start_received);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->cmd_stop_received);
+        irc_upgrade_pack_add_string (pack, ptr_redirect->output);
+        irc_upgrade_pack_add_int (pack, ptr_redirect->output_size);
+    }
+
+    return count;
+}
+
+/*
+ * Restores redirects of a server from a pack.
+ */
+
+void
+irc_upgrade_unpack_redirects (struct t_irc_upgrade_pack *pack,
+                              struct t_irc_server *server)
+{
+    struct t_irc_redirect *ptr_redirect;
+    const char *pattern, *signal, *string, *cmd_start, *cmd_stop, *cmd_extra;
+    const char *cmd_filter, *command, *output;
+    int i, count, redirect_count, timeout, current_count, assigned_to_command;
+    int cmd_start_received, cmd_stop_received, output_size;
+    time_t start_time;
+
+    count = irc_upgrade_pack_read_int (pack);
+    for (i = 0; (i < count) && !pack->error; i++)
+    {
+        pattern = irc_upgrade_pack_read_string (pack);
+        signal = irc_upgrade_pack_read_string (pack);
+        redirect_count = irc_upgrade_pack_read_int (pack);
+        string = irc_upgrade_pack_read_string (pack);
+        timeout = irc_upgrade_pack_read_int (pack);
+        cmd_start = irc_upgrade_pack_read_string (pack);
+        cmd_stop = irc_upgrade_pack_read_string (pack);
+        cmd_extra = irc_upgrade_pack_read_string (pack);
+        cmd_filter = irc_upgrade_pack_read_string (pack);
+        current_count = irc_upgrade_pack_read_int (pack);
+        command = irc_upgrade_pack_read_string (pack);
+        assigned_to_command = irc_upgrade_pack_read_int (pack);
+        start_time = irc_upgrade_pack_read_time (pack);
+        cmd_start_received = irc_upgrade_pack_read_int (pack);
+        cmd_stop_received = irc_upgrade_pack_read_int (pack);
+        output = irc_upgrade_pack_read_string (pack);
+        output_size = irc_upgrade_pack_read_int (pack);
+        if (pack->error)
+            break;
+        ptr_redirect = irc_redirect_new_with_commands (
+            server, pattern, signal, redirect_count, string, timeout,
+            cmd_start, cmd_stop, cmd_extra, cmd_filter);
+        if (ptr_redirect)
+        {
+            ptr_redirect->current_count = current_count;
+            if (command)
+                ptr_redirect->command = strdup (command);
+            ptr_redirect->assigned_to_command = assigned_to_command;
+            ptr_redirect->start_time = start_time;
+            irc_redirect_set_received (ptr_redirect, cmd_start_received,
+                                       cmd_stop_received);
+            if (output)
+                ptr_redirect->output = strdup (output);
+            ptr_redirect->output_size = output_size;
+        }
+    }
+}
+
+/*
+ * Packs notify list of a server.
+ *
+ * Returns number of notify packed.
+ */
+
+int
+irc_upgrade_pack_notify_list (struct t_irc_upgrade_pack *pack,
+                              struct t_irc_server *server)
+{
+    struct t_irc_notify *ptr_notify;
+    int count;
+
+    count = 0;
+    for (ptr_notify = server->notify_list; ptr_notify;
+         ptr_notify = ptr_notify->next_notify)
+    {
+        count++;
+    }
+
+    irc_upgrade_pack_add_int (pack, count);
+    for (ptr_notify = server->notify_list; ptr_notify;
+         ptr_notify = ptr_notify->next_notify)
+    {
+        irc_upgrade_pack_add_string (pack, ptr_notify->nick);
+        irc_upgrade_pack_add_int (pack, ptr_notify->is_on_server);
+        irc_upgrade_pack_add_string (pack, ptr_notify->away_message);
+    }
+
+    return count;
+}
+
+/*
+ * Restores notify list of a server from a pack (notify are already created
+ * with the server option, only their state is restored).
+ */
+
+void
+irc_upgrade_unpack_notify_list (struct t_irc_upgrade_pack *pack,
+                                struct t_irc_server *server)
+{
+    struct t_irc_notify *ptr_notify;
+    const char *nick, *away_message;
+    int i, count, is_on_server;
+
+    count = irc_upgrade_pack_read_int (pack);
+    for (i = 0; (i < count) && !pack->error; i++)
+    {
+        nick = irc_upgrade_pack_read_string (pack);
+        is_on_server = irc_upgrade_pack_read_int (pack);
+        away_message = irc_upgrade_pack_read_string (pack);
+        if (pack->error)
+            break;
+        ptr_notify = irc_notify_search (server, nick);
+        if (ptr_notify)
+        {
+            ptr_notify->is_on_server = is_on_server;
+            if (ptr_notify->away_message)
+                free (ptr_notify->away_message);
+            ptr_notify->away_message = (away_message) ?
+                strdup (away_message) : NULL;
+        }
+    }
+}
+
+/*
+ * Packs raw messages.
+ *
+ * Returns number of raw messages packed.
+ */
+
+int
+irc_upgrade_pack_raw_messages (struct t_irc_upgrade_pack *pack)
+{
+    struct t_irc_raw_message *ptr_raw_message;
+    int i;
+
+    irc_upgrade_pack_add_int (pack, irc_raw_messages_count);
+    for (i = 0; i < irc_raw_messages_count; i++)
+    {
+        ptr_raw_message = irc_raw_message_get (i);
+        irc_upgrade_pack_add_time (pack, ptr_raw_message->date);
+        irc_upgrade_pack_add_string (
+            pack,
+            (ptr_raw_message->server) ? ptr_raw_message->server->name : NULL);
+        irc_upgrade_pack_add_int (pack, ptr_raw_message->flags);
+        irc_upgrade_pack_add_string (pack, ptr_raw_message->message);
+    }
+
+    return irc_raw_messages_count;
+}
+
+/*
+ * Restores raw messages from a pack.
+ */
+
+void
+irc_upgrade_unpack_raw_messages (struct t_irc_upgrade_pack *pack)
+{
+    struct t_irc_server *ptr_server;
+    const char *server_name, *message;
+    int i, count, flags;
+    time_t date;
+
+    count = irc_upgrade_pack_read_int (pack);
+    for (i = 0; (i < count) && !pack->error; i++)
+    {
+        date = irc_upgrade_pack_read_time (pack);
+        server_name = irc_upgrade_pack_read_string (pack);
+        flags = irc_upgrade_pack_read_int (pack);
+        message = irc_upgrade_pack_read_string (pack);
+        if (pack->error || !server_name)
+            continue;
+        ptr_server = irc_server_search (server_name);
+        if (ptr_server)
+            irc_raw_message_add_to_list (date, ptr_server, flags, message);
+    }
+}
+
+/*
+ * Writes a pack in irc upgrade file, as an object with a single variable
+ * "data" (buffer).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+irc_upgrade_write_pack (struct t_upgrade_file *upgrade_file, int object_id,
+                        struct t_irc_upgrade_pack *pack)
+{
+    struct t_infolist *infolist;
+    struct t_infolist_item *ptr_item;
+    int rc;
+
+    if (pack->error)
+        return 0;
+
+    infolist = weechat_infolist_new ();
+    if (!infolist)
+        return 0;
+
+    rc = 0;
+    ptr_item = weechat_infolist_new_item (infolist);
+    if (ptr_item
+        && weechat_infolist_new_var_buffer (ptr_item, "data",
+                                            pack->data, pack->size))
+    {
+        rc = weechat_upgrade_write_object (upgrade_file, object_id, infolist);
+    }
+
+    weechat_infolist_free (infolist);
+
+    return rc;
+}
+
 /*
  * Saves servers/channels/nicks info to irc upgrade file.
  *
@@ -57,15 +671,15 @@ irc_upgrade_save_all_data (struct t_upgrade_file *upgrade_file)
     struct t_infolist *infolist;
     struct t_irc_server *ptr_server;
     struct t_irc_channel *ptr_channel;
-    struct t_irc_nick *ptr_nick;
-    struct t_irc_redirect *ptr_redirect;
     struct t_irc_redirect_pattern *ptr_redirect_pattern;
-    struct t_irc_notify *ptr_notify;
-    struct t_irc_modelist *ptr_modelist;
-    struct t_irc_modelist_item *ptr_item;
-    struct t_irc_raw_message *ptr_raw_message;
+    struct t_irc_upgrade_pack pack;
     int rc;
 
+    /*
+     * servers and channels are saved with infolists; nicks, modelists,
+     * redirects, notify and raw messages (which can be numerous) are saved
+     * in compact packs, with one object per channel/server
+     */
     for (ptr_server = irc_servers; ptr_server;
          ptr_server = ptr_server->next_server)
     {
@@ -105,128 +719,53 @@ irc_upgrade_save_all_data (struct t_upgrade_file *upgrade_file)
             if (!rc)
                 return 0;
 
-            for (ptr_nick = ptr_channel->nicks; ptr_nick;
-                 ptr_nick = ptr_nick->next_nick)
-            {
-                /* save nick */
-                infolist = weechat_infolist_new ();
-                if (!infolist)
-                    return 0;
-                if (!irc_nick_add_to_infolist (infolist, ptr_nick))
-                {
-                    weechat_infolist_free (infolist);
-                    return 0;
-                }
-                rc = weechat_upgrade_write_object (upgrade_file,
-                                                   IRC_UPGRADE_TYPE_NICK,
-                                                   infolist);
-                weechat_infolist_free (infolist);
-                if (!rc)
-                    return 0;
-            }
-
-            for (ptr_modelist = ptr_channel->modelists; ptr_modelist;
-                 ptr_modelist = ptr_modelist->next_modelist)
-            {
-                /* save modelist */
-                infolist = weechat_infolist_new ();
-                if (!infolist)
-                    return 0;
-                if (!irc_modelist_add_to_infolist (infolist, ptr_modelist))
-                {
-                    weechat_infolist_free (infolist);
-                    return 0;
-                }
-                rc = weechat_upgrade_write_object (upgrade_file,
-                                                   IRC_UPGRADE_TYPE_MODELIST,
-                                                   infolist);
-                weechat_infolist_free (infolist);
-                if (!rc)
-                    return 0;
-
-                for (ptr_item = ptr_modelist->items; ptr_item;
-                     ptr_item = ptr_item->next_item)
-                {
-                    /* save modelist item */
-                    infolist = weechat_infolist_new ();
-                    if (!infolist)
-                        return 0;
-                    if (!irc_modelist_item_add_to_infolist (infolist, ptr_item))
-                    {
-                        weechat_infolist_free (infolist);
-                        return 0;
-                    }
-                    rc = weechat_upgrade_write_object (upgrade_file,
-                                                       IRC_UPGRADE_TYPE_MODELIST_ITEM,
-                                                       infolist);
-                    weechat_infolist_free (infolist);
-                    if (!rc)
-                        return 0;
-                }
-            }
-        }
-
-        /* save server redirects */
-        for (ptr_redirect = ptr_server->redirects; ptr_redirect;
-             ptr_redirect = ptr_redirect->next_redirect)
-        {
-            infolist = weechat_infolist_new ();
-            if (!infolist)
-                return 0;
-            if (!irc_redirect_add_to_infolist (infolist, ptr_redirect))
-            {
-                weechat_infolist_free (infolist);
-                return 0;
-            }
-            rc = weechat_upgrade_write_object (upgrade_file,
-                                               IRC_UPGRADE_TYPE_REDIRECT,
-                                               infolist);
-            weechat_infolist_free (infolist);
+            /* save nicks */
+            irc_upgrade_pack_init (&pack, NULL, 0);
+            rc = (irc_upgrade_pack_nicks (&pack, ptr_channel) > 0) ?
+                irc_upgrade_write_pack (upgrade_file, IRC_UPGRADE_TYPE_NICKS,
+                                        &pack) : !pack.error;
+            irc_upgrade_pack_free (&pack);
             if (!rc)
                 return 0;
-        }
 
-        /* save server notify list */
-        for (ptr_notify = ptr_server->notify_list; ptr_notify;
-             ptr_notify = ptr_notify->next_notify)
-        {
-            infolist = weechat_infolist_new ();
-            if (!infolist)
-                return 0;
-            if (!irc_notify_add_to_infolist (infolist, ptr_notify))
-            {
-                weechat_infolist_free (infolist);
-                return 0;
-            }
-            rc = weechat_upgrade_write_object (upgrade_file,
-                                               IRC_UPGRADE_TYPE_NOTIFY,
-                                               infolist);
-            weechat_infolist_free (infolist);
+            /* save modelists */
+            irc_upgrade_pack_init (&pack, NULL, 0);
+            irc_upgrade_pack_modelists (&pack, ptr_channel);
+            rc = irc_upgrade_write_pack (upgrade_file,
+                                         IRC_UPGRADE_TYPE_MODELISTS, &pack);
+            irc_upgrade_pack_free (&pack);
             if (!rc)
                 return 0;
         }
-    }
 
-    /* save raw messages */
-    for (ptr_raw_message = irc_raw_messages; ptr_raw_message;
-         ptr_raw_message = ptr_raw_message->next_message)
-    {
-        infolist = weechat_infolist_new ();
-        if (!infolist)
-            return 0;
-        if (!irc_raw_add_to_infolist (infolist, ptr_raw_message))
-        {
-            weechat_infolist_free (infolist);
+        /* save server redirects */
+        irc_upgrade_pack_init (&pack, NULL, 0);
+        rc = (irc_upgrade_pack_redirects (&pack, ptr_server) > 0) ?
+            irc_upgrade_write_pack (upgrade_file, IRC_UPGRADE_TYPE_REDIRECTS,
+                                    &pack) : !pack.error;
+        irc_upgrade_pack_free (&pack);
+        if (!rc)
             return 0;
-        }
-        rc = weechat_upgrade_write_object (upgrade_file,
-                                           IRC_UPGRADE_TYPE_RAW_MESSAGE,
-                                           infolist);
-        weechat_infolist_free (infolist);
+
+        /* save server notify list */
+        irc_upgrade_pack_init (&pack, NULL, 0);
+        rc = (irc_upgrade_pack_notify_list (&pack, ptr_server) > 0) ?
+            irc_upgrade_write_pack (upgrade_file, IRC_UPGRADE_TYPE_NOTIFY_LIST,
+                                    &pack) : !pack.error;
+        irc_upgrade_pack_free (&pack);
         if (!rc)
             return 0;
     }
 
+    /* save raw messages */
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    rc = (irc_upgrade_pack_raw_messages (&pack) > 0) ?
+        irc_upgrade_write_pack (upgrade_file, IRC_UPGRADE_TYPE_RAW_MESSAGES,
+                                &pack) : !pack.error;
+    irc_upgrade_pack_free (&pack);
+    if (!rc)
+        return 0;
+
     /* save redirect patterns */
     for (ptr_redirect_pattern = irc_redirect_patterns; ptr_redirect_pattern;
          ptr_redirect_pattern = ptr_redirect_pattern->next_redirect)
@@ -257,6 +796,9 @@ irc_upgrade_save_all_data (struct t_upgrade_file *upgrade_file)
 /*
  * Saves irc upgrade file.
  *
+ * With debug enabled for irc plugin, the time spent is written in WeeChat log
+ * file.
+ *
  * Returns:
  *   1: OK
  *   0: error
@@ -267,6 +809,21 @@ irc_upgrade_save ()
 {
     int rc;
     struct t_upgrade_file *upgrade_file;
+    struct t_irc_server *ptr_server;
+    struct timeval tv_start, tv_end;
+
+    gettimeofday (&tv_start, NULL);
+
+    /*
+     * stop receiving threads and process messages already received, so that
+     * only the unterminated messages are saved
+     */
+    for (ptr_server = irc_servers; ptr_server;
+         ptr_server = ptr_server->next_server)
+    {
+        irc_recv_thread_stop (ptr_server, 1);
+    }
+    irc_server_msgq_flush ();
 
     upgrade_file = weechat_upgrade_new (IRC_UPGRADE_FILENAME,
                                         NULL, NULL, NULL);
@@ -277,6 +834,14 @@ irc_upgrade_save ()
 
     weechat_upgrade_close (upgrade_file);
 
+    if (weechat_irc_plugin->debug >= 1)
+    {
+        gettimeofday (&tv_end, NULL);
+        weechat_log_printf ("irc: upgrade: save: %lld usec (rc: %d)",
+                            weechat_util_timeval_diff (&tv_start, &tv_end),
+                            rc);
+    }
+
     return rc;
 }
 
@@ -351,6 +916,8 @@ irc_upgrade_read_cb (const void *pointer, void *data,
     struct t_irc_notify *ptr_notify;
     struct t_irc_modelist_item *ptr_item;
     struct t_gui_buffer *ptr_buffer;
+    struct t_irc_upgrade_pack pack;
+    void *ptr_data;
 
     /* make C compiler happy */
     (void) pointer;
@@ -402,17 +969,10 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                         irc_upgrade_current_server->current_ip = strdup (str);
                     sock = weechat_infolist_integer (infolist, "sock");
                     if (sock >= 0)
-                    {
                         irc_upgrade_current_server->sock = sock;
-                        irc_upgrade_current_server->hook_fd = weechat_hook_fd (
-                            irc_upgrade_current_server->sock,
-                            1, 0, 0,
-                            &irc_server_recv_cb,
-                            irc_upgrade_current_server,
-                            NULL);
-                    }
                     irc_upgrade_current_server->is_connected = weechat_infolist_integer (infolist, "is_connected");
                     irc_upgrade_current_server->ssl_connected = weechat_infolist_integer (infolist, "ssl_connected");
+                    irc_server_hook_recv (irc_upgrade_current_server);
                     irc_upgrade_current_server->disconnected = weechat_infolist_integer (infolist, "disconnected");
                     str = weechat_infolist_string (infolist, "unterminated_message");
                     if (str)
@@ -565,6 +1125,7 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                         }
                     }
                     irc_upgrade_current_server->reconnect_delay = weechat_infolist_integer (infolist, "reconnect_delay");
+                    irc_upgrade_current_server->reconnect_jitter = weechat_infolist_integer (infolist, "reconnect_jitter");
                     irc_upgrade_current_server->reconnect_start = weechat_infolist_time (infolist, "reconnect_start");
                     irc_upgrade_current_server->command_time = weechat_infolist_time (infolist, "command_time");
                     irc_upgrade_current_server->reconnect_join = weechat_infolist_integer (infolist, "reconnect_join");
@@ -645,7 +1206,8 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                                 nick = weechat_infolist_string (infolist, option_name);
                                 if (!nick)
                                     break;
-                                irc_channel_nick_speaking_add (irc_upgrade_current_channel,
+                                irc_channel_nick_speaking_add (irc_upgrade_current_server,
+                                                               irc_upgrade_current_channel,
                                                                nick,
                                                                i);
                                 index++;
@@ -820,7 +1382,10 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                         weechat_infolist_time (infolist, "datetime"));
                     if (ptr_item)
                     {
-                        ptr_item->number = weechat_infolist_integer (infolist, "number");
+                        irc_modelist_item_set_number (
+                            irc_upgrade_current_modelist,
+                            ptr_item,
+                            weechat_infolist_integer (infolist, "number"));
                     }
                 }
                 break;
@@ -846,8 +1411,10 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                             ptr_redirect->command = strdup (str);
                         ptr_redirect->assigned_to_command = weechat_infolist_integer (infolist, "assigned_to_command");
                         ptr_redirect->start_time = weechat_infolist_time (infolist, "start_time");
-                        ptr_redirect->cmd_start_received = weechat_infolist_integer (infolist, "cmd_start_received");
-                        ptr_redirect->cmd_stop_received = weechat_infolist_integer (infolist, "cmd_stop_received");
+                        irc_redirect_set_received (
+                            ptr_redirect,
+                            weechat_infolist_integer (infolist, "cmd_start_received"),
+                            weechat_infolist_integer (infolist, "cmd_stop_received"));
                         str = weechat_infolist_string (infolist, "output");
                         if (str)
                             ptr_redirect->output = strdup (str);
@@ -894,6 +1461,48 @@ irc_upgrade_read_cb (const void *pointer, void *data,
                     }
                 }
                 break;
+            case IRC_UPGRADE_TYPE_NICKS:
+                if (irc_upgrade_current_server && irc_upgrade_current_channel)
+                {
+                    ptr_data = weechat_infolist_buffer (infolist, "data", &size);
+                    irc_upgrade_pack_init (&pack, ptr_data, size);
+                    irc_upgrade_unpack_nicks (&pack,
+                                              irc_upgrade_current_server,
+                                              irc_upgrade_current_channel);
+                }
+                break;
+            case IRC_UPGRADE_TYPE_MODELISTS:
+                if (irc_upgrade_current_server && irc_upgrade_current_channel)
+                {
+                    ptr_data = weechat_infolist_buffer (infolist, "data", &size);
+                    irc_upgrade_pack_init (&pack, ptr_data, size);
+                    irc_upgrade_unpack_modelists (&pack,
+                                                  irc_upgrade_current_channel);
+                }
+                break;
+            case IRC_UPGRADE_TYPE_REDIRECTS:
+                if (irc_upgrade_current_server)
+                {
+                    ptr_data = weechat_infolist_buffer (infolist, "data", &size);
+                    irc_upgrade_pack_init (&pack, ptr_data, size);
+                    irc_upgrade_unpack_redirects (&pack,
+                                                  irc_upgrade_current_server);
+                }
+                break;
+            case IRC_UPGRADE_TYPE_NOTIFY_LIST:
+                if (irc_upgrade_current_server)
+                {
+                    ptr_data = weechat_infolist_buffer (infolist, "data", &size);
+                    irc_upgrade_pack_init (&pack, ptr_data, size);
+                    irc_upgrade_unpack_notify_list (&pack,
+                                                    irc_upgrade_current_server);
+                }
+                break;
+            case IRC_UPGRADE_TYPE_RAW_MESSAGES:
+                ptr_data = weechat_infolist_buffer (infolist, "data", &size);
+                irc_upgrade_pack_init (&pack, ptr_data, size);
+                irc_upgrade_unpack_raw_messages (&pack);
+                break;
         }
     }
 
@@ -903,6 +1512,9 @@ irc_upgrade_read_cb (const void *pointer, void *data,
 /*
  * Loads irc upgrade file.
  *
+ * With debug enabled for irc plugin, the time spent is written in WeeChat log
+ * file.
+ *
  * Returns:
  *   1: OK
  *   0: error
@@ -914,6 +1526,9 @@ irc_upgrade_load ()
     int rc;
     struct t_upgrade_file *upgrade_file;
     const char *ptr_filter;
+    struct timeval tv_start, tv_end;
+
+    gettimeofday (&tv_start, NULL);
 
     irc_upgrade_set_buffer_callbacks ();
 
@@ -926,6 +1541,14 @@ irc_upgrade_load ()
 
     weechat_upgrade_close (upgrade_file);
 
+    if (weechat_irc_plugin->debug >= 1)
+    {
+        gettimeofday (&tv_end, NULL);
+        weechat_log_printf ("irc: upgrade: load: %lld usec (rc: %d)",
+                            weechat_util_timeval_diff (&tv_start, &tv_end),
+                            rc);
+    }
+
     if (irc_raw_buffer)
     {
         ptr_filter = weechat_buffer_get_string (irc_raw_buffer,
@@ -20,6 +20,8 @@
 #ifndef WEECHAT_PLUGIN_IRC_UPGRADE_H
 #define WEECHAT_PLUGIN_IRC_UPGRADE_H
 
+#include <time.h>
+
 #define IRC_UPGRADE_FILENAME "irc"
 
 /* For developers: please add new values ONLY AT THE END of enums */
@@ -35,8 +37,61 @@ enum t_irc_upgrade_type
     IRC_UPGRADE_TYPE_NOTIFY,
     IRC_UPGRADE_TYPE_MODELIST,
     IRC_UPGRADE_TYPE_MODELIST_ITEM,
+    /* packed objects: many items in a single buffer (variable "data") */
+    IRC_UPGRADE_TYPE_NICKS,
+    IRC_UPGRADE_TYPE_MODELISTS,
+    IRC_UPGRADE_TYPE_REDIRECTS,
+    IRC_UPGRADE_TYPE_NOTIFY_LIST,
+    IRC_UPGRADE_TYPE_RAW_MESSAGES,
+};
+
+struct t_irc_server;
+struct t_irc_channel;
+struct t_upgrade_file;
+
+/* compact binary buffer used to save/restore many items at once */
+
+struct t_irc_upgrade_pack
+{
+    char *data;                        /* packed data                       */
+    int size;                          /* size of data                      */
+    int allocated;                     /* allocated size (0 if data is not  */
+                                       /* owned by pack, when reading)      */
+    int pos;                           /* current position (when reading)   */
+    int error;                         /* 1 if error (memory or bad data)   */
 };
 
+extern void irc_upgrade_pack_init (struct t_irc_upgrade_pack *pack,
+                                   const void *data, int size);
+extern void irc_upgrade_pack_free (struct t_irc_upgrade_pack *pack);
+extern void irc_upgrade_pack_add_int (struct t_irc_upgrade_pack *pack,
+                                      int value);
+extern void irc_upgrade_pack_add_time (struct t_irc_upgrade_pack *pack,
+                                       time_t value);
+extern void irc_upgrade_pack_add_string (struct t_irc_upgrade_pack *pack,
+                                         const char *string);
+extern int irc_upgrade_pack_read_int (struct t_irc_upgrade_pack *pack);
+extern time_t irc_upgrade_pack_read_time (struct t_irc_upgrade_pack *pack);
+extern const char *irc_upgrade_pack_read_string (struct t_irc_upgrade_pack *pack);
+extern int irc_upgrade_pack_nicks (struct t_irc_upgrade_pack *pack,
+                                   struct t_irc_channel *channel);
+extern void irc_upgrade_unpack_nicks (struct t_irc_upgrade_pack *pack,
+                                      struct t_irc_server *server,
+                                      struct t_irc_channel *channel);
+extern int irc_upgrade_pack_modelists (struct t_irc_upgrade_pack *pack,
+                                       struct t_irc_channel *channel);
+extern void irc_upgrade_unpack_modelists (struct t_irc_upgrade_pack *pack,
+                                          struct t_irc_channel *channel);
+extern int irc_upgrade_pack_redirects (struct t_irc_upgrade_pack *pack,
+                                       struct t_irc_server *server);
+extern void irc_upgrade_unpack_redirects (struct t_irc_upgrade_pack *pack,
+                                          struct t_irc_server *server);
+extern int irc_upgrade_pack_notify_list (struct t_irc_upgrade_pack *pack,
+                                         struct t_irc_server *server);
+extern void irc_upgrade_unpack_notify_list (struct t_irc_upgrade_pack *pack,
+                                            struct t_irc_server *server);
+extern int irc_upgrade_pack_raw_messages (struct t_irc_upgrade_pack *pack);
+extern void irc_upgrade_unpack_raw_messages (struct t_irc_upgrade_pack *pack);
 extern int irc_upgrade_save ();
 extern int irc_upgrade_load ();
 
@@ -138,6 +138,7 @@ irc_signal_upgrade_cb (const void *pointer, void *data,
              */
             ptr_server->index_current_address = 0;
             ptr_server->reconnect_delay = IRC_SERVER_OPTION_INTEGER(ptr_server, IRC_SERVER_OPTION_AUTORECONNECT_DELAY);
+            ptr_server->reconnect_jitter = 0;
             ptr_server->reconnect_start = time (NULL) - ptr_server->reconnect_delay - 1;
         }
     }
@@ -302,6 +303,8 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
 
     irc_redirect_end ();
 
+    irc_nick_end ();
+
     irc_color_end ();
 
     return WEECHAT_RC_OK;
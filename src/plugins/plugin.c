@@ -813,6 +813,8 @@ plugin_load (const char *filename, int init_plugin, int argc, char **argv)
         new_plugin->buffer_set_pointer = &gui_buffer_set_pointer;
         new_plugin->buffer_string_replace_local_var = &gui_buffer_string_replace_local_var;
         new_plugin->buffer_match_list = &gui_buffer_match_list;
+        new_plugin->buffer_batch_start = &gui_buffer_batch_start;
+        new_plugin->buffer_batch_end = &gui_buffer_batch_end;
 
         new_plugin->window_search_with_buffer = &gui_window_search_with_buffer;
         new_plugin->window_get_integer = &gui_window_get_integer;
@@ -909,6 +911,11 @@ plugin_load (const char *filename, int init_plugin, int argc, char **argv)
         new_plugin->hdata_set = &hdata_set;
         new_plugin->hdata_update = &hdata_update;
         new_plugin->hdata_get_string = &hdata_get_string;
+        new_plugin->hdata_path_compile = &hdata_path_compile;
+        new_plugin->hdata_path_get_type = &hdata_path_get_type;
+        new_plugin->hdata_path_get_array_size = &hdata_path_get_array_size;
+        new_plugin->hdata_path_get_value = &hdata_path_get_value;
+        new_plugin->hdata_path_free = &hdata_path_free;
 
         new_plugin->upgrade_new = &upgrade_file_new;
         new_plugin->upgrade_write_object = &upgrade_file_write_object;
@@ -0,0 +1,2165 @@
+/*
+ * relay-irc-backlog.c - backlog of IRC channels sent to clients
+ *
+ * Copyright (C) 2003-2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <time.h>
+
+#include "../../weechat-plugin.h"
+#include "../relay.h"
+#include "relay-irc.h"
+#include "relay-irc-backlog.h"
+#include "../relay-client.h"
+#include "../relay-config.h"
+#include "../relay-filter.h"
+#include "../relay-server.h"
+
+
+struct t_relay_irc_backlog_index *relay_irc_backlog_indexes = NULL;
+struct t_relay_irc_backlog_index *last_relay_irc_backlog_index = NULL;
+struct t_hashtable *relay_irc_backlog_indexes_by_buffer = NULL;
+
+struct t_relay_irc_backlog *relay_irc_backlogs = NULL;
+struct t_relay_irc_backlog *last_relay_irc_backlog = NULL;
+
+/* timer used to build backlogs and to expire backlogs in cache */
+struct t_hook *relay_irc_backlog_timer = NULL;
+int relay_irc_backlog_timer_interval = 0;
+
+/* number of lines read outside the timer since its last call */
+int relay_irc_backlog_lines_read = 0;
+
+/*
+ * signals hooked to update indexes and to detect buffers closed (only when at
+ * least one backlog or index exists)
+ */
+char *relay_irc_backlog_signals[] =
+{ "buffer_line_added", "buffer_lines_added", "buffer_cleared",
+  "buffer_type_changed", "buffer_closing", NULL };
+struct t_hook *relay_irc_backlog_hook_signals[5] =
+{ NULL, NULL, NULL, NULL, NULL };
+
+/* compiled paths to read buffers and lines */
+struct t_hdata_path *relay_irc_backlog_path_buffer_batch = NULL;
+struct t_hdata_path *relay_irc_backlog_path_buffer_last_line = NULL;
+struct t_hdata_path *relay_irc_backlog_path_buffer_lines_count = NULL;
+struct t_hdata_path *relay_irc_backlog_path_line_buffer = NULL;
+struct t_hdata_path *relay_irc_backlog_path_line_data = NULL;
+struct t_hdata_path *relay_irc_backlog_path_line_prev_line = NULL;
+struct t_hdata_path *relay_irc_backlog_path_date = NULL;
+struct t_hdata_path *relay_irc_backlog_path_tags_array = NULL;
+struct t_hdata_path *relay_irc_backlog_path_message = NULL;
+
+
+/*
+ * Compiles a path if not already compiled.
+ */
+
+void
+relay_irc_backlog_compile_path (struct t_hdata_path **hpath,
+                                const char *hdata_name, const char *path)
+{
+    if (!*hpath)
+        *hpath = weechat_hdata_path_compile (weechat_hdata_get (hdata_name),
+                                             path);
+}
+
+/*
+ * Compiles paths used to read buffers and lines (only once).
+ *
+ * Returns:
+ *   1: paths OK
+ *   0: error
+ */
+
+int
+relay_irc_backlog_compile_paths ()
+{
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_buffer_batch,
+                                    "buffer", "batch");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_buffer_last_line,
+                                    "buffer", "own_lines.last_line");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_buffer_lines_count,
+                                    "buffer", "own_lines.lines_count");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_line_buffer,
+                                    "line", "data.buffer");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_line_data,
+                                    "line", "data");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_line_prev_line,
+                                    "line", "prev_line");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_date,
+                                    "line_data", "date");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_tags_array,
+                                    "line_data", "tags_array");
+    relay_irc_backlog_compile_path (&relay_irc_backlog_path_message,
+                                    "line_data", "message");
+
+    return (relay_irc_backlog_path_buffer_batch
+            && relay_irc_backlog_path_buffer_last_line
+            && relay_irc_backlog_path_buffer_lines_count
+            && relay_irc_backlog_path_line_buffer
+            && relay_irc_backlog_path_line_data
+            && relay_irc_backlog_path_line_prev_line
+            && relay_irc_backlog_path_date
+            && relay_irc_backlog_path_tags_array
+            && relay_irc_backlog_path_message) ? 1 : 0;
+}
+
+/*
+ * Gets value of a pointer with a compiled path.
+ */
+
+void *
+relay_irc_backlog_path_pointer (struct t_hdata_path *hpath, void *pointer)
+{
+    void **ptr_value;
+
+    ptr_value = weechat_hdata_path_get_value (hpath, pointer, -1);
+
+    return (ptr_value) ? *ptr_value : NULL;
+}
+
+/*
+ * Gets value of an integer with a compiled path.
+ */
+
+int
+relay_irc_backlog_path_integer (struct t_hdata_path *hpath, void *pointer)
+{
+    int *ptr_value;
+
+    ptr_value = weechat_hdata_path_get_value (hpath, pointer, -1);
+
+    return (ptr_value) ? *ptr_value : 0;
+}
+
+/*
+ * Gets info about a line in a buffer:
+ *   - irc command
+ *   - date
+ *   - nick
+ *   - nick1 and nick2 (old and new nick for irc "nick" command)
+ *   - host
+ *   - message (without colors).
+ *
+ * If server_time is 1, the time is sent in an IRC tag, otherwise it is added
+ * in message (according to option relay.irc.backlog_time_format).
+ * Join/part/quit of localvar_nick (if not NULL) are ignored.
+ *
+ * Argument line_data must be non NULL, the other arguments can be NULL.
+ *
+ * Note: tags and message (if given and filled) must be freed after use.
+ */
+
+void
+relay_irc_get_line_info (int server_time, const char *localvar_nick,
+                         void *line_data,
+                         int *irc_command, int *irc_action, time_t *date,
+                         const char **nick, const char **nick1,
+                         const char **nick2, const char **host,
+                         char **tags, char **message)
+{
+    int i, num_tags, command, action, all_tags, length;
+    char str_tag[512], *pos, *message_no_color, str_time[256];
+    char **ptr_tag_value, **ptr_message_value;
+    const char *ptr_tag, *ptr_message, *ptr_nick, *ptr_nick1, *ptr_nick2;
+    const char *ptr_host, *time_format;
+    time_t msg_date, *ptr_date;
+    struct tm *tm, gm_time;
+
+    if (irc_command)
+        *irc_command = -1;
+    if (irc_action)
+        *irc_action = 0;
+    if (date)
+        *date = 0;
+    if (nick)
+        *nick = NULL;
+    if (nick1)
+        *nick1 = NULL;
+    if (nick2)
+        *nick2 = NULL;
+    if (host)
+        *host = NULL;
+    if (tags)
+        *tags = NULL;
+    if (message)
+        *message = NULL;
+
+    if (!line_data || !relay_irc_backlog_compile_paths ())
+        return;
+
+    /* line filtered by option relay.irc.backlog_filter? just exit */
+    if (!relay_filter_match_line (relay_config_filter_irc_backlog, line_data))
+        return;
+
+    ptr_date = weechat_hdata_path_get_value (relay_irc_backlog_path_date,
+                                             line_data, -1);
+    msg_date = (ptr_date) ? *ptr_date : 0;
+    num_tags = weechat_hdata_path_get_array_size (
+        relay_irc_backlog_path_tags_array, line_data);
+    ptr_message_value = weechat_hdata_path_get_value (
+        relay_irc_backlog_path_message, line_data, -1);
+    ptr_message = (ptr_message_value) ? *ptr_message_value : NULL;
+
+    /* no tag found, or no message? just exit */
+    if ((num_tags <= 0) || !ptr_message)
+        return;
+
+    command = -1;
+    action = 0;
+    ptr_nick = NULL;
+    ptr_nick1 = NULL;
+    ptr_nick2 = NULL;
+    ptr_host = NULL;
+    all_tags = weechat_hashtable_has_key (relay_config_hashtable_irc_backlog_tags,
+                                          "*");
+    for (i = 0; i < num_tags; i++)
+    {
+        ptr_tag_value = weechat_hdata_path_get_value (
+            relay_irc_backlog_path_tags_array, line_data, i);
+        ptr_tag = (ptr_tag_value) ? *ptr_tag_value : NULL;
+        if (ptr_tag)
+        {
+            if (strcmp (ptr_tag, "irc_action") == 0)
+                action = 1;
+            else if (strncmp (ptr_tag, "nick_", 5) == 0)
+                ptr_nick = ptr_tag + 5;
+            else if (strncmp (ptr_tag, "irc_nick1_", 10) == 0)
+                ptr_nick1 = ptr_tag + 10;
+            else if (strncmp (ptr_tag, "irc_nick2_", 10) == 0)
+                ptr_nick2 = ptr_tag + 10;
+            else if (strncmp (ptr_tag, "host_", 5) == 0)
+                ptr_host = ptr_tag + 5;
+            else if ((command < 0)
+                     && (all_tags
+                         || (weechat_hashtable_has_key (relay_config_hashtable_irc_backlog_tags,
+                                                        ptr_tag))))
+            {
+                command = relay_irc_search_backlog_commands_tags (ptr_tag);
+            }
+        }
+    }
+
+    /* not a supported IRC command? */
+    if (command < 0)
+        return;
+
+    /* ignore join/part/quit from self nick */
+    if ((command == RELAY_IRC_CMD_JOIN) || (command == RELAY_IRC_CMD_PART)
+        || (command == RELAY_IRC_CMD_QUIT))
+    {
+        if (localvar_nick && localvar_nick[0]
+            && ptr_nick && (strcmp (ptr_nick, localvar_nick) == 0))
+        {
+            return;
+        }
+    }
+
+    /* fills variables with the line data */
+    if (irc_command)
+        *irc_command = command;
+    if (irc_action)
+        *irc_action = action;
+    if (date)
+        *date = msg_date;
+    if (nick)
+        *nick = ptr_nick;
+    if (nick1)
+        *nick1 = ptr_nick1;
+    if (nick2)
+        *nick2 = ptr_nick2;
+    if (host)
+        *host = ptr_host;
+
+    if ((command == RELAY_IRC_CMD_PRIVMSG) && message)
+    {
+        message_no_color = weechat_string_remove_color (ptr_message, NULL);
+        if (message_no_color)
+        {
+            pos = message_no_color;
+            if (action)
+            {
+                pos = strchr (message_no_color, ' ');
+                if (pos)
+                {
+                    while (pos[0] == ' ')
+                    {
+                        pos++;
+                    }
+                }
+                else
+                    pos = message_no_color;
+            }
+            /*
+             * if server capability "server-time" is NOT enabled, and if the
+             * time format is not empty, add time inside message (before
+             * message)
+             */
+            time_format = weechat_config_string (relay_config_irc_backlog_time_format);
+            if (!server_time && time_format && time_format[0])
+            {
+                tm = localtime (&msg_date);
+                if (strftime (str_time, sizeof (str_time), time_format, tm) == 0)
+                    str_time[0] = '\0';
+                length = strlen (str_time) + strlen (pos) + 1;
+                *message = malloc (length);
+                if (*message)
+                    snprintf (*message, length, "%s%s", str_time, pos);
+            }
+            else
+                *message = strdup (pos);
+            free (message_no_color);
+        }
+    }
+
+    /* if server capability "server-time" is enabled, add an irc tag with time */
+    if (tags && server_time)
+    {
+        gmtime_r (&msg_date, &gm_time);
+        if (strftime (str_time, sizeof (str_time), "%Y-%m-%dT%H:%M:%S",
+                      &gm_time) == 0)
+        {
+            str_time[0] = '\0';
+        }
+        snprintf (str_tag, sizeof (str_tag), "@time=%s.000Z ", str_time);
+        *tags = strdup (str_tag);
+    }
+}
+
+/*
+ * Returns line at a position in index, NULL if the position is not in index.
+ */
+
+struct t_relay_irc_backlog_line *
+relay_irc_backlog_index_line (struct t_relay_irc_backlog_index *index,
+                              int position)
+{
+    if (!index
+        || (position < index->first_position)
+        || (position >= index->first_position + index->num_lines))
+    {
+        return NULL;
+    }
+
+    return &index->lines[index->start + position - index->first_position];
+}
+
+/*
+ * Fills a line in index.
+ */
+
+void
+relay_irc_backlog_index_set_line (struct t_relay_irc_backlog_line *index_line,
+                                  void *line)
+{
+    time_t *ptr_date;
+
+    index_line->line = line;
+    index_line->line_data = relay_irc_backlog_path_pointer (
+        relay_irc_backlog_path_line_data, line);
+    ptr_date = (index_line->line_data) ?
+        weechat_hdata_path_get_value (relay_irc_backlog_path_date,
+                                      index_line->line_data, -1) : NULL;
+    index_line->date = (ptr_date) ? *ptr_date : 0;
+    index_line->irc_command = RELAY_IRC_BACKLOG_CMD_UNKNOWN;
+}
+
+/*
+ * Callback for signals on buffers, used to update indexes.
+ */
+
+int
+relay_irc_backlog_signal_buffer_cb (const void *pointer, void *data,
+                                    const char *signal,
+                                    const char *type_data, void *signal_data)
+{
+    struct t_gui_buffer *ptr_buffer;
+    struct t_relay_irc_backlog_index *ptr_index;
+    void *ptr_line;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) type_data;
+
+    if (!signal_data)
+        return WEECHAT_RC_OK;
+
+    if (strcmp (signal, "buffer_closing") == 0)
+    {
+        /* backlogs may point to buffer, even if it has no index */
+        relay_irc_backlog_buffer_closing (signal_data);
+        relay_irc_backlog_schedule ();
+        return WEECHAT_RC_OK;
+    }
+
+    if (!relay_irc_backlog_indexes_by_buffer)
+    {
+        /* end of a batch: backlogs waiting for it can be started */
+        if (strcmp (signal, "buffer_lines_added") == 0)
+            relay_irc_backlog_schedule ();
+        return WEECHAT_RC_OK;
+    }
+
+    if (strcmp (signal, "buffer_line_added") == 0)
+    {
+        ptr_line = signal_data;
+        ptr_buffer = relay_irc_backlog_path_pointer (
+            relay_irc_backlog_path_line_buffer, ptr_line);
+        ptr_index = weechat_hashtable_get (relay_irc_backlog_indexes_by_buffer,
+                                           ptr_buffer);
+        if (ptr_index)
+            relay_irc_backlog_index_add_line (ptr_index, ptr_line);
+    }
+    else if (strcmp (signal, "buffer_lines_added") == 0)
+    {
+        /* lines inserted by a batch: the index is dropped */
+        ptr_line = weechat_arraylist_get (signal_data, 0);
+        ptr_buffer = relay_irc_backlog_path_pointer (
+            relay_irc_backlog_path_line_buffer, ptr_line);
+        ptr_index = weechat_hashtable_get (relay_irc_backlog_indexes_by_buffer,
+                                           ptr_buffer);
+        if (ptr_index)
+            relay_irc_backlog_index_drop (ptr_index);
+    }
+    else
+    {
+        /* buffer cleared or type changed: the index is dropped */
+        ptr_index = weechat_hashtable_get (relay_irc_backlog_indexes_by_buffer,
+                                           signal_data);
+        if (ptr_index)
+            relay_irc_backlog_index_drop (ptr_index);
+    }
+
+    relay_irc_backlog_schedule ();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Hooks or unhooks signals on buffers: they are hooked while at least one
+ * backlog or index exists (a backlog keeps a pointer to its buffer, even when
+ * it has no index, for example if the buffer is in a batch).
+ */
+
+void
+relay_irc_backlog_hook_buffer_signals ()
+{
+    int i, hook;
+
+    hook = (relay_irc_backlogs || relay_irc_backlog_indexes) ? 1 : 0;
+
+    for (i = 0; relay_irc_backlog_signals[i]; i++)
+    {
+        if (hook && !relay_irc_backlog_hook_signals[i])
+        {
+            relay_irc_backlog_hook_signals[i] = weechat_hook_signal (
+                relay_irc_backlog_signals[i],
+                &relay_irc_backlog_signal_buffer_cb, NULL, NULL);
+        }
+        else if (!hook && relay_irc_backlog_hook_signals[i])
+        {
+            weechat_unhook (relay_irc_backlog_hook_signals[i]);
+            relay_irc_backlog_hook_signals[i] = NULL;
+        }
+    }
+}
+
+/*
+ * Creates a new index for a buffer (the index is empty and is extended on
+ * demand).
+ *
+ * Returns pointer to new index, NULL if error.
+ */
+
+struct t_relay_irc_backlog_index *
+relay_irc_backlog_index_new (struct t_gui_buffer *buffer)
+{
+    struct t_relay_irc_backlog_index *new_index;
+    int lines_count;
+
+    if (!relay_irc_backlog_indexes_by_buffer)
+    {
+        relay_irc_backlog_indexes_by_buffer = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_POINTER,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!relay_irc_backlog_indexes_by_buffer)
+            return NULL;
+    }
+
+    new_index = malloc (sizeof (*new_index));
+    if (!new_index)
+        return NULL;
+
+    lines_count = relay_irc_backlog_path_integer (
+        relay_irc_backlog_path_buffer_lines_count, buffer);
+
+    /*
+     * the index is filled from the end: all the lines currently in buffer
+     * fit before "start", new lines are added after
+     */
+    new_index->size = lines_count + 64;
+    new_index->lines = malloc (new_index->size * sizeof (new_index->lines[0]));
+    if (!new_index->lines)
+    {
+        free (new_index);
+        return NULL;
+    }
+    new_index->buffer = buffer;
+    new_index->start = lines_count;
+    new_index->num_lines = 0;
+    new_index->first_position = 0;
+    new_index->complete = (lines_count == 0) ? 1 : 0;
+    new_index->lines_count = lines_count;
+    new_index->refcount = 0;
+
+    new_index->prev_index = last_relay_irc_backlog_index;
+    new_index->next_index = NULL;
+    if (last_relay_irc_backlog_index)
+        last_relay_irc_backlog_index->next_index = new_index;
+    else
+        relay_irc_backlog_indexes = new_index;
+    last_relay_irc_backlog_index = new_index;
+
+    weechat_hashtable_set (relay_irc_backlog_indexes_by_buffer,
+                           buffer, new_index);
+
+    relay_irc_backlog_hook_buffer_signals ();
+
+    return new_index;
+}
+
+/*
+ * Checks if an index is still valid: buffer not in a batch, same number of
+ * lines and same last line.
+ *
+ * Returns:
+ *   1: index is valid
+ *   0: index is not valid (it must be dropped)
+ */
+
+int
+relay_irc_backlog_index_valid (struct t_relay_irc_backlog_index *index)
+{
+    struct t_relay_irc_backlog_line *ptr_last;
+
+    if (!index || !index->buffer)
+        return 0;
+
+    /* in a batch, lines can be inserted/removed without any signal */
+    if (relay_irc_backlog_path_integer (relay_irc_backlog_path_buffer_batch,
+                                        index->buffer) > 0)
+    {
+        return 0;
+    }
+
+    if (relay_irc_backlog_path_integer (relay_irc_backlog_path_buffer_lines_count,
+                                        index->buffer) != index->lines_count)
+    {
+        return 0;
+    }
+
+    if (index->num_lines > 0)
+    {
+        ptr_last = &index->lines[index->start + index->num_lines - 1];
+        if (ptr_last->line != relay_irc_backlog_path_pointer (
+                relay_irc_backlog_path_buffer_last_line, index->buffer))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Removes an index from list of indexes.
+ */
+
+void
+relay_irc_backlog_index_remove_from_list (struct t_relay_irc_backlog_index *index)
+{
+    if (!index->buffer)
+        return;
+
+    weechat_hashtable_remove (relay_irc_backlog_indexes_by_buffer,
+                              index->buffer);
+
+    if (last_relay_irc_backlog_index == index)
+        last_relay_irc_backlog_index = index->prev_index;
+    if (index->prev_index)
+        (index->prev_index)->next_index = index->next_index;
+    else
+        relay_irc_backlog_indexes = index->next_index;
+    if (index->next_index)
+        (index->next_index)->prev_index = index->prev_index;
+
+    index->buffer = NULL;
+    index->prev_index = NULL;
+    index->next_index = NULL;
+
+    relay_irc_backlog_hook_buffer_signals ();
+}
+
+/*
+ * Drops an index: it is removed from list and backlogs using it are restarted
+ * (backlogs already built can not be reused any more).
+ *
+ * Lines in index are not read any more, since some of them may have been
+ * freed.
+ */
+
+void
+relay_irc_backlog_index_drop (struct t_relay_irc_backlog_index *index)
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+
+    if (!index || !index->buffer)
+        return;
+
+    index->refcount++;
+
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        if (ptr_backlog->index == index)
+            relay_irc_backlog_restart (ptr_backlog);
+    }
+
+    relay_irc_backlog_index_remove_from_list (index);
+    index->num_lines = 0;
+
+    relay_irc_backlog_index_unref (index);
+}
+
+/*
+ * Gets index on lines of a buffer (a new index is created if needed).
+ *
+ * The reference count of index is incremented: the index must be released
+ * with relay_irc_backlog_index_unref.
+ *
+ * Returns pointer to index, NULL if error or if buffer is in a batch
+ * (lines can not be indexed until the end of batch).
+ */
+
+struct t_relay_irc_backlog_index *
+relay_irc_backlog_index_get (struct t_gui_buffer *buffer)
+{
+    struct t_relay_irc_backlog_index *ptr_index;
+
+    if (!buffer || !relay_irc_backlog_compile_paths ())
+        return NULL;
+
+    ptr_index = (relay_irc_backlog_indexes_by_buffer) ?
+        weechat_hashtable_get (relay_irc_backlog_indexes_by_buffer,
+                               buffer) : NULL;
+    if (ptr_index && !relay_irc_backlog_index_valid (ptr_index))
+    {
+        relay_irc_backlog_index_drop (ptr_index);
+        ptr_index = NULL;
+    }
+
+    if (!ptr_index)
+    {
+        if (relay_irc_backlog_path_integer (relay_irc_backlog_path_buffer_batch,
+                                            buffer) > 0)
+        {
+            return NULL;
+        }
+        ptr_index = relay_irc_backlog_index_new (buffer);
+        if (!ptr_index)
+            return NULL;
+    }
+
+    ptr_index->refcount++;
+
+    return ptr_index;
+}
+
+/*
+ * Extends an index with the line before the oldest line in index.
+ *
+ * Returns:
+ *   1: one line added in index
+ *   0: no line added (first line of buffer already in index)
+ */
+
+int
+relay_irc_backlog_index_extend (struct t_relay_irc_backlog_index *index)
+{
+    void *ptr_line;
+
+    if (!index || !index->buffer || index->complete || (index->start <= 0))
+        return 0;
+
+    if (index->num_lines > 0)
+    {
+        ptr_line = relay_irc_backlog_path_pointer (
+            relay_irc_backlog_path_line_prev_line,
+            index->lines[index->start].line);
+    }
+    else
+    {
+        ptr_line = relay_irc_backlog_path_pointer (
+            relay_irc_backlog_path_buffer_last_line, index->buffer);
+    }
+
+    if (!ptr_line)
+    {
+        index->complete = 1;
+        return 0;
+    }
+
+    index->start--;
+    index->num_lines++;
+    index->first_position--;
+    relay_irc_backlog_index_set_line (&index->lines[index->start], ptr_line);
+
+    if (!relay_irc_backlog_path_pointer (relay_irc_backlog_path_line_prev_line,
+                                         ptr_line))
+    {
+        index->complete = 1;
+    }
+
+    return 1;
+}
+
+/*
+ * Adds a line in index (line added at the end of buffer).
+ *
+ * Lines removed at beginning of buffer (according to history limits) are
+ * removed from index.
+ */
+
+void
+relay_irc_backlog_index_add_line (struct t_relay_irc_backlog_index *index,
+                                  void *line)
+{
+    struct t_relay_irc_backlog_line *new_lines;
+    int lines_count, removed, lines_before, new_size;
+
+    lines_count = relay_irc_backlog_path_integer (
+        relay_irc_backlog_path_buffer_lines_count, index->buffer);
+
+    removed = index->lines_count + 1 - lines_count;
+    if ((removed < 0)
+        || (line != relay_irc_backlog_path_pointer (
+                relay_irc_backlog_path_buffer_last_line, index->buffer)))
+    {
+        relay_irc_backlog_index_drop (index);
+        return;
+    }
+
+    /* remove lines removed from buffer that were in index */
+    lines_before = (index->complete) ?
+        0 : index->lines_count - index->num_lines;
+    if (removed > lines_before)
+    {
+        removed -= lines_before;
+        if (removed > index->num_lines)
+        {
+            relay_irc_backlog_index_drop (index);
+            return;
+        }
+        index->start += removed;
+        index->num_lines -= removed;
+        index->first_position += removed;
+        index->complete = 1;
+    }
+
+    /* make room for the new line */
+    if (index->start + index->num_lines >= index->size)
+    {
+        if (index->complete && (index->start >= index->size / 2))
+        {
+            memmove (index->lines, index->lines + index->start,
+                     index->num_lines * sizeof (index->lines[0]));
+            index->start = 0;
+        }
+        else
+        {
+            new_size = index->size * 2;
+            new_lines = realloc (index->lines,
+                                 new_size * sizeof (index->lines[0]));
+            if (!new_lines)
+            {
+                relay_irc_backlog_index_drop (index);
+                return;
+            }
+            index->lines = new_lines;
+            index->size = new_size;
+        }
+    }
+
+    relay_irc_backlog_index_set_line (
+        &index->lines[index->start + index->num_lines], line);
+    index->num_lines++;
+    index->lines_count = lines_count;
+}
+
+/*
+ * Searches for the first line in index with a date greater than or equal to
+ * "date" (lines are assumed to be sorted by date).
+ *
+ * Returns position of line found, position after the last line of index if
+ * all lines are older.
+ */
+
+int
+relay_irc_backlog_index_search_date (struct t_relay_irc_backlog_index *index,
+                                     time_t date)
+{
+    int low, high, middle;
+
+    if (!index)
+        return 0;
+
+    low = 0;
+    high = index->num_lines;
+    while (low < high)
+    {
+        middle = low + ((high - low) / 2);
+        if (index->lines[index->start + middle].date < date)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return index->first_position + low;
+}
+
+/*
+ * Decrements the reference count of an index and frees it if it's not used
+ * any more.
+ */
+
+void
+relay_irc_backlog_index_unref (struct t_relay_irc_backlog_index *index)
+{
+    if (!index)
+        return;
+
+    index->refcount--;
+    if (index->refcount > 0)
+        return;
+
+    relay_irc_backlog_index_remove_from_list (index);
+
+    if (index->lines)
+        free (index->lines);
+
+    free (index);
+}
+
+/*
+ * Gets max length of IRC messages for an IRC server (option
+ * "split_msg_max_length").
+ */
+
+int
+relay_irc_backlog_get_split_max_length (const char *server)
+{
+    char option_name[1024];
+    struct t_config_option *ptr_option;
+
+    snprintf (option_name, sizeof (option_name),
+              "irc.server.%s.split_msg_max_length", server);
+    ptr_option = weechat_config_get (option_name);
+    if (!ptr_option || weechat_config_option_is_null (ptr_option))
+        ptr_option = weechat_config_get ("irc.server_default.split_msg_max_length");
+
+    return (ptr_option) ? weechat_config_integer (ptr_option) : 512;
+}
+
+/*
+ * Searches for a backlog that can be reused: same parameters and no line
+ * added in buffer since the backlog was started.
+ *
+ * Returns pointer to backlog found, NULL if not found.
+ */
+
+struct t_relay_irc_backlog *
+relay_irc_backlog_search (struct t_gui_buffer *buffer, const char *server,
+                          const char *channel, int server_time,
+                          time_t date_min, const char *localvar_nick,
+                          int max_number, int since_last_message)
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        if ((ptr_backlog->buffer == buffer)
+            && ptr_backlog->index
+            && (ptr_backlog->server_time == server_time)
+            && (ptr_backlog->date_min == date_min)
+            && (ptr_backlog->max_number == max_number)
+            && (ptr_backlog->since_last_message == since_last_message)
+            && (strcmp (ptr_backlog->server, server) == 0)
+            && (strcmp (ptr_backlog->channel, channel) == 0)
+            && ((!ptr_backlog->localvar_nick && !localvar_nick)
+                || (ptr_backlog->localvar_nick && localvar_nick
+                    && (strcmp (ptr_backlog->localvar_nick,
+                                localvar_nick) == 0))))
+        {
+            if (!relay_irc_backlog_index_valid (ptr_backlog->index))
+            {
+                relay_irc_backlog_index_drop (ptr_backlog->index);
+                continue;
+            }
+            if (ptr_backlog->end == ptr_backlog->index->first_position
+                + ptr_backlog->index->num_lines)
+            {
+                return ptr_backlog;
+            }
+        }
+    }
+
+    /* backlog not found */
+    return NULL;
+}
+
+/*
+ * Searches in index the position after the last line to send in a restarted
+ * backlog: lines added in buffer after the first start are not sent (clients
+ * receive them as pending messages).
+ *
+ * The index is searched from the newest line, until the line saved at first
+ * start or an older line (if this line has been removed from buffer).
+ *
+ * Returns position after the last line to send.
+ */
+
+int
+relay_irc_backlog_search_end (struct t_relay_irc_backlog *backlog)
+{
+    struct t_relay_irc_backlog_line *ptr_line;
+    int position;
+
+    position = backlog->index->first_position + backlog->index->num_lines;
+
+    /* buffer was empty at first start: no lines to send */
+    if (!backlog->end_line)
+        return position;
+
+    while (1)
+    {
+        if (position - 1 < backlog->index->first_position)
+            relay_irc_backlog_index_extend (backlog->index);
+        ptr_line = relay_irc_backlog_index_line (backlog->index, position - 1);
+        if (!ptr_line)
+            break;
+        if (((ptr_line->line == backlog->end_line)
+             && (ptr_line->date == backlog->end_date))
+            || (ptr_line->date < backlog->end_date))
+        {
+            break;
+        }
+        position--;
+    }
+
+    return (ptr_line) ? position : backlog->index->first_position;
+}
+
+/*
+ * Starts a backlog: gets index and sets the last line to send.
+ *
+ * On first start, the last line of buffer is saved: if the backlog is
+ * restarted (with a new index), lines added after this one are not sent.
+ *
+ * If the buffer is in a batch, the backlog is not started (it will be started
+ * later).
+ */
+
+void
+relay_irc_backlog_start (struct t_relay_irc_backlog *backlog)
+{
+    struct t_relay_irc_backlog_line *ptr_line;
+
+    if (backlog->index || !backlog->buffer)
+        return;
+
+    backlog->index = relay_irc_backlog_index_get (backlog->buffer);
+    if (!backlog->index)
+        return;
+
+    backlog->status = RELAY_IRC_BACKLOG_STATUS_SELECT;
+    if (backlog->end_saved)
+    {
+        backlog->end = relay_irc_backlog_search_end (backlog);
+    }
+    else
+    {
+        backlog->end = backlog->index->first_position
+            + backlog->index->num_lines;
+        if (backlog->index->num_lines == 0)
+            relay_irc_backlog_index_extend (backlog->index);
+        ptr_line = relay_irc_backlog_index_line (backlog->index,
+                                                 backlog->end - 1);
+        backlog->end_line = (ptr_line) ? ptr_line->line : NULL;
+        backlog->end_date = (ptr_line) ? ptr_line->date : 0;
+        backlog->end_saved = 1;
+    }
+    backlog->position = backlog->end;
+    backlog->count = 0;
+
+    /* if index already has older lines, search first line with the date */
+    backlog->lowest = -1;
+    if ((backlog->date_min > 0) && (backlog->index->num_lines > 0)
+        && (backlog->index->lines[backlog->index->start].date < backlog->date_min))
+    {
+        backlog->lowest = relay_irc_backlog_index_search_date (
+            backlog->index, backlog->date_min);
+    }
+
+    /* buffer was empty at first start: nothing to send */
+    if (!backlog->end_line)
+        backlog->lowest = backlog->end;
+}
+
+/*
+ * Restarts a backlog not yet built (its index has been dropped): it will use
+ * a new index.
+ *
+ * The last line to send is the one saved at first start, so lines added in
+ * buffer since then are not sent twice to client (in backlog and as pending
+ * messages).
+ *
+ * A backlog already built is kept for clients waiting for it, but can not be
+ * reused any more.
+ */
+
+void
+relay_irc_backlog_restart (struct t_relay_irc_backlog *backlog)
+{
+    relay_irc_backlog_index_unref (backlog->index);
+    backlog->index = NULL;
+
+    if (backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+        return;
+
+    if (backlog->messages)
+    {
+        weechat_string_dyn_free (backlog->messages, 1);
+        backlog->messages = NULL;
+    }
+    backlog->status = RELAY_IRC_BACKLOG_STATUS_SELECT;
+    backlog->position = -1;
+    backlog->lowest = -1;
+    backlog->end = -1;
+    backlog->count = 0;
+}
+
+/*
+ * Gets a backlog for a channel: a backlog with same parameters is reused if
+ * no line was added in buffer since it was started, otherwise a new backlog
+ * is created.
+ *
+ * The reference count of backlog is incremented: the backlog must be released
+ * with relay_irc_backlog_unref.
+ *
+ * Returns pointer to backlog, NULL if error.
+ */
+
+struct t_relay_irc_backlog *
+relay_irc_backlog_get (struct t_gui_buffer *buffer, const char *server,
+                       const char *channel, int server_time, time_t date_min)
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+    const char *localvar_nick;
+    int max_number, since_last_message;
+
+    if (!buffer || !server || !channel)
+        return NULL;
+
+    relay_irc_backlog_expire ();
+
+    localvar_nick = weechat_buffer_get_string (buffer, "localvar_nick");
+    max_number = weechat_config_integer (relay_config_irc_backlog_max_number);
+    since_last_message = weechat_config_boolean (
+        relay_config_irc_backlog_since_last_message);
+
+    ptr_backlog = relay_irc_backlog_search (buffer, server, channel,
+                                            server_time, date_min,
+                                            localvar_nick, max_number,
+                                            since_last_message);
+    if (ptr_backlog)
+    {
+        ptr_backlog->refcount++;
+        ptr_backlog->last_used = time (NULL);
+        return ptr_backlog;
+    }
+
+    ptr_backlog = malloc (sizeof (*ptr_backlog));
+    if (!ptr_backlog)
+        return NULL;
+
+    ptr_backlog->buffer = buffer;
+    ptr_backlog->server = strdup (server);
+    ptr_backlog->channel = strdup (channel);
+    ptr_backlog->server_time = server_time;
+    ptr_backlog->date_min = date_min;
+    ptr_backlog->localvar_nick = (localvar_nick) ? strdup (localvar_nick) : NULL;
+    ptr_backlog->max_number = max_number;
+    ptr_backlog->since_last_message = since_last_message;
+    ptr_backlog->split_max_length = relay_irc_backlog_get_split_max_length (
+        server);
+    ptr_backlog->index = NULL;
+    ptr_backlog->status = RELAY_IRC_BACKLOG_STATUS_SELECT;
+    ptr_backlog->position = -1;
+    ptr_backlog->lowest = -1;
+    ptr_backlog->end = -1;
+    ptr_backlog->end_saved = 0;
+    ptr_backlog->end_line = NULL;
+    ptr_backlog->end_date = 0;
+    ptr_backlog->count = 0;
+    ptr_backlog->messages = NULL;
+    ptr_backlog->data = NULL;
+    ptr_backlog->refcount = 1;
+    ptr_backlog->last_used = time (NULL);
+
+    ptr_backlog->prev_backlog = last_relay_irc_backlog;
+    ptr_backlog->next_backlog = NULL;
+    if (last_relay_irc_backlog)
+        last_relay_irc_backlog->next_backlog = ptr_backlog;
+    else
+        relay_irc_backlogs = ptr_backlog;
+    last_relay_irc_backlog = ptr_backlog;
+
+    relay_irc_backlog_hook_buffer_signals ();
+
+    relay_irc_backlog_start (ptr_backlog);
+
+    return ptr_backlog;
+}
+
+/*
+ * Adds an IRC message in a backlog, split if it is too long.
+ */
+
+void
+relay_irc_backlog_add_message (struct t_relay_irc_backlog *backlog,
+                               const char *format, ...)
+{
+    int number;
+    char *pos, hash_key[32];
+    const char *ptr_msg, *str_message;
+    struct t_hashtable *hashtable_in, *hashtable_out;
+
+    if (!backlog->messages)
+        return;
+
+    weechat_va_format (format);
+    if (!vbuffer)
+        return;
+
+    pos = strchr (vbuffer, '\r');
+    if (pos)
+        pos[0] = '\0';
+    pos = strchr (vbuffer, '\n');
+    if (pos)
+        pos[0] = '\0';
+
+    /* length of message without tags */
+    ptr_msg = vbuffer;
+    if (ptr_msg[0] == '@')
+    {
+        pos = strchr (ptr_msg, ' ');
+        if (pos)
+            ptr_msg = pos + 1;
+    }
+
+    /*
+     * short message (with a small margin for separators counted by
+     * irc_message_split): no need to split it
+     */
+    if ((backlog->split_max_length == 0)
+        || ((int)strlen (ptr_msg) + 16 <= backlog->split_max_length))
+    {
+        weechat_string_dyn_concat (backlog->messages, vbuffer, -1);
+        weechat_string_dyn_concat (backlog->messages, "\r\n", -1);
+        free (vbuffer);
+        return;
+    }
+
+    hashtable_in = weechat_hashtable_new (32,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          NULL, NULL);
+    if (hashtable_in)
+    {
+        weechat_hashtable_set (hashtable_in, "server", backlog->server);
+        weechat_hashtable_set (hashtable_in, "message", vbuffer);
+        hashtable_out = weechat_info_get_hashtable ("irc_message_split",
+                                                    hashtable_in);
+        if (hashtable_out)
+        {
+            number = 1;
+            while (1)
+            {
+                snprintf (hash_key, sizeof (hash_key), "msg%d", number);
+                str_message = weechat_hashtable_get (hashtable_out, hash_key);
+                if (!str_message)
+                    break;
+                weechat_string_dyn_concat (backlog->messages, str_message, -1);
+                weechat_string_dyn_concat (backlog->messages, "\r\n", -1);
+                number++;
+            }
+            weechat_hashtable_free (hashtable_out);
+        }
+        weechat_hashtable_free (hashtable_in);
+    }
+
+    free (vbuffer);
+}
+
+/*
+ * Starts the formatting of IRC messages in a backlog, from a position.
+ */
+
+void
+relay_irc_backlog_start_format (struct t_relay_irc_backlog *backlog,
+                                int position)
+{
+    backlog->status = RELAY_IRC_BACKLOG_STATUS_FORMAT;
+    backlog->position = position;
+    backlog->messages = weechat_string_dyn_alloc (4096);
+}
+
+/*
+ * Ends a backlog: IRC messages are ready to be sent to clients.
+ */
+
+void
+relay_irc_backlog_finish (struct t_relay_irc_backlog *backlog)
+{
+    char *buffer;
+    int size;
+
+    if (backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+        return;
+
+    if (backlog->messages)
+    {
+        size = strlen (*(backlog->messages));
+        buffer = weechat_string_dyn_free (backlog->messages, 0);
+        backlog->messages = NULL;
+        if (buffer)
+        {
+            backlog->data = relay_client_data_new (buffer, size, 0);
+            if (!backlog->data)
+                free (buffer);
+        }
+    }
+    backlog->status = RELAY_IRC_BACKLOG_STATUS_DONE;
+    backlog->last_used = time (NULL);
+}
+
+/*
+ * Selects one line (from newest to oldest) to find the first line to send.
+ */
+
+void
+relay_irc_backlog_select_line (struct t_relay_irc_backlog *backlog)
+{
+    struct t_relay_irc_backlog_line *ptr_line;
+    const char *ptr_nick;
+    int position, irc_command;
+
+    position = backlog->position - 1;
+
+    /* lines before this one have a date < date_min */
+    if ((backlog->lowest >= 0) && (position < backlog->lowest))
+    {
+        relay_irc_backlog_start_format (backlog, backlog->position);
+        return;
+    }
+
+    if (position < backlog->index->first_position)
+        relay_irc_backlog_index_extend (backlog->index);
+
+    ptr_line = relay_irc_backlog_index_line (backlog->index, position);
+    if (!ptr_line)
+    {
+        /* beginning of buffer reached */
+        relay_irc_backlog_start_format (backlog, backlog->position);
+        return;
+    }
+
+    ptr_nick = NULL;
+    if ((ptr_line->irc_command == RELAY_IRC_BACKLOG_CMD_UNKNOWN)
+        || backlog->since_last_message)
+    {
+        relay_irc_get_line_info (0, backlog->localvar_nick,
+                                 ptr_line->line_data,
+                                 &irc_command,
+                                 NULL, /* irc_action */
+                                 NULL, /* date */
+                                 &ptr_nick,
+                                 NULL, /* nick1 */
+                                 NULL, /* nick2 */
+                                 NULL, /* host */
+                                 NULL, /* tags */
+                                 NULL); /* message */
+        ptr_line->irc_command = irc_command;
+    }
+
+    if (ptr_line->irc_command >= 0)
+    {
+        /* if we have reached max minutes, stop */
+        if ((backlog->date_min > 0) && (ptr_line->date < backlog->date_min))
+        {
+            relay_irc_backlog_start_format (backlog, backlog->position);
+            return;
+        }
+        backlog->count++;
+    }
+
+    /* if we have reached max number of messages, stop */
+    if ((backlog->max_number > 0) && (backlog->count > backlog->max_number))
+    {
+        relay_irc_backlog_start_format (backlog, backlog->position);
+        return;
+    }
+
+    if (backlog->since_last_message
+        && backlog->localvar_nick && backlog->localvar_nick[0]
+        && ptr_nick && (strcmp (ptr_nick, backlog->localvar_nick) == 0))
+    {
+        /*
+         * stop when we find a line sent by the current nick
+         * (and include this line)
+         */
+        relay_irc_backlog_start_format (backlog, position);
+        return;
+    }
+
+    backlog->position = position;
+}
+
+/*
+ * Formats one line (from oldest to newest) as IRC message.
+ */
+
+void
+relay_irc_backlog_format_line (struct t_relay_irc_backlog *backlog)
+{
+    struct t_relay_irc_backlog_line *ptr_line;
+    char *tags, *message;
+    const char *ptr_nick, *ptr_nick1, *ptr_nick2, *ptr_host;
+    int irc_command, irc_action;
+
+    /* lines removed from buffer are skipped */
+    if (backlog->position < backlog->index->first_position)
+        backlog->position = backlog->index->first_position;
+
+    if (backlog->position >= backlog->end)
+    {
+        relay_irc_backlog_finish (backlog);
+        return;
+    }
+
+    ptr_line = relay_irc_backlog_index_line (backlog->index,
+                                             backlog->position);
+    backlog->position++;
+    if (!ptr_line || (ptr_line->irc_command == -1))
+        return;
+
+    relay_irc_get_line_info (backlog->server_time, backlog->localvar_nick,
+                             ptr_line->line_data,
+                             &irc_command,
+                             &irc_action,
+                             NULL, /* date */
+                             &ptr_nick,
+                             &ptr_nick1,
+                             &ptr_nick2,
+                             &ptr_host,
+                             &tags,
+                             &message);
+    switch (irc_command)
+    {
+        case RELAY_IRC_CMD_JOIN:
+            relay_irc_backlog_add_message (backlog,
+                                           "%s:%s%s%s JOIN :%s",
+                                           (tags) ? tags : "",
+                                           ptr_nick,
+                                           (ptr_host) ? "!" : "",
+                                           (ptr_host) ? ptr_host : "",
+                                           backlog->channel);
+            break;
+        case RELAY_IRC_CMD_PART:
+            relay_irc_backlog_add_message (backlog,
+                                           "%s:%s%s%s PART %s",
+                                           (tags) ? tags : "",
+                                           ptr_nick,
+                                           (ptr_host) ? "!" : "",
+                                           (ptr_host) ? ptr_host : "",
+                                           backlog->channel);
+            break;
+        case RELAY_IRC_CMD_QUIT:
+            relay_irc_backlog_add_message (backlog,
+                                           "%s:%s%s%s QUIT",
+                                           (tags) ? tags : "",
+                                           ptr_nick,
+                                           (ptr_host) ? "!" : "",
+                                           (ptr_host) ? ptr_host : "");
+            break;
+        case RELAY_IRC_CMD_NICK:
+            if (ptr_nick1 && ptr_nick2)
+            {
+                relay_irc_backlog_add_message (backlog,
+                                               "%s:%s NICK :%s",
+                                               (tags) ? tags : "",
+                                               ptr_nick1,
+                                               ptr_nick2);
+            }
+            break;
+        case RELAY_IRC_CMD_PRIVMSG:
+            if (ptr_nick && message)
+            {
+                relay_irc_backlog_add_message (backlog,
+                                               "%s:%s%s%s PRIVMSG %s :%s%s%s",
+                                               (tags) ? tags : "",
+                                               ptr_nick,
+                                               (ptr_host) ? "!" : "",
+                                               (ptr_host) ? ptr_host : "",
+                                               backlog->channel,
+                                               (irc_action) ? "\01ACTION " : "",
+                                               message,
+                                               (irc_action) ? "\01": "");
+            }
+            break;
+        case RELAY_IRC_NUM_CMD:
+            /* make C compiler happy */
+            break;
+    }
+    if (tags)
+        free (tags);
+    if (message)
+        free (message);
+}
+
+/*
+ * Builds a backlog, reading at most "max_lines" lines of buffer.
+ *
+ * Returns number of lines read.
+ */
+
+int
+relay_irc_backlog_run (struct t_relay_irc_backlog *backlog, int max_lines)
+{
+    int lines;
+
+    if (!backlog || (backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE))
+        return 0;
+
+    if (!backlog->buffer)
+    {
+        relay_irc_backlog_finish (backlog);
+        return 0;
+    }
+
+    if (backlog->index && !relay_irc_backlog_index_valid (backlog->index))
+        relay_irc_backlog_index_drop (backlog->index);
+
+    if (!backlog->index)
+    {
+        relay_irc_backlog_start (backlog);
+        if (!backlog->index)
+            return 0;
+    }
+
+    lines = 0;
+    while ((lines < max_lines)
+           && (backlog->status != RELAY_IRC_BACKLOG_STATUS_DONE))
+    {
+        if (backlog->status == RELAY_IRC_BACKLOG_STATUS_SELECT)
+            relay_irc_backlog_select_line (backlog);
+        else
+            relay_irc_backlog_format_line (backlog);
+        lines++;
+    }
+
+    return lines;
+}
+
+/*
+ * Frees a backlog and removes it from list.
+ */
+
+void
+relay_irc_backlog_free (struct t_relay_irc_backlog *backlog)
+{
+    if (!backlog)
+        return;
+
+    if (last_relay_irc_backlog == backlog)
+        last_relay_irc_backlog = backlog->prev_backlog;
+    if (backlog->prev_backlog)
+        (backlog->prev_backlog)->next_backlog = backlog->next_backlog;
+    else
+        relay_irc_backlogs = backlog->next_backlog;
+    if (backlog->next_backlog)
+        (backlog->next_backlog)->prev_backlog = backlog->prev_backlog;
+
+    if (backlog->server)
+        free (backlog->server);
+    if (backlog->channel)
+        free (backlog->channel);
+    if (backlog->localvar_nick)
+        free (backlog->localvar_nick);
+    relay_irc_backlog_index_unref (backlog->index);
+    if (backlog->messages)
+        weechat_string_dyn_free (backlog->messages, 1);
+    relay_client_data_unref (backlog->data);
+
+    free (backlog);
+
+    relay_irc_backlog_hook_buffer_signals ();
+}
+
+/*
+ * Decrements the reference count of a backlog: a backlog built is kept in
+ * cache (it may be sent to other clients), other backlogs are freed.
+ */
+
+void
+relay_irc_backlog_unref (struct t_relay_irc_backlog *backlog)
+{
+    if (!backlog)
+        return;
+
+    backlog->refcount--;
+    if (backlog->refcount > 0)
+        return;
+
+    if ((backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE) && backlog->index)
+        backlog->last_used = time (NULL);
+    else
+        relay_irc_backlog_free (backlog);
+}
+
+/*
+ * Frees backlogs in cache not used for some time (or that can not be reused).
+ */
+
+void
+relay_irc_backlog_expire ()
+{
+    struct t_relay_irc_backlog *ptr_backlog, *ptr_next_backlog;
+    time_t current_time;
+
+    current_time = time (NULL);
+
+    ptr_backlog = relay_irc_backlogs;
+    while (ptr_backlog)
+    {
+        ptr_next_backlog = ptr_backlog->next_backlog;
+
+        if ((ptr_backlog->refcount <= 0)
+            && (!ptr_backlog->index
+                || (current_time >= ptr_backlog->last_used + RELAY_IRC_BACKLOG_CACHE_DELAY)))
+        {
+            relay_irc_backlog_free (ptr_backlog);
+        }
+
+        ptr_backlog = ptr_next_backlog;
+    }
+}
+
+/*
+ * Clears cache of backlogs (called when an option of backlog is changed):
+ * backlogs not yet built are restarted and backlogs built can not be reused
+ * any more.
+ */
+
+void
+relay_irc_backlog_clear_cache ()
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        relay_irc_backlog_restart (ptr_backlog);
+    }
+
+    relay_irc_backlog_expire ();
+    relay_irc_backlog_schedule ();
+}
+
+/*
+ * Called when a buffer is closing: backlogs of buffer are ended with the
+ * messages already built and the index is dropped.
+ */
+
+void
+relay_irc_backlog_buffer_closing (struct t_gui_buffer *buffer)
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+    struct t_relay_irc_backlog_index *ptr_index;
+    int completed;
+
+    completed = 0;
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        if (ptr_backlog->buffer != buffer)
+            continue;
+        if (ptr_backlog->status != RELAY_IRC_BACKLOG_STATUS_DONE)
+        {
+            relay_irc_backlog_finish (ptr_backlog);
+            completed = 1;
+        }
+        relay_irc_backlog_index_unref (ptr_backlog->index);
+        ptr_backlog->index = NULL;
+        ptr_backlog->buffer = NULL;
+    }
+
+    ptr_index = (relay_irc_backlog_indexes_by_buffer) ?
+        weechat_hashtable_get (relay_irc_backlog_indexes_by_buffer,
+                               buffer) : NULL;
+    if (ptr_index)
+        relay_irc_backlog_index_drop (ptr_index);
+
+    if (completed)
+        relay_irc_backlog_flush_all ();
+}
+
+/*
+ * Sends a backlog built to a client.
+ */
+
+void
+relay_irc_backlog_send (struct t_relay_client *client,
+                        struct t_relay_irc_backlog *backlog)
+{
+    const char *ptr_data, *ptr_end, *pos;
+    char *message;
+    int length;
+
+    if (!backlog->data)
+        return;
+
+    if (client->websocket != 2)
+    {
+        relay_client_send_data (client, RELAY_CLIENT_MSG_STANDARD,
+                                backlog->data, NULL);
+        return;
+    }
+
+    /* with websocket, each IRC message is sent in a frame */
+    ptr_data = backlog->data->buffer;
+    ptr_end = backlog->data->buffer + backlog->data->size;
+    while (ptr_data < ptr_end)
+    {
+        pos = strstr (ptr_data, "\r\n");
+        length = (pos) ? pos + 2 - ptr_data : ptr_end - ptr_data;
+        message = weechat_strndup (ptr_data, length);
+        if (message)
+        {
+            relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
+                               message, length, NULL);
+            free (message);
+        }
+        ptr_data += length;
+    }
+}
+
+/*
+ * Adds a backlog or a message in messages waiting to be sent to a client.
+ *
+ * The reference to backlog is given to the client (it is released when the
+ * backlog is sent).
+ */
+
+void
+relay_irc_backlog_add_pending (struct t_relay_client *client,
+                               struct t_relay_irc_backlog *backlog,
+                               const char *message, int size)
+{
+    struct t_relay_irc_backlog_pending *new_pending;
+
+    if (!client || !client->protocol_data || (!backlog && !message))
+        return;
+
+    new_pending = malloc (sizeof (*new_pending));
+    if (!new_pending)
+    {
+        relay_irc_backlog_unref (backlog);
+        return;
+    }
+
+    new_pending->backlog = backlog;
+    new_pending->message = NULL;
+    new_pending->size = 0;
+    if (!backlog)
+    {
+        new_pending->message = malloc (size + 1);
+        if (!new_pending->message)
+        {
+            free (new_pending);
+            return;
+        }
+        memcpy (new_pending->message, message, size);
+        new_pending->message[size] = '\0';
+        new_pending->size = size;
+    }
+    new_pending->next_pending = NULL;
+
+    if (RELAY_IRC_DATA(client, last_backlog_pending))
+        (RELAY_IRC_DATA(client, last_backlog_pending))->next_pending = new_pending;
+    else
+        RELAY_IRC_DATA(client, backlog_pending) = new_pending;
+    RELAY_IRC_DATA(client, last_backlog_pending) = new_pending;
+}
+
+/*
+ * Frees a message waiting to be sent.
+ */
+
+void
+relay_irc_backlog_pending_free (struct t_relay_irc_backlog_pending *pending)
+{
+    relay_irc_backlog_unref (pending->backlog);
+    if (pending->message)
+        free (pending->message);
+    free (pending);
+}
+
+/*
+ * Sends messages waiting to a client, until a backlog not yet built is found.
+ */
+
+void
+relay_irc_backlog_flush_pending (struct t_relay_client *client)
+{
+    struct t_relay_irc_backlog_pending *ptr_pending;
+
+    if (!client || !client->protocol_data)
+        return;
+
+    while (client->protocol_data
+           && RELAY_IRC_DATA(client, backlog_pending))
+    {
+        ptr_pending = RELAY_IRC_DATA(client, backlog_pending);
+        if (ptr_pending->backlog
+            && (ptr_pending->backlog->status != RELAY_IRC_BACKLOG_STATUS_DONE))
+        {
+            break;
+        }
+
+        /* remove message from list before sending it */
+        RELAY_IRC_DATA(client, backlog_pending) = ptr_pending->next_pending;
+        if (!RELAY_IRC_DATA(client, backlog_pending))
+            RELAY_IRC_DATA(client, last_backlog_pending) = NULL;
+
+        if (ptr_pending->backlog)
+        {
+            relay_irc_backlog_send (client, ptr_pending->backlog);
+        }
+        else
+        {
+            relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
+                               ptr_pending->message, ptr_pending->size, NULL);
+        }
+
+        relay_irc_backlog_pending_free (ptr_pending);
+    }
+}
+
+/*
+ * Sends messages waiting to all IRC clients.
+ */
+
+void
+relay_irc_backlog_flush_all ()
+{
+    struct t_relay_client *ptr_client;
+
+    for (ptr_client = relay_clients; ptr_client;
+         ptr_client = ptr_client->next_client)
+    {
+        if ((ptr_client->protocol == RELAY_PROTOCOL_IRC)
+            && ptr_client->protocol_data
+            && RELAY_IRC_DATA(ptr_client, backlog_pending))
+        {
+            relay_irc_backlog_flush_pending (ptr_client);
+        }
+    }
+}
+
+/*
+ * Frees all messages waiting to be sent to a client.
+ */
+
+void
+relay_irc_backlog_free_pending (struct t_relay_client *client)
+{
+    struct t_relay_irc_backlog_pending *ptr_pending;
+
+    if (!client || !client->protocol_data)
+        return;
+
+    while (RELAY_IRC_DATA(client, backlog_pending))
+    {
+        ptr_pending = RELAY_IRC_DATA(client, backlog_pending);
+        RELAY_IRC_DATA(client, backlog_pending) = ptr_pending->next_pending;
+        relay_irc_backlog_pending_free (ptr_pending);
+    }
+    RELAY_IRC_DATA(client, last_backlog_pending) = NULL;
+}
+
+/*
+ * Callback for timer: builds backlogs (a limited number of lines on each
+ * call), sends backlogs built to clients and expires cache.
+ */
+
+int
+relay_irc_backlog_timer_cb (const void *pointer, void *data,
+                            int remaining_calls)
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+    int lines, completed;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) remaining_calls;
+
+    relay_irc_backlog_lines_read = 0;
+
+    lines = 0;
+    completed = 0;
+    for (ptr_backlog = relay_irc_backlogs;
+         ptr_backlog && (lines < RELAY_IRC_BACKLOG_LINES_PER_CALL);
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        if (ptr_backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+            continue;
+        lines += relay_irc_backlog_run (
+            ptr_backlog, RELAY_IRC_BACKLOG_LINES_PER_CALL - lines);
+        if (ptr_backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+            completed = 1;
+    }
+
+    if (completed)
+        relay_irc_backlog_flush_all ();
+
+    relay_irc_backlog_expire ();
+
+    relay_irc_backlog_schedule ();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Checks if a backlog is waiting for the end of a batch in its buffer (it can
+ * not be started before).
+ *
+ * Returns:
+ *   1: backlog is waiting for end of batch
+ *   0: backlog is not waiting for end of batch
+ */
+
+int
+relay_irc_backlog_waiting_batch (struct t_relay_irc_backlog *backlog)
+{
+    return ((backlog->status != RELAY_IRC_BACKLOG_STATUS_DONE)
+            && !backlog->index
+            && backlog->buffer
+            && relay_irc_backlog_path_buffer_batch
+            && (relay_irc_backlog_path_integer (
+                    relay_irc_backlog_path_buffer_batch,
+                    backlog->buffer) > 0)) ? 1 : 0;
+}
+
+/*
+ * Hooks timer according to backlogs: quick timer if some backlogs are not yet
+ * built, slower timer if they are all waiting for the end of a batch, slow
+ * timer to expire cache, no timer if there is no backlog.
+ */
+
+void
+relay_irc_backlog_schedule ()
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+    int interval;
+
+    interval = 0;
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        if (ptr_backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+        {
+            if (interval == 0)
+                interval = 1000;
+        }
+        else if (relay_irc_backlog_waiting_batch (ptr_backlog))
+        {
+            interval = RELAY_IRC_BACKLOG_BATCH_DELAY;
+        }
+        else
+        {
+            interval = 1;
+            break;
+        }
+    }
+    if ((interval == 0) && (relay_irc_backlog_lines_read > 0))
+        interval = 1;
+
+    if (interval == relay_irc_backlog_timer_interval)
+        return;
+
+    if (relay_irc_backlog_timer)
+    {
+        weechat_unhook (relay_irc_backlog_timer);
+        relay_irc_backlog_timer = NULL;
+    }
+    if (interval > 0)
+    {
+        relay_irc_backlog_timer = weechat_hook_timer (
+            interval, 0, 0,
+            &relay_irc_backlog_timer_cb, NULL, NULL);
+    }
+    relay_irc_backlog_timer_interval = interval;
+}
+
+/*
+ * Sends channel backlog to client.
+ *
+ * The backlog is built in the timer if there are many lines to read: until
+ * the backlog is sent, other messages for this client are queued.
+ */
+
+void
+relay_irc_send_channel_backlog (struct t_relay_client *client,
+                                const char *channel,
+                                struct t_gui_buffer *buffer)
+{
+    struct t_relay_server *ptr_server;
+    struct t_relay_irc_backlog *ptr_backlog;
+    int max_minutes, server_time;
+    time_t date_min, date_min2;
+
+    max_minutes = weechat_config_integer (relay_config_irc_backlog_max_minutes);
+    date_min = (max_minutes > 0) ? time (NULL) - (max_minutes * 60) : 0;
+    if (weechat_config_boolean (relay_config_irc_backlog_since_last_disconnect))
+    {
+        ptr_server = relay_server_search (client->protocol_string);
+        if (ptr_server && (ptr_server->last_client_disconnect > 0))
+        {
+            date_min2 = ptr_server->last_client_disconnect;
+            if (date_min2 > date_min)
+                date_min = date_min2;
+        }
+    }
+
+    server_time = (RELAY_IRC_DATA(client, server_capabilities)
+                   & (1 << RELAY_IRC_CAPAB_SERVER_TIME)) ? 1 : 0;
+
+    ptr_backlog = relay_irc_backlog_get (buffer, client->protocol_args,
+                                         channel, server_time, date_min);
+    if (!ptr_backlog)
+        return;
+
+    /* build now, unless too many lines were already read */
+    if ((ptr_backlog->status != RELAY_IRC_BACKLOG_STATUS_DONE)
+        && (relay_irc_backlog_lines_read < RELAY_IRC_BACKLOG_LINES_PER_CALL))
+    {
+        relay_irc_backlog_lines_read += relay_irc_backlog_run (
+            ptr_backlog,
+            RELAY_IRC_BACKLOG_LINES_PER_CALL - relay_irc_backlog_lines_read);
+    }
+
+    relay_irc_backlog_add_pending (client, ptr_backlog, NULL, 0);
+
+    if (ptr_backlog->status == RELAY_IRC_BACKLOG_STATUS_DONE)
+        relay_irc_backlog_flush_all ();
+
+    relay_irc_backlog_schedule ();
+}
+
+/*
+ * Prints backlogs and indexes in WeeChat log file (usually for crash dump).
+ */
+
+void
+relay_irc_backlog_print_log ()
+{
+    struct t_relay_irc_backlog_index *ptr_index;
+    struct t_relay_irc_backlog *ptr_backlog;
+
+    for (ptr_index = relay_irc_backlog_indexes; ptr_index;
+         ptr_index = ptr_index->next_index)
+    {
+        weechat_log_printf ("");
+        weechat_log_printf ("[relay irc backlog index (addr:0x%lx)]", ptr_index);
+        weechat_log_printf ("  buffer. . . . . . . . . . : 0x%lx", ptr_index->buffer);
+        weechat_log_printf ("  lines . . . . . . . . . . : 0x%lx", ptr_index->lines);
+        weechat_log_printf ("  size. . . . . . . . . . . : %d",    ptr_index->size);
+        weechat_log_printf ("  start . . . . . . . . . . : %d",    ptr_index->start);
+        weechat_log_printf ("  num_lines . . . . . . . . : %d",    ptr_index->num_lines);
+        weechat_log_printf ("  first_position. . . . . . : %d",    ptr_index->first_position);
+        weechat_log_printf ("  complete. . . . . . . . . : %d",    ptr_index->complete);
+        weechat_log_printf ("  lines_count . . . . . . . : %d",    ptr_index->lines_count);
+        weechat_log_printf ("  refcount. . . . . . . . . : %d",    ptr_index->refcount);
+        weechat_log_printf ("  prev_index. . . . . . . . : 0x%lx", ptr_index->prev_index);
+        weechat_log_printf ("  next_index. . . . . . . . : 0x%lx", ptr_index->next_index);
+    }
+
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        weechat_log_printf ("");
+        weechat_log_printf ("[relay irc backlog (addr:0x%lx)]", ptr_backlog);
+        weechat_log_printf ("  buffer. . . . . . . . . . : 0x%lx", ptr_backlog->buffer);
+        weechat_log_printf ("  server. . . . . . . . . . : '%s'",  ptr_backlog->server);
+        weechat_log_printf ("  channel . . . . . . . . . : '%s'",  ptr_backlog->channel);
+        weechat_log_printf ("  server_time . . . . . . . : %d",    ptr_backlog->server_time);
+        weechat_log_printf ("  date_min. . . . . . . . . : %lld",  (long long)ptr_backlog->date_min);
+        weechat_log_printf ("  localvar_nick . . . . . . : '%s'",  ptr_backlog->localvar_nick);
+        weechat_log_printf ("  max_number. . . . . . . . : %d",    ptr_backlog->max_number);
+        weechat_log_printf ("  since_last_message. . . . : %d",    ptr_backlog->since_last_message);
+        weechat_log_printf ("  split_max_length. . . . . : %d",    ptr_backlog->split_max_length);
+        weechat_log_printf ("  index . . . . . . . . . . : 0x%lx", ptr_backlog->index);
+        weechat_log_printf ("  status. . . . . . . . . . : %d",    ptr_backlog->status);
+        weechat_log_printf ("  position. . . . . . . . . : %d",    ptr_backlog->position);
+        weechat_log_printf ("  lowest. . . . . . . . . . : %d",    ptr_backlog->lowest);
+        weechat_log_printf ("  end . . . . . . . . . . . : %d",    ptr_backlog->end);
+        weechat_log_printf ("  end_saved . . . . . . . . : %d",    ptr_backlog->end_saved);
+        weechat_log_printf ("  end_line. . . . . . . . . : 0x%lx", ptr_backlog->end_line);
+        weechat_log_printf ("  end_date. . . . . . . . . : %lld",  (long long)ptr_backlog->end_date);
+        weechat_log_printf ("  count . . . . . . . . . . : %d",    ptr_backlog->count);
+        weechat_log_printf ("  messages. . . . . . . . . : 0x%lx", ptr_backlog->messages);
+        weechat_log_printf ("  data. . . . . . . . . . . : 0x%lx", ptr_backlog->data);
+        weechat_log_printf ("  refcount. . . . . . . . . : %d",    ptr_backlog->refcount);
+        weechat_log_printf ("  last_used . . . . . . . . : %lld",  (long long)ptr_backlog->last_used);
+        weechat_log_printf ("  prev_backlog. . . . . . . : 0x%lx", ptr_backlog->prev_backlog);
+        weechat_log_printf ("  next_backlog. . . . . . . : 0x%lx", ptr_backlog->next_backlog);
+    }
+}
+
+/*
+ * Ends backlogs: backlogs not yet built are built and sent to clients, then
+ * all backlogs and indexes are freed.
+ */
+
+void
+relay_irc_backlog_end ()
+{
+    struct t_relay_irc_backlog *ptr_backlog;
+    struct t_relay_client *ptr_client;
+
+    for (ptr_backlog = relay_irc_backlogs; ptr_backlog;
+         ptr_backlog = ptr_backlog->next_backlog)
+    {
+        relay_irc_backlog_run (ptr_backlog, INT_MAX);
+        relay_irc_backlog_finish (ptr_backlog);
+    }
+
+    relay_irc_backlog_flush_all ();
+
+    for (ptr_client = relay_clients; ptr_client;
+         ptr_client = ptr_client->next_client)
+    {
+        if (ptr_client->protocol == RELAY_PROTOCOL_IRC)
+            relay_irc_backlog_free_pending (ptr_client);
+    }
+
+    while (relay_irc_backlogs)
+    {
+        relay_irc_backlog_free (relay_irc_backlogs);
+    }
+
+    while (relay_irc_backlog_indexes)
+    {
+        relay_irc_backlog_index_drop (relay_irc_backlog_indexes);
+    }
+
+    if (relay_irc_backlog_timer)
+    {
+        weechat_unhook (relay_irc_backlog_timer);
+        relay_irc_backlog_timer = NULL;
+    }
+    relay_irc_backlog_timer_interval = 0;
+    relay_irc_backlog_lines_read = 0;
+
+    relay_irc_backlog_hook_buffer_signals ();
+
+    if (relay_irc_backlog_indexes_by_buffer)
+    {
+        weechat_hashtable_free (relay_irc_backlog_indexes_by_buffer);
+        relay_irc_backlog_indexes_by_buffer = NULL;
+    }
+
+    if (relay_irc_backlog_path_buffer_batch)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_buffer_batch);
+        relay_irc_backlog_path_buffer_batch = NULL;
+    }
+    if (relay_irc_backlog_path_buffer_last_line)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_buffer_last_line);
+        relay_irc_backlog_path_buffer_last_line = NULL;
+    }
+    if (relay_irc_backlog_path_buffer_lines_count)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_buffer_lines_count);
+        relay_irc_backlog_path_buffer_lines_count = NULL;
+    }
+    if (relay_irc_backlog_path_line_buffer)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_line_buffer);
+        relay_irc_backlog_path_line_buffer = NULL;
+    }
+    if (relay_irc_backlog_path_line_data)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_line_data);
+        relay_irc_backlog_path_line_data = NULL;
+    }
+    if (relay_irc_backlog_path_line_prev_line)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_line_prev_line);
+        relay_irc_backlog_path_line_prev_line = NULL;
+    }
+    if (relay_irc_backlog_path_date)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_date);
+        relay_irc_backlog_path_date = NULL;
+    }
+    if (relay_irc_backlog_path_tags_array)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_tags_array);
+        relay_irc_backlog_path_tags_array = NULL;
+    }
+    if (relay_irc_backlog_path_message)
+    {
+        weechat_hdata_path_free (relay_irc_backlog_path_message);
+        relay_irc_backlog_path_message = NULL;
+    }
+}
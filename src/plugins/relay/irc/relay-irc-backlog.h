@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2003-2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_RELAY_IRC_BACKLOG_H
+#define WEECHAT_PLUGIN_RELAY_IRC_BACKLOG_H
+
+#include <time.h>
+
+struct t_relay_client;
+struct t_relay_client_data;
+
+/* max number of lines of buffers read in one call of timer */
+#define RELAY_IRC_BACKLOG_LINES_PER_CALL 1024
+
+/* delay (in seconds) to keep a backlog built (it can be sent to other clients) */
+#define RELAY_IRC_BACKLOG_CACHE_DELAY    30
+
+/* delay (in milliseconds) to check again a buffer in a batch */
+#define RELAY_IRC_BACKLOG_BATCH_DELAY    100
+
+/* IRC command of a line not yet computed */
+#define RELAY_IRC_BACKLOG_CMD_UNKNOWN    -2
+
+/* status of a backlog */
+
+enum t_relay_irc_backlog_status
+{
+    RELAY_IRC_BACKLOG_STATUS_SELECT = 0, /* searching first line to send    */
+    RELAY_IRC_BACKLOG_STATUS_FORMAT,     /* building IRC messages           */
+    RELAY_IRC_BACKLOG_STATUS_DONE,       /* IRC messages ready to be sent   */
+    /* number of backlog status */
+    RELAY_IRC_BACKLOG_NUM_STATUS,
+};
+
+/* line in index */
+
+struct t_relay_irc_backlog_line
+{
+    void *line;                        /* pointer to line                   */
+    void *line_data;                   /* pointer to line data              */
+    time_t date;                       /* date of line                      */
+    int irc_command;                   /* IRC command (-1 = not an IRC      */
+                                       /* message, -2 = not yet computed)   */
+};
+
+/*
+ * index on lines of a buffer: the index covers the last lines of buffer and
+ * is extended to older lines on demand; it is updated when lines are added
+ * in buffer and dropped if buffer is cleared or if lines are inserted
+ */
+
+struct t_relay_irc_backlog_index
+{
+    struct t_gui_buffer *buffer;       /* buffer (NULL if index is dropped) */
+    struct t_relay_irc_backlog_line *lines; /* lines (from oldest to newest)*/
+    int size;                          /* allocated size for lines          */
+    int start;                         /* slot of oldest line in "lines"    */
+    int num_lines;                     /* number of lines in index          */
+    int first_position;                /* position of oldest line (does not */
+                                       /* change when lines are added or    */
+                                       /* removed)                          */
+    int complete;                      /* 1 if first line of buffer is in   */
+                                       /* index                             */
+    int lines_count;                   /* number of lines in buffer         */
+    int refcount;                      /* number of references              */
+    struct t_relay_irc_backlog_index *prev_index; /* link to previous index */
+    struct t_relay_irc_backlog_index *next_index; /* link to next index     */
+};
+
+/* backlog of a channel: IRC messages built once and shared by clients */
+
+struct t_relay_irc_backlog
+{
+    struct t_gui_buffer *buffer;       /* buffer (NULL if buffer closed)    */
+    char *server;                      /* IRC server name                   */
+    char *channel;                     /* channel name used in messages     */
+    int server_time;                   /* 1 if time is sent in an IRC tag   */
+                                       /* (capability "server-time")        */
+    time_t date_min;                   /* older lines are not sent          */
+    char *localvar_nick;               /* nick in buffer (local variable)   */
+    int max_number;                    /* max number of IRC messages        */
+    int since_last_message;            /* stop at last message of nick      */
+    int split_max_length;              /* max length of IRC messages        */
+                                       /* (0 = no split)                    */
+    struct t_relay_irc_backlog_index *index; /* index on buffer lines       */
+    enum t_relay_irc_backlog_status status; /* status                       */
+    int position;                      /* current position in index         */
+    int lowest;                        /* lowest position with a date       */
+                                       /* >= date_min (-1 if unknown)       */
+    int end;                           /* position after last line to send  */
+    int end_saved;                     /* 1 if last line to send is saved   */
+    void *end_line;                    /* last line to send at first start  */
+                                       /* (NULL if buffer was empty), kept  */
+                                       /* if backlog is restarted           */
+    time_t end_date;                   /* date of end_line                  */
+    int count;                         /* number of IRC messages selected   */
+    char **messages;                   /* IRC messages being built          */
+    struct t_relay_client_data *data;  /* IRC messages (when status is      */
+                                       /* "done")                           */
+    int refcount;                      /* number of clients waiting for it  */
+    time_t last_used;                  /* last time the backlog was used    */
+    struct t_relay_irc_backlog *prev_backlog; /* link to previous backlog   */
+    struct t_relay_irc_backlog *next_backlog; /* link to next backlog       */
+};
+
+/* message or backlog waiting to be sent to a client */
+
+struct t_relay_irc_backlog_pending
+{
+    struct t_relay_irc_backlog *backlog; /* backlog (NULL for a message)    */
+    char *message;                     /* IRC message (with "\r\n")         */
+    int size;                          /* size of message                   */
+    struct t_relay_irc_backlog_pending *next_pending; /* link to next one   */
+};
+
+extern struct t_relay_irc_backlog_index *relay_irc_backlog_indexes;
+extern struct t_relay_irc_backlog *relay_irc_backlogs;
+
+extern void relay_irc_get_line_info (int server_time,
+                                     const char *localvar_nick,
+                                     void *line_data,
+                                     int *irc_command, int *irc_action,
+                                     time_t *date,
+                                     const char **nick, const char **nick1,
+                                     const char **nick2, const char **host,
+                                     char **tags, char **message);
+extern struct t_relay_irc_backlog_index *relay_irc_backlog_index_get (struct t_gui_buffer *buffer);
+extern int relay_irc_backlog_index_extend (struct t_relay_irc_backlog_index *index);
+extern void relay_irc_backlog_index_add_line (struct t_relay_irc_backlog_index *index,
+                                              void *line);
+extern void relay_irc_backlog_index_drop (struct t_relay_irc_backlog_index *index);
+extern int relay_irc_backlog_index_search_date (struct t_relay_irc_backlog_index *index,
+                                                time_t date);
+extern void relay_irc_backlog_index_unref (struct t_relay_irc_backlog_index *index);
+extern struct t_relay_irc_backlog *relay_irc_backlog_get (struct t_gui_buffer *buffer,
+                                                          const char *server,
+                                                          const char *channel,
+                                                          int server_time,
+                                                          time_t date_min);
+extern int relay_irc_backlog_run (struct t_relay_irc_backlog *backlog,
+                                  int max_lines);
+extern void relay_irc_backlog_restart (struct t_relay_irc_backlog *backlog);
+extern void relay_irc_backlog_unref (struct t_relay_irc_backlog *backlog);
+extern void relay_irc_backlog_expire ();
+extern void relay_irc_backlog_clear_cache ();
+extern void relay_irc_backlog_buffer_closing (struct t_gui_buffer *buffer);
+extern void relay_irc_backlog_add_pending (struct t_relay_client *client,
+                                           struct t_relay_irc_backlog *backlog,
+                                           const char *message, int size);
+extern void relay_irc_backlog_flush_pending (struct t_relay_client *client);
+extern void relay_irc_backlog_flush_all ();
+extern void relay_irc_backlog_free_pending (struct t_relay_client *client);
+extern int relay_irc_backlog_waiting_batch (struct t_relay_irc_backlog *backlog);
+extern void relay_irc_backlog_schedule ();
+extern void relay_irc_send_channel_backlog (struct t_relay_client *client,
+                                            const char *channel,
+                                            struct t_gui_buffer *buffer);
+extern void relay_irc_backlog_print_log ();
+extern void relay_irc_backlog_end ();
+
+#endif /* WEECHAT_PLUGIN_RELAY_IRC_BACKLOG_H */
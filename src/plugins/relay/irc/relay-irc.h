@@ -21,6 +21,7 @@
 #define WEECHAT_PLUGIN_RELAY_IRC_H
 
 struct t_relay_client;
+struct t_relay_irc_backlog_pending;
 enum t_relay_status;
 
 #define RELAY_IRC_DATA(client, var)                              \
@@ -43,6 +44,9 @@ struct t_relay_irc_data
     struct t_hook *hook_signal_irc_outtags; /* signal "irc_outtags"         */
     struct t_hook *hook_signal_irc_disc;    /* signal "irc_disconnected"    */
     struct t_hook *hook_hsignal_irc_redir;  /* hsignal "irc_redirection_..."*/
+    struct t_relay_irc_backlog_pending *backlog_pending; /* messages sent   */
+                                       /* after backlogs being built        */
+    struct t_relay_irc_backlog_pending *last_backlog_pending; /* last one   */
 };
 
 enum t_relay_irc_command
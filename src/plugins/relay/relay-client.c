@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <gnutls/gnutls.h>
 
@@ -384,6 +385,14 @@ relay_client_recv_text (struct t_relay_client *client, const char *data)
                         if (rc == 0)
                         {
                             /* handshake from client is valid */
+                            if (weechat_config_boolean (relay_config_network_websocket_permessage_deflate)
+                                && (weechat_config_integer (relay_config_network_compression_level) > 0))
+                            {
+                                relay_websocket_parse_extensions (
+                                    weechat_hashtable_get (client->http_headers,
+                                                           "sec-websocket-extensions"),
+                                    client->ws_deflate);
+                            }
                             handshake  = relay_websocket_build_handshake (client);
                             if (handshake)
                             {
@@ -571,13 +580,17 @@ relay_client_recv_text_buffer (struct t_relay_client *client,
 
 /*
  * Reads data from a client.
+ *
+ * When the outqueue is not empty, the socket is hooked for writing too, and
+ * messages in outqueue are sent by this callback.
  */
 
 int
 relay_client_recv_cb (const void *pointer, void *data, int fd)
 {
     struct t_relay_client *client;
-    static char buffer[4096], decoded[8192 + 1];
+    static char buffer[4096];
+    unsigned char *decoded;
     const char *ptr_buffer;
     int num_read, rc;
     unsigned long long decoded_length, length_buffer;
@@ -587,6 +600,11 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
     (void) fd;
 
     client = (struct t_relay_client *)pointer;
+    decoded = NULL;
+
+    /* send messages in outqueue (socket may be ready for writing) */
+    if (client->outqueue)
+        relay_client_send_outqueue (client);
 
     /*
      * data can be received only during authentication
@@ -629,6 +647,7 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
                     WEECHAT_HASHTABLE_STRING,
                     WEECHAT_HASHTABLE_STRING,
                     NULL, NULL);
+                client->ws_deflate = relay_websocket_deflate_alloc ();
             }
         }
 
@@ -637,10 +656,16 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
         if (client->websocket == 2)
         {
             /* websocket used, decode message */
-            rc = relay_websocket_decode_frame ((unsigned char *)buffer,
+            rc = relay_websocket_decode_frame (client->ws_deflate,
+                                               (unsigned char *)buffer,
                                                (unsigned long long)num_read,
-                                               (unsigned char *)decoded,
+                                               &decoded,
                                                &decoded_length);
+            if (decoded && (!rc || (decoded_length == 0)))
+            {
+                free (decoded);
+                decoded = NULL;
+            }
             if (decoded_length == 0)
             {
                 /*
@@ -668,7 +693,7 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
                 relay_client_set_status (client, RELAY_STATUS_DISCONNECTED);
                 return WEECHAT_RC_OK;
             }
-            ptr_buffer = decoded;
+            ptr_buffer = (const char *)decoded;
             length_buffer = decoded_length;
         }
 
@@ -683,6 +708,8 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
             /* receive buffer as-is (binary data) */
             /* currently, all supported protocols receive only text, no binary */
         }
+        if (decoded)
+            free (decoded);
         relay_buffer_refresh (NULL);
     }
     else
@@ -730,6 +757,91 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Creates a new data to send to clients.
+ *
+ * If copy == 1, the buffer is duplicated, otherwise the buffer (which must
+ * have been allocated with malloc) is used as-is and freed with the data.
+ *
+ * The data is created with one reference, the caller must call
+ * relay_client_data_unref when it doesn't use it any more.
+ *
+ * Returns pointer to new data, NULL if error.
+ */
+
+struct t_relay_client_data *
+relay_client_data_new (char *buffer, int size, int copy)
+{
+    struct t_relay_client_data *new_data;
+
+    if (!buffer || (size <= 0))
+        return NULL;
+
+    new_data = malloc (sizeof (*new_data));
+    if (!new_data)
+        return NULL;
+
+    if (copy)
+    {
+        new_data->buffer = malloc (size);
+        if (!new_data->buffer)
+        {
+            free (new_data);
+            return NULL;
+        }
+        memcpy (new_data->buffer, buffer, size);
+    }
+    else
+    {
+        new_data->buffer = buffer;
+    }
+    new_data->size = size;
+    new_data->refcount = 1;
+
+    return new_data;
+}
+
+/*
+ * Removes a reference on a data, and frees it if it is not used any more.
+ */
+
+void
+relay_client_data_unref (struct t_relay_client_data *data)
+{
+    if (!data)
+        return;
+
+    data->refcount--;
+    if (data->refcount <= 0)
+    {
+        if (data->buffer)
+            free (data->buffer);
+        free (data);
+    }
+}
+
+/*
+ * Hooks the socket of a client, for reading and optionally for writing
+ * (when the outqueue is not empty).
+ */
+
+void
+relay_client_hook_fd_write (struct t_relay_client *client, int flag_write)
+{
+    if (!client->hook_fd || (client->sock < 0)
+        || (client->hook_fd_write == flag_write))
+    {
+        return;
+    }
+
+    weechat_unhook (client->hook_fd);
+    client->hook_fd = weechat_hook_fd (client->sock,
+                                       1, flag_write, 0,
+                                       &relay_client_recv_cb,
+                                       client, NULL);
+    client->hook_fd_write = (client->hook_fd) ? flag_write : 0;
+}
+
 /*
  * Frees a message in out queue.
  */
@@ -757,9 +869,22 @@ relay_client_outqueue_free (struct t_relay_client *client,
     if (outqueue->next_outqueue)
         (outqueue->next_outqueue)->prev_outqueue = outqueue->prev_outqueue;
 
+    /* update size of outqueue and remove key */
+    client->outqueue_size -= outqueue->data->size - outqueue->data_sent;
+    client->outqueue_count--;
+    if (outqueue->key)
+    {
+        if (client->outqueue_keys
+            && (weechat_hashtable_get (client->outqueue_keys,
+                                       outqueue->key) == outqueue))
+        {
+            weechat_hashtable_remove (client->outqueue_keys, outqueue->key);
+        }
+        free (outqueue->key);
+    }
+
     /* free data */
-    if (outqueue->data)
-        free (outqueue->data);
+    relay_client_data_unref (outqueue->data);
     if (outqueue->raw_message[0])
         free (outqueue->raw_message[0]);
     if (outqueue->raw_message[1])
@@ -783,82 +908,113 @@ relay_client_outqueue_free_all (struct t_relay_client *client)
     }
 }
 
+/*
+ * Removes bytes sent from the outqueue: messages entirely sent are removed,
+ * and the raw messages are displayed for all messages (at least partially)
+ * sent.
+ */
+
+void
+relay_client_outqueue_remove_sent (struct t_relay_client *client,
+                                   int num_sent)
+{
+    int i, size;
+
+    while (client->outqueue)
+    {
+        for (i = 0; i < 2; i++)
+        {
+            if (client->outqueue->raw_message[i])
+            {
+                /*
+                 * print raw message and remove it from outqueue
+                 * (so that it is displayed only one time, even if
+                 * message is sent in many chunks)
+                 */
+                relay_raw_print (
+                    client,
+                    client->outqueue->raw_msg_type[i],
+                    client->outqueue->raw_flags[i],
+                    client->outqueue->raw_message[i],
+                    client->outqueue->raw_size[i]);
+                client->outqueue->raw_flags[i] = 0;
+                free (client->outqueue->raw_message[i]);
+                client->outqueue->raw_message[i] = NULL;
+                client->outqueue->raw_size[i] = 0;
+            }
+        }
+        size = client->outqueue->data->size - client->outqueue->data_sent;
+        if (num_sent < size)
+        {
+            client->outqueue->data_sent += num_sent;
+            client->outqueue_size -= num_sent;
+            break;
+        }
+        /* whole data sent, remove outqueue */
+        num_sent -= size;
+        relay_client_outqueue_free (client, client->outqueue);
+        if (num_sent == 0)
+            break;
+    }
+}
+
 /*
  * Sends messages in outqueue for a client.
+ *
+ * Without SSL, many messages are sent with a single call to writev; with SSL,
+ * messages are sent one by one. In both cases, data is sent until the socket
+ * does not accept more data.
  */
 
 void
 relay_client_send_outqueue (struct t_relay_client *client)
 {
-    int i, num_sent;
-    char *buf;
+    struct iovec iov[RELAY_CLIENT_OUTQUEUE_IOV_MAX];
+    struct t_relay_client_outqueue *ptr_outqueue;
+    int count, num_sent, num_to_send;
 
     while (client->outqueue)
     {
         if (client->ssl)
         {
-            num_sent = gnutls_record_send (client->gnutls_sess,
-                                           client->outqueue->data,
-                                           client->outqueue->data_size);
+            num_to_send = client->outqueue->data->size
+                - client->outqueue->data_sent;
+            num_sent = gnutls_record_send (
+                client->gnutls_sess,
+                client->outqueue->data->buffer + client->outqueue->data_sent,
+                num_to_send);
         }
         else
         {
-            num_sent = send (client->sock,
-                             client->outqueue->data,
-                             client->outqueue->data_size, 0);
+            count = 0;
+            num_to_send = 0;
+            for (ptr_outqueue = client->outqueue;
+                 ptr_outqueue && (count < RELAY_CLIENT_OUTQUEUE_IOV_MAX);
+                 ptr_outqueue = ptr_outqueue->next_outqueue)
+            {
+                iov[count].iov_base = ptr_outqueue->data->buffer
+                    + ptr_outqueue->data_sent;
+                iov[count].iov_len = ptr_outqueue->data->size
+                    - ptr_outqueue->data_sent;
+                num_to_send += iov[count].iov_len;
+                count++;
+            }
+            num_sent = writev (client->sock, iov, count);
         }
         if (num_sent >= 0)
         {
-            for (i = 0; i < 2; i++)
-            {
-                if (client->outqueue->raw_message[i])
-                {
-                    /*
-                     * print raw message and remove it from outqueue
-                     * (so that it is displayed only one time, even if
-                     * message is sent in many chunks)
-                     */
-                    relay_raw_print (
-                        client,
-                        client->outqueue->raw_msg_type[i],
-                        client->outqueue->raw_flags[i],
-                        client->outqueue->raw_message[i],
-                        client->outqueue->raw_size[i]);
-                    client->outqueue->raw_flags[i] = 0;
-                    free (client->outqueue->raw_message[i]);
-                    client->outqueue->raw_message[i] = NULL;
-                    client->outqueue->raw_size[i] = 0;
-                }
-            }
             if (num_sent > 0)
             {
                 client->bytes_sent += num_sent;
                 relay_buffer_refresh (NULL);
             }
-            if (num_sent == client->outqueue->data_size)
-            {
-                /* whole data sent, remove outqueue */
-                relay_client_outqueue_free (client, client->outqueue);
-            }
-            else
+            relay_client_outqueue_remove_sent (client, num_sent);
+            if ((num_sent == 0) || (!client->ssl && (num_sent < num_to_send)))
             {
                 /*
-                 * some data was not sent, update outqueue and stop
-                 * sending data from outqueue
+                 * some data was not sent: socket is full, stop sending data
+                 * from outqueue
                  */
-                if (num_sent > 0)
-                {
-                    buf = malloc (client->outqueue->data_size - num_sent);
-                    if (buf)
-                    {
-                        memcpy (buf,
-                                client->outqueue->data + num_sent,
-                                client->outqueue->data_size - num_sent);
-                        free (client->outqueue->data);
-                        client->outqueue->data = buf;
-                        client->outqueue->data_size = client->outqueue->data_size - num_sent;
-                    }
-                }
                 break;
             }
         }
@@ -914,68 +1070,95 @@ relay_client_send_outqueue (struct t_relay_client *client)
         }
     }
 
-    if (!client->outqueue && client->hook_timer_send)
+    /* outqueue empty: stop waiting for socket ready for writing */
+    if (!client->outqueue)
     {
-        weechat_unhook (client->hook_timer_send);
-        client->hook_timer_send = NULL;
+        relay_client_hook_fd_write (client, 0);
+        if (client->status == RELAY_STATUS_CONNECTED)
+        {
+            /* protocol can send more data */
+            switch (client->protocol)
+            {
+                case RELAY_PROTOCOL_WEECHAT:
+                    relay_weechat_outqueue_empty (client);
+                    break;
+                case RELAY_PROTOCOL_IRC:
+                case RELAY_NUM_PROTOCOLS:
+                    break;
+            }
+        }
     }
 }
 
-/*
- * Timer called for a client when outqueue is not empty.
- *
- * This timer is automatically removed when the outqueue becomes empty
- * (done in the function relay_client_send_outqueue).
- */
-
-int
-relay_client_timer_send_cb (const void *pointer, void *data,
-                            int remaining_calls)
-{
-    struct t_relay_client *ptr_client;
-
-    /* make C compiler happy */
-    (void) data;
-    (void) remaining_calls;
-
-    ptr_client = (struct t_relay_client *)pointer;
-
-    relay_client_send_outqueue (ptr_client);
-
-    return WEECHAT_RC_OK;
-}
-
 /*
  * Adds a message in out queue.
+ *
+ * The data is not copied: a reference is added on it (data_sent is the
+ * number of bytes of data already sent).
+ *
+ * If key is not NULL and if a message with same key is in outqueue (and not
+ * yet partially sent), this message is removed: only the newest message is
+ * sent (for example the last title of a buffer).
+ *
+ * Raw messages are copied only if the relay raw buffer is opened (to display
+ * them when data is actually sent), otherwise they are added immediately in
+ * the raw messages.
  */
 
 void
 relay_client_outqueue_add (struct t_relay_client *client,
-                           const char *data, int data_size,
+                           struct t_relay_client_data *data, int data_sent,
+                           const char *key,
                            enum t_relay_client_msg_type raw_msg_type[2],
                            int raw_flags[2],
                            const char *raw_message[2],
                            int raw_size[2])
 {
-    struct t_relay_client_outqueue *new_outqueue;
+    struct t_relay_client_outqueue *new_outqueue, *ptr_outqueue;
     int i;
 
-    if (!client || !data || (data_size <= 0))
+    if (!client || !data || (data_sent >= data->size))
         return;
 
+    /* replace message with same key (if not yet partially sent) */
+    if (key && client->outqueue_keys)
+    {
+        ptr_outqueue = weechat_hashtable_get (client->outqueue_keys, key);
+        if (ptr_outqueue && (ptr_outqueue->data_sent == 0))
+        {
+            relay_client_outqueue_free (client, ptr_outqueue);
+            client->msgs_coalesced++;
+        }
+    }
+
     new_outqueue = malloc (sizeof (*new_outqueue));
     if (!new_outqueue)
         return;
 
-    new_outqueue->data = malloc (data_size);
-    if (!new_outqueue->data)
+    data->refcount++;
+    new_outqueue->data = data;
+    new_outqueue->data_sent = data_sent;
+    new_outqueue->key = NULL;
+    if (key)
     {
-        free (new_outqueue);
-        return;
+        if (!client->outqueue_keys)
+        {
+            client->outqueue_keys = weechat_hashtable_new (
+                32,
+                WEECHAT_HASHTABLE_STRING,
+                WEECHAT_HASHTABLE_POINTER,
+                NULL, NULL);
+        }
+        if (client->outqueue_keys)
+        {
+            new_outqueue->key = strdup (key);
+            if (new_outqueue->key)
+            {
+                weechat_hashtable_set (client->outqueue_keys,
+                                       key, new_outqueue);
+            }
+        }
     }
-
-    memcpy (new_outqueue->data, data, data_size);
-    new_outqueue->data_size = data_size;
     for (i = 0; i < 2; i++)
     {
         new_outqueue->raw_msg_type[i] = RELAY_CLIENT_MSG_STANDARD;
@@ -984,6 +1167,12 @@ relay_client_outqueue_add (struct t_relay_client *client,
         new_outqueue->raw_size[i] = 0;
         if (raw_message && raw_message[i] && (raw_size[i] > 0))
         {
+            if (!relay_raw_buffer)
+            {
+                relay_raw_print (client, raw_msg_type[i], raw_flags[i],
+                                 raw_message[i], raw_size[i]);
+                continue;
+            }
             new_outqueue->raw_message[i] = malloc (raw_size[i]);
             if (new_outqueue->raw_message[i])
             {
@@ -1003,18 +1192,22 @@ relay_client_outqueue_add (struct t_relay_client *client,
     else
         client->outqueue = new_outqueue;
     client->last_outqueue = new_outqueue;
+    client->outqueue_size += data->size - data_sent;
+    client->outqueue_count++;
 
-    if (!client->hook_timer_send)
-    {
-        client->hook_timer_send = weechat_hook_timer (
-            1, 0, 0,
-            &relay_client_timer_send_cb, client, NULL);
-    }
+    /* wait for socket ready for writing to send outqueue */
+    relay_client_hook_fd_write (client, 1);
 }
 
 /*
  * Sends data to client (adds in out queue if it's impossible to send now).
  *
+ * If "shared_data" is not NULL, it contains the data (which is not copied if
+ * it has to be added in out queue).
+ *
+ * If "key" is not NULL, a message with same key in out queue (not yet sent)
+ * is replaced by this one.
+ *
  * If "message_raw_buffer" is not NULL, it is used for display in raw buffer
  * and replaces display of data, which is default.
  *
@@ -1022,22 +1215,26 @@ relay_client_outqueue_add (struct t_relay_client *client,
  */
 
 int
-relay_client_send (struct t_relay_client *client,
-                   enum t_relay_client_msg_type msg_type,
-                   const char *data,
-                   int data_size, const char *message_raw_buffer)
+relay_client_send_full (struct t_relay_client *client,
+                        enum t_relay_client_msg_type msg_type,
+                        const char *data, int data_size,
+                        struct t_relay_client_data *shared_data,
+                        const char *key,
+                        const char *message_raw_buffer)
 {
     int num_sent, raw_size[2], raw_flags[2], opcode, i;
     enum t_relay_client_msg_type raw_msg_type[2];
     char *websocket_frame;
     unsigned long long length_frame;
     const char *ptr_data, *raw_msg[2];
+    struct t_relay_client_data *ptr_shared_data;
 
     if (client->sock < 0)
         return -1;
 
     ptr_data = data;
     websocket_frame = NULL;
+    ptr_shared_data = shared_data;
 
     /* set raw messages */
     for (i = 0; i < 2; i++)
@@ -1111,13 +1308,26 @@ relay_client_send (struct t_relay_client *client,
                     WEBSOCKET_FRAME_OPCODE_TEXT : WEBSOCKET_FRAME_OPCODE_BINARY;
                 break;
         }
-        websocket_frame = relay_websocket_encode_frame (opcode, data,
+        websocket_frame = relay_websocket_encode_frame (client->ws_deflate,
+                                                        opcode, data,
                                                         data_size,
                                                         &length_frame);
         if (websocket_frame)
         {
             ptr_data = websocket_frame;
             data_size = length_frame;
+            ptr_shared_data = NULL;
+        }
+        /*
+         * with "permessage-deflate" and context takeover, the frame is
+         * compressed against the previous frames: the key is ignored, a
+         * frame in outqueue can not be replaced without breaking the
+         * inflate context of client
+         */
+        if (client->ws_deflate && client->ws_deflate->enabled
+            && client->ws_deflate->server_context_takeover)
+        {
+            key = NULL;
         }
     }
 
@@ -1129,8 +1339,7 @@ relay_client_send (struct t_relay_client *client,
      */
     if (client->outqueue)
     {
-        relay_client_outqueue_add (client, ptr_data, data_size,
-                                   raw_msg_type, raw_flags, raw_msg, raw_size);
+        num_sent = 0;
     }
     else
     {
@@ -1147,6 +1356,7 @@ relay_client_send (struct t_relay_client *client,
                 {
                     relay_raw_print (client, raw_msg_type[i], raw_flags[i],
                                      raw_msg[i], raw_size[i]);
+                    raw_msg[i] = NULL;
                 }
             }
             if (num_sent > 0)
@@ -1154,14 +1364,6 @@ relay_client_send (struct t_relay_client *client,
                 client->bytes_sent += num_sent;
                 relay_buffer_refresh (NULL);
             }
-            if (num_sent < data_size)
-            {
-                /* some data was not sent, add it to outqueue */
-                relay_client_outqueue_add (client,
-                                           ptr_data + num_sent,
-                                           data_size - num_sent,
-                                           NULL, NULL, NULL, NULL);
-            }
         }
         else
         {
@@ -1171,10 +1373,7 @@ relay_client_send (struct t_relay_client *client,
                     || (num_sent == GNUTLS_E_INTERRUPTED))
                 {
                     /* add message to queue (will be sent later) */
-                    relay_client_outqueue_add (client,
-                                               ptr_data, data_size,
-                                               raw_msg_type, raw_flags,
-                                               raw_msg, raw_size);
+                    num_sent = 0;
                 }
                 else
                 {
@@ -1196,9 +1395,7 @@ relay_client_send (struct t_relay_client *client,
                 if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
                 {
                     /* add message to queue (will be sent later) */
-                    relay_client_outqueue_add (client, ptr_data, data_size,
-                                               raw_msg_type, raw_flags,
-                                               raw_msg, raw_size);
+                    num_sent = 0;
                 }
                 else
                 {
@@ -1218,12 +1415,95 @@ relay_client_send (struct t_relay_client *client,
         }
     }
 
+    /* some data was not sent, add it to outqueue */
+    if ((num_sent >= 0) && (num_sent < data_size))
+    {
+        if (ptr_shared_data)
+        {
+            relay_client_outqueue_add (client, ptr_shared_data, num_sent,
+                                       key, raw_msg_type, raw_flags,
+                                       raw_msg, raw_size);
+        }
+        else if (websocket_frame)
+        {
+            /* the websocket frame is given to the outqueue (not copied) */
+            ptr_shared_data = relay_client_data_new (websocket_frame,
+                                                     data_size, 0);
+            if (ptr_shared_data)
+            {
+                websocket_frame = NULL;
+                relay_client_outqueue_add (client, ptr_shared_data, num_sent,
+                                           key, raw_msg_type, raw_flags,
+                                           raw_msg, raw_size);
+                relay_client_data_unref (ptr_shared_data);
+            }
+        }
+        else
+        {
+            /* copy the data not sent */
+            ptr_shared_data = relay_client_data_new ((char *)ptr_data + num_sent,
+                                                     data_size - num_sent, 1);
+            if (ptr_shared_data)
+            {
+                relay_client_outqueue_add (client, ptr_shared_data, 0,
+                                           key, raw_msg_type, raw_flags,
+                                           raw_msg, raw_size);
+                relay_client_data_unref (ptr_shared_data);
+            }
+        }
+    }
+
     if (websocket_frame)
         free (websocket_frame);
 
     return num_sent;
 }
 
+/*
+ * Sends data to client (adds in out queue if it's impossible to send now).
+ *
+ * If "message_raw_buffer" is not NULL, it is used for display in raw buffer
+ * and replaces display of data, which is default.
+ *
+ * Returns number of bytes sent to client, -1 if error.
+ */
+
+int
+relay_client_send (struct t_relay_client *client,
+                   enum t_relay_client_msg_type msg_type,
+                   const char *data,
+                   int data_size, const char *message_raw_buffer)
+{
+    return relay_client_send_full (client, msg_type, data, data_size,
+                                   NULL, NULL, message_raw_buffer);
+}
+
+/*
+ * Sends a data to client (adds in out queue if it's impossible to send now).
+ *
+ * The data can be shared by many clients: it is not copied if it has to be
+ * added in out queue.
+ *
+ * If "message_raw_buffer" is not NULL, it is used for display in raw buffer
+ * and replaces display of data, which is default.
+ *
+ * Returns number of bytes sent to client, -1 if error.
+ */
+
+int
+relay_client_send_data (struct t_relay_client *client,
+                        enum t_relay_client_msg_type msg_type,
+                        struct t_relay_client_data *data,
+                        const char *message_raw_buffer)
+{
+    if (!data)
+        return -1;
+
+    return relay_client_send_full (client, msg_type,
+                                   data->buffer, data->size, data, NULL,
+                                   message_raw_buffer);
+}
+
 /*
  * Timer callback, called each second.
  */
@@ -1308,6 +1588,7 @@ relay_client_new (int sock, const char *address, struct t_relay_server *server)
         new_client->gnutls_handshake_ok = 0;
         new_client->websocket = 0;
         new_client->http_headers = NULL;
+        new_client->ws_deflate = NULL;
         new_client->address = strdup ((address && address[0]) ?
                                       address : "local");
         new_client->real_ip = NULL;
@@ -1328,7 +1609,7 @@ relay_client_new (int sock, const char *address, struct t_relay_server *server)
         new_client->start_time = time (NULL);
         new_client->end_time = 0;
         new_client->hook_fd = NULL;
-        new_client->hook_timer_send = NULL;
+        new_client->hook_fd_write = 0;
         new_client->last_activity = new_client->start_time;
         new_client->bytes_recv = 0;
         new_client->bytes_sent = 0;
@@ -1427,6 +1708,11 @@ relay_client_new (int sock, const char *address, struct t_relay_server *server)
 
         new_client->outqueue = NULL;
         new_client->last_outqueue = NULL;
+        new_client->outqueue_size = 0;
+        new_client->outqueue_count = 0;
+        new_client->outqueue_keys = NULL;
+        new_client->msgs_coalesced = 0;
+        new_client->msgs_dropped = 0;
 
         new_client->prev_client = NULL;
         new_client->next_client = relay_clients;
@@ -1513,6 +1799,8 @@ relay_client_new_with_infolist (struct t_infolist *infolist)
         new_client->gnutls_handshake_ok = 0;
         new_client->websocket = weechat_infolist_integer (infolist, "websocket");
         new_client->http_headers = NULL;
+        new_client->ws_deflate = (new_client->websocket) ?
+            relay_websocket_deflate_alloc_with_infolist (infolist) : NULL;
         new_client->address = strdup (weechat_infolist_string (infolist, "address"));
         str = weechat_infolist_string (infolist, "real_ip");
         new_client->real_ip = (str) ? strdup (str) : NULL;
@@ -1552,7 +1840,7 @@ relay_client_new_with_infolist (struct t_infolist *infolist)
         }
         else
             new_client->hook_fd = NULL;
-        new_client->hook_timer_send = NULL;
+        new_client->hook_fd_write = 0;
         new_client->last_activity = weechat_infolist_time (infolist, "last_activity");
         sscanf (weechat_infolist_string (infolist, "bytes_recv"),
                 "%llu", &(new_client->bytes_recv));
@@ -1585,6 +1873,13 @@ relay_client_new_with_infolist (struct t_infolist *infolist)
 
         new_client->outqueue = NULL;
         new_client->last_outqueue = NULL;
+        new_client->outqueue_size = 0;
+        new_client->outqueue_count = 0;
+        new_client->outqueue_keys = NULL;
+        new_client->msgs_coalesced = weechat_infolist_integer (infolist,
+                                                               "msgs_coalesced");
+        new_client->msgs_dropped = weechat_infolist_integer (infolist,
+                                                             "msgs_dropped");
 
         new_client->prev_client = NULL;
         new_client->next_client = relay_clients;
@@ -1643,11 +1938,7 @@ relay_client_set_status (struct t_relay_client *client,
             weechat_unhook (client->hook_fd);
             client->hook_fd = NULL;
         }
-        if (client->hook_timer_send)
-        {
-            weechat_unhook (client->hook_timer_send);
-            client->hook_timer_send = NULL;
-        }
+        client->hook_fd_write = 0;
         switch (client->protocol)
         {
             case RELAY_PROTOCOL_WEECHAT:
@@ -1712,6 +2003,9 @@ relay_client_free (struct t_relay_client *client)
     if (!client)
         return;
 
+    /* position of cursors on relay clients must be checked again */
+    relay_weechat_cursors_changes++;
+
     /* remove client from list */
     if (last_relay_client == client)
         last_relay_client = client->prev_client;
@@ -1742,10 +2036,10 @@ relay_client_free (struct t_relay_client *client)
         weechat_unhook (client->hook_timer_handshake);
     if (client->http_headers)
         weechat_hashtable_free (client->http_headers);
+    if (client->ws_deflate)
+        relay_websocket_deflate_free (client->ws_deflate);
     if (client->hook_fd)
         weechat_unhook (client->hook_fd);
-    if (client->hook_timer_send)
-        weechat_unhook (client->hook_timer_send);
     if (client->partial_message)
         free (client->partial_message);
     if (client->protocol_data)
@@ -1763,6 +2057,8 @@ relay_client_free (struct t_relay_client *client)
         }
     }
     relay_client_outqueue_free_all (client);
+    if (client->outqueue_keys)
+        weechat_hashtable_free (client->outqueue_keys);
 
     free (client);
 
@@ -1818,6 +2114,52 @@ relay_client_disconnect_all ()
     }
 }
 
+/*
+ * Returns hdata for client.
+ */
+
+struct t_hdata *
+relay_client_hdata_client_cb (const void *pointer, void *data,
+                              const char *hdata_name)
+{
+    struct t_hdata *hdata;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+
+    hdata = weechat_hdata_new (hdata_name, "prev_client", "next_client",
+                               0, 0, NULL, NULL);
+    if (hdata)
+    {
+        WEECHAT_HDATA_VAR(struct t_relay_client, id, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, desc, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, sock, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, server_port, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, ssl, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, websocket, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, address, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, real_ip, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, status, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, protocol, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, protocol_string, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, protocol_args, STRING, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, listen_start_time, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, start_time, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, end_time, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, last_activity, TIME, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, outqueue_size, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, outqueue_count, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, msgs_coalesced, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, msgs_dropped, INTEGER, 0, NULL, NULL);
+        WEECHAT_HDATA_VAR(struct t_relay_client, prev_client, POINTER, 0, NULL, hdata_name);
+        WEECHAT_HDATA_VAR(struct t_relay_client, next_client, POINTER, 0, NULL, hdata_name);
+        WEECHAT_HDATA_LIST(relay_clients, WEECHAT_HDATA_LIST_CHECK_POINTERS);
+        WEECHAT_HDATA_LIST(last_relay_client, 0);
+    }
+    return hdata;
+}
+
 /*
  * Adds a client in an infolist.
  *
@@ -1856,6 +2198,11 @@ relay_client_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "websocket", client->websocket))
         return 0;
+    if (client->ws_deflate
+        && !relay_websocket_deflate_add_to_infolist (ptr_item, client->ws_deflate))
+    {
+        return 0;
+    }
     if (!weechat_infolist_new_var_string (ptr_item, "address", client->address))
         return 0;
     if (!weechat_infolist_new_var_string (ptr_item, "real_ip", client->real_ip))
@@ -1886,7 +2233,7 @@ relay_client_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_pointer (ptr_item, "hook_fd", client->hook_fd))
         return 0;
-    if (!weechat_infolist_new_var_pointer (ptr_item, "hook_timer_send", client->hook_timer_send))
+    if (!weechat_infolist_new_var_integer (ptr_item, "hook_fd_write", client->hook_fd_write))
         return 0;
     if (!weechat_infolist_new_var_time (ptr_item, "last_activity", client->last_activity))
         return 0;
@@ -1902,6 +2249,14 @@ relay_client_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_string (ptr_item, "partial_message", client->partial_message))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "outqueue_size", client->outqueue_size))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "outqueue_count", client->outqueue_count))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "msgs_coalesced", client->msgs_coalesced))
+        return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "msgs_dropped", client->msgs_dropped))
+        return 0;
 
     switch (client->protocol)
     {
@@ -1944,6 +2299,7 @@ relay_client_print_log ()
         weechat_log_printf ("  http_headers. . . . . . . : 0x%lx (hashtable: '%s')",
                             ptr_client->http_headers,
                             weechat_hashtable_get_string (ptr_client->http_headers, "keys_values"));
+        relay_websocket_deflate_print_log (ptr_client->ws_deflate);
         weechat_log_printf ("  address . . . . . . . . . : '%s'", ptr_client->address);
         weechat_log_printf ("  real_ip . . . . . . . . . : '%s'", ptr_client->real_ip);
         weechat_log_printf ("  status. . . . . . . . . . : %d (%s)",
@@ -1964,7 +2320,7 @@ relay_client_print_log ()
         weechat_log_printf ("  start_time. . . . . . . . : %lld",  (long long)ptr_client->start_time);
         weechat_log_printf ("  end_time. . . . . . . . . : %lld",  (long long)ptr_client->end_time);
         weechat_log_printf ("  hook_fd . . . . . . . . . : 0x%lx", ptr_client->hook_fd);
-        weechat_log_printf ("  hook_timer_send . . . . . : 0x%lx", ptr_client->hook_timer_send);
+        weechat_log_printf ("  hook_fd_write . . . . . . : %d", ptr_client->hook_fd_write);
         weechat_log_printf ("  last_activity . . . . . . : %lld",  (long long)ptr_client->last_activity);
         weechat_log_printf ("  bytes_recv. . . . . . . . : %llu",  ptr_client->bytes_recv);
         weechat_log_printf ("  bytes_sent. . . . . . . . : %llu",  ptr_client->bytes_sent);
@@ -1989,6 +2345,14 @@ relay_client_print_log ()
         }
         weechat_log_printf ("  outqueue. . . . . . . . . : 0x%lx", ptr_client->outqueue);
         weechat_log_printf ("  last_outqueue . . . . . . : 0x%lx", ptr_client->last_outqueue);
+        weechat_log_printf ("  outqueue_size . . . . . . : %d",    ptr_client->outqueue_size);
+        weechat_log_printf ("  outqueue_count. . . . . . : %d",    ptr_client->outqueue_count);
+        weechat_log_printf ("  outqueue_keys . . . . . . : 0x%lx (hashtable: '%s')",
+                            ptr_client->outqueue_keys,
+                            weechat_hashtable_get_string (ptr_client->outqueue_keys,
+                                                          "keys_values"));
+        weechat_log_printf ("  msgs_coalesced. . . . . . : %d",    ptr_client->msgs_coalesced);
+        weechat_log_printf ("  msgs_dropped. . . . . . . : %d",    ptr_client->msgs_dropped);
         weechat_log_printf ("  prev_client . . . . . . . : 0x%lx", ptr_client->prev_client);
         weechat_log_printf ("  next_client . . . . . . . : 0x%lx", ptr_client->next_client);
     }
@@ -25,6 +25,7 @@
 #include <gnutls/gnutls.h>
 
 struct t_relay_server;
+struct t_relay_websocket_deflate;
 
 /* relay status */
 
@@ -67,12 +68,29 @@ enum t_relay_client_msg_type
     ((client->status == RELAY_STATUS_AUTH_FAILED) ||                    \
      (client->status == RELAY_STATUS_DISCONNECTED))
 
+/* max number of messages in outqueue sent with a single call to writev */
+
+#define RELAY_CLIENT_OUTQUEUE_IOV_MAX 64
+
+/* data sent to clients (can be shared by many outqueues) */
+
+struct t_relay_client_data
+{
+    char *buffer;                       /* data                             */
+    int size;                           /* number of bytes                  */
+    int refcount;                       /* number of references (data is    */
+                                        /* freed when it becomes 0)         */
+};
+
 /* output queue of messages to client */
 
 struct t_relay_client_outqueue
 {
-    char *data;                         /* data to send                     */
-    int data_size;                      /* number of bytes                  */
+    struct t_relay_client_data *data;   /* data to send                     */
+    int data_sent;                      /* number of bytes already sent     */
+    char *key;                          /* key to replace message by a      */
+                                        /* newer one (NULL if never         */
+                                        /* replaced)                        */
     int raw_msg_type[2];                /* msgs types                       */
     int raw_flags[2];                   /* flags for raw messages           */
     char *raw_message[2];               /* msgs for raw buffer (can be NULL)*/
@@ -95,6 +113,8 @@ struct t_relay_client
     int gnutls_handshake_ok;           /* 1 if handshake was done and OK    */
     int websocket;                     /* 0=not a ws, 1=init ws, 2=ws ready */
     struct t_hashtable *http_headers;  /* HTTP headers for websocket        */
+    struct t_relay_websocket_deflate *ws_deflate; /* websocket extension    */
+                                       /* "permessage-deflate"              */
     char *address;                     /* string with IP address            */
     char *real_ip;                     /* real IP (X-Real-IP HTTP header)   */
     enum t_relay_status status;        /* status (connecting, active,..)    */
@@ -109,7 +129,8 @@ struct t_relay_client
     time_t start_time;                 /* time of client connection         */
     time_t end_time;                   /* time of client disconnection      */
     struct t_hook *hook_fd;            /* hook for socket or child pipe     */
-    struct t_hook *hook_timer_send;    /* timer to quickly flush outqueue   */
+    int hook_fd_write;                 /* 1 if hook_fd waits for socket     */
+                                       /* ready for writing (outqueue)      */
     time_t last_activity;              /* time of last byte received/sent   */
     unsigned long long bytes_recv;     /* bytes received from client        */
     unsigned long long bytes_sent;     /* bytes sent to client              */
@@ -119,6 +140,12 @@ struct t_relay_client
     void *protocol_data;               /* data depending on protocol used   */
     struct t_relay_client_outqueue *outqueue; /* queue for outgoing msgs    */
     struct t_relay_client_outqueue *last_outqueue; /* last outgoing msg     */
+    int outqueue_size;                 /* bytes in outqueue (not yet sent)  */
+    int outqueue_count;                /* number of messages in outqueue    */
+    struct t_hashtable *outqueue_keys; /* keys of messages in outqueue      */
+    int msgs_coalesced;                /* msgs replaced in outqueue by a    */
+                                       /* newer one or merged (client slow) */
+    int msgs_dropped;                  /* msgs not sent (outqueue full)     */
     struct t_relay_client *prev_client;/* link to previous client           */
     struct t_relay_client *next_client;/* link to next client               */
 };
@@ -137,10 +164,25 @@ extern int relay_client_status_search (const char *name);
 extern int relay_client_count_active_by_port (int server_port);
 extern void relay_client_set_desc (struct t_relay_client *client);
 extern int relay_client_recv_cb (const void *pointer, void *data, int fd);
+extern struct t_relay_client_data *relay_client_data_new (char *buffer,
+                                                          int size,
+                                                          int copy);
+extern void relay_client_data_unref (struct t_relay_client_data *data);
+extern void relay_client_send_outqueue (struct t_relay_client *client);
+extern int relay_client_send_full (struct t_relay_client *client,
+                                   enum t_relay_client_msg_type msg_type,
+                                   const char *data, int data_size,
+                                   struct t_relay_client_data *shared_data,
+                                   const char *key,
+                                   const char *message_raw_buffer);
 extern int relay_client_send (struct t_relay_client *client,
                               enum t_relay_client_msg_type msg_type,
                               const char *data,
                               int data_size, const char *message_raw_buffer);
+extern int relay_client_send_data (struct t_relay_client *client,
+                                   enum t_relay_client_msg_type msg_type,
+                                   struct t_relay_client_data *data,
+                                   const char *message_raw_buffer);
 extern int relay_client_timer_cb (const void *pointer, void *data,
                                   int remaining_calls);
 extern struct t_relay_client *relay_client_new (int sock, const char *address,
@@ -152,6 +194,9 @@ extern void relay_client_free (struct t_relay_client *client);
 extern void relay_client_free_all ();
 extern void relay_client_disconnect (struct t_relay_client *client);
 extern void relay_client_disconnect_all ();
+extern struct t_hdata *relay_client_hdata_client_cb (const void *pointer,
+                                                     void *data,
+                                                     const char *hdata_name);
 extern int relay_client_add_to_infolist (struct t_infolist *infolist,
                                          struct t_relay_client *client);
 extern void relay_client_print_log ();
@@ -95,6 +95,13 @@ relay_command_client_list (int full)
                             date_activity,
                             ptr_client->bytes_recv,
                             ptr_client->bytes_sent);
+            weechat_printf (NULL,
+                            _("    outqueue: %d messages (%d bytes), "
+                              "messages coalesced: %d, dropped: %d"),
+                            ptr_client->outqueue_count,
+                            ptr_client->outqueue_size,
+                            ptr_client->msgs_coalesced,
+                            ptr_client->msgs_dropped);
         }
         else
         {
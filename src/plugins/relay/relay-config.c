@@ -34,9 +34,11 @@
 #include "relay-config.h"
 #include "relay-client.h"
 #include "relay-buffer.h"
+#include "relay-filter.h"
 #include "relay-network.h"
 #include "relay-server.h"
 #include "irc/relay-irc.h"
+#include "irc/relay-irc-backlog.h"
 
 
 struct t_config_file *relay_config_file = NULL;
@@ -75,9 +77,11 @@ struct t_config_option *relay_config_network_ssl_priorities;
 struct t_config_option *relay_config_network_totp_secret;
 struct t_config_option *relay_config_network_totp_window;
 struct t_config_option *relay_config_network_websocket_allowed_origins;
+struct t_config_option *relay_config_network_websocket_permessage_deflate;
 
 /* relay config, irc section */
 
+struct t_config_option *relay_config_irc_backlog_filter;
 struct t_config_option *relay_config_irc_backlog_max_minutes;
 struct t_config_option *relay_config_irc_backlog_max_number;
 struct t_config_option *relay_config_irc_backlog_since_last_disconnect;
@@ -88,12 +92,15 @@ struct t_config_option *relay_config_irc_backlog_time_format;
 /* relay config, weechat section */
 
 struct t_config_option *relay_config_weechat_commands;
+struct t_config_option *relay_config_weechat_cursor_page_max_size;
+struct t_config_option *relay_config_weechat_outqueue_max_size;
 
 /* other */
 
 regex_t *relay_config_regex_allowed_ips = NULL;
 regex_t *relay_config_regex_websocket_allowed_origins = NULL;
 struct t_hashtable *relay_config_hashtable_irc_backlog_tags = NULL;
+struct t_relay_filter *relay_config_filter_irc_backlog = NULL;
 char **relay_config_network_password_hash_algo_list = NULL;
 
 
@@ -407,6 +414,64 @@ relay_config_change_network_websocket_allowed_origins (const void *pointer, void
     }
 }
 
+/*
+ * Checks if IRC backlog filter is valid.
+ *
+ * Returns:
+ *   1: IRC backlog filter is valid
+ *   0: IRC backlog filter is not valid
+ */
+
+int
+relay_config_check_irc_backlog_filter (const void *pointer, void *data,
+                                       struct t_config_option *option,
+                                       const char *value)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    return relay_filter_valid (value);
+}
+
+/*
+ * Callback for changes on option "relay.irc.backlog_filter".
+ */
+
+void
+relay_config_change_irc_backlog_filter (const void *pointer, void *data,
+                                        struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    relay_filter_unref (relay_config_filter_irc_backlog);
+    relay_config_filter_irc_backlog = relay_filter_get (
+        weechat_config_string (relay_config_irc_backlog_filter));
+
+    relay_irc_backlog_clear_cache ();
+}
+
+/*
+ * Callback for changes on options "relay.irc.backlog_*" (backlogs built with
+ * the old value can not be reused).
+ */
+
+void
+relay_config_change_irc_backlog (const void *pointer, void *data,
+                                 struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    relay_irc_backlog_clear_cache ();
+}
+
 /*
  * Checks if IRC backlog tags are valid.
  *
@@ -502,6 +567,8 @@ relay_config_change_irc_backlog_tags (const void *pointer, void *data,
         }
         weechat_string_free_split (items);
     }
+
+    relay_irc_backlog_clear_cache ();
 }
 
 /*
@@ -1192,6 +1259,15 @@ relay_config_init ()
         NULL, NULL, NULL,
         &relay_config_change_network_websocket_allowed_origins, NULL, NULL,
         NULL, NULL, NULL);
+    relay_config_network_websocket_permessage_deflate = weechat_config_new_option (
+        relay_config_file, ptr_section,
+        "websocket_permessage_deflate", "boolean",
+        N_("enable websocket extension \"permessage-deflate\" (RFC 7692) "
+           "if the client asks for it: messages are compressed with the "
+           "level set in option relay.network.compression_level (the "
+           "extension is not used if compression level is 0)"),
+        NULL, 0, 0, "on", NULL, 0,
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
 
     /* section irc */
     ptr_section = weechat_config_new_section (relay_config_file, "irc",
@@ -1208,6 +1284,20 @@ relay_config_init ()
         return 0;
     }
 
+    relay_config_irc_backlog_filter = weechat_config_new_option (
+        relay_config_file, ptr_section,
+        "backlog_filter", "string",
+        N_("filter on lines displayed in backlog per IRC channel, options "
+           "separated by spaces: \"tags=xxx\": comma-separated list of tags "
+           "(\"+\" = logical \"and\", \"!\" = tag not in line, wildcard "
+           "\"*\" is allowed), \"notify=xxx\": minimum notify level "
+           "(\"low\", \"message\", \"private\" or \"highlight\"); "
+           "example: \"tags=!irc_smart_filter notify=message\" "
+           "(empty value = no filter)"),
+        NULL, 0, 0, "", NULL, 0,
+        &relay_config_check_irc_backlog_filter, NULL, NULL,
+        &relay_config_change_irc_backlog_filter, NULL, NULL,
+        NULL, NULL, NULL);
     relay_config_irc_backlog_max_minutes = weechat_config_new_option (
         relay_config_file, ptr_section,
         "backlog_max_minutes", "integer",
@@ -1215,26 +1305,34 @@ relay_config_init ()
            "(0 = unlimited, examples: 1440 = one day, 10080 = one week, "
            "43200 = one month, 525600 = one year)"),
         NULL, 0, INT_MAX, "0", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &relay_config_change_irc_backlog, NULL, NULL,
+        NULL, NULL, NULL);
     relay_config_irc_backlog_max_number = weechat_config_new_option (
         relay_config_file, ptr_section,
         "backlog_max_number", "integer",
         N_("maximum number of lines in backlog per IRC channel "
            "(0 = unlimited)"),
         NULL, 0, INT_MAX, "1024", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &relay_config_change_irc_backlog, NULL, NULL,
+        NULL, NULL, NULL);
     relay_config_irc_backlog_since_last_disconnect = weechat_config_new_option (
         relay_config_file, ptr_section,
         "backlog_since_last_disconnect", "boolean",
         N_("display backlog starting from last client disconnect"),
         NULL, 0, 0, "on", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &relay_config_change_irc_backlog, NULL, NULL,
+        NULL, NULL, NULL);
     relay_config_irc_backlog_since_last_message = weechat_config_new_option (
         relay_config_file, ptr_section,
         "backlog_since_last_message", "boolean",
         N_("display backlog starting from your last message"),
         NULL, 0, 0, "off", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &relay_config_change_irc_backlog, NULL, NULL,
+        NULL, NULL, NULL);
     relay_config_irc_backlog_tags = weechat_config_new_option (
         relay_config_file, ptr_section,
         "backlog_tags", "string",
@@ -1254,7 +1352,9 @@ relay_config_init ()
            "client, because time is sent as irc tag); empty string = disable "
            "time in backlog messages"),
         NULL, 0, 0, "[%H:%M] ", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &relay_config_change_irc_backlog, NULL, NULL,
+        NULL, NULL, NULL);
 
     /* section weechat */
     ptr_section = weechat_config_new_section (relay_config_file, "weechat",
@@ -1286,6 +1386,29 @@ relay_config_init ()
         NULL, NULL, NULL,
         NULL, NULL, NULL,
         NULL, NULL, NULL);
+    relay_config_weechat_cursor_page_max_size = weechat_config_new_option (
+        relay_config_file, ptr_section,
+        "cursor_page_max_size", "integer",
+        N_("maximum size of a page of hdata sent with command \"cursor\" "
+           "(in kilobytes): objects are added in the page until this size "
+           "is reached, the next objects are sent in next pages"),
+        NULL, 1, 64 * 1024, "256", NULL, 0,
+        NULL, NULL, NULL,
+        NULL, NULL, NULL,
+        NULL, NULL, NULL);
+    relay_config_weechat_outqueue_max_size = weechat_config_new_option (
+        relay_config_file, ptr_section,
+        "outqueue_max_size", "integer",
+        N_("maximum size of data waiting to be sent to a client (in "
+           "kilobytes); when this size is reached (client too slow), new "
+           "lines of buffers are not sent any more to this client and a "
+           "message \"_buffer_resync\" is sent for these buffers when all "
+           "data has been sent, so that the client can reload lines; "
+           "0 = no limit"),
+        NULL, 0, 1024 * 1024, "0", NULL, 0,
+        NULL, NULL, NULL,
+        NULL, NULL, NULL,
+        NULL, NULL, NULL);
 
     /* section port */
     ptr_section = weechat_config_new_section (
@@ -1341,6 +1464,7 @@ relay_config_read ()
         relay_config_change_network_allowed_ips (NULL, NULL, NULL);
         relay_config_change_network_password_hash_algo (NULL, NULL, NULL);
         relay_config_change_irc_backlog_tags (NULL, NULL, NULL);
+        relay_config_change_irc_backlog_filter (NULL, NULL, NULL);
     }
     return rc;
 }
@@ -1384,6 +1508,12 @@ relay_config_free ()
         relay_config_hashtable_irc_backlog_tags = NULL;
     }
 
+    if (relay_config_filter_irc_backlog)
+    {
+        relay_filter_unref (relay_config_filter_irc_backlog);
+        relay_config_filter_irc_backlog = NULL;
+    }
+
     if (relay_config_network_password_hash_algo_list)
     {
         weechat_string_free_split (relay_config_network_password_hash_algo_list);
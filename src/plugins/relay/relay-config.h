@@ -24,6 +24,8 @@
 
 #define RELAY_CONFIG_NAME "relay"
 
+struct t_relay_filter;
+
 extern struct t_config_file *relay_config_file;
 extern struct t_config_section *relay_config_section_port;
 extern struct t_config_section *relay_config_section_path;
@@ -54,7 +56,9 @@ extern struct t_config_option *relay_config_network_ssl_priorities;
 extern struct t_config_option *relay_config_network_totp_secret;
 extern struct t_config_option *relay_config_network_totp_window;
 extern struct t_config_option *relay_config_network_websocket_allowed_origins;
+extern struct t_config_option *relay_config_network_websocket_permessage_deflate;
 
+extern struct t_config_option *relay_config_irc_backlog_filter;
 extern struct t_config_option *relay_config_irc_backlog_max_minutes;
 extern struct t_config_option *relay_config_irc_backlog_max_number;
 extern struct t_config_option *relay_config_irc_backlog_since_last_disconnect;
@@ -63,10 +67,13 @@ extern struct t_config_option *relay_config_irc_backlog_tags;
 extern struct t_config_option *relay_config_irc_backlog_time_format;
 
 extern struct t_config_option *relay_config_weechat_commands;
+extern struct t_config_option *relay_config_weechat_cursor_page_max_size;
+extern struct t_config_option *relay_config_weechat_outqueue_max_size;
 
 extern regex_t *relay_config_regex_allowed_ips;
 extern regex_t *relay_config_regex_websocket_allowed_origins;
 extern struct t_hashtable *relay_config_hashtable_irc_backlog_tags;
+extern struct t_relay_filter *relay_config_filter_irc_backlog;
 extern char **relay_config_network_password_hash_algo_list;
 
 extern int relay_config_check_network_totp_secret (const void *pointer,
@@ -0,0 +1,490 @@
+/*
+ * relay-filter.c - filters on lines sent to clients
+ *
+ * Copyright (C) 2003-2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../weechat-plugin.h"
+#include "relay.h"
+#include "relay-filter.h"
+
+
+char *relay_filter_notify_level_string[RELAY_FILTER_NUM_NOTIFY_LEVELS] =
+{ "low", "message", "private", "highlight" };
+
+/* filters by string (shared between clients) */
+struct t_hashtable *relay_filters = NULL;
+
+/* compiled paths to read variables of lines */
+struct t_hdata_path *relay_filter_path_tags_array = NULL;
+struct t_hdata_path *relay_filter_path_notify_level = NULL;
+struct t_hdata_path *relay_filter_path_highlight = NULL;
+
+
+/*
+ * Searches for a notify level by name.
+ *
+ * Returns index of notify level found, -1 if not found.
+ */
+
+int
+relay_filter_search_notify_level (const char *level)
+{
+    int i;
+
+    if (!level)
+        return -1;
+
+    for (i = 0; i < RELAY_FILTER_NUM_NOTIFY_LEVELS; i++)
+    {
+        if (strcmp (relay_filter_notify_level_string[i], level) == 0)
+            return i;
+    }
+
+    /* notify level not found */
+    return -1;
+}
+
+/*
+ * Frees tags of a filter.
+ */
+
+void
+relay_filter_free_tags (int tags_count, char ***tags_array)
+{
+    int i;
+
+    if (!tags_array)
+        return;
+
+    for (i = 0; i < tags_count; i++)
+    {
+        if (tags_array[i])
+            weechat_string_free_split (tags_array[i]);
+    }
+    free (tags_array);
+}
+
+/*
+ * Parses a filter, which is a list of options separated by spaces:
+ *   tags=xxx    only lines matching tags are sent, tags are separated by
+ *               commas (logical "or") and "+" (logical "and"), a tag can
+ *               start with "!" (line must not have this tag) and can
+ *               contain wildcard "*"
+ *   notify=xxx  minimum notify level of lines sent: "low", "message",
+ *               "private" or "highlight" (highlights are always sent)
+ *
+ * Arguments tags_count, tags_array and notify_level can be NULL (the filter
+ * is only checked).
+ *
+ * Returns:
+ *   1: filter OK
+ *   0: invalid filter
+ */
+
+int
+relay_filter_parse (const char *string, int *tags_count, char ****tags_array,
+                    int *notify_level)
+{
+    char **items, **tags, ***array, *pos;
+    int rc, num_items, num_tags, i, j, level;
+
+    if (tags_count)
+        *tags_count = 0;
+    if (tags_array)
+        *tags_array = NULL;
+    if (notify_level)
+        *notify_level = -1;
+
+    if (!string)
+        return 0;
+
+    items = weechat_string_split (string, " ", NULL,
+                                  WEECHAT_STRING_SPLIT_STRIP_LEFT
+                                  | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                                  | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+                                  0, &num_items);
+    if (!items)
+        return 0;
+
+    rc = 1;
+    for (i = 0; i < num_items; i++)
+    {
+        pos = strchr (items[i], '=');
+        if (!pos || !pos[1])
+        {
+            rc = 0;
+            break;
+        }
+        pos[0] = '\0';
+        pos++;
+        if (strcmp (items[i], "tags") == 0)
+        {
+            tags = weechat_string_split (pos, ",", NULL,
+                                         WEECHAT_STRING_SPLIT_STRIP_LEFT
+                                         | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                                         | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+                                         0, &num_tags);
+            if (!tags)
+            {
+                rc = 0;
+                break;
+            }
+            if (tags_count && tags_array)
+            {
+                relay_filter_free_tags (*tags_count, *tags_array);
+                *tags_count = 0;
+                *tags_array = NULL;
+                array = malloc (num_tags * sizeof (*array));
+                if (array)
+                {
+                    for (j = 0; j < num_tags; j++)
+                    {
+                        array[j] = weechat_string_split (
+                            tags[j], "+", NULL,
+                            WEECHAT_STRING_SPLIT_STRIP_LEFT
+                            | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                            | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+                            0, NULL);
+                        if (!array[j])
+                            break;
+                    }
+                    *tags_count = j;
+                    *tags_array = array;
+                }
+                if (*tags_count < num_tags)
+                    rc = 0;
+            }
+            weechat_string_free_split (tags);
+            if (!rc)
+                break;
+        }
+        else if (strcmp (items[i], "notify") == 0)
+        {
+            level = relay_filter_search_notify_level (pos);
+            if (level < 0)
+            {
+                rc = 0;
+                break;
+            }
+            if (notify_level)
+                *notify_level = level;
+        }
+        else
+        {
+            /* unknown option */
+            rc = 0;
+            break;
+        }
+    }
+
+    weechat_string_free_split (items);
+
+    if (!rc && tags_count && tags_array)
+    {
+        relay_filter_free_tags (*tags_count, *tags_array);
+        *tags_count = 0;
+        *tags_array = NULL;
+    }
+
+    return rc;
+}
+
+/*
+ * Checks if a filter is valid.
+ *
+ * Returns:
+ *   1: filter is valid (or empty)
+ *   0: filter is invalid
+ */
+
+int
+relay_filter_valid (const char *string)
+{
+    if (!string || !string[0])
+        return 1;
+
+    return relay_filter_parse (string, NULL, NULL, NULL);
+}
+
+/*
+ * Gets a filter: if a filter with same string already exists, it is shared
+ * (its reference count is incremented), otherwise a new filter is compiled.
+ *
+ * The filter must be released with relay_filter_unref.
+ *
+ * Returns pointer to filter, NULL if string is empty or if the filter is
+ * invalid.
+ */
+
+struct t_relay_filter *
+relay_filter_get (const char *string)
+{
+    struct t_relay_filter *new_filter;
+
+    if (!string || !string[0])
+        return NULL;
+
+    if (!relay_filters)
+    {
+        relay_filters = weechat_hashtable_new (32,
+                                               WEECHAT_HASHTABLE_STRING,
+                                               WEECHAT_HASHTABLE_POINTER,
+                                               NULL, NULL);
+        if (!relay_filters)
+            return NULL;
+    }
+
+    new_filter = weechat_hashtable_get (relay_filters, string);
+    if (new_filter)
+    {
+        new_filter->refcount++;
+        return new_filter;
+    }
+
+    new_filter = malloc (sizeof (*new_filter));
+    if (!new_filter)
+        return NULL;
+
+    if (!relay_filter_parse (string, &new_filter->tags_count,
+                             &new_filter->tags_array,
+                             &new_filter->notify_level))
+    {
+        free (new_filter);
+        return NULL;
+    }
+    new_filter->string = strdup (string);
+    new_filter->refcount = 1;
+
+    weechat_hashtable_set (relay_filters, string, new_filter);
+
+    return new_filter;
+}
+
+/*
+ * Releases a reference to a filter: the filter is freed when it is not used
+ * any more.
+ */
+
+void
+relay_filter_unref (struct t_relay_filter *filter)
+{
+    if (!filter)
+        return;
+
+    filter->refcount--;
+    if (filter->refcount > 0)
+        return;
+
+    if (relay_filters)
+        weechat_hashtable_remove (relay_filters, filter->string);
+
+    if (filter->string)
+        free (filter->string);
+    relay_filter_free_tags (filter->tags_count, filter->tags_array);
+
+    free (filter);
+}
+
+/*
+ * Compiles paths used to read variables of lines.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+relay_filter_compile_paths ()
+{
+    struct t_hdata *ptr_hdata;
+
+    if (relay_filter_path_tags_array
+        && relay_filter_path_notify_level
+        && relay_filter_path_highlight)
+    {
+        return 1;
+    }
+
+    ptr_hdata = weechat_hdata_get ("line_data");
+    if (!ptr_hdata)
+        return 0;
+
+    if (!relay_filter_path_tags_array)
+    {
+        relay_filter_path_tags_array = weechat_hdata_path_compile (
+            ptr_hdata, "tags_array");
+    }
+    if (!relay_filter_path_notify_level)
+    {
+        relay_filter_path_notify_level = weechat_hdata_path_compile (
+            ptr_hdata, "notify_level");
+    }
+    if (!relay_filter_path_highlight)
+    {
+        relay_filter_path_highlight = weechat_hdata_path_compile (
+            ptr_hdata, "highlight");
+    }
+
+    return (relay_filter_path_tags_array
+            && relay_filter_path_notify_level
+            && relay_filter_path_highlight) ? 1 : 0;
+}
+
+/*
+ * Checks if tags of a line match tags of filter (same rules as tags in
+ * WeeChat filters).
+ *
+ * Returns:
+ *   1: tags match
+ *   0: tags do not match
+ */
+
+int
+relay_filter_match_tags (struct t_relay_filter *filter, void *line_data)
+{
+    int i, j, k, num_tags, match, tag_found, tag_negated;
+    const char *ptr_tag;
+    char **ptr_line_tag;
+
+    num_tags = weechat_hdata_path_get_array_size (relay_filter_path_tags_array,
+                                                  line_data);
+
+    for (i = 0; i < filter->tags_count; i++)
+    {
+        match = 1;
+        for (j = 0; filter->tags_array[i][j]; j++)
+        {
+            ptr_tag = filter->tags_array[i][j];
+            tag_found = 0;
+            tag_negated = 0;
+
+            /* check if tag is negated (prefixed with a '!') */
+            if ((ptr_tag[0] == '!') && ptr_tag[1])
+            {
+                ptr_tag++;
+                tag_negated = 1;
+            }
+
+            if (strcmp (ptr_tag, "*") == 0)
+            {
+                tag_found = 1;
+            }
+            else
+            {
+                for (k = 0; k < num_tags; k++)
+                {
+                    ptr_line_tag = weechat_hdata_path_get_value (
+                        relay_filter_path_tags_array, line_data, k);
+                    if (ptr_line_tag && *ptr_line_tag
+                        && weechat_string_match (*ptr_line_tag, ptr_tag, 0))
+                    {
+                        tag_found = 1;
+                        break;
+                    }
+                }
+            }
+            if (tag_found && tag_negated)
+                return 0;
+            if ((!tag_found && !tag_negated) || (tag_found && tag_negated))
+            {
+                match = 0;
+                break;
+            }
+        }
+        if (match)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Checks if a line (pointer to "line_data") matches a filter.
+ *
+ * Returns:
+ *   1: line matches filter (it must be sent)
+ *   0: line does not match filter (it must not be sent)
+ */
+
+int
+relay_filter_match_line (struct t_relay_filter *filter, void *line_data)
+{
+    char *ptr_notify_level, *ptr_highlight;
+    int notify_level;
+
+    /* no filter: all lines are sent */
+    if (!filter)
+        return 1;
+
+    if (!line_data || !relay_filter_compile_paths ())
+        return 0;
+
+    if (filter->notify_level >= 0)
+    {
+        ptr_highlight = weechat_hdata_path_get_value (
+            relay_filter_path_highlight, line_data, -1);
+        ptr_notify_level = weechat_hdata_path_get_value (
+            relay_filter_path_notify_level, line_data, -1);
+        notify_level = (ptr_highlight && *ptr_highlight) ?
+            RELAY_FILTER_NUM_NOTIFY_LEVELS - 1 :
+            ((ptr_notify_level) ? (int)(*ptr_notify_level) : -1);
+        if (notify_level < filter->notify_level)
+            return 0;
+    }
+
+    if ((filter->tags_count > 0)
+        && !relay_filter_match_tags (filter, line_data))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Frees compiled paths and hashtable with filters.
+ */
+
+void
+relay_filter_end ()
+{
+    if (relay_filter_path_tags_array)
+    {
+        weechat_hdata_path_free (relay_filter_path_tags_array);
+        relay_filter_path_tags_array = NULL;
+    }
+    if (relay_filter_path_notify_level)
+    {
+        weechat_hdata_path_free (relay_filter_path_notify_level);
+        relay_filter_path_notify_level = NULL;
+    }
+    if (relay_filter_path_highlight)
+    {
+        weechat_hdata_path_free (relay_filter_path_highlight);
+        relay_filter_path_highlight = NULL;
+    }
+    if (relay_filters)
+    {
+        weechat_hashtable_free (relay_filters);
+        relay_filters = NULL;
+    }
+}
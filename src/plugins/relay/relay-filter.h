@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2003-2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_RELAY_FILTER_H
+#define WEECHAT_PLUGIN_RELAY_FILTER_H
+
+#define RELAY_FILTER_NUM_NOTIFY_LEVELS 4
+
+/* filter on lines, compiled once and shared by clients using same string */
+
+struct t_relay_filter
+{
+    char *string;                      /* filter (key in hashtable)         */
+    int tags_count;                    /* number of tags groups (OR)        */
+    char ***tags_array;                /* tags in each group (AND)          */
+    int notify_level;                  /* minimum notify level of line      */
+                                       /* (-1 = any level)                  */
+    int refcount;                      /* number of references to filter   */
+};
+
+extern char *relay_filter_notify_level_string[];
+
+extern int relay_filter_search_notify_level (const char *level);
+extern int relay_filter_valid (const char *string);
+extern struct t_relay_filter *relay_filter_get (const char *string);
+extern void relay_filter_unref (struct t_relay_filter *filter);
+extern int relay_filter_match_line (struct t_relay_filter *filter,
+                                    void *line_data);
+extern void relay_filter_end ();
+
+#endif /* WEECHAT_PLUGIN_RELAY_FILTER_H */
@@ -166,7 +166,7 @@ relay_info_infolist_relay_cb (const void *pointer, void *data,
 }
 
 /*
- * Hooks infolist for relay plugin.
+ * Hooks info, infolist and hdata for relay plugin.
  */
 
 void
@@ -188,4 +188,9 @@ relay_info_init ()
         N_("relay pointer (optional)"),
         NULL,
         &relay_info_infolist_relay_cb, NULL, NULL);
+
+    /* hdata hooks */
+    weechat_hook_hdata (
+        "relay_client", N_("relay client"),
+        &relay_client_hdata_client_cb, NULL, NULL);
 }
@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <zlib.h>
 
 #include "../weechat-plugin.h"
 #include "relay.h"
@@ -104,6 +105,75 @@ relay_websocket_save_header (struct t_relay_client *client,
     free (name);
 }
 
+/*
+ * Allocates a structure for websocket extension "permessage-deflate"
+ * (not enabled by default).
+ *
+ * Returns pointer to new structure, NULL if error.
+ */
+
+struct t_relay_websocket_deflate *
+relay_websocket_deflate_alloc ()
+{
+    struct t_relay_websocket_deflate *new_ws_deflate;
+
+    new_ws_deflate = malloc (sizeof (*new_ws_deflate));
+    if (!new_ws_deflate)
+        return NULL;
+
+    new_ws_deflate->strm_deflate = NULL;
+    new_ws_deflate->strm_inflate = NULL;
+    relay_websocket_deflate_reinit (new_ws_deflate);
+
+    return new_ws_deflate;
+}
+
+/*
+ * Reinitializes "permessage-deflate" with default values (not enabled) and
+ * frees the streams.
+ */
+
+void
+relay_websocket_deflate_reinit (struct t_relay_websocket_deflate *ws_deflate)
+{
+    if (!ws_deflate)
+        return;
+
+    ws_deflate->enabled = 0;
+    ws_deflate->server_context_takeover = 1;
+    ws_deflate->client_context_takeover = 1;
+    ws_deflate->window_bits_deflate = WEBSOCKET_DEFLATE_WINDOW_BITS_MAX;
+    ws_deflate->window_bits_inflate = WEBSOCKET_DEFLATE_WINDOW_BITS_MAX;
+    ws_deflate->server_max_window_bits_recv = 0;
+    if (ws_deflate->strm_deflate)
+    {
+        deflateEnd (ws_deflate->strm_deflate);
+        free (ws_deflate->strm_deflate);
+        ws_deflate->strm_deflate = NULL;
+    }
+    if (ws_deflate->strm_inflate)
+    {
+        inflateEnd (ws_deflate->strm_inflate);
+        free (ws_deflate->strm_inflate);
+        ws_deflate->strm_inflate = NULL;
+    }
+}
+
+/*
+ * Frees a structure for "permessage-deflate".
+ */
+
+void
+relay_websocket_deflate_free (struct t_relay_websocket_deflate *ws_deflate)
+{
+    if (!ws_deflate)
+        return;
+
+    relay_websocket_deflate_reinit (ws_deflate);
+
+    free (ws_deflate);
+}
+
 /*
  * Checks if a client handshake is valid.
  *
@@ -170,6 +240,135 @@ relay_websocket_client_handshake_valid (struct t_relay_client *client)
     return 0;
 }
 
+/*
+ * Parses HTTP header "Sec-WebSocket-Extensions" sent by client, and enables
+ * extension "permessage-deflate" (RFC 7692) if it is offered with parameters
+ * that are supported.
+ *
+ * The header can contain multiple offers, for example:
+ *   permessage-deflate; client_max_window_bits, permessage-deflate
+ *
+ * The first offer accepted is used.
+ */
+
+void
+relay_websocket_parse_extensions (const char *extensions,
+                                  struct t_relay_websocket_deflate *ws_deflate)
+{
+    char **exts, **params, **items, *error;
+    int num_exts, num_params, num_items, i, j, accepted, flags;
+    int server_context_takeover, client_context_takeover;
+    int window_bits_deflate, window_bits_inflate, server_max_window_bits_recv;
+    long bits;
+
+    if (!extensions || !ws_deflate)
+        return;
+
+    flags = WEECHAT_STRING_SPLIT_STRIP_LEFT
+        | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+        | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS;
+
+    exts = weechat_string_split (extensions, ",", " ", flags, 0, &num_exts);
+    if (!exts)
+        return;
+
+    for (i = 0; i < num_exts; i++)
+    {
+        params = weechat_string_split (exts[i], ";", " ", flags, 0,
+                                       &num_params);
+        if (!params)
+            continue;
+        if ((num_params < 1)
+            || (weechat_strcasecmp (params[0], "permessage-deflate") != 0))
+        {
+            weechat_string_free_split (params);
+            continue;
+        }
+        accepted = 1;
+        server_context_takeover = 1;
+        client_context_takeover = 1;
+        window_bits_deflate = WEBSOCKET_DEFLATE_WINDOW_BITS_MAX;
+        window_bits_inflate = WEBSOCKET_DEFLATE_WINDOW_BITS_MAX;
+        server_max_window_bits_recv = 0;
+        for (j = 1; accepted && (j < num_params); j++)
+        {
+            items = weechat_string_split (params[j], "=", " \"", flags, 2,
+                                          &num_items);
+            if (!items || (num_items < 1))
+            {
+                accepted = 0;
+            }
+            else if (strcmp (items[0], "server_no_context_takeover") == 0)
+            {
+                server_context_takeover = 0;
+            }
+            else if (strcmp (items[0], "client_no_context_takeover") == 0)
+            {
+                client_context_takeover = 0;
+            }
+            else if (strcmp (items[0], "server_max_window_bits") == 0)
+            {
+                /*
+                 * a window of 256 bytes (8 bits) is not supported by zlib
+                 * for raw deflate: the offer is declined in this case
+                 */
+                error = NULL;
+                bits = (num_items > 1) ? strtol (items[1], &error, 10) : 0;
+                if (error && !error[0]
+                    && (bits > WEBSOCKET_DEFLATE_WINDOW_BITS_MIN)
+                    && (bits <= WEBSOCKET_DEFLATE_WINDOW_BITS_MAX))
+                {
+                    window_bits_deflate = bits;
+                    server_max_window_bits_recv = 1;
+                }
+                else
+                {
+                    accepted = 0;
+                }
+            }
+            else if (strcmp (items[0], "client_max_window_bits") == 0)
+            {
+                /* value is optional */
+                if (num_items > 1)
+                {
+                    error = NULL;
+                    bits = strtol (items[1], &error, 10);
+                    if (error && !error[0]
+                        && (bits >= WEBSOCKET_DEFLATE_WINDOW_BITS_MIN)
+                        && (bits <= WEBSOCKET_DEFLATE_WINDOW_BITS_MAX))
+                    {
+                        window_bits_inflate = bits;
+                    }
+                    else
+                    {
+                        accepted = 0;
+                    }
+                }
+            }
+            else
+            {
+                /* unknown parameter */
+                accepted = 0;
+            }
+            if (items)
+                weechat_string_free_split (items);
+        }
+        weechat_string_free_split (params);
+        if (accepted)
+        {
+            ws_deflate->enabled = 1;
+            ws_deflate->server_context_takeover = server_context_takeover;
+            ws_deflate->client_context_takeover = client_context_takeover;
+            ws_deflate->window_bits_deflate = window_bits_deflate;
+            ws_deflate->window_bits_inflate = window_bits_inflate;
+            ws_deflate->server_max_window_bits_recv = server_max_window_bits_recv;
+            break;
+        }
+    }
+
+    weechat_string_free_split (exts);
+}
+
 /*
  * Builds the handshake that will be returned to client, to initialize and use
  * the websocket.
@@ -179,6 +378,11 @@ relay_websocket_client_handshake_valid (struct t_relay_client *client)
  *   Upgrade: websocket
  *   Connection: Upgrade
  *   Sec-WebSocket-Accept: 73OzoF/IyV9znm7Tsb4EtlEEmn4=
+ *   Sec-WebSocket-Extensions: permessage-deflate
+ *
+ * The header "Sec-WebSocket-Extensions" is sent only if the extension
+ * "permessage-deflate" has been accepted (see function
+ * relay_websocket_parse_extensions).
  *
  * Note: result must be freed after use.
  */
@@ -188,6 +392,7 @@ relay_websocket_build_handshake (struct t_relay_client *client)
 {
     const char *sec_websocket_key;
     char *key, sec_websocket_accept[128], handshake[1024], hash[160 / 8];
+    char extensions[256], str_param[64];
     int length, hash_size;
 
     sec_websocket_key = weechat_hashtable_get (client->http_headers,
@@ -220,14 +425,47 @@ relay_websocket_build_handshake (struct t_relay_client *client)
 
     free (key);
 
+    /* build header with the extension accepted */
+    extensions[0] = '\0';
+    if (client->ws_deflate && client->ws_deflate->enabled)
+    {
+        snprintf (extensions, sizeof (extensions),
+                  "Sec-WebSocket-Extensions: permessage-deflate");
+        if (!client->ws_deflate->server_context_takeover)
+        {
+            strcat (extensions, "; server_no_context_takeover");
+        }
+        if (!client->ws_deflate->client_context_takeover)
+        {
+            strcat (extensions, "; client_no_context_takeover");
+        }
+        if (client->ws_deflate->server_max_window_bits_recv)
+        {
+            snprintf (str_param, sizeof (str_param),
+                      "; server_max_window_bits=%d",
+                      client->ws_deflate->window_bits_deflate);
+            strcat (extensions, str_param);
+        }
+        if (client->ws_deflate->window_bits_inflate < WEBSOCKET_DEFLATE_WINDOW_BITS_MAX)
+        {
+            snprintf (str_param, sizeof (str_param),
+                      "; client_max_window_bits=%d",
+                      client->ws_deflate->window_bits_inflate);
+            strcat (extensions, str_param);
+        }
+        strcat (extensions, "\r\n");
+    }
+
     /* build the handshake (it will be sent as-is to client) */
     snprintf (handshake, sizeof (handshake),
               "HTTP/1.1 101 Switching Protocols\r\n"
               "Upgrade: websocket\r\n"
               "Connection: Upgrade\r\n"
               "Sec-WebSocket-Accept: %s\r\n"
+              "%s"
               "\r\n",
-              sec_websocket_accept);
+              sec_websocket_accept,
+              extensions);
 
     return strdup (handshake);
 }
@@ -258,23 +496,303 @@ relay_websocket_send_http (struct t_relay_client *client,
 }
 
 /*
- * Decodes a websocket frame.
+ * Initializes the stream used to compress messages sent to client.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+relay_websocket_deflate_init_stream_deflate (struct t_relay_websocket_deflate *ws_deflate)
+{
+    int level;
+
+    ws_deflate->strm_deflate = calloc (1, sizeof (*ws_deflate->strm_deflate));
+    if (!ws_deflate->strm_deflate)
+        return 0;
+
+    level = weechat_config_integer (relay_config_network_compression_level);
+
+    /* negative window bits: raw deflate (no zlib header) */
+    if (deflateInit2 (ws_deflate->strm_deflate, level, Z_DEFLATED,
+                      -(ws_deflate->window_bits_deflate), 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        free (ws_deflate->strm_deflate);
+        ws_deflate->strm_deflate = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Initializes the stream used to decompress messages received from client.
+ *
+ * The maximum window is always used: it can decompress data compressed with
+ * any smaller window.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+relay_websocket_deflate_init_stream_inflate (struct t_relay_websocket_deflate *ws_deflate)
+{
+    ws_deflate->strm_inflate = calloc (1, sizeof (*ws_deflate->strm_inflate));
+    if (!ws_deflate->strm_inflate)
+        return 0;
+
+    /* negative window bits: raw inflate (no zlib header) */
+    if (inflateInit2 (ws_deflate->strm_inflate,
+                      -WEBSOCKET_DEFLATE_WINDOW_BITS_MAX) != Z_OK)
+    {
+        free (ws_deflate->strm_inflate);
+        ws_deflate->strm_inflate = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Compresses a message with "permessage-deflate": the data is compressed
+ * and flushed, then the 4 bytes 0x00 0x00 0xFF 0xFF added by the flush are
+ * removed (RFC 7692, section 7.2.1).
+ *
+ * Returns compressed data, NULL if error.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+relay_websocket_deflate (const void *data, unsigned long long size,
+                         struct t_relay_websocket_deflate *ws_deflate,
+                         unsigned long long *size_deflated)
+{
+    z_stream *strm;
+    char *dest, *dest2;
+    unsigned long long dest_alloc;
+    int rc;
+
+    *size_deflated = 0;
+
+    if (!data || !ws_deflate)
+        return NULL;
+
+    if (!ws_deflate->strm_deflate
+        && !relay_websocket_deflate_init_stream_deflate (ws_deflate))
+    {
+        return NULL;
+    }
+
+    strm = ws_deflate->strm_deflate;
+
+    dest_alloc = compressBound (size) + 16;
+    dest = malloc (dest_alloc);
+    if (!dest)
+        return NULL;
+
+    strm->next_in = (Bytef *)data;
+    strm->avail_in = size;
+    strm->next_out = (Bytef *)dest;
+    strm->avail_out = dest_alloc;
+    while (1)
+    {
+        rc = deflate (strm, Z_SYNC_FLUSH);
+        if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+            break;
+        if ((strm->avail_in == 0) && (strm->avail_out > 0))
+            break;
+        /* output buffer is full: make it bigger */
+        dest2 = realloc (dest, dest_alloc * 2);
+        if (!dest2)
+        {
+            rc = Z_MEM_ERROR;
+            break;
+        }
+        dest = dest2;
+        strm->next_out = (Bytef *)(dest + dest_alloc);
+        strm->avail_out = dest_alloc;
+        dest_alloc *= 2;
+    }
+
+    if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+    {
+        /* stream is in an unknown state: a new one will be created */
+        deflateEnd (strm);
+        free (strm);
+        ws_deflate->strm_deflate = NULL;
+        free (dest);
+        return NULL;
+    }
+
+    *size_deflated = dest_alloc - strm->avail_out;
+
+    /* remove the 4 bytes added by the flush */
+    if ((*size_deflated >= 4)
+        && (memcmp (dest + *size_deflated - 4, "\x00\x00\xff\xff", 4) == 0))
+    {
+        *size_deflated -= 4;
+    }
+
+    if (!ws_deflate->server_context_takeover)
+        deflateReset (strm);
+
+    return dest;
+}
+
+/*
+ * Decompresses a message compressed with "permessage-deflate": the 4 bytes
+ * 0x00 0x00 0xFF 0xFF are added at the end of data before decompression
+ * (RFC 7692, section 7.2.2).
+ *
+ * Returns decompressed data, NULL if error.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+relay_websocket_inflate (const void *data, unsigned long long size,
+                         struct t_relay_websocket_deflate *ws_deflate,
+                         unsigned long long *size_inflated)
+{
+    z_stream *strm;
+    char *dest, *dest2;
+    Bytef dict[WEBSOCKET_DEFLATE_WINDOW_SIZE_MAX];
+    uInt dict_size;
+    unsigned long long dest_alloc;
+    int i, rc, stream_end;
+
+    *size_inflated = 0;
+
+    if (!data || !ws_deflate)
+        return NULL;
+
+    if (!ws_deflate->strm_inflate
+        && !relay_websocket_deflate_init_stream_inflate (ws_deflate))
+    {
+        return NULL;
+    }
+
+    strm = ws_deflate->strm_inflate;
+
+    dest_alloc = (size * 4 > 1024) ? size * 4 : 1024;
+    dest = malloc (dest_alloc);
+    if (!dest)
+        return NULL;
+
+    rc = Z_OK;
+    stream_end = 0;
+    strm->next_out = (Bytef *)dest;
+    strm->avail_out = dest_alloc;
+    for (i = 0; (i < 2) && !stream_end; i++)
+    {
+        strm->next_in = (i == 0) ?
+            (Bytef *)data : (Bytef *)"\x00\x00\xff\xff";
+        strm->avail_in = (i == 0) ? size : 4;
+        while (1)
+        {
+            rc = inflate (strm, Z_SYNC_FLUSH);
+            if (rc == Z_STREAM_END)
+            {
+                /* last block received (BFINAL bit set by client) */
+                stream_end = 1;
+                break;
+            }
+            if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+                break;
+            if (strm->avail_out > 0)
+            {
+                if ((strm->avail_in == 0) || (rc == Z_BUF_ERROR))
+                    break;
+                continue;
+            }
+            /* output buffer is full: make it bigger */
+            dest2 = realloc (dest, dest_alloc * 2);
+            if (!dest2)
+            {
+                rc = Z_MEM_ERROR;
+                break;
+            }
+            dest = dest2;
+            strm->next_out = (Bytef *)(dest + dest_alloc);
+            strm->avail_out = dest_alloc;
+            dest_alloc *= 2;
+        }
+        if ((rc != Z_OK) && (rc != Z_BUF_ERROR) && (rc != Z_STREAM_END))
+            break;
+    }
+
+    if ((rc != Z_OK) && (rc != Z_BUF_ERROR) && (rc != Z_STREAM_END))
+    {
+        /* invalid data: the connection will be closed */
+        free (dest);
+        return NULL;
+    }
+
+    *size_inflated = dest_alloc - strm->avail_out;
+
+    if (!ws_deflate->client_context_takeover)
+    {
+        inflateReset (strm);
+    }
+    else if (stream_end)
+    {
+        /* new stream for next message, keeping the sliding window */
+        dict_size = 0;
+        if (inflateGetDictionary (strm, dict, &dict_size) != Z_OK)
+            dict_size = 0;
+        inflateReset (strm);
+        if (dict_size > 0)
+            inflateSetDictionary (strm, dict, dict_size);
+    }
+
+    return dest;
+}
+
+/*
+ * Decodes websocket frames.
+ *
+ * If a frame has bit RSV1 set, it is decompressed with "permessage-deflate"
+ * (this is an error if the extension has not been negotiated).
+ *
+ * Argument "decoded" is set with the decoded data: for each frame, the
+ * message type (one byte), the data and a final '\0'.
  *
  * Returns:
  *   1: frame decoded successfully
  *   0: error decoding frame (connection must be closed if it happens)
+ *
+ * Note: *decoded must be freed after use (even if an error is returned).
  */
 
 int
-relay_websocket_decode_frame (const unsigned char *buffer,
+relay_websocket_decode_frame (struct t_relay_websocket_deflate *ws_deflate,
+                              const unsigned char *buffer,
                               unsigned long long buffer_length,
-                              unsigned char *decoded,
+                              unsigned char **decoded,
                               unsigned long long *decoded_length)
 {
     unsigned long long i, index_buffer, length_frame_size, length_frame;
-    unsigned char opcode;
+    unsigned long long decoded_alloc, size_inflated;
+    unsigned char opcode, *ptr_data, *decoded2;
+    char *inflated;
+    int masks[4], compressed;
 
     *decoded_length = 0;
+
+    /*
+     * without compression, decoded data is never longer than the buffer
+     * (message type and final '\0' take less space than frame header)
+     */
+    decoded_alloc = buffer_length + 1;
+    *decoded = malloc (decoded_alloc);
+    if (!*decoded)
+        return 0;
+
     index_buffer = 0;
 
     /* loop to decode all frames in message */
@@ -282,6 +800,21 @@ relay_websocket_decode_frame (const unsigned char *buffer,
     {
         opcode = buffer[index_buffer] & 15;
 
+        /* bits RSV2 and RSV3 are not used by any extension */
+        if (buffer[index_buffer] & 0x30)
+            return 0;
+
+        /*
+         * bit RSV1 means compressed message, allowed only if
+         * "permessage-deflate" is enabled and only for data frames
+         */
+        compressed = (buffer[index_buffer] & 0x40) ? 1 : 0;
+        if (compressed
+            && (!ws_deflate || !ws_deflate->enabled || (opcode & 0x08)))
+        {
+            return 0;
+        }
+
         /*
          * check if frame is masked: client MUST send a masked frame; if frame is
          * not masked, we MUST reject it and close the connection (see RFC 6455)
@@ -296,7 +829,7 @@ relay_websocket_decode_frame (const unsigned char *buffer,
         if ((length_frame == 126) || (length_frame == 127))
         {
             length_frame_size = (length_frame == 126) ? 2 : 8;
-            if (buffer_length < 1 + length_frame_size)
+            if (index_buffer + length_frame_size > buffer_length)
                 return 0;
             length_frame = 0;
             for (i = 0; i < length_frame_size; i++)
@@ -306,11 +839,13 @@ relay_websocket_decode_frame (const unsigned char *buffer,
             index_buffer += length_frame_size;
         }
 
-        if (buffer_length < 1 + length_frame_size + 4 + length_frame)
+        if ((index_buffer + 4 > buffer_length)
+            || (length_frame > buffer_length - index_buffer - 4))
+        {
             return 0;
+        }
 
         /* read masks (4 bytes) */
-        int masks[4];
         for (i = 0; i < 4; i++)
         {
             masks[i] = (int)((unsigned char)buffer[index_buffer + i]);
@@ -321,25 +856,53 @@ relay_websocket_decode_frame (const unsigned char *buffer,
         switch (opcode)
         {
             case WEBSOCKET_FRAME_OPCODE_PING:
-                decoded[*decoded_length] = RELAY_CLIENT_MSG_PING;
+                (*decoded)[*decoded_length] = RELAY_CLIENT_MSG_PING;
                 break;
             case WEBSOCKET_FRAME_OPCODE_CLOSE:
-                decoded[*decoded_length] = RELAY_CLIENT_MSG_CLOSE;
+                (*decoded)[*decoded_length] = RELAY_CLIENT_MSG_CLOSE;
                 break;
             default:
-                decoded[*decoded_length] = RELAY_CLIENT_MSG_STANDARD;
+                (*decoded)[*decoded_length] = RELAY_CLIENT_MSG_STANDARD;
                 break;
         }
         *decoded_length += 1;
 
         /* decode data using masks */
+        ptr_data = *decoded + *decoded_length;
         for (i = 0; i < length_frame; i++)
         {
-            decoded[*decoded_length + i] = (int)((unsigned char)buffer[index_buffer + i]) ^ masks[i % 4];
+            ptr_data[i] = (int)((unsigned char)buffer[index_buffer + i]) ^ masks[i % 4];
         }
-        decoded[*decoded_length + length_frame] = '\0';
-        *decoded_length += length_frame + 1;
         index_buffer += length_frame;
+
+        /* decompress data */
+        if (compressed)
+        {
+            inflated = relay_websocket_inflate (ptr_data, length_frame,
+                                                ws_deflate, &size_inflated);
+            if (!inflated)
+                return 0;
+            if (*decoded_length + size_inflated + 1
+                + (buffer_length - index_buffer) + 1 > decoded_alloc)
+            {
+                decoded_alloc = *decoded_length + size_inflated + 1
+                    + (buffer_length - index_buffer) + 1;
+                decoded2 = realloc (*decoded, decoded_alloc);
+                if (!decoded2)
+                {
+                    free (inflated);
+                    return 0;
+                }
+                *decoded = decoded2;
+                ptr_data = *decoded + *decoded_length;
+            }
+            memcpy (ptr_data, inflated, size_inflated);
+            free (inflated);
+            length_frame = size_inflated;
+        }
+
+        ptr_data[length_frame] = '\0';
+        *decoded_length += length_frame + 1;
     }
 
     return 1;
@@ -348,6 +911,9 @@ relay_websocket_decode_frame (const unsigned char *buffer,
 /*
  * Encodes data in a websocket frame.
  *
+ * If "permessage-deflate" is enabled, data frames (text and binary) are
+ * compressed (bit RSV1 is set).
+ *
  * Returns websocket frame, NULL if error.
  * Argument "length_frame" is set with the length of frame built.
  *
@@ -355,22 +921,45 @@ relay_websocket_decode_frame (const unsigned char *buffer,
  */
 
 char *
-relay_websocket_encode_frame (int opcode,
+relay_websocket_encode_frame (struct t_relay_websocket_deflate *ws_deflate,
+                              int opcode,
                               const char *buffer,
                               unsigned long long length,
                               unsigned long long *length_frame)
 {
     unsigned char *frame;
-    unsigned long long index;
+    char *deflated;
+    unsigned long long index, length_deflated;
 
     *length_frame = 0;
 
+    deflated = NULL;
+    if (ws_deflate && ws_deflate->enabled
+        && ((opcode == WEBSOCKET_FRAME_OPCODE_TEXT)
+            || (opcode == WEBSOCKET_FRAME_OPCODE_BINARY)))
+    {
+        /* if compression fails, the message is sent uncompressed */
+        deflated = relay_websocket_deflate (buffer, length, ws_deflate,
+                                            &length_deflated);
+        if (deflated)
+        {
+            buffer = deflated;
+            length = length_deflated;
+        }
+    }
+
     frame = malloc (length + 10);
     if (!frame)
+    {
+        if (deflated)
+            free (deflated);
         return NULL;
+    }
 
     frame[0] = 0x80;
     frame[0] |= opcode;
+    if (deflated)
+        frame[0] |= 0x40;
 
     if (length <= 125)
     {
@@ -406,5 +995,129 @@ relay_websocket_encode_frame (int opcode,
 
     *length_frame = index + length;
 
+    if (deflated)
+        free (deflated);
+
     return (char *)frame;
 }
+
+/*
+ * Adds "permessage-deflate" data in an infolist (for /upgrade).
+ *
+ * The deflate stream is not saved: a new one is created after /upgrade (it
+ * never references data sent before, so the client can continue to
+ * decompress with the same stream). The sliding window of inflate stream is
+ * saved, because the client can reference data sent before /upgrade if
+ * it keeps its context.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+relay_websocket_deflate_add_to_infolist (struct t_infolist_item *item,
+                                         struct t_relay_websocket_deflate *ws_deflate)
+{
+    Bytef dict[WEBSOCKET_DEFLATE_WINDOW_SIZE_MAX];
+    uInt dict_size;
+
+    if (!item || !ws_deflate)
+        return 0;
+
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_enabled", ws_deflate->enabled))
+        return 0;
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_server_context_takeover", ws_deflate->server_context_takeover))
+        return 0;
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_client_context_takeover", ws_deflate->client_context_takeover))
+        return 0;
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_window_bits_deflate", ws_deflate->window_bits_deflate))
+        return 0;
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_window_bits_inflate", ws_deflate->window_bits_inflate))
+        return 0;
+    if (!weechat_infolist_new_var_integer (item, "ws_deflate_server_max_window_bits_recv", ws_deflate->server_max_window_bits_recv))
+        return 0;
+    if (ws_deflate->strm_inflate && ws_deflate->client_context_takeover)
+    {
+        dict_size = 0;
+        if ((inflateGetDictionary (ws_deflate->strm_inflate, dict,
+                                   &dict_size) == Z_OK)
+            && (dict_size > 0))
+        {
+            if (!weechat_infolist_new_var_buffer (item, "ws_deflate_inflate_dict", dict, dict_size))
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Allocates a structure for "permessage-deflate" using an infolist.
+ *
+ * This is called after /upgrade.
+ *
+ * Returns pointer to new structure, NULL if error.
+ */
+
+struct t_relay_websocket_deflate *
+relay_websocket_deflate_alloc_with_infolist (struct t_infolist *infolist)
+{
+    struct t_relay_websocket_deflate *new_ws_deflate;
+    void *dict;
+    int dict_size;
+
+    new_ws_deflate = relay_websocket_deflate_alloc ();
+    if (!new_ws_deflate)
+        return NULL;
+
+    /* "ws_deflate_enabled" is new in WeeChat 3.2 */
+    if (!weechat_infolist_search_var (infolist, "ws_deflate_enabled"))
+        return new_ws_deflate;
+
+    new_ws_deflate->enabled = weechat_infolist_integer (
+        infolist, "ws_deflate_enabled");
+    new_ws_deflate->server_context_takeover = weechat_infolist_integer (
+        infolist, "ws_deflate_server_context_takeover");
+    new_ws_deflate->client_context_takeover = weechat_infolist_integer (
+        infolist, "ws_deflate_client_context_takeover");
+    new_ws_deflate->window_bits_deflate = weechat_infolist_integer (
+        infolist, "ws_deflate_window_bits_deflate");
+    new_ws_deflate->window_bits_inflate = weechat_infolist_integer (
+        infolist, "ws_deflate_window_bits_inflate");
+    new_ws_deflate->server_max_window_bits_recv = weechat_infolist_integer (
+        infolist, "ws_deflate_server_max_window_bits_recv");
+
+    /* restore sliding window of inflate stream */
+    dict = weechat_infolist_buffer (infolist, "ws_deflate_inflate_dict",
+                                    &dict_size);
+    if (new_ws_deflate->enabled && dict && (dict_size > 0)
+        && relay_websocket_deflate_init_stream_inflate (new_ws_deflate))
+    {
+        inflateSetDictionary (new_ws_deflate->strm_inflate, dict, dict_size);
+    }
+
+    return new_ws_deflate;
+}
+
+/*
+ * Prints "permessage-deflate" data in WeeChat log file (usually for crash
+ * dump).
+ */
+
+void
+relay_websocket_deflate_print_log (struct t_relay_websocket_deflate *ws_deflate)
+{
+    weechat_log_printf ("  ws_deflate. . . . . . . . : 0x%lx", ws_deflate);
+    if (!ws_deflate)
+        return;
+
+    weechat_log_printf ("    enabled . . . . . . . . : %d",   ws_deflate->enabled);
+    weechat_log_printf ("    server_context_takeover : %d",   ws_deflate->server_context_takeover);
+    weechat_log_printf ("    client_context_takeover : %d",   ws_deflate->client_context_takeover);
+    weechat_log_printf ("    window_bits_deflate . . : %d",   ws_deflate->window_bits_deflate);
+    weechat_log_printf ("    window_bits_inflate . . : %d",   ws_deflate->window_bits_inflate);
+    weechat_log_printf ("    server_max_window_bits_recv: %d", ws_deflate->server_max_window_bits_recv);
+    weechat_log_printf ("    strm_deflate. . . . . . : 0x%lx", ws_deflate->strm_deflate);
+    weechat_log_printf ("    strm_inflate. . . . . . : 0x%lx", ws_deflate->strm_inflate);
+}
@@ -27,20 +27,61 @@
 #define WEBSOCKET_FRAME_OPCODE_PING         0x09
 #define WEBSOCKET_FRAME_OPCODE_PONG         0x0A
 
+/* extension "permessage-deflate" (RFC 7692) */
+#define WEBSOCKET_DEFLATE_WINDOW_BITS_MIN   8
+#define WEBSOCKET_DEFLATE_WINDOW_BITS_MAX   15
+#define WEBSOCKET_DEFLATE_WINDOW_SIZE_MAX   (1 << WEBSOCKET_DEFLATE_WINDOW_BITS_MAX)
+
+struct z_stream_s;
+struct t_infolist;
+struct t_infolist_item;
+
+struct t_relay_websocket_deflate
+{
+    int enabled;                       /* 1 if permessage-deflate is used   */
+    int server_context_takeover;       /* 1 if server keeps its deflate     */
+                                       /* context between messages          */
+    int client_context_takeover;       /* 1 if client keeps its deflate     */
+                                       /* context between messages          */
+    int window_bits_deflate;           /* window bits to compress (server)  */
+    int window_bits_inflate;           /* window bits to decompress (client)*/
+    int server_max_window_bits_recv;   /* 1 if server_max_window_bits was   */
+                                       /* received from client              */
+    struct z_stream_s *strm_deflate;   /* stream to compress messages       */
+    struct z_stream_s *strm_inflate;   /* stream to decompress messages     */
+};
+
 extern int relay_websocket_is_http_get_weechat (const char *message);
 extern void relay_websocket_save_header (struct t_relay_client *client,
                                          const char *message);
 extern int relay_websocket_client_handshake_valid (struct t_relay_client *client);
+extern struct t_relay_websocket_deflate *relay_websocket_deflate_alloc ();
+extern void relay_websocket_deflate_reinit (struct t_relay_websocket_deflate *ws_deflate);
+extern void relay_websocket_deflate_free (struct t_relay_websocket_deflate *ws_deflate);
+extern void relay_websocket_parse_extensions (const char *extensions,
+                                              struct t_relay_websocket_deflate *ws_deflate);
 extern char *relay_websocket_build_handshake (struct t_relay_client *client);
 extern void relay_websocket_send_http (struct t_relay_client *client,
                                        const char *http);
-extern int relay_websocket_decode_frame (const unsigned char *buffer,
+extern char *relay_websocket_deflate (const void *data, unsigned long long size,
+                                      struct t_relay_websocket_deflate *ws_deflate,
+                                      unsigned long long *size_deflated);
+extern char *relay_websocket_inflate (const void *data, unsigned long long size,
+                                      struct t_relay_websocket_deflate *ws_deflate,
+                                      unsigned long long *size_inflated);
+extern int relay_websocket_decode_frame (struct t_relay_websocket_deflate *ws_deflate,
+                                         const unsigned char *buffer,
                                          unsigned long long length,
-                                         unsigned char *decoded,
+                                         unsigned char **decoded,
                                          unsigned long long *decoded_length);
-extern char *relay_websocket_encode_frame (int opcode,
+extern char *relay_websocket_encode_frame (struct t_relay_websocket_deflate *ws_deflate,
+                                           int opcode,
                                            const char *buffer,
                                            unsigned long long length,
                                            unsigned long long *length_frame);
+extern int relay_websocket_deflate_add_to_infolist (struct t_infolist_item *item,
+                                                    struct t_relay_websocket_deflate *ws_deflate);
+extern struct t_relay_websocket_deflate *relay_websocket_deflate_alloc_with_infolist (struct t_infolist *infolist);
+extern void relay_websocket_deflate_print_log (struct t_relay_websocket_deflate *ws_deflate);
 
 #endif /* WEECHAT_PLUGIN_RELAY_WEBSOCKET_H */
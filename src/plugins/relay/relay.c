@@ -29,11 +29,13 @@
 #include "relay-command.h"
 #include "relay-completion.h"
 #include "relay-config.h"
+#include "relay-filter.h"
 #include "relay-info.h"
 #include "relay-network.h"
 #include "relay-raw.h"
 #include "relay-server.h"
 #include "relay-upgrade.h"
+#include "irc/relay-irc-backlog.h"
 
 
 WEECHAT_PLUGIN_NAME(RELAY_PLUGIN_NAME);
@@ -171,6 +173,7 @@ relay_debug_dump_cb (const void *pointer, void *data,
 
         relay_server_print_log ();
         relay_client_print_log ();
+        relay_irc_backlog_print_log ();
 
         weechat_log_printf ("");
         weechat_log_printf ("***** End of \"%s\" plugin dump *****",
@@ -232,6 +235,8 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
     if (relay_hook_timer)
         weechat_unhook (relay_hook_timer);
 
+    relay_irc_backlog_end ();
+
     relay_config_write ();
 
     if (relay_signal_upgrade_received)
@@ -254,5 +259,7 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
 
     relay_config_free ();
 
+    relay_filter_end ();
+
     return WEECHAT_RC_OK;
 }
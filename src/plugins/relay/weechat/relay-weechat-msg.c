@@ -39,6 +39,11 @@
 #include "../relay-client.h"
 #include "../relay-config.h"
 #include "../relay-raw.h"
+#include "../relay-websocket.h"
+
+
+/* compiled hdata paths, kept for next messages (key: path and keys) */
+struct t_hashtable *relay_weechat_msg_hdata_paths = NULL;
 
 
 /*
@@ -65,6 +70,11 @@ relay_weechat_msg_new (const char *id)
     }
     new_msg->data_alloc = RELAY_WEECHAT_MSG_INITIAL_ALLOC;
     new_msg->data_size = 0;
+    new_msg->compression = -1;
+    new_msg->compression_level = 0;
+    new_msg->compressed = NULL;
+    new_msg->compression_time = 0;
+    new_msg->key = NULL;
 
     /* add size and compression flag (they will be set later) */
     relay_weechat_msg_add_int (new_msg, 0);
@@ -76,6 +86,40 @@ relay_weechat_msg_new (const char *id)
     return new_msg;
 }
 
+/*
+ * Removes compressed message (called when content of message is changed).
+ */
+
+void
+relay_weechat_msg_reset_compressed (struct t_relay_weechat_msg *msg)
+{
+    if (msg->compressed)
+    {
+        relay_client_data_unref (msg->compressed);
+        msg->compressed = NULL;
+    }
+    msg->compression = -1;
+    msg->compression_level = 0;
+    msg->compression_time = 0;
+}
+
+/*
+ * Sets key of message: if the message is queued for a client, it will
+ * replace a message with same key not yet sent (for example the previous
+ * title of a buffer).
+ */
+
+void
+relay_weechat_msg_set_key (struct t_relay_weechat_msg *msg, const char *key)
+{
+    if (!msg)
+        return;
+
+    if (msg->key)
+        free (msg->key);
+    msg->key = (key) ? strdup (key) : NULL;
+}
+
 /*
  * Adds some bytes to a message.
  */
@@ -89,6 +133,9 @@ relay_weechat_msg_add_bytes (struct t_relay_weechat_msg *msg,
     if (!msg || !msg->data)
         return;
 
+    if (msg->compression >= 0)
+        relay_weechat_msg_reset_compressed (msg);
+
     while (msg->data_size + size > msg->data_alloc)
     {
         msg->data_alloc *= 2;
@@ -119,6 +166,9 @@ relay_weechat_msg_set_bytes (struct t_relay_weechat_msg *msg,
     if (!msg || !msg->data || (position + size) > msg->data_size)
         return;
 
+    if (msg->compression >= 0)
+        relay_weechat_msg_reset_compressed (msg);
+
     memcpy (msg->data + position, buffer, size);
 }
 
@@ -320,438 +370,1094 @@ relay_weechat_msg_add_hashtable (struct t_relay_weechat_msg *msg,
 }
 
 /*
- * Adds recursively hdata for a path to a message.
+ * Reads a pointer in an object using a compiled hdata path.
  *
- * Returns the number of hdata objects added to message.
+ * Returns the pointer read, NULL if not found.
  */
 
-int
-relay_weechat_msg_add_hdata_path (struct t_relay_weechat_msg *msg,
-                                  char **list_path,
-                                  int index_path,
-                                  void **path_pointers,
-                                  struct t_hdata *hdata,
-                                  void *pointer,
-                                  char **list_keys)
+void *
+relay_weechat_msg_hdata_path_pointer (struct t_hdata_path *hpath,
+                                      void *pointer)
 {
-    int num_added, i, j, count, count_all, var_type, array_size, max_array_size;
-    int length;
-    char *pos, *pos2, *str_count, *error, *name;
-    void *sub_pointer;
-    struct t_hdata *sub_hdata;
-    const char *sub_hdata_name;
+    void **ptr_value;
+
+    if (!hpath)
+        return NULL;
 
-    num_added = 0;
+    ptr_value = weechat_hdata_path_get_value (hpath, pointer, -1);
 
-    count_all = 0;
-    count = 0;
-    pos = strchr (list_path[index_path], '(');
-    if (pos)
+    return (ptr_value) ? *ptr_value : NULL;
+}
+
+/*
+ * Builds a new compiled hdata path: variables to move in path and keys are
+ * compiled once, so that objects are then added to messages without any
+ * lookup by name in hdata.
+ *
+ * Argument list_vars contains names of variables to follow from the head
+ * hdata (counts removed), argument keys is the comma-separated list of keys
+ * (NULL for all keys of last hdata).
+ *
+ * Returns pointer to new compiled path, NULL if error (invalid path or keys).
+ */
+
+struct t_relay_weechat_msg_hdata_path *
+relay_weechat_msg_hdata_path_new (const char *hdata_head, char **list_vars,
+                                  int num_vars, const char *keys)
+{
+    struct t_relay_weechat_msg_hdata_path *new_path;
+    struct t_hdata *ptr_hdata;
+    struct t_hdata_path *ptr_key;
+    const char *hdata_name, *ptr_var, *array_size;
+    char **names, **list_keys;
+    int i, type, num_keys;
+
+    if (!hdata_head || (num_vars < 0))
+        return NULL;
+
+    new_path = malloc (sizeof (*new_path));
+    if (!new_path)
+        return NULL;
+
+    new_path->names = NULL;
+    new_path->keys_types = NULL;
+    new_path->num_path = num_vars + 1;
+    new_path->hdata_head = NULL;
+    new_path->vars = NULL;
+    new_path->vars_prev = NULL;
+    new_path->vars_next = NULL;
+    new_path->num_keys = 0;
+    new_path->keys = NULL;
+    new_path->refcount = 1;
+
+    names = NULL;
+    list_keys = NULL;
+
+    new_path->vars = calloc (new_path->num_path, sizeof (*new_path->vars));
+    new_path->vars_prev = calloc (new_path->num_path,
+                                  sizeof (*new_path->vars_prev));
+    new_path->vars_next = calloc (new_path->num_path,
+                                  sizeof (*new_path->vars_next));
+    if (!new_path->vars || !new_path->vars_prev || !new_path->vars_next)
+        goto error;
+
+    new_path->hdata_head = weechat_hdata_get (hdata_head);
+    if (!new_path->hdata_head)
+        goto error;
+
+    /*
+     * build string with path where variable names are replaced by hdata
+     * name, and compile the variables to move in path
+     */
+    names = weechat_string_dyn_alloc (64);
+    if (!names)
+        goto error;
+    weechat_string_dyn_concat (names, hdata_head, -1);
+    ptr_hdata = new_path->hdata_head;
+    for (i = 0; i < new_path->num_path; i++)
     {
-        pos2 = strchr (pos + 1, ')');
-        if (pos2 && (pos2 > pos + 1))
+        if (i > 0)
         {
-            str_count = weechat_strndup (pos + 1, pos2 - (pos + 1));
-            if (str_count)
+            hdata_name = weechat_hdata_get_var_hdata (ptr_hdata,
+                                                      list_vars[i - 1]);
+            if (!hdata_name)
+                goto error;
+            new_path->vars[i] = weechat_hdata_path_compile (ptr_hdata,
+                                                            list_vars[i - 1]);
+            if (!new_path->vars[i])
+                goto error;
+            ptr_hdata = weechat_hdata_get (hdata_name);
+            if (!ptr_hdata)
+                goto error;
+            weechat_string_dyn_concat (names, "/", -1);
+            weechat_string_dyn_concat (names, hdata_name, -1);
+        }
+        ptr_var = weechat_hdata_get_string (ptr_hdata, "var_prev");
+        if (ptr_var)
+            new_path->vars_prev[i] = weechat_hdata_path_compile (ptr_hdata,
+                                                                 ptr_var);
+        ptr_var = weechat_hdata_get_string (ptr_hdata, "var_next");
+        if (ptr_var)
+            new_path->vars_next[i] = weechat_hdata_path_compile (ptr_hdata,
+                                                                 ptr_var);
+    }
+    new_path->names = weechat_string_dyn_free (names, 0);
+    names = NULL;
+
+    /* split keys */
+    if (!keys)
+        keys = weechat_hdata_get_string (ptr_hdata, "var_keys");
+    list_keys = weechat_string_split (
+        keys, ",", NULL,
+        WEECHAT_STRING_SPLIT_STRIP_LEFT
+        | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+        | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+        0, &num_keys);
+    if (!list_keys)
+        goto error;
+    new_path->keys = malloc (num_keys * sizeof (*new_path->keys));
+    if (!new_path->keys)
+        goto error;
+
+    /*
+     * compile keys and build string with list of keys with types:
+     * "key1:type1,key2:type2,..."
+     */
+    new_path->keys_types = malloc (strlen (keys) + (num_keys * 8) + 1);
+    if (!new_path->keys_types)
+        goto error;
+    new_path->keys_types[0] = '\0';
+    for (i = 0; i < num_keys; i++)
+    {
+        type = weechat_hdata_get_var_type (ptr_hdata, list_keys[i]);
+        if ((type < 0) || (type == WEECHAT_HDATA_OTHER))
+            continue;
+        ptr_key = weechat_hdata_path_compile (ptr_hdata, list_keys[i]);
+        if (!ptr_key)
+            continue;
+        new_path->keys[new_path->num_keys] = ptr_key;
+        new_path->num_keys++;
+        if (new_path->keys_types[0])
+            strcat (new_path->keys_types, ",");
+        strcat (new_path->keys_types, list_keys[i]);
+        strcat (new_path->keys_types, ":");
+        array_size = weechat_hdata_get_var_array_size_string (ptr_hdata,
+                                                              NULL,
+                                                              list_keys[i]);
+        if (array_size)
+            strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_ARRAY);
+        else
+        {
+            switch (type)
             {
-                if (strcmp (str_count, "*") == 0)
-                    count_all = 1;
-                else
-                {
-                    error = NULL;
-                    count = (int)strtol (str_count, &error, 10);
-                    if (error && !error[0])
-                    {
-                        if (count > 0)
-                            count--;
-                        else if (count < 0)
-                            count++;
-                    }
-                    else
-                        count = 0;
-                }
-                free (str_count);
+                case WEECHAT_HDATA_CHAR:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_CHAR);
+                    break;
+                case WEECHAT_HDATA_INTEGER:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_INT);
+                    break;
+                case WEECHAT_HDATA_LONG:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_LONG);
+                    break;
+                case WEECHAT_HDATA_STRING:
+                case WEECHAT_HDATA_SHARED_STRING:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_STRING);
+                    break;
+                case WEECHAT_HDATA_POINTER:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_POINTER);
+                    break;
+                case WEECHAT_HDATA_TIME:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_TIME);
+                    break;
+                case WEECHAT_HDATA_HASHTABLE:
+                    strcat (new_path->keys_types, RELAY_WEECHAT_MSG_OBJ_HASHTABLE);
+                    break;
             }
         }
     }
+    if (new_path->num_keys == 0)
+        goto error;
+
+    weechat_string_free_split (list_keys);
+
+    return new_path;
+
+error:
+    if (names)
+        weechat_string_dyn_free (names, 1);
+    if (list_keys)
+        weechat_string_free_split (list_keys);
+    relay_weechat_msg_hdata_path_unref (new_path);
+    return NULL;
+}
+
+/*
+ * Checks if a compiled hdata path is still valid: it becomes invalid if one
+ * of its hdata has been freed (for example when a plugin is unloaded).
+ *
+ * Returns:
+ *   1: compiled path is valid
+ *   0: compiled path is invalid
+ */
+
+int
+relay_weechat_msg_hdata_path_is_valid (struct t_relay_weechat_msg_hdata_path *path)
+{
+    int i;
+
+    for (i = 0; i < path->num_path; i++)
+    {
+        if ((path->vars[i]
+             && (weechat_hdata_path_get_type (path->vars[i]) < 0))
+            || (path->vars_prev[i]
+                && (weechat_hdata_path_get_type (path->vars_prev[i]) < 0))
+            || (path->vars_next[i]
+                && (weechat_hdata_path_get_type (path->vars_next[i]) < 0)))
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < path->num_keys; i++)
+    {
+        if (weechat_hdata_path_get_type (path->keys[i]) < 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Gets a compiled hdata path: it is searched in the compiled paths already
+ * used (and compiled if not found), so that the same path sent many times
+ * (for example for each line displayed) is compiled only once.
+ *
+ * Returns pointer to compiled path, NULL if error.
+ *
+ * Note: the compiled path must be released with
+ * relay_weechat_msg_hdata_path_unref after use.
+ */
+
+struct t_relay_weechat_msg_hdata_path *
+relay_weechat_msg_hdata_path_get (const char *hdata_head, char **list_vars,
+                                  int num_vars, const char *keys)
+{
+    struct t_relay_weechat_msg_hdata_path *ptr_path;
+    char **key;
+    int i;
+
+    if (!hdata_head)
+        return NULL;
+
+    if (!relay_weechat_msg_hdata_paths)
+    {
+        relay_weechat_msg_hdata_paths = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_STRING,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!relay_weechat_msg_hdata_paths)
+            return NULL;
+        weechat_hashtable_set_pointer (
+            relay_weechat_msg_hdata_paths,
+            "callback_free_value",
+            &relay_weechat_msg_hdata_paths_free_value_cb);
+    }
+
+    /* key is "hdata_head/var1/var2" + "\n" + keys (if keys are given) */
+    key = weechat_string_dyn_alloc (64);
+    if (!key)
+        return NULL;
+    weechat_string_dyn_concat (key, hdata_head, -1);
+    for (i = 0; i < num_vars; i++)
+    {
+        weechat_string_dyn_concat (key, "/", -1);
+        weechat_string_dyn_concat (key, list_vars[i], -1);
+    }
+    if (keys)
+    {
+        weechat_string_dyn_concat (key, "\n", -1);
+        weechat_string_dyn_concat (key, keys, -1);
+    }
+
+    ptr_path = weechat_hashtable_get (relay_weechat_msg_hdata_paths, *key);
+    if (ptr_path)
+    {
+        if (relay_weechat_msg_hdata_path_is_valid (ptr_path))
+        {
+            ptr_path->refcount++;
+            goto end;
+        }
+        weechat_hashtable_remove (relay_weechat_msg_hdata_paths, *key);
+    }
+
+    ptr_path = relay_weechat_msg_hdata_path_new (hdata_head, list_vars,
+                                                 num_vars, keys);
+    if (ptr_path)
+    {
+        if (weechat_hashtable_get_integer (relay_weechat_msg_hdata_paths,
+                                           "items_count") >= RELAY_WEECHAT_MSG_HDATA_PATHS_MAX)
+        {
+            weechat_hashtable_remove_all (relay_weechat_msg_hdata_paths);
+        }
+        /* one reference for the caller, one for the hashtable */
+        ptr_path->refcount++;
+        weechat_hashtable_set (relay_weechat_msg_hdata_paths, *key, ptr_path);
+    }
+
+end:
+    weechat_string_dyn_free (key, 1);
+    return ptr_path;
+}
+
+/*
+ * Releases a compiled hdata path (it is freed when it is not used any more).
+ */
+
+void
+relay_weechat_msg_hdata_path_unref (struct t_relay_weechat_msg_hdata_path *path)
+{
+    int i;
+
+    if (!path)
+        return;
+
+    path->refcount--;
+    if (path->refcount > 0)
+        return;
+
+    if (path->names)
+        free (path->names);
+    if (path->keys_types)
+        free (path->keys_types);
+    for (i = 0; i < path->num_path; i++)
+    {
+        if (path->vars && path->vars[i])
+            weechat_hdata_path_free (path->vars[i]);
+        if (path->vars_prev && path->vars_prev[i])
+            weechat_hdata_path_free (path->vars_prev[i]);
+        if (path->vars_next && path->vars_next[i])
+            weechat_hdata_path_free (path->vars_next[i]);
+    }
+    if (path->vars)
+        free (path->vars);
+    if (path->vars_prev)
+        free (path->vars_prev);
+    if (path->vars_next)
+        free (path->vars_next);
+    for (i = 0; i < path->num_keys; i++)
+    {
+        weechat_hdata_path_free (path->keys[i]);
+    }
+    if (path->keys)
+        free (path->keys);
+
+    free (path);
+}
 
-    while (pointer)
+/*
+ * Callback for freeing a compiled hdata path in hashtable.
+ */
+
+void
+relay_weechat_msg_hdata_paths_free_value_cb (struct t_hashtable *hashtable,
+                                             const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    relay_weechat_msg_hdata_path_unref (
+        (struct t_relay_weechat_msg_hdata_path *)value);
+}
+
+/*
+ * Frees all compiled hdata paths kept for next messages (compiled paths still
+ * used by hdata are freed when these hdata are freed).
+ */
+
+void
+relay_weechat_msg_hdata_paths_free_all ()
+{
+    if (relay_weechat_msg_hdata_paths)
     {
-        path_pointers[index_path] = pointer;
+        weechat_hashtable_free (relay_weechat_msg_hdata_paths);
+        relay_weechat_msg_hdata_paths = NULL;
+    }
+}
+
+/*
+ * Adds values of keys for an object of hdata to a message.
+ */
+
+void
+relay_weechat_msg_add_hdata_values (struct t_relay_weechat_msg *msg,
+                                    struct t_relay_weechat_msg_hdata_path *path,
+                                    void *pointer)
+{
+    struct t_hdata_path *ptr_key;
+    void *ptr_value;
+    int i, j, var_type, array_size, max_array_size;
 
-        if (list_path[index_path + 1])
+    for (i = 0; i < path->num_keys; i++)
+    {
+        ptr_key = path->keys[i];
+        var_type = weechat_hdata_path_get_type (ptr_key);
+        max_array_size = 1;
+        array_size = weechat_hdata_path_get_array_size (ptr_key, pointer);
+        if (array_size >= 0)
         {
-            /* recursive call with next path */
-            pos = strchr (list_path[index_path + 1], '(');
-            if (pos)
-                pos[0] = '\0';
-            sub_pointer = weechat_hdata_pointer (hdata, pointer, list_path[index_path + 1]);
-            sub_hdata_name = weechat_hdata_get_var_hdata (hdata, list_path[index_path + 1]);
-            if (pos)
-                pos[0] = '(';
-            if (sub_pointer && sub_hdata_name)
+            switch (var_type)
             {
-                sub_hdata = weechat_hdata_get (sub_hdata_name);
-                if (sub_hdata)
-                {
-                    num_added += relay_weechat_msg_add_hdata_path (msg,
-                                                                   list_path,
-                                                                   index_path + 1,
-                                                                   path_pointers,
-                                                                   sub_hdata,
-                                                                   sub_pointer,
-                                                                   list_keys);
-                }
+                case WEECHAT_HDATA_CHAR:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_CHAR);
+                    break;
+                case WEECHAT_HDATA_INTEGER:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_INT);
+                    break;
+                case WEECHAT_HDATA_LONG:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_LONG);
+                    break;
+                case WEECHAT_HDATA_STRING:
+                case WEECHAT_HDATA_SHARED_STRING:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_STRING);
+                    break;
+                case WEECHAT_HDATA_POINTER:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_POINTER);
+                    break;
+                case WEECHAT_HDATA_TIME:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_TIME);
+                    break;
+                case WEECHAT_HDATA_HASHTABLE:
+                    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_HASHTABLE);
+                    break;
             }
+            relay_weechat_msg_add_int (msg, array_size);
+            max_array_size = array_size;
         }
-        else
+        for (j = 0; j < max_array_size; j++)
         {
-            /* last path? then get pointer + values and fill message with them */
-            for (i = 0; list_path[i]; i++)
+            ptr_value = weechat_hdata_path_get_value (
+                ptr_key, pointer, (array_size >= 0) ? j : -1);
+            switch (var_type)
             {
-                relay_weechat_msg_add_pointer (msg, path_pointers[i]);
+                case WEECHAT_HDATA_CHAR:
+                    relay_weechat_msg_add_char (
+                        msg, (ptr_value) ? *((char *)ptr_value) : '\0');
+                    break;
+                case WEECHAT_HDATA_INTEGER:
+                    relay_weechat_msg_add_int (
+                        msg, (ptr_value) ? *((int *)ptr_value) : 0);
+                    break;
+                case WEECHAT_HDATA_LONG:
+                    relay_weechat_msg_add_long (
+                        msg, (ptr_value) ? *((long *)ptr_value) : 0);
+                    break;
+                case WEECHAT_HDATA_STRING:
+                case WEECHAT_HDATA_SHARED_STRING:
+                    relay_weechat_msg_add_string (
+                        msg, (ptr_value) ? *((char **)ptr_value) : NULL);
+                    break;
+                case WEECHAT_HDATA_POINTER:
+                    relay_weechat_msg_add_pointer (
+                        msg, (ptr_value) ? *((void **)ptr_value) : NULL);
+                    break;
+                case WEECHAT_HDATA_TIME:
+                    relay_weechat_msg_add_time (
+                        msg, (ptr_value) ? *((time_t *)ptr_value) : 0);
+                    break;
+                case WEECHAT_HDATA_HASHTABLE:
+                    relay_weechat_msg_add_hashtable (
+                        msg,
+                        (ptr_value) ? *((struct t_hashtable **)ptr_value) : NULL);
+                    break;
             }
-            for (i = 0; list_keys[i]; i++)
+        }
+    }
+}
+
+/*
+ * Parses count in an item of hdata path (format: "name(N)" or "name(*)"),
+ * then removes the count from the item (only the name is kept).
+ */
+
+void
+relay_weechat_msg_hdata_parse_count (char *path_item,
+                                     int *count, int *count_all)
+{
+    char *pos, *pos2, *str_count, *error;
+
+    *count = 0;
+    *count_all = 0;
+
+    pos = strchr (path_item, '(');
+    if (!pos)
+        return;
+
+    pos2 = strchr (pos + 1, ')');
+    if (pos2 && (pos2 > pos + 1))
+    {
+        str_count = weechat_strndup (pos + 1, pos2 - (pos + 1));
+        if (str_count)
+        {
+            if (strcmp (str_count, "*") == 0)
+                *count_all = 1;
+            else
             {
-                var_type = weechat_hdata_get_var_type (hdata, list_keys[i]);
-                if ((var_type >= 0) && (var_type != WEECHAT_HDATA_OTHER))
+                error = NULL;
+                *count = (int)strtol (str_count, &error, 10);
+                if (error && !error[0])
                 {
-                    max_array_size = 1;
-                    array_size = weechat_hdata_get_var_array_size (hdata,
-                                                                   pointer,
-                                                                   list_keys[i]);
-                    if (array_size >= 0)
-                    {
-                        switch (var_type)
-                        {
-                            case WEECHAT_HDATA_CHAR:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_CHAR);
-                                break;
-                            case WEECHAT_HDATA_INTEGER:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_INT);
-                                break;
-                            case WEECHAT_HDATA_LONG:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_LONG);
-                                break;
-                            case WEECHAT_HDATA_STRING:
-                            case WEECHAT_HDATA_SHARED_STRING:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_STRING);
-                                break;
-                            case WEECHAT_HDATA_POINTER:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_POINTER);
-                                break;
-                            case WEECHAT_HDATA_TIME:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_TIME);
-                                break;
-                            case WEECHAT_HDATA_HASHTABLE:
-                                relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_HASHTABLE);
-                                break;
-                        }
-                        relay_weechat_msg_add_int (msg, array_size);
-                        max_array_size = array_size;
-                    }
-                    length = 16 + strlen (list_keys[i]) + 1;
-                    name = malloc (length);
-                    if (name)
-                    {
-                        for (j = 0; j < max_array_size; j++)
-                        {
-                            snprintf (name, length, "%d|%s", j, list_keys[i]);
-                            switch (var_type)
-                            {
-                                case WEECHAT_HDATA_CHAR:
-                                    relay_weechat_msg_add_char (msg,
-                                                                weechat_hdata_char (hdata,
-                                                                                    pointer,
-                                                                                    name));
-                                    break;
-                                case WEECHAT_HDATA_INTEGER:
-                                    relay_weechat_msg_add_int (msg,
-                                                               weechat_hdata_integer (hdata,
-                                                                                      pointer,
-                                                                                      name));
-                                    break;
-                                case WEECHAT_HDATA_LONG:
-                                    relay_weechat_msg_add_long (msg,
-                                                                weechat_hdata_long (hdata,
-                                                                                    pointer,
-                                                                                    name));
-                                    break;
-                                case WEECHAT_HDATA_STRING:
-                                case WEECHAT_HDATA_SHARED_STRING:
-                                    relay_weechat_msg_add_string (msg,
-                                                                  weechat_hdata_string (hdata,
-                                                                                        pointer,
-                                                                                        name));
-                                    break;
-                                case WEECHAT_HDATA_POINTER:
-                                    relay_weechat_msg_add_pointer (msg,
-                                                                   weechat_hdata_pointer (hdata,
-                                                                                          pointer,
-                                                                                          name));
-                                    break;
-                                case WEECHAT_HDATA_TIME:
-                                    relay_weechat_msg_add_time (msg,
-                                                                weechat_hdata_time (hdata,
-                                                                                    pointer,
-                                                                                    name));
-                                    break;
-                                case WEECHAT_HDATA_HASHTABLE:
-                                    relay_weechat_msg_add_hashtable (msg,
-                                                                     weechat_hdata_hashtable (hdata,
-                                                                                              pointer,
-                                                                                              name));
-                                    break;
-                            }
-                        }
-                        free (name);
-                    }
+                    if (*count > 0)
+                        (*count)--;
+                    else if (*count < 0)
+                        (*count)++;
                 }
+                else
+                    *count = 0;
             }
-            num_added++;
-        }
-        if (count_all)
-        {
-            pointer = weechat_hdata_move (hdata, pointer, 1);
+            free (str_count);
         }
-        else if (count == 0)
-            pointer = NULL;
-        else if (count > 0)
-        {
-            pointer = weechat_hdata_move (hdata, pointer, 1);
-            count--;
-        }
-        else
-        {
-            pointer = weechat_hdata_move (hdata, pointer, -1);
-            count++;
-        }
-        if (!pointer)
-            break;
     }
 
-    return num_added;
+    pos[0] = '\0';
 }
 
 /*
- * Adds a hdata to a message.
+ * Allocates a new hdata structure with "num_path" items in path (the
+ * compiled path and head pointers are set by the caller).
+ *
+ * Returns pointer to new hdata structure, NULL if error.
+ */
+
+struct t_relay_weechat_msg_hdata *
+relay_weechat_msg_hdata_alloc (int num_path)
+{
+    struct t_relay_weechat_msg_hdata *new_hdata;
+
+    if (num_path < 1)
+        return NULL;
+
+    new_hdata = malloc (sizeof (*new_hdata));
+    if (!new_hdata)
+        return NULL;
+
+    new_hdata->path = NULL;
+    new_hdata->head_list = NULL;
+    new_hdata->head_pointers = NULL;
+    new_hdata->num_head_pointers = 0;
+    new_hdata->check_pointers = 1;
+    new_hdata->counts = calloc (num_path, sizeof (*new_hdata->counts));
+    new_hdata->counts_all = calloc (num_path, sizeof (*new_hdata->counts_all));
+    new_hdata->started = 0;
+    new_hdata->ended = 0;
+    new_hdata->index_head = 0;
+    new_hdata->check_position = 1;
+    new_hdata->pointers = calloc (num_path, sizeof (*new_hdata->pointers));
+    new_hdata->remaining = calloc (num_path, sizeof (*new_hdata->remaining));
+    if (!new_hdata->counts || !new_hdata->counts_all
+        || !new_hdata->pointers || !new_hdata->remaining)
+    {
+        relay_weechat_msg_hdata_free (new_hdata);
+        return NULL;
+    }
+
+    return new_hdata;
+}
+
+/*
+ * Builds a new hdata structure with a hdata path and keys (the hdata is not
+ * added to a message, see function relay_weechat_msg_add_hdata_page).
  *
  * Argument path has format:
  *   hdata_head:ptr->var->var->...->var
- * where ptr can be a list name or a pointer (0x12345)
+ * where ptr can be a list name, a pointer (0x12345) or a list of pointers
+ * separated by commas (0x12345,0x23456): in this case all pointers are added
+ * in the same hdata
  *
  * Argument keys is optional: if not NULL, comma-separated list of keys to
  * return for hdata.
  *
- * Returns:
- *   1: hdata added to message
- *   0: error (hdata NOT added to message)
+ * Returns pointer to new hdata structure, NULL if error (invalid path or
+ * keys).
  */
 
-int
-relay_weechat_msg_add_hdata (struct t_relay_weechat_msg *msg,
-                             const char *path, const char *keys)
+struct t_relay_weechat_msg_hdata *
+relay_weechat_msg_hdata_new (const char *path, const char *keys)
 {
-    struct t_hdata *ptr_hdata_head, *ptr_hdata;
-    char *hdata_head, *pos, **list_keys, *keys_types, **list_path;
-    char *path_returned;
-    const char *hdata_name, *array_size;
-    void *pointer, **path_pointers;
+    struct t_relay_weechat_msg_hdata *new_hdata;
+    char *hdata_head, *pos, **list_path, **list_pointers;
     unsigned long value;
-    int rc, num_keys, num_path, i, type, pos_count, count, rc_sscanf;
-    uint32_t count32;
+    int i, rc_sscanf, num_path, num_pointers;
 
-    rc = 0;
+    if (!path)
+        return NULL;
 
+    new_hdata = NULL;
     hdata_head = NULL;
-    list_keys = NULL;
-    num_keys = 0;
-    keys_types = NULL;
     list_path = NULL;
-    num_path = 0;
-    path_returned = NULL;
+    list_pointers = NULL;
 
     /* extract hdata name (head) from path */
     pos = strchr (path, ':');
     if (!pos)
-        goto end;
+        goto error;
     hdata_head = weechat_strndup (path, pos - path);
     if (!hdata_head)
-        goto end;
-    ptr_hdata_head = weechat_hdata_get (hdata_head);
-    if (!ptr_hdata_head)
-        goto end;
+        goto error;
 
     /* split path */
-    list_path = weechat_string_split (pos + 1, "/", NULL,
-                                      WEECHAT_STRING_SPLIT_STRIP_LEFT
-                                      | WEECHAT_STRING_SPLIT_STRIP_RIGHT
-                                      | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
-                                      0, &num_path);
+    list_path = weechat_string_split (
+        pos + 1, "/", NULL,
+        WEECHAT_STRING_SPLIT_STRIP_LEFT
+        | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+        | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+        0, &num_path);
     if (!list_path)
-        goto end;
+        goto error;
+    new_hdata = relay_weechat_msg_hdata_alloc (num_path);
+    if (!new_hdata)
+        goto error;
+
+    /* extract counts from path, keep only names */
+    for (i = 0; i < num_path; i++)
+    {
+        relay_weechat_msg_hdata_parse_count (list_path[i],
+                                             &new_hdata->counts[i],
+                                             &new_hdata->counts_all[i]);
+    }
+
+    /* get compiled path (variables after head, and keys) */
+    new_hdata->path = relay_weechat_msg_hdata_path_get (hdata_head,
+                                                        list_path + 1,
+                                                        num_path - 1,
+                                                        keys);
+    if (!new_hdata->path)
+        goto error;
 
-    /* extract pointer from first path (direct pointer or list name) */
-    pointer = NULL;
-    pos = strchr (list_path[0], '(');
-    if (pos)
-        pos[0] = '\0';
+    /*
+     * extract pointer(s) from first path: direct pointer, list of pointers
+     * separated by commas (for example: "0x123,0x456") or list name
+     */
     if (strncmp (list_path[0], "0x", 2) == 0)
     {
-        rc_sscanf = sscanf (list_path[0], "%lx", &value);
-        if ((rc_sscanf != EOF) && (rc_sscanf != 0))
+        list_pointers = weechat_string_split (list_path[0], ",",
+                                              NULL, 0, 0, &num_pointers);
+        if (!list_pointers)
+            goto error;
+        new_hdata->head_pointers = malloc (
+            sizeof (*new_hdata->head_pointers) * num_pointers);
+        if (!new_hdata->head_pointers)
+            goto error;
+        new_hdata->num_head_pointers = num_pointers;
+        for (i = 0; i < num_pointers; i++)
         {
-            pointer = (void *)value;
-            if (!weechat_hdata_check_pointer (ptr_hdata_head, NULL, pointer))
+            new_hdata->head_pointers[i] = NULL;
+            rc_sscanf = sscanf (list_pointers[i], "%lx", &value);
+            if ((rc_sscanf != EOF) && (rc_sscanf != 0))
             {
-                if (weechat_relay_plugin->debug >= 1)
+                new_hdata->head_pointers[i] = (void *)value;
+                if (!weechat_hdata_check_pointer (new_hdata->path->hdata_head,
+                                                  NULL,
+                                                  new_hdata->head_pointers[i]))
                 {
-                    weechat_printf (NULL,
-                                    _("%s: invalid pointer in hdata path: "
-                                      "\"%s\""),
-                                    RELAY_PLUGIN_NAME,
-                                    path);
+                    if (weechat_relay_plugin->debug >= 1)
+                    {
+                        weechat_printf (NULL,
+                                        _("%s: invalid pointer in hdata path: "
+                                          "\"%s\""),
+                                        RELAY_PLUGIN_NAME,
+                                        path);
+                    }
+                    goto error;
                 }
-                goto end;
             }
+            if (!new_hdata->head_pointers[i])
+                goto error;
         }
     }
     else
-        pointer = weechat_hdata_get_list (ptr_hdata_head, list_path[0]);
-    if (pos)
-        pos[0] = '(';
-    if (!pointer)
-        goto end;
-
-    /*
-     * build string with path where:
-     * - counters are removed
-     * - variable names are replaced by hdata name
-     */
-    path_returned = malloc (strlen (path) * 2);
-    if (!path_returned)
-        goto end;
-    ptr_hdata = ptr_hdata_head;
-    strcpy (path_returned, hdata_head);
-    for (i = 1; i < num_path; i++)
     {
-        pos = strchr (list_path[i], '(');
-        if (pos)
-            pos[0] = '\0';
-        hdata_name = weechat_hdata_get_var_hdata (ptr_hdata, list_path[i]);
-        if (!hdata_name)
-            goto end;
-        ptr_hdata = weechat_hdata_get (hdata_name);
-        if (!ptr_hdata)
-            goto end;
-        strcat (path_returned, "/");
-        strcat (path_returned, hdata_name);
-        if (pos)
-            pos[0] = '(';
+        new_hdata->head_list = strdup (list_path[0]);
+        new_hdata->head_pointers = malloc (sizeof (*new_hdata->head_pointers));
+        if (!new_hdata->head_list || !new_hdata->head_pointers)
+            goto error;
+        new_hdata->num_head_pointers = 1;
+        new_hdata->head_pointers[0] = weechat_hdata_get_list (
+            new_hdata->path->hdata_head, new_hdata->head_list);
+        if (!new_hdata->head_pointers[0])
+            goto error;
     }
 
-    /* split keys */
-    if (!keys)
-        keys = weechat_hdata_get_string (ptr_hdata, "var_keys");
-    list_keys = weechat_string_split (keys, ",", NULL,
-                                      WEECHAT_STRING_SPLIT_STRIP_LEFT
-                                      | WEECHAT_STRING_SPLIT_STRIP_RIGHT
-                                      | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
-                                      0, &num_keys);
-    if (!list_keys)
-        goto end;
+    if (list_pointers)
+        weechat_string_free_split (list_pointers);
+    weechat_string_free_split (list_path);
+    free (hdata_head);
 
-    /* build string with list of keys with types: "key1:type1,key2:type2,..." */
-    keys_types = malloc (strlen (keys) + (num_keys * 8) + 1);
-    if (!keys_types)
-        goto end;
-    keys_types[0] = '\0';
-    for (i = 0; i < num_keys; i++)
+    return new_hdata;
+
+error:
+    if (list_pointers)
+        weechat_string_free_split (list_pointers);
+    if (list_path)
+        weechat_string_free_split (list_path);
+    if (hdata_head)
+        free (hdata_head);
+    relay_weechat_msg_hdata_free (new_hdata);
+    return NULL;
+}
+
+/*
+ * Builds a new hdata structure with objects of a hdata given by their
+ * pointers (without parsing a path): this is used to send objects received
+ * in signals (for example lines displayed), the pointers are not checked.
+ *
+ * Argument keys is optional: if not NULL, comma-separated list of keys to
+ * return for hdata.
+ *
+ * Returns pointer to new hdata structure, NULL if error.
+ */
+
+struct t_relay_weechat_msg_hdata *
+relay_weechat_msg_hdata_new_pointers (const char *hdata_head, void **pointers,
+                                      int num_pointers, const char *keys)
+{
+    struct t_relay_weechat_msg_hdata *new_hdata;
+
+    if (!hdata_head || !pointers || (num_pointers < 1))
+        return NULL;
+
+    new_hdata = relay_weechat_msg_hdata_alloc (1);
+    if (!new_hdata)
+        return NULL;
+
+    new_hdata->check_pointers = 0;
+    new_hdata->path = relay_weechat_msg_hdata_path_get (hdata_head, NULL, 0,
+                                                        keys);
+    new_hdata->head_pointers = malloc (
+        sizeof (*new_hdata->head_pointers) * num_pointers);
+    if (!new_hdata->path || !new_hdata->head_pointers)
     {
-        type = weechat_hdata_get_var_type (ptr_hdata, list_keys[i]);
-        if ((type >= 0) && (type != WEECHAT_HDATA_OTHER))
+        relay_weechat_msg_hdata_free (new_hdata);
+        return NULL;
+    }
+    memcpy (new_hdata->head_pointers, pointers,
+            sizeof (*new_hdata->head_pointers) * num_pointers);
+    new_hdata->num_head_pointers = num_pointers;
+
+    return new_hdata;
+}
+
+/*
+ * Gets the pointer for the head of hdata path (the list is read again, and
+ * a pointer received from client is checked again, because objects may have
+ * been removed since the hdata was built).
+ *
+ * Returns pointer to head object, NULL if not found.
+ */
+
+void *
+relay_weechat_msg_hdata_get_head (struct t_relay_weechat_msg_hdata *hdata)
+{
+    void *pointer;
+
+    if (hdata->head_list)
+    {
+        return weechat_hdata_get_list (hdata->path->hdata_head,
+                                       hdata->head_list);
+    }
+
+    pointer = hdata->head_pointers[hdata->index_head];
+    if (!hdata->check_pointers)
+        return pointer;
+
+    return (weechat_hdata_check_pointer (hdata->path->hdata_head, NULL,
+                                         pointer)) ?
+        pointer : NULL;
+}
+
+/*
+ * Moves the pointer of an item in hdata path to the next object, according
+ * to the count of this item.
+ *
+ * Returns pointer to next object, NULL if the end of list or count has been
+ * reached.
+ */
+
+void *
+relay_weechat_msg_hdata_move (struct t_relay_weechat_msg_hdata *hdata,
+                              int index)
+{
+    if (hdata->counts_all[index])
+    {
+        return relay_weechat_msg_hdata_path_pointer (
+            hdata->path->vars_next[index], hdata->pointers[index]);
+    }
+    if (hdata->remaining[index] > 0)
+    {
+        hdata->remaining[index]--;
+        return relay_weechat_msg_hdata_path_pointer (
+            hdata->path->vars_next[index], hdata->pointers[index]);
+    }
+    if (hdata->remaining[index] < 0)
+    {
+        hdata->remaining[index]++;
+        return relay_weechat_msg_hdata_path_pointer (
+            hdata->path->vars_prev[index], hdata->pointers[index]);
+    }
+    return NULL;
+}
+
+/*
+ * Positions hdata on the next object to add in a message.
+ *
+ * If pointer is not NULL, the object is searched from this pointer for the
+ * item "index" in path (down to the last item), otherwise the pointer of item
+ * "index" is moved to the next object first.
+ *
+ * Returns:
+ *   1: object found (pointers of hdata contain the path to this object)
+ *   0: no more objects
+ */
+
+int
+relay_weechat_msg_hdata_seek (struct t_relay_weechat_msg_hdata *hdata,
+                              int index, void *pointer)
+{
+    while (1)
+    {
+        if (pointer)
         {
-            if (keys_types[0])
-                strcat (keys_types, ",");
-            strcat (keys_types, list_keys[i]);
-            strcat (keys_types, ":");
-            array_size = weechat_hdata_get_var_array_size_string (ptr_hdata,
-                                                                  NULL,
-                                                                  list_keys[i]);
-            if (array_size)
-                strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_ARRAY);
-            else
+            /* first object for this item: start its count */
+            hdata->pointers[index] = pointer;
+            hdata->remaining[index] = hdata->counts[index];
+        }
+        else
+        {
+            pointer = relay_weechat_msg_hdata_move (hdata, index);
+            if (!pointer)
             {
-                switch (type)
+                if (index > 0)
                 {
-                    case WEECHAT_HDATA_CHAR:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_CHAR);
-                        break;
-                    case WEECHAT_HDATA_INTEGER:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_INT);
-                        break;
-                    case WEECHAT_HDATA_LONG:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_LONG);
-                        break;
-                    case WEECHAT_HDATA_STRING:
-                    case WEECHAT_HDATA_SHARED_STRING:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_STRING);
-                        break;
-                    case WEECHAT_HDATA_POINTER:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_POINTER);
-                        break;
-                    case WEECHAT_HDATA_TIME:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_TIME);
-                        break;
-                    case WEECHAT_HDATA_HASHTABLE:
-                        strcat (keys_types, RELAY_WEECHAT_MSG_OBJ_HASHTABLE);
-                        break;
+                    /* end of this list: move to next object in parent */
+                    index--;
+                    continue;
                 }
+                /* end of list for this head: use next pointer of head */
+                do
+                {
+                    hdata->index_head++;
+                    if (hdata->index_head >= hdata->num_head_pointers)
+                    {
+                        hdata->ended = 1;
+                        return 0;
+                    }
+                    pointer = relay_weechat_msg_hdata_get_head (hdata);
+                } while (!pointer);
+                continue;
             }
+            hdata->pointers[index] = pointer;
         }
+        if (index == hdata->path->num_path - 1)
+            return 1;
+        /* search first object in next item (if not found, move in this one) */
+        pointer = relay_weechat_msg_hdata_path_pointer (
+            hdata->path->vars[index + 1], hdata->pointers[index]);
+        if (pointer)
+            index++;
     }
-    if (!keys_types[0])
-        goto end;
+}
+
+/*
+ * Checks that the current position in hdata is still valid: all pointers are
+ * searched again from the head of path, without going beyond the count of
+ * each item (objects may have been removed since the last page was built).
+ *
+ * Returns:
+ *   1: position is valid
+ *   0: position is invalid (at least one pointer was not found)
+ */
+
+int
+relay_weechat_msg_hdata_check_position (struct t_relay_weechat_msg_hdata *hdata)
+{
+    struct t_hdata_path *ptr_move;
+    void *pointer;
+    int i, steps;
+
+    for (i = 0; i < hdata->path->num_path; i++)
+    {
+        if (i == 0)
+            pointer = relay_weechat_msg_hdata_get_head (hdata);
+        else
+        {
+            pointer = relay_weechat_msg_hdata_path_pointer (
+                hdata->path->vars[i], hdata->pointers[i - 1]);
+        }
+        ptr_move = (hdata->counts[i] < 0) ?
+            hdata->path->vars_prev[i] : hdata->path->vars_next[i];
+        steps = abs (hdata->counts[i]);
+        while (pointer && (pointer != hdata->pointers[i]))
+        {
+            if (!hdata->counts_all[i] && (steps <= 0))
+                return 0;
+            pointer = relay_weechat_msg_hdata_path_pointer (ptr_move,
+                                                            pointer);
+            steps--;
+        }
+        if (!pointer)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Adds a page of hdata to a message: objects are added from the current
+ * position in hdata until the end, or until "max_count" objects have been
+ * added, or until "max_size" bytes have been added to message (0 means no
+ * limit for these arguments); if objects remain, at least one is added.
+ *
+ * The position in hdata is kept, so that next call adds the next objects.
+ * If hdata->check_position is set and if objects have been removed since the
+ * previous call, the hdata is ended (the page is empty); the caller can reset
+ * this flag when it knows that no objects have been removed.
+ *
+ * Returns the number of objects added to message.
+ */
+
+int
+relay_weechat_msg_add_hdata_page (struct t_relay_weechat_msg *msg,
+                                  struct t_relay_weechat_msg_hdata *hdata,
+                                  int max_count, int max_size)
+{
+    int i, pos_count, start_size, count;
+    uint32_t count32;
+
+    if (!msg || !hdata)
+        return 0;
 
-    /* start hdata in message */
     relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_HDATA);
-    relay_weechat_msg_add_string (msg, path_returned);
-    relay_weechat_msg_add_string (msg, keys_types);
+    relay_weechat_msg_add_string (msg, hdata->path->names);
+    relay_weechat_msg_add_string (msg, hdata->path->keys_types);
 
     /* "count" will be set later, with number of objects in hdata */
     pos_count = msg->data_size;
     count = 0;
     relay_weechat_msg_add_int (msg, 0);
-    path_pointers = malloc (sizeof (*path_pointers) * num_path);
-    if (path_pointers)
+    start_size = msg->data_size;
+
+    /* a hdata used by the compiled path has been freed? */
+    if (!hdata->ended && !relay_weechat_msg_hdata_path_is_valid (hdata->path))
+        hdata->ended = 1;
+
+    if (!hdata->ended)
+    {
+        if (!hdata->started)
+        {
+            hdata->started = 1;
+            relay_weechat_msg_hdata_seek (
+                hdata, 0, relay_weechat_msg_hdata_get_head (hdata));
+        }
+        else if (hdata->check_position
+                 && !relay_weechat_msg_hdata_check_position (hdata))
+        {
+            hdata->ended = 1;
+        }
+    }
+
+    while (!hdata->ended)
     {
-        count = relay_weechat_msg_add_hdata_path (msg,
-                                                  list_path,
-                                                  0,
-                                                  path_pointers,
-                                                  ptr_hdata_head,
-                                                  pointer,
-                                                  list_keys);
-        free (path_pointers);
+        for (i = 0; i < hdata->path->num_path; i++)
+        {
+            relay_weechat_msg_add_pointer (msg, hdata->pointers[i]);
+        }
+        relay_weechat_msg_add_hdata_values (
+            msg,
+            hdata->path,
+            hdata->pointers[hdata->path->num_path - 1]);
+        count++;
+        relay_weechat_msg_hdata_seek (hdata, hdata->path->num_path - 1,
+                                      NULL);
+        if ((max_count > 0) && (count >= max_count))
+            break;
+        if ((max_size > 0) && (msg->data_size - start_size >= max_size))
+            break;
     }
+
     count32 = htonl ((uint32_t)count);
     relay_weechat_msg_set_bytes (msg, pos_count, &count32, 4);
 
-    rc = 1;
+    return count;
+}
 
-end:
-    if (list_keys)
-        weechat_string_free_split (list_keys);
-    if (keys_types)
-        free (keys_types);
-    if (list_path)
-        weechat_string_free_split (list_path);
-    if (path_returned)
-        free (path_returned);
-    if (hdata_head)
-        free (hdata_head);
+/*
+ * Frees a hdata structure.
+ */
+
+void
+relay_weechat_msg_hdata_free (struct t_relay_weechat_msg_hdata *hdata)
+{
+    if (!hdata)
+        return;
 
-    return rc;
+    if (hdata->path)
+        relay_weechat_msg_hdata_path_unref (hdata->path);
+    if (hdata->head_list)
+        free (hdata->head_list);
+    if (hdata->counts)
+        free (hdata->counts);
+    if (hdata->counts_all)
+        free (hdata->counts_all);
+    if (hdata->head_pointers)
+        free (hdata->head_pointers);
+    if (hdata->pointers)
+        free (hdata->pointers);
+    if (hdata->remaining)
+        free (hdata->remaining);
+
+    free (hdata);
+}
+
+/*
+ * Adds a hdata to a message.
+ *
+ * Argument path has format:
+ *   hdata_head:ptr->var->var->...->var
+ * where ptr can be a list name, a pointer (0x12345) or a list of pointers
+ * separated by commas (0x12345,0x23456): in this case all pointers are added
+ * in the same hdata
+ *
+ * Argument keys is optional: if not NULL, comma-separated list of keys to
+ * return for hdata.
+ *
+ * Returns:
+ *   1: hdata added to message
+ *   0: error (hdata NOT added to message)
+ */
+
+int
+relay_weechat_msg_add_hdata (struct t_relay_weechat_msg *msg,
+                             const char *path, const char *keys)
+{
+    struct t_relay_weechat_msg_hdata *hdata;
+
+    hdata = relay_weechat_msg_hdata_new (path, keys);
+    if (!hdata)
+        return 0;
+
+    relay_weechat_msg_add_hdata_page (msg, hdata, 0, 0);
+
+    relay_weechat_msg_hdata_free (hdata);
+
+    return 1;
+}
+
+/*
+ * Adds a hdata with objects given by their pointers to a message (see
+ * function relay_weechat_msg_hdata_new_pointers).
+ *
+ * Returns:
+ *   1: hdata added to message
+ *   0: error (hdata NOT added to message)
+ */
+
+int
+relay_weechat_msg_add_hdata_pointers (struct t_relay_weechat_msg *msg,
+                                      const char *hdata_head, void **pointers,
+                                      int num_pointers, const char *keys)
+{
+    struct t_relay_weechat_msg_hdata *hdata;
+
+    hdata = relay_weechat_msg_hdata_new_pointers (hdata_head, pointers,
+                                                  num_pointers, keys);
+    if (!hdata)
+        return 0;
+
+    relay_weechat_msg_add_hdata_page (msg, hdata, 0, 0);
+
+    relay_weechat_msg_hdata_free (hdata);
+
+    return 1;
 }
 
 /*
@@ -1027,81 +1733,257 @@ relay_weechat_msg_add_nicklist (struct t_relay_weechat_msg *msg,
 }
 
 /*
- * Sends a message.
+ * Compresses a message (if not already done with same compression and
+ * level).
+ *
+ * The compressed message is kept in message, so that the same message sent
+ * to many clients is compressed only once.
+ * If compression fails or if the compressed message is not smaller than
+ * the message, msg->compressed is NULL (and the message must be sent
+ * uncompressed).
  */
 
 void
-relay_weechat_msg_send (struct t_relay_client *client,
-                        struct t_relay_weechat_msg *msg)
+relay_weechat_msg_compress (struct t_relay_weechat_msg *msg,
+                            int compression, int level)
 {
     uint32_t size32;
-    char compression, raw_message[1024];
     int rc;
     Bytef *dest;
     uLongf dest_size;
     struct timeval tv1, tv2;
+
+    if (!msg || !msg->data)
+        return;
+
+    /* message already compressed with this compression and level? */
+    if ((msg->compression == compression)
+        && (msg->compression_level == level))
+    {
+        return;
+    }
+
+    relay_weechat_msg_reset_compressed (msg);
+    msg->compression = compression;
+    msg->compression_level = level;
+
+    switch (compression)
+    {
+        case RELAY_WEECHAT_COMPRESSION_ZLIB:
+            dest_size = compressBound (msg->data_size - 5);
+            dest = malloc (dest_size + 5);
+            if (!dest)
+                break;
+            gettimeofday (&tv1, NULL);
+            rc = compress2 (dest + 5, &dest_size,
+                            (Bytef *)(msg->data + 5), msg->data_size - 5,
+                            level);
+            gettimeofday (&tv2, NULL);
+            msg->compression_time = weechat_util_timeval_diff (&tv1, &tv2);
+            if ((rc == Z_OK) && ((int)dest_size + 5 < msg->data_size))
+            {
+                /* set size and compression flag */
+                size32 = htonl ((uint32_t)(dest_size + 5));
+                memcpy (dest, &size32, 4);
+                dest[4] = RELAY_WEECHAT_COMPRESSION_ZLIB;
+                msg->compressed = relay_client_data_new ((char *)dest,
+                                                         dest_size + 5, 0);
+                if (!msg->compressed)
+                    free (dest);
+            }
+            else
+                free (dest);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Compresses a message with the deflate stream of a client (compression
+ * "zlib_stream"): the message is compressed against the previous messages
+ * sent to this client, so it can not be shared with other clients.
+ *
+ * Returns compressed message (with header), NULL if error.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+relay_weechat_msg_compress_stream (struct t_relay_client *client,
+                                   struct t_relay_weechat_msg *msg,
+                                   int level, int *size,
+                                   long long *time_diff)
+{
+    z_stream *stream;
+    char *dest, *dest2;
+    int dest_alloc, rc;
+    uint32_t size32;
+    struct timeval tv1, tv2;
+
+    *size = 0;
+    *time_diff = 0;
+
+    stream = relay_weechat_deflate_get (client, level);
+    if (!stream)
+        return NULL;
+
+    /* 5 bytes for header, 16 bytes for sync flush and empty blocks */
+    dest_alloc = 5 + deflateBound (stream, msg->data_size - 5) + 16;
+    dest = malloc (dest_alloc);
+    if (!dest)
+        return NULL;
+
+    gettimeofday (&tv1, NULL);
+
+    stream->next_in = (Bytef *)(msg->data + 5);
+    stream->avail_in = msg->data_size - 5;
+    stream->next_out = (Bytef *)(dest + 5);
+    stream->avail_out = dest_alloc - 5;
+    while (1)
+    {
+        rc = deflate (stream, Z_SYNC_FLUSH);
+        if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+            break;
+        if ((stream->avail_in == 0) && (stream->avail_out > 0))
+            break;
+        /* output buffer is full: make it bigger */
+        dest2 = realloc (dest, dest_alloc * 2);
+        if (!dest2)
+        {
+            rc = Z_MEM_ERROR;
+            break;
+        }
+        dest = dest2;
+        stream->next_out = (Bytef *)(dest + dest_alloc);
+        stream->avail_out = dest_alloc;
+        dest_alloc *= 2;
+    }
+
+    gettimeofday (&tv2, NULL);
+    *time_diff = weechat_util_timeval_diff (&tv1, &tv2);
+
+    if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+    {
+        /* stream is in an unknown state: a new one will be created */
+        relay_weechat_deflate_free (client);
+        free (dest);
+        return NULL;
+    }
+
+    *size = dest_alloc - stream->avail_out;
+
+    /* set size and compression flag */
+    size32 = htonl ((uint32_t)(*size));
+    memcpy (dest, &size32, 4);
+    dest[4] = RELAY_WEECHAT_COMPRESSION_ZLIB_STREAM;
+
+    return dest;
+}
+
+/*
+ * Sends a message.
+ */
+
+void
+relay_weechat_msg_send (struct t_relay_client *client,
+                        struct t_relay_weechat_msg *msg)
+{
+    uint32_t size32;
+    char raw_message[1024], *dest;
+    int level, dest_size;
     long long time_diff;
+    struct t_relay_client_data *data;
 
-    if (weechat_config_integer (relay_config_network_compression_level) > 0)
+    if (!msg || !msg->data)
+        return;
+
+    level = weechat_config_integer (relay_config_network_compression_level);
+
+    /*
+     * messages are not compressed if the websocket uses "permessage-deflate"
+     * (they are compressed by the websocket)
+     */
+    if (client->ws_deflate && client->ws_deflate->enabled)
+        level = 0;
+
+    if ((level > 0)
+        && (RELAY_WEECHAT_DATA(client, compression) == RELAY_WEECHAT_COMPRESSION_ZLIB_STREAM))
     {
-        switch (RELAY_WEECHAT_DATA(client, compression))
+        dest = relay_weechat_msg_compress_stream (client, msg, level,
+                                                  &dest_size, &time_diff);
+        if (dest)
         {
-            case RELAY_WEECHAT_COMPRESSION_ZLIB:
-                dest_size = compressBound (msg->data_size - 5);
-                dest = malloc (dest_size + 5);
-                if (dest)
-                {
-                    gettimeofday (&tv1, NULL);
-                    rc = compress2 (dest + 5, &dest_size,
-                                    (Bytef *)(msg->data + 5), msg->data_size - 5,
-                                    weechat_config_integer (relay_config_network_compression_level));
-                    gettimeofday (&tv2, NULL);
-                    time_diff = weechat_util_timeval_diff (&tv1, &tv2);
-                    if ((rc == Z_OK) && ((int)dest_size + 5 < msg->data_size))
-                    {
-                        /* set size and compression flag */
-                        size32 = htonl ((uint32_t)(dest_size + 5));
-                        memcpy (dest, &size32, 4);
-                        dest[4] = RELAY_WEECHAT_COMPRESSION_ZLIB;
-
-                        /* display message in raw buffer */
-                        snprintf (raw_message, sizeof (raw_message),
-                                  "obj: %d/%d bytes (%d%%, %.2fms), id: %s",
-                                  (int)dest_size + 5,
-                                  msg->data_size,
-                                  100 - ((((int)dest_size + 5) * 100) / msg->data_size),
-                                  ((float)time_diff) / 1000,
-                                  msg->id);
-
-                        /* send compressed data */
-                        relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
-                                           (const char *)dest, dest_size + 5,
-                                           raw_message);
-
-                        free (dest);
-                        return;
-                    }
-                    free (dest);
-                }
-                break;
-            default:
-                break;
+            /* display message in raw buffer */
+            snprintf (raw_message, sizeof (raw_message),
+                      "obj: %d/%d bytes (%d%%, %.2fms), id: %s",
+                      dest_size,
+                      msg->data_size,
+                      100 - ((dest_size * 100) / msg->data_size),
+                      ((float)time_diff) / 1000,
+                      msg->id);
+
+            /*
+             * send compressed data (not copied if it must be queued);
+             * the key is ignored: a message in the outqueue can not be
+             * removed without breaking the deflate stream
+             */
+            data = relay_client_data_new (dest, dest_size, 0);
+            if (data)
+            {
+                relay_client_send_data (client, RELAY_CLIENT_MSG_STANDARD,
+                                        data, raw_message);
+                relay_client_data_unref (data);
+                return;
+            }
+            free (dest);
+        }
+    }
+    else if ((level > 0)
+             && (RELAY_WEECHAT_DATA(client, compression) != RELAY_WEECHAT_COMPRESSION_OFF))
+    {
+        relay_weechat_msg_compress (msg,
+                                    RELAY_WEECHAT_DATA(client, compression),
+                                    level);
+        if (msg->compressed)
+        {
+            /* display message in raw buffer */
+            snprintf (raw_message, sizeof (raw_message),
+                      "obj: %d/%d bytes (%d%%, %.2fms), id: %s",
+                      msg->compressed->size,
+                      msg->data_size,
+                      100 - ((msg->compressed->size * 100) / msg->data_size),
+                      ((float)msg->compression_time) / 1000,
+                      msg->id);
+
+            /*
+             * send compressed data (shared by all clients: it is not copied
+             * if it must be queued)
+             */
+            relay_client_send_full (client, RELAY_CLIENT_MSG_STANDARD,
+                                    msg->compressed->buffer,
+                                    msg->compressed->size,
+                                    msg->compressed, msg->key, raw_message);
+            return;
         }
     }
 
     /* compression failed (or not asked), send uncompressed message */
 
-    /* set size and compression flag */
+    /*
+     * set size and compression flag (directly in data, to keep compressed
+     * message for other clients)
+     */
     size32 = htonl ((uint32_t)msg->data_size);
-    relay_weechat_msg_set_bytes (msg, 0, &size32, 4);
-    compression = RELAY_WEECHAT_COMPRESSION_OFF;
-    relay_weechat_msg_set_bytes (msg, 4, &compression, 1);
+    memcpy (msg->data, &size32, 4);
+    msg->data[4] = RELAY_WEECHAT_COMPRESSION_OFF;
 
     /* send uncompressed data */
     snprintf (raw_message, sizeof (raw_message),
               "obj: %d bytes, id: %s", msg->data_size, msg->id);
-    relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
-                       msg->data, msg->data_size, raw_message);
+    relay_client_send_full (client, RELAY_CLIENT_MSG_STANDARD,
+                            msg->data, msg->data_size, NULL, msg->key,
+                            raw_message);
 }
 
 /*
@@ -1118,6 +2000,10 @@ relay_weechat_msg_free (struct t_relay_weechat_msg *msg)
         free (msg->id);
     if (msg->data)
         free (msg->data);
+    if (msg->compressed)
+        relay_client_data_unref (msg->compressed);
+    if (msg->key)
+        free (msg->key);
 
     free (msg);
 }
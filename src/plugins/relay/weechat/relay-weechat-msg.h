@@ -22,10 +22,14 @@
 
 #include <time.h>
 
+struct t_relay_client_data;
 struct t_relay_weechat_nicklist;
 
 #define RELAY_WEECHAT_MSG_INITIAL_ALLOC 4096
 
+/* max number of compiled hdata paths kept for next messages */
+#define RELAY_WEECHAT_MSG_HDATA_PATHS_MAX 64
+
 /* object ids in binary messages */
 #define RELAY_WEECHAT_MSG_OBJ_CHAR      "chr"
 #define RELAY_WEECHAT_MSG_OBJ_INT       "int"
@@ -46,9 +50,59 @@ struct t_relay_weechat_msg
     char *data;                        /* binary buffer                     */
     int data_alloc;                    /* currently allocated size          */
     int data_size;                     /* current size of buffer            */
+    /* compressed message, computed once and sent to all clients */
+    int compression;                   /* compression of "compressed"       */
+                                       /* (-1 if not yet compressed)        */
+    int compression_level;             /* compression level used            */
+    struct t_relay_client_data *compressed; /* compressed message (NULL */
+                                       /* if compression failed/useless),   */
+                                       /* shared by outqueues of clients    */
+    long long compression_time;        /* compression time (microseconds)   */
+    char *key;                         /* key to replace a message not yet  */
+                                       /* sent in outqueue (NULL if none)   */
+};
+
+struct t_relay_weechat_msg_hdata_path
+{
+    char *names;                       /* hdata path returned (hdata names) */
+    char *keys_types;                  /* "key1:type1,key2:type2,..."       */
+    int num_path;                      /* number of items in path           */
+    struct t_hdata *hdata_head;        /* hdata for head of path            */
+    struct t_hdata_path **vars;        /* var to get first object of each   */
+                                       /* item from its parent (NULL for 0) */
+    struct t_hdata_path **vars_prev;   /* var "prev" for each item of path  */
+    struct t_hdata_path **vars_next;   /* var "next" for each item of path  */
+    int num_keys;                      /* number of keys returned in hdata  */
+    struct t_hdata_path **keys;        /* keys returned in hdata            */
+    int refcount;                      /* number of hdata using this path   */
+                                       /* (+1 if kept for next messages)    */
 };
 
+struct t_relay_weechat_msg_hdata
+{
+    struct t_relay_weechat_msg_hdata_path *path; /* compiled path and keys  */
+    char *head_list;                   /* list name for head of path        */
+                                       /* (NULL if head is pointer(s))      */
+    void **head_pointers;              /* pointers for head of path         */
+    int num_head_pointers;             /* number of pointers for head       */
+    int check_pointers;                /* 1 if head pointers are checked    */
+    int *counts;                       /* count for each item of path       */
+    int *counts_all;                   /* 1 if count is "*" for item        */
+    /* position: next object to add in message */
+    int started;                       /* 1 if first object has been found  */
+    int ended;                         /* 1 if no more objects to add       */
+    int index_head;                    /* index of current head pointer     */
+    int check_position;                /* 1 if position is checked before   */
+                                       /* next page (objects removed?)      */
+    void **pointers;                   /* current pointer for each item     */
+    int *remaining;                    /* remaining count for each item     */
+};
+
+extern struct t_hashtable *relay_weechat_msg_hdata_paths;
+
 extern struct t_relay_weechat_msg *relay_weechat_msg_new (const char *id);
+extern void relay_weechat_msg_set_key (struct t_relay_weechat_msg *msg,
+                                       const char *key);
 extern void relay_weechat_msg_add_bytes (struct t_relay_weechat_msg *msg,
                                          const void *buffer, int size);
 extern void relay_weechat_msg_set_bytes (struct t_relay_weechat_msg *msg,
@@ -72,8 +126,32 @@ extern void relay_weechat_msg_add_time (struct t_relay_weechat_msg *msg,
                                         time_t time);
 extern void relay_weechat_msg_add_hashtable (struct t_relay_weechat_msg *msg,
                                              struct t_hashtable *hashtable);
+extern struct t_relay_weechat_msg_hdata_path *relay_weechat_msg_hdata_path_get (const char *hdata_head,
+                                                                               char **list_vars,
+                                                                               int num_vars,
+                                                                               const char *keys);
+extern void relay_weechat_msg_hdata_path_unref (struct t_relay_weechat_msg_hdata_path *path);
+extern void relay_weechat_msg_hdata_paths_free_value_cb (struct t_hashtable *hashtable,
+                                                         const void *key,
+                                                         void *value);
+extern void relay_weechat_msg_hdata_paths_free_all ();
+extern struct t_relay_weechat_msg_hdata *relay_weechat_msg_hdata_new (const char *path,
+                                                                     const char *keys);
+extern struct t_relay_weechat_msg_hdata *relay_weechat_msg_hdata_new_pointers (const char *hdata_head,
+                                                                              void **pointers,
+                                                                              int num_pointers,
+                                                                              const char *keys);
+extern int relay_weechat_msg_add_hdata_page (struct t_relay_weechat_msg *msg,
+                                             struct t_relay_weechat_msg_hdata *hdata,
+                                             int max_count, int max_size);
+extern void relay_weechat_msg_hdata_free (struct t_relay_weechat_msg_hdata *hdata);
 extern int relay_weechat_msg_add_hdata (struct t_relay_weechat_msg *msg,
                                         const char *path, const char *keys);
+extern int relay_weechat_msg_add_hdata_pointers (struct t_relay_weechat_msg *msg,
+                                                 const char *hdata_head,
+                                                 void **pointers,
+                                                 int num_pointers,
+                                                 const char *keys);
 extern void relay_weechat_msg_add_infolist (struct t_relay_weechat_msg *msg,
                                             const char *name,
                                             void *pointer,
@@ -81,6 +159,12 @@ extern void relay_weechat_msg_add_infolist (struct t_relay_weechat_msg *msg,
 extern void relay_weechat_msg_add_nicklist (struct t_relay_weechat_msg *msg,
                                             struct t_gui_buffer *buffer,
                                             struct t_relay_weechat_nicklist *nicklist);
+extern void relay_weechat_msg_compress (struct t_relay_weechat_msg *msg,
+                                        int compression, int level);
+extern char *relay_weechat_msg_compress_stream (struct t_relay_client *client,
+                                                struct t_relay_weechat_msg *msg,
+                                                int level, int *size,
+                                                long long *time_diff);
 extern void relay_weechat_msg_send (struct t_relay_client *client,
                                     struct t_relay_weechat_msg *msg);
 extern void relay_weechat_msg_free (struct t_relay_weechat_msg *msg);
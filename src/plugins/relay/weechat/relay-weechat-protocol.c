@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #include "../../weechat-plugin.h"
 #include "../relay.h"
@@ -33,6 +34,7 @@
 #include "../relay-client.h"
 #include "../relay-auth.h"
 #include "../relay-config.h"
+#include "../relay-filter.h"
 #include "../relay-raw.h"
 
 
@@ -159,6 +161,36 @@ relay_weechat_protocol_is_sync (struct t_relay_client *ptr_client,
     return 0;
 }
 
+/*
+ * Gets filter on lines of a buffer synchronized.
+ *
+ * First searches buffer with full_name in hashtable "buffers_sync": if it is
+ * found, the filter of this buffer is returned (it can be NULL).
+ * Otherwise the filter of special name "*" is returned (if any).
+ *
+ * Returns pointer to filter, NULL if lines of buffer are not filtered.
+ */
+
+struct t_relay_filter *
+relay_weechat_protocol_get_filter (struct t_relay_client *ptr_client,
+                                   struct t_gui_buffer *buffer)
+{
+    const char *ptr_full_name;
+
+    ptr_full_name = weechat_buffer_get_string (buffer, "full_name");
+    if (weechat_hashtable_has_key (RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
+                                   ptr_full_name))
+    {
+        return weechat_hashtable_get (
+            RELAY_WEECHAT_DATA(ptr_client, buffers_filter),
+            ptr_full_name);
+    }
+
+    return weechat_hashtable_get (
+        RELAY_WEECHAT_DATA(ptr_client, buffers_filter),
+        "*");
+}
+
 /*
  * Replies to a client handshake command.
  */
@@ -229,7 +261,7 @@ relay_weechat_protocol_handshake_reply (struct t_relay_client *client,
 
 RELAY_WEECHAT_PROTOCOL_CALLBACK(handshake)
 {
-    char **options, **auths, *pos;
+    char **options, **auths, **compressions, *pos;
     int i, j, index_hash_algo, hash_algo_found, auth_allowed, compression;
     int password_received, plain_text_password;
 
@@ -292,9 +324,30 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(handshake)
                 }
                 else if (strcmp (options[i], "compression") == 0)
                 {
-                    compression = relay_weechat_compression_search (pos);
-                    if (compression >= 0)
-                        RELAY_WEECHAT_DATA(client, compression) = compression;
+                    /* use first compression supported (list sorted by client) */
+                    compressions = weechat_string_split (
+                        pos,
+                        ":",
+                        NULL,
+                        WEECHAT_STRING_SPLIT_STRIP_LEFT
+                        | WEECHAT_STRING_SPLIT_STRIP_RIGHT
+                        | WEECHAT_STRING_SPLIT_COLLAPSE_SEPS,
+                        0,
+                        NULL);
+                    if (compressions)
+                    {
+                        for (j = 0; compressions[j]; j++)
+                        {
+                            compression = relay_weechat_compression_search (
+                                compressions[j]);
+                            if (compression >= 0)
+                            {
+                                RELAY_WEECHAT_DATA(client, compression) = compression;
+                                break;
+                            }
+                        }
+                        weechat_string_free_split (compressions);
+                    }
                 }
             }
         }
@@ -337,7 +390,7 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(handshake)
  *                  hash is given in hexadecimal
  *   totp           time-based one time password used as secondary
  *                  authentication factor
- *   compression    zlib (default) or off
+ *   compression    zlib (default), zlib_stream or off
  *
  * Message looks like:
  *   init password=mypass
@@ -482,6 +535,160 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(hdata)
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Sends a page of hdata for a cursor.
+ *
+ * The message contains the hdata and the cursor name, which is NULL if there
+ * are no more objects: in this case the cursor is closed.
+ */
+
+void
+relay_weechat_protocol_cursor_send_page (struct t_relay_client *client,
+                                         struct t_relay_weechat_cursor *cursor)
+{
+    struct t_relay_weechat_msg *msg;
+
+    msg = relay_weechat_msg_new (cursor->id);
+    if (!msg)
+        return;
+
+    /* objects may have been removed since previous page: check position */
+    cursor->hdata->check_position =
+        (cursor->changes != relay_weechat_cursors_changes);
+
+    relay_weechat_msg_add_hdata_page (
+        msg,
+        cursor->hdata,
+        cursor->count,
+        weechat_config_integer (relay_config_weechat_cursor_page_max_size) * 1024);
+    cursor->changes = relay_weechat_cursors_changes;
+    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_STRING);
+    relay_weechat_msg_add_string (msg,
+                                  (cursor->hdata->ended) ? NULL : cursor->name);
+    relay_weechat_msg_send (client, msg);
+    relay_weechat_msg_free (msg);
+
+    if (cursor->hdata->ended)
+    {
+        weechat_hashtable_remove (RELAY_WEECHAT_DATA(client, cursors),
+                                  cursor->name);
+    }
+}
+
+/*
+ * Sends an empty page for a cursor (invalid hdata path or cursor not found).
+ */
+
+void
+relay_weechat_protocol_cursor_send_empty (struct t_relay_client *client,
+                                          const char *id)
+{
+    struct t_relay_weechat_msg *msg;
+
+    msg = relay_weechat_msg_new (id);
+    if (!msg)
+        return;
+
+    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_HDATA);
+    relay_weechat_msg_add_string (msg, NULL);  /* h-path */
+    relay_weechat_msg_add_string (msg, NULL);  /* keys */
+    relay_weechat_msg_add_int (msg, 0);  /* count */
+    relay_weechat_msg_add_type (msg, RELAY_WEECHAT_MSG_OBJ_STRING);
+    relay_weechat_msg_add_string (msg, NULL);  /* cursor */
+    relay_weechat_msg_send (client, msg);
+    relay_weechat_msg_free (msg);
+}
+
+/*
+ * Gets the max number of objects by page received in command "cursor".
+ *
+ * Returns the number of objects (0 = no limit), -1 if invalid.
+ */
+
+int
+relay_weechat_protocol_cursor_count (const char *str_count)
+{
+    char *error;
+    long count;
+
+    error = NULL;
+    count = strtol (str_count, &error, 10);
+    if (!error || error[0] || (count < 0) || (count > INT_MAX))
+        return -1;
+
+    return (int)count;
+}
+
+/*
+ * Callback for command "cursor" (from client).
+ *
+ * Message looks like:
+ *   cursor open 500 buffer:0x12345/own_lines/last_line(-5000)/data date,prefix,message
+ *   cursor next 1
+ *   cursor next 1 100
+ *   cursor stream 1
+ *   cursor close 1
+ */
+
+RELAY_WEECHAT_PROTOCOL_CALLBACK(cursor)
+{
+    struct t_relay_weechat_cursor *ptr_cursor;
+    int count;
+
+    RELAY_WEECHAT_PROTOCOL_MIN_ARGS(2);
+
+    if (strcmp (argv[0], "open") == 0)
+    {
+        RELAY_WEECHAT_PROTOCOL_MIN_ARGS(3);
+        count = relay_weechat_protocol_cursor_count (argv[1]);
+        ptr_cursor = (count >= 0) ?
+            relay_weechat_cursor_new (client, id, argv[2],
+                                      (argc > 3) ? argv_eol[3] : NULL,
+                                      count) : NULL;
+        if (ptr_cursor)
+            relay_weechat_protocol_cursor_send_page (client, ptr_cursor);
+        else
+            relay_weechat_protocol_cursor_send_empty (client, id);
+    }
+    else if ((strcmp (argv[0], "next") == 0)
+             || (strcmp (argv[0], "stream") == 0))
+    {
+        ptr_cursor = weechat_hashtable_get (RELAY_WEECHAT_DATA(client, cursors),
+                                            argv[1]);
+        if (!ptr_cursor)
+        {
+            relay_weechat_protocol_cursor_send_empty (client, id);
+            return WEECHAT_RC_OK;
+        }
+        relay_weechat_cursor_set_id (ptr_cursor, id);
+        if (argc > 2)
+        {
+            count = relay_weechat_protocol_cursor_count (argv[2]);
+            if (count >= 0)
+                ptr_cursor->count = count;
+        }
+        if (strcmp (argv[0], "next") == 0)
+        {
+            ptr_cursor->stream = 0;
+            relay_weechat_protocol_cursor_send_page (client, ptr_cursor);
+        }
+        else
+        {
+            /* pages are sent when the client has read previous data */
+            ptr_cursor->stream = 1;
+            relay_weechat_protocol_cursors_stream (client);
+        }
+    }
+    else if (strcmp (argv[0], "close") == 0)
+    {
+        weechat_hashtable_remove (RELAY_WEECHAT_DATA(client, cursors), argv[1]);
+    }
+    else
+        return WEECHAT_RC_ERROR;
+
+    return WEECHAT_RC_OK;
+}
+
 /*
  * Callback for command "info" (from client).
  *
@@ -840,8 +1047,186 @@ error:
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Renames a buffer in hashtable "buffers_sync" of a client (after signal
+ * "buffer_renamed").
+ */
+
+void
+relay_weechat_protocol_rename_sync (struct t_relay_client *client,
+                                    struct t_gui_buffer *buffer)
+{
+    const char *ptr_old_full_name;
+    int *ptr_old_flags, flags;
+    struct t_relay_filter *ptr_filter;
+
+    ptr_old_full_name = weechat_buffer_get_string (buffer, "old_full_name");
+    if (!ptr_old_full_name || !ptr_old_full_name[0])
+        return;
+
+    ptr_old_flags = weechat_hashtable_get (
+        RELAY_WEECHAT_DATA(client, buffers_sync),
+        ptr_old_full_name);
+    if (ptr_old_flags)
+    {
+        flags = *ptr_old_flags;
+        weechat_hashtable_remove (
+            RELAY_WEECHAT_DATA(client, buffers_sync),
+            ptr_old_full_name);
+        weechat_hashtable_set (
+            RELAY_WEECHAT_DATA(client, buffers_sync),
+            weechat_buffer_get_string (buffer, "full_name"),
+            &flags);
+    }
+
+    ptr_filter = weechat_hashtable_get (
+        RELAY_WEECHAT_DATA(client, buffers_filter),
+        ptr_old_full_name);
+    if (ptr_filter)
+    {
+        /* keep a reference: the filter is released when it is removed */
+        ptr_filter->refcount++;
+        weechat_hashtable_remove (
+            RELAY_WEECHAT_DATA(client, buffers_filter),
+            ptr_old_full_name);
+        weechat_hashtable_set (
+            RELAY_WEECHAT_DATA(client, buffers_filter),
+            weechat_buffer_get_string (buffer, "full_name"),
+            ptr_filter);
+    }
+}
+
+/*
+ * Frees a message of hashtable with messages built for filters.
+ */
+
+void
+relay_weechat_protocol_free_filtered_msg (struct t_hashtable *hashtable,
+                                          const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    if (value)
+        relay_weechat_msg_free ((struct t_relay_weechat_msg *)value);
+}
+
+/*
+ * Gets message with lines matching a filter: the message is built only once
+ * for each filter (and shared by all clients using this filter), so each
+ * line is checked only once per filter.
+ *
+ * Argument "msgs" is a pointer to a hashtable (created on first call), which
+ * must be freed by the caller.
+ *
+ * Returns pointer to message, NULL if no line matches filter.
+ */
+
+struct t_relay_weechat_msg *
+relay_weechat_protocol_filtered_msg (struct t_hashtable **msgs,
+                                     struct t_relay_filter *filter,
+                                     const char *id,
+                                     const char *hdata_head,
+                                     void **pointers, int num_pointers,
+                                     const char *keys)
+{
+    struct t_relay_weechat_msg *msg;
+    void **filtered_pointers;
+    int i, num_filtered;
+
+    if (!*msgs)
+    {
+        *msgs = weechat_hashtable_new (8,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+        if (!*msgs)
+            return NULL;
+        weechat_hashtable_set_pointer (*msgs, "callback_free_value",
+                                       &relay_weechat_protocol_free_filtered_msg);
+    }
+
+    if (weechat_hashtable_has_key (*msgs, filter))
+        return weechat_hashtable_get (*msgs, filter);
+
+    msg = NULL;
+
+    filtered_pointers = malloc (num_pointers * sizeof (*filtered_pointers));
+    if (filtered_pointers)
+    {
+        num_filtered = 0;
+        for (i = 0; i < num_pointers; i++)
+        {
+            if (relay_filter_match_line (filter, pointers[i]))
+            {
+                filtered_pointers[num_filtered] = pointers[i];
+                num_filtered++;
+            }
+        }
+        if (num_filtered > 0)
+        {
+            msg = relay_weechat_msg_new (id);
+            if (msg)
+            {
+                relay_weechat_msg_add_hdata_pointers (
+                    msg, hdata_head, filtered_pointers, num_filtered, keys);
+            }
+        }
+        free (filtered_pointers);
+    }
+
+    weechat_hashtable_set (*msgs, filter, msg);
+
+    return msg;
+}
+
+/*
+ * Checks if new lines of a buffer must be dropped for a client: if the
+ * outqueue of client is full (option relay.weechat.outqueue_max_size) or if
+ * lines have already been dropped for this buffer (the client will receive
+ * a message "_buffer_resync" when its outqueue is empty).
+ *
+ * Returns:
+ *   1: lines must be dropped
+ *   0: lines can be sent
+ */
+
+int
+relay_weechat_protocol_drop_lines (struct t_relay_client *client,
+                                   struct t_gui_buffer *buffer)
+{
+    int max_size;
+
+    if (weechat_hashtable_has_key (RELAY_WEECHAT_DATA(client, buffers_resync),
+                                   buffer))
+    {
+        return 1;
+    }
+
+    max_size = weechat_config_integer (relay_config_weechat_outqueue_max_size);
+    if ((max_size <= 0) || (client->outqueue_size < max_size * 1024))
+        return 0;
+
+    weechat_hashtable_set (RELAY_WEECHAT_DATA(client, buffers_resync),
+                           buffer, NULL);
+    relay_weechat_hook_timer_resync (client);
+
+    return 1;
+}
+
 /*
  * Callback for signals "buffer_*".
+ *
+ * The signal is hooked once for all clients: the message is built only once
+ * (and compressed only once for each compression), then sent to all clients
+ * synchronized with this buffer.
+ *
+ * Messages with title and local variables of buffer have a key: if the
+ * client is slow, a message not yet sent is replaced by the newest one.
+ *
+ * Lines added are checked against the filter of buffer set by each client
+ * (command "sync"): a message is built once for each filter used.
  */
 
 int
@@ -850,336 +1235,272 @@ relay_weechat_protocol_signal_buffer_cb (const void *pointer, void *data,
                                          const char *type_data,
                                          void *signal_data)
 {
-    struct t_relay_client *ptr_client;
+    struct t_relay_client *ptr_client, *ptr_next_client;
     struct t_gui_line *ptr_line;
     struct t_hdata *ptr_hdata_line, *ptr_hdata_line_data;
     struct t_gui_line_data *ptr_line_data;
     struct t_gui_buffer *ptr_buffer;
-    struct t_relay_weechat_msg *msg;
-    char cmd_hdata[64], str_signal[128];
-    const char *ptr_old_full_name;
-    int *ptr_old_flags, flags;
+    struct t_relay_weechat_msg *msg, *ptr_msg;
+    struct t_relay_filter *ptr_filter;
+    struct t_hashtable *filtered_msgs;
+    struct t_arraylist *ptr_lines;
+    char str_signal[128], str_key[128];
+    const char *ptr_hdata_head, *ptr_keys;
+    void **pointers, **lines_pointers, *ptr_object;
+    int sync_flags, buffer_renamed, buffer_closing, line_added, i, size;
+    int num_pointers;
 
     /* make C compiler happy */
+    (void) pointer;
     (void) data;
     (void) type_data;
 
-    ptr_client = (struct t_relay_client *)pointer;
-    if (!ptr_client || !relay_client_valid (ptr_client))
+    if (!relay_weechat_signals_clients)
         return WEECHAT_RC_OK;
 
     snprintf (str_signal, sizeof (str_signal), "_%s", signal);
 
-    if (strcmp (signal, "buffer_opened") == 0)
+    ptr_buffer = NULL;
+    ptr_hdata_head = NULL;
+    ptr_keys = NULL;
+    pointers = &ptr_object;
+    lines_pointers = NULL;
+    num_pointers = 1;
+    sync_flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
+        RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+    buffer_renamed = 0;
+    buffer_closing = 0;
+    line_added = 0;
+    str_key[0] = '\0';
+
+    if ((strcmp (signal, "buffer_line_added") == 0)
+        || (strcmp (signal, "buffer_lines_added") == 0))
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        /*
+         * lines added in a batch (all in the same buffer) are sent in a
+         * single message "_buffer_line_added", with one hdata containing
+         * all lines
+         */
+        if (strcmp (signal, "buffer_lines_added") == 0)
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,short_name,"
-                                             "nicklist,title,local_variables,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_lines = (struct t_arraylist *)signal_data;
+            if (!ptr_lines)
+                return WEECHAT_RC_OK;
+            size = weechat_arraylist_size (ptr_lines);
+            if (size <= 0)
+                return WEECHAT_RC_OK;
+            ptr_line = (struct t_gui_line *)weechat_arraylist_get (ptr_lines,
+                                                                   0);
         }
-    }
-    else if (strcmp (signal, "buffer_type_changed") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        else
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,type");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_lines = NULL;
+            size = 1;
+            ptr_line = (struct t_gui_line *)signal_data;
         }
-    }
-    else if (strcmp (signal, "buffer_moved") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
+        if (!ptr_line)
             return WEECHAT_RC_OK;
 
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
-    }
-    else if ((strcmp (signal, "buffer_merged") == 0)
-             || (strcmp (signal, "buffer_unmerged") == 0))
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
+        ptr_hdata_line = weechat_hdata_get ("line");
+        if (!ptr_hdata_line)
             return WEECHAT_RC_OK;
 
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
-    }
-    else if ((strcmp (signal, "buffer_hidden") == 0)
-             || (strcmp (signal, "buffer_unhidden") == 0))
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
+        ptr_hdata_line_data = weechat_hdata_get ("line_data");
+        if (!ptr_hdata_line_data)
+            return WEECHAT_RC_OK;
+
+        ptr_line_data = weechat_hdata_pointer (ptr_hdata_line, ptr_line, "data");
+        if (!ptr_line_data)
+            return WEECHAT_RC_OK;
+
+        ptr_buffer = weechat_hdata_pointer (ptr_hdata_line_data, ptr_line_data,
+                                            "buffer");
+        if (!ptr_buffer || relay_weechat_is_relay_buffer (ptr_buffer))
             return WEECHAT_RC_OK;
 
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        snprintf (str_signal, sizeof (str_signal), "_buffer_line_added");
+        /* pointers are given directly to the hdata (no path to parse) */
+        ptr_hdata_head = "line_data";
+        if (ptr_lines)
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
+            lines_pointers = malloc (size * sizeof (*lines_pointers));
+            if (!lines_pointers)
+                return WEECHAT_RC_OK;
+            num_pointers = 0;
+            for (i = 0; i < size; i++)
             {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
+                ptr_line = (struct t_gui_line *)weechat_arraylist_get (
+                    ptr_lines, i);
+                ptr_line_data = weechat_hdata_pointer (ptr_hdata_line,
+                                                       ptr_line, "data");
+                if (!ptr_line_data)
+                    continue;
+                lines_pointers[num_pointers] = ptr_line_data;
+                num_pointers++;
             }
+            pointers = lines_pointers;
+        }
+        else
+        {
+            ptr_object = ptr_line_data;
         }
+        ptr_keys = "buffer,date,date_printed,displayed,notify_level,"
+            "highlight,tags_array,prefix,message";
+        /* send signal only if sync with flag "buffer" */
+        sync_flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+        line_added = 1;
     }
-    else if (strcmp (signal, "buffer_renamed") == 0)
+    else
     {
         ptr_buffer = (struct t_gui_buffer *)signal_data;
         if (!ptr_buffer)
             return WEECHAT_RC_OK;
 
-        /* rename old buffer name if present in hashtable "buffers_sync" */
-        ptr_old_full_name = weechat_buffer_get_string (ptr_buffer,
-                                                       "old_full_name");
-        if (ptr_old_full_name && ptr_old_full_name[0])
+        if (strcmp (signal, "buffer_opened") == 0)
         {
-            ptr_old_flags = weechat_hashtable_get (
-                RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
-                ptr_old_full_name);
-            if (ptr_old_flags)
-            {
-                flags = *ptr_old_flags;
-                weechat_hashtable_remove (
-                    RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
-                    ptr_old_full_name);
-                weechat_hashtable_set (
-                    RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
-                    weechat_buffer_get_string (ptr_buffer, "full_name"),
-                    &flags);
-            }
+            ptr_keys = "number,full_name,short_name,nicklist,title,"
+                "local_variables,prev_buffer,next_buffer";
         }
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        else if (strcmp (signal, "buffer_type_changed") == 0)
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,short_name,"
-                                             "local_variables");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_keys = "number,full_name,type";
         }
-    }
-    else if (strcmp (signal, "buffer_title_changed") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        else if ((strcmp (signal, "buffer_moved") == 0)
+                 || (strcmp (signal, "buffer_merged") == 0)
+                 || (strcmp (signal, "buffer_unmerged") == 0)
+                 || (strcmp (signal, "buffer_hidden") == 0)
+                 || (strcmp (signal, "buffer_unhidden") == 0))
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,title");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_keys = "number,full_name,prev_buffer,next_buffer";
         }
-    }
-    else if (strncmp (signal, "buffer_localvar_", 16) == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        else if (strcmp (signal, "buffer_renamed") == 0)
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,local_variables");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_keys = "number,full_name,short_name,local_variables";
+            buffer_renamed = 1;
         }
-    }
-    else if (strcmp (signal, "buffer_cleared") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer || relay_weechat_is_relay_buffer (ptr_buffer))
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        else if (strcmp (signal, "buffer_title_changed") == 0)
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
+            ptr_keys = "number,full_name,title";
+            snprintf (str_key, sizeof (str_key),
+                      "title:0x%lx", (unsigned long)ptr_buffer);
         }
-    }
-    else if (strcmp (signal, "buffer_line_added") == 0)
-    {
-        ptr_line = (struct t_gui_line *)signal_data;
-        if (!ptr_line)
-            return WEECHAT_RC_OK;
-
-        ptr_hdata_line = weechat_hdata_get ("line");
-        if (!ptr_hdata_line)
+        else if (strncmp (signal, "buffer_localvar_", 16) == 0)
+        {
+            ptr_keys = "number,full_name,local_variables";
+            snprintf (str_key, sizeof (str_key),
+                      "localvar:0x%lx", (unsigned long)ptr_buffer);
+        }
+        else if (strcmp (signal, "buffer_cleared") == 0)
+        {
+            if (relay_weechat_is_relay_buffer (ptr_buffer))
+                return WEECHAT_RC_OK;
+            ptr_keys = "number,full_name";
+            /* send signal only if sync with flag "buffer" */
+            sync_flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+        }
+        else if (strcmp (signal, "buffer_closing") == 0)
+        {
+            ptr_keys = "number,full_name";
+            buffer_closing = 1;
+        }
+        else
+        {
+            /* signal not sent to clients */
             return WEECHAT_RC_OK;
+        }
 
-        ptr_hdata_line_data = weechat_hdata_get ("line_data");
-        if (!ptr_hdata_line_data)
-            return WEECHAT_RC_OK;
+        ptr_hdata_head = "buffer";
+        ptr_object = ptr_buffer;
+    }
 
-        ptr_line_data = weechat_hdata_pointer (ptr_hdata_line, ptr_line, "data");
-        if (!ptr_line_data)
-            return WEECHAT_RC_OK;
+    msg = NULL;
+    filtered_msgs = NULL;
 
-        ptr_buffer = weechat_hdata_pointer (ptr_hdata_line_data, ptr_line_data,
-                                            "buffer");
-        if (!ptr_buffer || relay_weechat_is_relay_buffer (ptr_buffer))
-            return WEECHAT_RC_OK;
+    ptr_client = relay_clients;
+    while (ptr_client)
+    {
+        ptr_next_client = ptr_client->next_client;
 
-        /* send signal only if sync with flag "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+        if (RELAY_WEECHAT_SIGNALS_HOOKED(ptr_client))
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
+            /* rename old buffer name if present in hashtable "buffers_sync" */
+            if (buffer_renamed)
+                relay_weechat_protocol_rename_sync (ptr_client, ptr_buffer);
+
+            if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
+                                                sync_flags))
             {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "line_data:0x%lx",
-                          (unsigned long)ptr_line_data);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "buffer,date,date_printed,"
-                                             "displayed,notify_level,"
-                                             "highlight,tags_array,prefix,"
-                                             "message");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
+                ptr_filter = (line_added) ?
+                    relay_weechat_protocol_get_filter (ptr_client,
+                                                       ptr_buffer) : NULL;
+                if (ptr_filter)
+                {
+                    ptr_msg = relay_weechat_protocol_filtered_msg (
+                        &filtered_msgs, ptr_filter, str_signal,
+                        ptr_hdata_head, pointers, num_pointers, ptr_keys);
+                }
+                else
+                {
+                    /* message is built for first client synchronized */
+                    if (!msg)
+                    {
+                        msg = relay_weechat_msg_new (str_signal);
+                        if (msg)
+                        {
+                            relay_weechat_msg_add_hdata_pointers (
+                                msg, ptr_hdata_head, pointers, num_pointers,
+                                ptr_keys);
+                            if (str_key[0])
+                                relay_weechat_msg_set_key (msg, str_key);
+                        }
+                    }
+                    ptr_msg = msg;
+                }
+
+                /* no message if all lines are filtered out */
+                if (ptr_msg)
+                {
+                    if (line_added
+                        && relay_weechat_protocol_drop_lines (ptr_client,
+                                                              ptr_buffer))
+                    {
+                        ptr_client->msgs_dropped++;
+                    }
+                    else
+                    {
+                        relay_weechat_msg_send (ptr_client, ptr_msg);
+                    }
+                }
             }
-        }
-    }
-    else if (strcmp (signal, "buffer_closing") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
 
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
+            /* remove buffer from hashtables */
+            if (buffer_closing)
             {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (unsigned long)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
+                weechat_hashtable_remove (
+                    RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
+                    weechat_buffer_get_string (ptr_buffer, "full_name"));
+                weechat_hashtable_remove (
+                    RELAY_WEECHAT_DATA(ptr_client, buffers_filter),
+                    weechat_buffer_get_string (ptr_buffer, "full_name"));
+                weechat_hashtable_remove (
+                    RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
+                    ptr_buffer);
+                weechat_hashtable_remove (
+                    RELAY_WEECHAT_DATA(ptr_client, buffers_resync),
+                    ptr_buffer);
             }
         }
 
-        /* remove buffer from hashtables */
-        weechat_hashtable_remove (
-            RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
-            weechat_buffer_get_string (ptr_buffer, "full_name"));
-        weechat_hashtable_remove (
-            RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
-            ptr_buffer);
+        ptr_client = ptr_next_client;
     }
 
+    if (msg)
+        relay_weechat_msg_free (msg);
+    if (filtered_msgs)
+        weechat_hashtable_free (filtered_msgs);
+    if (lines_pointers)
+        free (lines_pointers);
+
     return WEECHAT_RC_OK;
 }
 
@@ -1255,6 +1576,16 @@ relay_weechat_protocol_timer_nicklist_cb (const void *pointer, void *data,
     if (!ptr_client || !relay_client_valid (ptr_client))
         return WEECHAT_RC_OK;
 
+    /*
+     * if client is slow (data still in outqueue), postpone the send of
+     * nicklist: new diffs will be merged in the same message
+     */
+    if (ptr_client->outqueue)
+    {
+        relay_weechat_hook_timer_nicklist (ptr_client);
+        return WEECHAT_RC_OK;
+    }
+
     weechat_hashtable_map (RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
                            &relay_weechat_protocol_nicklist_map_cb,
                            ptr_client);
@@ -1267,7 +1598,194 @@ relay_weechat_protocol_timer_nicklist_cb (const void *pointer, void *data,
 }
 
 /*
- * Callback for hsignals "nicklist_*".
+ * Callback for entries in hashtable "buffers_resync" of client (sends
+ * message "_buffer_resync" for each buffer in this hashtable).
+ */
+
+void
+relay_weechat_protocol_resync_map_cb (void *data,
+                                      struct t_hashtable *hashtable,
+                                      const void *key,
+                                      const void *value)
+{
+    struct t_relay_client *ptr_client;
+    struct t_gui_buffer *ptr_buffer;
+    struct t_hdata *ptr_hdata;
+    struct t_relay_weechat_msg *msg;
+    char cmd_hdata[64];
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) value;
+
+    ptr_client = (struct t_relay_client *)data;
+    ptr_buffer = (struct t_gui_buffer *)key;
+
+    ptr_hdata = weechat_hdata_get ("buffer");
+    if (!ptr_hdata
+        || !weechat_hdata_check_pointer (ptr_hdata,
+                                         weechat_hdata_get_list (ptr_hdata, "gui_buffers"),
+                                         ptr_buffer))
+    {
+        return;
+    }
+
+    msg = relay_weechat_msg_new ("_buffer_resync");
+    if (msg)
+    {
+        snprintf (cmd_hdata, sizeof (cmd_hdata),
+                  "buffer:0x%lx", (unsigned long)ptr_buffer);
+        relay_weechat_msg_add_hdata (msg, cmd_hdata, "number,full_name");
+        relay_weechat_msg_send (ptr_client, msg);
+        relay_weechat_msg_free (msg);
+    }
+}
+
+/*
+ * Callback for resync timer: when all data has been sent to the client,
+ * sends message "_buffer_resync" for buffers with lines dropped.
+ */
+
+int
+relay_weechat_protocol_timer_resync_cb (const void *pointer, void *data,
+                                        int remaining_calls)
+{
+    struct t_relay_client *ptr_client;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) remaining_calls;
+
+    ptr_client = (struct t_relay_client *)pointer;
+    if (!ptr_client || !relay_client_valid (ptr_client))
+        return WEECHAT_RC_OK;
+
+    /* client is still slow, wait */
+    if (ptr_client->outqueue)
+        return WEECHAT_RC_OK;
+
+    weechat_hashtable_map (RELAY_WEECHAT_DATA(ptr_client, buffers_resync),
+                           &relay_weechat_protocol_resync_map_cb,
+                           ptr_client);
+
+    weechat_hashtable_remove_all (RELAY_WEECHAT_DATA(ptr_client, buffers_resync));
+
+    weechat_unhook (RELAY_WEECHAT_DATA(ptr_client, hook_timer_resync));
+    RELAY_WEECHAT_DATA(ptr_client, hook_timer_resync) = NULL;
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback called for each cursor of a client: searches the first cursor in
+ * stream mode.
+ */
+
+void
+relay_weechat_protocol_cursors_stream_map_cb (void *data,
+                                              struct t_hashtable *hashtable,
+                                              const void *key,
+                                              const void *value)
+{
+    struct t_relay_weechat_cursor **ptr_cursor_stream, *ptr_cursor;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    ptr_cursor_stream = (struct t_relay_weechat_cursor **)data;
+    ptr_cursor = (struct t_relay_weechat_cursor *)value;
+
+    if (!*ptr_cursor_stream && ptr_cursor->stream)
+        *ptr_cursor_stream = ptr_cursor;
+}
+
+/*
+ * Sends pages of cursors in stream mode, while all data previously sent has
+ * been sent to client (outqueue is empty).
+ *
+ * This function is called when a cursor is streamed and each time the
+ * outqueue of client becomes empty.
+ */
+
+void
+relay_weechat_protocol_cursors_stream (struct t_relay_client *client)
+{
+    struct t_relay_weechat_cursor *ptr_cursor;
+
+    if (!client->protocol_data)
+        return;
+
+    while (!client->outqueue && !RELAY_CLIENT_HAS_ENDED(client))
+    {
+        ptr_cursor = NULL;
+        weechat_hashtable_map (RELAY_WEECHAT_DATA(client, cursors),
+                               &relay_weechat_protocol_cursors_stream_map_cb,
+                               &ptr_cursor);
+        if (!ptr_cursor)
+            break;
+        relay_weechat_protocol_cursor_send_page (client, ptr_cursor);
+    }
+}
+
+/*
+ * Adds a nicklist diff for a client and schedules the send of nicklist.
+ */
+
+void
+relay_weechat_protocol_nicklist_add_diff (struct t_relay_client *client,
+                                          struct t_gui_buffer *buffer,
+                                          char diff,
+                                          struct t_gui_nick_group *parent_group,
+                                          struct t_gui_nick_group *group,
+                                          struct t_gui_nick *nick)
+{
+    struct t_relay_weechat_nicklist *ptr_nicklist;
+
+    ptr_nicklist = weechat_hashtable_get (RELAY_WEECHAT_DATA(client,
+                                                             buffers_nicklist),
+                                          buffer);
+    if (!ptr_nicklist)
+    {
+        ptr_nicklist = relay_weechat_nicklist_new ();
+        if (!ptr_nicklist)
+            return;
+        ptr_nicklist->nicklist_count = weechat_buffer_get_integer (buffer,
+                                                                   "nicklist_count");
+        weechat_hashtable_set (RELAY_WEECHAT_DATA(client, buffers_nicklist),
+                               buffer,
+                               ptr_nicklist);
+    }
+    else if (client->outqueue)
+    {
+        /* diff merged in nicklist postponed because client is slow */
+        client->msgs_coalesced++;
+    }
+
+    /*
+     * add items if nicklist was not empty or very small (otherwise we will
+     * send full nicklist)
+     */
+    if (ptr_nicklist->nicklist_count > 1)
+    {
+        /* add nicklist item for parent group and group/nick */
+        relay_weechat_nicklist_add_item (ptr_nicklist,
+                                         RELAY_WEECHAT_NICKLIST_DIFF_PARENT,
+                                         parent_group, NULL);
+        relay_weechat_nicklist_add_item (ptr_nicklist, diff, group, nick);
+    }
+
+    /* add timer to send nicklist */
+    if (RELAY_WEECHAT_DATA(client, hook_timer_nicklist))
+    {
+        weechat_unhook (RELAY_WEECHAT_DATA(client, hook_timer_nicklist));
+        RELAY_WEECHAT_DATA(client, hook_timer_nicklist) = NULL;
+    }
+    relay_weechat_hook_timer_nicklist (client);
+}
+
+/*
+ * Callback for hsignals "nicklist_*" (hooked once for all clients).
  */
 
 int
@@ -1279,22 +1797,16 @@ relay_weechat_protocol_hsignal_nicklist_cb (const void *pointer, void *data,
     struct t_gui_nick_group *parent_group, *group;
     struct t_gui_nick *nick;
     struct t_gui_buffer *ptr_buffer;
-    struct t_relay_weechat_nicklist *ptr_nicklist;
     char diff;
 
     /* make C compiler happy */
+    (void) pointer;
     (void) data;
 
-    ptr_client = (struct t_relay_client *)pointer;
-    if (!ptr_client || !relay_client_valid (ptr_client))
+    if (!relay_weechat_signals_clients)
         return WEECHAT_RC_OK;
 
-    /* check if buffer is synchronized with flag "nicklist" */
     ptr_buffer = weechat_hashtable_get (hashtable, "buffer");
-    if (!relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                         RELAY_WEECHAT_PROTOCOL_SYNC_NICKLIST))
-        return WEECHAT_RC_OK;
-
     parent_group = weechat_hashtable_get (hashtable, "parent_group");
     group = weechat_hashtable_get (hashtable, "group");
     nick = weechat_hashtable_get (hashtable, "nick");
@@ -1303,21 +1815,6 @@ relay_weechat_protocol_hsignal_nicklist_cb (const void *pointer, void *data,
     if (!parent_group)
         return WEECHAT_RC_OK;
 
-    ptr_nicklist = weechat_hashtable_get (RELAY_WEECHAT_DATA(ptr_client,
-                                                             buffers_nicklist),
-                                          ptr_buffer);
-    if (!ptr_nicklist)
-    {
-        ptr_nicklist = relay_weechat_nicklist_new ();
-        if (!ptr_nicklist)
-            return WEECHAT_RC_OK;
-        ptr_nicklist->nicklist_count = weechat_buffer_get_integer (ptr_buffer,
-                                                                   "nicklist_count");
-        weechat_hashtable_set (RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
-                               ptr_buffer,
-                               ptr_nicklist);
-    }
-
     /* set diff type */
     diff = RELAY_WEECHAT_NICKLIST_DIFF_UNKNOWN;
     if ((strcmp (signal, "nicklist_group_added") == 0)
@@ -1336,35 +1833,28 @@ relay_weechat_protocol_hsignal_nicklist_cb (const void *pointer, void *data,
         diff = RELAY_WEECHAT_NICKLIST_DIFF_CHANGED;
     }
 
-    if (diff != RELAY_WEECHAT_NICKLIST_DIFF_UNKNOWN)
-    {
-        /*
-         * add items if nicklist was not empty or very small (otherwise we will
-         * send full nicklist)
-         */
-        if (ptr_nicklist->nicklist_count > 1)
-        {
-            /* add nicklist item for parent group and group/nick */
-            relay_weechat_nicklist_add_item (ptr_nicklist,
-                                             RELAY_WEECHAT_NICKLIST_DIFF_PARENT,
-                                             parent_group, NULL);
-            relay_weechat_nicklist_add_item (ptr_nicklist, diff, group, nick);
-        }
+    if (diff == RELAY_WEECHAT_NICKLIST_DIFF_UNKNOWN)
+        return WEECHAT_RC_OK;
 
-        /* add timer to send nicklist */
-        if (RELAY_WEECHAT_DATA(ptr_client, hook_timer_nicklist))
+    for (ptr_client = relay_clients; ptr_client;
+         ptr_client = ptr_client->next_client)
+    {
+        /* check if buffer is synchronized with flag "nicklist" */
+        if (RELAY_WEECHAT_SIGNALS_HOOKED(ptr_client)
+            && relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
+                                               RELAY_WEECHAT_PROTOCOL_SYNC_NICKLIST))
         {
-            weechat_unhook (RELAY_WEECHAT_DATA(ptr_client, hook_timer_nicklist));
-            RELAY_WEECHAT_DATA(ptr_client, hook_timer_nicklist) = NULL;
+            relay_weechat_protocol_nicklist_add_diff (ptr_client, ptr_buffer,
+                                                      diff, parent_group,
+                                                      group, nick);
         }
-        relay_weechat_hook_timer_nicklist (ptr_client);
     }
 
     return WEECHAT_RC_OK;
 }
 
 /*
- * Callback for signals "upgrade*".
+ * Callback for signals "upgrade*" (hooked once for all clients).
  */
 
 int
@@ -1373,37 +1863,51 @@ relay_weechat_protocol_signal_upgrade_cb (const void *pointer, void *data,
                                           const char *type_data,
                                           void *signal_data)
 {
-    struct t_relay_client *ptr_client;
+    struct t_relay_client *ptr_client, *ptr_next_client;
     struct t_relay_weechat_msg *msg;
     char str_signal[128];
 
     /* make C compiler happy */
+    (void) pointer;
     (void) data;
     (void) type_data;
     (void) signal_data;
 
-    ptr_client = (struct t_relay_client *)pointer;
-    if (!ptr_client || !relay_client_valid (ptr_client))
+    if ((strcmp (signal, "upgrade") != 0)
+        && (strcmp (signal, "upgrade_ended") != 0))
+    {
         return WEECHAT_RC_OK;
+    }
 
     snprintf (str_signal, sizeof (str_signal), "_%s", signal);
 
-    if ((strcmp (signal, "upgrade") == 0)
-        || (strcmp (signal, "upgrade_ended") == 0))
+    msg = NULL;
+
+    ptr_client = relay_clients;
+    while (ptr_client)
     {
+        ptr_next_client = ptr_client->next_client;
+
         /* send signal only if client is synchronized with flag "upgrade" */
-        if (relay_weechat_protocol_is_sync (ptr_client, NULL,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_UPGRADE))
+        if (RELAY_WEECHAT_SIGNALS_HOOKED(ptr_client)
+            && relay_weechat_protocol_is_sync (ptr_client, NULL,
+                                               RELAY_WEECHAT_PROTOCOL_SYNC_UPGRADE))
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
+            if (!msg)
             {
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
+                msg = relay_weechat_msg_new (str_signal);
+                if (!msg)
+                    break;
             }
+            relay_weechat_msg_send (ptr_client, msg);
         }
+
+        ptr_client = ptr_next_client;
     }
 
+    if (msg)
+        relay_weechat_msg_free (msg);
+
     return WEECHAT_RC_OK;
 }
 
@@ -1414,17 +1918,42 @@ relay_weechat_protocol_signal_upgrade_cb (const void *pointer, void *data,
  *   sync
  *   sync * buffer
  *   sync irc.freenode.#weechat buffer,nicklist
+ *   sync irc.freenode.#weechat buffer tags=!irc_join+!irc_part notify=message
+ *
+ * The filter (third argument and following ones) applies to lines of buffers
+ * synchronized with flag "buffer"; if no filter is given, any filter
+ * previously set on these buffers is removed.
  */
 
 RELAY_WEECHAT_PROTOCOL_CALLBACK(sync)
 {
     char **buffers, **flags;
-    const char *ptr_full_name;
+    const char *ptr_full_name, *ptr_filter_string;
     int num_buffers, num_flags, i, add_flags, mask, *ptr_old_flags, new_flags;
     struct t_gui_buffer *ptr_buffer;
+    struct t_relay_filter *ptr_filter;
 
     RELAY_WEECHAT_PROTOCOL_MIN_ARGS(0);
 
+    ptr_filter_string = (argc > 2) ? argv_eol[2] : NULL;
+    if (!relay_filter_valid (ptr_filter_string))
+    {
+        if (weechat_relay_plugin->debug >= 1)
+        {
+            weechat_printf (NULL,
+                            _("%s%s: invalid filter received from client "
+                              "%s%s%s for command \"%s\": \"%s\""),
+                            weechat_prefix ("error"),
+                            RELAY_PLUGIN_NAME,
+                            RELAY_COLOR_CHAT_CLIENT,
+                            client->desc,
+                            RELAY_COLOR_CHAT,
+                            command,
+                            ptr_filter_string);
+        }
+        return WEECHAT_RC_OK;
+    }
+
     buffers = weechat_string_split ((argc > 0) ? argv[0] : "*",
                                     ",",
                                     NULL,
@@ -1487,6 +2016,21 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(sync)
                                                ptr_full_name,
                                                &new_flags);
                     }
+                    if (add_flags & RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER)
+                    {
+                        ptr_filter = relay_filter_get (ptr_filter_string);
+                        if (ptr_filter)
+                        {
+                            weechat_hashtable_set (RELAY_WEECHAT_DATA(client, buffers_filter),
+                                                   ptr_full_name,
+                                                   ptr_filter);
+                        }
+                        else
+                        {
+                            weechat_hashtable_remove (RELAY_WEECHAT_DATA(client, buffers_filter),
+                                                      ptr_full_name);
+                        }
+                    }
                 }
             }
         }
@@ -1570,6 +2114,11 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(desync)
                                                            ptr_full_name);
                     new_flags = ((ptr_old_flags) ? *ptr_old_flags : 0);
                     new_flags &= ~(sub_flags & mask);
+                    if (!(new_flags & RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+                    {
+                        weechat_hashtable_remove (RELAY_WEECHAT_DATA(client, buffers_filter),
+                                                  ptr_full_name);
+                    }
                     if (new_flags)
                     {
                         weechat_hashtable_set (RELAY_WEECHAT_DATA(client, buffers_sync),
@@ -1738,6 +2287,7 @@ relay_weechat_protocol_recv (struct t_relay_client *client, const char *data)
         { { "handshake", &relay_weechat_protocol_cb_handshake },
           { "init", &relay_weechat_protocol_cb_init },
           { "hdata", &relay_weechat_protocol_cb_hdata },
+          { "cursor", &relay_weechat_protocol_cb_cursor },
           { "info", &relay_weechat_protocol_cb_info },
           { "infolist", &relay_weechat_protocol_cb_infolist },
           { "nicklist", &relay_weechat_protocol_cb_nicklist },
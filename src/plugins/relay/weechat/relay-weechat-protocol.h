@@ -98,6 +98,10 @@ extern int relay_weechat_protocol_signal_upgrade_cb (const void *pointer,
 extern int relay_weechat_protocol_timer_nicklist_cb (const void *pointer,
                                                      void *data,
                                                      int remaining_calls);
+extern int relay_weechat_protocol_timer_resync_cb (const void *pointer,
+                                                   void *data,
+                                                   int remaining_calls);
+extern void relay_weechat_protocol_cursors_stream (struct t_relay_client *client);
 extern void relay_weechat_protocol_recv (struct t_relay_client *client,
                                          const char *data);
 
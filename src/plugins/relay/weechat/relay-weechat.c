@@ -29,19 +29,37 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <arpa/inet.h>
+#include <zlib.h>
 
 #include "../../weechat-plugin.h"
 #include "../relay.h"
 #include "relay-weechat.h"
+#include "relay-weechat-msg.h"
 #include "relay-weechat-nicklist.h"
 #include "relay-weechat-protocol.h"
 #include "../relay-client.h"
 #include "../relay-config.h"
+#include "../relay-filter.h"
 #include "../relay-raw.h"
 
 
 char *relay_weechat_compression_string[] = /* strings for compression       */
-{ "off", "zlib" };
+{ "off", "zlib", "zlib_stream" };
+
+/* signals hooked once for all clients */
+struct t_hook *relay_weechat_hook_signal_buffer = NULL;
+struct t_hook *relay_weechat_hook_hsignal_nicklist = NULL;
+struct t_hook *relay_weechat_hook_signal_upgrade = NULL;
+int relay_weechat_signals_clients = 0;     /* clients receiving signals     */
+
+/* hooks to detect changes when cursors are opened (by any client) */
+struct t_hook *relay_weechat_hook_signal_cursors = NULL;
+struct t_hook *relay_weechat_hook_hsignal_cursors = NULL;
+struct t_hook *relay_weechat_hook_command_run_cursors = NULL;
+int relay_weechat_cursors_opened = 0;      /* cursors opened by all clients */
+int relay_weechat_cursors_changes = 0;     /* number of changes (signals,   */
+                                           /* commands) which may have      */
+                                           /* removed objects               */
 
 
 /*
@@ -68,47 +86,132 @@ relay_weechat_compression_search (const char *compression)
 
 /*
  * Hooks signals for a client.
+ *
+ * Signals are hooked only once for all clients (when the first client is
+ * added): the callbacks build each message once and send it to all clients
+ * synchronized.
  */
 
 void
 relay_weechat_hook_signals (struct t_relay_client *client)
 {
-    RELAY_WEECHAT_DATA(client, hook_signal_buffer) =
-        weechat_hook_signal ("buffer_*",
-                             &relay_weechat_protocol_signal_buffer_cb,
-                             client, NULL);
-    RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) =
-        weechat_hook_hsignal ("nicklist_*",
-                              &relay_weechat_protocol_hsignal_nicklist_cb,
-                              client, NULL);
-    RELAY_WEECHAT_DATA(client, hook_signal_upgrade) =
-        weechat_hook_signal ("upgrade*",
-                             &relay_weechat_protocol_signal_upgrade_cb,
-                             client, NULL);
+    if (RELAY_WEECHAT_DATA(client, signals_hooked))
+        return;
+
+    if (relay_weechat_signals_clients == 0)
+    {
+        relay_weechat_hook_signal_buffer =
+            weechat_hook_signal ("buffer_*",
+                                 &relay_weechat_protocol_signal_buffer_cb,
+                                 NULL, NULL);
+        relay_weechat_hook_hsignal_nicklist =
+            weechat_hook_hsignal ("nicklist_*",
+                                  &relay_weechat_protocol_hsignal_nicklist_cb,
+                                  NULL, NULL);
+        relay_weechat_hook_signal_upgrade =
+            weechat_hook_signal ("upgrade*",
+                                 &relay_weechat_protocol_signal_upgrade_cb,
+                                 NULL, NULL);
+    }
+
+    RELAY_WEECHAT_DATA(client, signals_hooked) = 1;
+    relay_weechat_signals_clients++;
 }
 
 /*
  * Unhooks signals for a client.
+ *
+ * Signals are unhooked when the last client is removed.
  */
 
 void
 relay_weechat_unhook_signals (struct t_relay_client *client)
 {
-    if (RELAY_WEECHAT_DATA(client, hook_signal_buffer))
-    {
-        weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_buffer));
-        RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
-    }
-    if (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist))
+    if (!RELAY_WEECHAT_DATA(client, signals_hooked))
+        return;
+
+    RELAY_WEECHAT_DATA(client, signals_hooked) = 0;
+    relay_weechat_signals_clients--;
+
+    if (relay_weechat_signals_clients <= 0)
     {
-        weechat_unhook (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
-        RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
+        relay_weechat_signals_clients = 0;
+        if (relay_weechat_hook_signal_buffer)
+        {
+            weechat_unhook (relay_weechat_hook_signal_buffer);
+            relay_weechat_hook_signal_buffer = NULL;
+        }
+        if (relay_weechat_hook_hsignal_nicklist)
+        {
+            weechat_unhook (relay_weechat_hook_hsignal_nicklist);
+            relay_weechat_hook_hsignal_nicklist = NULL;
+        }
+        if (relay_weechat_hook_signal_upgrade)
+        {
+            weechat_unhook (relay_weechat_hook_signal_upgrade);
+            relay_weechat_hook_signal_upgrade = NULL;
+        }
+        /* no more clients: compiled hdata paths are not needed any more */
+        relay_weechat_msg_hdata_paths_free_all ();
     }
-    if (RELAY_WEECHAT_DATA(client, hook_signal_upgrade))
+}
+
+/*
+ * Creates deflate stream of a client (compression "zlib_stream"), or
+ * creates a new one if the compression level has changed.
+ *
+ * The stream produces raw deflate data (no zlib header), flushed after each
+ * message: a new stream can be started at any time (for example after
+ * /upgrade or if compression level is changed), the client continues to
+ * inflate data with the same stream.
+ *
+ * Returns pointer to deflate stream, NULL if error.
+ */
+
+struct z_stream_s *
+relay_weechat_deflate_get (struct t_relay_client *client, int level)
+{
+    z_stream *stream;
+
+    stream = RELAY_WEECHAT_DATA(client, deflate_stream);
+    if (stream && (RELAY_WEECHAT_DATA(client, deflate_level) == level))
+        return stream;
+
+    relay_weechat_deflate_free (client);
+
+    stream = malloc (sizeof (*stream));
+    if (!stream)
+        return NULL;
+    stream->zalloc = Z_NULL;
+    stream->zfree = Z_NULL;
+    stream->opaque = Z_NULL;
+    if (deflateInit2 (stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
     {
-        weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_upgrade));
-        RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
+        free (stream);
+        return NULL;
     }
+
+    RELAY_WEECHAT_DATA(client, deflate_stream) = stream;
+    RELAY_WEECHAT_DATA(client, deflate_level) = level;
+
+    return stream;
+}
+
+/*
+ * Frees deflate stream of a client.
+ */
+
+void
+relay_weechat_deflate_free (struct t_relay_client *client)
+{
+    if (!RELAY_WEECHAT_DATA(client, deflate_stream))
+        return;
+
+    deflateEnd (RELAY_WEECHAT_DATA(client, deflate_stream));
+    free (RELAY_WEECHAT_DATA(client, deflate_stream));
+    RELAY_WEECHAT_DATA(client, deflate_stream) = NULL;
+    RELAY_WEECHAT_DATA(client, deflate_level) = 0;
 }
 
 /*
@@ -124,6 +227,228 @@ relay_weechat_hook_timer_nicklist (struct t_relay_client *client)
                             client, NULL);
 }
 
+/*
+ * Hooks timer to send resync of buffers (when lines have been dropped).
+ */
+
+void
+relay_weechat_hook_timer_resync (struct t_relay_client *client)
+{
+    if (RELAY_WEECHAT_DATA(client, hook_timer_resync))
+        return;
+
+    RELAY_WEECHAT_DATA(client, hook_timer_resync) =
+        weechat_hook_timer (1000, 0, 0,
+                            &relay_weechat_protocol_timer_resync_cb,
+                            client, NULL);
+}
+
+/*
+ * Callback for all signals, when at least one cursor is opened.
+ */
+
+int
+relay_weechat_cursors_signal_cb (const void *pointer, void *data,
+                                 const char *signal,
+                                 const char *type_data, void *signal_data)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) signal;
+    (void) type_data;
+    (void) signal_data;
+
+    relay_weechat_cursors_changes++;
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for all hsignals, when at least one cursor is opened.
+ */
+
+int
+relay_weechat_cursors_hsignal_cb (const void *pointer, void *data,
+                                  const char *signal,
+                                  struct t_hashtable *hashtable)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) signal;
+    (void) hashtable;
+
+    relay_weechat_cursors_changes++;
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for all commands, when at least one cursor is opened.
+ */
+
+int
+relay_weechat_cursors_command_run_cb (const void *pointer, void *data,
+                                      struct t_gui_buffer *buffer,
+                                      const char *command)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) buffer;
+    (void) command;
+
+    relay_weechat_cursors_changes++;
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Hooks all signals, hsignals and commands when the first cursor is opened:
+ * objects are removed by commands or by the code handling signals, so the
+ * position of a cursor is checked again only if there was a change since its
+ * previous page (instead of being checked before each page).
+ */
+
+void
+relay_weechat_cursors_hook ()
+{
+    relay_weechat_cursors_opened++;
+    if (relay_weechat_cursors_opened > 1)
+        return;
+
+    relay_weechat_hook_signal_cursors =
+        weechat_hook_signal ("*",
+                             &relay_weechat_cursors_signal_cb,
+                             NULL, NULL);
+    relay_weechat_hook_hsignal_cursors =
+        weechat_hook_hsignal ("*",
+                              &relay_weechat_cursors_hsignal_cb,
+                              NULL, NULL);
+    relay_weechat_hook_command_run_cursors =
+        weechat_hook_command_run ("*",
+                                  &relay_weechat_cursors_command_run_cb,
+                                  NULL, NULL);
+}
+
+/*
+ * Unhooks signals, hsignals and commands when the last cursor is closed.
+ */
+
+void
+relay_weechat_cursors_unhook ()
+{
+    relay_weechat_cursors_opened--;
+    if (relay_weechat_cursors_opened > 0)
+        return;
+
+    relay_weechat_cursors_opened = 0;
+    if (relay_weechat_hook_signal_cursors)
+    {
+        weechat_unhook (relay_weechat_hook_signal_cursors);
+        relay_weechat_hook_signal_cursors = NULL;
+    }
+    if (relay_weechat_hook_hsignal_cursors)
+    {
+        weechat_unhook (relay_weechat_hook_hsignal_cursors);
+        relay_weechat_hook_hsignal_cursors = NULL;
+    }
+    if (relay_weechat_hook_command_run_cursors)
+    {
+        weechat_unhook (relay_weechat_hook_command_run_cursors);
+        relay_weechat_hook_command_run_cursors = NULL;
+    }
+}
+
+/*
+ * Opens a new cursor on a hdata path for a client (command "cursor").
+ *
+ * Returns pointer to new cursor, NULL if error (invalid hdata path or too
+ * many cursors opened).
+ */
+
+struct t_relay_weechat_cursor *
+relay_weechat_cursor_new (struct t_relay_client *client, const char *id,
+                          const char *path, const char *keys, int count)
+{
+    struct t_relay_weechat_cursor *new_cursor;
+    char name[32];
+
+    if (weechat_hashtable_get_integer (RELAY_WEECHAT_DATA(client, cursors),
+                                       "items_count") >= RELAY_WEECHAT_CURSORS_MAX)
+    {
+        return NULL;
+    }
+
+    new_cursor = malloc (sizeof (*new_cursor));
+    if (!new_cursor)
+        return NULL;
+
+    new_cursor->hdata = relay_weechat_msg_hdata_new (path, keys);
+    if (!new_cursor->hdata)
+    {
+        free (new_cursor);
+        return NULL;
+    }
+
+    RELAY_WEECHAT_DATA(client, cursors_counter)++;
+    snprintf (name, sizeof (name),
+              "%d", RELAY_WEECHAT_DATA(client, cursors_counter));
+    new_cursor->name = strdup (name);
+    new_cursor->id = (id) ? strdup (id) : NULL;
+    new_cursor->count = (count > 0) ? count : 0;
+    new_cursor->stream = 0;
+    new_cursor->changes = relay_weechat_cursors_changes;
+
+    weechat_hashtable_set (RELAY_WEECHAT_DATA(client, cursors),
+                           name, new_cursor);
+    relay_weechat_cursors_hook ();
+
+    return new_cursor;
+}
+
+/*
+ * Sets id of messages sent for a cursor (id of last command received for
+ * this cursor).
+ */
+
+void
+relay_weechat_cursor_set_id (struct t_relay_weechat_cursor *cursor,
+                             const char *id)
+{
+    if (cursor->id)
+        free (cursor->id);
+    cursor->id = (id) ? strdup (id) : NULL;
+}
+
+/*
+ * Frees a value of hashtable "cursors".
+ */
+
+void
+relay_weechat_free_cursors (struct t_hashtable *hashtable,
+                            const void *key, void *value)
+{
+    struct t_relay_weechat_cursor *ptr_cursor;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    ptr_cursor = (struct t_relay_weechat_cursor *)value;
+
+    if (ptr_cursor->name)
+        free (ptr_cursor->name);
+    if (ptr_cursor->id)
+        free (ptr_cursor->id);
+    relay_weechat_msg_hdata_free (ptr_cursor->hdata);
+
+    free (ptr_cursor);
+
+    relay_weechat_cursors_unhook ();
+}
+
 /*
  * Reads data from a client.
  */
@@ -134,6 +459,17 @@ relay_weechat_recv (struct t_relay_client *client, const char *data)
     relay_weechat_protocol_recv (client, data);
 }
 
+/*
+ * Called when all data in outqueue of a client has been sent: sends pages
+ * of cursors in stream mode.
+ */
+
+void
+relay_weechat_outqueue_empty (struct t_relay_client *client)
+{
+    relay_weechat_protocol_cursors_stream (client);
+}
+
 /*
  * Closes connection with a client.
  */
@@ -159,6 +495,44 @@ relay_weechat_free_buffers_nicklist (struct t_hashtable *hashtable,
     relay_weechat_nicklist_free ((struct t_relay_weechat_nicklist *)value);
 }
 
+/*
+ * Frees a value of hashtable "buffers_filter".
+ */
+
+void
+relay_weechat_free_buffers_filter (struct t_hashtable *hashtable,
+                                   const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    relay_filter_unref ((struct t_relay_filter *)value);
+}
+
+/*
+ * Creates hashtable "buffers_filter" of a client.
+ */
+
+struct t_hashtable *
+relay_weechat_new_buffers_filter ()
+{
+    struct t_hashtable *hashtable;
+
+    hashtable = weechat_hashtable_new (32,
+                                       WEECHAT_HASHTABLE_STRING,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+    if (hashtable)
+    {
+        weechat_hashtable_set_pointer (hashtable,
+                                       "callback_free_value",
+                                       &relay_weechat_free_buffers_filter);
+    }
+
+    return hashtable;
+}
+
 /*
  * Initializes relay data specific to WeeChat protocol.
  */
@@ -174,14 +548,16 @@ relay_weechat_alloc (struct t_relay_client *client)
     RELAY_WEECHAT_DATA(client, password_ok) = 0;
     RELAY_WEECHAT_DATA(client, totp_ok) = 0;
     RELAY_WEECHAT_DATA(client, compression) = RELAY_WEECHAT_COMPRESSION_ZLIB;
+    RELAY_WEECHAT_DATA(client, deflate_stream) = NULL;
+    RELAY_WEECHAT_DATA(client, deflate_level) = 0;
     RELAY_WEECHAT_DATA(client, buffers_sync) =
         weechat_hashtable_new (32,
                                WEECHAT_HASHTABLE_STRING,
                                WEECHAT_HASHTABLE_INTEGER,
                                NULL, NULL);
-    RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
-    RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
-    RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
+    RELAY_WEECHAT_DATA(client, buffers_filter) =
+        relay_weechat_new_buffers_filter ();
+    RELAY_WEECHAT_DATA(client, signals_hooked) = 0;
     RELAY_WEECHAT_DATA(client, buffers_nicklist) =
         weechat_hashtable_new (32,
                                WEECHAT_HASHTABLE_POINTER,
@@ -191,6 +567,21 @@ relay_weechat_alloc (struct t_relay_client *client)
                                    "callback_free_value",
                                    &relay_weechat_free_buffers_nicklist);
     RELAY_WEECHAT_DATA(client, hook_timer_nicklist) = NULL;
+    RELAY_WEECHAT_DATA(client, buffers_resync) =
+        weechat_hashtable_new (32,
+                               WEECHAT_HASHTABLE_POINTER,
+                               WEECHAT_HASHTABLE_POINTER,
+                               NULL, NULL);
+    RELAY_WEECHAT_DATA(client, hook_timer_resync) = NULL;
+    RELAY_WEECHAT_DATA(client, cursors) =
+        weechat_hashtable_new (8,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_POINTER,
+                               NULL, NULL);
+    weechat_hashtable_set_pointer (RELAY_WEECHAT_DATA(client, cursors),
+                                   "callback_free_value",
+                                   &relay_weechat_free_cursors);
+    RELAY_WEECHAT_DATA(client, cursors_counter) = 0;
 
     relay_weechat_hook_signals (client);
 }
@@ -208,6 +599,7 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
     int index, value;
     char name[64];
     const char *key;
+    struct t_relay_filter *ptr_filter;
 
     client->protocol_data = malloc (sizeof (struct t_relay_weechat_data));
     if (client->protocol_data)
@@ -227,6 +619,13 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
             RELAY_WEECHAT_DATA(client, totp_ok) = 1;
         RELAY_WEECHAT_DATA(client, compression) = weechat_infolist_integer (
             infolist, "compression");
+        /*
+         * the deflate stream is not saved: a new one is created on next
+         * message sent (it uses raw deflate, so the client can continue to
+         * inflate with the same stream)
+         */
+        RELAY_WEECHAT_DATA(client, deflate_stream) = NULL;
+        RELAY_WEECHAT_DATA(client, deflate_level) = 0;
 
         /* sync of buffers */
         RELAY_WEECHAT_DATA(client, buffers_sync) = weechat_hashtable_new (
@@ -248,9 +647,28 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
                                    &value);
             index++;
         }
-        RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
-        RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
-        RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
+        /* "buffers_filter" is new in WeeChat 3.2 */
+        RELAY_WEECHAT_DATA(client, buffers_filter) =
+            relay_weechat_new_buffers_filter ();
+        index = 0;
+        while (1)
+        {
+            snprintf (name, sizeof (name), "buffers_filter_name_%05d", index);
+            key = weechat_infolist_string (infolist, name);
+            if (!key)
+                break;
+            snprintf (name, sizeof (name), "buffers_filter_value_%05d", index);
+            ptr_filter = relay_filter_get (
+                weechat_infolist_string (infolist, name));
+            if (ptr_filter)
+            {
+                weechat_hashtable_set (RELAY_WEECHAT_DATA(client, buffers_filter),
+                                       key,
+                                       ptr_filter);
+            }
+            index++;
+        }
+        RELAY_WEECHAT_DATA(client, signals_hooked) = 0;
         RELAY_WEECHAT_DATA(client, buffers_nicklist) =
             weechat_hashtable_new (32,
                                    WEECHAT_HASHTABLE_POINTER,
@@ -260,14 +678,25 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
                                        "callback_free_value",
                                        &relay_weechat_free_buffers_nicklist);
         RELAY_WEECHAT_DATA(client, hook_timer_nicklist) = NULL;
+        RELAY_WEECHAT_DATA(client, buffers_resync) =
+            weechat_hashtable_new (32,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   NULL, NULL);
+        RELAY_WEECHAT_DATA(client, hook_timer_resync) = NULL;
 
-        if (RELAY_CLIENT_HAS_ENDED(client))
-        {
-            RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
-            RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
-            RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
-        }
-        else
+        /* cursors are not saved (client has to open them again) */
+        RELAY_WEECHAT_DATA(client, cursors) =
+            weechat_hashtable_new (8,
+                                   WEECHAT_HASHTABLE_STRING,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   NULL, NULL);
+        weechat_hashtable_set_pointer (RELAY_WEECHAT_DATA(client, cursors),
+                                       "callback_free_value",
+                                       &relay_weechat_free_cursors);
+        RELAY_WEECHAT_DATA(client, cursors_counter) = 0;
+
+        if (!RELAY_CLIENT_HAS_ENDED(client))
             relay_weechat_hook_signals (client);
     }
 }
@@ -301,14 +730,18 @@ relay_weechat_free (struct t_relay_client *client)
     {
         if (RELAY_WEECHAT_DATA(client, buffers_sync))
             weechat_hashtable_free (RELAY_WEECHAT_DATA(client, buffers_sync));
-        if (RELAY_WEECHAT_DATA(client, hook_signal_buffer))
-            weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_buffer));
-        if (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist))
-            weechat_unhook (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
-        if (RELAY_WEECHAT_DATA(client, hook_signal_upgrade))
-            weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_upgrade));
+        if (RELAY_WEECHAT_DATA(client, buffers_filter))
+            weechat_hashtable_free (RELAY_WEECHAT_DATA(client, buffers_filter));
+        relay_weechat_unhook_signals (client);
+        relay_weechat_deflate_free (client);
         if (RELAY_WEECHAT_DATA(client, buffers_nicklist))
             weechat_hashtable_free (RELAY_WEECHAT_DATA(client, buffers_nicklist));
+        if (RELAY_WEECHAT_DATA(client, buffers_resync))
+            weechat_hashtable_free (RELAY_WEECHAT_DATA(client, buffers_resync));
+        if (RELAY_WEECHAT_DATA(client, hook_timer_resync))
+            weechat_unhook (RELAY_WEECHAT_DATA(client, hook_timer_resync));
+        if (RELAY_WEECHAT_DATA(client, cursors))
+            weechat_hashtable_free (RELAY_WEECHAT_DATA(client, cursors));
 
         free (client->protocol_data);
 
@@ -316,6 +749,34 @@ relay_weechat_free (struct t_relay_client *client)
     }
 }
 
+/*
+ * Adds a filter of hashtable "buffers_filter" in an infolist item.
+ */
+
+void
+relay_weechat_add_buffers_filter_to_infolist (void *data,
+                                              struct t_hashtable *hashtable,
+                                              const void *key,
+                                              const void *value)
+{
+    struct t_infolist_item *ptr_item;
+    char name[64];
+    int *index;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    ptr_item = (struct t_infolist_item *)(((void **)data)[0]);
+    index = (int *)(((void **)data)[1]);
+
+    snprintf (name, sizeof (name), "buffers_filter_name_%05d", *index);
+    weechat_infolist_new_var_string (ptr_item, name, (const char *)key);
+    snprintf (name, sizeof (name), "buffers_filter_value_%05d", *index);
+    weechat_infolist_new_var_string (
+        ptr_item, name, ((struct t_relay_filter *)value)->string);
+    (*index)++;
+}
+
 /*
  * Adds client WeeChat data in an infolist.
  *
@@ -328,6 +789,9 @@ int
 relay_weechat_add_to_infolist (struct t_infolist_item *item,
                                struct t_relay_client *client)
 {
+    void *map_data[2];
+    int index;
+
     if (!item || !client)
         return 0;
 
@@ -341,6 +805,12 @@ relay_weechat_add_to_infolist (struct t_infolist_item *item,
         return 0;
     if (!weechat_hashtable_add_to_infolist (RELAY_WEECHAT_DATA(client, buffers_sync), item, "buffers_sync"))
         return 0;
+    index = 0;
+    map_data[0] = item;
+    map_data[1] = &index;
+    weechat_hashtable_map (RELAY_WEECHAT_DATA(client, buffers_filter),
+                           &relay_weechat_add_buffers_filter_to_infolist,
+                           map_data);
 
     return 1;
 }
@@ -358,17 +828,31 @@ relay_weechat_print_log (struct t_relay_client *client)
         weechat_log_printf ("    password_ok . . . . . . : %d",   RELAY_WEECHAT_DATA(client, password_ok));
         weechat_log_printf ("    totp_ok . . . . . . . . : %d",   RELAY_WEECHAT_DATA(client, totp_ok));
         weechat_log_printf ("    compression . . . . . . : %d",   RELAY_WEECHAT_DATA(client, compression));
+        weechat_log_printf ("    deflate_stream. . . . . : 0x%lx", RELAY_WEECHAT_DATA(client, deflate_stream));
+        weechat_log_printf ("    deflate_level . . . . . : %d",   RELAY_WEECHAT_DATA(client, deflate_level));
         weechat_log_printf ("    buffers_sync. . . . . . : 0x%lx (hashtable: '%s')",
                             RELAY_WEECHAT_DATA(client, buffers_sync),
                             weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, buffers_sync),
                                                           "keys_values"));
-        weechat_log_printf ("    hook_signal_buffer. . . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_signal_buffer));
-        weechat_log_printf ("    hook_hsignal_nicklist . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
-        weechat_log_printf ("    hook_signal_upgrade . . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_signal_upgrade));
+        weechat_log_printf ("    buffers_filter. . . . . : 0x%lx (hashtable: '%s')",
+                            RELAY_WEECHAT_DATA(client, buffers_filter),
+                            weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, buffers_filter),
+                                                          "keys"));
+        weechat_log_printf ("    signals_hooked. . . . . : %d",   RELAY_WEECHAT_DATA(client, signals_hooked));
         weechat_log_printf ("    buffers_nicklist. . . . : 0x%lx (hashtable: '%s')",
                             RELAY_WEECHAT_DATA(client, buffers_nicklist),
                             weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, buffers_nicklist),
                                                           "keys_values"));
         weechat_log_printf ("    hook_timer_nicklist . . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_timer_nicklist));
+        weechat_log_printf ("    buffers_resync. . . . . : 0x%lx (hashtable: '%s')",
+                            RELAY_WEECHAT_DATA(client, buffers_resync),
+                            weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, buffers_resync),
+                                                          "keys_values"));
+        weechat_log_printf ("    hook_timer_resync . . . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_timer_resync));
+        weechat_log_printf ("    cursors . . . . . . . . : 0x%lx (hashtable: '%s')",
+                            RELAY_WEECHAT_DATA(client, cursors),
+                            weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, cursors),
+                                                          "keys"));
+        weechat_log_printf ("    cursors_counter . . . . : %d",   RELAY_WEECHAT_DATA(client, cursors_counter));
     }
 }
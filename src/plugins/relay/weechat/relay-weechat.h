@@ -22,6 +22,8 @@
 
 struct t_relay_client;
 enum t_relay_status;
+struct z_stream_s;
+struct t_relay_weechat_msg_hdata;
 
 #define RELAY_WEECHAT_DATA(client, var)                          \
     (((struct t_relay_weechat_data *)client->protocol_data)->var)
@@ -30,14 +32,35 @@ enum t_relay_status;
     ((RELAY_WEECHAT_DATA(client, password_ok)                    \
       && RELAY_WEECHAT_DATA(client, totp_ok)))
 
+/* max number of hdata cursors opened by a client */
+#define RELAY_WEECHAT_CURSORS_MAX 16
+
+#define RELAY_WEECHAT_SIGNALS_HOOKED(client)                     \
+    ((client->protocol == RELAY_PROTOCOL_WEECHAT)                \
+     && client->protocol_data                                    \
+     && RELAY_WEECHAT_DATA(client, signals_hooked))
+
 enum t_relay_weechat_compression
 {
     RELAY_WEECHAT_COMPRESSION_OFF = 0, /* no compression of binary objects  */
     RELAY_WEECHAT_COMPRESSION_ZLIB,    /* zlib compression                  */
+    RELAY_WEECHAT_COMPRESSION_ZLIB_STREAM, /* deflate stream for connection */
     /* number of compressions */
     RELAY_WEECHAT_NUM_COMPRESSIONS,
 };
 
+struct t_relay_weechat_cursor
+{
+    char *name;                        /* cursor name (sent to client)      */
+    char *id;                          /* id of messages sent to client     */
+    struct t_relay_weechat_msg_hdata *hdata; /* hdata path and position     */
+    int count;                         /* max objects by page (0 = no limit)*/
+    int stream;                        /* 1 if pages are sent when outqueue */
+                                       /* of client is empty                */
+    int changes;                       /* relay_weechat_cursors_changes     */
+                                       /* when previous page was built      */
+};
+
 struct t_relay_weechat_data
 {
     /* handshake status */
@@ -49,25 +72,54 @@ struct t_relay_weechat_data
 
     /* options set by client (init command) */
     enum t_relay_weechat_compression compression; /* compression type       */
+    struct z_stream_s *deflate_stream; /* deflate stream (compression       */
+                                       /* "zlib_stream"), kept for the      */
+                                       /* whole connection                  */
+    int deflate_level;                 /* compression level of stream       */
 
     /* sync of buffers */
     struct t_hashtable *buffers_sync;  /* buffers synchronized (events      */
                                        /* received for these buffers)       */
-    struct t_hook *hook_signal_buffer;    /* hook for signals "buffer_*"    */
-    struct t_hook *hook_hsignal_nicklist; /* hook for hsignals "nicklist_*" */
-    struct t_hook *hook_signal_upgrade;   /* hook for signals "upgrade*"    */
+    struct t_hashtable *buffers_filter; /* filters on lines of buffers      */
+                                        /* synchronized (compiled filters)  */
+    int signals_hooked;                /* 1 if client receives signals      */
+                                       /* "buffer_*", "nicklist_*" and      */
+                                       /* "upgrade*" (hooked once for all   */
+                                       /* clients)                          */
     struct t_hashtable *buffers_nicklist; /* send nicklist for these buffers*/
     struct t_hook *hook_timer_nicklist;   /* timer for sending nicklist     */
+    struct t_hashtable *buffers_resync;   /* lines dropped for these        */
+                                          /* buffers (outqueue was full)    */
+    struct t_hook *hook_timer_resync;     /* timer for sending resync       */
+
+    /* paged hdata (command "cursor") */
+    struct t_hashtable *cursors;       /* cursors opened by client          */
+    int cursors_counter;               /* counter to build cursor names     */
 };
 
 extern char *relay_weechat_compression_string[];
+extern int relay_weechat_signals_clients;
+extern int relay_weechat_cursors_opened;
+extern int relay_weechat_cursors_changes;
 
 extern int relay_weechat_compression_search (const char *compression);
 extern void relay_weechat_hook_signals (struct t_relay_client *client);
 extern void relay_weechat_unhook_signals (struct t_relay_client *client);
+extern struct z_stream_s *relay_weechat_deflate_get (struct t_relay_client *client,
+                                                    int level);
+extern void relay_weechat_deflate_free (struct t_relay_client *client);
 extern void relay_weechat_hook_timer_nicklist (struct t_relay_client *client);
+extern void relay_weechat_hook_timer_resync (struct t_relay_client *client);
+extern struct t_relay_weechat_cursor *relay_weechat_cursor_new (struct t_relay_client *client,
+                                                               const char *id,
+                                                               const char *path,
+                                                               const char *keys,
+                                                               int count);
+extern void relay_weechat_cursor_set_id (struct t_relay_weechat_cursor *cursor,
+                                         const char *id);
 extern void relay_weechat_recv (struct t_relay_client *client,
                                 const char *data);
+extern void relay_weechat_outqueue_empty (struct t_relay_client *client);
 extern void relay_weechat_close_connection (struct t_relay_client *client);
 extern void relay_weechat_alloc (struct t_relay_client *client);
 extern void relay_weechat_alloc_with_infolist (struct t_relay_client *client,
@@ -56,6 +56,7 @@ struct t_weelist_item;
 struct t_arraylist;
 struct t_hashtable;
 struct t_hdata;
+struct t_hdata_path;
 struct timeval;
 
 /*
@@ -68,7 +69,7 @@ struct timeval;
  * please change the date with current one; for a second change at same
  * date, increment the 01, otherwise please keep 01.
  */
-#define WEECHAT_PLUGIN_API_VERSION "20201004-01"
+#define WEECHAT_PLUGIN_API_VERSION "20261018-02"
 
 /* macros for defining plugin infos */
 #define WEECHAT_PLUGIN_NAME(__name)                                     \
@@ -906,6 +907,8 @@ struct t_weechat_plugin
     char *(*buffer_string_replace_local_var) (struct t_gui_buffer *buffer,
                                               const char *string);
     int (*buffer_match_list) (struct t_gui_buffer *buffer, const char *string);
+    void (*buffer_batch_start) (struct t_gui_buffer *buffer);
+    void (*buffer_batch_end) (struct t_gui_buffer *buffer);
 
     /* windows */
     struct t_gui_window *(*window_search_with_buffer) (struct t_gui_buffer *buffer);
@@ -1137,6 +1140,14 @@ struct t_weechat_plugin
                          struct t_hashtable *hashtable);
     const char *(*hdata_get_string) (struct t_hdata *hdata,
                                      const char *property);
+    struct t_hdata_path *(*hdata_path_compile) (struct t_hdata *hdata,
+                                                const char *path);
+    int (*hdata_path_get_type) (struct t_hdata_path *hpath);
+    int (*hdata_path_get_array_size) (struct t_hdata_path *hpath,
+                                      void *pointer);
+    void *(*hdata_path_get_value) (struct t_hdata_path *hpath, void *pointer,
+                                   int index);
+    void (*hdata_path_free) (struct t_hdata_path *hpath);
 
     /* upgrade */
     struct t_upgrade_file *(*upgrade_new) (const char *filename,
@@ -1849,6 +1860,10 @@ extern int weechat_plugin_end (struct t_weechat_plugin *plugin);
                                                       __string)
 #define weechat_buffer_match_list(__buffer, __string)                   \
     (weechat_plugin->buffer_match_list)(__buffer, __string)
+#define weechat_buffer_batch_start(__buffer)                            \
+    (weechat_plugin->buffer_batch_start)(__buffer)
+#define weechat_buffer_batch_end(__buffer)                              \
+    (weechat_plugin->buffer_batch_end)(__buffer)
 
 /* windows */
 #define weechat_window_search_with_buffer(__buffer)                     \
@@ -2119,6 +2134,16 @@ extern int weechat_plugin_end (struct t_weechat_plugin *plugin);
     (weechat_plugin->hdata_update)(__hdata, __pointer, __hashtable)
 #define weechat_hdata_get_string(__hdata, __property)                   \
     (weechat_plugin->hdata_get_string)(__hdata, __property)
+#define weechat_hdata_path_compile(__hdata, __path)                     \
+    (weechat_plugin->hdata_path_compile)(__hdata, __path)
+#define weechat_hdata_path_get_type(__hpath)                            \
+    (weechat_plugin->hdata_path_get_type)(__hpath)
+#define weechat_hdata_path_get_array_size(__hpath, __pointer)           \
+    (weechat_plugin->hdata_path_get_array_size)(__hpath, __pointer)
+#define weechat_hdata_path_get_value(__hpath, __pointer, __index)       \
+    (weechat_plugin->hdata_path_get_value)(__hpath, __pointer, __index)
+#define weechat_hdata_path_free(__hpath)                                \
+    (weechat_plugin->hdata_path_free)(__hpath)
 
 /* upgrade */
 #define weechat_upgrade_new(__filename, __callback_read,                \
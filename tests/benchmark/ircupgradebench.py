@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmark of save/load of IRC data on /upgrade.
+
+This script starts WeeChat in headless mode with a temporary home directory
+and a fake IRC server on localhost, which makes WeeChat join a lot of channels
+with a lot of nicks (a large network).
+
+Then the session is saved with "/upgrade -quit" (sent with a relay client,
+"weechat" protocol) and restored by starting WeeChat again with "--upgrade".
+
+The time spent in irc_upgrade_save and irc_upgrade_load is read in WeeChat
+log file (it is written there by irc plugin when debug is enabled for irc).
+
+Everything runs on localhost: no external network is used.
+"""
+
+import argparse
+import json
+import os
+import re
+import selectors
+import shutil
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+RELAY_PASSWORD = 'bench'
+IRC_SERVER = 'bench'
+IRC_NICK = 'bench'
+
+NICKS_PER_NAMES_LINE = 40
+
+RE_UPGRADE_LOG = re.compile(
+    r'irc: upgrade: (save|load): (\d+) usec \(rc: (\d+)\)')
+
+
+def free_port():
+    """Return a free TCP port on localhost."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+class FakeIrcServer(object):
+    """Fake IRC server: WeeChat joins channels with a lot of nicks."""
+
+    def __init__(self, channels, nicks):
+        self.listen_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listen_sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listen_sock.bind(('127.0.0.1', 0))
+        self.listen_sock.listen(1)
+        self.listen_sock.setblocking(False)
+        self.port = self.listen_sock.getsockname()[1]
+        self.channels = channels
+        self.nicks = nicks
+        self.sock = None
+        self.inbuf = b''
+        self.outbuf = b''
+        self.nick = IRC_NICK
+        self.loaded = False
+
+    def accept(self):
+        """Accept connection from WeeChat."""
+        self.sock, _ = self.listen_sock.accept()
+        self.sock.setblocking(False)
+
+    def close(self):
+        """Close sockets."""
+        if self.sock:
+            self.sock.close()
+            self.sock = None
+        self.listen_sock.close()
+
+    def network(self):
+        """
+        Return the messages sent after login: channels joined with their
+        nicks, then a PING (its PONG tells that all messages were received).
+        """
+        lines = [':server 001 {0} :Welcome'.format(self.nick),
+                 ':server 376 {0} :End of MOTD'.format(self.nick)]
+        nick_number = 0
+        for i in range(self.channels):
+            channel = '#chan%d' % i
+            count = (self.nicks // self.channels
+                     + (1 if i < self.nicks % self.channels else 0))
+            names = []
+            for j in range(count):
+                prefix = '@' if j % 20 == 0 else ('+' if j % 10 == 0 else '')
+                names.append('%snick%d' % (prefix, nick_number))
+                nick_number += 1
+            lines.append(':{0}!u@localhost JOIN {1}'.format(self.nick,
+                                                            channel))
+            lines.append(':server 332 {0} {1} :topic of {1}'.format(
+                self.nick, channel))
+            names.insert(0, self.nick)
+            for k in range(0, len(names), NICKS_PER_NAMES_LINE):
+                lines.append(':server 353 {0} = {1} :{2}'.format(
+                    self.nick, channel,
+                    ' '.join(names[k:k + NICKS_PER_NAMES_LINE])))
+            lines.append(':server 366 {0} {1} :End of NAMES'.format(
+                self.nick, channel))
+        lines.append('PING :bench-loaded')
+        return ('\r\n'.join(lines) + '\r\n').encode()
+
+    def flush(self):
+        """Send as much queued data as possible."""
+        if not self.sock or not self.outbuf:
+            return
+        try:
+            sent = self.sock.send(self.outbuf)
+            self.outbuf = self.outbuf[sent:]
+        except BlockingIOError:
+            pass
+
+    def read(self):
+        """Read and answer messages sent by WeeChat."""
+        try:
+            data = self.sock.recv(65536)
+        except (BlockingIOError, ConnectionResetError):
+            return
+        if not data:
+            self.sock.close()
+            self.sock = None
+            return
+        self.inbuf += data
+        while b'\r\n' in self.inbuf:
+            line, self.inbuf = self.inbuf.split(b'\r\n', 1)
+            words = line.decode('utf-8', 'replace').split(' ')
+            command = words[0].upper()
+            if command == 'NICK' and len(words) > 1:
+                self.nick = words[1]
+            elif command == 'USER':
+                self.outbuf += self.network()
+            elif command == 'PONG' and 'bench-loaded' in line.decode():
+                self.loaded = True
+            elif command == 'PING':
+                self.outbuf += (':server PONG server :%s\r\n'
+                                % words[-1].lstrip(':')).encode()
+
+
+class Benchmark(object):
+    """IRC upgrade benchmark."""
+
+    def __init__(self, args):
+        self.args = args
+        self.home = None
+        self.port_weechat = None
+        self.ircd = None
+        self.process = None
+
+    def env(self):
+        """Return environment for WeeChat."""
+        env = dict(os.environ)
+        if self.args.libdir:
+            env['WEECHAT_EXTRA_LIBDIR'] = self.args.libdir
+        return env
+
+    def start_weechat(self, options, commands):
+        """Start WeeChat (headless)."""
+        self.process = subprocess.Popen(
+            [self.args.weechat, '--dir', self.home] + options
+            + ['-r', ';'.join(commands)],
+            env=self.env(), stdin=subprocess.DEVNULL,
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    def wait_exit(self, what):
+        """Wait for end of WeeChat, and return its exit code."""
+        try:
+            return self.process.wait(self.args.timeout)
+        except subprocess.TimeoutExpired:
+            raise IOError('timeout: %s' % what)
+
+    def read_log(self, what):
+        """Return time (in microseconds) of save or load read in log file."""
+        with open(os.path.join(self.home, 'weechat.log'), 'r',
+                  errors='replace') as log_file:
+            for match in RE_UPGRADE_LOG.finditer(log_file.read()):
+                if match.group(1) == what:
+                    if match.group(3) != '1':
+                        raise IOError('irc upgrade %s failed' % what)
+                    return int(match.group(2))
+        raise IOError('irc upgrade %s not found in weechat.log' % what)
+
+    def load_network(self):
+        """Run event loop until WeeChat has received the whole network."""
+        selector = selectors.DefaultSelector()
+        selector.register(self.ircd.listen_sock, selectors.EVENT_READ)
+        deadline = time.monotonic() + self.args.timeout
+        while not self.ircd.loaded:
+            if time.monotonic() > deadline:
+                raise IOError('timeout: network not loaded by WeeChat')
+            if self.process.poll() is not None:
+                raise IOError('WeeChat exited (code %d)'
+                              % self.process.returncode)
+            if self.ircd.sock and self.ircd.outbuf:
+                selector.modify(self.ircd.sock,
+                                selectors.EVENT_READ | selectors.EVENT_WRITE)
+            for key, mask in selector.select(0.05):
+                if key.fileobj is self.ircd.listen_sock:
+                    if self.ircd.sock:
+                        raise IOError('WeeChat connected again to the fake '
+                                       'IRC server')
+                    self.ircd.accept()
+                    selector.register(self.ircd.sock, selectors.EVENT_READ)
+                    continue
+                if mask & selectors.EVENT_READ:
+                    self.ircd.read()
+                    if not self.ircd.sock:
+                        raise IOError('WeeChat closed connection to the '
+                                      'fake IRC server')
+                if mask & selectors.EVENT_WRITE:
+                    self.ircd.flush()
+                    if not self.ircd.outbuf:
+                        selector.modify(self.ircd.sock, selectors.EVENT_READ)
+        selector.close()
+
+    def send_upgrade(self):
+        """Send "/upgrade -quit" with a relay client (weechat protocol)."""
+        deadline = time.monotonic() + self.args.timeout
+        while True:
+            try:
+                sock = socket.create_connection(('127.0.0.1',
+                                                 self.port_weechat))
+                break
+            except ConnectionRefusedError:
+                if time.monotonic() > deadline:
+                    raise IOError('timeout: connection to relay')
+                time.sleep(0.05)
+        sock.sendall(('init password=%s,compression=off\n'
+                      'input core.weechat /upgrade -quit\n'
+                      % RELAY_PASSWORD).encode())
+        return sock
+
+    def run_round(self):
+        """Run one round: load network, save and load it."""
+        self.home = tempfile.mkdtemp(prefix='weechat_ircupgradebench_')
+        self.port_weechat = free_port()
+        self.ircd = FakeIrcServer(self.args.channels, self.args.nicks)
+        try:
+            self.start_weechat([], [
+                '/debug set irc 1',
+                '/set relay.network.password %s' % RELAY_PASSWORD,
+                '/server add %s 127.0.0.1/%d' % (IRC_SERVER, self.ircd.port),
+                '/set irc.server.%s.nicks %s' % (IRC_SERVER, IRC_NICK),
+                '/connect %s' % IRC_SERVER,
+                '/relay add weechat %d' % self.port_weechat,
+            ])
+            start = time.monotonic()
+            self.load_network()
+            time_network = time.monotonic() - start
+            sock = self.send_upgrade()
+            self.wait_exit('save of session')
+            sock.close()
+            time_save = self.read_log('save')
+            size = os.path.getsize(os.path.join(self.home, 'irc.upgrade'))
+            self.ircd.close()
+
+            self.start_weechat(['--upgrade'], ['/quit'])
+            self.wait_exit('load of session')
+            time_load = self.read_log('load')
+        finally:
+            self.stop()
+        return {
+            'network_s': time_network,
+            'save_us': time_save,
+            'load_us': time_load,
+            'file_size': size,
+        }
+
+    def run(self):
+        """Run the benchmark."""
+        rounds = [self.run_round() for _ in range(self.args.rounds)]
+        return {
+            'channels': self.args.channels,
+            'nicks': self.args.nicks,
+            'rounds': rounds,
+            'save_us': statistics.median(r['save_us'] for r in rounds),
+            'load_us': statistics.median(r['load_us'] for r in rounds),
+            'file_size': rounds[-1]['file_size'],
+        }
+
+    def stop(self):
+        """Stop WeeChat and remove temporary home."""
+        if self.process and self.process.poll() is None:
+            self.process.kill()
+            self.process.wait()
+        self.process = None
+        if self.ircd:
+            self.ircd.close()
+            self.ircd = None
+        if self.home:
+            shutil.rmtree(self.home, ignore_errors=True)
+            self.home = None
+
+
+def print_report(result):
+    """Print report."""
+    print('IRC upgrade of %d channels, %d nicks:'
+          % (result['channels'], result['nicks']))
+    for i, item in enumerate(result['rounds']):
+        print('  round %d: network received in %.2f s, save: %.1f ms, '
+              'load: %.1f ms, irc.upgrade: %d bytes'
+              % (i + 1, item['network_s'], item['save_us'] / 1000,
+                 item['load_us'] / 1000, item['file_size']))
+    print('  median: save: %.1f ms, load: %.1f ms'
+          % (result['save_us'] / 1000, result['load_us'] / 1000))
+
+
+def get_parser():
+    """Get parser for command line arguments."""
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+        description='Benchmark of save/load of IRC data on WeeChat /upgrade.')
+    parser.add_argument('-w', '--weechat', required=True,
+                        help='path to weechat-headless binary')
+    parser.add_argument('-l', '--libdir',
+                        help='directory with plugins (set in '
+                        'WEECHAT_EXTRA_LIBDIR), for example the "src" '
+                        'directory of CMake build')
+    parser.add_argument('-c', '--channels', type=int, default=500,
+                        help='number of channels joined')
+    parser.add_argument('-n', '--nicks', type=int, default=100000,
+                        help='total number of nicks in channels')
+    parser.add_argument('-r', '--rounds', type=int, default=3,
+                        help='number of rounds (network, save, load)')
+    parser.add_argument('--timeout', type=float, default=120,
+                        help='timeout for each step (in seconds)')
+    parser.add_argument('-j', '--json',
+                        help='write results in this file (JSON format)')
+    return parser
+
+
+def main():
+    """Main function."""
+    args = get_parser().parse_args()
+    if args.channels <= 0 or args.nicks < 0 or args.rounds <= 0:
+        sys.exit('ERROR: channels and rounds must be positive')
+    bench = Benchmark(args)
+    try:
+        result = bench.run()
+    except (IOError, OSError) as exc:
+        sys.exit('ERROR: %s' % exc)
+    finally:
+        bench.stop()
+    print_report(result)
+    if args.json:
+        with open(args.json, 'w') as json_file:
+            json.dump(result, json_file, indent=2, sort_keys=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,1023 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Load generator and benchmark for the relay plugin.
+
+This script starts WeeChat in headless mode with a temporary home directory,
+a fake IRC server on localhost and relays for the "weechat" and "irc"
+protocols, then it connects synthetic clients (plain, TLS and websocket)
+and injects lines in an IRC channel at a fixed rate.
+
+Everything runs on localhost: no external network is used.
+
+At the end, it reports for each kind of client:
+- latency of lines (time between the line sent by the IRC server and the
+  line received by the relay client): percentiles 50, 90, 99 and max,
+- lines received/missed,
+- bytes received by clients and compression ratio (weechat protocol
+  compression and websocket "permessage-deflate"),
+- depth of outqueue of clients in relay (polled with hdata "relay_client"),
+- CPU used by WeeChat during the injection of lines, per client (the CPU
+  used without lines, measured before, is subtracted).
+
+A "monitor" client with weechat protocol polls the outqueue of clients: it is
+not counted in stats of clients.
+
+Note: the clients are all handled by this script in a single process, so
+with a lot of clients or a high rate of lines, this script can become the
+bottleneck (the CPU used by this script is reported as well).
+"""
+
+import argparse
+import base64
+import json
+import os
+import re
+import selectors
+import shutil
+import socket
+import ssl
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import zlib
+
+RELAY_PASSWORD = 'bench'
+IRC_SERVER = 'bench'
+IRC_NICK = 'bench'
+IRC_CHANNEL = '#bench'
+BUFFER_NAME = 'irc.%s.%s' % (IRC_SERVER, IRC_CHANNEL)
+
+WEECHAT_COMPRESSIONS = ('off', 'zlib', 'zlib_stream')
+TRANSPORTS = ('plain', 'tls', 'websocket')
+
+RE_LINE = re.compile(rb'bench:(\d+):')
+
+CLIENT_HDATA_KEYS = ('id', 'protocol_string', 'ssl', 'websocket',
+                     'outqueue_size', 'outqueue_count', 'msgs_dropped')
+
+
+def percentile(values, pct):
+    """Return percentile of a sorted list of values."""
+    if not values:
+        return 0
+    index = int(round((pct / 100.0) * (len(values) - 1)))
+    return values[index]
+
+
+def free_port():
+    """Return a free TCP port on localhost."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+def process_cpu_time(pid):
+    """Return CPU time (user + system) used by a process, in seconds."""
+    try:
+        with open('/proc/%d/stat' % pid, 'r') as stat_file:
+            fields = stat_file.read().rsplit(')', 1)[1].split()
+        ticks = os.sysconf('SC_CLK_TCK')
+        return (int(fields[11]) + int(fields[12])) / float(ticks)
+    except (OSError, IndexError, ValueError):
+        return None
+
+
+class WeechatMessageDecoder(object):
+    """Decoder of binary objects sent with the weechat protocol."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def _take(self, size):
+        value = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return value
+
+    def _int(self):
+        return struct.unpack('>i', self._take(4))[0]
+
+    def _short_string(self):
+        return self._take(ord(self._take(1))).decode('utf-8', 'replace')
+
+    def _string(self):
+        length = self._int()
+        if length < 0:
+            return None
+        return self._take(length).decode('utf-8', 'replace')
+
+    def _hashtable(self):
+        type_keys = self._take(3).decode()
+        type_values = self._take(3).decode()
+        return dict((self.object(type_keys), self.object(type_values))
+                    for _ in range(self._int()))
+
+    def _hdata(self):
+        path = self._string()
+        keys = [key.split(':') for key in self._string().split(',')]
+        count = self._int()
+        items = []
+        for _ in range(count):
+            item = {'__path': [self._short_string()
+                               for _ in path.split('/')]}
+            for name, obj_type in keys:
+                item[name] = self.object(obj_type)
+            items.append(item)
+        return items
+
+    def _array(self):
+        obj_type = self._take(3).decode()
+        return [self.object(obj_type) for _ in range(self._int())]
+
+    def object(self, obj_type):
+        """Decode an object."""
+        if obj_type == 'chr':
+            return self._take(1)[0]
+        if obj_type == 'int':
+            return self._int()
+        if obj_type in ('lon', 'ptr', 'tim'):
+            return self._short_string()
+        if obj_type in ('str', 'buf'):
+            return self._string()
+        if obj_type == 'htb':
+            return self._hashtable()
+        if obj_type == 'hda':
+            return self._hdata()
+        if obj_type == 'arr':
+            return self._array()
+        raise ValueError('unsupported object type: %s' % obj_type)
+
+    def decode(self):
+        """Decode a message: return (id, list of objects)."""
+        msg_id = self._string()
+        objects = []
+        while self.pos < len(self.data):
+            objects.append(self.object(self._take(3).decode()))
+        return msg_id, objects
+
+
+class Client(object):  # pylint: disable=too-many-instance-attributes
+    """Client connected to relay (base class)."""
+
+    protocol = None
+
+    def __init__(self, bench, transport, port):
+        self.bench = bench
+        self.transport = transport
+        self.port = port
+        self.sock = None
+        self.ready = False
+        self.closed = False
+        self.ws_deflate = False
+        self.ws_inflate = None
+        self.ws_buffer = b''
+        self.ws_message = b''
+        self.ws_message_deflated = False
+        self.wire_bytes = 0
+        self.raw_bytes = 0
+        self.latencies = []
+        self.received = bytearray()
+        self.duplicates = 0
+
+    @property
+    def kind(self):
+        """Return kind of client (used to group results)."""
+        kind = '%s/%s' % (self.protocol, self.transport)
+        if self.ws_deflate:
+            kind += '+deflate'
+        return kind
+
+    def connect(self):
+        """Connect to relay (blocking), then switch to non-blocking mode."""
+        self.sock = socket.create_connection(('127.0.0.1', self.port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        if self.transport == 'tls':
+            context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+            context.check_hostname = False
+            context.verify_mode = ssl.CERT_NONE
+            self.sock = context.wrap_socket(self.sock)
+        if self.transport == 'websocket':
+            self.websocket_handshake()
+        self.sock.setblocking(False)
+        self.login()
+
+    def websocket_handshake(self):
+        """Upgrade connection to websocket."""
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = [
+            'GET /weechat HTTP/1.1',
+            'Host: 127.0.0.1:%d' % self.port,
+            'Upgrade: websocket',
+            'Connection: Upgrade',
+            'Sec-WebSocket-Key: %s' % key,
+            'Sec-WebSocket-Version: 13',
+        ]
+        if self.bench.args.ws_deflate:
+            request.append('Sec-WebSocket-Extensions: permessage-deflate; '
+                           'client_max_window_bits')
+        self.sock.sendall(('\r\n'.join(request) + '\r\n\r\n').encode())
+        response = b''
+        while b'\r\n\r\n' not in response:
+            data = self.sock.recv(4096)
+            if not data:
+                raise IOError('websocket handshake failed')
+            response += data
+        headers, self.ws_buffer = response.split(b'\r\n\r\n', 1)
+        if b' 101 ' not in headers.split(b'\r\n', 1)[0]:
+            raise IOError('websocket handshake refused: %s' % headers)
+        if b'permessage-deflate' in headers.lower():
+            self.ws_deflate = True
+            self.ws_inflate = zlib.decompressobj(-zlib.MAX_WBITS)
+
+    def send(self, data):
+        """Send data to relay (in a masked websocket frame if needed)."""
+        if self.transport == 'websocket':
+            mask = os.urandom(4)
+            length = len(data)
+            if length < 126:
+                header = struct.pack('>BB', 0x81, 0x80 | length)
+            elif length < 65536:
+                header = struct.pack('>BBH', 0x81, 0x80 | 126, length)
+            else:
+                header = struct.pack('>BBQ', 0x81, 0x80 | 127, length)
+            data = header + mask + bytes(b ^ mask[i % 4]
+                                         for i, b in enumerate(data))
+        self.sock.setblocking(True)
+        try:
+            self.sock.sendall(data)
+        finally:
+            self.sock.setblocking(False)
+
+    def login(self):
+        """Login and synchronize with relay."""
+        raise NotImplementedError
+
+    def receive_data(self, data, now):
+        """Receive data (after websocket decoding)."""
+        raise NotImplementedError
+
+    def line_received(self, seq, now):
+        """Record reception of a line injected by the IRC server."""
+        if seq >= len(self.bench.sent_times):
+            return
+        if seq >= len(self.received):
+            self.received.extend(bytes(seq + 1 - len(self.received)))
+        if self.received[seq]:
+            self.duplicates += 1
+            return
+        self.received[seq] = 1
+        self.latencies.append(now - self.bench.sent_times[seq])
+
+    def websocket_frames(self, now):
+        """Decode websocket frames received."""
+        buf = self.ws_buffer
+        while len(buf) >= 2:
+            byte0, byte1 = buf[0], buf[1]
+            length = byte1 & 0x7F
+            pos = 2
+            if length == 126:
+                if len(buf) < 4:
+                    break
+                length = struct.unpack('>H', buf[2:4])[0]
+                pos = 4
+            elif length == 127:
+                if len(buf) < 10:
+                    break
+                length = struct.unpack('>Q', buf[2:10])[0]
+                pos = 10
+            if len(buf) < pos + length:
+                break
+            payload = buf[pos:pos + length]
+            buf = buf[pos + length:]
+            opcode = byte0 & 0x0F
+            if opcode == 0x8:
+                self.closed = True
+                break
+            if opcode == 0x9:
+                self.send_pong(payload)
+                continue
+            if opcode in (0x1, 0x2):
+                self.ws_message = b''
+                self.ws_message_deflated = bool(byte0 & 0x40)
+            elif opcode != 0x0:
+                continue
+            self.ws_message += payload
+            if byte0 & 0x80:
+                message = self.ws_message
+                self.ws_message = b''
+                if self.ws_message_deflated:
+                    message = self.ws_inflate.decompress(
+                        message + b'\x00\x00\xff\xff')
+                self.raw_bytes += len(message)
+                self.receive_data(message, now)
+        self.ws_buffer = buf
+
+    def send_pong(self, payload):
+        """Answer to a websocket ping."""
+        mask = os.urandom(4)
+        frame = struct.pack('>BB', 0x8A, 0x80 | len(payload)) + mask + bytes(
+            b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.setblocking(True)
+        try:
+            self.sock.sendall(frame)
+        finally:
+            self.sock.setblocking(False)
+
+    def read(self, now):
+        """Read data from socket."""
+        while True:
+            try:
+                data = self.sock.recv(262144)
+            except (ssl.SSLWantReadError, BlockingIOError):
+                return
+            except (ConnectionError, OSError):
+                data = b''
+            if not data:
+                self.closed = True
+                return
+            self.wire_bytes += len(data)
+            if self.transport == 'websocket':
+                self.ws_buffer += data
+                self.websocket_frames(now)
+            else:
+                self.raw_bytes += len(data)
+                self.receive_data(data, now)
+            if self.closed:
+                return
+
+
+class WeechatClient(Client):
+    """Client using the weechat protocol."""
+
+    protocol = 'weechat'
+
+    def __init__(self, bench, transport, port, compression, monitor=False):
+        Client.__init__(self, bench, transport, port)
+        self.compression = compression
+        self.monitor = monitor
+        self.buffer = b''
+        self.inflate_stream = None
+        self.msg_compressed_bytes = 0
+        self.msg_uncompressed_bytes = 0
+
+    @property
+    def kind(self):
+        return '%s/%s' % (Client.kind.fget(self), self.compression)
+
+    def login(self):
+        if self.compression == 'zlib_stream':
+            self.inflate_stream = zlib.decompressobj(-zlib.MAX_WBITS)
+        commands = [
+            '(hs) handshake compression=%s' % self.compression,
+            'init password=%s' % RELAY_PASSWORD,
+        ]
+        if not self.monitor:
+            commands.append('sync %s buffer' % BUFFER_NAME)
+        commands.append('(ready) ping ready')
+        for command in commands:
+            self.send((command + '\n').encode())
+
+    def receive_data(self, data, now):
+        self.buffer += data
+        while len(self.buffer) >= 5:
+            length = struct.unpack('>I', self.buffer[:4])[0]
+            if len(self.buffer) < length:
+                break
+            compression = self.buffer[4]
+            body = self.buffer[5:length]
+            self.buffer = self.buffer[length:]
+            self.msg_compressed_bytes += length
+            if compression == 1:
+                body = zlib.decompress(body)
+            elif compression == 2:
+                body = self.inflate_stream.decompress(body)
+            self.msg_uncompressed_bytes += 5 + len(body)
+            self.message_received(body, now)
+
+    def message_received(self, body, now):
+        """Process a message received."""
+        if self.monitor:
+            msg_id, objects = WeechatMessageDecoder(body).decode()
+            if msg_id == 'clients' and objects:
+                self.bench.clients_stats(objects[0])
+            elif msg_id == 'monitor' and objects and objects[0]:
+                self.bench.monitor_id = objects[0][0]['id']
+            elif msg_id == '_pong':
+                self.ready = True
+            return
+        if not self.ready:
+            if b'\x00\x00\x00\x05_pong' in body[:16]:
+                self.ready = True
+            return
+        for match in RE_LINE.finditer(body):
+            self.line_received(int(match.group(1)), now)
+
+    def poll_clients(self, msg_id='clients'):
+        """Ask outqueue of clients (monitor only)."""
+        self.send(('(%s) hdata relay_client:relay_clients(*) %s\n'
+                   % (msg_id, ','.join(CLIENT_HDATA_KEYS))).encode())
+
+
+class IrcClient(Client):
+    """Client using the irc protocol."""
+
+    protocol = 'irc'
+
+    def __init__(self, bench, transport, port):
+        Client.__init__(self, bench, transport, port)
+        self.buffer = b''
+
+    def login(self):
+        self.send(('PASS %s\r\nNICK %s\r\nUSER %s 0 * :%s\r\n'
+                   % (RELAY_PASSWORD, IRC_NICK, IRC_NICK,
+                      IRC_NICK)).encode())
+
+    def receive_data(self, data, now):
+        data = self.buffer + data
+        pos = data.rfind(b'\n')
+        if pos < 0:
+            self.buffer = data
+            return
+        self.buffer = data[pos + 1:]
+        data = data[:pos + 1]
+        if not self.ready:
+            if (' JOIN ' in data.decode('utf-8', 'replace')
+                    and IRC_CHANNEL.encode() in data):
+                self.ready = True
+            return
+        for match in RE_LINE.finditer(data):
+            self.line_received(int(match.group(1)), now)
+
+
+class FakeIrcServer(object):
+    """Fake IRC server: WeeChat connects to it, lines are injected in it."""
+
+    def __init__(self):
+        self.listen_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listen_sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listen_sock.bind(('127.0.0.1', 0))
+        self.listen_sock.listen(1)
+        self.listen_sock.setblocking(False)
+        self.port = self.listen_sock.getsockname()[1]
+        self.sock = None
+        self.inbuf = b''
+        self.outbuf = b''
+        self.nick = IRC_NICK
+        self.joined = False
+
+    def accept(self):
+        """Accept connection from WeeChat."""
+        self.sock, _ = self.listen_sock.accept()
+        self.sock.setblocking(False)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def queue(self, data):
+        """Queue data to send to WeeChat."""
+        self.outbuf += data
+
+    def flush(self):
+        """Send as much queued data as possible."""
+        if not self.sock or not self.outbuf:
+            return
+        try:
+            sent = self.sock.send(self.outbuf)
+            self.outbuf = self.outbuf[sent:]
+        except BlockingIOError:
+            pass
+
+    def read(self):
+        """Read and answer messages sent by WeeChat."""
+        try:
+            data = self.sock.recv(65536)
+        except BlockingIOError:
+            return
+        if not data:
+            raise IOError('WeeChat closed connection to the fake IRC server')
+        self.inbuf += data
+        while b'\r\n' in self.inbuf:
+            line, self.inbuf = self.inbuf.split(b'\r\n', 1)
+            words = line.decode('utf-8', 'replace').split(' ')
+            command = words[0].upper()
+            if command == 'NICK' and len(words) > 1:
+                self.nick = words[1]
+            elif command == 'USER':
+                self.queue((':server 001 {0} :Welcome\r\n'
+                            ':server 376 {0} :End of MOTD\r\n'
+                            ':{0}!u@localhost JOIN {1}\r\n'
+                            ':server 353 {0} = {1} :{0} alice\r\n'
+                            ':server 366 {0} {1} :End of NAMES\r\n'
+                            .format(self.nick, IRC_CHANNEL)).encode())
+                self.joined = True
+            elif command == 'PING':
+                self.queue((':server PONG server :%s\r\n'
+                            % words[-1].lstrip(':')).encode())
+
+
+class Benchmark(object):  # pylint: disable=too-many-instance-attributes
+    """Relay benchmark."""
+
+    def __init__(self, args):
+        self.args = args
+        self.home = tempfile.mkdtemp(prefix='weechat_relaybench_')
+        self.port_weechat = free_port()
+        self.port_irc = free_port()
+        self.port_tls_weechat = free_port()
+        self.port_tls_irc = free_port()
+        self.ircd = FakeIrcServer()
+        self.process = None
+        self.clients = []
+        self.monitor = None
+        self.monitor_id = None
+        self.sent_times = []
+        self.outqueue = {}
+        self.dropped = {}
+        self.selector = selectors.DefaultSelector()
+        self.tls = 'tls' in args.transports
+
+    def create_certificate(self):
+        """Create a self-signed certificate for relay (TLS)."""
+        ssl_dir = os.path.join(self.home, 'ssl')
+        os.mkdir(ssl_dir)
+        key_file = os.path.join(ssl_dir, 'key.pem')
+        cert_file = os.path.join(ssl_dir, 'cert.pem')
+        try:
+            subprocess.check_call(
+                ['openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes',
+                 '-keyout', key_file, '-out', cert_file, '-days', '1',
+                 '-subj', '/CN=localhost'],
+                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        except (OSError, subprocess.CalledProcessError):
+            print('WARNING: unable to create a certificate with openssl, '
+                  'TLS clients are disabled')
+            self.tls = False
+            return
+        with open(os.path.join(ssl_dir, 'relay.pem'), 'w') as pem:
+            for name in (key_file, cert_file):
+                with open(name, 'r') as pem_part:
+                    pem.write(pem_part.read())
+
+    def start_weechat(self):
+        """Start WeeChat (headless) with relays and IRC server."""
+        commands = [
+            '/set relay.network.password %s' % RELAY_PASSWORD,
+            '/set relay.network.max_clients 0',
+            '/set relay.network.compression_level %d'
+            % self.args.compression_level,
+            '/set relay.irc.backlog_max_number 0',
+            '/server add %s 127.0.0.1/%d' % (IRC_SERVER, self.ircd.port),
+            '/set irc.server.%s.nicks %s' % (IRC_SERVER, IRC_NICK),
+            '/connect %s' % IRC_SERVER,
+            '/relay add weechat %d' % self.port_weechat,
+            '/relay add irc.%s %d' % (IRC_SERVER, self.port_irc),
+        ]
+        if self.tls:
+            commands += [
+                '/relay add ssl.weechat %d' % self.port_tls_weechat,
+                '/relay add ssl.irc.%s %d' % (IRC_SERVER, self.port_tls_irc),
+            ]
+        env = dict(os.environ)
+        if self.args.libdir:
+            env['WEECHAT_EXTRA_LIBDIR'] = self.args.libdir
+        self.process = subprocess.Popen(
+            [self.args.weechat, '--dir', self.home, '-r', ';'.join(commands)],
+            env=env, stdin=subprocess.DEVNULL,
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    def wait(self, condition, timeout, what):
+        """Run event loop until a condition is true."""
+        deadline = time.monotonic() + timeout
+        while not condition():
+            if time.monotonic() > deadline:
+                raise IOError('timeout: %s' % what)
+            if self.process.poll() is not None:
+                raise IOError('WeeChat exited (code %d)'
+                              % self.process.returncode)
+            self.loop_once(0.05)
+
+    def loop_once(self, timeout):
+        """Process events on sockets."""
+        if self.ircd.outbuf:
+            self.selector.modify(self.ircd.sock,
+                                 selectors.EVENT_READ | selectors.EVENT_WRITE,
+                                 self.ircd)
+        for key, mask in self.selector.select(timeout):
+            obj = key.data
+            if obj is self.ircd:
+                if mask & selectors.EVENT_READ:
+                    self.ircd.read()
+                if mask & selectors.EVENT_WRITE:
+                    self.ircd.flush()
+                    if not self.ircd.outbuf:
+                        self.selector.modify(self.ircd.sock,
+                                             selectors.EVENT_READ, self.ircd)
+            else:
+                obj.read(time.monotonic())
+                if obj.closed:
+                    self.selector.unregister(obj.sock)
+
+    def client_port(self, protocol, transport):
+        """Return port of relay for a protocol/transport."""
+        if transport == 'tls':
+            if protocol == 'weechat':
+                return self.port_tls_weechat
+            return self.port_tls_irc
+        return self.port_weechat if protocol == 'weechat' else self.port_irc
+
+    def connect_client(self, client):
+        """Connect a client and watch its socket."""
+        client.connect()
+        self.selector.register(client.sock, selectors.EVENT_READ, client)
+        if client.ws_buffer:
+            client.websocket_frames(time.monotonic())
+
+    def create_monitor(self):
+        """
+        Create and connect the monitor: it is connected alone, so that its id
+        in relay is known and it is not counted in stats of clients.
+        """
+        self.monitor = WeechatClient(self, 'plain', self.port_weechat, 'off',
+                                     monitor=True)
+        self.connect_client(self.monitor)
+        self.wait(lambda: self.monitor.ready or self.monitor.closed,
+                  self.args.timeout, 'login of monitor')
+        self.monitor.poll_clients('monitor')
+        self.wait(lambda: self.monitor_id is not None or self.monitor.closed,
+                  self.args.timeout, 'id of monitor')
+        if self.monitor.closed:
+            raise IOError('monitor not connected')
+
+    def create_clients(self):
+        """Create and connect clients."""
+        transports = [t for t in self.args.transports
+                      if t != 'tls' or self.tls]
+        for i in range(self.args.weechat_clients):
+            transport = transports[i % len(transports)]
+            compression = self.args.compressions[
+                (i // len(transports)) % len(self.args.compressions)]
+            self.clients.append(
+                WeechatClient(self, transport,
+                              self.client_port('weechat', transport),
+                              compression))
+        for i in range(self.args.irc_clients):
+            transport = transports[i % len(transports)]
+            self.clients.append(
+                IrcClient(self, transport,
+                          self.client_port('irc', transport)))
+        for client in self.clients:
+            self.connect_client(client)
+
+    def clients_stats(self, items):
+        """Record outqueue of clients (from hdata "relay_client")."""
+        for item in items:
+            if (item.get('protocol_string') is None
+                    or item['id'] == self.monitor_id):
+                continue
+            protocol = item['protocol_string'].split('.', 1)[0]
+            transport = 'plain'
+            if item['ssl']:
+                transport = 'tls'
+            elif item['websocket']:
+                transport = 'websocket'
+            group = '%s/%s' % (protocol, transport)
+            self.outqueue.setdefault(group, []).append(
+                (item['outqueue_size'], item['outqueue_count']))
+            self.dropped[(group, item['id'])] = item['msgs_dropped']
+
+    def inject(self, start, sent):
+        """Inject lines in IRC channel according to rate."""
+        due = int((time.monotonic() - start) * self.args.rate)
+        due = min(due, int(self.args.duration * self.args.rate))
+        if due <= sent:
+            return sent
+        padding = 'x' * max(0, self.args.line_size - 20)
+        now = time.monotonic()
+        data = []
+        for seq in range(sent, due):
+            self.sent_times.append(now)
+            data.append(':alice!a@localhost PRIVMSG %s :bench:%d: %s\r\n'
+                        % (IRC_CHANNEL, seq, padding))
+        self.ircd.queue(''.join(data).encode())
+        self.ircd.flush()
+        return due
+
+    def all_received(self):
+        """Check if all clients have received all lines."""
+        total = len(self.sent_times)
+        return all(len(client.latencies) >= total or client.closed
+                   for client in self.clients)
+
+    def run(self):
+        """Run the benchmark."""
+        if self.tls:
+            self.create_certificate()
+        self.start_weechat()
+        self.selector.register(self.ircd.listen_sock, selectors.EVENT_READ,
+                               self.ircd)
+
+        # wait for WeeChat connected to IRC server, joined on channel
+        deadline = time.monotonic() + self.args.timeout
+        while not self.ircd.sock:
+            if time.monotonic() > deadline or self.process.poll() is not None:
+                raise IOError('WeeChat did not connect to fake IRC server')
+            if self.selector.select(0.1):
+                self.ircd.accept()
+        self.selector.unregister(self.ircd.listen_sock)
+        self.selector.register(self.ircd.sock, selectors.EVENT_READ,
+                               self.ircd)
+        self.wait(lambda: self.ircd.joined and not self.ircd.outbuf,
+                  self.args.timeout, 'join of IRC channel')
+        # let WeeChat create the channel buffer
+        deadline = time.monotonic() + 0.5
+        self.wait(lambda: time.monotonic() > deadline, 5, 'WeeChat')
+
+        self.create_monitor()
+        self.create_clients()
+        self.wait(lambda: all(c.ready or c.closed for c in self.clients),
+                  self.args.timeout, 'login of clients')
+        not_ready = [c.kind for c in self.clients if not c.ready]
+        if not_ready:
+            raise IOError('clients not connected: %s' % ', '.join(not_ready))
+
+        # CPU used by WeeChat without lines (idle + polls of monitor)
+        baseline_rate = self.measure_baseline()
+
+        # inject lines
+        cpu_start = process_cpu_time(self.process.pid)
+        self_cpu_start = time.process_time()
+        start = time.monotonic()
+        next_poll = start
+        sent = 0
+        total = int(self.args.duration * self.args.rate)
+        while sent < total:
+            sent = self.inject(start, sent)
+            if time.monotonic() >= next_poll:
+                self.monitor.poll_clients()
+                next_poll += self.args.poll_interval
+            self.loop_once(min(0.01, 1.0 / max(self.args.rate, 1)))
+            if self.process.poll() is not None:
+                raise IOError('WeeChat exited during benchmark')
+
+        # wait for all lines received by clients
+        deadline = time.monotonic() + self.args.drain
+        while time.monotonic() < deadline and not self.all_received():
+            if time.monotonic() >= next_poll:
+                self.monitor.poll_clients()
+                next_poll += self.args.poll_interval
+            self.loop_once(0.01)
+        elapsed = time.monotonic() - start
+        cpu_end = process_cpu_time(self.process.pid)
+        self_cpu = time.process_time() - self_cpu_start
+
+        weechat_cpu = None
+        if cpu_start is not None and cpu_end is not None:
+            weechat_cpu = cpu_end - cpu_start
+        return self.report(elapsed, weechat_cpu, baseline_rate, self_cpu)
+
+    def measure_baseline(self):
+        """
+        Measure CPU used by WeeChat without lines injected (idle and polls of
+        monitor), so that it can be subtracted from CPU used during benchmark.
+
+        Returns CPU used per second, None if the CPU can not be measured.
+        """
+        cpu_start = process_cpu_time(self.process.pid)
+        if cpu_start is None:
+            return None
+        start = time.monotonic()
+        next_poll = start
+        while time.monotonic() - start < self.args.baseline:
+            if time.monotonic() >= next_poll:
+                self.monitor.poll_clients()
+                next_poll += self.args.poll_interval
+            self.loop_once(0.01)
+        elapsed = time.monotonic() - start
+        self.outqueue = {}
+        return (process_cpu_time(self.process.pid) - cpu_start) / elapsed
+
+    def report(self, elapsed, weechat_cpu, baseline_rate, self_cpu):
+        """Build report (dict) of benchmark."""
+        total = len(self.sent_times)
+        groups = {}
+        for client in self.clients:
+            groups.setdefault(client.kind, []).append(client)
+        result = {
+            'lines_sent': total,
+            'rate': self.args.rate,
+            'duration': round(elapsed, 3),
+            'clients': len(self.clients),
+            'weechat_cpu': weechat_cpu,
+            'weechat_cpu_baseline': None,
+            'weechat_cpu_per_client': None,
+            'bench_cpu': round(self_cpu, 3),
+            'groups': {},
+        }
+        if weechat_cpu is not None and baseline_rate is not None:
+            baseline = baseline_rate * elapsed
+            result['weechat_cpu_baseline'] = round(baseline, 3)
+            result['weechat_cpu_per_client'] = (
+                max(0.0, weechat_cpu - baseline) / len(self.clients))
+        for kind in sorted(groups):
+            clients = groups[kind]
+            latencies = sorted(lat for client in clients
+                               for lat in client.latencies)
+            received = sum(len(client.latencies) for client in clients)
+            wire = sum(client.wire_bytes for client in clients)
+            raw = sum(client.raw_bytes for client in clients)
+            uncompressed = raw
+            if clients[0].protocol == 'weechat':
+                uncompressed = sum(client.msg_uncompressed_bytes
+                                   for client in clients)
+            transport = kind.split('/')[1].split('+')[0]
+            outqueue = self.outqueue.get(
+                '%s/%s' % (clients[0].protocol, transport), [])
+            result['groups'][kind] = {
+                'clients': len(clients),
+                'lines_received': received,
+                'lines_missed': total * len(clients) - received,
+                'duplicates': sum(client.duplicates for client in clients),
+                'latency_ms': {
+                    'p50': round(percentile(latencies, 50) * 1000, 3),
+                    'p90': round(percentile(latencies, 90) * 1000, 3),
+                    'p99': round(percentile(latencies, 99) * 1000, 3),
+                    'max': round(latencies[-1] * 1000, 3) if latencies else 0,
+                },
+                'bytes_received': wire,
+                'compression_ratio': (round(float(uncompressed) / wire, 3)
+                                      if wire else 0),
+                'outqueue_size_max': max([q[0] for q in outqueue] or [0]),
+                'outqueue_count_max': max([q[1] for q in outqueue] or [0]),
+                'closed': sum(1 for client in clients if client.closed),
+            }
+        result['msgs_dropped'] = sum(self.dropped.values())
+        return result
+
+    def stop(self):
+        """Stop WeeChat and remove temporary home directory."""
+        if self.process and self.process.poll() is None:
+            self.process.terminate()
+            try:
+                self.process.wait(10)
+            except subprocess.TimeoutExpired:
+                self.process.kill()
+                self.process.wait()
+        shutil.rmtree(self.home, ignore_errors=True)
+
+
+def print_report(result):
+    """Display report of benchmark."""
+    print('Lines sent: %d (%.0f lines/s) in %.2fs, clients: %d'
+          % (result['lines_sent'], result['rate'], result['duration'],
+             result['clients']))
+    if result['weechat_cpu'] is not None:
+        print('CPU WeeChat: %.3fs (%.1f%%), without lines: %.3fs, '
+              'per client: %.4fs'
+              % (result['weechat_cpu'],
+                 100.0 * result['weechat_cpu'] / result['duration'],
+                 result['weechat_cpu_baseline'],
+                 result['weechat_cpu_per_client']))
+    print('CPU benchmark: %.3fs' % result['bench_cpu'])
+    print('Messages dropped by relay: %d' % result['msgs_dropped'])
+    print('')
+    columns = ('client', 'nb', 'received', 'missed', 'p50 ms', 'p90 ms',
+               'p99 ms', 'max ms', 'bytes', 'ratio', 'outq max',
+               'outq msgs')
+    rows = []
+    for kind, group in sorted(result['groups'].items()):
+        rows.append((
+            kind,
+            str(group['clients']),
+            str(group['lines_received']),
+            str(group['lines_missed']),
+            '%.2f' % group['latency_ms']['p50'],
+            '%.2f' % group['latency_ms']['p90'],
+            '%.2f' % group['latency_ms']['p99'],
+            '%.2f' % group['latency_ms']['max'],
+            str(group['bytes_received']),
+            '%.2f' % group['compression_ratio'],
+            str(group['outqueue_size_max']),
+            str(group['outqueue_count_max']),
+        ))
+    widths = [max(len(row[i]) for row in rows + [columns])
+              for i in range(len(columns))]
+    for row in [columns] + rows:
+        print('  '.join(value.ljust(widths[i]) if i == 0
+                        else value.rjust(widths[i])
+                        for i, value in enumerate(row)))
+
+
+def comma_list(choices):
+    """Return an argparse type for a comma-separated list of choices."""
+    def parse(value):
+        items = [item for item in value.split(',') if item]
+        for item in items:
+            if item not in choices:
+                raise argparse.ArgumentTypeError(
+                    'invalid value "%s" (choices: %s)'
+                    % (item, ', '.join(choices)))
+        if not items:
+            raise argparse.ArgumentTypeError('empty list')
+        return items
+    return parse
+
+
+def get_parser():
+    """Get parser for command line arguments."""
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+        description='Load generator and benchmark for WeeChat relay plugin.')
+    parser.add_argument('-w', '--weechat', required=True,
+                        help='path to weechat-headless binary')
+    parser.add_argument('-l', '--libdir',
+                        help='directory with plugins (set in '
+                        'WEECHAT_EXTRA_LIBDIR), for example the "src" '
+                        'directory of CMake build')
+    parser.add_argument('--weechat-clients', type=int, default=9,
+                        help='number of clients with weechat protocol')
+    parser.add_argument('--irc-clients', type=int, default=3,
+                        help='number of clients with irc protocol')
+    parser.add_argument('-t', '--transports',
+                        type=comma_list(TRANSPORTS),
+                        default=list(TRANSPORTS),
+                        help='transports used by clients (cycled): '
+                        + ', '.join(TRANSPORTS))
+    parser.add_argument('-c', '--compressions',
+                        type=comma_list(WEECHAT_COMPRESSIONS),
+                        default=list(WEECHAT_COMPRESSIONS),
+                        help='compressions used by weechat clients '
+                        '(cycled): ' + ', '.join(WEECHAT_COMPRESSIONS))
+    parser.add_argument('--compression-level', type=int, default=6,
+                        help='compression level in relay (0-9)')
+    parser.add_argument('--no-ws-deflate', dest='ws_deflate',
+                        action='store_false',
+                        help='do not ask websocket extension '
+                        '"permessage-deflate"')
+    parser.add_argument('-r', '--rate', type=float, default=200,
+                        help='lines injected per second')
+    parser.add_argument('-d', '--duration', type=float, default=10,
+                        help='duration of injection (in seconds)')
+    parser.add_argument('-s', '--line-size', type=int, default=100,
+                        help='approximate size of lines injected (in bytes)')
+    parser.add_argument('--drain', type=float, default=5,
+                        help='max delay to wait for lines not yet received '
+                        'by clients after injection (in seconds)')
+    parser.add_argument('--poll-interval', type=float, default=0.5,
+                        help='interval between checks of outqueue of clients '
+                        '(in seconds)')
+    parser.add_argument('--baseline', type=float, default=1,
+                        help='duration of measure of CPU used by WeeChat '
+                        'without lines, subtracted from CPU used by clients '
+                        '(in seconds)')
+    parser.add_argument('--timeout', type=float, default=20,
+                        help='timeout for startup and login of clients '
+                        '(in seconds)')
+    parser.add_argument('-j', '--json',
+                        help='write results in this file (JSON format)')
+    return parser
+
+
+def main():
+    """Main function."""
+    args = get_parser().parse_args()
+    if args.weechat_clients + args.irc_clients <= 0:
+        sys.exit('ERROR: no clients')
+    if args.rate <= 0 or args.duration <= 0:
+        sys.exit('ERROR: rate and duration must be positive')
+    bench = Benchmark(args)
+    try:
+        result = bench.run()
+    except (IOError, OSError) as exc:
+        sys.exit('ERROR: %s' % exc)
+    finally:
+        bench.stop()
+    print_report(result)
+    if args.json:
+        with open(args.json, 'w') as json_file:
+            json.dump(result, json_file, indent=2, sort_keys=True)
+    missed = sum(group['lines_missed'] for group in result['groups'].values())
+    sys.exit(1 if missed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -23,7 +23,22 @@
 
 extern "C"
 {
+#include <stddef.h>
+#include <string.h>
 #include "src/core/wee-hdata.h"
+#include "src/core/wee-hashtable.h"
+#include "src/plugins/weechat-plugin.h"
+
+struct t_test_hdata_path
+{
+    int number;
+    char *name;
+    int count;
+    char **names;
+    int values[3];
+    struct t_hashtable *hashtable;
+    struct t_test_hdata_path *next;
+};
 }
 
 TEST_GROUP(CoreHdata)
@@ -96,6 +111,153 @@ TEST(CoreHdata, Read)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   hdata_path_compile
+ *   hdata_path_get
+ *   hdata_path_get_type
+ *   hdata_path_get_object
+ *   hdata_path_get_array_size
+ *   hdata_path_get_value
+ *   hdata_path_invalidate
+ *   hdata_path_free
+ */
+
+TEST(CoreHdata, Path)
+{
+    struct t_hdata *hdata;
+    struct t_hdata_path *hpath, *hpath2;
+    struct t_test_hdata_path obj1, obj2;
+    struct t_weechat_plugin *plugin;
+    char *names[3];
+
+    /* fake plugin, used to free the hdata at the end of test */
+    plugin = (struct t_weechat_plugin *)&obj1;
+
+    hdata = hdata_new (plugin, "test_hdata_path", NULL, "next", 0, 0,
+                       NULL, NULL);
+    CHECK(hdata);
+    HDATA_VAR(struct t_test_hdata_path, number, INTEGER, 0, NULL, NULL);
+    HDATA_VAR(struct t_test_hdata_path, name, STRING, 0, NULL, NULL);
+    HDATA_VAR(struct t_test_hdata_path, count, INTEGER, 0, NULL, NULL);
+    HDATA_VAR(struct t_test_hdata_path, names, STRING, 0, "*", NULL);
+    HDATA_VAR(struct t_test_hdata_path, values, INTEGER, 0, "count", NULL);
+    HDATA_VAR(struct t_test_hdata_path, hashtable, HASHTABLE, 0, NULL, NULL);
+    HDATA_VAR(struct t_test_hdata_path, next, POINTER, 0, NULL,
+              "test_hdata_path");
+
+    names[0] = (char *)"a";
+    names[1] = (char *)"b";
+    names[2] = NULL;
+    memset (&obj1, 0, sizeof (obj1));
+    memset (&obj2, 0, sizeof (obj2));
+    obj1.number = 1;
+    obj1.name = (char *)"obj1";
+    obj1.next = &obj2;
+    obj2.number = 2;
+    obj2.name = (char *)"obj2";
+    obj2.count = 2;
+    obj2.names = names;
+    obj2.values[0] = 10;
+    obj2.values[1] = 20;
+    obj2.hashtable = hashtable_new (8,
+                                    WEECHAT_HASHTABLE_STRING,
+                                    WEECHAT_HASHTABLE_STRING,
+                                    NULL, NULL);
+    hashtable_set (obj2.hashtable, "key", "value");
+
+    POINTERS_EQUAL(NULL, hdata_path_compile (NULL, "number"));
+    POINTERS_EQUAL(NULL, hdata_path_compile (hdata, NULL));
+    POINTERS_EQUAL(NULL, hdata_path_compile (hdata, ""));
+    POINTERS_EQUAL(NULL, hdata_path_compile (hdata, "xxx"));
+    POINTERS_EQUAL(NULL, hdata_path_compile (hdata, "next.xxx"));
+    LONGS_EQUAL(-1, hdata_path_get_type (NULL));
+    LONGS_EQUAL(-1, hdata_path_get_array_size (NULL, &obj1));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (NULL, &obj1, -1));
+
+    /* simple variable */
+    hpath = hdata_path_compile (hdata, "number");
+    CHECK(hpath);
+    LONGS_EQUAL(WEECHAT_HDATA_INTEGER, hdata_path_get_type (hpath));
+    LONGS_EQUAL(-1, hdata_path_get_array_size (hpath, &obj1));
+    POINTERS_EQUAL(&obj1.number, hdata_path_get_value (hpath, &obj1, -1));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (hpath, NULL, -1));
+    hdata_path_free (hpath);
+
+    /* pointers followed in path, value after the last pointer */
+    hpath = hdata_path_compile (hdata, "next.name");
+    CHECK(hpath);
+    LONGS_EQUAL(WEECHAT_HDATA_STRING, hdata_path_get_type (hpath));
+    POINTERS_EQUAL(&obj2, hdata_path_get_object (hpath, &obj1));
+    STRCMP_EQUAL("obj2", *((char **)hdata_path_get_value (hpath, &obj1, -1)));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (hpath, &obj2, -1));
+    hdata_path_free (hpath);
+
+    /* value is not a pointer: rest of path is ignored */
+    hpath = hdata_path_compile (hdata, "next.number.xxx");
+    CHECK(hpath);
+    LONGS_EQUAL(2, *((int *)hdata_path_get_value (hpath, &obj1, -1)));
+    hdata_path_free (hpath);
+
+    /* arrays: automatic size and size in a variable */
+    hpath = hdata_path_compile (hdata, "next.names");
+    CHECK(hpath);
+    LONGS_EQUAL(2, hdata_path_get_array_size (hpath, &obj1));
+    LONGS_EQUAL(-1, hdata_path_get_array_size (hpath, &obj2));
+    STRCMP_EQUAL("b", *((char **)hdata_path_get_value (hpath, &obj1, 1)));
+    hdata_path_free (hpath);
+    hpath = hdata_path_compile (hdata, "names");
+    CHECK(hpath);
+    LONGS_EQUAL(0, hdata_path_get_array_size (hpath, &obj1));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (hpath, &obj1, 0));
+    hdata_path_free (hpath);
+    hpath = hdata_path_compile (hdata, "next.1|values");
+    CHECK(hpath);
+    LONGS_EQUAL(2, hdata_path_get_array_size (hpath, &obj1));
+    LONGS_EQUAL(20, *((int *)hdata_path_get_value (hpath, &obj1, -1)));
+    LONGS_EQUAL(10, *((int *)hdata_path_get_value (hpath, &obj1, 0)));
+    hdata_path_free (hpath);
+
+    /* hashtable followed by a key */
+    hpath = hdata_path_compile (hdata, "next.hashtable.key");
+    CHECK(hpath);
+    LONGS_EQUAL(WEECHAT_HDATA_HASHTABLE, hdata_path_get_type (hpath));
+    STRCMP_EQUAL("key", hpath->hashtable_key);
+    POINTERS_EQUAL(obj2.hashtable,
+                   *((struct t_hashtable **)hdata_path_get_value (hpath,
+                                                                  &obj1, -1)));
+    hdata_path_free (hpath);
+
+    /* compiled paths kept in hdata */
+    hpath = hdata_path_get (hdata, "next.name");
+    CHECK(hpath);
+    POINTERS_EQUAL(hpath, hdata_path_get (hdata, "next.name"));
+    POINTERS_EQUAL(NULL, hdata_path_get (hdata, "xxx"));
+    LONGS_EQUAL(1, hdata->hash_path->items_count);
+
+    /* variable replaced in hdata: compiled paths are invalidated */
+    hpath2 = hdata_path_compile (hdata, "next.number");
+    CHECK(hpath2);
+    HDATA_VAR(struct t_test_hdata_path, name, STRING, 0, NULL, NULL);
+    LONGS_EQUAL(-1, hdata_path_get_type (hpath));
+    LONGS_EQUAL(-1, hdata_path_get_type (hpath2));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (hpath2, &obj1, -1));
+    hpath = hdata_path_get (hdata, "next.name");
+    CHECK(hpath);
+    LONGS_EQUAL(WEECHAT_HDATA_STRING, hdata_path_get_type (hpath));
+    hdata_path_free (hpath2);
+
+    /* hdata freed: compiled paths are invalidated */
+    hpath = hdata_path_compile (hdata, "next.number");
+    CHECK(hpath);
+    hdata_free_all_plugin (plugin);
+    LONGS_EQUAL(-1, hdata_path_get_type (hpath));
+    POINTERS_EQUAL(NULL, hdata_path_get_value (hpath, &obj1, -1));
+    hdata_path_free (hpath);
+
+    hashtable_free (obj2.hashtable);
+}
+
 /*
  * Tests functions:
  *   hdata_free_all_plugin
@@ -116,6 +116,7 @@ extern "C"
     free (str);
 
 extern struct t_hashtable *string_hashtable_shared;
+extern struct t_hashtable *string_hashtable_iconv;
 
 TEST_GROUP(CoreString)
 {
@@ -1618,6 +1619,18 @@ TEST(CoreString, Iconv)
     WEE_TEST_STR(noel_iso, string_iconv (1, "UTF-8", "ISO-8859-15", noel_utf8));
     WEE_TEST_STR(noel_utf8, string_iconv (0, "ISO-8859-15", "UTF-8", noel_iso));
 
+    /* iconv descriptors are kept in pool and reused */
+    CHECK(string_hashtable_iconv);
+    CHECK(hashtable_has_key (string_hashtable_iconv, "UTF-8\nISO-8859-15"));
+    CHECK(hashtable_has_key (string_hashtable_iconv, "ISO-8859-15\nUTF-8"));
+    WEE_TEST_STR(noel_iso, string_iconv (1, "UTF-8", "ISO-8859-15", noel_utf8));
+    WEE_TEST_STR(noel_utf8, string_iconv (0, "ISO-8859-15", "UTF-8", noel_iso));
+
+    /* unsupported conversion is kept in pool as well */
+    WEE_TEST_STR("abc", string_iconv (0, "UTF-8", "unknown-charset", "abc"));
+    CHECK(hashtable_has_key (string_hashtable_iconv, "UTF-8\nunknown-charset"));
+    WEE_TEST_STR("abc", string_iconv (0, "UTF-8", "unknown-charset", "abc"));
+
     /* string_iconv_to_internal */
     WEE_TEST_STR(NULL, string_iconv_to_internal (NULL, NULL));
     WEE_TEST_STR("", string_iconv_to_internal (NULL, ""));
@@ -24,9 +24,12 @@
 extern "C"
 {
 #include <string.h>
+#include "src/core/wee-arraylist.h"
 #include "src/core/wee-config.h"
+#include "src/core/wee-hashtable.h"
 #include "src/core/wee-string.h"
 #include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
 #include "src/gui/gui-filter.h"
 #include "src/gui/gui-hotlist.h"
 #include "src/gui/gui-line.h"
@@ -497,6 +500,51 @@ TEST(GuiLine, Free)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   gui_line_free (line added in a batch)
+ */
+
+TEST(GuiLine, FreeInBatch)
+{
+    struct t_gui_buffer *buffer;
+
+    buffer = gui_buffer_new (NULL, "test_batch",
+                             NULL, NULL, NULL,
+                             NULL, NULL, NULL);
+    CHECK(buffer);
+
+    /* keep only 2 lines in buffer: first lines of batch are freed */
+    config_file_option_set (config_history_max_buffer_lines_number, "2", 1);
+
+    gui_buffer_batch_start (buffer);
+    LONGS_EQUAL(1, buffer->batch);
+    gui_chat_printf_date_tags (buffer, 1000, NULL, "line 1");
+    gui_chat_printf_date_tags (buffer, 1001, NULL, "line 2");
+    gui_chat_printf_date_tags (buffer, 1002, NULL, "line 3");
+    gui_chat_printf_date_tags (buffer, 1003, NULL, "line 4");
+    LONGS_EQUAL(2, buffer->own_lines->lines_count);
+
+    /* lines freed are replaced by NULL in the batch */
+    LONGS_EQUAL(4, arraylist_size (buffer->batch_lines));
+    POINTERS_EQUAL(NULL, arraylist_get (buffer->batch_lines, 0));
+    POINTERS_EQUAL(NULL, arraylist_get (buffer->batch_lines, 1));
+    POINTERS_EQUAL(buffer->own_lines->first_line,
+                   arraylist_get (buffer->batch_lines, 2));
+    POINTERS_EQUAL(buffer->own_lines->last_line,
+                   arraylist_get (buffer->batch_lines, 3));
+    LONGS_EQUAL(2, buffer->batch_lines_index->items_count);
+
+    gui_buffer_batch_end (buffer);
+    LONGS_EQUAL(0, buffer->batch);
+    POINTERS_EQUAL(NULL, buffer->batch_lines);
+    POINTERS_EQUAL(NULL, buffer->batch_lines_index);
+
+    config_file_option_reset (config_history_max_buffer_lines_number, 1);
+
+    gui_buffer_close (buffer);
+}
+
 /*
  * Tests functions:
  *   gui_line_free_all
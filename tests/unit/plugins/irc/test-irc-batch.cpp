@@ -0,0 +1,247 @@
+/*
+ * test-irc-batch.cpp - test IRC batch functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "src/core/wee-arraylist.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/irc/irc-batch.h"
+#include "src/plugins/irc/irc-channel.h"
+#include "src/plugins/irc/irc-server.h"
+}
+
+#include "tests/tests.h"
+
+#define IRC_FAKE_SERVER "fake"
+
+TEST_GROUP(IrcBatch)
+{
+};
+
+/*
+ * Tests functions:
+ *   irc_batch_is_playback
+ */
+
+TEST(IrcBatch, IsPlayback)
+{
+    LONGS_EQUAL(0, irc_batch_is_playback (NULL));
+    LONGS_EQUAL(0, irc_batch_is_playback (""));
+    LONGS_EQUAL(0, irc_batch_is_playback ("netjoin"));
+    LONGS_EQUAL(0, irc_batch_is_playback ("netsplit"));
+
+    LONGS_EQUAL(1, irc_batch_is_playback ("chathistory"));
+    LONGS_EQUAL(1, irc_batch_is_playback ("draft/chathistory"));
+    LONGS_EQUAL(1, irc_batch_is_playback ("znc.in/playback"));
+}
+
+TEST_GROUP(IrcBatchWithServer)
+{
+    struct t_irc_server *server;
+
+    void server_recv (const char *command)
+    {
+        char str_command[4096];
+
+        snprintf (str_command, sizeof (str_command),
+                  "/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+                  "/server fakerecv %s",
+                  command);
+        run_cmd (str_command);
+    }
+
+    void setup ()
+    {
+        printf ("\n");
+
+        /* create a fake server (no I/O) */
+        run_cmd ("/server add " IRC_FAKE_SERVER " fake:127.0.0.1 "
+                 "-nicks=nick1,nick2,nick3");
+
+        /* connect to the fake server */
+        run_cmd ("/connect " IRC_FAKE_SERVER);
+
+        /* get the server pointer */
+        server = irc_server_search (IRC_FAKE_SERVER);
+    }
+
+    void teardown ()
+    {
+        /* disconnect and delete the fake server */
+        run_cmd ("/disconnect " IRC_FAKE_SERVER);
+        run_cmd ("/server del " IRC_FAKE_SERVER);
+        server = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_batch_start
+ *   irc_batch_search
+ *   irc_batch_free
+ *   irc_batch_free_all
+ */
+
+TEST(IrcBatchWithServer, StartSearchFree)
+{
+    struct t_irc_batch *batch1, *batch2;
+
+    POINTERS_EQUAL(NULL, irc_batch_start (NULL, "ref", NULL, "type", NULL));
+    POINTERS_EQUAL(NULL, irc_batch_start (server, NULL, NULL, "type", NULL));
+    POINTERS_EQUAL(NULL, irc_batch_start (server, "", NULL, "type", NULL));
+    POINTERS_EQUAL(NULL, irc_batch_start (server, "ref", NULL, NULL, NULL));
+    POINTERS_EQUAL(NULL, irc_batch_start (server, "ref", NULL, "", NULL));
+
+    batch1 = irc_batch_start (server, "ref1", NULL, "chathistory", "#test");
+    CHECK(batch1);
+    STRCMP_EQUAL("ref1", batch1->reference);
+    POINTERS_EQUAL(NULL, batch1->parent_ref);
+    STRCMP_EQUAL("chathistory", batch1->type);
+    STRCMP_EQUAL("#test", batch1->parameters);
+    CHECK(batch1->messages);
+    LONGS_EQUAL(0, arraylist_size (batch1->messages));
+    POINTERS_EQUAL(batch1, server->batches);
+    POINTERS_EQUAL(batch1, server->last_batch);
+
+    /* reference already used */
+    POINTERS_EQUAL(NULL, irc_batch_start (server, "ref1", NULL, "test", NULL));
+
+    batch2 = irc_batch_start (server, "ref2", "ref1", "netjoin", NULL);
+    CHECK(batch2);
+    STRCMP_EQUAL("ref1", batch2->parent_ref);
+    POINTERS_EQUAL(NULL, batch2->parameters);
+    POINTERS_EQUAL(batch1, server->batches);
+    POINTERS_EQUAL(batch2, server->last_batch);
+
+    POINTERS_EQUAL(NULL, irc_batch_search (NULL, "ref1"));
+    POINTERS_EQUAL(NULL, irc_batch_search (server, NULL));
+    POINTERS_EQUAL(NULL, irc_batch_search (server, "ref3"));
+    POINTERS_EQUAL(batch1, irc_batch_search (server, "ref1"));
+    POINTERS_EQUAL(batch2, irc_batch_search (server, "ref2"));
+
+    irc_batch_free (server, batch1);
+    POINTERS_EQUAL(batch2, server->batches);
+    POINTERS_EQUAL(batch2, server->last_batch);
+    POINTERS_EQUAL(NULL, irc_batch_search (server, "ref1"));
+
+    irc_batch_free_all (server);
+    POINTERS_EQUAL(NULL, server->batches);
+    POINTERS_EQUAL(NULL, server->last_batch);
+}
+
+/*
+ * Tests functions:
+ *   irc_batch_add_message
+ *   irc_batch_end
+ */
+
+TEST(IrcBatchWithServer, AddMessage)
+{
+    struct t_irc_batch *batch;
+    struct t_irc_channel *ptr_channel;
+    struct t_gui_line *ptr_line;
+    int lines_count;
+
+    server_recv (":server 001 alice");
+    server_recv (":alice!user@host JOIN #test");
+    ptr_channel = server->channels;
+    CHECK(ptr_channel);
+    lines_count = ptr_channel->buffer->own_lines->lines_count;
+
+    /* message without batch in progress */
+    LONGS_EQUAL(0, irc_batch_add_message (server, ":bob!u@h PRIVMSG #test :hi",
+                                          "PRIVMSG", "#test", "#test :hi"));
+
+    server_recv (":server BATCH +abc chathistory #test");
+    batch = irc_batch_search (server, "abc");
+    CHECK(batch);
+    STRCMP_EQUAL("chathistory", batch->type);
+    STRCMP_EQUAL("#test", batch->parameters);
+
+    /* messages in batch are not displayed now, they are sorted by date */
+    server_recv ("@batch=abc;time=2021-03-01T10:00:02.000Z "
+                 ":bob!user@host PRIVMSG #test :second");
+    server_recv ("@batch=abc;time=2021-03-01T10:00:01.000Z "
+                 ":bob!user@host PRIVMSG #test :first");
+    server_recv ("@batch=abc :bob!user@host PRIVMSG #test :third");
+    server_recv ("@batch=xyz;time=2021-03-01T10:00:00.000Z "
+                 ":bob!user@host PRIVMSG #test :not in batch");
+    LONGS_EQUAL(3, arraylist_size (batch->messages));
+    LONGS_EQUAL(lines_count + 1, ptr_channel->buffer->own_lines->lines_count);
+    lines_count++;
+
+    /* nested batch: messages are moved to parent batch at the end */
+    server_recv ("@batch=abc :server BATCH +def netjoin");
+    batch = irc_batch_search (server, "def");
+    CHECK(batch);
+    STRCMP_EQUAL("abc", batch->parent_ref);
+    server_recv ("@batch=def;time=2021-03-01T09:00:00.000Z "
+                 ":bob!user@host PRIVMSG #test :zero");
+    server_recv (":server BATCH -def");
+    POINTERS_EQUAL(NULL, irc_batch_search (server, "def"));
+    batch = irc_batch_search (server, "abc");
+    CHECK(batch);
+    LONGS_EQUAL(4, arraylist_size (batch->messages));
+
+    /* end of batch: messages are displayed */
+    server_recv (":server BATCH -abc");
+    POINTERS_EQUAL(NULL, server->batches);
+    LONGS_EQUAL(lines_count + 4, ptr_channel->buffer->own_lines->lines_count);
+    LONGS_EQUAL(0, ptr_channel->buffer->batch);
+
+    /* lines are sorted by date in buffer */
+    ptr_line = ptr_channel->buffer->own_lines->last_line;
+    CHECK(ptr_line);
+    STRCMP_EQUAL("third", ptr_line->data->message);
+    ptr_line = ptr_line->prev_line;
+    STRCMP_EQUAL("second", ptr_line->data->message);
+    ptr_line = ptr_line->prev_line;
+    STRCMP_EQUAL("first", ptr_line->data->message);
+
+    /* line older than the join is inserted before it */
+    ptr_line = ptr_channel->buffer->own_lines->first_line;
+    CHECK(ptr_line);
+    STRCMP_EQUAL("zero", ptr_line->data->message);
+}
+
+/*
+ * Tests functions:
+ *   irc_batch_end_expired
+ */
+
+TEST(IrcBatchWithServer, EndExpired)
+{
+    struct t_irc_batch *batch;
+
+    batch = irc_batch_start (server, "ref1", NULL, "test", NULL);
+    CHECK(batch);
+
+    irc_batch_end_expired (server, batch->start_time + 1);
+    POINTERS_EQUAL(batch, server->batches);
+
+    irc_batch_end_expired (server, batch->start_time + IRC_BATCH_TIMEOUT);
+    POINTERS_EQUAL(NULL, server->batches);
+}
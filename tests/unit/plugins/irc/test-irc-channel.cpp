@@ -23,9 +23,15 @@
 
 extern "C"
 {
+#include <stdio.h>
 #include <string.h>
+#include "src/core/wee-hdata.h"
+#include "src/core/hook/wee-hook-hdata.h"
 #include "src/plugins/irc/irc-channel.h"
 #include "src/plugins/irc/irc-server.h"
+
+extern void irc_channel_nick_speaking_free_all (struct t_irc_channel *channel);
+extern void irc_channel_nick_speaking_time_free_all (struct t_irc_channel *channel);
 }
 
 TEST_GROUP(IrcChannel)
@@ -93,3 +99,156 @@ TEST(IrcChannel, IsChannel)
 
     irc_server_free (server);
 }
+
+/*
+ * Tests functions:
+ *   irc_channel_nick_speaking_add
+ *   irc_channel_nick_speaking_rename
+ *   irc_channel_nick_speaking_rename_if_present
+ */
+
+TEST(IrcChannel, NickSpeaking)
+{
+    struct t_irc_channel *channel;
+    struct t_irc_channel_speaking *ptr_nick;
+    struct t_hdata *hdata;
+    char nick[32];
+    int i;
+
+    channel = (struct t_irc_channel *)calloc (1, sizeof (*channel));
+    CHECK(channel);
+
+    irc_channel_nick_speaking_add (NULL, channel, "alice", 0);
+    irc_channel_nick_speaking_add (NULL, channel, "bob", 1);
+    irc_channel_nick_speaking_add (NULL, channel, "carol", 0);
+    LONGS_EQUAL(3, channel->nicks_speaking_count[0]);
+    LONGS_EQUAL(1, channel->nicks_speaking_count[1]);
+    STRCMP_EQUAL("alice", channel->nicks_speaking[0]->nick);
+    STRCMP_EQUAL("carol", channel->last_nick_speaking[0]->nick);
+    STRCMP_EQUAL("bob", channel->nicks_speaking[1]->nick);
+
+    /* nick speaking again (case insensitive) is moved at the end */
+    irc_channel_nick_speaking_add (NULL, channel, "ALICE", 0);
+    LONGS_EQUAL(3, channel->nicks_speaking_count[0]);
+    STRCMP_EQUAL("bob", channel->nicks_speaking[0]->nick);
+    STRCMP_EQUAL("ALICE", channel->last_nick_speaking[0]->nick);
+    STRCMP_EQUAL("alice", channel->last_nick_speaking[0]->nick_lower);
+
+    /* rename */
+    irc_channel_nick_speaking_rename (NULL, channel, "bob", "bob2");
+    STRCMP_EQUAL("bob2", channel->nicks_speaking[0]->nick);
+    STRCMP_EQUAL("bob2", channel->nicks_speaking[1]->nick);
+    irc_channel_nick_speaking_rename_if_present (NULL, channel, "BOB2");
+    STRCMP_EQUAL("BOB2", channel->nicks_speaking[0]->nick);
+
+    /* rename to a nick already in list: the old entry is removed */
+    irc_channel_nick_speaking_rename (NULL, channel, "carol", "alice");
+    LONGS_EQUAL(2, channel->nicks_speaking_count[0]);
+    STRCMP_EQUAL("BOB2", channel->nicks_speaking[0]->nick);
+    STRCMP_EQUAL("alice", channel->last_nick_speaking[0]->nick);
+
+    /* hdata */
+    hdata = hook_hdata_get (NULL, "irc_channel");
+    CHECK(hdata);
+    POINTERS_EQUAL(channel->nicks_speaking[0],
+                   hdata_pointer (hdata, channel, "nicks_speaking"));
+    POINTERS_EQUAL(channel->last_nick_speaking[0],
+                   hdata_pointer (hdata, channel, "last_nick_speaking"));
+    LONGS_EQUAL(2, hdata_integer (hdata, channel, "0|nicks_speaking_count"));
+    LONGS_EQUAL(1, hdata_integer (hdata, channel, "1|nicks_speaking_count"));
+    POINTERS_EQUAL(channel->nicks_speaking_hashtable[0],
+                   hdata_hashtable (hdata, channel, "nicks_speaking_hashtable"));
+
+    /* list is limited, oldest nicks are removed */
+    for (i = 0; i < IRC_CHANNEL_NICKS_SPEAKING_LIMIT + 10; i++)
+    {
+        snprintf (nick, sizeof (nick), "nick%d", i);
+        irc_channel_nick_speaking_add (NULL, channel, nick, 0);
+    }
+    LONGS_EQUAL(IRC_CHANNEL_NICKS_SPEAKING_LIMIT,
+                channel->nicks_speaking_count[0]);
+    STRCMP_EQUAL("nick10", channel->nicks_speaking[0]->nick);
+    snprintf (nick, sizeof (nick), "nick%d",
+              IRC_CHANNEL_NICKS_SPEAKING_LIMIT + 9);
+    STRCMP_EQUAL(nick, channel->last_nick_speaking[0]->nick);
+    i = 0;
+    for (ptr_nick = channel->nicks_speaking[0]; ptr_nick;
+         ptr_nick = ptr_nick->next_nick)
+    {
+        i++;
+    }
+    LONGS_EQUAL(IRC_CHANNEL_NICKS_SPEAKING_LIMIT, i);
+
+    irc_channel_nick_speaking_free_all (channel);
+    POINTERS_EQUAL(NULL, channel->nicks_speaking[0]);
+    POINTERS_EQUAL(NULL, channel->last_nick_speaking[0]);
+    POINTERS_EQUAL(NULL, channel->nicks_speaking_hashtable[0]);
+    free (channel);
+}
+
+/*
+ * Tests functions:
+ *   irc_channel_nick_speaking_time_add
+ *   irc_channel_nick_speaking_time_search
+ *   irc_channel_nick_speaking_time_rename
+ *   irc_channel_nick_speaking_time_remove_old
+ */
+
+TEST(IrcChannel, NickSpeakingTime)
+{
+    struct t_irc_channel *channel;
+    struct t_irc_channel_speaking *ptr_nick;
+    time_t now;
+
+    channel = (struct t_irc_channel *)calloc (1, sizeof (*channel));
+    CHECK(channel);
+
+    now = time (NULL);
+
+    POINTERS_EQUAL(NULL,
+                   irc_channel_nick_speaking_time_search (NULL, channel,
+                                                          "alice", 0));
+
+    irc_channel_nick_speaking_time_add (NULL, channel, "alice", now - 7200);
+    irc_channel_nick_speaking_time_add (NULL, channel, "bob", now);
+    STRCMP_EQUAL("bob", channel->nicks_speaking_time->nick);
+    STRCMP_EQUAL("alice", channel->last_nick_speaking_time->nick);
+
+    ptr_nick = irc_channel_nick_speaking_time_search (NULL, channel,
+                                                      "ALICE", 0);
+    CHECK(ptr_nick);
+    STRCMP_EQUAL("alice", ptr_nick->nick);
+
+    /* too old */
+    POINTERS_EQUAL(NULL,
+                   irc_channel_nick_speaking_time_search (NULL, channel,
+                                                          "alice", 1));
+    CHECK(irc_channel_nick_speaking_time_search (NULL, channel, "bob", 1));
+
+    /* rename */
+    irc_channel_nick_speaking_time_rename (NULL, channel, "bob", "bob2");
+    POINTERS_EQUAL(NULL,
+                   irc_channel_nick_speaking_time_search (NULL, channel,
+                                                          "bob", 0));
+    CHECK(irc_channel_nick_speaking_time_search (NULL, channel, "bob2", 0));
+
+    /* speaking again: nick moved at beginning */
+    irc_channel_nick_speaking_time_add (NULL, channel, "alice", now);
+    STRCMP_EQUAL("alice", channel->nicks_speaking_time->nick);
+    STRCMP_EQUAL("bob2", channel->last_nick_speaking_time->nick);
+
+    /* remove old nicks */
+    channel->last_nick_speaking_time->time_last_message = now - 7200;
+    irc_channel_nick_speaking_time_remove_old (channel);
+    POINTERS_EQUAL(NULL,
+                   irc_channel_nick_speaking_time_search (NULL, channel,
+                                                          "bob2", 0));
+    STRCMP_EQUAL("alice", channel->nicks_speaking_time->nick);
+    POINTERS_EQUAL(channel->nicks_speaking_time,
+                   channel->last_nick_speaking_time);
+
+    irc_channel_nick_speaking_time_free_all (channel);
+    POINTERS_EQUAL(NULL, channel->nicks_speaking_time);
+    POINTERS_EQUAL(NULL, channel->last_nick_speaking_time);
+    free (channel);
+}
@@ -214,3 +214,96 @@ TEST(IrcIgnore, CheckHost)
     irc_ignore_free_all ();
     irc_server_free (server);
 }
+
+/*
+ * Tests functions:
+ *   irc_ignore_mask_can_be_combined
+ */
+
+TEST(IrcIgnore, MaskCanBeCombined)
+{
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined (NULL));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined (""));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("(?-i)^nick$"));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("(a)\\1"));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("a)"));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("(a"));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("[a"));
+    LONGS_EQUAL(0, irc_ignore_mask_can_be_combined ("a\\"));
+
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("^nick$"));
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("^(nick1|nick2)$"));
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("^user\\.name@host$"));
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("[)(]"));
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("[])]"));
+    LONGS_EQUAL(1, irc_ignore_mask_can_be_combined ("\\(a"));
+}
+
+/*
+ * Tests functions:
+ *   irc_ignore_check
+ */
+
+TEST(IrcIgnore, Check)
+{
+    struct t_irc_server *server;
+
+    server = irc_server_alloc ("test_ignore");
+    CHECK(server);
+
+    LONGS_EQUAL(0, irc_ignore_check (NULL, "#test", "nick", "nick!u@h"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick", "nick!u@h"));
+
+    irc_ignore_new ("^nick1$", NULL, NULL);
+    irc_ignore_new ("^user2@host2$", "TEST_ignore", NULL);
+    irc_ignore_new ("^nick3!user3@host3$", NULL, "#Chan3");
+    irc_ignore_new ("(?-i)^Nick4$", NULL, "nick4");
+    irc_ignore_new ("^nick6$", "other", NULL);
+    irc_ignore_new ("^nick7$", NULL, "#\xc3\x89t\xc3\xa9");
+
+    /* ignore on any server/channel */
+    LONGS_EQUAL(1, irc_ignore_check (server, "#test", "nick1", "nick1!u@h"));
+    LONGS_EQUAL(1, irc_ignore_check (server, "#test", "NICK1", "NICK1!u@h"));
+    LONGS_EQUAL(1, irc_ignore_check (server, NULL, "nick1", "nick1!u@h"));
+    LONGS_EQUAL(1, irc_ignore_check (server, "nick1", "nick1", "nick1!u@h"));
+
+    /* ignore on a server (mask without "!") */
+    LONGS_EQUAL(1, irc_ignore_check (server, "#test", "nick2",
+                                     "nick2!user2@host2"));
+    LONGS_EQUAL(1, irc_ignore_check (server, NULL, "nick2",
+                                     "nick2!user2@host2"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick2",
+                                     "nick2!user2@other"));
+
+    /* ignore on a channel */
+    LONGS_EQUAL(1, irc_ignore_check (server, "#chan3", "nick3",
+                                     "nick3!user3@host3"));
+    LONGS_EQUAL(1, irc_ignore_check (server, NULL, "nick3",
+                                     "nick3!user3@host3"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick3",
+                                     "nick3!user3@host3"));
+
+    /* ignore on a private buffer, with a case sensitive mask */
+    LONGS_EQUAL(1, irc_ignore_check (server, "Nick4", "Nick4", "Nick4!u@h"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "nick4", "nick4", "nick4!u@h"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "Nick4", "Nick4!u@h"));
+
+    /* ignore on another server */
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick6", "nick6!u@h"));
+
+    /* ignore on a channel with non-ASCII chars */
+    LONGS_EQUAL(1, irc_ignore_check (server, "#\xc3\x89t\xc3\xa9", "nick7",
+                                     "nick7!u@h"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick7", "nick7!u@h"));
+
+    /* verdict is cached, and cache is cleared when ignores are changed */
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick8", "nick8!u@h"));
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick8", "nick8!u@h"));
+    irc_ignore_new ("^nick8$", NULL, NULL);
+    LONGS_EQUAL(1, irc_ignore_check (server, "#test", "nick8", "nick8!u@h"));
+    irc_ignore_free (last_irc_ignore);
+    LONGS_EQUAL(0, irc_ignore_check (server, "#test", "nick8", "nick8!u@h"));
+
+    irc_ignore_free_all ();
+    irc_server_free (server);
+}
@@ -0,0 +1,202 @@
+/*
+ * test-irc-modelist.cpp - test IRC channel mode list functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "src/core/wee-hashtable.h"
+#include "src/plugins/irc/irc-channel.h"
+#include "src/plugins/irc/irc-modelist.h"
+}
+
+TEST_GROUP(IrcModelist)
+{
+    struct t_irc_channel channel;
+    struct t_irc_modelist *modelist;
+
+    void setup ()
+    {
+        memset (&channel, 0, sizeof (channel));
+        modelist = irc_modelist_new (&channel, 'b');
+    }
+
+    void teardown ()
+    {
+        irc_modelist_free_all (&channel);
+        modelist = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_modelist_new
+ *   irc_modelist_search
+ *   irc_modelist_valid
+ *   irc_modelist_free
+ */
+
+TEST(IrcModelist, NewSearchFree)
+{
+    struct t_irc_modelist *modelist_q;
+
+    CHECK(modelist);
+    LONGS_EQUAL('b', modelist->type);
+    LONGS_EQUAL(IRC_MODELIST_STATE_EMPTY, modelist->state);
+    LONGS_EQUAL(0, modelist->items_count);
+    POINTERS_EQUAL(NULL, modelist->items_by_number);
+    POINTERS_EQUAL(NULL, modelist->masks);
+
+    modelist_q = irc_modelist_new (&channel, 'q');
+    CHECK(modelist_q);
+
+    POINTERS_EQUAL(NULL, irc_modelist_search (NULL, 'b'));
+    POINTERS_EQUAL(modelist, irc_modelist_search (&channel, 'b'));
+    POINTERS_EQUAL(modelist_q, irc_modelist_search (&channel, 'q'));
+    POINTERS_EQUAL(NULL, irc_modelist_search (&channel, 'e'));
+
+    LONGS_EQUAL(1, irc_modelist_valid (&channel, modelist_q));
+    irc_modelist_free (&channel, modelist_q);
+    LONGS_EQUAL(0, irc_modelist_valid (&channel, modelist_q));
+    POINTERS_EQUAL(modelist, channel.last_modelist);
+}
+
+/*
+ * Tests functions:
+ *   irc_modelist_item_new
+ *   irc_modelist_item_search_mask
+ *   irc_modelist_item_search_number
+ *   irc_modelist_item_build_index
+ *   irc_modelist_item_free
+ *   irc_modelist_item_free_all
+ */
+
+TEST(IrcModelist, Items)
+{
+    struct t_irc_modelist_item *item1, *item2, *item3, *item4;
+
+    POINTERS_EQUAL(NULL, irc_modelist_item_new (modelist, NULL, NULL, 0));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (NULL, "a!*@*"));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (modelist, NULL));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (NULL, 0));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 0));
+
+    item1 = irc_modelist_item_new (modelist, "a!*@*", "alice", 1000);
+    item2 = irc_modelist_item_new (modelist, "b!*@*", NULL, 0);
+    item3 = irc_modelist_item_new (modelist, "c!*@*", NULL, 0);
+    CHECK(item1);
+    CHECK(item2);
+    CHECK(item3);
+    LONGS_EQUAL(3, modelist->items_count);
+    LONGS_EQUAL(IRC_MODELIST_STATE_MODIFIED, modelist->state);
+    LONGS_EQUAL(0, item1->number);
+    LONGS_EQUAL(1, item2->number);
+    LONGS_EQUAL(2, item3->number);
+
+    /* search by number */
+    POINTERS_EQUAL(item1, irc_modelist_item_search_number (modelist, 0));
+    POINTERS_EQUAL(item2, irc_modelist_item_search_number (modelist, 1));
+    POINTERS_EQUAL(item3, irc_modelist_item_search_number (modelist, 2));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, -1));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 3));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 100000));
+
+    /* search by mask (index is built on first search) */
+    POINTERS_EQUAL(NULL, modelist->masks);
+    POINTERS_EQUAL(item2, irc_modelist_item_search_mask (modelist, "b!*@*"));
+    CHECK(modelist->masks);
+    LONGS_EQUAL(3, modelist->masks->items_count);
+    POINTERS_EQUAL(item1, irc_modelist_item_search_mask (modelist, "a!*@*"));
+    POINTERS_EQUAL(item3, irc_modelist_item_search_mask (modelist, "c!*@*"));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (modelist, "C!*@*"));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (modelist, "d!*@*"));
+
+    /* numbers are kept after an item is removed */
+    irc_modelist_item_free (modelist, item2);
+    LONGS_EQUAL(2, modelist->items_count);
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 1));
+    POINTERS_EQUAL(item3, irc_modelist_item_search_number (modelist, 2));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (modelist, "b!*@*"));
+
+    /* duplicated mask: first item is found, then the other one */
+    item4 = irc_modelist_item_new (modelist, "a!*@*", NULL, 0);
+    CHECK(item4);
+    LONGS_EQUAL(3, item4->number);
+    LONGS_EQUAL(1, modelist->masks_duplicated);
+    POINTERS_EQUAL(item1, irc_modelist_item_search_mask (modelist, "a!*@*"));
+    irc_modelist_item_free (modelist, item1);
+    LONGS_EQUAL(0, modelist->masks_duplicated);
+    POINTERS_EQUAL(item4, irc_modelist_item_search_mask (modelist, "a!*@*"));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 0));
+    POINTERS_EQUAL(item4, irc_modelist_item_search_number (modelist, 3));
+
+    irc_modelist_item_free_all (modelist);
+    LONGS_EQUAL(IRC_MODELIST_STATE_EMPTY, modelist->state);
+    LONGS_EQUAL(0, modelist->items_count);
+    POINTERS_EQUAL(NULL, modelist->items);
+    POINTERS_EQUAL(NULL, modelist->items_by_number);
+    POINTERS_EQUAL(NULL, modelist->masks);
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 3));
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_mask (modelist, "a!*@*"));
+}
+
+/*
+ * Tests functions:
+ *   irc_modelist_item_new (list received: bulk load)
+ *   irc_modelist_item_search_mask
+ *   irc_modelist_item_search_number
+ */
+
+TEST(IrcModelist, BulkLoad)
+{
+    struct t_irc_modelist_item *ptr_item;
+    char mask[64];
+    int i;
+
+    modelist->state = IRC_MODELIST_STATE_RECEIVING;
+    for (i = 0; i < 5000; i++)
+    {
+        snprintf (mask, sizeof (mask), "nick%d!*@*", i);
+        CHECK(irc_modelist_item_new (modelist, mask, NULL, 0));
+    }
+    LONGS_EQUAL(5000, modelist->items_count);
+    CHECK(modelist->items_by_number_size >= 5000);
+
+    /* masks are not indexed while the list is received */
+    POINTERS_EQUAL(modelist->items->next_item,
+                   irc_modelist_item_search_mask (modelist, "nick1!*@*"));
+    POINTERS_EQUAL(NULL, modelist->masks);
+
+    /* end of list: index is built on first search */
+    modelist->state = IRC_MODELIST_STATE_RECEIVED;
+    ptr_item = irc_modelist_item_search_mask (modelist, "nick4321!*@*");
+    CHECK(ptr_item);
+    LONGS_EQUAL(4321, ptr_item->number);
+    CHECK(modelist->masks);
+    LONGS_EQUAL(5000, modelist->masks->items_count);
+    CHECK(modelist->masks->size >= 5000);
+
+    POINTERS_EQUAL(ptr_item, irc_modelist_item_search_number (modelist, 4321));
+    POINTERS_EQUAL(modelist->last_item,
+                   irc_modelist_item_search_number (modelist, 4999));
+}
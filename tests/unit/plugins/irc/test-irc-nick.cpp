@@ -23,6 +23,8 @@
 
 extern "C"
 {
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "src/plugins/irc/irc-nick.h"
 #include "src/plugins/irc/irc-server.h"
@@ -172,3 +174,63 @@ TEST(IrcNick, IsNick)
 
     irc_server_free (server);
 }
+
+/*
+ * Tests functions:
+ *   irc_nick_find_color_cached
+ *   irc_nick_color_cache_flush
+ */
+
+TEST(IrcNick, FindColorCached)
+{
+    const char *ptr_color;
+    char *color, nickname[32];
+    int i;
+
+    irc_nick_color_cache_flush ();
+    LONGS_EQUAL(0, irc_nick_color_cache_count);
+
+    POINTERS_EQUAL(NULL, irc_nick_find_color_cached (NULL));
+    LONGS_EQUAL(0, irc_nick_color_cache_count);
+
+    /* nick added in cache */
+    color = irc_nick_find_color ("alice");
+    ptr_color = irc_nick_find_color_cached ("alice");
+    STRCMP_EQUAL(color, ptr_color);
+    free (color);
+    LONGS_EQUAL(1, irc_nick_color_cache_count);
+    STRCMP_EQUAL("alice", irc_nick_color_cache[0].nickname);
+
+    /* nick found in cache */
+    POINTERS_EQUAL(ptr_color, irc_nick_find_color_cached ("alice"));
+    LONGS_EQUAL(1, irc_nick_color_cache_count);
+
+    /* most recently used nick is first */
+    irc_nick_find_color_cached ("bob");
+    LONGS_EQUAL(2, irc_nick_color_cache_count);
+    STRCMP_EQUAL("bob", irc_nick_color_cache[0].nickname);
+    STRCMP_EQUAL("alice", irc_nick_color_cache[1].nickname);
+    POINTERS_EQUAL(ptr_color, irc_nick_find_color_cached ("alice"));
+    STRCMP_EQUAL("alice", irc_nick_color_cache[0].nickname);
+    STRCMP_EQUAL("bob", irc_nick_color_cache[1].nickname);
+
+    /* cache full: least recently used nick ("bob") is removed */
+    for (i = 0; i < IRC_NICK_COLOR_CACHE_SIZE - 2; i++)
+    {
+        snprintf (nickname, sizeof (nickname), "nick%d", i);
+        irc_nick_find_color_cached (nickname);
+    }
+    LONGS_EQUAL(IRC_NICK_COLOR_CACHE_SIZE, irc_nick_color_cache_count);
+    irc_nick_find_color_cached ("alice");
+    irc_nick_find_color_cached ("carol");
+    LONGS_EQUAL(IRC_NICK_COLOR_CACHE_SIZE, irc_nick_color_cache_count);
+    STRCMP_EQUAL("carol", irc_nick_color_cache[0].nickname);
+    STRCMP_EQUAL("alice", irc_nick_color_cache[1].nickname);
+    for (i = 0; i < IRC_NICK_COLOR_CACHE_SIZE; i++)
+    {
+        CHECK(strcmp (irc_nick_color_cache[i].nickname, "bob") != 0);
+    }
+
+    irc_nick_color_cache_flush ();
+    LONGS_EQUAL(0, irc_nick_color_cache_count);
+}
@@ -24,6 +24,7 @@
 extern "C"
 {
 #include <stdio.h>
+#include <string.h>
 #include "src/core/wee-config-file.h"
 #include "src/core/wee-hashtable.h"
 #include "src/core/wee-hook.h"
@@ -42,7 +43,6 @@ extern const char *irc_protocol_nick_address (struct t_irc_server *server,
                                               struct t_irc_nick *nick,
                                               const char *nickname,
                                               const char *address);
-extern struct t_hashtable *irc_protocol_get_message_tags (const char *tags);
 }
 
 #include "tests/tests.h"
@@ -160,35 +160,84 @@ TEST(IrcProtocol, Tags)
 
 /*
  * Tests functions:
- *   irc_protocol_get_message_tags
+ *   irc_protocol_tags_split
+ *   irc_protocol_tags_search
  */
 
-TEST(IrcProtocol, GetMessageTags)
+TEST(IrcProtocol, TagsSplit)
 {
-    struct t_hashtable *hashtable;
+    struct t_irc_protocol_tag tags[4];
+    const struct t_irc_protocol_tag *ptr_tag;
+    const char *str_tags = "aaa=bbb;ccc;;example.com/ddd=eee;aaa=fff";
 
-    POINTERS_EQUAL(NULL, irc_protocol_get_message_tags (NULL));
-    POINTERS_EQUAL(NULL, irc_protocol_get_message_tags (""));
+    LONGS_EQUAL(0, irc_protocol_tags_split (NULL, -1, tags, 4));
+    LONGS_EQUAL(0, irc_protocol_tags_split ("", -1, tags, 4));
+    LONGS_EQUAL(0, irc_protocol_tags_split (";;", -1, tags, 4));
 
-    hashtable = irc_protocol_get_message_tags ("abc");
-    CHECK(hashtable);
-    LONGS_EQUAL(1, hashtable->items_count);
-    POINTERS_EQUAL(NULL, (const char *)hashtable_get (hashtable, "abc"));
-    hashtable_free (hashtable);
+    /* count tags only */
+    LONGS_EQUAL(4, irc_protocol_tags_split (str_tags, -1, NULL, 0));
 
-    hashtable = irc_protocol_get_message_tags ("abc=def");
-    CHECK(hashtable);
-    LONGS_EQUAL(1, hashtable->items_count);
-    STRCMP_EQUAL("def", (const char *)hashtable_get (hashtable, "abc"));
-    hashtable_free (hashtable);
+    /* length is given: only "aaa=bbb;ccc" is parsed */
+    LONGS_EQUAL(2, irc_protocol_tags_split (str_tags, 11, tags, 4));
+    LONGS_EQUAL(3, tags[1].key_size);
+    CHECK(strncmp (tags[1].key, "ccc", 3) == 0);
+    POINTERS_EQUAL(NULL, tags[1].value);
 
-    hashtable = irc_protocol_get_message_tags ("aaa=bbb;ccc;example.com/ddd=eee");
-    CHECK(hashtable);
-    LONGS_EQUAL(3, hashtable->items_count);
-    STRCMP_EQUAL("bbb", (const char *)hashtable_get (hashtable, "aaa"));
-    POINTERS_EQUAL(NULL, (const char *)hashtable_get (hashtable, "ccc"));
-    STRCMP_EQUAL("eee", (const char *)hashtable_get (hashtable, "example.com/ddd"));
-    hashtable_free (hashtable);
+    /* more tags than the max: all tags are counted */
+    LONGS_EQUAL(4, irc_protocol_tags_split (str_tags, -1, tags, 2));
+
+    LONGS_EQUAL(4, irc_protocol_tags_split (str_tags, -1, tags, 4));
+    POINTERS_EQUAL(str_tags, tags[0].key);
+    LONGS_EQUAL(3, tags[0].key_size);
+    POINTERS_EQUAL(str_tags + 4, tags[0].value);
+    LONGS_EQUAL(3, tags[0].value_size);
+    LONGS_EQUAL(15, tags[2].key_size);
+    CHECK(strncmp (tags[2].key, "example.com/ddd", 15) == 0);
+    CHECK(strncmp (tags[2].value, "eee", 3) == 0);
+
+    POINTERS_EQUAL(NULL, irc_protocol_tags_search (NULL, 0, "aaa"));
+    POINTERS_EQUAL(NULL, irc_protocol_tags_search (tags, 4, NULL));
+    POINTERS_EQUAL(NULL, irc_protocol_tags_search (tags, 4, "aa"));
+    POINTERS_EQUAL(NULL, irc_protocol_tags_search (tags, 4, "example.com"));
+    POINTERS_EQUAL(&tags[1], irc_protocol_tags_search (tags, 4, "ccc"));
+    POINTERS_EQUAL(&tags[2], irc_protocol_tags_search (tags, 4,
+                                                       "example.com/ddd"));
+
+    /* last tag is returned if the key is there many times */
+    ptr_tag = irc_protocol_tags_search (tags, 4, "aaa");
+    POINTERS_EQUAL(&tags[3], ptr_tag);
+    CHECK(strncmp (ptr_tag->value, "fff", 3) == 0);
+}
+
+/*
+ * Tests functions:
+ *   irc_protocol_tag_value_unescape
+ */
+
+TEST(IrcProtocol, TagValueUnescape)
+{
+    struct t_irc_protocol_tag tag;
+    char *str;
+
+    POINTERS_EQUAL(NULL, irc_protocol_tag_value_unescape (NULL));
+
+    tag.key = "abc";
+    tag.key_size = 3;
+    tag.value = NULL;
+    tag.value_size = 0;
+    POINTERS_EQUAL(NULL, irc_protocol_tag_value_unescape (&tag));
+
+    tag.value = "";
+    WEE_TEST_STR("", irc_protocol_tag_value_unescape (&tag));
+
+    tag.value = "a\\\\b\\:c\\sd\\re\\nf\\xg;ignored";
+    tag.value_size = 19;
+    WEE_TEST_STR("a\\b;c d\re\nfxg", irc_protocol_tag_value_unescape (&tag));
+
+    /* trailing backslash is removed */
+    tag.value = "abc\\";
+    tag.value_size = 4;
+    WEE_TEST_STR("abc", irc_protocol_tag_value_unescape (&tag));
 }
 
 /*
@@ -217,6 +266,60 @@ TEST(IrcProtocol, ParseTime)
     /* valid time as timestamp */
     LONGS_EQUAL(1547386699, irc_protocol_parse_time ("1547386699.123"));
     LONGS_EQUAL(1547386699, irc_protocol_parse_time ("1547386699"));
+
+    /* time zone */
+    LONGS_EQUAL(1547386699, irc_protocol_parse_time ("2019-01-13T15:38:19+02:00"));
+    LONGS_EQUAL(1547386699, irc_protocol_parse_time ("2019-01-13T11:08:19-0230"));
+    LONGS_EQUAL(1547386699, irc_protocol_parse_time ("2019-01-13T14:38:19.5+01"));
+
+    /* invalid dates */
+    LONGS_EQUAL(0, irc_protocol_parse_time ("2019-13-13T13:38:19Z"));
+    LONGS_EQUAL(0, irc_protocol_parse_time ("2019-01-13T25:38:19Z"));
+    LONGS_EQUAL(0, irc_protocol_parse_time ("19-01-13T13:38:19Z"));
+}
+
+/*
+ * Tests functions:
+ *   irc_protocol_parse_time_tv
+ */
+
+TEST(IrcProtocol, ParseTimeTv)
+{
+    struct timeval tv;
+
+    LONGS_EQUAL(0, irc_protocol_parse_time_tv (NULL, -1, &tv));
+    LONGS_EQUAL(0, irc_protocol_parse_time_tv ("", -1, &tv));
+    LONGS_EQUAL(0, irc_protocol_parse_time_tv ("2019-01-13T13:38:19Z", 0, &tv));
+    LONGS_EQUAL(0, irc_protocol_parse_time_tv ("2019-01-13T13:38:19Z", 16, &tv));
+    LONGS_EQUAL(0, irc_protocol_parse_time_tv ("1547386699x", -1, &tv));
+
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("2019-01-13T13:38:19.123Z",
+                                               -1, &tv));
+    LONGS_EQUAL(1547386699, tv.tv_sec);
+    LONGS_EQUAL(123000, tv.tv_usec);
+
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("2019-01-13T13:38:19.1234567Z",
+                                               -1, &tv));
+    LONGS_EQUAL(1547386699, tv.tv_sec);
+    LONGS_EQUAL(123456, tv.tv_usec);
+
+    /* length is given: time is followed by other tags */
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("2019-01-13T13:38:19.5Z;a=b",
+                                               22, &tv));
+    LONGS_EQUAL(1547386699, tv.tv_sec);
+    LONGS_EQUAL(500000, tv.tv_usec);
+
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("1547386699.042", -1, &tv));
+    LONGS_EQUAL(1547386699, tv.tv_sec);
+    LONGS_EQUAL(42000, tv.tv_usec);
+
+    /* leap years */
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("2020-02-29T00:00:00Z",
+                                               -1, &tv));
+    LONGS_EQUAL(1582934400, tv.tv_sec);
+    LONGS_EQUAL(1, irc_protocol_parse_time_tv ("2000-03-01T00:00:00Z",
+                                               -1, &tv));
+    LONGS_EQUAL(951868800, tv.tv_sec);
 }
 
 TEST_GROUP(IrcProtocolWithServer)
@@ -1378,6 +1481,49 @@ TEST(IrcProtocolWithServer, 005_multiple_messages)
     STRCMP_EQUAL(" PREFIX=(ohv)@%+ HOSTLEN=24", ptr_server->isupport);
 }
 
+/*
+ * Tests functions:
+ *   irc_protocol_cb_005 (casemapping changed: rebuild of hashtables)
+ */
+
+TEST(IrcProtocolWithServer, 005_casemapping)
+{
+    struct t_irc_channel *ptr_channel;
+    struct t_irc_nick *ptr_nick;
+
+    server_recv (":server 001 alice");
+    server_recv (":alice!user@host JOIN #Test[1]");
+    server_recv (":bob[2]!user@host JOIN #Test[1]");
+
+    ptr_channel = ptr_server->channels;
+    CHECK(ptr_channel);
+    ptr_nick = ptr_channel->last_nick;
+    CHECK(ptr_nick);
+    STRCMP_EQUAL("bob[2]", ptr_nick->name);
+
+    /* default casemapping: rfc1459 */
+    POINTERS_EQUAL(ptr_channel, irc_channel_search (ptr_server, "#Test[1]"));
+    POINTERS_EQUAL(ptr_channel, irc_channel_search (ptr_server, "#TEST{1}"));
+    POINTERS_EQUAL(ptr_nick, irc_nick_search (ptr_server, ptr_channel, "BOB{2}"));
+
+    server_recv (":server 005 alice CASEMAPPING=ascii :are supported");
+    LONGS_EQUAL(IRC_SERVER_CASEMAPPING_ASCII, ptr_server->casemapping);
+
+    POINTERS_EQUAL(ptr_channel, irc_channel_search (ptr_server, "#TEST[1]"));
+    POINTERS_EQUAL(NULL, irc_channel_search (ptr_server, "#TEST{1}"));
+    POINTERS_EQUAL(ptr_nick, irc_nick_search (ptr_server, ptr_channel, "BOB[2]"));
+    POINTERS_EQUAL(NULL, irc_nick_search (ptr_server, ptr_channel, "BOB{2}"));
+
+    /* nick changed */
+    server_recv (":bob[2]!user@host NICK :Carol");
+    POINTERS_EQUAL(NULL, irc_nick_search (ptr_server, ptr_channel, "bob[2]"));
+    POINTERS_EQUAL(ptr_nick, irc_nick_search (ptr_server, ptr_channel, "carol"));
+
+    /* nick removed */
+    server_recv (":carol!user@host PART #test[1]");
+    POINTERS_EQUAL(NULL, irc_nick_search (ptr_server, ptr_channel, "carol"));
+}
+
 /*
  * Tests functions:
  *   irc_protocol_cb_008 (server notice mask)
@@ -0,0 +1,149 @@
+/*
+ * test-irc-raw.cpp - test IRC raw functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <string.h>
+#include "src/core/wee-config-file.h"
+#include "src/plugins/irc/irc-config.h"
+#include "src/plugins/irc/irc-raw.h"
+}
+
+TEST_GROUP(IrcRaw)
+{
+    void teardown ()
+    {
+        config_file_option_reset (irc_config_look_raw_messages, 1);
+        config_file_option_reset (irc_config_look_raw_messages_size, 1);
+        irc_raw_message_free_all ();
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_raw_message_add_to_list
+ *   irc_raw_message_get
+ */
+
+TEST(IrcRaw, AddToList)
+{
+    struct t_irc_raw_message *ptr_raw_message;
+    char message[8192];
+
+    irc_raw_message_free_all ();
+    config_file_option_set (irc_config_look_raw_messages, "3", 1);
+
+    POINTERS_EQUAL(NULL, irc_raw_message_add_to_list (0, NULL, 0, NULL));
+    POINTERS_EQUAL(NULL, irc_raw_message_get (-1));
+    POINTERS_EQUAL(NULL, irc_raw_message_get (0));
+
+    /* max number of messages */
+    ptr_raw_message = irc_raw_message_add_to_list (1, NULL,
+                                                   IRC_RAW_FLAG_RECV, "msg1");
+    CHECK(ptr_raw_message);
+    LONGS_EQUAL(1, ptr_raw_message->date);
+    LONGS_EQUAL(IRC_RAW_FLAG_RECV, ptr_raw_message->flags);
+    STRCMP_EQUAL("msg1", ptr_raw_message->message);
+    irc_raw_message_add_to_list (2, NULL, IRC_RAW_FLAG_SEND, "msg2");
+    irc_raw_message_add_to_list (3, NULL, IRC_RAW_FLAG_RECV, "msg3");
+    LONGS_EQUAL(3, irc_raw_messages_count);
+    irc_raw_message_add_to_list (4, NULL, IRC_RAW_FLAG_SEND, "msg4");
+    LONGS_EQUAL(3, irc_raw_messages_count);
+    STRCMP_EQUAL("msg2", irc_raw_message_get (0)->message);
+    LONGS_EQUAL(2, irc_raw_message_get (0)->date);
+    STRCMP_EQUAL("msg3", irc_raw_message_get (1)->message);
+    STRCMP_EQUAL("msg4", irc_raw_message_get (2)->message);
+    POINTERS_EQUAL(NULL, irc_raw_message_get (3));
+
+    /* max size of messages */
+    irc_raw_message_free_all ();
+    config_file_option_set (irc_config_look_raw_messages, "100", 1);
+    config_file_option_set (irc_config_look_raw_messages_size, "16384", 1);
+    memset (message, 'a', 8000);
+    message[8000] = '\0';
+    irc_raw_message_add_to_list (1, NULL, IRC_RAW_FLAG_RECV, message);
+    message[0] = 'b';
+    irc_raw_message_add_to_list (2, NULL, IRC_RAW_FLAG_RECV, message);
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    message[0] = 'c';
+    irc_raw_message_add_to_list (3, NULL, IRC_RAW_FLAG_RECV, message);
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    LONGS_EQUAL('b', irc_raw_message_get (0)->message[0]);
+    LONGS_EQUAL(8001, irc_raw_message_get (0)->offset);
+    LONGS_EQUAL('c', irc_raw_message_get (1)->message[0]);
+    LONGS_EQUAL(0, irc_raw_message_get (1)->offset);
+    LONGS_EQUAL(8000, strlen (irc_raw_message_get (1)->message));
+
+    /* small message stored after the newest message */
+    irc_raw_message_add_to_list (4, NULL, IRC_RAW_FLAG_RECV, "test");
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    LONGS_EQUAL('c', irc_raw_message_get (0)->message[0]);
+    STRCMP_EQUAL("test", irc_raw_message_get (1)->message);
+    LONGS_EQUAL(8001, irc_raw_message_get (1)->offset);
+}
+
+/*
+ * Tests functions:
+ *   irc_raw_message_resize
+ */
+
+TEST(IrcRaw, Resize)
+{
+    irc_raw_message_free_all ();
+    irc_raw_message_add_to_list (1, NULL, IRC_RAW_FLAG_RECV, "msg1");
+    irc_raw_message_add_to_list (2, NULL, IRC_RAW_FLAG_RECV, "msg2");
+    irc_raw_message_add_to_list (3, NULL, IRC_RAW_FLAG_RECV, "msg3");
+    LONGS_EQUAL(3, irc_raw_messages_count);
+
+    /* the newest messages are kept */
+    config_file_option_set (irc_config_look_raw_messages, "2", 1);
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    STRCMP_EQUAL("msg2", irc_raw_message_get (0)->message);
+    STRCMP_EQUAL("msg3", irc_raw_message_get (1)->message);
+
+    /* no messages kept in memory */
+    config_file_option_set (irc_config_look_raw_messages, "0", 1);
+    LONGS_EQUAL(0, irc_raw_messages_count);
+    POINTERS_EQUAL(NULL, irc_raw_message_add_to_list (4, NULL,
+                                                      IRC_RAW_FLAG_RECV,
+                                                      "msg4"));
+}
+
+/*
+ * Tests functions:
+ *   irc_raw_print
+ */
+
+TEST(IrcRaw, Print)
+{
+    irc_raw_message_free_all ();
+
+    irc_raw_print (NULL, IRC_RAW_FLAG_RECV, NULL);
+    LONGS_EQUAL(0, irc_raw_messages_count);
+
+    /* raw buffer not displayed: messages are not printed */
+    irc_raw_print (NULL, IRC_RAW_FLAG_RECV, "msg1");
+    irc_raw_print (NULL, IRC_RAW_FLAG_SEND, "msg2");
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    LONGS_EQUAL(2, irc_raw_messages_not_printed);
+}
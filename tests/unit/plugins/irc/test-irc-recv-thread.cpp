@@ -0,0 +1,280 @@
+/*
+ * test-irc-recv-thread.cpp - test IRC receiving thread functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "src/plugins/irc/irc-recv-thread.h"
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-stats.h"
+}
+
+#include "tests/tests.h"
+
+#define IRC_TEST_SERVER "testrecv"
+
+TEST_GROUP(IrcRecvThread)
+{
+};
+
+/*
+ * Tests functions:
+ *   irc_recv_thread_split
+ *   irc_recv_thread_free_messages
+ */
+
+TEST(IrcRecvThread, Split)
+{
+    struct t_irc_recv_thread recv_thread;
+    struct t_irc_recv_thread_message *messages, *last_message;
+    char buffer[256];
+
+    memset (&recv_thread, 0, sizeof (recv_thread));
+    messages = NULL;
+    last_message = NULL;
+
+    irc_recv_thread_split (NULL, buffer, &messages, &last_message);
+    irc_recv_thread_split (&recv_thread, NULL, &messages, &last_message);
+    POINTERS_EQUAL(NULL, messages);
+
+    strcpy (buffer, "");
+    irc_recv_thread_split (&recv_thread, buffer, &messages, &last_message);
+    POINTERS_EQUAL(NULL, messages);
+    POINTERS_EQUAL(NULL, recv_thread.unterminated_message);
+
+    strcpy (buffer, "PING :abc\r\nPING :d");
+    irc_recv_thread_split (&recv_thread, buffer, &messages, &last_message);
+    CHECK(messages);
+    STRCMP_EQUAL("PING :abc", messages->data);
+    POINTERS_EQUAL(messages, last_message);
+    STRCMP_EQUAL("PING :d", recv_thread.unterminated_message);
+
+    /* '\r' is ignored, even in the middle of a message */
+    strcpy (buffer, "e\rf\r\n\nPING :ghi\n");
+    irc_recv_thread_split (&recv_thread, buffer, &messages, &last_message);
+    CHECK(messages->next_message);
+    STRCMP_EQUAL("PING :def", messages->next_message->data);
+    CHECK(messages->next_message->next_message);
+    STRCMP_EQUAL("", messages->next_message->next_message->data);
+    STRCMP_EQUAL("PING :ghi", last_message->data);
+    POINTERS_EQUAL(NULL, last_message->next_message);
+    POINTERS_EQUAL(NULL, recv_thread.unterminated_message);
+
+    irc_recv_thread_free_messages (messages);
+}
+
+TEST_GROUP(IrcRecvThreadWithServer)
+{
+    struct t_irc_server *server;
+    int sock[2];
+
+    /* waits for data sent by receiving thread to main thread */
+    int wait_data ()
+    {
+        struct pollfd fds;
+
+        fds.fd = server->recv_thread->pipe_data[0];
+        fds.events = POLLIN;
+        fds.revents = 0;
+        return (poll (&fds, 1, 5000) > 0) ? 1 : 0;
+    }
+
+    /* reads data sent by WeeChat to the server */
+    void read_sent (char *buffer, int size)
+    {
+        struct pollfd fds;
+        int num_read;
+
+        buffer[0] = '\0';
+        fds.fd = sock[1];
+        fds.events = POLLIN;
+        fds.revents = 0;
+        if (poll (&fds, 1, 5000) > 0)
+        {
+            num_read = read (sock[1], buffer, size - 1);
+            if (num_read > 0)
+                buffer[num_read] = '\0';
+        }
+    }
+
+    void setup ()
+    {
+        int flags;
+
+        printf ("\n");
+
+        run_cmd ("/server add " IRC_TEST_SERVER " 127.0.0.1 -noautoreconnect");
+        server = irc_server_search (IRC_TEST_SERVER);
+
+        /* the server socket is one end of a socket pair */
+        sock[0] = -1;
+        sock[1] = -1;
+        if (socketpair (AF_UNIX, SOCK_STREAM, 0, sock) == 0)
+        {
+            flags = fcntl (sock[0], F_GETFL);
+            fcntl (sock[0], F_SETFL, flags | O_NONBLOCK);
+            server->sock = sock[0];
+        }
+    }
+
+    void teardown ()
+    {
+        irc_recv_thread_stop (server, 0);
+        if (server->sock >= 0)
+        {
+            close (server->sock);
+            server->sock = -1;
+        }
+        if (sock[1] >= 0)
+            close (sock[1]);
+        run_cmd ("/server del " IRC_TEST_SERVER);
+        server = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_recv_thread_start
+ *   irc_recv_thread_data_cb
+ *   irc_recv_thread_stop
+ */
+
+TEST(IrcRecvThreadWithServer, StartStop)
+{
+    char buffer[1024];
+    const char *data = "PING :abc\r\nPING :def\r\nPI";
+    long bytes_recv;
+
+    CHECK(server);
+    CHECK(server->sock >= 0);
+
+    LONGS_EQUAL(0, irc_recv_thread_start (NULL));
+
+    bytes_recv = server->stats->total[IRC_STATS_BYTES_RECV];
+
+    LONGS_EQUAL(1, irc_recv_thread_start (server));
+    CHECK(server->recv_thread);
+    CHECK(server->hook_fd);
+
+    /* thread already started */
+    LONGS_EQUAL(0, irc_recv_thread_start (server));
+
+    LONGS_EQUAL(strlen (data), write (sock[1], data, strlen (data)));
+    LONGS_EQUAL(1, wait_data ());
+
+    /* messages are processed by main thread: PONG is sent to server */
+    irc_recv_thread_data_cb (server, NULL, server->recv_thread->pipe_data[0]);
+    LONGS_EQUAL(bytes_recv + (long)strlen (data),
+                server->stats->total[IRC_STATS_BYTES_RECV]);
+    read_sent (buffer, sizeof (buffer));
+    STRCMP_EQUAL("PONG :abc\r\nPONG :def\r\n", buffer);
+
+    /* unterminated message is kept in server when thread is stopped */
+    irc_recv_thread_stop (server, 1);
+    POINTERS_EQUAL(NULL, server->recv_thread);
+    POINTERS_EQUAL(NULL, server->hook_fd);
+    STRCMP_EQUAL("PI", server->unterminated_message);
+
+    /* end of message is received by a new thread */
+    LONGS_EQUAL(1, irc_recv_thread_start (server));
+    LONGS_EQUAL(8, write (sock[1], "NG :xyz\n", 8));
+    LONGS_EQUAL(1, wait_data ());
+    irc_recv_thread_data_cb (server, NULL, server->recv_thread->pipe_data[0]);
+    POINTERS_EQUAL(NULL, server->unterminated_message);
+    read_sent (buffer, sizeof (buffer));
+    STRCMP_EQUAL("PONG :xyz\r\n", buffer);
+}
+
+/*
+ * Tests functions:
+ *   irc_recv_thread_data_cb (connection closed by peer)
+ *   irc_server_recv_error
+ */
+
+TEST(IrcRecvThreadWithServer, ConnectionClosed)
+{
+    CHECK(server);
+    CHECK(server->sock >= 0);
+
+    LONGS_EQUAL(1, irc_recv_thread_start (server));
+
+    close (sock[1]);
+    sock[1] = -1;
+    LONGS_EQUAL(1, wait_data ());
+
+    /* error in thread: server is disconnected, thread is stopped */
+    irc_recv_thread_data_cb (server, NULL, server->recv_thread->pipe_data[0]);
+    POINTERS_EQUAL(NULL, server->recv_thread);
+    POINTERS_EQUAL(NULL, server->hook_fd);
+    LONGS_EQUAL(-1, server->sock);
+}
+
+/*
+ * Tests functions:
+ *   irc_recv_thread_run (socket not read when queue is full)
+ *   irc_recv_thread_data_cb (thread resumed)
+ */
+
+TEST(IrcRecvThreadWithServer, QueueFull)
+{
+    char buffer[4096];
+    int flags, i, paused, rc;
+
+    CHECK(server);
+    CHECK(server->sock >= 0);
+
+    LONGS_EQUAL(1, irc_recv_thread_start (server));
+
+    /* send empty messages until the queue is full */
+    flags = fcntl (sock[1], F_GETFL);
+    fcntl (sock[1], F_SETFL, flags | O_NONBLOCK);
+    memset (buffer, '\n', sizeof (buffer));
+    paused = 0;
+    for (i = 0; (i < 5000) && !paused; i++)
+    {
+        if (write (sock[1], buffer, sizeof (buffer)) <= 0)
+            usleep (1000);
+        pthread_mutex_lock (&server->recv_thread->mutex);
+        paused = server->recv_thread->paused;
+        pthread_mutex_unlock (&server->recv_thread->mutex);
+    }
+    LONGS_EQUAL(1, paused);
+    CHECK(server->recv_thread->size >= IRC_RECV_THREAD_MAX_QUEUE_SIZE);
+
+    /* the socket is not read any more: data is left in socket */
+    rc = write (sock[1], buffer, sizeof (buffer));
+    (void) rc;
+    usleep (100 * 1000);
+    CHECK(recv (sock[0], buffer, 1, MSG_PEEK | MSG_DONTWAIT) > 0);
+
+    /* queue is emptied by main thread: the thread reads the socket again */
+    LONGS_EQUAL(1, wait_data ());
+    irc_recv_thread_data_cb (server, NULL, server->recv_thread->pipe_data[0]);
+    LONGS_EQUAL(1, wait_data ());
+    irc_recv_thread_data_cb (server, NULL, server->recv_thread->pipe_data[0]);
+}
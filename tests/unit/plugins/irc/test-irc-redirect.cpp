@@ -0,0 +1,182 @@
+/*
+ * test-irc-redirect.cpp - test IRC redirection of commands
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "src/core/wee-hashtable.h"
+#include "src/plugins/irc/irc-redirect.h"
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-stats.h"
+}
+
+#include "tests/tests.h"
+
+#define IRC_FAKE_SERVER "fake"
+
+TEST_GROUP(IrcRedirectWithServer)
+{
+    struct t_irc_server *server;
+
+    void setup ()
+    {
+        printf ("\n");
+
+        /* create a fake server (no I/O) */
+        run_cmd ("/server add " IRC_FAKE_SERVER " fake:127.0.0.1 "
+                 "-nicks=nick1,nick2,nick3");
+
+        /* connect to the fake server */
+        run_cmd ("/connect " IRC_FAKE_SERVER);
+
+        /* simulate the end of connection */
+        run_cmd ("/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+                 "/server fakerecv :server 001 alice");
+
+        /* get the server pointer */
+        server = irc_server_search (IRC_FAKE_SERVER);
+    }
+
+    void teardown ()
+    {
+        /* disconnect and delete the fake server */
+        run_cmd ("/disconnect " IRC_FAKE_SERVER);
+        run_cmd ("/server del " IRC_FAKE_SERVER);
+        server = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_redirect_new
+ *   irc_redirect_free
+ *   irc_redirect_free_all
+ */
+
+TEST(IrcRedirectWithServer, NewFree)
+{
+    struct t_irc_redirect *redirect1, *redirect2;
+
+    CHECK(server);
+
+    POINTERS_EQUAL(NULL, irc_redirect_new (server, "unknown", "test",
+                                           1, NULL, 0, NULL));
+
+    redirect1 = irc_redirect_new (server, "whois", "test", 1, "bob", 0, NULL);
+    redirect2 = irc_redirect_new (server, "ison", "test", 1, NULL, 0, NULL);
+    CHECK(redirect1);
+    CHECK(redirect2);
+
+    /* start/stop commands of both redirects are indexed */
+    CHECK(server->redirects_commands);
+    LONGS_EQUAL(1, *((int *)hashtable_get (server->redirects_commands,
+                                           "311")));
+    LONGS_EQUAL(1, *((int *)hashtable_get (server->redirects_commands,
+                                           "318")));
+    LONGS_EQUAL(1, *((int *)hashtable_get (server->redirects_commands,
+                                           "303")));
+    LONGS_EQUAL(0, server->redirects_in_progress);
+
+    irc_redirect_free (redirect2);
+    POINTERS_EQUAL(NULL, hashtable_get (server->redirects_commands, "303"));
+    CHECK(hashtable_get (server->redirects_commands, "311"));
+
+    irc_redirect_set_received (redirect1, 1, 0);
+    LONGS_EQUAL(1, server->redirects_in_progress);
+
+    irc_redirect_free_all (server);
+    POINTERS_EQUAL(NULL, server->redirects);
+    LONGS_EQUAL(0, server->redirects_commands->items_count);
+    LONGS_EQUAL(0, server->redirects_in_progress);
+}
+
+/*
+ * Tests functions:
+ *   irc_redirect_init_command
+ *   irc_redirect_message
+ *   irc_redirect_stop
+ */
+
+TEST(IrcRedirectWithServer, Message)
+{
+    struct t_irc_redirect *redirect;
+
+    CHECK(server);
+
+    irc_stats_reset (server->stats);
+
+    LONGS_EQUAL(0, irc_redirect_message (server, ":server 001 alice",
+                                         "001", "alice"));
+
+    redirect = irc_redirect_new (server, "whois", "test", 1, "bob", 0, NULL);
+    CHECK(redirect);
+
+    /* redirect not started */
+    LONGS_EQUAL(0, irc_redirect_message (
+                    server, ":server 311 alice bob user host * :Bob",
+                    "311", "alice bob user host * :Bob"));
+
+    irc_redirect_init_command (redirect, "WHOIS bob");
+
+    /* command not indexed: message is not checked by redirects */
+    LONGS_EQUAL(0, irc_redirect_message (
+                    server, ":bob!user@host PRIVMSG alice :hi",
+                    "PRIVMSG", "alice :hi"));
+    LONGS_EQUAL(1, server->stats->total[IRC_STATS_REDIRECT_MSGS]);
+
+    /* start command with another nick */
+    LONGS_EQUAL(0, irc_redirect_message (
+                    server, ":server 311 alice carol user host * :Carol",
+                    "311", "alice carol user host * :Carol"));
+    LONGS_EQUAL(0, server->redirects_in_progress);
+
+    /* start command */
+    LONGS_EQUAL(1, irc_redirect_message (
+                    server, ":server 311 alice bob user host * :Bob",
+                    "311", "alice bob user host * :Bob"));
+    LONGS_EQUAL(1, redirect->cmd_start_received);
+    LONGS_EQUAL(1, server->redirects_in_progress);
+
+    /* command not indexed, but redirect is in progress */
+    LONGS_EQUAL(1, irc_redirect_message (
+                    server, ":server 319 alice bob :#test",
+                    "319", "alice bob :#test"));
+
+    /* stop command (also extra command): redirect is removed */
+    LONGS_EQUAL(1, irc_redirect_message (
+                    server, ":server 318 alice bob :End of /WHOIS list.",
+                    "318", "alice bob :End of /WHOIS list."));
+    POINTERS_EQUAL(NULL, server->redirects);
+    LONGS_EQUAL(0, server->redirects_in_progress);
+    LONGS_EQUAL(0, server->redirects_commands->items_count);
+
+    /* no more redirects */
+    LONGS_EQUAL(0, irc_redirect_message (
+                    server, ":server 319 alice bob :#test",
+                    "319", "alice bob :#test"));
+
+    LONGS_EQUAL(5, server->stats->total[IRC_STATS_REDIRECT_MSGS]);
+    LONGS_EQUAL(1, server->stats->total[IRC_STATS_REDIRECTS]);
+    CHECK(server->stats->total[IRC_STATS_REDIRECT_TIME] >= 0);
+}
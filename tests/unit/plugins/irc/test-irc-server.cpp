@@ -24,11 +24,22 @@
 extern "C"
 {
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "src/core/wee-config-file.h"
 #include "src/plugins/plugin.h"
 #include "src/plugins/irc/irc-channel.h"
+#include "src/plugins/irc/irc-config.h"
 #include "src/plugins/irc/irc-server.h"
 
 extern char *irc_server_build_autojoin (struct t_irc_server *server);
+extern void irc_server_reconnect_schedule (struct t_irc_server *server);
+extern void irc_server_send_unsent (struct t_irc_server *server);
+extern int irc_server_send_data (struct t_irc_server *server,
+                                 const char *data);
 }
 
 #include "tests/tests.h"
@@ -119,6 +130,40 @@ TEST(IrcServer, Strncasecmp)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   irc_server_string_tolower
+ */
+
+TEST(IrcServer, StringTolower)
+{
+    struct t_irc_server *server;
+    char *str;
+
+    POINTERS_EQUAL(NULL, irc_server_string_tolower (NULL, NULL));
+
+    /* no server: RFC 1459 casemapping */
+    WEE_TEST_STR("", irc_server_string_tolower (NULL, ""));
+    WEE_TEST_STR("nick{a}|b~c", irc_server_string_tolower (NULL, "NiCk[A]\\B^C"));
+
+    server = irc_server_alloc ("my_ircd");
+    CHECK(server);
+
+    server->casemapping = IRC_SERVER_CASEMAPPING_RFC1459;
+    WEE_TEST_STR("#chan{a}|b~c", irc_server_string_tolower (server, "#CHAN[A]\\B^C"));
+
+    server->casemapping = IRC_SERVER_CASEMAPPING_STRICT_RFC1459;
+    WEE_TEST_STR("#chan{a}|b^c", irc_server_string_tolower (server, "#CHAN[A]\\B^C"));
+
+    server->casemapping = IRC_SERVER_CASEMAPPING_ASCII;
+    WEE_TEST_STR("#chan[a]\\b^c", irc_server_string_tolower (server, "#CHAN[A]\\B^C"));
+
+    /* UTF-8 chars are not changed */
+    WEE_TEST_STR("#\xc3\x89t\xc3\xa9", irc_server_string_tolower (server, "#\xc3\x89T\xc3\xa9"));
+
+    irc_server_free (server);
+}
+
 /*
  * Tests functions:
  *   irc_server_eval_expression
@@ -500,6 +545,68 @@ TEST(IrcServer, Send)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   irc_server_send_unsent
+ *   irc_server_send_data
+ */
+
+TEST(IrcServer, SendData)
+{
+    struct t_irc_server *server;
+    char *data, *received;
+    int fds[2], flags, size, length, num_read;
+
+    server = irc_server_alloc ("my_ircd");
+    CHECK(server);
+
+    LONGS_EQUAL(0, socketpair (AF_UNIX, SOCK_STREAM, 0, fds));
+    flags = fcntl (fds[0], F_GETFL);
+    fcntl (fds[0], F_SETFL, flags | O_NONBLOCK);
+    flags = fcntl (fds[1], F_GETFL);
+    fcntl (fds[1], F_SETFL, flags | O_NONBLOCK);
+    server->sock = fds[0];
+
+    /* data bigger than the socket buffer: the end is kept for later */
+    size = 4 * 1024 * 1024;
+    data = (char *)malloc (size + 1);
+    CHECK(data);
+    memset (data, 'a', size);
+    data[size - 1] = 'z';
+    data[size] = '\0';
+    LONGS_EQUAL(1, irc_server_send_data (server, data));
+    CHECK(server->outqueue_unsent);
+    CHECK(strlen (server->outqueue_unsent) < (size_t)size);
+    CHECK(server->hook_timer_anti_flood);
+
+    /* new data is sent after the data kept */
+    LONGS_EQUAL(1, irc_server_send_data (server, "PING :end\r\n"));
+    CHECK(server->outqueue_unsent);
+
+    /* read everything, sending data kept when the socket has room */
+    received = (char *)malloc (size + 64);
+    CHECK(received);
+    length = 0;
+    while (length < size + 11)
+    {
+        num_read = read (fds[1], received + length, size + 64 - length);
+        if (num_read > 0)
+            length += num_read;
+        irc_server_send_unsent (server);
+    }
+    LONGS_EQUAL(size + 11, length);
+    POINTERS_EQUAL(NULL, server->outqueue_unsent);
+    LONGS_EQUAL('z', received[size - 1]);
+    MEMCMP_EQUAL("PING :end\r\n", received + size, 11);
+
+    free (data);
+    free (received);
+    server->sock = -1;
+    close (fds[0]);
+    close (fds[1]);
+    irc_server_free (server);
+}
+
 /*
  * Tests functions:
  *   irc_server_set_send_default_tags
@@ -520,6 +627,58 @@ TEST(IrcServer, GetTagsToSend)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   irc_server_anti_flood_wait
+ *   irc_server_anti_flood_consume
+ */
+
+TEST(IrcServer, AntiFlood)
+{
+    struct t_irc_server *server;
+    long long wait;
+
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (NULL, 0, 0));
+    irc_server_anti_flood_consume (NULL, 0, 0);
+
+    server = irc_server_alloc ("my_ircd");
+    CHECK(server);
+
+    /* default: one message every 2 seconds, no burst, no limit on bytes */
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (server, 0, 10));
+    irc_server_anti_flood_consume (server, 0, 10);
+    wait = irc_server_anti_flood_wait (server, 0, 10);
+    CHECK((wait > 1900) && (wait <= 2000));
+    CHECK(server->last_user_message > 0);
+
+    /* burst of 3 messages */
+    config_file_option_set (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BURST],
+                            "3", 1);
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (server, 0, 10));
+    irc_server_anti_flood_consume (server, 0, 10);
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (server, 0, 10));
+    irc_server_anti_flood_consume (server, 0, 10);
+    wait = irc_server_anti_flood_wait (server, 0, 10);
+    CHECK((wait > 1900) && (wait <= 2000));
+
+    /* no anti-flood on messages, limit of 100 bytes per second */
+    config_file_option_set (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_PRIO_LOW],
+                            "0", 1);
+    config_file_option_set (server->options[IRC_SERVER_OPTION_ANTI_FLOOD_BYTES],
+                            "100", 1);
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (server, 1, 60));
+    irc_server_anti_flood_consume (server, 1, 60);
+    wait = irc_server_anti_flood_wait (server, 1, 60);
+    CHECK((wait > 100) && (wait <= 200));
+
+    /* message bigger than the bucket: sent when the bucket is empty */
+    server->anti_flood_bytes_time.tv_sec = 0;
+    server->anti_flood_bytes_time.tv_usec = 0;
+    LONGS_EQUAL(0, irc_server_anti_flood_wait (server, 1, 500));
+
+    irc_server_free (server);
+}
+
 /*
  * Tests functions:
  *   irc_server_outqueue_send
@@ -677,7 +836,54 @@ TEST(IrcServer, CloseConnection)
 
 TEST(IrcServer, ReconnectSchedule)
 {
-    /* TODO: write tests */
+    struct t_irc_server *server;
+    int i, delays[6] = { 10, 20, 40, 80, 100, 100 };
+
+    server = irc_server_alloc ("my_ircd");
+    CHECK(server);
+
+    config_file_option_set (server->options[IRC_SERVER_OPTION_AUTORECONNECT_DELAY],
+                            "10", 1);
+    config_file_option_set (irc_config_network_autoreconnect_delay_growing,
+                            "2", 1);
+    config_file_option_set (irc_config_network_autoreconnect_delay_max,
+                            "100", 1);
+    config_file_option_set (irc_config_network_autoreconnect_delay_jitter,
+                            "50", 1);
+
+    /* random delay is not added to the growing delay and max is respected */
+    for (i = 0; i < 6; i++)
+    {
+        irc_server_reconnect_schedule (server);
+        LONGS_EQUAL(delays[i], server->reconnect_delay);
+        CHECK(server->reconnect_jitter >= 0);
+        CHECK(server->reconnect_jitter <= delays[i] / 2);
+        CHECK(server->reconnect_delay + server->reconnect_jitter <= 100);
+        CHECK(server->reconnect_start > 0);
+    }
+    LONGS_EQUAL(0, server->reconnect_jitter);
+
+    /* no max delay */
+    config_file_option_set (irc_config_network_autoreconnect_delay_max,
+                            "0", 1);
+    irc_server_reconnect_schedule (server);
+    LONGS_EQUAL(200, server->reconnect_delay);
+    CHECK(server->reconnect_jitter >= 0);
+    CHECK(server->reconnect_jitter <= 100);
+
+    /* no autoreconnect */
+    config_file_option_set (server->options[IRC_SERVER_OPTION_AUTORECONNECT],
+                            "off", 1);
+    irc_server_reconnect_schedule (server);
+    LONGS_EQUAL(0, server->reconnect_delay);
+    LONGS_EQUAL(0, server->reconnect_jitter);
+    LONGS_EQUAL(0, server->reconnect_start);
+
+    config_file_option_reset (irc_config_network_autoreconnect_delay_growing, 1);
+    config_file_option_reset (irc_config_network_autoreconnect_delay_max, 1);
+    config_file_option_reset (irc_config_network_autoreconnect_delay_jitter, 1);
+
+    irc_server_free (server);
 }
 
 /*
@@ -800,6 +1006,60 @@ TEST(IrcServer, Reconnect)
     /* TODO: write tests */
 }
 
+/*
+ * Tests functions:
+ *   irc_server_connection_in_progress
+ *   irc_server_count_connections_in_progress
+ *   irc_server_connect_pending
+ */
+
+TEST(IrcServer, ConnectPending)
+{
+    struct t_irc_server *server1, *server2;
+
+    run_cmd ("/set irc.network.connections_max 1");
+    run_cmd ("/server add fake1 fake:127.0.0.1 -nicks=nick1");
+    run_cmd ("/server add fake2 fake:127.0.0.1 -nicks=nick2 "
+             "-connection_priority=10");
+    server1 = irc_server_search ("fake1");
+    server2 = irc_server_search ("fake2");
+    CHECK(server1);
+    CHECK(server2);
+
+    LONGS_EQUAL(0, irc_server_connection_in_progress (server1));
+    LONGS_EQUAL(0, irc_server_count_connections_in_progress ());
+
+    /* only one slot: server with highest priority is connected first */
+    server1->connect_pending = 1;
+    server2->connect_pending = 1;
+    irc_server_connect_pending (time (NULL));
+    LONGS_EQUAL(1, server1->connect_pending);
+    LONGS_EQUAL(0, server2->connect_pending);
+    LONGS_EQUAL(0, irc_server_connection_in_progress (server1));
+    LONGS_EQUAL(1, irc_server_connection_in_progress (server2));
+    LONGS_EQUAL(1, irc_server_count_connections_in_progress ());
+    CHECK(server2->connect_duration >= 0);
+    LONGS_EQUAL(-1, server2->login_duration);
+
+    /* no free slot */
+    irc_server_connect_pending (time (NULL));
+    LONGS_EQUAL(1, server1->connect_pending);
+
+    /* message 001 on server2 frees the slot: server1 is connected */
+    run_cmd ("/command -buffer irc.server.fake2 irc "
+             "/server fakerecv :server 001 nick2");
+    LONGS_EQUAL(1, server2->is_connected);
+    CHECK(server2->login_duration >= 0);
+    LONGS_EQUAL(0, server1->connect_pending);
+    LONGS_EQUAL(1, irc_server_connection_in_progress (server1));
+
+    run_cmd ("/disconnect fake1");
+    run_cmd ("/disconnect fake2");
+    run_cmd ("/server del fake1");
+    run_cmd ("/server del fake2");
+    run_cmd ("/unset irc.network.connections_max");
+}
+
 /*
  * Tests functions:
  *   irc_server_auto_connect_timer_cb
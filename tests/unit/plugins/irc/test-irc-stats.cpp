@@ -0,0 +1,306 @@
+/*
+ * test-irc-stats.cpp - test IRC statistics functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "src/core/wee-hashtable.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-color.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-stats.h"
+}
+
+#include "tests/tests.h"
+
+#define IRC_FAKE_SERVER "fake"
+
+TEST_GROUP(IrcStats)
+{
+};
+
+/*
+ * Tests functions:
+ *   irc_stats_window_add
+ *   irc_stats_window_sum
+ */
+
+TEST(IrcStats, Window)
+{
+    struct t_irc_stats_window window;
+    time_t now;
+
+    memset (&window, 0, sizeof (window));
+
+    /* 2021-03-01 10:00:00 */
+    now = 1614592800;
+
+    LONGS_EQUAL(0, irc_stats_window_sum (&window, now, 1));
+    LONGS_EQUAL(0, irc_stats_window_sum (&window, now, 15));
+
+    irc_stats_window_add (&window, now, 5);
+    irc_stats_window_add (&window, now + 30, 2);
+    LONGS_EQUAL(7, irc_stats_window_sum (&window, now, 1));
+
+    /* two minutes later */
+    irc_stats_window_add (&window, now + 120, 3);
+    LONGS_EQUAL(3, irc_stats_window_sum (&window, now + 120, 1));
+    LONGS_EQUAL(10, irc_stats_window_sum (&window, now + 120, 5));
+    LONGS_EQUAL(10, irc_stats_window_sum (&window, now + 120, 15));
+    LONGS_EQUAL(10, irc_stats_window_sum (&window, now + 120, 60));
+
+    /* six minutes later: first values are out of 5-minute window */
+    LONGS_EQUAL(0, irc_stats_window_sum (&window, now + 360, 1));
+    LONGS_EQUAL(3, irc_stats_window_sum (&window, now + 360, 5));
+    LONGS_EQUAL(10, irc_stats_window_sum (&window, now + 360, 15));
+
+    /* one hour later: slot is reused, old values are discarded */
+    irc_stats_window_add (&window, now + 3600, 1);
+    LONGS_EQUAL(1, irc_stats_window_sum (&window, now + 3600, 1));
+    LONGS_EQUAL(1, irc_stats_window_sum (&window, now + 3600, 15));
+}
+
+/*
+ * Tests functions:
+ *   irc_stats_new
+ *   irc_stats_add
+ *   irc_stats_add_sent
+ *   irc_stats_add_message
+ *   irc_stats_get
+ *   irc_stats_reset
+ *   irc_stats_free
+ */
+
+TEST(IrcStats, AddGet)
+{
+    struct t_irc_stats *stats;
+    struct t_irc_stats_command *ptr_cmd;
+    struct timeval tv_start;
+    time_t now;
+    char command[32];
+    int i;
+
+    stats = irc_stats_new ();
+    CHECK(stats);
+    CHECK(stats->start_time > 0);
+    CHECK(stats->commands);
+
+    now = time (NULL);
+
+    /* invalid arguments */
+    irc_stats_add (NULL, IRC_STATS_BYTES_RECV, 10);
+    irc_stats_add_sent (NULL, "test\r\n", 6);
+    irc_stats_add_sent (stats, NULL, 6);
+    irc_stats_add_sent (stats, "test\r\n", 0);
+    LONGS_EQUAL(0, irc_stats_get (NULL, IRC_STATS_BYTES_RECV, now, 0));
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_NUM_COUNTERS, now, 0));
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_BYTES_SENT, now, 0));
+
+    irc_stats_add (stats, IRC_STATS_BYTES_RECV, 10);
+    irc_stats_add (stats, IRC_STATS_BYTES_RECV, 32);
+    now = time (NULL);
+    LONGS_EQUAL(42, irc_stats_get (stats, IRC_STATS_BYTES_RECV, now, 0));
+    LONGS_EQUAL(42, irc_stats_get (stats, IRC_STATS_BYTES_RECV, now, 5));
+    LONGS_EQUAL(42, irc_stats_get (stats, IRC_STATS_BYTES_RECV, now, 15));
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_BYTES_RECV,
+                                  now + 3600, 15));
+
+    /* sent: one or many messages in buffer */
+    irc_stats_add_sent (stats, "PING :test\r\n", 12);
+    irc_stats_add_sent (stats, "PRIVMSG #a :a\r\nPRIVMSG #b :b\r\n", 30);
+    LONGS_EQUAL(42, irc_stats_get (stats, IRC_STATS_BYTES_SENT, now, 0));
+    LONGS_EQUAL(3, irc_stats_get (stats, IRC_STATS_MSGS_SENT, now, 0));
+
+    /* messages received */
+    gettimeofday (&tv_start, NULL);
+    irc_stats_add_message (stats, "PRIVMSG", &tv_start);
+    irc_stats_add_message (stats, "PRIVMSG", &tv_start);
+    irc_stats_add_message (stats, "JOIN", &tv_start);
+    irc_stats_add_message (stats, NULL, &tv_start);
+    LONGS_EQUAL(4, irc_stats_get (stats, IRC_STATS_MSGS_RECV, now, 0));
+    LONGS_EQUAL(2, stats->commands->items_count);
+    ptr_cmd = (struct t_irc_stats_command *)hashtable_get (stats->commands,
+                                                           "PRIVMSG");
+    CHECK(ptr_cmd);
+    LONGS_EQUAL(2, ptr_cmd->count);
+    CHECK(ptr_cmd->time >= 0);
+    ptr_cmd = (struct t_irc_stats_command *)hashtable_get (stats->commands,
+                                                           "JOIN");
+    CHECK(ptr_cmd);
+    LONGS_EQUAL(1, ptr_cmd->count);
+
+    /* too many commands: other ones are counted in "other" */
+    for (i = 0; i < IRC_STATS_MAX_COMMANDS + 10; i++)
+    {
+        snprintf (command, sizeof (command), "CMD%d", i);
+        irc_stats_add_message (stats, command, &tv_start);
+    }
+    LONGS_EQUAL(IRC_STATS_MAX_COMMANDS + 1, stats->commands->items_count);
+    POINTERS_EQUAL(NULL, hashtable_get (stats->commands, "CMD70"));
+    ptr_cmd = (struct t_irc_stats_command *)hashtable_get (
+        stats->commands, IRC_STATS_COMMAND_OTHER);
+    CHECK(ptr_cmd);
+    LONGS_EQUAL(12, ptr_cmd->count);
+    ptr_cmd = (struct t_irc_stats_command *)hashtable_get (stats->commands,
+                                                           "PRIVMSG");
+    CHECK(ptr_cmd);
+    irc_stats_add_message (stats, "PRIVMSG", &tv_start);
+    LONGS_EQUAL(3, ptr_cmd->count);
+
+    irc_stats_reset (stats);
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_BYTES_RECV, now, 0));
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_BYTES_RECV, now, 5));
+    LONGS_EQUAL(0, irc_stats_get (stats, IRC_STATS_MSGS_RECV, now, 0));
+    LONGS_EQUAL(0, stats->commands->items_count);
+
+    irc_stats_free (stats);
+}
+
+TEST_GROUP(IrcStatsWithServer)
+{
+    struct t_irc_server *server;
+
+    void setup ()
+    {
+        printf ("\n");
+
+        /* create a fake server (no I/O) */
+        run_cmd ("/server add " IRC_FAKE_SERVER " fake:127.0.0.1 "
+                 "-nicks=nick1,nick2,nick3");
+
+        /* connect to the fake server */
+        run_cmd ("/connect " IRC_FAKE_SERVER);
+
+        /* get the server pointer */
+        server = irc_server_search (IRC_FAKE_SERVER);
+    }
+
+    void teardown ()
+    {
+        /* disconnect and delete the fake server */
+        run_cmd ("/disconnect " IRC_FAKE_SERVER);
+        run_cmd ("/server del " IRC_FAKE_SERVER);
+        server = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_stats_outqueue_depth
+ *   irc_stats_to_hashtable
+ */
+
+TEST(IrcStatsWithServer, ToHashtable)
+{
+    struct t_hashtable *hashtable;
+
+    CHECK(server);
+    CHECK(server->stats);
+
+    LONGS_EQUAL(0, irc_stats_outqueue_depth (NULL));
+    POINTERS_EQUAL(NULL, irc_stats_to_hashtable (NULL));
+
+    irc_stats_reset (server->stats);
+
+    run_cmd ("/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+             "/server fakerecv :server 001 alice");
+    run_cmd ("/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+             "/server fakerecv :bob!user@host PRIVMSG alice :hi");
+
+    LONGS_EQUAL(0, irc_stats_outqueue_depth (server));
+
+    hashtable = irc_stats_to_hashtable (server);
+    CHECK(hashtable);
+    STRCMP_EQUAL(IRC_FAKE_SERVER,
+                 (const char *)hashtable_get (hashtable, "server"));
+    STRCMP_EQUAL("2", (const char *)hashtable_get (hashtable, "msgs_recv"));
+    STRCMP_EQUAL("2", (const char *)hashtable_get (hashtable, "msgs_recv_5m"));
+    STRCMP_EQUAL("2", (const char *)hashtable_get (hashtable, "msgs_recv_15m"));
+    STRCMP_EQUAL("1", (const char *)hashtable_get (hashtable,
+                                                   "command_count_001"));
+    STRCMP_EQUAL("1", (const char *)hashtable_get (hashtable,
+                                                   "command_count_PRIVMSG_5m"));
+    STRCMP_EQUAL("0", (const char *)hashtable_get (hashtable,
+                                                   "outqueue_depth"));
+    CHECK(hashtable_get (hashtable, "start_time"));
+    CHECK(hashtable_get (hashtable, "lag_current"));
+    hashtable_free (hashtable);
+}
+
+/*
+ * Tests functions:
+ *   irc_command_server_stats_windows
+ *   irc_command_display_server_stats
+ */
+
+TEST(IrcStatsWithServer, Display)
+{
+    struct t_gui_line *ptr_line;
+    char *message;
+    int header_found, msgs_recv_found;
+
+    CHECK(server);
+
+    irc_stats_reset (server->stats);
+
+    run_cmd ("/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+             "/server fakerecv :server 001 alice");
+    run_cmd ("/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+             "/server fakerecv :bob!user@host PRIVMSG alice :hi");
+
+    run_cmd ("/server stats " IRC_FAKE_SERVER);
+
+    /* one column for each window (irc_stats_windows) */
+    header_found = 0;
+    msgs_recv_found = 0;
+    for (ptr_line = gui_buffers->own_lines->last_line; ptr_line;
+         ptr_line = ptr_line->prev_line)
+    {
+        message = gui_color_decode (ptr_line->data->message, NULL);
+        CHECK(message);
+        if (strncmp (message, "Statistics for server", 21) == 0)
+        {
+            free (message);
+            break;
+        }
+        if (strcmp (message,
+                    "                                  total      1 min"
+                    "      5 min     15 min") == 0)
+        {
+            header_found = 1;
+        }
+        if (strcmp (message,
+                    "  messages received                   2          2"
+                    "          2          2") == 0)
+        {
+            msgs_recv_found = 1;
+        }
+        free (message);
+    }
+    LONGS_EQUAL(1, header_found);
+    LONGS_EQUAL(1, msgs_recv_found);
+}
@@ -0,0 +1,447 @@
+/*
+ * test-irc-upgrade.cpp - test IRC upgrade functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-infolist.h"
+#include "src/core/wee-upgrade-file.h"
+#include "src/plugins/irc/irc-channel.h"
+#include "src/plugins/irc/irc-modelist.h"
+#include "src/plugins/irc/irc-nick.h"
+#include "src/plugins/irc/irc-notify.h"
+#include "src/plugins/irc/irc-raw.h"
+#include "src/plugins/irc/irc-redirect.h"
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-upgrade.h"
+
+extern struct t_irc_server *irc_upgrade_current_server;
+extern struct t_irc_channel *irc_upgrade_current_channel;
+extern int irc_upgrade_read_cb (const void *pointer, void *data,
+                                struct t_upgrade_file *upgrade_file,
+                                int object_id,
+                                struct t_infolist *infolist);
+extern int irc_upgrade_write_pack (struct t_upgrade_file *upgrade_file,
+                                   int object_id,
+                                   struct t_irc_upgrade_pack *pack);
+extern char *weechat_home;
+}
+
+#include "tests/tests.h"
+
+#define IRC_FAKE_SERVER "fake"
+#define IRC_UPGRADE_TEST_FILE "test_irc_upgrade"
+
+TEST_GROUP(IrcUpgrade)
+{
+};
+
+/*
+ * Tests functions:
+ *   irc_upgrade_pack_init
+ *   irc_upgrade_pack_add_int
+ *   irc_upgrade_pack_add_time
+ *   irc_upgrade_pack_add_string
+ *   irc_upgrade_pack_read_int
+ *   irc_upgrade_pack_read_time
+ *   irc_upgrade_pack_read_string
+ *   irc_upgrade_pack_free
+ */
+
+TEST(IrcUpgrade, Pack)
+{
+    struct t_irc_upgrade_pack pack, pack_read;
+    int i;
+
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    POINTERS_EQUAL(NULL, pack.data);
+    LONGS_EQUAL(0, pack.size);
+    LONGS_EQUAL(0, pack.error);
+
+    irc_upgrade_pack_add_int (&pack, 42);
+    irc_upgrade_pack_add_int (&pack, -1);
+    irc_upgrade_pack_add_time (&pack, 1614592800);
+    irc_upgrade_pack_add_string (&pack, "test");
+    irc_upgrade_pack_add_string (&pack, NULL);
+    irc_upgrade_pack_add_string (&pack, "");
+    for (i = 0; i < 1000; i++)
+    {
+        irc_upgrade_pack_add_string (&pack, "a string to grow the buffer");
+    }
+    LONGS_EQUAL(0, pack.error);
+    CHECK(pack.size <= pack.allocated);
+
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    LONGS_EQUAL(0, pack_read.allocated);
+    LONGS_EQUAL(42, irc_upgrade_pack_read_int (&pack_read));
+    LONGS_EQUAL(-1, irc_upgrade_pack_read_int (&pack_read));
+    LONGS_EQUAL(1614592800, irc_upgrade_pack_read_time (&pack_read));
+    STRCMP_EQUAL("test", irc_upgrade_pack_read_string (&pack_read));
+    POINTERS_EQUAL(NULL, irc_upgrade_pack_read_string (&pack_read));
+    STRCMP_EQUAL("", irc_upgrade_pack_read_string (&pack_read));
+    for (i = 0; i < 1000; i++)
+    {
+        STRCMP_EQUAL("a string to grow the buffer",
+                     irc_upgrade_pack_read_string (&pack_read));
+    }
+    LONGS_EQUAL(0, pack_read.error);
+    LONGS_EQUAL(pack.size, pack_read.pos);
+
+    /* read after end of data */
+    LONGS_EQUAL(0, irc_upgrade_pack_read_int (&pack_read));
+    LONGS_EQUAL(1, pack_read.error);
+    POINTERS_EQUAL(NULL, irc_upgrade_pack_read_string (&pack_read));
+
+    /* truncated string */
+    irc_upgrade_pack_init (&pack_read, pack.data, 16 + 4 + 2);
+    irc_upgrade_pack_read_int (&pack_read);
+    irc_upgrade_pack_read_int (&pack_read);
+    irc_upgrade_pack_read_time (&pack_read);
+    LONGS_EQUAL(0, pack_read.error);
+    POINTERS_EQUAL(NULL, irc_upgrade_pack_read_string (&pack_read));
+    LONGS_EQUAL(1, pack_read.error);
+
+    /* pack used for reading: data is not freed */
+    irc_upgrade_pack_free (&pack_read);
+
+    irc_upgrade_pack_free (&pack);
+    POINTERS_EQUAL(NULL, pack.data);
+    LONGS_EQUAL(0, pack.size);
+}
+
+TEST_GROUP(IrcUpgradeWithServer)
+{
+    struct t_irc_server *server;
+
+    void server_recv (const char *command)
+    {
+        char str_command[4096];
+
+        snprintf (str_command, sizeof (str_command),
+                  "/command -buffer irc.server." IRC_FAKE_SERVER " irc "
+                  "/server fakerecv %s",
+                  command);
+        run_cmd (str_command);
+    }
+
+    /* reads an upgrade file, restoring data in the given channel */
+    int read_file (struct t_irc_channel *channel)
+    {
+        struct t_upgrade_file *upgrade_file;
+        int rc;
+
+        irc_upgrade_current_server = server;
+        irc_upgrade_current_channel = channel;
+        upgrade_file = upgrade_file_new (IRC_UPGRADE_TEST_FILE,
+                                         &irc_upgrade_read_cb, NULL, NULL);
+        if (!upgrade_file)
+            return 0;
+        rc = upgrade_file_read (upgrade_file);
+        upgrade_file_close (upgrade_file);
+        irc_upgrade_current_server = NULL;
+        irc_upgrade_current_channel = NULL;
+        return rc;
+    }
+
+    void remove_file ()
+    {
+        char path[4096];
+
+        snprintf (path, sizeof (path), "%s/%s.upgrade",
+                  weechat_home, IRC_UPGRADE_TEST_FILE);
+        unlink (path);
+    }
+
+    void setup ()
+    {
+        printf ("\n");
+
+        /* create a fake server (no I/O) */
+        run_cmd ("/server add " IRC_FAKE_SERVER " fake:127.0.0.1 "
+                 "-nicks=nick1,nick2,nick3");
+
+        /* connect to the fake server */
+        run_cmd ("/connect " IRC_FAKE_SERVER);
+
+        /* get the server pointer */
+        server = irc_server_search (IRC_FAKE_SERVER);
+
+        server_recv (":server 001 alice");
+        server_recv (":alice!user@host JOIN #test");
+        server_recv (":alice!user@host JOIN #test2");
+    }
+
+    void teardown ()
+    {
+        remove_file ();
+
+        /* disconnect and delete the fake server */
+        run_cmd ("/disconnect " IRC_FAKE_SERVER);
+        run_cmd ("/server del " IRC_FAKE_SERVER);
+        server = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_upgrade_pack_nicks
+ *   irc_upgrade_unpack_nicks
+ *   irc_upgrade_pack_modelists
+ *   irc_upgrade_unpack_modelists
+ */
+
+TEST(IrcUpgradeWithServer, PackNicksModelists)
+{
+    struct t_irc_channel *channel, *channel2;
+    struct t_irc_modelist *modelist;
+    struct t_irc_modelist_item *item;
+    struct t_irc_nick *ptr_nick;
+    struct t_irc_upgrade_pack pack, pack_read;
+
+    channel = irc_channel_search (server, "#test");
+    channel2 = irc_channel_search (server, "#test2");
+    CHECK(channel);
+    CHECK(channel2);
+
+    irc_nick_new (server, channel, "bob", "user@host", "@", 1, "bob_account",
+                  "Bob");
+    irc_nick_new (server, channel, "carol", NULL, " ", 0, NULL, NULL);
+    modelist = irc_modelist_search (channel, 'b');
+    CHECK(modelist);
+    irc_modelist_item_new (modelist, "a!*@*", "alice", 1000);
+    item = irc_modelist_item_new (modelist, "b!*@*", NULL, 0);
+    irc_modelist_item_new (modelist, "c!*@*", NULL, 0);
+    irc_modelist_item_free (modelist, item);
+    modelist->state = IRC_MODELIST_STATE_RECEIVED;
+
+    /* nicks */
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    LONGS_EQUAL(channel->nicks_count,
+                irc_upgrade_pack_nicks (&pack, channel));
+    irc_nick_free_all (server, channel2);
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_nicks (&pack_read, server, channel2);
+    LONGS_EQUAL(0, pack_read.error);
+    LONGS_EQUAL(channel->nicks_count, channel2->nicks_count);
+    ptr_nick = irc_nick_search (server, channel2, "bob");
+    CHECK(ptr_nick);
+    STRCMP_EQUAL("user@host", ptr_nick->host);
+    STRCMP_EQUAL(irc_nick_search (server, channel, "bob")->prefixes,
+                 ptr_nick->prefixes);
+    LONGS_EQUAL(1, ptr_nick->away);
+    STRCMP_EQUAL("bob_account", ptr_nick->account);
+    STRCMP_EQUAL("Bob", ptr_nick->realname);
+    ptr_nick = irc_nick_search (server, channel2, "carol");
+    CHECK(ptr_nick);
+    POINTERS_EQUAL(NULL, ptr_nick->host);
+    POINTERS_EQUAL(NULL, ptr_nick->account);
+    irc_upgrade_pack_free (&pack);
+
+    /* modelists (numbers and state are kept) */
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    LONGS_EQUAL(2, irc_upgrade_pack_modelists (&pack, channel));
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_modelists (&pack_read, channel2);
+    LONGS_EQUAL(0, pack_read.error);
+    modelist = irc_modelist_search (channel2, 'b');
+    CHECK(modelist);
+    LONGS_EQUAL(IRC_MODELIST_STATE_RECEIVED, modelist->state);
+    LONGS_EQUAL(2, modelist->items_count);
+    item = irc_modelist_item_search_number (modelist, 0);
+    CHECK(item);
+    STRCMP_EQUAL("a!*@*", item->mask);
+    STRCMP_EQUAL("alice", item->setter);
+    LONGS_EQUAL(1000, item->datetime);
+    POINTERS_EQUAL(NULL, irc_modelist_item_search_number (modelist, 1));
+    item = irc_modelist_item_search_number (modelist, 2);
+    CHECK(item);
+    POINTERS_EQUAL(item, irc_modelist_item_search_mask (modelist, "c!*@*"));
+    irc_upgrade_pack_free (&pack);
+}
+
+/*
+ * Tests functions:
+ *   irc_upgrade_pack_redirects
+ *   irc_upgrade_unpack_redirects
+ *   irc_upgrade_pack_notify_list
+ *   irc_upgrade_unpack_notify_list
+ *   irc_upgrade_pack_raw_messages
+ *   irc_upgrade_unpack_raw_messages
+ */
+
+TEST(IrcUpgradeWithServer, PackRedirectsNotifyRaw)
+{
+    struct t_irc_redirect *redirect;
+    struct t_irc_notify *notify;
+    struct t_irc_raw_message *raw_message;
+    struct t_irc_upgrade_pack pack, pack_read;
+    int *ptr_value;
+
+    /* redirects */
+    irc_redirect_free_all (server);
+    redirect = irc_redirect_new_with_commands (server, "test_pattern",
+                                               "test_signal", 2, "alice", 30,
+                                               "311:1", "318:1", "319",
+                                               "311,318");
+    CHECK(redirect);
+    redirect->current_count = 2;
+    redirect->command = strdup ("WHOIS alice");
+    redirect->assigned_to_command = 1;
+    redirect->start_time = 1614592800;
+    redirect->output = strdup ("output");
+    redirect->output_size = 6;
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    LONGS_EQUAL(1, irc_upgrade_pack_redirects (&pack, server));
+    irc_redirect_free_all (server);
+    POINTERS_EQUAL(NULL, server->redirects);
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_redirects (&pack_read, server);
+    LONGS_EQUAL(0, pack_read.error);
+    LONGS_EQUAL(pack.size, pack_read.pos);
+    redirect = server->redirects;
+    CHECK(redirect);
+    POINTERS_EQUAL(NULL, redirect->next_redirect);
+    STRCMP_EQUAL("test_pattern", redirect->pattern);
+    STRCMP_EQUAL("test_signal", redirect->signal);
+    LONGS_EQUAL(2, redirect->count);
+    STRCMP_EQUAL("alice", redirect->string);
+    LONGS_EQUAL(30, redirect->timeout);
+    ptr_value = (int *)hashtable_get (redirect->cmd_start, "311");
+    CHECK(ptr_value);
+    LONGS_EQUAL(1, *ptr_value);
+    LONGS_EQUAL(1, redirect->cmd_stop->items_count);
+    LONGS_EQUAL(1, redirect->cmd_extra->items_count);
+    CHECK(hashtable_has_key (redirect->cmd_extra, "319"));
+    LONGS_EQUAL(2, redirect->cmd_filter->items_count);
+    CHECK(hashtable_has_key (redirect->cmd_filter, "311"));
+    CHECK(hashtable_has_key (redirect->cmd_filter, "318"));
+    LONGS_EQUAL(2, redirect->current_count);
+    STRCMP_EQUAL("WHOIS alice", redirect->command);
+    LONGS_EQUAL(1, redirect->assigned_to_command);
+    LONGS_EQUAL(1614592800, redirect->start_time);
+    STRCMP_EQUAL("output", redirect->output);
+    LONGS_EQUAL(6, redirect->output_size);
+    irc_redirect_free_all (server);
+    irc_upgrade_pack_free (&pack);
+
+    /* notify list (only state of existing notify is restored) */
+    notify = irc_notify_new (server, "bob", 1);
+    CHECK(notify);
+    notify->is_on_server = 1;
+    notify->away_message = strdup ("gone");
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    LONGS_EQUAL(1, irc_upgrade_pack_notify_list (&pack, server));
+    notify->is_on_server = 0;
+    free (notify->away_message);
+    notify->away_message = NULL;
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_notify_list (&pack_read, server);
+    LONGS_EQUAL(0, pack_read.error);
+    LONGS_EQUAL(pack.size, pack_read.pos);
+    LONGS_EQUAL(1, notify->is_on_server);
+    STRCMP_EQUAL("gone", notify->away_message);
+    irc_notify_free_all (server);
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_notify_list (&pack_read, server);
+    LONGS_EQUAL(0, pack_read.error);
+    POINTERS_EQUAL(NULL, server->notify_list);
+    irc_upgrade_pack_free (&pack);
+
+    /* raw messages (messages without server are not restored) */
+    irc_raw_message_free_all ();
+    irc_raw_message_add_to_list (1000, server, IRC_RAW_FLAG_RECV,
+                                 ":alice!user@host PRIVMSG #test :hello");
+    irc_raw_message_add_to_list (1001, NULL, IRC_RAW_FLAG_SEND, "PING :x");
+    irc_raw_message_add_to_list (1002, server,
+                                 IRC_RAW_FLAG_SEND | IRC_RAW_FLAG_MODIFIED,
+                                 "PRIVMSG #test :hi");
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    LONGS_EQUAL(3, irc_upgrade_pack_raw_messages (&pack));
+    irc_raw_message_free_all ();
+    irc_upgrade_pack_init (&pack_read, pack.data, pack.size);
+    irc_upgrade_unpack_raw_messages (&pack_read);
+    LONGS_EQUAL(0, pack_read.error);
+    LONGS_EQUAL(pack.size, pack_read.pos);
+    LONGS_EQUAL(2, irc_raw_messages_count);
+    raw_message = irc_raw_message_get (0);
+    CHECK(raw_message);
+    LONGS_EQUAL(1000, raw_message->date);
+    POINTERS_EQUAL(server, raw_message->server);
+    LONGS_EQUAL(IRC_RAW_FLAG_RECV, raw_message->flags);
+    STRCMP_EQUAL(":alice!user@host PRIVMSG #test :hello",
+                 raw_message->message);
+    raw_message = irc_raw_message_get (1);
+    CHECK(raw_message);
+    LONGS_EQUAL(1002, raw_message->date);
+    POINTERS_EQUAL(server, raw_message->server);
+    LONGS_EQUAL(IRC_RAW_FLAG_SEND | IRC_RAW_FLAG_MODIFIED, raw_message->flags);
+    STRCMP_EQUAL("PRIVMSG #test :hi", raw_message->message);
+    irc_raw_message_free_all ();
+    irc_upgrade_pack_free (&pack);
+}
+
+/*
+ * Tests functions:
+ *   irc_upgrade_write_pack
+ *   irc_upgrade_read_cb (packed nicks)
+ */
+
+TEST(IrcUpgradeWithServer, WriteReadPack)
+{
+    struct t_irc_channel *channel, *channel2;
+    struct t_irc_nick *ptr_nick;
+    struct t_upgrade_file *upgrade_file;
+    struct t_irc_upgrade_pack pack;
+
+    channel = irc_channel_search (server, "#test");
+    channel2 = irc_channel_search (server, "#test2");
+    CHECK(channel);
+    CHECK(channel2);
+
+    irc_nick_new (server, channel, "bob", "user@host.example.com", "@", 0,
+                  NULL, NULL);
+    irc_nick_new (server, channel, "carol", NULL, " ", 1, NULL, NULL);
+
+    upgrade_file = upgrade_file_new (IRC_UPGRADE_TEST_FILE, NULL, NULL, NULL);
+    CHECK(upgrade_file);
+    irc_upgrade_pack_init (&pack, NULL, 0);
+    irc_upgrade_pack_nicks (&pack, channel);
+    CHECK(irc_upgrade_write_pack (upgrade_file, IRC_UPGRADE_TYPE_NICKS,
+                                  &pack));
+    irc_upgrade_pack_free (&pack);
+    upgrade_file_close (upgrade_file);
+
+    irc_nick_free_all (server, channel2);
+    LONGS_EQUAL(1, read_file (channel2));
+    LONGS_EQUAL(channel->nicks_count, channel2->nicks_count);
+    ptr_nick = irc_nick_search (server, channel2, "bob");
+    CHECK(ptr_nick);
+    STRCMP_EQUAL("user@host.example.com", ptr_nick->host);
+    ptr_nick = irc_nick_search (server, channel2, "carol");
+    CHECK(ptr_nick);
+    LONGS_EQUAL(1, ptr_nick->away);
+}
@@ -0,0 +1,341 @@
+/*
+ * test-relay-irc-backlog.cpp - test backlog of IRC channels (relay)
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/relay/relay.h"
+#include "src/plugins/relay/relay-client.h"
+#include "src/plugins/relay/irc/relay-irc-backlog.h"
+}
+
+#define DATE_2021 1609459200
+
+TEST_GROUP(RelayIrcBacklog)
+{
+};
+
+/*
+ * Tests functions:
+ *   relay_irc_backlog_index_get
+ *   relay_irc_backlog_index_extend
+ *   relay_irc_backlog_index_search_date
+ *   relay_irc_backlog_index_unref
+ */
+
+TEST(RelayIrcBacklog, Index)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_irc_backlog_index *index, *index2;
+    int i;
+
+    POINTERS_EQUAL(NULL, relay_irc_backlog_index_get (NULL));
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+
+    for (i = 0; i < 10; i++)
+    {
+        gui_chat_printf_date_tags (test_buffer, DATE_2021 + (i * 60),
+                                   "irc_privmsg,nick_alice",
+                                   "alice\tmessage %d", i);
+    }
+
+    index = relay_irc_backlog_index_get (test_buffer);
+    CHECK(index);
+    POINTERS_EQUAL(test_buffer, index->buffer);
+    LONGS_EQUAL(0, index->num_lines);
+    LONGS_EQUAL(0, index->complete);
+    LONGS_EQUAL(10, index->lines_count);
+    LONGS_EQUAL(1, index->refcount);
+
+    /* same buffer: index is shared */
+    index2 = relay_irc_backlog_index_get (test_buffer);
+    POINTERS_EQUAL(index, index2);
+    LONGS_EQUAL(2, index->refcount);
+    relay_irc_backlog_index_unref (index2);
+    LONGS_EQUAL(1, index->refcount);
+
+    /* extend index with all lines, from newest to oldest */
+    for (i = 0; i < 10; i++)
+    {
+        LONGS_EQUAL(1, relay_irc_backlog_index_extend (index));
+    }
+    LONGS_EQUAL(0, relay_irc_backlog_index_extend (index));
+    LONGS_EQUAL(10, index->num_lines);
+    LONGS_EQUAL(1, index->complete);
+    LONGS_EQUAL(-10, index->first_position);
+    POINTERS_EQUAL(test_buffer->own_lines->first_line,
+                   index->lines[index->start].line);
+    LONGS_EQUAL(DATE_2021, index->lines[index->start].date);
+    POINTERS_EQUAL(test_buffer->own_lines->last_line,
+                   index->lines[index->start + 9].line);
+
+    /* search by date */
+    LONGS_EQUAL(-10, relay_irc_backlog_index_search_date (index, 0));
+    LONGS_EQUAL(-10, relay_irc_backlog_index_search_date (index, DATE_2021));
+    LONGS_EQUAL(-9, relay_irc_backlog_index_search_date (index,
+                                                         DATE_2021 + 1));
+    LONGS_EQUAL(-5, relay_irc_backlog_index_search_date (index,
+                                                         DATE_2021 + 300));
+    LONGS_EQUAL(0, relay_irc_backlog_index_search_date (index,
+                                                        DATE_2021 + 3600));
+
+    /* new line in buffer: index is updated */
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 600,
+                               "irc_privmsg,nick_bob", "bob\tnew message");
+    LONGS_EQUAL(11, index->num_lines);
+    LONGS_EQUAL(11, index->lines_count);
+    LONGS_EQUAL(-10, index->first_position);
+    POINTERS_EQUAL(test_buffer->own_lines->last_line,
+                   index->lines[index->start + 10].line);
+    LONGS_EQUAL(0, relay_irc_backlog_index_search_date (index,
+                                                        DATE_2021 + 600));
+    index2 = relay_irc_backlog_index_get (test_buffer);
+    POINTERS_EQUAL(index, index2);
+    relay_irc_backlog_index_unref (index2);
+
+    /* buffer cleared: index is dropped */
+    gui_buffer_clear (test_buffer);
+    POINTERS_EQUAL(NULL, index->buffer);
+    LONGS_EQUAL(0, index->num_lines);
+    index2 = relay_irc_backlog_index_get (test_buffer);
+    CHECK(index2);
+    CHECK(index2 != index);
+    LONGS_EQUAL(1, index2->complete);
+    LONGS_EQUAL(0, relay_irc_backlog_index_extend (index2));
+    relay_irc_backlog_index_unref (index2);
+
+    relay_irc_backlog_index_unref (index);
+    relay_irc_backlog_index_unref (NULL);
+
+    gui_buffer_close (test_buffer);
+}
+
+/*
+ * Tests functions:
+ *   relay_irc_backlog_get
+ *   relay_irc_backlog_run
+ *   relay_irc_backlog_unref
+ *   relay_irc_backlog_clear_cache
+ */
+
+TEST(RelayIrcBacklog, GetRun)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_irc_backlog *backlog, *backlog2;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+
+    gui_chat_printf_date_tags (test_buffer, DATE_2021,
+                               "irc_privmsg,nick_alice,host_alice@host",
+                               "alice\thello");
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 60,
+                               "no_irc_tag", "not an IRC message");
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 120,
+                               "irc_privmsg,nick_bob,host_bob@host",
+                               "bob\thi alice");
+
+    POINTERS_EQUAL(NULL, relay_irc_backlog_get (NULL, "server", "#chan",
+                                                1, 0));
+    POINTERS_EQUAL(NULL, relay_irc_backlog_get (test_buffer, NULL, "#chan",
+                                                1, 0));
+    POINTERS_EQUAL(NULL, relay_irc_backlog_get (test_buffer, "server", NULL,
+                                                1, 0));
+
+    backlog = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    CHECK(backlog);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_SELECT, backlog->status);
+    LONGS_EQUAL(1, backlog->refcount);
+
+    /* backlog not built yet: it is shared */
+    backlog2 = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    POINTERS_EQUAL(backlog, backlog2);
+    LONGS_EQUAL(2, backlog->refcount);
+    relay_irc_backlog_unref (backlog2);
+
+    /* other parameters: new backlog */
+    backlog2 = relay_irc_backlog_get (test_buffer, "server", "#chan", 0, 0);
+    CHECK(backlog2);
+    CHECK(backlog2 != backlog);
+    relay_irc_backlog_unref (backlog2);
+
+    /* build the backlog */
+    CHECK(relay_irc_backlog_run (backlog, INT_MAX) > 0);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_DONE, backlog->status);
+    LONGS_EQUAL(2, backlog->count);
+    CHECK(backlog->data);
+    STRCMP_EQUAL("@time=2021-01-01T00:00:00.000Z "
+                 ":alice!alice@host PRIVMSG #chan :hello\r\n"
+                 "@time=2021-01-01T00:02:00.000Z "
+                 ":bob!bob@host PRIVMSG #chan :hi alice\r\n",
+                 backlog->data->buffer);
+    LONGS_EQUAL(strlen (backlog->data->buffer), backlog->data->size);
+
+    /* backlog built and no new line: it is reused */
+    backlog2 = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    POINTERS_EQUAL(backlog, backlog2);
+    relay_irc_backlog_unref (backlog2);
+
+    /* new line in buffer: backlog is not reused */
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 180,
+                               "irc_privmsg,nick_alice,host_alice@host",
+                               "alice\tbye");
+    backlog2 = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    CHECK(backlog2);
+    CHECK(backlog2 != backlog);
+    relay_irc_backlog_run (backlog2, INT_MAX);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_DONE, backlog2->status);
+    LONGS_EQUAL(3, backlog2->count);
+    relay_irc_backlog_unref (backlog2);
+
+    /* only lines since a date */
+    backlog2 = relay_irc_backlog_get (test_buffer, "server", "#chan", 1,
+                                      DATE_2021 + 100);
+    CHECK(backlog2);
+    relay_irc_backlog_run (backlog2, INT_MAX);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_DONE, backlog2->status);
+    LONGS_EQUAL(2, backlog2->count);
+    CHECK(backlog2->data);
+    CHECK(strstr (backlog2->data->buffer, ":bob!bob@host PRIVMSG"));
+    CHECK(strstr (backlog2->data->buffer, ":alice!alice@host PRIVMSG #chan :bye"));
+    POINTERS_EQUAL(NULL, strstr (backlog2->data->buffer, ":hello"));
+    relay_irc_backlog_unref (backlog2);
+
+    relay_irc_backlog_unref (backlog);
+    relay_irc_backlog_unref (NULL);
+    relay_irc_backlog_clear_cache ();
+    POINTERS_EQUAL(NULL, relay_irc_backlogs);
+
+    gui_buffer_close (test_buffer);
+    POINTERS_EQUAL(NULL, relay_irc_backlog_indexes);
+}
+
+/*
+ * Tests functions:
+ *   relay_irc_backlog_restart
+ */
+
+TEST(RelayIrcBacklog, Restart)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_irc_backlog *backlog;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+
+    gui_chat_printf_date_tags (test_buffer, DATE_2021,
+                               "irc_privmsg,nick_alice,host_alice@host",
+                               "alice\thello");
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 60,
+                               "irc_privmsg,nick_bob,host_bob@host",
+                               "bob\thi alice");
+
+    /* start the backlog, but do not build it */
+    backlog = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    CHECK(backlog);
+    CHECK(backlog->index);
+    LONGS_EQUAL(1, backlog->end_saved);
+    POINTERS_EQUAL(test_buffer->own_lines->last_line, backlog->end_line);
+    LONGS_EQUAL(DATE_2021 + 60, backlog->end_date);
+
+    /* new line in buffer, then index dropped: backlog is restarted */
+    gui_chat_printf_date_tags (test_buffer, DATE_2021 + 120,
+                               "irc_privmsg,nick_alice,host_alice@host",
+                               "alice\tbye");
+    relay_irc_backlog_index_drop (backlog->index);
+    POINTERS_EQUAL(NULL, backlog->index);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_SELECT, backlog->status);
+
+    /* line added after the first start is not in backlog */
+    relay_irc_backlog_run (backlog, INT_MAX);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_DONE, backlog->status);
+    LONGS_EQUAL(2, backlog->count);
+    CHECK(backlog->data);
+    STRCMP_EQUAL("@time=2021-01-01T00:00:00.000Z "
+                 ":alice!alice@host PRIVMSG #chan :hello\r\n"
+                 "@time=2021-01-01T00:01:00.000Z "
+                 ":bob!bob@host PRIVMSG #chan :hi alice\r\n",
+                 backlog->data->buffer);
+
+    relay_irc_backlog_unref (backlog);
+    relay_irc_backlog_clear_cache ();
+    POINTERS_EQUAL(NULL, relay_irc_backlogs);
+
+    gui_buffer_close (test_buffer);
+    POINTERS_EQUAL(NULL, relay_irc_backlog_indexes);
+}
+
+/*
+ * Tests functions:
+ *   relay_irc_backlog_get (buffer in a batch)
+ *   relay_irc_backlog_waiting_batch
+ *   relay_irc_backlog_buffer_closing
+ */
+
+TEST(RelayIrcBacklog, BufferClosedInBatch)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_irc_backlog *backlog;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+
+    gui_chat_printf_date_tags (test_buffer, DATE_2021,
+                               "irc_privmsg,nick_alice,host_alice@host",
+                               "alice\thello");
+
+    /* buffer in a batch: backlog is not started */
+    gui_buffer_batch_start (test_buffer);
+    backlog = relay_irc_backlog_get (test_buffer, "server", "#chan", 1, 0);
+    CHECK(backlog);
+    POINTERS_EQUAL(NULL, backlog->index);
+    POINTERS_EQUAL(NULL, relay_irc_backlog_indexes);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_SELECT, backlog->status);
+    LONGS_EQUAL(1, relay_irc_backlog_waiting_batch (backlog));
+    LONGS_EQUAL(0, relay_irc_backlog_run (backlog, INT_MAX));
+    LONGS_EQUAL(1, relay_irc_backlog_waiting_batch (backlog));
+
+    /* buffer closed during the batch: backlog is ended without the buffer */
+    gui_buffer_close (test_buffer);
+    POINTERS_EQUAL(NULL, backlog->buffer);
+    LONGS_EQUAL(RELAY_IRC_BACKLOG_STATUS_DONE, backlog->status);
+    LONGS_EQUAL(0, backlog->count);
+    LONGS_EQUAL(0, relay_irc_backlog_waiting_batch (backlog));
+    LONGS_EQUAL(0, relay_irc_backlog_run (backlog, INT_MAX));
+
+    relay_irc_backlog_unref (backlog);
+    relay_irc_backlog_clear_cache ();
+    POINTERS_EQUAL(NULL, relay_irc_backlogs);
+    POINTERS_EQUAL(NULL, relay_irc_backlog_indexes);
+}
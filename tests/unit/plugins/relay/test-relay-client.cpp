@@ -0,0 +1,543 @@
+/*
+ * test-relay-client.cpp - test client functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include "src/core/wee-hashtable.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/plugins/relay/relay.h"
+#include "src/plugins/relay/relay-client.h"
+#include "src/plugins/relay/relay-websocket.h"
+#include "src/plugins/relay/weechat/relay-weechat.h"
+#include "src/plugins/relay/weechat/relay-weechat-msg.h"
+#include "src/plugins/relay/weechat/relay-weechat-protocol.h"
+}
+
+TEST_GROUP(RelayClient)
+{
+};
+
+/*
+ * Tests functions:
+ *   relay_client_data_new
+ *   relay_client_data_unref
+ */
+
+TEST(RelayClient, DataNewUnref)
+{
+    struct t_relay_client_data *data;
+    char buffer[16], *buffer2;
+
+    strcpy (buffer, "test");
+
+    POINTERS_EQUAL(NULL, relay_client_data_new (NULL, 4, 1));
+    POINTERS_EQUAL(NULL, relay_client_data_new (buffer, 0, 1));
+
+    /* data copied */
+    data = relay_client_data_new (buffer, 4, 1);
+    CHECK(data);
+    CHECK(data->buffer != buffer);
+    MEMCMP_EQUAL("test", data->buffer, 4);
+    LONGS_EQUAL(4, data->size);
+    LONGS_EQUAL(1, data->refcount);
+    relay_client_data_unref (data);
+
+    /* data not copied (freed with data) */
+    buffer2 = strdup ("test");
+    data = relay_client_data_new (buffer2, 4, 0);
+    CHECK(data);
+    POINTERS_EQUAL(buffer2, data->buffer);
+    data->refcount++;
+    relay_client_data_unref (data);
+    LONGS_EQUAL(1, data->refcount);
+    relay_client_data_unref (data);
+
+    relay_client_data_unref (NULL);
+}
+
+TEST_GROUP(RelayClientWithSocket)
+{
+    struct t_relay_client client;
+    int sock[2];
+
+    void setup ()
+    {
+        int flags;
+
+        /* the client socket is one end of a socket pair */
+        sock[0] = -1;
+        sock[1] = -1;
+        LONGS_EQUAL(0, socketpair (AF_UNIX, SOCK_STREAM, 0, sock));
+        flags = fcntl (sock[0], F_GETFL);
+        fcntl (sock[0], F_SETFL, flags | O_NONBLOCK);
+        flags = fcntl (sock[1], F_GETFL);
+        fcntl (sock[1], F_SETFL, flags | O_NONBLOCK);
+
+        memset (&client, 0, sizeof (client));
+        client.sock = sock[0];
+        client.protocol = RELAY_PROTOCOL_WEECHAT;
+        client.status = RELAY_STATUS_CONNECTED;
+        client.send_data_type = RELAY_CLIENT_DATA_BINARY;
+    }
+
+    void teardown ()
+    {
+        if (client.protocol_data)
+            relay_weechat_free (&client);
+        if (client.ws_deflate)
+            relay_websocket_deflate_free (client.ws_deflate);
+        if (client.outqueue_keys)
+            hashtable_free (client.outqueue_keys);
+        if (sock[0] >= 0)
+            close (sock[0]);
+        if (sock[1] >= 0)
+            close (sock[1]);
+    }
+};
+
+/*
+ * Tests functions:
+ *   relay_client_send
+ *   relay_client_send_data
+ *   relay_client_send_outqueue
+ */
+
+TEST(RelayClientWithSocket, SendOutqueue)
+{
+    struct t_relay_client_data *data;
+    char *buffer, *received;
+    int size, num_sent, num_read, total_sent, total_read;
+
+    size = 64 * 1024;
+    buffer = (char *)malloc (size);
+    received = (char *)malloc (size * 8);
+    CHECK(buffer);
+    CHECK(received);
+    memset (buffer, 'a', size);
+    data = relay_client_data_new (buffer, size, 1);
+    CHECK(data);
+
+    /* fill the socket until some data is queued */
+    total_sent = 0;
+    while (!client.outqueue && (total_sent < size * 8))
+    {
+        num_sent = relay_client_send (&client, RELAY_CLIENT_MSG_STANDARD,
+                                      buffer, size, "test");
+        CHECK(num_sent >= 0);
+        total_sent += size;
+    }
+    CHECK(client.outqueue);
+
+    /* shared data is not copied when it is queued */
+    LONGS_EQUAL(0, relay_client_send_data (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           data, "test"));
+    total_sent += size;
+    POINTERS_EQUAL(data, client.last_outqueue->data);
+    LONGS_EQUAL(0, client.last_outqueue->data_sent);
+    LONGS_EQUAL(2, data->refcount);
+
+    /* read data and send outqueue until it is empty */
+    total_read = 0;
+    while (total_read < total_sent)
+    {
+        num_read = read (sock[1], received, size * 8);
+        if (num_read > 0)
+            total_read += num_read;
+        relay_client_send_outqueue (&client);
+        if ((num_read <= 0) && !client.outqueue)
+            break;
+    }
+    LONGS_EQUAL(total_sent, total_read);
+    POINTERS_EQUAL(NULL, client.outqueue);
+    POINTERS_EQUAL(NULL, client.last_outqueue);
+    LONGS_EQUAL(1, data->refcount);
+    LONGS_EQUAL(total_sent, client.bytes_sent);
+
+    relay_client_data_unref (data);
+    free (buffer);
+    free (received);
+}
+
+/*
+ * Tests functions:
+ *   relay_client_send_full
+ */
+
+TEST(RelayClientWithSocket, SendFullKey)
+{
+    char *buffer, *received;
+    int size, num_sent, num_read, total_sent, total_read, count, queued;
+
+    size = 64 * 1024;
+    buffer = (char *)malloc (size);
+    received = (char *)malloc (size * 9);
+    CHECK(buffer);
+    CHECK(received);
+    memset (buffer, 'a', size);
+
+    /* fill the socket until some data is queued */
+    total_sent = 0;
+    while (!client.outqueue && (total_sent < size * 8))
+    {
+        num_sent = relay_client_send (&client, RELAY_CLIENT_MSG_STANDARD,
+                                      buffer, size, "test");
+        CHECK(num_sent >= 0);
+        total_sent += size;
+    }
+    CHECK(client.outqueue);
+    count = client.outqueue_count;
+    queued = client.outqueue_size;
+    CHECK(queued > 0);
+
+    /* first message with a key is queued */
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1", 6, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(count + 1, client.outqueue_count);
+    LONGS_EQUAL(queued + 6, client.outqueue_size);
+    LONGS_EQUAL(0, client.msgs_coalesced);
+
+    /* message with another key is queued */
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title2", 6, NULL, "title:2",
+                                           NULL));
+    LONGS_EQUAL(count + 2, client.outqueue_count);
+    LONGS_EQUAL(queued + 12, client.outqueue_size);
+    LONGS_EQUAL(0, client.msgs_coalesced);
+
+    /* message with same key replaces the first one */
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1-new", 10, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(count + 2, client.outqueue_count);
+    LONGS_EQUAL(queued + 16, client.outqueue_size);
+    LONGS_EQUAL(1, client.msgs_coalesced);
+    MEMCMP_EQUAL("title1-new", client.last_outqueue->data->buffer, 10);
+    STRCMP_EQUAL("title:1", client.last_outqueue->key);
+    LONGS_EQUAL(2, client.outqueue_keys->items_count);
+    total_sent += 16;
+
+    /* read all data and send outqueue until it is empty */
+    total_read = 0;
+    while (total_read < total_sent)
+    {
+        num_read = read (sock[1], received + total_read,
+                         (size * 9) - total_read);
+        if (num_read > 0)
+            total_read += num_read;
+        relay_client_send_outqueue (&client);
+        if ((num_read <= 0) && !client.outqueue)
+            break;
+    }
+    LONGS_EQUAL(total_sent, total_read);
+    MEMCMP_EQUAL("title2title1-new", received + total_read - 16, 16);
+    POINTERS_EQUAL(NULL, client.outqueue);
+    LONGS_EQUAL(0, client.outqueue_count);
+    LONGS_EQUAL(0, client.outqueue_size);
+    LONGS_EQUAL(0, client.outqueue_keys->items_count);
+
+    free (buffer);
+    free (received);
+}
+
+/*
+ * Decodes websocket frames sent by relay (not masked) and inflates their
+ * payload if bit RSV1 is set; the payloads are concatenated in "output".
+ *
+ * Returns number of frames decoded, -1 if error.
+ */
+
+int
+test_relay_client_inflate_frames (z_stream *strm, const unsigned char *data,
+                                  int size, char *output, int output_max,
+                                  int *output_size)
+{
+    unsigned char *payload;
+    unsigned long long length;
+    int pos, count, deflated, rc;
+
+    pos = 0;
+    count = 0;
+    *output_size = 0;
+    while (pos + 2 <= size)
+    {
+        deflated = data[pos] & 0x40;
+        length = data[pos + 1] & 0x7F;
+        if (length == 126)
+        {
+            length = ((unsigned long long)data[pos + 2] << 8) | data[pos + 3];
+            pos += 4;
+        }
+        else if (length == 127)
+        {
+            length = 0;
+            for (rc = 0; rc < 8; rc++)
+                length = (length << 8) | data[pos + 2 + rc];
+            pos += 10;
+        }
+        else
+        {
+            pos += 2;
+        }
+        if ((pos + (int)length > size)
+            || (*output_size + (int)length > output_max))
+        {
+            return -1;
+        }
+        if (deflated)
+        {
+            /* append the 4 bytes removed by the sender (RFC 7692) */
+            payload = (unsigned char *)malloc (length + 4);
+            memcpy (payload, data + pos, length);
+            memcpy (payload + length, "\x00\x00\xff\xff", 4);
+            strm->next_in = payload;
+            strm->avail_in = length + 4;
+            strm->next_out = (Bytef *)(output + *output_size);
+            strm->avail_out = output_max - *output_size;
+            rc = inflate (strm, Z_SYNC_FLUSH);
+            free (payload);
+            if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+                return -1;
+            *output_size = (char *)strm->next_out - output;
+        }
+        else
+        {
+            memcpy (output + *output_size, data + pos, length);
+            *output_size += length;
+        }
+        pos += length;
+        count++;
+    }
+
+    return (pos == size) ? count : -1;
+}
+
+/*
+ * Tests functions:
+ *   relay_client_send_full (key ignored with websocket "permessage-deflate")
+ */
+
+TEST(RelayClientWithSocket, SendFullKeyWebsocketDeflate)
+{
+    z_stream strm;
+    char *buffer, *output;
+    unsigned char *received;
+    int size, i, count, total_read, num_read, output_size;
+
+    client.websocket = 2;
+    client.ws_deflate = relay_websocket_deflate_alloc ();
+    CHECK(client.ws_deflate);
+    relay_websocket_parse_extensions ("permessage-deflate", client.ws_deflate);
+    LONGS_EQUAL(1, client.ws_deflate->enabled);
+    LONGS_EQUAL(1, client.ws_deflate->server_context_takeover);
+
+    /* data not compressible, to fill the socket */
+    size = 64 * 1024;
+    buffer = (char *)malloc (size);
+    received = (unsigned char *)malloc (size * 64);
+    output = (char *)malloc (size * 64);
+    CHECK(buffer);
+    CHECK(received);
+    CHECK(output);
+    srand (1);
+    for (i = 0; i < size; i++)
+    {
+        buffer[i] = rand () & 0xFF;
+    }
+
+    count = 0;
+    while (!client.outqueue && (count < 32))
+    {
+        CHECK(relay_client_send (&client, RELAY_CLIENT_MSG_STANDARD,
+                                 buffer, size, "test") >= 0);
+        count++;
+    }
+    CHECK(client.outqueue);
+    count = client.outqueue_count;
+
+    /* messages with same key are all queued: nothing is replaced */
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1", 6, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title2", 6, NULL, "title:2",
+                                           NULL));
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1-new", 10, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(count + 3, client.outqueue_count);
+    LONGS_EQUAL(0, client.msgs_coalesced);
+
+    /* read all data */
+    total_read = 0;
+    while (1)
+    {
+        num_read = read (sock[1], received + total_read,
+                         (size * 64) - total_read);
+        if (num_read > 0)
+            total_read += num_read;
+        relay_client_send_outqueue (&client);
+        if ((num_read <= 0) && !client.outqueue)
+            break;
+    }
+    POINTERS_EQUAL(NULL, client.outqueue);
+
+    /* all frames can be inflated, in order */
+    memset (&strm, 0, sizeof (strm));
+    LONGS_EQUAL(Z_OK, inflateInit2 (&strm, -15));
+    CHECK(test_relay_client_inflate_frames (&strm, received, total_read,
+                                            output, size * 64,
+                                            &output_size) > 3);
+    inflateEnd (&strm);
+    CHECK(output_size > 22);
+    MEMCMP_EQUAL("title1title2title1-new", output + output_size - 22, 22);
+    MEMCMP_EQUAL(buffer, output, size);
+
+    /* without context takeover, a message with same key is replaced */
+    relay_websocket_deflate_reinit (client.ws_deflate);
+    relay_websocket_parse_extensions (
+        "permessage-deflate; server_no_context_takeover", client.ws_deflate);
+    LONGS_EQUAL(0, client.ws_deflate->server_context_takeover);
+    while (!client.outqueue)
+    {
+        CHECK(relay_client_send (&client, RELAY_CLIENT_MSG_STANDARD,
+                                 buffer, size, "test") >= 0);
+    }
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1", 6, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(0, relay_client_send_full (&client,
+                                           RELAY_CLIENT_MSG_STANDARD,
+                                           "title1-new", 10, NULL, "title:1",
+                                           NULL));
+    LONGS_EQUAL(1, client.msgs_coalesced);
+    while (client.outqueue)
+    {
+        while (read (sock[1], received, size * 64) > 0)
+        {
+        }
+        relay_client_send_outqueue (&client);
+    }
+
+    free (buffer);
+    free (received);
+    free (output);
+}
+
+/*
+ * Tests functions:
+ *   relay_client_send_outqueue (cursor in stream mode)
+ *   relay_weechat_protocol_cursors_stream
+ */
+
+TEST(RelayClientWithSocket, SendOutqueueCursorStream)
+{
+    struct t_relay_client *ptr_client;
+    struct t_relay_weechat_cursor *cursor;
+    struct t_gui_buffer *test_buffer;
+    char *buffer, *received, path[128];
+    int i, size, pages, changes;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+    for (i = 0; i < 10; i++)
+    {
+        gui_chat_printf (test_buffer, "line %d", i + 1);
+    }
+
+    ptr_client = &client;
+    relay_weechat_alloc (&client);
+    CHECK(client.protocol_data);
+
+    snprintf (path, sizeof (path),
+              "buffer:0x%lx/own_lines/last_line(-10)/data",
+              (unsigned long)test_buffer);
+    cursor = relay_weechat_cursor_new (&client, "test", path, "message", 1);
+    CHECK(cursor);
+    LONGS_EQUAL(1, relay_weechat_cursors_opened);
+    LONGS_EQUAL(relay_weechat_cursors_changes, cursor->changes);
+
+    /* a signal is a change: position of cursor will be checked */
+    changes = relay_weechat_cursors_changes;
+    gui_chat_printf (test_buffer, "line 11");
+    CHECK(relay_weechat_cursors_changes > changes);
+
+    /* fill the socket until some data is queued */
+    size = 64 * 1024;
+    buffer = (char *)malloc (size);
+    received = (char *)malloc (size);
+    CHECK(buffer);
+    CHECK(received);
+    memset (buffer, 'a', size);
+    while (!client.outqueue)
+    {
+        CHECK(relay_client_send (&client, RELAY_CLIENT_MSG_STANDARD,
+                                 buffer, size, "test") >= 0);
+    }
+
+    /* client has not read previous data: no page is sent */
+    cursor->stream = 1;
+    relay_weechat_protocol_cursors_stream (&client);
+    POINTERS_EQUAL(cursor,
+                   hashtable_get (RELAY_WEECHAT_DATA(ptr_client, cursors),
+                                  "1"));
+    LONGS_EQUAL(0, cursor->hdata->started);
+
+    /* pages are sent when the outqueue is empty, until the cursor ends */
+    for (pages = 0; pages < 100; pages++)
+    {
+        while (read (sock[1], received, size) > 0)
+        {
+        }
+        relay_client_send_outqueue (&client);
+        if (!client.outqueue
+            && !hashtable_get (RELAY_WEECHAT_DATA(ptr_client, cursors), "1"))
+        {
+            break;
+        }
+    }
+    CHECK(pages < 100);
+    LONGS_EQUAL(0, RELAY_WEECHAT_DATA(ptr_client, cursors)->items_count);
+    LONGS_EQUAL(0, relay_weechat_cursors_opened);
+
+    free (buffer);
+    free (received);
+    gui_buffer_close (test_buffer);
+}
@@ -0,0 +1,184 @@
+/*
+ * test-relay-filter.cpp - test filters on lines (relay)
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/relay/relay-filter.h"
+}
+
+TEST_GROUP(RelayFilter)
+{
+};
+
+/*
+ * Tests functions:
+ *   relay_filter_search_notify_level
+ */
+
+TEST(RelayFilter, SearchNotifyLevel)
+{
+    LONGS_EQUAL(-1, relay_filter_search_notify_level (NULL));
+    LONGS_EQUAL(-1, relay_filter_search_notify_level (""));
+    LONGS_EQUAL(-1, relay_filter_search_notify_level ("xxx"));
+
+    LONGS_EQUAL(0, relay_filter_search_notify_level ("low"));
+    LONGS_EQUAL(1, relay_filter_search_notify_level ("message"));
+    LONGS_EQUAL(2, relay_filter_search_notify_level ("private"));
+    LONGS_EQUAL(3, relay_filter_search_notify_level ("highlight"));
+}
+
+/*
+ * Tests functions:
+ *   relay_filter_valid
+ */
+
+TEST(RelayFilter, Valid)
+{
+    LONGS_EQUAL(1, relay_filter_valid (NULL));
+    LONGS_EQUAL(1, relay_filter_valid (""));
+    LONGS_EQUAL(1, relay_filter_valid ("tags=irc_privmsg"));
+    LONGS_EQUAL(1, relay_filter_valid ("tags=!irc_join+!irc_part,irc_*"));
+    LONGS_EQUAL(1, relay_filter_valid ("notify=message"));
+    LONGS_EQUAL(1, relay_filter_valid ("  tags=irc_privmsg  notify=low  "));
+
+    LONGS_EQUAL(0, relay_filter_valid ("xxx"));
+    LONGS_EQUAL(0, relay_filter_valid ("tags"));
+    LONGS_EQUAL(0, relay_filter_valid ("tags="));
+    LONGS_EQUAL(0, relay_filter_valid ("notify=xxx"));
+    LONGS_EQUAL(0, relay_filter_valid ("unknown=1"));
+    LONGS_EQUAL(0, relay_filter_valid ("tags=irc_privmsg xxx"));
+}
+
+/*
+ * Tests functions:
+ *   relay_filter_get
+ *   relay_filter_unref
+ */
+
+TEST(RelayFilter, GetUnref)
+{
+    struct t_relay_filter *filter, *filter2;
+
+    POINTERS_EQUAL(NULL, relay_filter_get (NULL));
+    POINTERS_EQUAL(NULL, relay_filter_get (""));
+    POINTERS_EQUAL(NULL, relay_filter_get ("notify=xxx"));
+
+    filter = relay_filter_get ("tags=!irc_join+!irc_part,irc_* notify=message");
+    CHECK(filter);
+    STRCMP_EQUAL("tags=!irc_join+!irc_part,irc_* notify=message",
+                 filter->string);
+    LONGS_EQUAL(2, filter->tags_count);
+    STRCMP_EQUAL("!irc_join", filter->tags_array[0][0]);
+    STRCMP_EQUAL("!irc_part", filter->tags_array[0][1]);
+    POINTERS_EQUAL(NULL, filter->tags_array[0][2]);
+    STRCMP_EQUAL("irc_*", filter->tags_array[1][0]);
+    POINTERS_EQUAL(NULL, filter->tags_array[1][1]);
+    LONGS_EQUAL(1, filter->notify_level);
+    LONGS_EQUAL(1, filter->refcount);
+
+    /* same string: filter is shared */
+    filter2 = relay_filter_get ("tags=!irc_join+!irc_part,irc_* notify=message");
+    POINTERS_EQUAL(filter, filter2);
+    LONGS_EQUAL(2, filter->refcount);
+    relay_filter_unref (filter2);
+    LONGS_EQUAL(1, filter->refcount);
+
+    /* other string: new filter */
+    filter2 = relay_filter_get ("notify=highlight");
+    CHECK(filter2);
+    CHECK(filter2 != filter);
+    LONGS_EQUAL(0, filter2->tags_count);
+    POINTERS_EQUAL(NULL, filter2->tags_array);
+    LONGS_EQUAL(3, filter2->notify_level);
+    relay_filter_unref (filter2);
+
+    relay_filter_unref (filter);
+    relay_filter_unref (NULL);
+}
+
+/*
+ * Tests functions:
+ *   relay_filter_match_line
+ */
+
+TEST(RelayFilter, MatchLine)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_filter *filter_tags, *filter_not_tags, *filter_notify;
+    struct t_gui_line_data *line_join, *line_msg, *line_none, *line_highlight;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+
+    gui_chat_printf_date_tags (test_buffer, 0, "irc_join,nick_alice",
+                               "alice has joined");
+    line_join = test_buffer->own_lines->last_line->data;
+    gui_chat_printf_date_tags (test_buffer, 0,
+                               "irc_privmsg,notify_message,nick_bob",
+                               "bob\thello");
+    line_msg = test_buffer->own_lines->last_line->data;
+    gui_chat_printf_date_tags (test_buffer, 0, "notify_none", "no notify");
+    line_none = test_buffer->own_lines->last_line->data;
+    gui_chat_printf_date_tags (test_buffer, 0,
+                               "irc_privmsg,notify_highlight,nick_bob",
+                               "bob\tping");
+    line_highlight = test_buffer->own_lines->last_line->data;
+
+    /* no filter: all lines match */
+    LONGS_EQUAL(1, relay_filter_match_line (NULL, line_join));
+    LONGS_EQUAL(1, relay_filter_match_line (NULL, line_none));
+
+    filter_tags = relay_filter_get ("tags=irc_priv*+nick_bob");
+    CHECK(filter_tags);
+    LONGS_EQUAL(0, relay_filter_match_line (filter_tags, NULL));
+    LONGS_EQUAL(0, relay_filter_match_line (filter_tags, line_join));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_tags, line_msg));
+    LONGS_EQUAL(0, relay_filter_match_line (filter_tags, line_none));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_tags, line_highlight));
+
+    filter_not_tags = relay_filter_get ("tags=!irc_join+!irc_part+!irc_quit");
+    CHECK(filter_not_tags);
+    LONGS_EQUAL(0, relay_filter_match_line (filter_not_tags, line_join));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_not_tags, line_msg));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_not_tags, line_none));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_not_tags, line_highlight));
+
+    filter_notify = relay_filter_get ("notify=message");
+    CHECK(filter_notify);
+    LONGS_EQUAL(0, relay_filter_match_line (filter_notify, line_join));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_notify, line_msg));
+    LONGS_EQUAL(0, relay_filter_match_line (filter_notify, line_none));
+    LONGS_EQUAL(1, relay_filter_match_line (filter_notify, line_highlight));
+
+    relay_filter_unref (filter_tags);
+    relay_filter_unref (filter_not_tags);
+    relay_filter_unref (filter_notify);
+
+    gui_buffer_close (test_buffer);
+}
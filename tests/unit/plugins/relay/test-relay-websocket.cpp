@@ -0,0 +1,296 @@
+/*
+ * test-relay-websocket.cpp - test websocket functions
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/plugins/relay/relay.h"
+#include "src/plugins/relay/relay-client.h"
+#include "src/plugins/relay/relay-websocket.h"
+}
+
+#define WS_CHECK_EXT(__enabled, __server_ctx, __client_ctx,             \
+                     __bits_deflate, __bits_inflate, __server_bits_recv, \
+                     __extensions)                                      \
+    relay_websocket_deflate_reinit (ws_deflate);                        \
+    relay_websocket_parse_extensions (__extensions, ws_deflate);        \
+    LONGS_EQUAL(__enabled, ws_deflate->enabled);                        \
+    LONGS_EQUAL(__server_ctx, ws_deflate->server_context_takeover);     \
+    LONGS_EQUAL(__client_ctx, ws_deflate->client_context_takeover);     \
+    LONGS_EQUAL(__bits_deflate, ws_deflate->window_bits_deflate);       \
+    LONGS_EQUAL(__bits_inflate, ws_deflate->window_bits_inflate);       \
+    LONGS_EQUAL(__server_bits_recv,                                     \
+                ws_deflate->server_max_window_bits_recv);
+
+/*
+ * Builds a frame sent by a client (masked) with an unmasked frame sent by
+ * the server.
+ *
+ * Note: result must be freed after use.
+ */
+
+unsigned char *
+test_relay_websocket_mask_frame (const char *frame,
+                                 unsigned long long length_frame,
+                                 unsigned long long *length_masked)
+{
+    unsigned char *masked, masks[4] = { 0x12, 0x34, 0x56, 0x78 };
+    unsigned long long i, length_header;
+
+    length_header = 2;
+    if ((frame[1] & 127) == 126)
+        length_header += 2;
+    else if ((frame[1] & 127) == 127)
+        length_header += 8;
+
+    masked = (unsigned char *)malloc (length_frame + 4);
+    memcpy (masked, frame, length_header);
+    masked[1] |= 128;
+    memcpy (masked + length_header, masks, 4);
+    for (i = length_header; i < length_frame; i++)
+    {
+        masked[i + 4] = (unsigned char)frame[i] ^ masks[(i - length_header) % 4];
+    }
+    *length_masked = length_frame + 4;
+
+    return masked;
+}
+
+TEST_GROUP(RelayWebsocket)
+{
+};
+
+/*
+ * Tests functions:
+ *   relay_websocket_deflate_alloc
+ *   relay_websocket_deflate_reinit
+ *   relay_websocket_deflate_free
+ *   relay_websocket_parse_extensions
+ */
+
+TEST(RelayWebsocket, ParseExtensions)
+{
+    struct t_relay_websocket_deflate *ws_deflate;
+
+    ws_deflate = relay_websocket_deflate_alloc ();
+    CHECK(ws_deflate);
+    LONGS_EQUAL(0, ws_deflate->enabled);
+    POINTERS_EQUAL(NULL, ws_deflate->strm_deflate);
+    POINTERS_EQUAL(NULL, ws_deflate->strm_inflate);
+
+    relay_websocket_parse_extensions (NULL, NULL);
+    relay_websocket_parse_extensions ("permessage-deflate", NULL);
+
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0, NULL);
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0, "");
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0, "x-webkit-deflate-frame");
+    WS_CHECK_EXT(1, 1, 1, 15, 15, 0, "permessage-deflate");
+    WS_CHECK_EXT(1, 1, 1, 15, 15, 0,
+                 "permessage-deflate; client_max_window_bits");
+    WS_CHECK_EXT(1, 0, 0, 15, 15, 0,
+                 "permessage-deflate; server_no_context_takeover; "
+                 "client_no_context_takeover");
+    WS_CHECK_EXT(1, 1, 1, 10, 12, 1,
+                 "permessage-deflate; server_max_window_bits=10; "
+                 "client_max_window_bits=\"12\"");
+
+    /* invalid/unsupported offers are declined */
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0,
+                 "permessage-deflate; server_max_window_bits=8");
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0,
+                 "permessage-deflate; server_max_window_bits");
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0,
+                 "permessage-deflate; client_max_window_bits=16");
+    WS_CHECK_EXT(0, 1, 1, 15, 15, 0,
+                 "permessage-deflate; unknown");
+
+    /* first offer accepted is used */
+    WS_CHECK_EXT(1, 0, 1, 15, 15, 0,
+                 "x-webkit-deflate-frame, "
+                 "permessage-deflate; unknown, "
+                 "permessage-deflate; server_no_context_takeover, "
+                 "permessage-deflate");
+
+    relay_websocket_deflate_free (ws_deflate);
+    relay_websocket_deflate_free (NULL);
+}
+
+/*
+ * Tests functions:
+ *   relay_websocket_deflate
+ *   relay_websocket_inflate
+ */
+
+TEST(RelayWebsocket, DeflateInflate)
+{
+    struct t_relay_websocket_deflate *ws_deflate;
+    const char *msg = "hdata buffer:gui_buffers(*) number,full_name,title";
+    char *deflated, *inflated;
+    unsigned long long size_deflated1, size_deflated2, size_inflated;
+
+    ws_deflate = relay_websocket_deflate_alloc ();
+    CHECK(ws_deflate);
+    relay_websocket_parse_extensions ("permessage-deflate", ws_deflate);
+
+    POINTERS_EQUAL(NULL, relay_websocket_deflate (NULL, 0, ws_deflate,
+                                                  &size_deflated1));
+    POINTERS_EQUAL(NULL, relay_websocket_inflate (NULL, 0, ws_deflate,
+                                                  &size_inflated));
+
+    /* first message */
+    deflated = relay_websocket_deflate (msg, strlen (msg), ws_deflate,
+                                        &size_deflated1);
+    CHECK(deflated);
+    CHECK(size_deflated1 > 0);
+    CHECK(ws_deflate->strm_deflate);
+    inflated = relay_websocket_inflate (deflated, size_deflated1, ws_deflate,
+                                        &size_inflated);
+    CHECK(inflated);
+    LONGS_EQUAL(strlen (msg), size_inflated);
+    MEMCMP_EQUAL(msg, inflated, size_inflated);
+    free (deflated);
+    free (inflated);
+
+    /* same message again: smaller with context takeover */
+    deflated = relay_websocket_deflate (msg, strlen (msg), ws_deflate,
+                                        &size_deflated2);
+    CHECK(deflated);
+    CHECK(size_deflated2 < size_deflated1);
+    inflated = relay_websocket_inflate (deflated, size_deflated2, ws_deflate,
+                                        &size_inflated);
+    CHECK(inflated);
+    LONGS_EQUAL(strlen (msg), size_inflated);
+    MEMCMP_EQUAL(msg, inflated, size_inflated);
+    free (deflated);
+    free (inflated);
+
+    /* no context takeover: same size for same message */
+    relay_websocket_deflate_reinit (ws_deflate);
+    relay_websocket_parse_extensions (
+        "permessage-deflate; server_no_context_takeover; "
+        "client_no_context_takeover",
+        ws_deflate);
+    deflated = relay_websocket_deflate (msg, strlen (msg), ws_deflate,
+                                        &size_deflated1);
+    CHECK(deflated);
+    free (deflated);
+    deflated = relay_websocket_deflate (msg, strlen (msg), ws_deflate,
+                                        &size_deflated2);
+    CHECK(deflated);
+    LONGS_EQUAL(size_deflated1, size_deflated2);
+    inflated = relay_websocket_inflate (deflated, size_deflated2, ws_deflate,
+                                        &size_inflated);
+    CHECK(inflated);
+    MEMCMP_EQUAL(msg, inflated, size_inflated);
+    free (deflated);
+    free (inflated);
+
+    /* invalid compressed data */
+    POINTERS_EQUAL(NULL, relay_websocket_inflate ("\xff\xff\xff\xff", 4,
+                                                  ws_deflate,
+                                                  &size_inflated));
+
+    relay_websocket_deflate_free (ws_deflate);
+}
+
+/*
+ * Tests functions:
+ *   relay_websocket_encode_frame
+ *   relay_websocket_decode_frame
+ */
+
+TEST(RelayWebsocket, EncodeDecodeFrame)
+{
+    struct t_relay_websocket_deflate *ws_deflate;
+    const char *msg = "init password=test";
+    char *frame;
+    unsigned char *masked, *decoded;
+    unsigned long long length_frame, length_masked, decoded_length;
+
+    /* without compression */
+    frame = relay_websocket_encode_frame (NULL, WEBSOCKET_FRAME_OPCODE_TEXT,
+                                          msg, strlen (msg), &length_frame);
+    CHECK(frame);
+    LONGS_EQUAL(0x81, (unsigned char)frame[0]);
+    LONGS_EQUAL(strlen (msg), frame[1]);
+    LONGS_EQUAL(2 + strlen (msg), length_frame);
+    MEMCMP_EQUAL(msg, frame + 2, strlen (msg));
+
+    /* frame not masked: error */
+    LONGS_EQUAL(0, relay_websocket_decode_frame (NULL,
+                                                 (unsigned char *)frame,
+                                                 length_frame,
+                                                 &decoded, &decoded_length));
+    free (decoded);
+
+    masked = test_relay_websocket_mask_frame (frame, length_frame,
+                                              &length_masked);
+    LONGS_EQUAL(1, relay_websocket_decode_frame (NULL, masked, length_masked,
+                                                 &decoded, &decoded_length));
+    LONGS_EQUAL(1 + strlen (msg) + 1, decoded_length);
+    LONGS_EQUAL(RELAY_CLIENT_MSG_STANDARD, decoded[0]);
+    STRCMP_EQUAL(msg, (const char *)decoded + 1);
+    free (decoded);
+    free (masked);
+    free (frame);
+
+    /* with compression */
+    ws_deflate = relay_websocket_deflate_alloc ();
+    CHECK(ws_deflate);
+    relay_websocket_parse_extensions ("permessage-deflate", ws_deflate);
+    frame = relay_websocket_encode_frame (ws_deflate,
+                                          WEBSOCKET_FRAME_OPCODE_TEXT,
+                                          msg, strlen (msg), &length_frame);
+    CHECK(frame);
+    LONGS_EQUAL(0xC1, (unsigned char)frame[0]);
+    masked = test_relay_websocket_mask_frame (frame, length_frame,
+                                              &length_masked);
+
+    /* compressed frame received without extension: error */
+    LONGS_EQUAL(0, relay_websocket_decode_frame (NULL, masked, length_masked,
+                                                 &decoded, &decoded_length));
+    free (decoded);
+
+    LONGS_EQUAL(1, relay_websocket_decode_frame (ws_deflate,
+                                                 masked, length_masked,
+                                                 &decoded, &decoded_length));
+    LONGS_EQUAL(1 + strlen (msg) + 1, decoded_length);
+    LONGS_EQUAL(RELAY_CLIENT_MSG_STANDARD, decoded[0]);
+    STRCMP_EQUAL(msg, (const char *)decoded + 1);
+    free (decoded);
+    free (masked);
+    free (frame);
+
+    /* control frames are never compressed */
+    frame = relay_websocket_encode_frame (ws_deflate,
+                                          WEBSOCKET_FRAME_OPCODE_PONG,
+                                          "abc", 3, &length_frame);
+    CHECK(frame);
+    LONGS_EQUAL(0x8A, (unsigned char)frame[0]);
+    LONGS_EQUAL(5, length_frame);
+    free (frame);
+
+    relay_websocket_deflate_free (ws_deflate);
+}
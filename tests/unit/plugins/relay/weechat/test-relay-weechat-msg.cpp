@@ -0,0 +1,368 @@
+/*
+ * test-relay-weechat-msg.cpp - test messages for WeeChat protocol (relay)
+ *
+ * Copyright (C) 2021 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/relay/relay.h"
+#include "src/plugins/relay/relay-client.h"
+#include "src/plugins/relay/weechat/relay-weechat.h"
+#include "src/plugins/relay/weechat/relay-weechat-msg.h"
+}
+
+TEST_GROUP(RelayWeechatMsg)
+{
+};
+
+/*
+ * Tests functions:
+ *   relay_weechat_msg_new
+ *   relay_weechat_msg_add_string
+ *   relay_weechat_msg_free
+ */
+
+TEST(RelayWeechatMsg, NewFree)
+{
+    struct t_relay_weechat_msg *msg;
+
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    STRCMP_EQUAL("test", msg->id);
+    /* size (4) + compression (1) + id (4 + 4) */
+    LONGS_EQUAL(13, msg->data_size);
+    LONGS_EQUAL(-1, msg->compression);
+    POINTERS_EQUAL(NULL, msg->compressed);
+
+    relay_weechat_msg_add_string (msg, "abc");
+    LONGS_EQUAL(20, msg->data_size);
+    MEMCMP_EQUAL("\x00\x00\x00\x03" "abc", msg->data + 13, 7);
+
+    relay_weechat_msg_free (msg);
+    relay_weechat_msg_free (NULL);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_msg_compress
+ */
+
+TEST(RelayWeechatMsg, Compress)
+{
+    struct t_relay_weechat_msg *msg;
+    struct t_relay_client_data *ptr_compressed;
+    char string[1024];
+    uint32_t size32;
+    int i;
+
+    relay_weechat_msg_compress (NULL, RELAY_WEECHAT_COMPRESSION_ZLIB, 6);
+
+    /* small message: compression is useless */
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    relay_weechat_msg_compress (msg, RELAY_WEECHAT_COMPRESSION_ZLIB, 6);
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB, msg->compression);
+    LONGS_EQUAL(6, msg->compression_level);
+    POINTERS_EQUAL(NULL, msg->compressed);
+    relay_weechat_msg_free (msg);
+
+    /* big message: compressed once, then compressed message is reused */
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    memset (string, 'a', sizeof (string) - 1);
+    string[sizeof (string) - 1] = '\0';
+    for (i = 0; i < 16; i++)
+    {
+        relay_weechat_msg_add_string (msg, string);
+    }
+    relay_weechat_msg_compress (msg, RELAY_WEECHAT_COMPRESSION_ZLIB, 6);
+    CHECK(msg->compressed);
+    CHECK(msg->compressed->size < msg->data_size);
+    memcpy (&size32, msg->compressed->buffer, 4);
+    LONGS_EQUAL(msg->compressed->size, (int)ntohl (size32));
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB, msg->compressed->buffer[4]);
+    ptr_compressed = msg->compressed;
+    relay_weechat_msg_compress (msg, RELAY_WEECHAT_COMPRESSION_ZLIB, 6);
+    POINTERS_EQUAL(ptr_compressed, msg->compressed);
+
+    /* another level: message is compressed again */
+    relay_weechat_msg_compress (msg, RELAY_WEECHAT_COMPRESSION_ZLIB, 9);
+    LONGS_EQUAL(9, msg->compression_level);
+    CHECK(msg->compressed);
+
+    /* message changed: compressed message is removed */
+    relay_weechat_msg_add_char (msg, 'a');
+    LONGS_EQUAL(-1, msg->compression);
+    POINTERS_EQUAL(NULL, msg->compressed);
+
+    relay_weechat_msg_free (msg);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_deflate_get
+ *   relay_weechat_deflate_free
+ *   relay_weechat_msg_compress_stream
+ */
+
+TEST(RelayWeechatMsg, CompressStream)
+{
+    struct t_relay_client client, *ptr_client;
+    struct t_relay_weechat_msg *msg;
+    struct z_stream_s *stream;
+    char string[256], *dest1, *dest2;
+    uint32_t size32;
+    int size1, size2;
+    long long time_diff;
+
+    memset (&client, 0, sizeof (client));
+    client.protocol = RELAY_PROTOCOL_WEECHAT;
+    ptr_client = &client;
+    relay_weechat_alloc (&client);
+    CHECK(client.protocol_data);
+    POINTERS_EQUAL(NULL, RELAY_WEECHAT_DATA(ptr_client, deflate_stream));
+
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    snprintf (string, sizeof (string),
+              "%s", "this is a test message, sent twice to the client");
+    relay_weechat_msg_add_string (msg, string);
+
+    /* first message */
+    dest1 = relay_weechat_msg_compress_stream (&client, msg, 6,
+                                               &size1, &time_diff);
+    CHECK(dest1);
+    stream = RELAY_WEECHAT_DATA(ptr_client, deflate_stream);
+    CHECK(stream);
+    LONGS_EQUAL(6, RELAY_WEECHAT_DATA(ptr_client, deflate_level));
+    memcpy (&size32, dest1, 4);
+    LONGS_EQUAL(size1, (int)ntohl (size32));
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB_STREAM, dest1[4]);
+    /* data is flushed: it ends with an empty stored block */
+    MEMCMP_EQUAL("\x00\x00\xff\xff", dest1 + size1 - 4, 4);
+
+    /* same message: compressed against the first one, so much smaller */
+    dest2 = relay_weechat_msg_compress_stream (&client, msg, 6,
+                                               &size2, &time_diff);
+    CHECK(dest2);
+    POINTERS_EQUAL(stream, RELAY_WEECHAT_DATA(ptr_client, deflate_stream));
+    CHECK(size2 < size1);
+    CHECK(size2 < msg->data_size / 2);
+    free (dest1);
+    free (dest2);
+
+    /* compression level changed: a new stream is created */
+    dest1 = relay_weechat_msg_compress_stream (&client, msg, 9,
+                                               &size1, &time_diff);
+    CHECK(dest1);
+    LONGS_EQUAL(9, RELAY_WEECHAT_DATA(ptr_client, deflate_level));
+    free (dest1);
+
+    relay_weechat_deflate_free (&client);
+    POINTERS_EQUAL(NULL, RELAY_WEECHAT_DATA(ptr_client, deflate_stream));
+    LONGS_EQUAL(0, RELAY_WEECHAT_DATA(ptr_client, deflate_level));
+
+    relay_weechat_msg_free (msg);
+    relay_weechat_free (&client);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_msg_hdata_new
+ *   relay_weechat_msg_add_hdata_page
+ *   relay_weechat_msg_hdata_free
+ */
+
+TEST(RelayWeechatMsg, AddHdataPage)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_weechat_msg *msg, *msg_page;
+    struct t_relay_weechat_msg_hdata *hdata;
+    char path[128], objects[8192];
+    int i, header_size, size, objects_size, pages, total;
+    uint32_t count32;
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+    for (i = 0; i < 10; i++)
+    {
+        gui_chat_printf (test_buffer, "line %d", i + 1);
+    }
+
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_new (NULL, NULL));
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_new ("buffer", NULL));
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_new ("xxx:gui_buffers", NULL));
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_new ("buffer:0x1", NULL));
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_new ("buffer:gui_buffers",
+                                                      "xxx"));
+
+    snprintf (path, sizeof (path),
+              "buffer:0x%lx/own_lines/last_line(-8)/data",
+              (unsigned long)test_buffer);
+
+    /* whole hdata in a single message */
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    LONGS_EQUAL(1, relay_weechat_msg_add_hdata (msg, path, "message"));
+
+    hdata = relay_weechat_msg_hdata_new (path, "message");
+    CHECK(hdata);
+    STRCMP_EQUAL("buffer/lines/line/line_data", hdata->path->names);
+    STRCMP_EQUAL("message:str", hdata->path->keys_types);
+    LONGS_EQUAL(4, hdata->path->num_path);
+    LONGS_EQUAL(1, hdata->path->num_keys);
+    LONGS_EQUAL(-7, hdata->counts[2]);
+    header_size = 3 + 4 + strlen (hdata->path->names)
+        + 4 + strlen (hdata->path->keys_types) + 4;
+    memcpy (&count32, msg->data + 13 + header_size - 4, 4);
+    LONGS_EQUAL(8, ntohl (count32));
+
+    /* same hdata in pages of 3 objects: same objects are sent */
+    LONGS_EQUAL(1, hdata->check_position);
+    hdata->check_position = 0;
+    objects_size = 0;
+    total = 0;
+    for (pages = 0; pages < 10; pages++)
+    {
+        msg_page = relay_weechat_msg_new ("test");
+        CHECK(msg_page);
+        total += relay_weechat_msg_add_hdata_page (msg_page, hdata, 3, 0);
+        size = msg_page->data_size - 13 - header_size;
+        memcpy (objects + objects_size, msg_page->data + 13 + header_size,
+                size);
+        objects_size += size;
+        relay_weechat_msg_free (msg_page);
+        if (hdata->ended)
+            break;
+    }
+    LONGS_EQUAL(2, pages);
+    LONGS_EQUAL(8, total);
+    LONGS_EQUAL(msg->data_size - 13 - header_size, objects_size);
+    MEMCMP_EQUAL(msg->data + 13 + header_size, objects, objects_size);
+    relay_weechat_msg_hdata_free (hdata);
+    relay_weechat_msg_free (msg);
+
+    /* pages limited by size: at least one object is added */
+    hdata = relay_weechat_msg_hdata_new (path, "message");
+    CHECK(hdata);
+    msg_page = relay_weechat_msg_new ("test");
+    LONGS_EQUAL(1, relay_weechat_msg_add_hdata_page (msg_page, hdata, 0, 1));
+    LONGS_EQUAL(0, hdata->ended);
+    relay_weechat_msg_free (msg_page);
+
+    /* lines removed between two pages: hdata is ended */
+    gui_buffer_clear (test_buffer);
+    msg_page = relay_weechat_msg_new ("test");
+    LONGS_EQUAL(0, relay_weechat_msg_add_hdata_page (msg_page, hdata, 0, 0));
+    LONGS_EQUAL(1, hdata->ended);
+    relay_weechat_msg_free (msg_page);
+    relay_weechat_msg_hdata_free (hdata);
+
+    relay_weechat_msg_hdata_free (NULL);
+
+    gui_buffer_close (test_buffer);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_msg_hdata_path_get
+ *   relay_weechat_msg_hdata_path_unref
+ *   relay_weechat_msg_hdata_new_pointers
+ *   relay_weechat_msg_add_hdata_pointers
+ */
+
+TEST(RelayWeechatMsg, AddHdataPointers)
+{
+    struct t_gui_buffer *test_buffer;
+    struct t_relay_weechat_msg *msg, *msg_pointers;
+    struct t_relay_weechat_msg_hdata *hdata, *hdata2;
+    void *pointers[2];
+    char path[128];
+
+    test_buffer = gui_buffer_new (NULL, "test", NULL, NULL, NULL,
+                                  NULL, NULL, NULL);
+    CHECK(test_buffer);
+    gui_chat_printf (test_buffer, "line 1");
+    gui_chat_printf (test_buffer, "line 2");
+
+    /* same path and keys: compiled path is shared */
+    snprintf (path, sizeof (path),
+              "buffer:0x%lx/own_lines/first_line(*)/data",
+              (unsigned long)test_buffer);
+    hdata = relay_weechat_msg_hdata_new (path, "message,prefix");
+    CHECK(hdata);
+    hdata2 = relay_weechat_msg_hdata_new (path, "message,prefix");
+    CHECK(hdata2);
+    POINTERS_EQUAL(hdata->path, hdata2->path);
+    LONGS_EQUAL(3, hdata->path->refcount);
+    relay_weechat_msg_hdata_free (hdata2);
+    LONGS_EQUAL(2, hdata->path->refcount);
+    hdata2 = relay_weechat_msg_hdata_new (path, "message");
+    CHECK(hdata2);
+    CHECK(hdata->path != hdata2->path);
+    relay_weechat_msg_hdata_free (hdata2);
+
+    /* objects given by pointers: same objects as with a path */
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    snprintf (path, sizeof (path),
+              "line_data:0x%lx,0x%lx",
+              (unsigned long)test_buffer->own_lines->first_line->data,
+              (unsigned long)test_buffer->own_lines->last_line->data);
+    LONGS_EQUAL(1, relay_weechat_msg_add_hdata (msg, path, "message,prefix"));
+    msg_pointers = relay_weechat_msg_new ("test");
+    CHECK(msg_pointers);
+    POINTERS_EQUAL(NULL,
+                   relay_weechat_msg_hdata_new_pointers ("line_data", NULL,
+                                                         0, NULL));
+    LONGS_EQUAL(0, relay_weechat_msg_add_hdata_pointers (msg_pointers,
+                                                         "xxx", pointers, 1,
+                                                         NULL));
+    pointers[0] = test_buffer->own_lines->first_line->data;
+    pointers[1] = test_buffer->own_lines->last_line->data;
+    LONGS_EQUAL(1, relay_weechat_msg_add_hdata_pointers (msg_pointers,
+                                                         "line_data",
+                                                         pointers, 2,
+                                                         "message,prefix"));
+    LONGS_EQUAL(msg->data_size, msg_pointers->data_size);
+    MEMCMP_EQUAL(msg->data, msg_pointers->data, msg->data_size);
+    relay_weechat_msg_free (msg);
+    relay_weechat_msg_free (msg_pointers);
+
+    /* compiled paths not kept any more: still usable by hdata */
+    relay_weechat_msg_hdata_paths_free_all ();
+    POINTERS_EQUAL(NULL, relay_weechat_msg_hdata_paths);
+    LONGS_EQUAL(1, hdata->path->refcount);
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    LONGS_EQUAL(2, relay_weechat_msg_add_hdata_page (msg, hdata, 0, 0));
+    relay_weechat_msg_free (msg);
+    relay_weechat_msg_hdata_free (hdata);
+
+    gui_buffer_close (test_buffer);
+}